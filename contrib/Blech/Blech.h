@@ -67,8 +67,11 @@ Using Blech:
 
 #define BLECHVERSION "Lax/Blech 1.7.4"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 //#ifdef WIN32
 
@@ -514,6 +517,10 @@ public:
 	{
 		if (!text || !text[0])
 			return 0;
+		if (!MayMatch(text))
+			return 0;
+		if (CompiledMode)
+			return FeedCompiled(text);
 		BlechDebug("Feed(%s)", text);
 		unsigned int Root = (unsigned char)text[0];
 
@@ -526,6 +533,28 @@ public:
 
 	template <unsigned int Size> unsigned int Feed(char(&Input)[Size]) { return Feed(Input, (size_t)Size); }
 
+	// Returns false if no event can match the text. Every normal string on the path from an event's
+	// node to the root has to be found in the text for the event to match, so the text is scanned
+	// once for the longest of those strings of each event.
+	bool MayMatch(const char* text)
+	{
+		if (PrefilterDirty)
+			BuildPrefilter();
+
+		if (PrefilterAlwaysMatch)
+			return true;
+
+		int State = 0;
+		for (const unsigned char* pPos = (const unsigned char*)text; *pPos; ++pPos)
+		{
+			State = PrefilterTable[State * PrefilterClasses + PrefilterClass[*pPos]];
+			if (PrefilterMatch[State])
+				return true;
+		}
+
+		return false;
+	}
+
 	inline bool IsExact(const char* Text)
 	{
 		if (!strchr(Text, ScanVarDelimiter) && (!PrintVarDelimiter || !strchr(Text, PrintVarDelimiter)))
@@ -533,30 +562,40 @@ public:
 		return false;
 	}
 
-	unsigned int AddEvent(const char* Text, fBlechCallback Callback, void* pData = 0)
+	struct BlechPart
 	{
-		BlechDebug("AddEvent(%s,%X,%X)", Text, Callback, pData);
-		BLECHASSERT(Text);
-		BLECHASSERT(Callback);
+		std::string      Text;
+		eBlechStringType Type;
+	};
+
+	// Splits an event pattern into its normal strings and variables. A doubled delimiter in a
+	// normal string stands for the delimiter itself.
+	std::vector<BlechPart> SplitPattern(const char* Text) const
+	{
+		std::vector<BlechPart> Parts;
 		const char* pText = Text;
 		const char* Part = Text;
 		eBlechStringType StringType = BST_NORMAL;
-		BlechNode* pNode = 0;
+
+		auto AddPart = [&](const char* End, eBlechStringType Type)
+		{
+			if (Part != End)
+				Parts.push_back({ std::string(Part, End), Type });
+		};
+
 		while (char c = *pText)
 		{
 			if (c == ScanVarDelimiter)
 			{
 				if (StringType == BST_NORMAL && pText[1] == ScanVarDelimiter)
 				{
-					if (Part != pText)
-						pNode = AddNode(pNode, Part, pText, StringType);
+					AddPart(pText, StringType);
 					Part = &pText[1];
 					pText++;
 				}
 				else
 				{
-					if (Part != pText)
-						pNode = AddNode(pNode, Part, pText, StringType);
+					AddPart(pText, StringType);
 					Part = &pText[1];
 					if (StringType == BST_SCANVAR)
 						StringType = BST_NORMAL;
@@ -569,15 +608,13 @@ public:
 				{
 					if (StringType == BST_NORMAL && pText[1] == PrintVarDelimiter)
 					{
-						if (Part != pText)
-							pNode = AddNode(pNode, Part, pText, StringType);
+						AddPart(pText, StringType);
 						Part = &pText[1];
 						pText++;
 					}
 					else
 					{
-						if (Part != pText)
-							pNode = AddNode(pNode, Part, pText, StringType);
+						AddPart(pText, StringType);
 						Part = &pText[1];
 						if (StringType == BST_PRINTVAR)
 							StringType = BST_NORMAL;
@@ -587,9 +624,73 @@ public:
 				}
 			pText++;
 		}
-		if (*Part)
+		AddPart(pText, StringType);
+
+		return Parts;
+	}
+
+	// Compiled matching puts the normal strings of every event into a single automaton. A line
+	// is scanned once to find where each of those strings occurs, and every event is then
+	// resolved against those positions instead of walking the tree. Matches are the same as
+	// Feed, except that callbacks are made in the order the events were added.
+	void SetCompiled(bool Compiled)
+	{
+		CompiledMode = Compiled;
+		CompiledDirty = true;
+	}
+
+	bool IsCompiled() const { return CompiledMode; }
+
+	struct BlechCapture
+	{
+		const char*    Name;
+		size_t         Begin;
+		size_t         Length;
+	};
+
+	struct BlechMatch
+	{
+		unsigned int   ID;
+		size_t         FirstCapture;  // index into the captures passed to Match
+		size_t         CaptureCount;
+	};
+
+	// Finds every event that matches the text, without making any callbacks. Captures are
+	// slices of the text.
+	size_t Match(const char* text, std::vector<BlechMatch>& Matches, std::vector<BlechCapture>& Captures)
+	{
+		Matches.clear();
+		Captures.clear();
+		if (!text || !text[0])
+			return 0;
+
+		if (CompiledDirty)
+			BuildCompiled();
+
+		ScanCompiled(text);
+
+		const size_t Length = strlen(text);
+		for (const BlechCompiledEvent& Event : CompiledEvents)
+		{
+			const size_t FirstCapture = Captures.size();
+			if (MatchCompiled(Event, text, Length, Captures))
+				Matches.push_back({ Event.pEvent->ID, FirstCapture, Captures.size() - FirstCapture });
+			else
+				Captures.resize(FirstCapture);
+		}
+
+		return Matches.size();
+	}
+
+	unsigned int AddEvent(const char* Text, fBlechCallback Callback, void* pData = 0)
+	{
+		BlechDebug("AddEvent(%s,%X,%X)", Text, Callback, pData);
+		BLECHASSERT(Text);
+		BLECHASSERT(Callback);
+		BlechNode* pNode = 0;
+		for (const BlechPart& Part : SplitPattern(Text))
 		{
-			pNode = AddNode(pNode, Part, pText, StringType);
+			pNode = AddNode(pNode, Part.Text.c_str(), Part.Text.c_str() + Part.Text.length(), Part.Type);
 		}
 
 		// add event to node
@@ -603,6 +704,8 @@ public:
 		rEvent.OriginalString = Text;
 
 		pNode->AddEvent(&rEvent);
+		PrefilterDirty = true;
+		CompiledDirty = true;
 
 		return rEvent.ID;
 	}
@@ -644,6 +747,8 @@ public:
 		}
 
 		EventMap.erase(ID);
+		PrefilterDirty = true;
+		CompiledDirty = true;
 		return true;
 	}
 
@@ -709,8 +814,439 @@ private:
 
 		EventMap.clear();
 		LastID = 0;
+		PrefilterDirty = true;
+		CompiledDirty = true;
+	}
+
+	static unsigned char FoldCase(unsigned char c)
+	{
+#ifndef BLECH_CASE_SENSITIVE
+		if (c >= 'a' && c <= 'z')
+			return c - 32;
+#endif
+		return c;
+	}
+
+	// Builds an Aho-Corasick automaton over the longest normal string of every event. Characters
+	// are mapped to classes first, so the transition table only has columns for characters that
+	// appear in one of the strings.
+	void BuildPrefilter()
+	{
+		PrefilterDirty = false;
+		PrefilterAlwaysMatch = false;
+
+		std::vector<const BlechNode*> Literals;
+		for (const auto& [ID, Event] : EventMap)
+		{
+			const BlechNode* pLongest = nullptr;
+			for (const BlechNode* pNode = Event.pBlechNode; pNode; pNode = pNode->pParent)
+			{
+				if (pNode->StringType == BST_NORMAL && (!pLongest || pNode->Length > pLongest->Length))
+					pLongest = pNode;
+			}
+
+			if (!pLongest)
+			{
+				if (Event.pBlechNode)
+				{
+					// nothing but variables, anything can match.
+					PrefilterAlwaysMatch = true;
+					return;
+				}
+				continue;
+			}
+
+			Literals.push_back(pLongest);
+		}
+
+		memset(PrefilterClass, 0, sizeof(PrefilterClass));
+		PrefilterClasses = 1;
+		for (const BlechNode* pNode : Literals)
+		{
+			for (uint32_t N = 0; N < pNode->Length; ++N)
+			{
+				unsigned char c = FoldCase((unsigned char)pNode->pString[N]);
+				if (!PrefilterClass[c])
+				{
+					PrefilterClass[c] = PrefilterClasses++;
+#ifndef BLECH_CASE_SENSITIVE
+					if (c >= 'A' && c <= 'Z')
+						PrefilterClass[c + 32] = PrefilterClass[c];
+#endif
+				}
+			}
+		}
+
+		// build the trie
+		PrefilterTable.assign(PrefilterClasses, -1);
+		PrefilterMatch.assign(1, false);
+		for (const BlechNode* pNode : Literals)
+		{
+			int State = 0;
+			for (uint32_t N = 0; N < pNode->Length; ++N)
+			{
+				int& Next = PrefilterTable[State * PrefilterClasses + PrefilterClass[(unsigned char)pNode->pString[N]]];
+				if (Next == -1)
+				{
+					Next = (int)PrefilterMatch.size();
+					PrefilterMatch.push_back(false);
+					PrefilterTable.resize(PrefilterTable.size() + PrefilterClasses, -1);
+				}
+				State = PrefilterTable[State * PrefilterClasses + PrefilterClass[(unsigned char)pNode->pString[N]]];
+			}
+			PrefilterMatch[State] = true;
+		}
+
+		// turn it into a complete transition table, following failure links breadth first
+		std::vector<int> Fail(PrefilterMatch.size(), 0);
+		std::vector<int> Queue;
+		Queue.reserve(PrefilterMatch.size());
+
+		for (int Class = 0; Class < PrefilterClasses; ++Class)
+		{
+			int& Next = PrefilterTable[Class];
+			if (Next == -1)
+				Next = 0;
+			else
+				Queue.push_back(Next);
+		}
+
+		for (size_t Head = 0; Head < Queue.size(); ++Head)
+		{
+			int State = Queue[Head];
+			if (PrefilterMatch[Fail[State]])
+				PrefilterMatch[State] = true;
+
+			for (int Class = 0; Class < PrefilterClasses; ++Class)
+			{
+				int& Next = PrefilterTable[State * PrefilterClasses + Class];
+				int FailNext = PrefilterTable[Fail[State] * PrefilterClasses + Class];
+				if (Next == -1)
+				{
+					Next = FailNext;
+				}
+				else
+				{
+					Fail[Next] = FailNext;
+					Queue.push_back(Next);
+				}
+			}
+		}
+	}
+
+
+	struct BlechCompiledToken
+	{
+		eBlechStringType Type;          // BST_SCANVAR, or BST_NORMAL for a run of normal strings
+		std::string      Text;          // the variable name, or the run when it is all normal strings
+		std::vector<BlechPart> Parts;   // the run when it includes print variables
+		int              Literal = -1;  // the run's index into the automaton, if it has one
+	};
+
+	struct BlechCompiledEvent
+	{
+		BLECHEVENT*      pEvent;
+		std::vector<BlechCompiledToken> Tokens;
+	};
+
+	// Builds an Aho-Corasick automaton over every run of normal strings in every event. Runs that
+	// include a print variable can't be known ahead of time, those are searched for as needed.
+	void BuildCompiled()
+	{
+		CompiledDirty = false;
+		CompiledEvents.clear();
+
+		std::map<std::string, int> LiteralIDs;
+		std::vector<std::string> Literals;
+
+		for (auto& [ID, Event] : EventMap)
+		{
+			BlechCompiledEvent& Compiled = CompiledEvents.emplace_back();
+			Compiled.pEvent = &Event;
+
+			bool Dynamic = false;
+			for (BlechPart& Part : SplitPattern(Event.OriginalString.c_str()))
+			{
+				if (Part.Type == BST_SCANVAR)
+				{
+					Compiled.Tokens.push_back({ BST_SCANVAR, std::move(Part.Text) });
+					continue;
+				}
+
+				if (Compiled.Tokens.empty() || Compiled.Tokens.back().Type == BST_SCANVAR)
+				{
+					Compiled.Tokens.push_back({ BST_NORMAL });
+					Dynamic = false;
+				}
+
+				BlechCompiledToken& Run = Compiled.Tokens.back();
+				if (Part.Type == BST_PRINTVAR)
+					Dynamic = true;
+				if (!Run.Text.empty())
+					Run.Parts.push_back({ Run.Text, BST_NORMAL });
+				Run.Text.clear();
+				Run.Parts.push_back(std::move(Part));
+
+				if (!Dynamic)
+				{
+					// still all normal strings, keep the run as a single string
+					for (const BlechPart& RunPart : Run.Parts)
+						Run.Text += RunPart.Text;
+					Run.Parts.clear();
+				}
+			}
+
+			for (BlechCompiledToken& Token : Compiled.Tokens)
+			{
+				if (Token.Type != BST_NORMAL || !Token.Parts.empty())
+					continue;
+
+				std::string Folded = Token.Text;
+				for (char& c : Folded)
+					c = (char)FoldCase((unsigned char)c);
+
+				auto [iter, Added] = LiteralIDs.emplace(Folded, (int)Literals.size());
+				if (Added)
+					Literals.push_back(Folded);
+				Token.Literal = iter->second;
+			}
+		}
+
+		memset(CompiledClass, 0, sizeof(CompiledClass));
+		CompiledClasses = 1;
+		for (const std::string& Literal : Literals)
+		{
+			for (char Char : Literal)
+			{
+				unsigned char c = (unsigned char)Char;
+				if (!CompiledClass[c])
+				{
+					CompiledClass[c] = CompiledClasses++;
+#ifndef BLECH_CASE_SENSITIVE
+					if (c >= 'A' && c <= 'Z')
+						CompiledClass[c + 32] = CompiledClass[c];
+#endif
+				}
+			}
+		}
+
+		// build the trie, each state remembers the literal that ends there
+		CompiledTable.assign(CompiledClasses, -1);
+		CompiledTerminal.assign(1, -1);
+		CompiledLiteralLength.clear();
+		for (const std::string& Literal : Literals)
+		{
+			int State = 0;
+			for (char Char : Literal)
+			{
+				int Class = CompiledClass[(unsigned char)Char];
+				if (CompiledTable[State * CompiledClasses + Class] == -1)
+				{
+					CompiledTable[State * CompiledClasses + Class] = (int)CompiledTerminal.size();
+					CompiledTerminal.push_back(-1);
+					CompiledTable.resize(CompiledTable.size() + CompiledClasses, -1);
+				}
+				State = CompiledTable[State * CompiledClasses + Class];
+			}
+			CompiledTerminal[State] = (int)CompiledLiteralLength.size();
+			CompiledLiteralLength.push_back(Literal.length());
+		}
+
+		// complete the transition table. Output links point at the nearest state on the failure
+		// chain where another literal ends, so every literal ending at a position can be listed.
+		std::vector<int> Fail(CompiledTerminal.size(), 0);
+		CompiledOutput.assign(CompiledTerminal.size(), -1);
+		std::vector<int> Queue;
+		Queue.reserve(CompiledTerminal.size());
+
+		for (int Class = 0; Class < CompiledClasses; ++Class)
+		{
+			int& Next = CompiledTable[Class];
+			if (Next == -1)
+				Next = 0;
+			else
+				Queue.push_back(Next);
+		}
+
+		for (size_t Head = 0; Head < Queue.size(); ++Head)
+		{
+			int State = Queue[Head];
+			CompiledOutput[State] = CompiledTerminal[Fail[State]] != -1 ? Fail[State] : CompiledOutput[Fail[State]];
+
+			for (int Class = 0; Class < CompiledClasses; ++Class)
+			{
+				int& Next = CompiledTable[State * CompiledClasses + Class];
+				int FailNext = CompiledTable[Fail[State] * CompiledClasses + Class];
+				if (Next == -1)
+				{
+					Next = FailNext;
+				}
+				else
+				{
+					Fail[Next] = FailNext;
+					Queue.push_back(Next);
+				}
+			}
+		}
+
+		CompiledOccurrences.assign(Literals.size(), {});
+	}
+
+	// Records where each literal starts in the text. Each literal has a fixed length, so its
+	// positions are found in increasing order.
+	void ScanCompiled(const char* text)
+	{
+		for (std::vector<size_t>& Occurrences : CompiledOccurrences)
+			Occurrences.clear();
+
+		int State = 0;
+		for (const unsigned char* pPos = (const unsigned char*)text; *pPos; ++pPos)
+		{
+			State = CompiledTable[State * CompiledClasses + CompiledClass[*pPos]];
+
+			const size_t End = pPos - (const unsigned char*)text + 1;
+			for (int Output = CompiledTerminal[State] != -1 ? State : CompiledOutput[State]; Output > 0; Output = CompiledOutput[Output])
+			{
+				int Literal = CompiledTerminal[Output];
+				CompiledOccurrences[Literal].push_back(End - CompiledLiteralLength[Literal]);
+			}
+		}
 	}
 
+	std::string_view GetRunText(const BlechCompiledToken& Run, std::string& Buffer)
+	{
+		if (Run.Parts.empty())
+			return Run.Text;
+
+		Buffer.clear();
+		char VarData[4096];
+		for (const BlechPart& Part : Run.Parts)
+		{
+			if (Part.Type == BST_PRINTVAR)
+			{
+				VarData[0] = 0;
+				BlechTry(VariableValue(const_cast<char*>(Part.Text.c_str()), VarData, sizeof(VarData)));
+				Buffer += VarData;
+			}
+			else
+			{
+				Buffer += Part.Text;
+			}
+		}
+
+		return Buffer;
+	}
+
+	// Finds the first place at or after Pos where the run occurs.
+	size_t FindRun(const BlechCompiledToken& Run, std::string_view RunText, const char* text, size_t Pos)
+	{
+		if (Run.Literal != -1)
+		{
+			const std::vector<size_t>& Occurrences = CompiledOccurrences[Run.Literal];
+			auto iter = std::lower_bound(Occurrences.begin(), Occurrences.end(), Pos);
+			return iter != Occurrences.end() ? *iter : std::string_view::npos;
+		}
+
+		std::string Needle{ RunText };
+		const char* pFound = STRFIND(text + Pos, Needle.c_str());
+		return pFound ? pFound - text : std::string_view::npos;
+	}
+
+	// Follows the same rules as QueueEvents. Normal strings before the first scan variable must
+	// start the text, those after the last one must end it, and a scan variable ends at the first
+	// place that the strings following it occur.
+	bool MatchCompiled(const BlechCompiledEvent& Event, const char* text, size_t Length, std::vector<BlechCapture>& Captures)
+	{
+		std::string Buffer;
+		size_t Pos = 0;
+		const BlechCompiledToken* pScanVar = nullptr;
+		const BlechCompiledToken* pRun = nullptr;
+
+		for (const BlechCompiledToken& Token : Event.Tokens)
+		{
+			if (Token.Type != BST_SCANVAR)
+			{
+				pRun = &Token;
+				continue;
+			}
+
+			std::string_view RunText = pRun ? GetRunText(*pRun, Buffer) : std::string_view();
+			if (pScanVar)
+			{
+				if (!RunText.empty())
+				{
+					size_t Found = FindRun(*pRun, RunText, text, Pos);
+					if (Found == std::string_view::npos)
+						return false;
+
+					Captures.push_back({ pScanVar->Text.c_str(), Pos, Found - Pos });
+					Pos = Found + RunText.length();
+				}
+				else
+				{
+					Captures.push_back({ pScanVar->Text.c_str(), Pos, 0 });
+				}
+			}
+			else
+			{
+				if (RunText.length() > Length - Pos || STRNCMP(text + Pos, RunText.data(), RunText.length()))
+					return false;
+				Pos += RunText.length();
+			}
+
+			pScanVar = &Token;
+			pRun = nullptr;
+		}
+
+		std::string_view RunText = pRun ? GetRunText(*pRun, Buffer) : std::string_view();
+		if (pScanVar)
+		{
+			if (RunText.length() > Length - Pos)
+				return false;
+
+			size_t End = Length - RunText.length();
+			if (STRNCMP(text + End, RunText.data(), RunText.length()))
+				return false;
+
+			Captures.push_back({ pScanVar->Text.c_str(), Pos, End - Pos });
+			return true;
+		}
+
+		return RunText.length() == Length - Pos && !STRNCMP(text + Pos, RunText.data(), RunText.length());
+	}
+
+	unsigned int FeedCompiled(const char* text)
+	{
+		BlechDebug("FeedCompiled(%s)", text);
+		Match(text, CompiledMatches, CompiledCaptures);
+
+		// callbacks are made from a list, the same as Chew, so that they can add or remove events
+		PBLECHEXECUTE pExecuteList = nullptr;
+		for (auto iter = CompiledMatches.rbegin(); iter != CompiledMatches.rend(); ++iter)
+		{
+			PBLECHVALUE pValues = nullptr;
+			for (size_t Index = iter->CaptureCount; Index-- > 0;)
+			{
+				const BlechCapture& Capture = CompiledCaptures[iter->FirstCapture + Index];
+				PBLECHVALUE pNewValue = new BLECHVALUE;
+				pNewValue->Name = Capture.Name;
+				pNewValue->Value = std::string_view{ text + Capture.Begin, Capture.Length };
+				pNewValue->pNext = pValues;
+				pValues = pNewValue;
+			}
+
+			PBLECHEXECUTE pNew = new BLECHEXECUTE;
+			BLECHEVENT& rEvent = EventMap[iter->ID];
+			pNew->Callback = rEvent.Callback;
+			pNew->ID = rEvent.ID;
+			pNew->pData = rEvent.pData;
+			pNew->pValues = pValues;
+			pNew->pNext = pExecuteList;
+			pExecuteList = pNew;
+		}
+
+		return ProcessExecutionList(&pExecuteList);
+	}
 
 	void QueueEvent(PBLECHEXECUTE* ppExecuteList, PBLECHEVENT pEvent, PBLECHVALUE pValues)
 	{
@@ -1391,4 +1927,24 @@ private:
 	fBlechVariableValue VariableValue = 0;
 	BlechEventMap EventMap;
 	BlechNode* Tree[256];
+
+	bool PrefilterDirty = true;
+	bool PrefilterAlwaysMatch = false;
+	int PrefilterClasses = 1;
+	unsigned char PrefilterClass[256] = { 0 };
+	std::vector<int> PrefilterTable;
+	std::vector<bool> PrefilterMatch;
+
+	bool CompiledMode = false;
+	bool CompiledDirty = true;
+	int CompiledClasses = 1;
+	unsigned char CompiledClass[256] = { 0 };
+	std::vector<int> CompiledTable;
+	std::vector<int> CompiledTerminal;
+	std::vector<int> CompiledOutput;
+	std::vector<size_t> CompiledLiteralLength;
+	std::vector<std::vector<size_t>> CompiledOccurrences;
+	std::vector<BlechCompiledEvent> CompiledEvents;
+	std::vector<BlechMatch> CompiledMatches;
+	std::vector<BlechCapture> CompiledCaptures;
 };
\ No newline at end of file
@@ -29,7 +29,7 @@ class ZepFont;
 struct SpanInfo
 {
     ByteRange lineByteRange;                       // Begin/end range of the text buffer for this line, as always end is one beyond the end.
-    std::vector<LineCharInfo> lineCodePoints;      // Codepoints
+    const ZepBuffer* pBuffer = nullptr;            // Buffer the range is in, for filling out the codepoints
     long bufferLineNumber = 0;                     // Line in the original buffer, not the screen line
     float yOffsetPx = 0.0f;                        // Position in the buffer in pixels, if the screen was as big as the buffer.
     NVec2f lineTextSizePx = NVec2f(0.0f);          // Pixel size of the text
@@ -39,6 +39,19 @@ struct SpanInfo
     NVec2f lineWidgetHeights;
     ZepFont* pFont = nullptr;
 
+    // Codepoints, worked out the first time they are asked for; most lines of a large buffer are never shown,
+    // so laying out the buffer only measures them.
+    const std::vector<LineCharInfo>& CodePoints() const;
+    std::vector<LineCharInfo>& CodePoints()
+    {
+        static_cast<const SpanInfo*>(this)->CodePoints();
+        return lineCodePoints;
+    }
+    void InvalidateCodePoints()
+    {
+        codePointsValid = false;
+    }
+
     float FullLineHeightPx() const
     {
         return padding.x + padding.y + lineTextSizePx.y;
@@ -55,6 +68,10 @@ struct SpanInfo
     {
         return offset.Index() >= lineByteRange.first && offset.Index() < lineByteRange.second;
     }
+
+private:
+    mutable std::vector<LineCharInfo> lineCodePoints;
+    mutable bool codePointsValid = false;
 };
 
 inline bool operator < (const SpanInfo& lhs, const SpanInfo& rhs)
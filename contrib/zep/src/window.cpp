@@ -85,6 +85,38 @@ ZepWindow::ZepWindow(ZepTabWindow& window, ZepBuffer* buffer)
     timer_start(m_toolTipTimer);
 }
 
+const std::vector<LineCharInfo>& SpanInfo::CodePoints() const
+{
+    if (codePointsValid)
+    {
+        return lineCodePoints;
+    }
+
+    lineCodePoints.clear();
+    codePointsValid = true;
+    if (!pBuffer)
+    {
+        return lineCodePoints;
+    }
+
+    const auto& textBuffer = pBuffer->GetWorkingBuffer();
+    auto ch = lineByteRange.first;
+    while (ch < lineByteRange.second)
+    {
+        LineCharInfo info;
+
+        // Important note: We can't navigate the text buffer by pointers!
+        // The gap buffer will get in the way; so need to be careful to use [] or an iterator
+        // GetCharSize is cached for speed on debug builds.
+        info.iterator = GlyphIterator(pBuffer, ch);
+        info.size = pFont->GetCharSize(&textBuffer[ch]);
+        lineCodePoints.push_back(info);
+        ch += utf8_codepoint_length(textBuffer[ch]);
+    }
+
+    return lineCodePoints;
+}
+
 ZepWindow::~ZepWindow()
 {
     std::for_each(m_windowLines.begin(), m_windowLines.end(), [](SpanInfo* pInfo) { delete pInfo; });
@@ -734,43 +766,27 @@ void ZepWindow::UpdateLineSpans()
         m_windowLines.push_back(lineInfo);
     }
 
-    // Now build the codepoint offsets
+    // The codepoint offsets are built on demand, see SpanInfo::CodePoints
     for (auto& line : m_windowLines)
     {
-        auto ch = line->lineByteRange.first;
-
-        // TODO: Optimize
-        line->lineCodePoints.clear();
-        uint32_t points = 0;
-        while (ch < line->lineByteRange.second)
-        {
-            LineCharInfo info;
-
-            // Important note: We can't navigate the text buffer by pointers!
-            // The gap buffer will get in the way; so need to be careful to use [] or an iterator
-            // GetCharSize is cached for speed on debug builds.
-            info.iterator = GlyphIterator(m_pBuffer, ch);
-            info.size = line->pFont->GetCharSize(&textBuffer[ch]);
-            line->lineCodePoints.push_back(info);
-            ch += utf8_codepoint_length(textBuffer[ch]);
-            points++;
-        }
+        line->pBuffer = m_pBuffer;
+        line->InvalidateCodePoints();
     }
 
     if (ZTestFlags(GetWindowFlags(), WindowFlags::HideTrailingNewline)
         && !m_windowLines.empty())
     {
         SpanInfo* lastLine = m_windowLines.back();
-        if (lastLine->lineCodePoints.size() == 1)
+        if (lastLine->CodePoints().size() == 1)
         {
-            uint8_t ch = lastLine->lineCodePoints[0].iterator.Char();
+            uint8_t ch = lastLine->CodePoints()[0].iterator.Char();
             if (ch == '\n')
             {
                 delete lastLine;
                 m_windowLines.pop_back();
             }
         }
-        else if (lastLine->lineCodePoints.empty())
+        else if (lastLine->CodePoints().empty())
         {
             delete lastLine;
             m_windowLines.pop_back();
@@ -1011,7 +1027,7 @@ void ZepWindow::DisplayLineBackground(SpanInfo& lineInfo, ZepSyntax* pSyntax)
     }
 
     // Walk from the start of the line to the end of the line (in buffer chars)
-    for (auto& cp : lineInfo.lineCodePoints)
+    for (auto& cp : lineInfo.CodePoints())
     {
         NRectf charRect(NVec2f(screenPosX, ToWindowY(lineInfo.yOffsetPx)), NVec2f(screenPosX + cp.size.x, ToWindowY(lineInfo.yOffsetPx + lineInfo.FullLineHeightPx())));
 
@@ -1264,7 +1280,7 @@ bool ZepWindow::DisplayLine(SpanInfo& lineInfo, int displayPass, GlyphIterator*
     bool lineStart = true;
 
     // Walk from the start of the line to the end of the line (in buffer chars)
-    for (const auto& cp : lineInfo.lineCodePoints)
+    for (const auto& cp : lineInfo.CodePoints())
     {
         const uint8_t* pCh;
         const uint8_t* pEnd;
@@ -1650,7 +1666,7 @@ void ZepWindow::GetCursorInfo(NVec2f& pos, NVec2f& size)
     float xPos = m_textRegion->rect.topLeftPx.x + m_xPad;
 
     int count = 0;
-    for (auto& ch : cursorBufferLine.lineCodePoints)
+    for (auto& ch : cursorBufferLine.CodePoints())
     {
         if (count == cursorCL.x)
         {
@@ -1759,9 +1775,9 @@ void ZepWindow::DisplayGridMarkers()
     {
         auto& lineInfo = *m_windowLines[windowLine];
         auto pos = m_textRegion->rect.topLeftPx + NVec2f(m_xPad, 0.0f);
-        for (int i = 0; i < lineInfo.lineCodePoints.size(); i++)
+        for (int i = 0; i < lineInfo.CodePoints().size(); i++)
         {
-            auto cp = lineInfo.lineCodePoints[i];
+            auto cp = lineInfo.CodePoints()[i];
 
             if (i != 0 && i % 8 == 0)
             {
@@ -2089,7 +2105,7 @@ void ZepWindow::MoveCursorY(int yDistance, LineLocation clampLocation)
     target.y = std::min(target.y, long(m_windowLines.size() - 1));
 
     auto* line = m_windowLines[target.y];
-    if (line->lineCodePoints.empty())
+    if (line->CodePoints().empty())
         line = m_windowLines[target.y - 1];
 
     // Snap to the new vertical column if necessary (see comment below)
@@ -2099,7 +2115,7 @@ void ZepWindow::MoveCursorY(int yDistance, LineLocation clampLocation)
     GlyphIterator cursorItr;
 
     // TODO; this was an assert
-    /*if (line.lineCodePoints.empty())
+    /*if (line.CodePoints().empty())
     {
         target.x = 0;
         cursorItr = GetBufferCursor().PeekByteOffset(line.lineByteRange.first);
@@ -2107,10 +2123,10 @@ void ZepWindow::MoveCursorY(int yDistance, LineLocation clampLocation)
     else*/
     {
         // Move to the same codepoint offset on the line below
-        target.x = std::min(target.x, long(line->lineCodePoints.size() - 1));
+        target.x = std::min(target.x, long(line->CodePoints().size() - 1));
         target.x = std::max(target.x, long(0));
 
-        cursorItr = line->lineCodePoints[target.x].iterator;
+        cursorItr = line->CodePoints()[target.x].iterator;
     }
 
     // We can't call the buffer's LineLocation code, because when moving in span lines,
@@ -2157,19 +2173,22 @@ NVec2i ZepWindow::BufferToDisplay(const GlyphIterator& loc)
     UpdateLayout();
 
     NVec2i ret(0, 0);
-    int line_number = 0;
 
-    // TODO: Performance; quick lookup for line
-    for (auto& line : m_windowLines)
+    // The lines are in buffer order, so find the last one starting at or before the location
+    auto itrLine = std::upper_bound(m_windowLines.begin(), m_windowLines.end(), loc.Index(),
+        [](ByteIndex index, const SpanInfo* pLine) { return index < pLine->lineByteRange.first; });
+    if (itrLine != m_windowLines.begin())
     {
+        auto& line = *(itrLine - 1);
+
         // If inside the line...
         if (line->lineByteRange.ContainsLocation(loc.Index()))
         {
-            ret.y = line_number;
+            ret.y = long(itrLine - 1 - m_windowLines.begin());
             ret.x = 0;
 
             // Scan the code points for where we are
-            for (auto& ch : line->lineCodePoints)
+            for (auto& ch : line->CodePoints())
             {
                 if (ch.iterator == loc)
                 {
@@ -2178,7 +2197,6 @@ NVec2i ZepWindow::BufferToDisplay(const GlyphIterator& loc)
                 ret.x++;
             }
         }
-        line_number++;
     }
 
     assert(!m_windowLines.empty());
@@ -2189,7 +2207,7 @@ NVec2i ZepWindow::BufferToDisplay(const GlyphIterator& loc)
 
     // Max Last line, last code point offset
     ret.y = long(m_windowLines.size() - 1);
-    ret.x = long(m_windowLines[m_windowLines.size() - 1]->lineCodePoints.size() - 1);
+    ret.x = long(m_windowLines[m_windowLines.size() - 1]->CodePoints().size() - 1);
     return ret;
 }
 
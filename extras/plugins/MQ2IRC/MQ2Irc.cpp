@@ -19,8 +19,11 @@
 
 #include <mq/Plugin.h>
 
+#include <atomic>
+#include <deque>
 #include <list>
 #include <mutex>
+#include <string>
 
 #pragma comment(lib,"wsock32.lib")
 
@@ -55,7 +58,6 @@ char UseTimeStamp[MAX_STRING] = {0};
 char strTimeBuffer[MAX_STRING] = {0};
 char szTemp[MAX_STRING] = {0};
 char strDefault[MAX_STRING] = {0};
-std::recursive_mutex s_mutex;
 
 int maxLength;
 TIMESTAMP* pTimestamp = nullptr;
@@ -65,19 +67,241 @@ WORD sockVersion;
 WSADATA wsaData;
 int nret;
 LPHOSTENT hostEntry;
-SOCKET theSocket;
-char* ireadbuf = new char[512];
+SOCKET theSocket = INVALID_SOCKET;
 char buff[512];
 std::list<char*> channels;
 std::list<char*>::iterator mychan;
 void* pchan = nullptr;
 int IRCChatColor = USERCOLOR_DEFAULT;
-bool bConnecting = false;
-bool bTriedConnect = false;
-bool bConnected = false;
+std::atomic<bool> bConnecting = false;
+std::atomic<bool> bTriedConnect = false;
+std::atomic<bool> bConnected = false;
+std::atomic<bool> bLostConnection = false;
 SOCKADDR_IN serverInfo;
 void ircout(char* text);
 
+//----------------------------------------------------------------------------
+// Network thread
+//
+// All socket I/O happens on a background thread. Outgoing lines are queued from the
+// main thread and paced with a token bucket so relaying a busy channel doesn't trip
+// the server's flood protection. Commands always go out ahead of chat, and chat that
+// is waiting on the same target gets joined into fewer lines. Incoming data is split
+// into lines on the thread (PINGs are answered there) and parsed on the next pulse.
+
+constexpr size_t IRC_MAX_MESSAGE = 400;        // leaves room for the prefix the server adds
+constexpr size_t IRC_MAX_QUEUED_MESSAGES = 256; // oldest chat is dropped past this
+constexpr size_t IRC_MAX_LINE = 510;
+constexpr int IRC_MAX_LINES_PER_PULSE = 20;
+
+struct IrcMessage
+{
+	std::string Target;
+	std::string Text;
+};
+
+std::mutex s_queueMutex;
+std::deque<std::string> s_outgoingCommands;
+std::deque<IrcMessage> s_outgoingMessages;
+std::deque<std::string> s_incomingLines;
+std::atomic<bool> bStopNetworkThread = false;
+HANDLE hNetworkThread = nullptr;
+int IrcSendBurst = 5;
+int IrcSendDelay = 2000;
+
+// Queue a protocol command. These are sent before any queued chat.
+void IrcSendCommand(std::string_view line)
+{
+	std::scoped_lock lock(s_queueMutex);
+	s_outgoingCommands.emplace_back(line);
+}
+
+// Queue a PRIVMSG. If we are being rate limited these may be combined with the
+// messages queued after them for the same target.
+void IrcSendMessage(const char* target, const char* text)
+{
+	std::scoped_lock lock(s_queueMutex);
+
+	if (s_outgoingMessages.size() >= IRC_MAX_QUEUED_MESSAGES)
+		s_outgoingMessages.pop_front();
+
+	s_outgoingMessages.push_back({ target, text });
+}
+
+static std::string NextOutgoingLine()
+{
+	std::scoped_lock lock(s_queueMutex);
+
+	if (!s_outgoingCommands.empty())
+	{
+		std::string line = std::move(s_outgoingCommands.front());
+		s_outgoingCommands.pop_front();
+		return line;
+	}
+
+	if (s_outgoingMessages.empty())
+		return {};
+
+	IrcMessage message = std::move(s_outgoingMessages.front());
+	s_outgoingMessages.pop_front();
+
+	while (!s_outgoingMessages.empty()
+		&& ci_equals(s_outgoingMessages.front().Target, message.Target)
+		&& message.Text.size() + 3 + s_outgoingMessages.front().Text.size() <= IRC_MAX_MESSAGE)
+	{
+		message.Text.append(" | ");
+		message.Text.append(s_outgoingMessages.front().Text);
+		s_outgoingMessages.pop_front();
+	}
+
+	return fmt::format("PRIVMSG {} :{}", message.Target, message.Text);
+}
+
+static bool HasOutgoingCommands()
+{
+	std::scoped_lock lock(s_queueMutex);
+	return !s_outgoingCommands.empty();
+}
+
+DWORD WINAPI IRCNetworkThread(void* lpParam)
+{
+	nret = connect(theSocket, (LPSOCKADDR)& serverInfo, sizeof(struct sockaddr));
+	if (nret == SOCKET_ERROR)
+	{
+		if (!bStopNetworkThread)
+			closesocket(theSocket);
+		theSocket = INVALID_SOCKET;
+
+		bConnected = false;
+		bTriedConnect = true;
+		bConnecting = false;
+		return 0;
+	}
+
+	unsigned long nonblocking = 1;
+	ioctlsocket(theSocket, FIONBIO, &nonblocking);
+
+	IrcSendCommand(fmt::format("NICK {}", IrcNick));
+	IrcSendCommand(fmt::format("USER {} {} {} :{}", Username, IrcNick, IrcNick, Realname));
+	IrcSendCommand(fmt::format("JOIN {}", IrcChan));
+
+	bConnected = true;
+	bTriedConnect = true;
+	bConnecting = false;
+
+	double tokens = IrcSendBurst;
+	ULONGLONG lastRefill = GetTickCount64();
+	std::string incoming;
+	std::string outgoing;
+	char chunk[4096];
+	bool lost = false;
+
+	while (!bStopNetworkThread && !lost)
+	{
+		ULONGLONG now = GetTickCount64();
+		tokens = std::min<double>(IrcSendBurst, tokens + static_cast<double>(now - lastRefill) / IrcSendDelay);
+		lastRefill = now;
+
+		// Send whatever the bucket allows. A line the socket only partly took is
+		// finished before anything else goes out.
+		while (true)
+		{
+			if (outgoing.empty())
+			{
+				if (tokens < 1)
+					break;
+
+				outgoing = NextOutgoingLine();
+				if (outgoing.empty())
+					break;
+
+				outgoing.append("\r\n");
+				tokens -= 1;
+			}
+
+			int sent = send(theSocket, outgoing.data(), static_cast<int>(outgoing.size()), 0);
+			if (sent == SOCKET_ERROR)
+			{
+				if (WSAGetLastError() != WSAEWOULDBLOCK)
+					lost = true;
+				break;
+			}
+
+			outgoing.erase(0, sent);
+		}
+
+		// After /i quit we only stay around long enough to send the QUIT.
+		if (!bConnected && outgoing.empty() && !HasOutgoingCommands())
+			break;
+
+		while (true)
+		{
+			int received = recv(theSocket, chunk, sizeof(chunk), 0);
+			if (received > 0)
+			{
+				incoming.append(chunk, received);
+				continue;
+			}
+
+			if (received == 0 || WSAGetLastError() != WSAEWOULDBLOCK)
+				lost = true;
+			break;
+		}
+
+		size_t start = 0;
+		for (size_t eol = incoming.find('\n'); eol != std::string::npos; eol = incoming.find('\n', start))
+		{
+			std::string_view line(incoming.data() + start, std::min(eol - start, IRC_MAX_LINE));
+			start = eol + 1;
+
+			if (starts_with(line, "PING "))
+			{
+				std::string_view token = line.substr(5);
+				if (!token.empty() && token.back() == '\r')
+					token.remove_suffix(1);
+
+				IrcSendCommand(fmt::format("PONG {}", token));
+				continue;
+			}
+
+			std::scoped_lock lock(s_queueMutex);
+			s_incomingLines.emplace_back(line);
+		}
+		incoming.erase(0, start);
+
+		// a line this long without a newline isn't IRC
+		if (incoming.size() > sizeof(chunk))
+			incoming.clear();
+
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(theSocket, &readSet);
+
+		fd_set writeSet;
+		FD_ZERO(&writeSet);
+		if (!outgoing.empty())
+			FD_SET(theSocket, &writeSet);
+
+		timeval timeout = { 0, 50 * 1000 };
+		select(0, &readSet, &writeSet, nullptr, &timeout);
+	}
+
+	closesocket(theSocket);
+	theSocket = INVALID_SOCKET;
+
+	{
+		std::scoped_lock lock(s_queueMutex);
+		s_outgoingCommands.clear();
+		s_outgoingMessages.clear();
+	}
+
+	if (lost && bConnected)
+		bLostConnection = true;
+	bConnected = false;
+
+	return 0;
+}
+
 class CIRCWnd : public CCustomWnd
 {
 public:
@@ -105,8 +329,7 @@ public:
 					}
 					else
 					{
-						sprintf_s(buff, "PRIVMSG %s :%s\n\0", *mychan, InputBox->InputText.c_str());
-						send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+						IrcSendMessage(*mychan, InputBox->InputText.c_str());
 						sprintf_s(buff, "\ag<\aw%s\ag>\a-w %s\0", IrcNick, InputBox->InputText.c_str());
 						ircout(buff);
 					}
@@ -167,37 +390,6 @@ void ircout(char* text)
 	}
 }
 
-DWORD WINAPI IRCConnectThread(void* lpParam)
-{
-	std::scoped_lock lock(s_mutex);
-
-	bConnecting = true;
-	nret = connect(theSocket, (LPSOCKADDR)& serverInfo, sizeof(struct sockaddr));
-	if (nret == SOCKET_ERROR)
-	{
-		bConnected = false;
-	}
-	else
-	{
-		unsigned long nonblocking = 1;
-		ioctlsocket(theSocket, FIONBIO, &nonblocking);
-		Sleep((clock_t)2 * CLOCKS_PER_SEC / 2);
-
-		sprintf_s(buff, "NICK %s\n\0", IrcNick);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
-		sprintf_s(buff, "USER %s %s %s :%s\n\0", Username, IrcNick, IrcNick, Realname);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
-		sprintf_s(buff, "JOIN %s\n\0", IrcChan);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
-		bConnected = true;
-	}
-
-	bTriedConnect = true;
-	bConnecting = false;
-
-	return 0;
-}
-
 void TimeStampCmd(SPAWNINFO* pChar, char* szLine)
 {
 	// Get first arg and check command
@@ -247,6 +439,14 @@ void IrcConnectCmd(SPAWNINFO* pChar, char* szLine)
 		return;
 	}
 
+	if (hNetworkThread)
+	{
+		// after a quit the previous thread may still be sending the QUIT
+		WaitForSingleObject(hNetworkThread, INFINITE);
+		CloseHandle(hNetworkThread);
+		hNetworkThread = nullptr;
+	}
+
 	char Arg1[MAX_STRING] = { 0 };
 	char Arg2[MAX_STRING] = { 0 };
 	char Arg3[MAX_STRING] = { 0 };
@@ -330,9 +530,15 @@ void IrcConnectCmd(SPAWNINFO* pChar, char* szLine)
 	serverInfo.sin_family = AF_INET;
 	serverInfo.sin_addr = *((LPIN_ADDR)* hostEntry->h_addr_list);
 	serverInfo.sin_port = htons(IrcPort);
-	DWORD ThreadId;
-	CreateThread(NULL, 0, &IRCConnectThread, 0, 0, &ThreadId);
-	return;
+
+	bConnecting = true;
+	bStopNetworkThread = false;
+	{
+		std::scoped_lock lock(s_queueMutex);
+		s_incomingLines.clear();
+	}
+
+	hNetworkThread = CreateThread(nullptr, 0, &IRCNetworkThread, nullptr, 0, nullptr);
 }
 
 void IrcCmd(SPAWNINFO* pChar, char* szLine)
@@ -374,8 +580,8 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "NICK"))
 	{
-		sprintf_s(buff, "NICK %s\n\0", z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "NICK %s", z[1]);
+		IrcSendCommand(buff);
 		WritePrivateProfileString("Last Connect", "Nick", IrcNick, INIFileName);
 		WritePrivateProfileString(IrcServer, "Nick", IrcNick, INIFileName);
 		return;
@@ -383,8 +589,8 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "JOIN"))
 	{
-		sprintf_s(buff, "JOIN %s\n\0", z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "JOIN %s", z[1]);
+		IrcSendCommand(buff);
 		WritePrivateProfileString("Last Connect", "Chan", IrcChan, INIFileName);
 		WritePrivateProfileString(IrcServer, "Chan", IrcChan, INIFileName);
 		return;
@@ -392,15 +598,15 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "PART"))
 	{
-		sprintf_s(buff, "PART %s\n\0", *mychan);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "PART %s", *mychan);
+		IrcSendCommand(buff);
 		return;
 	}
 
 	if (!strcmp(szArg1, "WHOIS"))
 	{
-		sprintf_s(buff, "WHOIS %s\n\0", z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "WHOIS %s", z[1]);
+		IrcSendCommand(buff);
 		return;
 	}
 
@@ -413,8 +619,8 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "QUIT"))
 	{
-		sprintf_s(buff, "QUIT :%s\n\0", z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "QUIT :%s", z[1]);
+		IrcSendCommand(buff);
 		bConnected = false;
 		ircout("\ar#\ax Connection Closed, you can unload MQ2Irc now.");
 		return;
@@ -422,8 +628,8 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "RAW"))
 	{
-		sprintf_s(buff, "%s\n\0", z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "%s", z[1]);
+		IrcSendCommand(buff);
 		sprintf_s(buff, "\ab[\a-yraw\ab(\ay%s\ab)]\a-w %s\0", IrcServer, z[1]);
 		ircout(buff);
 		return;
@@ -437,8 +643,7 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 			return;
 		}
 
-		sprintf_s(buff, "PRIVMSG %s :%s\n\0", *mychan, z[1]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		IrcSendMessage(*mychan, z[1]);
 		sprintf_s(buff, "\ag<\aw%s\ag>\a-w %s\0", IrcNick, z[1]);
 		ircout(buff);
 		return;
@@ -446,8 +651,8 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 
 	if (!strcmp(szArg1, "NAMES"))
 	{
-		sprintf_s(buff, "NAMES %s\n\0", IrcChan);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "NAMES %s", IrcChan);
+		IrcSendCommand(buff);
 		return;
 	}
 
@@ -481,8 +686,7 @@ void IrcCmd(SPAWNINFO* pChar, char* szLine)
 			}
 		}
 		// FIXME:  z[2] is out of bounds (probably wrong above too).
-		sprintf_s(buff, "PRIVMSG %s :%s\n\0", z[1], z[2]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		IrcSendMessage(z[1], z[2]);
 		sprintf_s(buff, "\ab[\a-rmsg\ab(\ar%s\ab)]\a-w %s\0", z[1], z[2]);
 		ircout(buff);
 		return;
@@ -582,8 +786,8 @@ char* parse(char* rawmsg)
 
 	if (!strcmp(command, "PING"))
 	{
-		sprintf_s(buff, "PONG %s\n\0", param[0]);
-		send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+		sprintf_s(buff, "PONG %s", param[0]);
+		IrcSendCommand(buff);
 
 		return nullptr;
 	}
@@ -686,8 +890,8 @@ char* parse(char* rawmsg)
 		param[1][strlen(param[1]) - 1] = '\0';
 		if (!strcmp(param[1], "\001VERSION\001"))
 		{
-			sprintf_s(buff, "NOTICE %s :\001VERSION %s\001\n\0", prefix, Version);
-			send(theSocket, buff, static_cast<int>(strlen(buff)), 0);
+			sprintf_s(buff, "NOTICE %s :\001VERSION %s\001", prefix, Version);
+			IrcSendCommand(buff);
 			sprintf_s(buff, "\ab[\ao%s\ab(\a-octcp\ab)]\a-w VERSION", prefix);
 			return buff;
 		}
@@ -986,6 +1190,8 @@ PLUGIN_API void InitializePlugin()
 	GetPrivateProfileString("Settings", "Realname", "mq2irc", Realname, MAX_STRING, INIFileName);
 	GetPrivateProfileString("Settings", "UseWnd", "No", UseWnd, MAX_STRING, INIFileName);
 	GetPrivateProfileString("Settings", "USeTimeStamp", "No", UseTimeStamp, MAX_STRING, INIFileName);
+	IrcSendBurst = std::max(1, GetPrivateProfileInt("Settings", "SendBurst", 5, INIFileName));
+	IrcSendDelay = std::max(1, GetPrivateProfileInt("Settings", "SendDelay", 2000, INIFileName));
 
 	irctop = GetPrivateProfileInt("Settings", "ChatTop", 0, INIFileName);
 	ircbottom = GetPrivateProfileInt("Settings", "ChatBottom", 210, INIFileName);
@@ -997,6 +1203,8 @@ PLUGIN_API void InitializePlugin()
 	WritePrivateProfileString("Settings", "Realname", Realname, INIFileName);
 	WritePrivateProfileString("Settings", "UseWnd", UseWnd, INIFileName);
 	WritePrivateProfileString("Settings", "UseTimeStamp", UseTimeStamp, INIFileName);
+	WritePrivateProfileString("Settings", "SendBurst", std::to_string(IrcSendBurst), INIFileName);
+	WritePrivateProfileString("Settings", "SendDelay", std::to_string(IrcSendDelay), INIFileName);
 
 	WritePrivateProfileString("Settings", "ChatTop", std::to_string(irctop), INIFileName);
 	WritePrivateProfileString("Settings", "ChatBottom", std::to_string(ircbottom), INIFileName);
@@ -1023,7 +1231,18 @@ PLUGIN_API void ShutdownPlugin()
 	RemoveCommand("/itimestamp");
 	RemoveMQ2Data("Irc");
 
-	// todo: wait to ensure we aren't trying to connect
+	// Stop the network thread before our code goes away. Closing the socket aborts a
+	// connect that is still pending.
+	if (hNetworkThread)
+	{
+		bStopNetworkThread = true;
+		if (bConnecting)
+			closesocket(theSocket);
+
+		WaitForSingleObject(hNetworkThread, INFINITE);
+		CloseHandle(hNetworkThread);
+		hNetworkThread = nullptr;
+	}
 
 	delete pIrcType;
 }
@@ -1043,24 +1262,27 @@ PLUGIN_API void OnPulse()
 		}
 	}
 
-	// Fill the input buffer with new data, if any.
+	if (bLostConnection.exchange(false))
+	{
+		ircout("\ar#\ax Connection lost.");
+	}
 
-	for (int i = 0; i < 512; i++)
+	// Parse what the network thread received, a bounded amount per pulse.
+	for (int i = 0; i < IRC_MAX_LINES_PER_PULSE; i++)
 	{
-		int err = recv(theSocket, &ireadbuf[i], 1, 0);
-		if ((ireadbuf[i] == '\n') || (err == 0) || (err == SOCKET_ERROR))
+		std::string line;
 		{
-			if (ireadbuf[i] == '\n')
-			{
-				ireadbuf[i] = '\0';
-				char* message;
-				if ((message = parse(ireadbuf)) != nullptr)
-				{
-					ircout(message);
-				}
-			}
+			std::scoped_lock lock(s_queueMutex);
+			if (s_incomingLines.empty())
+				break;
 
-			break;
+			line = std::move(s_incomingLines.front());
+			s_incomingLines.pop_front();
+		}
+
+		if (char* message = parse(line.data()))
+		{
+			ircout(message);
 		}
 	}
 }
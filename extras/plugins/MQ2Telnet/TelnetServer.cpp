@@ -24,6 +24,8 @@
 #include "TelnetServer.h"
 
 #include <mutex>
+#include <string>
+#include <vector>
 
 #pragma comment(lib, "ws2_32")
 
@@ -37,7 +39,9 @@ SOCKET Listener;
 bool bListening;
 bool bKillThread;
 bool bThreading;
-TXTBUFFER* Sends = nullptr;
+std::vector<std::string> Sends;
+int DroppedSends = 0;
+HANDLE hWakeEvent = nullptr;
 TXTBUFFER* Commands = 0;
 bool LocalOnly = true;
 bool ANSI = true;
@@ -46,6 +50,61 @@ char TelnetPasswordPrompt[MAX_STRING] = { 0 };
 char TelnetWelcome[MAX_STRING] = { 0 };
 extern int PortUsed;
 
+// Queue text for a connection. Nothing here touches the socket, so a client that
+// isn't reading only ever fills its own buffer; once that is full further lines are
+// dropped and the client is told how many it missed when there is room again.
+static void QueueOutput(TELNET* Conn, std::string_view text)
+{
+	if (Conn->Output.size() + text.size() > TELNET_MAX_OUTPUT)
+	{
+		++Conn->DroppedLines;
+		return;
+	}
+
+	if (Conn->DroppedLines)
+	{
+		char szNotice[64];
+		int length = sprintf_s(szNotice, "[MQ2Telnet: %d lines dropped]\r\n", Conn->DroppedLines);
+		if (Conn->Output.size() + text.size() + length > TELNET_MAX_OUTPUT)
+		{
+			++Conn->DroppedLines;
+			return;
+		}
+
+		Conn->Output.append(szNotice, length);
+		Conn->DroppedLines = 0;
+	}
+
+	Conn->Output.append(text);
+}
+
+// Write as much pending output as the socket will take without blocking. Whatever
+// doesn't fit stays queued for the next pass. A hard error closes the connection,
+// which gets it cleaned up on the next pass.
+static void FlushOutput(TELNET* Conn)
+{
+	size_t written = 0;
+	while (written < Conn->Output.size())
+	{
+		int length = static_cast<int>(std::min<size_t>(Conn->Output.size() - written, TELNET_MAX_OUTPUT));
+		int sent = send(Conn->connection->m_Socket, Conn->Output.data() + written, length, 0);
+		if (sent == SOCKET_ERROR)
+		{
+			if (WSAGetLastError() != WSAEWOULDBLOCK)
+			{
+				Conn->connection->Close();
+				Conn->Output.clear();
+				return;
+			}
+			break;
+		}
+
+		written += sent;
+	}
+
+	Conn->Output.erase(0, written);
+}
+
 DWORD WINAPI ProcessingThread(void* lpParam)
 {
 	std::scoped_lock lock(s_processingMutex);
@@ -84,7 +143,6 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 				std::scoped_lock lock(s_listMutex);
 
 				TELNET* NewConn = new TELNET;
-				memset(NewConn, 0, sizeof(TELNET));
 
 				CWinTelnet* telnet = new CWinTelnet;
 				telnet->m_Socket = incoming;
@@ -100,22 +158,24 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 			}
 		}
 
-			// process sends
-		std::unique_lock lock(s_bufferMutex);
+		// process sends. Take everything the game thread queued in one swap so it
+		// never waits on us for longer than that.
+		std::vector<std::string> Pending;
+		int Dropped = 0;
+		{
+			std::scoped_lock lock(s_bufferMutex);
+			Pending.swap(Sends);
+			Sends.reserve(Pending.size());
+			Dropped = std::exchange(DroppedSends, 0);
+		}
 
-		TELNET* Conn = Connections;
-		char szText[MAX_STRING * 25] = { 0 };
-		TXTBUFFER* pBuff = Sends;
-		while (pBuff)
+		std::string DropNotice;
+		if (Dropped)
 		{
-			TXTBUFFER* NextChat = pBuff->pNext;
-			strcat_s(szText, pBuff->szText);
-			strcat_s(szText, "\r\n");
-			free(pBuff);
-			pBuff = NextChat;
+			DropNotice = fmt::format("[MQ2Telnet: {} lines dropped]\r\n", Dropped);
 		}
-		Sends = nullptr;
-		lock.unlock();
+
+		TELNET* Conn = Connections;
 
 		std::scoped_lock lock2(s_listMutex);
 		while (Conn)
@@ -146,17 +206,25 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 			switch (Conn->State)
 			{
 			case TS_MAININPUT:
-				Conn->connection->WriteStr(szText);
+				if (!DropNotice.empty())
+					QueueOutput(Conn, DropNotice);
+				for (const std::string& Line : Pending)
+				{
+					QueueOutput(Conn, Line);
+				}
 				break;
 			case TS_SENDLOGIN:
-				Conn->connection->WriteStr(TelnetLoginPrompt);
+				QueueOutput(Conn, TelnetLoginPrompt);
 				Conn->State = TS_GETLOGIN;
 				break;
 			case TS_SENDPASSWORD:
-				Conn->connection->WriteStr(TelnetPasswordPrompt);
+				QueueOutput(Conn, TelnetPasswordPrompt);
 				Conn->State = TS_GETPASSWORD;
 				break;
 			}
+
+			// one write per connection per pass, however many lines came in
+			FlushOutput(Conn);
 			Conn = Conn->pNext;
 		}
 
@@ -244,7 +312,7 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 					}
 					else
 					{
-						Conn->connection->WriteStr("invalid\r\n");
+						QueueOutput(Conn, "invalid\r\n");
 						Conn->State = TS_SENDLOGIN;
 					}
 				}
@@ -253,16 +321,17 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 					// process password
 					if (!strcmp(Conn->Password, Conn->Received->szText))
 					{
-						Conn->connection->WriteStr(TelnetWelcome);
-						Conn->connection->WriteStr("\r\n");
+						QueueOutput(Conn, TelnetWelcome);
+						QueueOutput(Conn, "\r\n");
 						Conn->State = TS_MAININPUT;
 					}
 					else
 					{
-						Conn->connection->WriteStr("invalid\r\n");
+						QueueOutput(Conn, "invalid\r\n");
 						if (++Conn->PasswordTries >= 3)
 						{
-							Conn->connection->WriteStr("3 strikes, you're out. later.\r\n");
+							QueueOutput(Conn, "3 strikes, you're out. later.\r\n");
+							FlushOutput(Conn);
 							Conn->connection->Disconnect();
 						}
 						Conn->State = TS_SENDPASSWORD;
@@ -281,7 +350,8 @@ DWORD WINAPI ProcessingThread(void* lpParam)
 			Conn = Conn->pNext;
 		}
 
-		Sleep(10);
+		// wake early when there is something to send
+		WaitForSingleObject(hWakeEvent, 10);
 	}
 
 	DebugSpew("MQ2Telnet processing thread ending");
@@ -294,13 +364,15 @@ CTelnetServer::CTelnetServer()
 	WSADATA wsa;
 	WSAStartup(MAKEWORD(2, 0), &wsa);
 
-	Sends = nullptr;
+	Sends.clear();
+	DroppedSends = 0;
 	Commands = nullptr;
 	Connections = nullptr;
 	bListening = false;
 	bKillThread = false;
 	LocalOnly = false;
 	bThreading = false;
+	hWakeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 
 	CreateThread(nullptr, 0, &ProcessingThread, this, 0, nullptr);
 }
@@ -356,25 +428,23 @@ bool CTelnetServer::Listen(int Port)
 
 void CTelnetServer::Broadcast(char* String)
 {
-	std::scoped_lock lock(s_bufferMutex);
-
-	TXTBUFFER* pChat = (TXTBUFFER*)malloc(sizeof(TXTBUFFER));
-
-	if (pChat)
+	// Called from the game thread: only queue the line, the processing thread does the
+	// formatting and the socket work. If it falls behind we drop rather than grow.
 	{
-		strcpy_s(pChat->szText, String);
-		pChat->pNext = nullptr;
-		if (!Sends)
-		{
-			Sends = pChat;
-		}
-		else
+		std::scoped_lock lock(s_bufferMutex);
+
+		if (Sends.size() >= TELNET_MAX_BROADCASTS)
 		{
-			TXTBUFFER* pCurrent;
-			for (pCurrent = Sends; pCurrent->pNext; pCurrent = pCurrent->pNext);
-			pCurrent->pNext = pChat;
+			++DroppedSends;
+			return;
 		}
+
+		std::string& Line = Sends.emplace_back(String);
+		Line.append("\r\n");
 	}
+
+	if (hWakeEvent)
+		SetEvent(hWakeEvent);
 }
 
 void CTelnetServer::Shutdown()
@@ -404,11 +474,16 @@ void CTelnetServer::Shutdown()
 	}
 
 	// delete all extra shit
-	while (Sends)
 	{
-		TXTBUFFER* pNext = Sends->pNext;
-		free(Sends);
-		Sends = pNext;
+		std::scoped_lock lock2(s_bufferMutex);
+		Sends.clear();
+		DroppedSends = 0;
+	}
+
+	if (hWakeEvent)
+	{
+		CloseHandle(hWakeEvent);
+		hWakeEvent = nullptr;
 	}
 
 	while (Commands)
@@ -16,6 +16,8 @@
 
 #include "WinTelnet.h"
 
+#include <string>
+
 #define TS_SENDLOGIN    0
 #define TS_GETLOGIN     1
 #define TS_SENDPASSWORD 2
@@ -35,17 +37,29 @@ struct TXTBUFFER
 	TXTBUFFER* pNext;
 };
 
+// Output waiting to be written to a single connection. Bounded so that a client
+// that stops reading costs us at most this much memory before lines are dropped.
+constexpr size_t TELNET_MAX_OUTPUT = 64 * 1024;
+
+// Lines queued by the game thread that the processing thread hasn't picked up yet.
+constexpr size_t TELNET_MAX_BROADCASTS = 4096;
+
 struct TELNET
 {
-	CWinTelnet* connection;
-	int State;
-	char Username[32];
-	char Password[32];
-	int PasswordTries;
-	char Buffer[MAX_STRING];
-	TXTBUFFER* Received;
-	TELNET* pLast;
-	TELNET* pNext;
+	CWinTelnet* connection = nullptr;
+	int State = TS_SENDLOGIN;
+	char Username[32] = { 0 };
+	char Password[32] = { 0 };
+	int PasswordTries = 0;
+	char Buffer[MAX_STRING] = { 0 };
+	TXTBUFFER* Received = nullptr;
+
+	std::string Output;              // pending bytes, written from OutputOffset onward
+	size_t OutputOffset = 0;
+	int DroppedLines = 0;            // lines discarded since the last overflow notice
+
+	TELNET* pLast = nullptr;
+	TELNET* pNext = nullptr;
 };
 
 class CTelnetServer
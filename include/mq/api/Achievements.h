@@ -22,6 +22,9 @@ namespace mq {
 // Look up an achievement by name.
 MQLIB_API const eqlib::Achievement* GetAchievementByName(std::string_view name);
 
+// Look up the index of an achievement by name. Returns -1 if there is no such achievement.
+MQLIB_API int GetAchievementIndexByName(std::string_view name);
+
 // Look up an achievement by its id.
 MQLIB_API const eqlib::Achievement* GetAchievementById(int id);
 
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <chrono>
+
 namespace mq {
 
 class PipeMessage;
@@ -30,8 +32,14 @@ namespace postoffice {
 		NoConnection            = -2,                  // no connection established
 		RoutingFailed           = -3,                  // message routing failed
 		AmbiguousRecipient      = -4,                  // RPC message couldn't determine single recipient
+		MailboxFull             = -5,                  // recipient had too much mail waiting
+		Timeout                 = -6,                  // no response came before the deadline
+		Cancelled               = -7,                  // the sender gave up on the response (never sent)
 	};
 
+	/** How long a ResponseFuture waits for its response unless it's told otherwise */
+	constexpr std::chrono::milliseconds DEFAULT_RESPONSE_TIMEOUT = std::chrono::seconds(30);
+
 	/**
 	 * An address shim to be used to fill out the address on the envelope in the MQ post office.
 	 */
@@ -57,6 +65,12 @@ namespace postoffice {
 
 		/** Used to specify if the mailbox is fully qualified (default to false) */
 		bool AbsoluteMailbox = false;
+
+		/**
+		 * Set when sending state, like "hp". Waiting mail with the same key from the same sender is
+		 * replaced, so a busy recipient only handles the newest.
+		 */
+		std::optional<std::string> Key;
 	};
 
 	/**
@@ -79,6 +93,86 @@ namespace postoffice {
 	using ReceiveCallbackAPI = std::function<void(const std::shared_ptr<Message>&)>;
 	using ResponseCallbackAPI = std::function<void(int, const std::shared_ptr<Message>&)>;
 
+	/**
+	 * The eventual response to a message sent with PostAsync or SendToActorAsync. Responses are
+	 * delivered on the main thread, so rather than blocking on it, check it from there (every pulse,
+	 * or from a coroutine) until it is ready. Any number can be outstanding at once, to the same
+	 * actor or different ones.
+	 *
+	 * It is ready once the response arrives, the request fails (for instance because the connection
+	 * to the recipient closed), the deadline passes, or it is cancelled. Whatever comes after that is
+	 * ignored.
+	 */
+	class ResponseFuture
+	{
+	public:
+		ResponseFuture() = default;
+
+		explicit ResponseFuture(std::chrono::milliseconds timeout)
+			: m_state(std::make_shared<State>())
+		{
+			m_state->deadline = std::chrono::steady_clock::now() + timeout;
+		}
+
+		/** False for a default constructed future, which will never be ready */
+		bool IsValid() const { return m_state != nullptr; }
+
+		bool IsReady() const
+		{
+			if (m_state == nullptr)
+				return false;
+
+			if (!m_state->ready && std::chrono::steady_clock::now() >= m_state->deadline)
+				m_state->Resolve(static_cast<int>(ResponseStatus::Timeout), nullptr);
+
+			return m_state->ready;
+		}
+
+		/** The status of the reply once ready: what the recipient replied with, or a ResponseStatus */
+		int GetStatus() const { return IsReady() ? m_state->status : 0; }
+
+		/** The reply once ready. Empty if the request failed. */
+		std::shared_ptr<Message> GetReply() const { return IsReady() ? m_state->message : nullptr; }
+
+		/** Stops waiting. The future becomes ready with ResponseStatus::Cancelled. */
+		void Cancel()
+		{
+			if (m_state != nullptr)
+				m_state->Resolve(static_cast<int>(ResponseStatus::Cancelled), nullptr);
+		}
+
+		/** The callback to send with the request, which fills in this future */
+		ResponseCallbackAPI GetCallback() const
+		{
+			return [state = m_state](int status, const std::shared_ptr<Message>& message)
+				{
+					if (state != nullptr)
+						state->Resolve(status, message);
+				};
+		}
+
+	private:
+		struct State
+		{
+			bool ready = false;
+			int status = 0;
+			std::shared_ptr<Message> message;
+			std::chrono::steady_clock::time_point deadline;
+
+			void Resolve(int status_, const std::shared_ptr<Message>& message_)
+			{
+				if (!ready)
+				{
+					ready = true;
+					status = status_;
+					message = message_;
+				}
+			}
+		};
+
+		std::shared_ptr<State> m_state;
+	};
+
 	/**
 	 * A dropbox shim used to store a reference to the actual dropbox and provide functions to interact with it
 	 */
@@ -112,6 +206,29 @@ namespace postoffice {
 		 */
 		void Post(const Address& address, const std::string& data, const ResponseCallbackAPI& callback = nullptr) const;
 
+		/**
+		 * Sends a message to an address and returns its response as a future
+		 *
+		 * @param address the address to send the message, which must name a single recipient
+		 * @param data the message (as a data string)
+		 * @param timeout how long to wait for the response
+		 * @return a future that is ready when the response arrives or the request fails
+		 */
+		ResponseFuture PostAsync(const Address& address, const std::string& data,
+			std::chrono::milliseconds timeout = DEFAULT_RESPONSE_TIMEOUT) const
+		{
+			ResponseFuture future(timeout);
+			Post(address, data, future.GetCallback());
+			return future;
+		}
+
+		template <typename T>
+		ResponseFuture PostAsync(const Address& address, const T& obj,
+			std::chrono::milliseconds timeout = DEFAULT_RESPONSE_TIMEOUT) const
+		{
+			return PostAsync(address, obj.SerializeAsString(), timeout);
+		}
+
 		/**
 		 * Sends a reply to the sender of a message
 		 *
@@ -183,6 +300,29 @@ void SendToActor(const Address& address, const T& obj, const ResponseCallbackAPI
  */
 void SendToActor(const Address& address, const std::string& data, const ResponseCallbackAPI& callback = nullptr);
 
+/**
+ * Sends a message to an address and returns its response as a future
+ *
+ * @param address the address to send the message, which must name a single recipient
+ * @param data the message (as a data string)
+ * @param timeout how long to wait for the response
+ * @return a future that is ready when the response arrives or the request fails
+ */
+inline ResponseFuture SendToActorAsync(const Address& address, const std::string& data,
+	std::chrono::milliseconds timeout = DEFAULT_RESPONSE_TIMEOUT)
+{
+	ResponseFuture future(timeout);
+	SendToActor(address, data, future.GetCallback());
+	return future;
+}
+
+template <typename T>
+ResponseFuture SendToActorAsync(const Address& address, const T& obj,
+	std::chrono::milliseconds timeout = DEFAULT_RESPONSE_TIMEOUT)
+{
+	return SendToActorAsync(address, obj.SerializeAsString(), timeout);
+}
+
 } // namespace postoffice
 
 } // namespace mq
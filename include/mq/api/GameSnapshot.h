@@ -0,0 +1,97 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/Common.h"
+#include "eqlib/Globals.h"
+#include "eqlib/PlayerClient.h"
+
+#include <cstdint>
+
+namespace mq {
+
+constexpr int MAX_SNAPSHOT_XTARGETS = 23;
+constexpr int MAX_SNAPSHOT_BUFFS = eqlib::MAX_TOTAL_BUFFS;
+
+/**
+ * A spawn as it was at the start of the frame. Valid is false when there was no spawn, for example
+ * with no target or for a group member in another zone. The name is kept for group members either
+ * way.
+ */
+struct MQSpawnSnapshot
+{
+	bool Valid;
+	bool Dead;
+	uint32_t SpawnID;
+	char Name[eqlib::EQ_MAX_NAME];
+	int Level;
+	int Class;
+	int Type;                                // eSpawnType
+	float X;
+	float Y;
+	float Z;
+	float Heading;                           // in degrees
+	float Distance;                          // from the controlled player, ignoring height
+	int PctHPs;
+	int PctMana;
+	int PctEndurance;
+};
+
+struct MQBuffSnapshot
+{
+	int SpellID;                             // zero if the slot is empty
+	int Duration;                            // in ticks
+};
+
+/**
+ * The state that scripts, HUDs and plugins most often read, copied once per frame right after the
+ * main pulse, so that they can read plain memory instead of each going through TLOs or walking the
+ * game's structures. Fields are only ever added at the end.
+ */
+struct MQGameSnapshot
+{
+	uint64_t Frame;                          // goes up by one with each update
+	bool InGame;                             // the rest is zeroed when not in game
+
+	MQSpawnSnapshot Self;
+	int CurrentHPs;
+	int MaxHPs;
+	int CurrentMana;
+	int MaxMana;
+	int CurrentEndurance;
+	int MaxEndurance;
+	int ZoneID;
+
+	MQSpawnSnapshot Target;
+
+	int GroupCount;                          // members other than the controlled player
+	MQSpawnSnapshot Group[eqlib::MAX_GROUP_SIZE - 1];
+
+	int XTargetCount;                        // occupied slots, in slot order
+	MQSpawnSnapshot XTargets[MAX_SNAPSHOT_XTARGETS];
+
+	int BuffCount;                           // slots with a spell in them
+	MQBuffSnapshot Buffs[MAX_SNAPSHOT_BUFFS];  // by buff slot
+};
+
+/**
+ * Returns the snapshot of this frame. It is updated on the main thread after the main pulse and
+ * before plugins pulse, and stays the same until the next frame.
+ *
+ * @return The game state snapshot.
+ */
+MQLIB_API const MQGameSnapshot& GetGameSnapshot();
+
+} // namespace mq
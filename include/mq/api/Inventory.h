@@ -15,10 +15,112 @@
 #pragma once
 
 #include "mq/base/Common.h"
+#include "eqlib/Items.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
 
 namespace mq {
 
 // Get the number of bank slots matching size
 MQLIB_API int GetBankSlotCount(int nSize, bool bEmptyOnly = false);
 
+constexpr int MAX_SNAPSHOT_ITEM_NAME = 64;
+
+enum class InventorySnapshotSource
+{
+	Inventory,                               // worn, packs and cursor
+	Bank,                                    // bank and shared bank
+	KeyRings,                                // every keyring type
+};
+
+enum MQInventoryItemFlags : uint32_t
+{
+	InventoryItem_Lore                       = 0x0001,
+	InventoryItem_NoDrop                     = 0x0002,
+	InventoryItem_NoRent                     = 0x0004,
+	InventoryItem_Container                  = 0x0008,
+	InventoryItem_Stackable                  = 0x0010,
+	InventoryItem_Magic                      = 0x0020,
+};
+
+/**
+ * One item as it was when the snapshot was taken. Items inside a container follow the container.
+ */
+struct MQInventoryItemSnapshot
+{
+	eqlib::ItemContainerInstance Location;
+	int16_t Slot;
+	int16_t BagSlot;                         // -1 if the item is not inside a container
+	int ItemID;
+	char Name[MAX_SNAPSHOT_ITEM_NAME];
+	int StackCount;
+	int Charges;
+	uint32_t Flags;                          // MQInventoryItemFlags
+};
+
+struct MQInventorySnapshot
+{
+	// Goes up only when the items differ from the last snapshot of the same source, so callers can
+	// keep their own results until it changes.
+	uint32_t Revision;
+	std::vector<MQInventoryItemSnapshot> Items;
+};
+
+/**
+ * Returns every item in an inventory source in one call. The snapshot is taken again only after
+ * the inventory could have changed (the next pulse or after MQ moves an item), and otherwise
+ * the same one is returned. Only call this from the main thread.
+ *
+ * @param source Which items to take.
+ * @return The snapshot, valid until the next call for the same source.
+ */
+MQLIB_API const MQInventorySnapshot& GetInventorySnapshot(InventorySnapshotSource source);
+
+/**
+ * One step of a batch of item moves: move the item at From to To, which is either empty or holds
+ * a stack of the same item with room for it.
+ */
+struct MQItemMove
+{
+	eqlib::ItemGlobalIndex From;
+	eqlib::ItemGlobalIndex To;
+	int Count = 0;                           // zero to move the whole stack
+};
+
+// Called once every move of a batch has either gone through or timed out.
+using MQItemMovesCallback = std::function<void(int moved, int failed)>;
+
+/**
+ * Plans where a list of items goes in the bank or in the packs of the inventory. Each item first
+ * tops up a stack of the same item that has room for all of it, then takes an empty slot inside a
+ * bag that can hold it, then an empty top level slot. Items are grouped by the container they come
+ * from, so each bag is only gone through once. Items that don't fit anywhere are left out.
+ *
+ * @param items The items to move.
+ * @param destination eItemContainerBank or eItemContainerPossessions.
+ * @return The moves, in the order they should be made.
+ */
+MQLIB_API std::vector<MQItemMove> PlanItemMoves(const std::vector<eqlib::ItemGlobalIndex>& items,
+	eqlib::ItemContainerInstance destination);
+
+/**
+ * Queues a batch of moves. They are sent several at a time without going through the cursor,
+ * and the next group goes out as soon as the server has made the previous one. Only one batch runs
+ * at a time.
+ *
+ * @param moves The moves to make, usually from PlanItemMoves.
+ * @param callback Called on the main thread when the batch is done or cancelled.
+ * @return False if another batch is still running or there is nothing to move.
+ */
+MQLIB_API bool MoveItems(std::vector<MQItemMove> moves, MQItemMovesCallback callback = nullptr);
+
+// Whether a batch of moves is still running.
+MQLIB_API bool IsMovingItems();
+
+// Drops the moves that haven't been sent yet, the callback counts them as failed. Pass false to
+// drop the callback too, for example when the plugin that queued the moves unloads.
+MQLIB_API void CancelItemMoves(bool callCallback = true);
+
 } // namespace mq
\ No newline at end of file
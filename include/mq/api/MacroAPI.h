@@ -20,6 +20,10 @@
 #include "mq/api/MacroDataTypes.h"
 
 #include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace eqlib {
 	class PlayerClient;
@@ -140,6 +144,76 @@ MQLIB_API int EvaluateMacroDataMember(MQ2Type* Type, MQVarPtr VarPtr, MQTypeVar&
 // Returns false if the given name is neither a member nor a method of the given type.
 MQLIB_OBJECT bool FindMacroDataMember(MQ2Type* Type, const std::string& Member);
 
+// Evaluates several members of the same object, e.g. { "Name", "PctHPs", "Buff[1]" } of a spawn,
+// without resolving the object again for each one. Callback receives the position of each member
+// in Members and its result, which has no Type if the member failed. A result may point at
+// temporary storage, so it is only valid for the duration of the callback.
+MQLIB_OBJECT void EvaluateMacroDataMembers(const MQTypeVar& Object, const std::vector<std::string_view>& Members,
+	const std::function<void(size_t, const MQTypeVar&)>& Callback);
+
+// A data expression, such as "Me.PctHPs" or "Spawn[pc Bob].Distance", parsed once ahead of time.
+// Evaluating it skips the parsing, and the TLO and member lookups are remembered between
+// evaluations for as long as they stay valid.
+struct MQBoundDataExpression;
+
+// Returns nullptr if the expression can't be bound. Nested ${} variables aren't supported.
+MQLIB_OBJECT std::shared_ptr<MQBoundDataExpression> BindDataExpression(std::string_view expression);
+
+// Evaluates the expression as ${expression} would be, leaving the result in Result.
+MQLIB_OBJECT bool EvaluateBoundDataExpression(const MQBoundDataExpression& expression, MQTypeVar& Result);
+
+// The TLO that the expression starts with, if it starts with one.
+MQLIB_OBJECT MQTopLevelObject* GetBoundTopLevelObject(const MQBoundDataExpression& expression);
+
+// A line of text with ${} variables in it, split into literal and variable segments once ahead of
+// time. Compiled strings are cached by their text, so compiling the same line again is cheap.
+struct MQCompiledMacroString;
+
+MQLIB_OBJECT std::shared_ptr<const MQCompiledMacroString> CompileMacroString(std::string_view strOriginal);
+
+// Evaluates a compiled string the same way ParseMacroData would evaluate its text.
+MQLIB_OBJECT std::string EvaluateCompiledMacroString(const MQCompiledMacroString& compiled);
+
+// Evaluates a compiled string into szOutput, with the same truncation handling as ParseMacroData.
+MQLIB_OBJECT bool ParseCompiledMacroData(const MQCompiledMacroString& compiled, char* szOutput, size_t BufferSize);
+
+// Subscriptions to data expressions such as "Me.PctHPs". Each distinct expression is evaluated
+// once per frame no matter how many subscribers it has, and a subscriber is only called when its
+// trigger fires.
+enum class MQDataTrigger
+{
+	Changed,                             // the value changed
+	Above,                               // the value went above the threshold
+	Below,                               // the value went below the threshold
+};
+
+using MQDataChangedCallback = std::function<void(const MQTypeVar& value)>;
+
+// Returns 0 if the expression can't be bound. The first value is delivered on the next frame if
+// it satisfies the trigger. Subscriptions must be removed before the plugin that made them unloads.
+MQLIB_OBJECT int SubscribeDataExpression(std::string_view expression, MQDataTrigger trigger, double threshold,
+	MQDataChangedCallback callback);
+MQLIB_OBJECT bool UnsubscribeDataExpression(int subscriptionID);
+
+// Temporary storage for data type results that only need to live until the current line has been
+// evaluated. While an evaluation is in progress these are not limited to MAX_STRING. Outside of one
+// they share DataTypeTemp, and AllocateDataTypeTemp returns nullptr for anything larger.
+MQLIB_OBJECT char* AllocateDataTypeTemp(size_t size);
+MQLIB_OBJECT char* StoreDataTypeTemp(std::string_view str);
+
+// Evaluations nest. Temporaries are released when the outermost one ends.
+MQLIB_OBJECT void BeginDataEvaluation();
+MQLIB_OBJECT void EndDataEvaluation();
+
+struct MQDataEvaluationScope
+{
+	MQDataEvaluationScope() { BeginDataEvaluation(); }
+	~MQDataEvaluationScope() { EndDataEvaluation(); }
+
+	MQDataEvaluationScope(const MQDataEvaluationScope&) = delete;
+	MQDataEvaluationScope& operator=(const MQDataEvaluationScope&) = delete;
+};
+
 //----------------------------------------------------------------------------
 // Compatibility shims
 
@@ -21,6 +21,7 @@
 #include "eqlib/CXStr.h"
 #include "eqlib/Items.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -41,6 +42,7 @@ namespace datatypes {
 }
 using datatypes::MQ2Type;
 struct MQTypeVar;
+class MQNameLookupTable;
 
 template <typename T>
 static constexpr auto type_name() noexcept;
@@ -520,10 +522,19 @@ protected:
 	mutable std::mutex m_mutex;
 
 private:
+	const MQNameLookupTable* GetMemberTable() const;
+	const MQNameLookupTable* GetMethodTable() const;
+
 	std::vector<std::unique_ptr<MQTypeMember>> Members;
 	std::vector<std::unique_ptr<MQTypeMember>> Methods;
 	std::unordered_map<std::string, int> MemberMap;
 	std::unordered_map<std::string, int> MethodMap;
+
+	// Lookup tables built from the maps above the first time a name is resolved after they change.
+	// Readers never take the lock. Old tables are kept, a reader might still be using one.
+	mutable std::atomic<const MQNameLookupTable*> m_memberTable{ nullptr };
+	mutable std::atomic<const MQNameLookupTable*> m_methodTable{ nullptr };
+	mutable std::vector<std::unique_ptr<MQNameLookupTable>> m_lookupTables;
 };
 
 } // namespace datatypes
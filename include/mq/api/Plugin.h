@@ -16,6 +16,8 @@
 
 #include "mq/base/Common.h"
 
+#include <array>
+#include <chrono>
 #include <string_view>
 #include <string>
 
@@ -27,6 +29,7 @@ namespace eqlib {
 namespace mq {
 
 class PluginInterface;
+struct MQAllocationCounters;
 
 // Plugin Function Types
 using fMQWriteChatColor      = DWORD  (*)(const char*, DWORD, DWORD);
@@ -40,6 +43,7 @@ using fMQCleanUI             = void   (*)();
 using fMQDrawHUD             = void   (*)();
 using fMQSetGameState        = void   (*)(DWORD GameState);
 using fMQSpawn               = void   (*)(PlayerClient*);
+using fMQSpawns              = void   (*)(PlayerClient* const* spawns, size_t count);
 using fMQGroundItem          = void   (*)(EQGroundItem*);
 using fMQBeginZone           = void   (*)();
 using fMQEndZone             = void   (*)();
@@ -49,6 +53,53 @@ using fMQMacroStop           = void   (*)(const char*);
 using fMQLoadPlugin          = void   (*)(const char*);
 using fMQUnloadPlugin        = void   (*)(const char*);
 using fMQGetPluginInterface  = PluginInterface* (*)();
+using fMQSaveReloadState     = void   (*)(std::string& state);
+using fMQRestoreReloadState  = void   (*)(std::string_view state);
+
+// The plugin callbacks that are timed as they are dispatched.
+enum class PluginCallback
+{
+	WriteChatColor,
+	IncomingChat,
+	Pulse,
+	AsyncPulse,
+	Zoned,
+	CleanUI,
+	ReloadUI,
+	DrawHUD,
+	SetGameState,
+	AddSpawn,
+	RemoveSpawn,
+	AddSpawns,
+	RemoveSpawns,
+	AddGroundItem,
+	RemoveGroundItem,
+	BeginZone,
+	EndZone,
+	UpdateImGui,
+	MacroStart,
+	MacroStop,
+	LoadPlugin,
+	UnloadPlugin,
+
+	Count
+};
+
+// Returns the name of the callback as plugins export it, less the "On" prefix.
+MQLIB_OBJECT const char* GetPluginCallbackName(PluginCallback callback);
+
+// Finds a callback by the name GetPluginCallbackName returns. Returns false if there is none.
+MQLIB_OBJECT bool FindPluginCallback(std::string_view name, PluginCallback& callback);
+
+struct MQPluginCallbackTiming
+{
+	uint64_t                 Count = 0;
+	uint32_t                 SlowCount = 0;        // calls that took longer than the slow callback warning
+	std::chrono::nanoseconds LastTime = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds MaxTime = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds TotalTime = std::chrono::nanoseconds::zero();
+	uint64_t                 LastWarning = 0;      // tick count of the last slow callback warning
+};
 
 struct MQPlugin
 {
@@ -63,6 +114,7 @@ struct MQPlugin
 	fMQZoned             Zoned = 0;
 	fMQWriteChatColor    WriteChatColor = 0;
 	fMQPulse             Pulse = 0;
+	fMQPulse             AsyncPulse = 0;       // runs on a worker thread alongside the pulse
 	fMQIncomingChat      IncomingChat = 0;
 	fMQCleanUI           CleanUI = 0;
 	fMQReloadUI          ReloadUI = 0;
@@ -70,6 +122,8 @@ struct MQPlugin
 	fMQSetGameState      SetGameState = 0;
 	fMQSpawn             AddSpawn = 0;
 	fMQSpawn             RemoveSpawn = 0;
+	fMQSpawns            AddSpawns = 0;        // replaces AddSpawn, delivered once per pulse
+	fMQSpawns            RemoveSpawns = 0;     // replaces RemoveSpawn
 	fMQGroundItem        AddGroundItem = 0;
 	fMQGroundItem        RemoveGroundItem = 0;
 	fMQBeginZone         BeginZone = 0;
@@ -80,9 +134,18 @@ struct MQPlugin
 	fMQLoadPlugin        LoadPlugin = 0;
 	fMQUnloadPlugin      UnloadPlugin = 0;
 	fMQGetPluginInterface GetPluginInterface = 0;
+	fMQSaveReloadState   SaveReloadState = 0;   // called before the plugin is unloaded by a reload
+	fMQRestoreReloadState RestoreReloadState = 0; // receives the saved state after it is loaded again
 
 	MQPlugin* pLast = nullptr;
 	MQPlugin* pNext = nullptr;
+
+	// Time spent in each callback, indexed by PluginCallback.
+	std::array<MQPluginCallbackTiming, static_cast<size_t>(PluginCallback::Count)> CallbackTimings;
+
+	// Allocations made by the plugin while gbTrackAllocations is on. Null for plugins built
+	// before allocations were tracked.
+	const MQAllocationCounters* Allocations = nullptr;
 };
 
 MQLIB_API bool IsPluginsInitialized();
@@ -0,0 +1,77 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "mq/base/Common.h"
+#include "eqlib/Globals.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace mq {
+
+/**
+ * A spawn as the client publishing spawns for the zone last reported it. Positions are only sent
+ * again once they have moved a little, so they can be up to half a unit off.
+ */
+struct MQSharedSpawn
+{
+	uint32_t SpawnID;
+	char Name[eqlib::EQ_MAX_NAME];
+	int Level;
+	int Type;                                // eSpawnType
+	float X;
+	float Y;
+	float Z;
+	int PctHPs;
+	bool Dead;
+};
+
+/**
+ * When SharedSpawns is on in MacroQuest.ini, the clients in the same zone pick one of themselves
+ * to send the spawns it sees to the others a few times a second (SharedSpawnRate), so that any of
+ * them can look at the zone the way that client sees it.
+ *
+ * @return The process id of the client that spawns are coming from, this one included, or 0 if
+ *         there is none yet.
+ */
+MQLIB_API uint32_t GetSharedSpawnsPublisher();
+
+/**
+ * Returns the shared spawns, sorted by spawn id. The pointer is good until the next pulse.
+ *
+ * @param count Set to the number of spawns.
+ * @return The first spawn, or nullptr if there are none.
+ */
+MQLIB_API const MQSharedSpawn* GetSharedSpawns(size_t& count);
+
+/**
+ * Finds a shared spawn by id. The pointer is good until the next pulse.
+ *
+ * @param spawnID The spawn to look for.
+ * @return The spawn, or nullptr if it isn't in the shared spawns.
+ */
+MQLIB_API const MQSharedSpawn* FindSharedSpawn(uint32_t spawnID);
+
+/**
+ * Finds a shared spawn by its exact name, ignoring case, for example to find where another
+ * character is. The pointer is good until the next pulse.
+ *
+ * @param name The name to look for.
+ * @return The first spawn with the name, or nullptr if there is none.
+ */
+MQLIB_API const MQSharedSpawn* FindSharedSpawnByName(std::string_view name);
+
+} // namespace mq
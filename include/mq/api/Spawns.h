@@ -17,10 +17,15 @@
 #include "eqlib/Globals.h"
 #include "eqlib/PlayerClient.h"
 
+#include <string_view>
+#include <vector>
+
 using namespace eqlib;
 
 namespace mq {
 
+struct MQSpawnSearch;
+
 /**
  * Returns true if the given spawn is marked by the group or raid.
  *
@@ -63,5 +68,38 @@ MQLIB_API uint32_t GetRaidMainAssistTargetID(int index);
  */
 MQLIB_API bool IsAssistNPC(PlayerClient* pSpawn);
 
+/**
+ * Returns up to Count spawns matching a search, nearest first. This is the same
+ * as calling NthNearestSpawn for 1 through Count, but only searches once.
+ *
+ * @param pSearchSpawn The search to match spawns against
+ * @param Count The maximum number of spawns to return
+ * @param pOrigin The spawn to measure distance from. Defaults to the controlled player
+ * @param IncludeOrigin Whether the origin itself may be returned
+ * @return The matching spawns, sorted by distance from the origin.
+ */
+MQLIB_API std::vector<PlayerClient*> GetNearestSpawns(MQSpawnSearch* pSearchSpawn, int Count,
+	PlayerClient* pOrigin = nullptr, bool IncludeOrigin = false);
+
+/**
+ * Returns up to Count spawns matching a search string, nearest to the controlled
+ * player first. The search string uses the same syntax as ${NearestSpawn}.
+ *
+ * @param searchString The spawn search, eg "npc radius 100"
+ * @param Count The maximum number of spawns to return
+ * @return The matching spawns, sorted by distance.
+ */
+MQLIB_API std::vector<PlayerClient*> GetNearestSpawns(std::string_view searchString, int Count);
+
+/**
+ * Returns true if the origin has line of sight to the spawn. Results are cached by spawn
+ * and position for the rest of the frame, and for LineOfSightCacheTime milliseconds
+ * (MacroQuest.ini, default 100), so repeated checks against the same spawn are cheap.
+ *
+ * @param pOrigin The spawn to check from. Usually the controlled player
+ * @param pSpawn The spawn to check
+ * @return Whether the origin can see the spawn.
+ */
+MQLIB_API bool CanSeeSpawn(PlayerClient* pOrigin, PlayerClient* pSpawn);
 
 } // namespace mq
@@ -29,13 +29,16 @@ namespace mq {
 class MQTexture
 {
 public:
-	explicit MQTexture(std::string_view name);
+	explicit MQTexture(std::string_view name, bool loadNow = true);
 	MQLIB_OBJECT ~MQTexture();
 
 	MQTexture(const MQTexture&) = delete;
 	MQTexture& operator=(const MQTexture&) = delete;
 
 	bool IsValid() const { return m_bmi != nullptr; }
+
+	// True while a texture from CreateTextureAsync is waiting to be loaded. It is not valid until then.
+	bool IsLoading() const { return m_loading; }
 	const std::string& GetFilename() const { return m_name; }
 
 	MQLIB_OBJECT ImTextureID GetTextureID() const;
@@ -44,9 +47,13 @@ public:
 	void ReleaseTexture();
 	void AcquireTexture();
 
+	void Load();
+	void CancelLoad() { m_loading = false; }
+
 private:
 	std::string m_name;
 	eqlib::BMI* m_bmi = nullptr;
+	bool m_loading = false;
 };
 
 using MQTexturePtr = std::shared_ptr<MQTexture>;
@@ -62,5 +69,11 @@ MQLIB_OBJECT void DestroyTexture(MQTexture* texture);
 // that wraps CreateTexture/DestroyTexture in a shared_ptr.
 MQLIB_OBJECT MQTexturePtr CreateTexturePtr(std::string_view filename);
 
+// Returns a texture for an image file that is loaded over the next frames instead of right away.
+// Until then, IsLoading is true and the texture has no texture id. If the file can't be loaded,
+// IsLoading turns false and the texture stays invalid. Asking for the same file again while the
+// texture is still held returns the same texture, so a file is only ever loaded once.
+MQLIB_OBJECT MQTexturePtr CreateTextureAsync(std::string_view filename);
+
 } // namespace mq
 
@@ -0,0 +1,151 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Splits a command line into its arguments in a single pass.
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mq {
+
+// Follows the same rules as GetArg and GetNextArg with their default options: arguments are
+// separated by spaces and tabs, and double quotes group anything, separators included, into one
+// argument. A quote that is never closed runs to the end of the line.
+//
+// Arguments are views into the line, so the line has to outlive the CommandArgs. The only
+// argument that gets copied is one with quotes in the middle of it, like a"b c"d, because
+// GetArg drops those quotes too.
+//
+// Unlike GetArg, arguments are numbered from 0. Asking for one past the end returns an empty
+// view, like GetArg returns an empty string.
+class CommandArgs
+{
+public:
+	CommandArgs() = default;
+
+	explicit CommandArgs(std::string_view line)
+		: m_line(line)
+	{
+		Parse();
+	}
+
+	// CommandArgs may refer into its own storage, so it can't be copied.
+	CommandArgs(const CommandArgs&) = delete;
+	CommandArgs& operator=(const CommandArgs&) = delete;
+
+	size_t size() const { return m_args.size(); }
+	bool empty() const { return m_args.empty(); }
+
+	// The argument with its quotes removed, like GetArg.
+	std::string_view operator[](size_t index) const
+	{
+		return index < m_args.size() ? m_args[index].value : std::string_view();
+	}
+
+	// The argument as it appears on the line, quotes and all, like GetArg with LeaveQuotes.
+	std::string_view Raw(size_t index) const
+	{
+		return index < m_args.size() ? m_args[index].raw : std::string_view();
+	}
+
+	// Everything from the start of the argument to the end of the line, like GetNextArg. Past the
+	// last argument this is empty but still points at the end of the line, so if the line is null
+	// terminated, the rest always is too.
+	std::string_view Rest(size_t index) const
+	{
+		if (index < m_args.size())
+			return m_line.substr(m_args[index].raw.data() - m_line.data());
+
+		return m_line.substr(m_line.size());
+	}
+
+	std::string_view Line() const { return m_line; }
+
+private:
+	static bool IsSeparator(char ch)
+	{
+		return ch == ' ' || ch == '\t';
+	}
+
+	void Parse()
+	{
+		size_t pos = 0;
+
+		while (true)
+		{
+			while (pos < m_line.size() && IsSeparator(m_line[pos]))
+				++pos;
+
+			if (pos == m_line.size())
+				break;
+
+			size_t start = pos;
+			size_t quotes = 0;
+			bool inQuotes = false;
+
+			while (pos < m_line.size() && (inQuotes || !IsSeparator(m_line[pos])))
+			{
+				if (m_line[pos] == '"')
+				{
+					inQuotes = !inQuotes;
+					++quotes;
+				}
+
+				++pos;
+			}
+
+			std::string_view raw = m_line.substr(start, pos - start);
+			m_args.push_back({ raw, Unquote(raw, quotes) });
+		}
+	}
+
+	std::string_view Unquote(std::string_view raw, size_t quotes)
+	{
+		if (quotes == 0)
+			return raw;
+
+		// the usual case, "quoted words", or an unclosed quote at the start
+		if (raw.front() == '"' && (quotes == 1 || (quotes == 2 && raw.size() > 1 && raw.back() == '"')))
+			return raw.substr(1, raw.size() - quotes);
+
+		std::string& unquoted = m_unquoted.emplace_back();
+		unquoted.reserve(raw.size() - quotes);
+
+		for (char ch : raw)
+		{
+			if (ch != '"')
+				unquoted.push_back(ch);
+		}
+
+		return unquoted;
+	}
+
+	struct Arg
+	{
+		std::string_view raw;
+		std::string_view value;
+	};
+
+	std::string_view m_line;
+	std::vector<Arg> m_args;
+
+	// a deque, so adding to it doesn't move the strings that earlier arguments refer to
+	std::deque<std::string> m_unquoted;
+};
+
+} // namespace mq
@@ -122,4 +122,21 @@ inline void AddDetourBytes(uintptr_t address, std::string_view name)
 
 MQLIB_API void RemoveDetour(uintptr_t address);
 
+// Detours added or removed between these are all patched in when the outermost batch is
+// committed, instead of one at a time. Trampolines keep pointing at the original functions until
+// then. Batches can be nested, but only on one thread.
+MQLIB_API void BeginDetourBatch();
+MQLIB_API void CommitDetourBatch();
+
+// Begins a detour batch, and commits it when it goes out of scope.
+class DetourBatch
+{
+public:
+	DetourBatch() { BeginDetourBatch(); }
+	~DetourBatch() { CommitDetourBatch(); }
+
+	DetourBatch(const DetourBatch&) = delete;
+	DetourBatch& operator=(const DetourBatch&) = delete;
+};
+
 } // namespace mq
@@ -0,0 +1,147 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Lock-free multiple producer, single consumer queue.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace mq {
+
+// Any number of threads may push. Exactly one thread at a time may consume.
+//
+// Producers push onto an intrusive stack with a single compare-exchange, so posting
+// never blocks behind the consumer or another producer. The consumer takes the whole
+// stack in one exchange and reverses it into a private list, which it then works
+// through in order. Items the consumer didn't get to (because of a budget) stay at the
+// front of that private list, ahead of anything pushed later.
+template <typename T>
+class MPSCQueue
+{
+	struct Node
+	{
+		T value;
+		Node* next = nullptr;
+	};
+
+public:
+	MPSCQueue() = default;
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	~MPSCQueue()
+	{
+		Clear();
+	}
+
+	void Push(T&& value)
+	{
+		Node* node = new Node{ std::move(value), m_head.load(std::memory_order_relaxed) };
+
+		while (!m_head.compare_exchange_weak(node->next, node,
+			std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// Consumer only. True if nothing has been pushed that hasn't been consumed.
+	bool IsEmpty() const
+	{
+		return m_pending == nullptr && m_head.load(std::memory_order_acquire) == nullptr;
+	}
+
+	// Consumer only. Calls func on items in the order they were pushed, until the queue
+	// is empty or maxCount items have been handled. Returns the number handled.
+	template <typename Func>
+	size_t Consume(Func&& func, size_t maxCount = SIZE_MAX)
+	{
+		size_t count = 0;
+
+		while (count < maxCount && TakeNext(func))
+			++count;
+
+		return count;
+	}
+
+	// Consumer only. Like Consume, but stops once budget has elapsed. At least one item is
+	// handled if any are queued, so that a slow item can't stall the queue forever.
+	template <typename Func>
+	size_t ConsumeFor(Func&& func, std::chrono::steady_clock::duration budget)
+	{
+		auto deadline = std::chrono::steady_clock::now() + budget;
+		size_t count = 0;
+
+		while (TakeNext(func))
+		{
+			++count;
+
+			if (std::chrono::steady_clock::now() >= deadline)
+				break;
+		}
+
+		return count;
+	}
+
+	// Consumer only. Drops everything queued without handling it.
+	void Clear()
+	{
+		Consume([](T&) {});
+	}
+
+private:
+	template <typename Func>
+	bool TakeNext(Func& func)
+	{
+		if (!m_pending)
+		{
+			m_pending = TakeAll();
+			if (!m_pending)
+				return false;
+		}
+
+		std::unique_ptr<Node> node{ m_pending };
+		m_pending = node->next;
+
+		func(node->value);
+		return true;
+	}
+
+	Node* TakeAll()
+	{
+		Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+
+		// The stack is newest first, reverse it.
+		Node* reversed = nullptr;
+		while (node)
+		{
+			Node* next = node->next;
+			node->next = reversed;
+			reversed = node;
+			node = next;
+		}
+
+		return reversed;
+	}
+
+	std::atomic<Node*> m_head{ nullptr };  // shared, newest first
+	Node* m_pending = nullptr;             // consumer owned, oldest first
+};
+
+} // namespace mq
@@ -16,9 +16,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
-#include <list>
 #include <memory>
+#include <vector>
 
 namespace mq {
 
@@ -46,25 +48,29 @@ public:
 
 	void operator()(T... args)
 	{
-		if (m_connected && m_callback)
+		if (m_connected.load(std::memory_order_acquire) && m_callback)
 			m_callback(args...);
 	}
 
 	bool IsConnected() const
 	{
-		return m_connected;
+		return m_connected.load(std::memory_order_acquire);
 	}
 
 	void Disconnect()
 	{
-		m_connected = false;
+		m_connected.store(false, std::memory_order_release);
 	}
 
 private:
 	Callback m_callback;
-	bool m_connected;
+	std::atomic<bool> m_connected;
 };
 
+// Emitting walks an immutable snapshot of the connections, so it doesn't allocate or lock and
+// callbacks are free to connect or disconnect while it runs. Connecting and disconnecting copy
+// the snapshot and publish the copy, so they are the expensive side. A connection that is
+// disconnected while an emit is in progress is not called again, even by that emit.
 template <typename... T>
 class Signal
 {
@@ -75,53 +81,77 @@ public:
 
 private:
 	using ConnectionItem = SignalConnectionItem<T...>;
-	using ConnectionList = std::list<std::shared_ptr<ConnectionItem>>;
+	using ConnectionList = std::vector<std::shared_ptr<ConnectionItem>>;
 
-	ConnectionList m_list;
-	uint32_t m_recurseCount = 0;
+	std::shared_ptr<const ConnectionList> m_list;
 
-	void ClearDisconnected()
+	std::shared_ptr<const ConnectionList> GetSnapshot() const
 	{
-		m_list.erase(std::remove_if(m_list.begin(), m_list.end(),
-			[](std::shared_ptr<ConnectionItem>& item)
+		return std::atomic_load_explicit(&m_list, std::memory_order_acquire);
+	}
+
+	// Copies the current snapshot, lets func change the copy and publishes it, trying again if
+	// another thread published first. Nothing is published if func returns false.
+	template <typename Func>
+	bool UpdateList(Func&& func)
+	{
+		std::shared_ptr<const ConnectionList> current = GetSnapshot();
+
+		while (true)
 		{
-			return !item->IsConnected();
-		}), m_list.end());
+			auto updated = current ? std::make_shared<ConnectionList>(*current) : std::make_shared<ConnectionList>();
+			if (!func(*updated))
+				return false;
+
+			std::shared_ptr<const ConnectionList> desired = updated->empty() ? nullptr : std::move(updated);
+			if (std::atomic_compare_exchange_weak_explicit(&m_list, &current, std::move(desired),
+				std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return true;
+			}
+		}
+	}
+
+	static bool RemoveDisconnected(ConnectionList& list)
+	{
+		auto iter = std::remove_if(list.begin(), list.end(),
+			[](const std::shared_ptr<ConnectionItem>& item) { return !item->IsConnected(); });
+		if (iter == list.end())
+			return false;
+
+		list.erase(iter, list.end());
+		return true;
 	}
-	
+
 public:
 	Signal() {}
 
 	~Signal()
 	{
-		for (auto& item : m_list)
-			item->Disconnect();
+		DisconnectAll();
 	}
 
 	void operator()(T... args)
 	{
-		std::list<std::shared_ptr<ConnectionItem>> list;
-		for (auto& item : m_list)
-		{
-			if (item->IsConnected())
-				list.push_back(item);
-		}
-
-		++m_recurseCount;
+		// holding the snapshot keeps it alive even if a callback publishes a new one
+		std::shared_ptr<const ConnectionList> list = GetSnapshot();
+		if (!list)
+			return;
 
-		for (auto& item : list)
+		for (const auto& item : *list)
 		{
 			(*item)(args...);
 		}
-
-		if (--m_recurseCount == 0)
-			ClearDisconnected();
 	}
 
 	Connection Connect(const Callback& callback)
 	{
 		auto item = std::make_shared<ConnectionItem>(callback, true);
-		m_list.push_back(item);
+		UpdateList([&](ConnectionList& list)
+		{
+			list.push_back(item);
+			return true;
+		});
 
 		return Connection(*this, item);
 	}
@@ -129,18 +159,21 @@ public:
 	bool Disconnect(const Connection& connection)
 	{
 		bool found = false;
-		for (auto& item : m_list)
+		if (auto list = GetSnapshot())
 		{
-			if (connection.HasItem(*item) && item->IsConnected())
+			for (auto& item : *list)
 			{
-				found = true;
-				item->Disconnect();
+				if (connection.HasItem(*item) && item->IsConnected())
+				{
+					found = true;
+					item->Disconnect();
+				}
 			}
 		}
 
 		if (found)
 		{
-			ClearDisconnected();
+			UpdateList(RemoveDisconnected);
 		}
 
 		return found;
@@ -148,13 +181,18 @@ public:
 
 	bool DisconnectAll()
 	{
-		for (auto& item : m_list)
+		std::shared_ptr<const ConnectionList> list = std::atomic_exchange_explicit(&m_list,
+			std::shared_ptr<const ConnectionList>(), std::memory_order_acq_rel);
+		if (!list)
+			return false;
+
+		for (auto& item : *list)
 			item->Disconnect();
 
-		ClearDisconnected();
+		return true;
 	}
 
-	friend class Connection;
+	friend Connection;
 };
 
 template <typename... T>
@@ -190,7 +228,7 @@ public:
 
 	bool IsConnected() const
 	{
-		return m_item->IsConnected();
+		return m_item && m_item->IsConnected();
 	}
 
 	bool Disconnect()
@@ -75,7 +75,7 @@ private:
 	Reducible lexer(std::vector<std::string_view>::iterator& it, std::vector<std::string_view>::iterator& end)
 	{
 		// the default will get completely replaced on the first successful term evaluation
-		Reducible&& parsed = std::move(m_error());
+		Reducible parsed = m_error();
 		std::optional<Reducer> current_reducer = {};
 		std::optional<Modifier> current_modifier = {};
 		std::optional<Term> current_term = {};
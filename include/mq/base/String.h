@@ -26,6 +26,11 @@
 #include <set>
 #include <map>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MQ_STRING_SSE2 1
+#endif
+
 namespace mq {
 
 inline void to_lower(std::string& str)
@@ -412,20 +417,105 @@ struct ci_less
 	using is_transparent = void;
 };
 
+namespace detail {
+
+// Folds ASCII upper case only, which is what ::tolower does in the "C" locale.
+constexpr unsigned char ascii_tolower(unsigned char c) noexcept
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+#if defined(MQ_STRING_SSE2)
+inline __m128i ascii_tolower16(__m128i v) noexcept
+{
+	// bytes >= 0x80 are negative as signed chars and never fall inside 'A'..'Z'
+	const __m128i upper = _mm_and_si128(
+		_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+	return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+inline bool ci_equals_n(const char* s1, const char* s2, size_t length) noexcept
+{
+	size_t pos = 0;
+
+#if defined(MQ_STRING_SSE2)
+	for (; pos + 16 <= length; pos += 16)
+	{
+		const __m128i a = ascii_tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + pos)));
+		const __m128i b = ascii_tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s2 + pos)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+			return false;
+	}
+#endif
+
+	for (; pos < length; ++pos)
+	{
+		if (ascii_tolower(static_cast<unsigned char>(s1[pos])) != ascii_tolower(static_cast<unsigned char>(s2[pos])))
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace detail
+
 inline int find_substr(std::string_view haystack, std::string_view needle)
 {
-	auto iter = std::search(std::begin(haystack), std::end(haystack),
-		std::begin(needle), std::end(needle));
-	if (iter == std::end(haystack)) return -1;
-	return static_cast<int>(iter - std::begin(haystack));
+	size_t pos = haystack.find(needle);
+	if (pos == std::string_view::npos || haystack.empty()) return -1;
+	return static_cast<int>(pos);
 }
 
 inline int ci_find_substr(std::string_view haystack, std::string_view needle)
 {
-	auto iter = std::search(std::begin(haystack), std::end(haystack),
-		std::begin(needle), std::end(needle), ci_less::nocase_equals());
-	if (iter == std::end(haystack)) return -1;
-	return static_cast<int>(iter - std::begin(haystack));
+	// an empty needle is found at the front of anything but an empty haystack
+	if (haystack.empty()) return -1;
+	if (needle.empty()) return 0;
+	if (needle.length() > haystack.length()) return -1;
+
+	const size_t last = haystack.length() - needle.length();
+	size_t pos = 0;
+
+#if defined(MQ_STRING_SSE2)
+	// Compare the first and last characters of the needle against 16 positions at once and
+	// only check the rest of the needle where both of them match.
+	const __m128i first = _mm_set1_epi8(static_cast<char>(detail::ascii_tolower(needle.front())));
+	const __m128i lastChar = _mm_set1_epi8(static_cast<char>(detail::ascii_tolower(needle.back())));
+	const size_t finalOffset = needle.length() - 1;
+
+	for (; pos + 16 <= last + 1; pos += 16)
+	{
+		const __m128i blockFirst = detail::ascii_tolower16(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + pos)));
+		const __m128i blockFinal = detail::ascii_tolower16(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + pos + finalOffset)));
+
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockFinal, lastChar)));
+
+		while (mask != 0)
+		{
+			unsigned int bit = 0;
+			while ((mask & (1u << bit)) == 0)
+				++bit;
+
+			if (detail::ci_equals_n(haystack.data() + pos + bit + 1, needle.data() + 1, needle.length() - 1))
+				return static_cast<int>(pos + bit);
+
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; pos <= last; ++pos)
+	{
+		if (detail::ci_equals_n(haystack.data() + pos, needle.data(), needle.length()))
+			return static_cast<int>(pos);
+	}
+
+	return -1;
 }
 
 inline int ci_find_substr_w(std::wstring_view haystack, std::wstring_view needle)
@@ -455,7 +545,7 @@ inline int ci_find_substr_w(std::wstring_view haystack, std::wstring_view needle
 inline bool ci_equals(std::string_view sv1, std::string_view sv2)
 {
 	return sv1.size() == sv2.size()
-		&& std::equal(sv1.begin(), sv1.end(), sv2.begin(), ci_less::nocase_equals());
+		&& detail::ci_equals_n(sv1.data(), sv2.data(), sv1.size());
 }
 
 inline bool ci_equals(std::wstring_view sv1, std::wstring_view sv2)
@@ -16,25 +16,84 @@
 
 #include <mq/base/Common.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace mq {
 
 //----------------------------------------------------------------------------
 // Benchmarks are used to measure the amount of time spent doing something. When
 // entering a benchmark, the current time is taken, and when leaving, the elapsed
 // time spent in the benchmark is added to the total.
+//
+// Each thread keeps a stack of the benchmarks it is inside of. Time spent in a benchmark entered
+// while another is active counts towards the outer benchmark's total but not its self time, and
+// a benchmark that is re-entered only adds its outermost time to its total.
+
+//----------------------------------------------------------------------------
+// Distribution of the times recorded by a benchmark, so that slow outliers show up instead of
+// disappearing into the average. Times are bucketed the way HDR histograms do it: each power of
+// two is split into 16 equal buckets, which keeps every time to within about 6% of its real value
+// in a fixed amount of memory.
+
+struct MQBenchmarkHistogram
+{
+	static constexpr int SubBucketBits = 4;
+	static constexpr uint64_t SubBucketCount = uint64_t{ 1 } << SubBucketBits;
+	static constexpr int MaxValueBits = 40;                  // times up to 2^40ns (about 18 minutes)
+	static constexpr size_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+	std::array<uint32_t, BucketCount> Buckets = {};
+	uint64_t Count = 0;
+	std::chrono::nanoseconds Max = std::chrono::nanoseconds::zero();
+
+	MQLIB_OBJECT void Record(std::chrono::nanoseconds time);
+	MQLIB_OBJECT void Reset();
+
+	// Returns the time that the given percentage (0-100) of recorded times are at or below.
+	MQLIB_OBJECT std::chrono::nanoseconds GetPercentile(double percentile) const;
+};
 
 struct MQBenchmark
 {
 	std::string Name;
 	std::chrono::steady_clock::time_point Entry;
-	std::chrono::microseconds LastTime = std::chrono::microseconds::zero();
-	std::chrono::microseconds TotalTime = std::chrono::microseconds::zero();
+	std::chrono::nanoseconds LastTime = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds TotalTime = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds SelfTime = std::chrono::nanoseconds::zero();   // TotalTime less time spent in other benchmarks
 	uint64_t Count = 0;
+	uint64_t Allocations = 0;                // heap allocations made inside the benchmark, while tracking them
+	uint64_t AllocatedBytes = 0;
+	MQBenchmarkHistogram Histogram;
 
 	MQBenchmark(const std::string& name) : Name(name) {}
 	MQBenchmark() {}
 };
 
+//----------------------------------------------------------------------------
+// Every frame, the main thread records which benchmarks ran inside which as a tree. Each node is
+// one benchmark reached through one path of parents, so the same benchmark can appear under
+// several parents. Nodes refer to each other by index into the tree.
+
+struct MQBenchmarkNode
+{
+	static constexpr uint32_t FrameRoot = static_cast<uint32_t>(-1);
+
+	uint32_t Benchmark = FrameRoot;          // benchmark id, or FrameRoot for the frame itself
+	int Parent = -1;
+	int FirstChild = -1;
+	int NextSibling = -1;
+	uint32_t Count = 0;
+	std::chrono::nanoseconds InclusiveTime = std::chrono::nanoseconds::zero();
+	std::chrono::nanoseconds SelfTime = std::chrono::nanoseconds::zero();
+	uint32_t Allocations = 0;                // heap allocations made inside the node, while tracking them
+	uint64_t AllocatedBytes = 0;
+};
+
 //----------------------------------------------------------------------------
 // Benchmarking API
 
@@ -47,12 +106,40 @@ MQLIB_API void RemoveMQ2Benchmark(uint32_t BMHandle);
 // Returns a reference to a benchmark by looking up its id.
 MQLIB_API bool GetMQ2Benchmark(uint32_t BMHandle, MQBenchmark& Dest);
 
+// Finds a benchmark by its name. Returns false if there is no benchmark with that name.
+MQLIB_OBJECT bool FindMQ2Benchmark(std::string_view Name, uint32_t& BMHandle);
+
+// Returns the benchmark tree of the last complete frame. The first node is the whole frame. It is
+// empty until a frame has completed. Main thread only.
+MQLIB_OBJECT const std::vector<MQBenchmarkNode>& GetBenchmarkFrameTree();
+
 // Enter the benchmark and start adding time.
 MQLIB_API void EnterMQ2Benchmark(uint32_t BMHandle);
 
 // Leave the benchmark.
 MQLIB_API void ExitMQ2Benchmark(uint32_t BMHandle);
 
+//----------------------------------------------------------------------------
+// Allocation tracking. While gbTrackAllocations is on, every call to operator new in MQ2Main and
+// in the plugins is counted, other than the aligned forms. The runtime is linked statically, so
+// each module has its own operator new and its own counters: MQ2Main's are returned by
+// GetMainAllocations and each plugin's are in its MQPlugin. Allocations are also counted against
+// the benchmarks the thread is inside of, whichever module made them. malloc and allocations made
+// by the game are not seen.
+
+struct MQAllocationCounters
+{
+	std::atomic<uint64_t> Count = 0;
+	std::atomic<uint64_t> Bytes = 0;
+};
+
+// Counts an allocation against the module's counters and the current thread's benchmarks. Called
+// from operator new, so it must not allocate.
+MQLIB_OBJECT void RecordAllocation(MQAllocationCounters& Counters, size_t Size);
+
+// Allocations made by MQ2Main.
+MQLIB_OBJECT const MQAllocationCounters& GetMainAllocations();
+
 //----------------------------------------------------------------------------
 // Scoped benchmark object, enters the benchmark at creation and leaves the benchmark at the end
 // of the current scope.
@@ -70,6 +157,49 @@ private:
 };
 
 
+//----------------------------------------------------------------------------
+// Frame tracing. While a trace is running (/mqtrace start), every benchmark that is left, every
+// frame and every trace event is recorded with its start time and duration into a ring buffer.
+// Stopping the trace writes the buffer out in the Chrome trace event format, which can be opened
+// in chrome://tracing or Perfetto.
+
+// Returns true if a trace is being recorded.
+MQLIB_OBJECT bool IsFrameTraceActive();
+
+// Records an event in the running trace. Does nothing if no trace is being recorded.
+MQLIB_OBJECT void AddTraceEvent(std::string_view Name, std::string_view Category,
+	std::chrono::steady_clock::time_point Start, std::chrono::steady_clock::time_point End);
+
+// Scoped trace event, records the time from its creation to the end of the current scope. Nothing
+// is recorded unless a trace was running when it was created. The name must outlive the object.
+//
+// Usage:
+//     MQScopedTraceEvent trace(scriptName, "lua");
+struct MQScopedTraceEvent
+{
+	MQScopedTraceEvent(std::string_view name, std::string_view category = "trace")
+		: m_name(name), m_category(category), m_active(IsFrameTraceActive())
+	{
+		if (m_active)
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	~MQScopedTraceEvent()
+	{
+		if (m_active)
+			AddTraceEvent(m_name, m_category, m_start, std::chrono::steady_clock::now());
+	}
+
+	MQScopedTraceEvent(const MQScopedTraceEvent&) = delete;
+	MQScopedTraceEvent& operator=(const MQScopedTraceEvent&) = delete;
+
+private:
+	std::string_view m_name;
+	std::string_view m_category;
+	std::chrono::steady_clock::time_point m_start;
+	bool m_active;
+};
+
 //----------------------------------------------------------------------------
 // Old-style benchmark macro. Prefer using MQScopedBenchmark instead.
 #ifdef DISABLE_BENCHMARKS
@@ -1474,10 +1474,25 @@ bool IGFD::FileInfos::FinalizeFileTypeParsing(const size_t& vMaxDotToExtract) {
 
 #pragma region FileManager
 
+bool IGFD::DirScanEntry::operator==(const DirScanEntry& rhs) const {
+    return fileNameExt == rhs.fileNameExt && fileType == rhs.fileType && fileType.isSymLink() == rhs.fileType.isSymLink() &&
+           hasStat == rhs.hasStat && fileSize == rhs.fileSize && fileModifTime == rhs.fileModifTime;
+}
+bool IGFD::DirScanEntry::operator!=(const DirScanEntry& rhs) const {
+    return !(*this == rhs);
+}
+
 IGFD::FileManager::FileManager() {
     fsRoot = std::string(1u, PATH_SEP);
 }
 
+IGFD::FileManager::~FileManager() {
+    m_CancelDirScan();
+    for (auto& scan : m_RetiredDirScans) {
+        scan.thread.join();
+    }
+}
+
 void IGFD::FileManager::OpenCurrentPath(const FileDialogInternal& vFileDialogInternal) {
     showDrives = false;
     ClearComposer();
@@ -1687,6 +1702,7 @@ void IGFD::FileManager::m_SortFields(const FileDialogInternal& vFileDialogIntern
 }
 
 void IGFD::FileManager::ClearFileLists() {
+    m_CancelDirScan();
     m_FilteredFileList.clear();
     m_FileList.clear();
 }
@@ -1696,14 +1712,13 @@ void IGFD::FileManager::ClearPathLists() {
     m_PathList.clear();
 }
 
-void IGFD::FileManager::m_AddFile(
-    const FileDialogInternal& vFileDialogInternal, const std::string& vPath, const std::string& vFileName, const FileType& vFileType) {
+void IGFD::FileManager::m_AddFile(const FileDialogInternal& vFileDialogInternal, const std::string& vPath, const DirScanEntry& vEntry) {
     auto infos = std::make_shared<FileInfos>();
 
     infos->filePath = vPath;
-    infos->fileNameExt = vFileName;
+    infos->fileNameExt = vEntry.fileNameExt;
     infos->fileNameExt_optimized = Utils::LowerCaseString(infos->fileNameExt);
-    infos->fileType = vFileType;
+    infos->fileType = vEntry.fileType;
 
     if (infos->fileNameExt.empty() ||
         (infos->fileNameExt == "." &&
@@ -1728,7 +1743,9 @@ void IGFD::FileManager::m_AddFile(
 
     vFileDialogInternal.filterManager.m_FillFileStyle(infos);
 
-    m_CompleteFileInfos(infos);
+    if (vEntry.hasStat) {
+        m_CompleteFileInfos(infos, vEntry.fileSize, vEntry.fileModifTime);
+    }
     m_FileList.push_back(infos);
 }
 
@@ -1777,94 +1794,233 @@ void IGFD::FileManager::ScanDir(const FileDialogInternal& vFileDialogInternal, c
             path += std::string(1u, PATH_SEP);
 #endif  // _IGFD_WIN_
 
-        ClearFileLists();
+        ClearFileLists();  // abandon the scan of the previous directory too
+
+        auto it = std::find_if(m_DirListingCache.begin(), m_DirListingCache.end(),
+            [&path](const DirListingCacheEntry& vEntry) { return vEntry.path == path; });
+        if (it != m_DirListingCache.end()) {
+            // show what was read last time right away, and read it again in case it changed since
+            m_DirListingCache.splice(m_DirListingCache.begin(), m_DirListingCache, it);
+            for (const auto& entry : *it->listing) {
+                m_AddFile(vFileDialogInternal, path, entry);
+            }
+            m_SortFields(vFileDialogInternal, m_FileList, m_FilteredFileList);
+
+            if (std::chrono::steady_clock::now() - it->scanTime >= std::chrono::milliseconds(DIR_LISTING_REFRESH_MS)) {
+                m_StartDirScan(path, true);
+            }
+        } else {
+            // entries are added as they are read, see UpdateDirScan
+            m_StartDirScan(path, false);
+        }
+    }
+}
+
+void IGFD::FileManager::m_StartDirScan(const std::string& vPath, bool vIsRefresh) {
+    m_CancelDirScan();
+
+    m_DirScan.job = std::make_shared<DirScanJob>();
+    m_DirScan.job->path = vPath;
+    m_DirScan.job->isRefresh = vIsRefresh;
+    m_DirScan.thread = std::thread(&IGFD::FileManager::m_ThreadDirScanFunc, m_DirScan.job);
+}
+
+void IGFD::FileManager::m_CancelDirScan() {
+    if (m_DirScan.job.use_count()) {
+        // the thread may be in a slow stat, don't wait for it here
+        m_DirScan.job->cancelled = true;
+        m_RetiredDirScans.push_back(std::move(m_DirScan));
+        m_DirScan = DirScan();
+    }
+}
+
+bool IGFD::FileManager::IsScanningDir() const {
+    return m_DirScan.job.use_count() != 0;
+}
+
+void IGFD::FileManager::UpdateDirScan(const FileDialogInternal& vFileDialogInternal) {
+    for (auto it = m_RetiredDirScans.begin(); it != m_RetiredDirScans.end();) {
+        if (it->job->done) {
+            it->thread.join();
+            it = m_RetiredDirScans.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!m_DirScan.job.use_count())
+        return;
+
+    auto job = m_DirScan.job;
+    const bool done = job->done;  // read before taking the pending entries, the thread publishes its last ones before setting it
+
+    DirScanListing entries;
+    {
+        std::lock_guard<std::mutex> lock(job->pendingMutex);
+        entries.swap(job->pending);
+    }
+
+    if (!job->isRefresh && !entries.empty()) {
+        for (const auto& entry : entries) {
+            m_AddFile(vFileDialogInternal, job->path, entry);
+        }
+        m_SortFields(vFileDialogInternal, m_FileList, m_FilteredFileList);
+    }
+
+    if (!done)
+        return;
+
+    m_DirScan.thread.join();
+    m_DirScan = DirScan();
+
+    auto listing = std::make_shared<const DirScanListing>(std::move(job->listing));
+
+    auto it = std::find_if(m_DirListingCache.begin(), m_DirListingCache.end(),
+        [&job](const DirListingCacheEntry& vEntry) { return vEntry.path == job->path; });
+    if (job->isRefresh && (it == m_DirListingCache.end() || *it->listing != *listing)) {
+        m_FilteredFileList.clear();
+        m_FileList.clear();
+        for (const auto& entry : *listing) {
+            m_AddFile(vFileDialogInternal, job->path, entry);
+        }
+        m_SortFields(vFileDialogInternal, m_FileList, m_FilteredFileList);
+    }
+
+    if (it != m_DirListingCache.end()) {
+        m_DirListingCache.erase(it);
+    }
+    m_DirListingCache.push_front({job->path, listing, std::chrono::steady_clock::now()});
+    if (m_DirListingCache.size() > DIR_LISTING_CACHE_SIZE) {
+        m_DirListingCache.pop_back();
+    }
+}
+
+void IGFD::FileManager::m_ThreadDirScanFunc(std::shared_ptr<DirScanJob> vJob) {
+    const std::string& path = vJob->path;
+
+    // entries are handed over in batches, a few times per second at most, so the dialog doesn't
+    // sort a growing list every frame
+    DirScanListing batch;
+    auto lastPublish = std::chrono::steady_clock::now();
+    auto publish = [&vJob, &batch, &lastPublish]() {
+        std::lock_guard<std::mutex> lock(vJob->pendingMutex);
+        vJob->pending.insert(vJob->pending.end(), batch.begin(), batch.end());
+        batch.clear();
+        lastPublish = std::chrono::steady_clock::now();
+    };
+
+    auto addEntry = [&](const std::string& vFileName, const FileType& vFileType) {
+        DirScanEntry entry;
+        entry.fileNameExt = vFileName;
+        entry.fileType = vFileType;
+
+        // the stat is what makes big directories slow, see m_CompleteFileInfos
+        if (vFileName != "." && vFileName != "..") {
+            auto fpn = path + std::string(1u, PATH_SEP) + vFileName;
+            struct stat statInfos = {};
+            if (!stat(fpn.c_str(), &statInfos)) {
+                entry.hasStat = true;
+                entry.fileSize = (size_t)statInfos.st_size;
+                entry.fileModifTime = statInfos.st_mtime;
+            }
+        }
+
+        vJob->listing.push_back(entry);
+        batch.push_back(std::move(entry));
+        if (std::chrono::steady_clock::now() - lastPublish >= std::chrono::milliseconds(100)) {
+            publish();
+        }
+    };
 
 #ifdef USE_STD_FILESYSTEM
-        try {
-            const std::filesystem::path fspath(path);
-            const auto dir_iter = std::filesystem::directory_iterator(fspath);
-            FileType fstype = FileType(FileType::ContentType::Directory, std::filesystem::is_symlink(std::filesystem::status(fspath)));
-            m_AddFile(vFileDialogInternal, path, "..", fstype);
-            for (const auto& file : dir_iter) {
-                FileType fileType;
-                if (file.is_symlink()) {
-                    fileType.SetSymLink(file.is_symlink());
-                    fileType.SetContent(FileType::ContentType::LinkToUnknown);
-                }
+    try {
+        const std::filesystem::path fspath(path);
+        const auto dir_iter = std::filesystem::directory_iterator(fspath);
+        FileType fstype = FileType(FileType::ContentType::Directory, std::filesystem::is_symlink(std::filesystem::status(fspath)));
+        addEntry("..", fstype);
+        for (const auto& file : dir_iter) {
+            if (vJob->cancelled)
+                break;
 
-                if (file.is_directory()) {
-                    fileType.SetContent(FileType::ContentType::Directory);
-                }  // directory or symlink to directory
-                else if (file.is_regular_file()) {
-                    fileType.SetContent(FileType::ContentType::File);
-                }
+            FileType fileType;
+            if (file.is_symlink()) {
+                fileType.SetSymLink(file.is_symlink());
+                fileType.SetContent(FileType::ContentType::LinkToUnknown);
+            }
 
-                if (fileType.isValid()) {
-                    auto fileNameExt = file.path().filename().string();
-                    m_AddFile(vFileDialogInternal, path, fileNameExt, fileType);
-                }
+            if (file.is_directory()) {
+                fileType.SetContent(FileType::ContentType::Directory);
+            }  // directory or symlink to directory
+            else if (file.is_regular_file()) {
+                fileType.SetContent(FileType::ContentType::File);
+            }
+
+            if (fileType.isValid()) {
+                auto fileNameExt = file.path().filename().string();
+                addEntry(fileNameExt, fileType);
             }
-        } catch (const std::exception& ex) {
-            printf("%s", ex.what());
         }
+    } catch (const std::exception& ex) {
+        printf("%s", ex.what());
+    }
 #else  // dirent
-        struct dirent** files = nullptr;
-        size_t n = scandir(path.c_str(), &files, nullptr, inAlphaSort);
-        if (n && files) {
-            size_t i;
+    struct dirent** files = nullptr;
+    size_t n = scandir(path.c_str(), &files, nullptr, inAlphaSort);
+    if (n && files) {
+        size_t i;
 
-            for (i = 0; i < n; i++) {
-                struct dirent* ent = files[i];
+        for (i = 0; i < n && !vJob->cancelled; i++) {
+            struct dirent* ent = files[i];
 
-                FileType fileType;
-                switch (ent->d_type) {
-                    case DT_DIR: fileType.SetContent(FileType::ContentType::Directory); break;
-                    case DT_REG: fileType.SetContent(FileType::ContentType::File); break;
+            FileType fileType;
+            switch (ent->d_type) {
+                case DT_DIR: fileType.SetContent(FileType::ContentType::Directory); break;
+                case DT_REG: fileType.SetContent(FileType::ContentType::File); break;
 #if defined(_IGFD_UNIX_) || (DT_LNK != DT_UNKNOWN)
-                    case DT_LNK:
+                case DT_LNK:
 #endif
-                    case DT_UNKNOWN: {
-                        struct stat sb = {};
+                case DT_UNKNOWN: {
+                    struct stat sb = {};
 #ifdef _IGFD_WIN_
-                        auto filePath = path + ent->d_name;
+                    auto filePath = path + ent->d_name;
 #else
-                        auto filePath = path + std::string(1u, PATH_SEP) + ent->d_name;
+                    auto filePath = path + std::string(1u, PATH_SEP) + ent->d_name;
 #endif
 
-                        if (!stat(filePath.c_str(), &sb)) {
-                            if (sb.st_mode & S_IFLNK) {
-                                fileType.SetSymLink(true);
-                                fileType.SetContent(FileType::ContentType::LinkToUnknown);  // by default if we can't figure out the
-                                                                                            // target type.
-                            }
-                            if (sb.st_mode & S_IFREG) {
-                                fileType.SetContent(FileType::ContentType::File);
-                                break;
-                            } else if (sb.st_mode & S_IFDIR) {
-                                fileType.SetContent(FileType::ContentType::Directory);
-                                break;
-                            }
+                    if (!stat(filePath.c_str(), &sb)) {
+                        if (sb.st_mode & S_IFLNK) {
+                            fileType.SetSymLink(true);
+                            fileType.SetContent(FileType::ContentType::LinkToUnknown);  // by default if we can't figure out the
+                                                                                        // target type.
+                        }
+                        if (sb.st_mode & S_IFREG) {
+                            fileType.SetContent(FileType::ContentType::File);
+                            break;
+                        } else if (sb.st_mode & S_IFDIR) {
+                            fileType.SetContent(FileType::ContentType::Directory);
+                            break;
                         }
-                        break;
                     }
-                    default: break;  // leave it invalid (devices, etc.)
-                }
-
-                if (fileType.isValid()) {
-                    m_AddFile(vFileDialogInternal, path, ent->d_name, fileType);
+                    break;
                 }
+                default: break;  // leave it invalid (devices, etc.)
             }
 
-            for (i = 0; i < n; i++) {
-                free(files[i]);
+            if (fileType.isValid()) {
+                addEntry(ent->d_name, fileType);
             }
+        }
 
-            free(files);
+        for (i = 0; i < n; i++) {
+            free(files[i]);
         }
-#endif  // USE_STD_FILESYSTEM
 
-        m_SortFields(vFileDialogInternal, m_FileList, m_FilteredFileList);
+        free(files);
     }
+#endif  // USE_STD_FILESYSTEM
+
+    publish();
+    vJob->done = true;
 }
 
 void IGFD::FileManager::m_ScanDirForPathSelection(const FileDialogInternal& vFileDialogInternal, const std::string& vPath) {
@@ -2111,29 +2267,36 @@ void IGFD::FileManager::m_CompleteFileInfos(const std::shared_ptr<FileInfos>& vI
             fpn = vInfos->filePath + std::string(1u, PATH_SEP) + vInfos->fileNameExt;
 
         struct stat statInfos = {};
-        char timebuf[100];
         int result = stat(fpn.c_str(), &statInfos);
         if (!result) {
-            if (!vInfos->fileType.isDir()) {
-                vInfos->fileSize = (size_t)statInfos.st_size;
-                vInfos->formatedFileSize = m_FormatFileSize(vInfos->fileSize);
-            }
+            m_CompleteFileInfos(vInfos, (size_t)statInfos.st_size, statInfos.st_mtime);
+        }
+    }
+}
 
-            size_t len = 0;
+void IGFD::FileManager::m_CompleteFileInfos(const std::shared_ptr<FileInfos>& vInfos, size_t vFileSize, time_t vModifTime) {
+    if (!vInfos.use_count())
+        return;
+
+    if (!vInfos->fileType.isDir()) {
+        vInfos->fileSize = vFileSize;
+        vInfos->formatedFileSize = m_FormatFileSize(vInfos->fileSize);
+    }
+
+    char timebuf[100];
+    size_t len = 0;
 #ifdef _MSC_VER
-            struct tm _tm;
-            errno_t err = localtime_s(&_tm, &statInfos.st_mtime);
-            if (!err)
-                len = strftime(timebuf, 99, DateTimeFormat, &_tm);
+    struct tm _tm;
+    errno_t err = localtime_s(&_tm, &vModifTime);
+    if (!err)
+        len = strftime(timebuf, 99, DateTimeFormat, &_tm);
 #else   // _MSC_VER
-            struct tm* _tm = localtime(&statInfos.st_mtime);
-            if (_tm)
-                len = strftime(timebuf, 99, DateTimeFormat, _tm);
+    struct tm* _tm = localtime(&vModifTime);
+    if (_tm)
+        len = strftime(timebuf, 99, DateTimeFormat, _tm);
 #endif  // _MSC_VER
-            if (len) {
-                vInfos->fileModifDate = std::string(timebuf, len);
-            }
-        }
+    if (len) {
+        vInfos->fileModifDate = std::string(timebuf, len);
     }
 }
 
@@ -2627,6 +2790,7 @@ void IGFD::FileDialogInternal::NewFrame() {
     isOk = false;          // reset dialog result
     fileManager.drivesClicked = false;
     fileManager.puPathClicked = false;
+    fileManager.UpdateDirScan(*this);
 
     needToExitDialog = false;
 
@@ -3766,7 +3930,7 @@ bool IGFD::FileDialog::Display(const std::string& vKey, ImGuiWindowFlags vFlags,
                 fdFilter.SetDefaultFilterIfNotDefined();
 
                 // init list of files
-                if (fdFile.IsFileListEmpty() && !fdFile.showDrives) {
+                if (fdFile.IsFileListEmpty() && !fdFile.showDrives && !fdFile.IsScanningDir()) {
                     if (fdFile.dLGpath != ".")  // Removes extension seperator in filename if we don't check
                         IGFD::Utils::ReplaceString(fdFile.dLGDefaultFileName, fdFile.dLGpath, "");  // local path
 
@@ -1257,6 +1257,9 @@ struct IGFD_Thumbnail_Info {
 #include <regex>
 #include <array>
 #include <mutex>
+#include <ctime>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <cfloat>
 #include <memory>
@@ -1316,6 +1319,14 @@ struct IGFD_Thumbnail_Info {
 #define EXT_MAX_LEVEL 10U
 #endif  // EXT_MAX_LEVEL
 
+#ifndef DIR_LISTING_CACHE_SIZE
+#define DIR_LISTING_CACHE_SIZE 8U  // count of recently visited directory listings kept
+#endif  // DIR_LISTING_CACHE_SIZE
+
+#ifndef DIR_LISTING_REFRESH_MS
+#define DIR_LISTING_REFRESH_MS 1000  // a cached listing younger than this is shown without reading the directory again
+#endif  // DIR_LISTING_REFRESH_MS
+
 #pragma endregion
 
 #pragma region IGFD NAMESPACE
@@ -1610,6 +1621,30 @@ public:
 
 #pragma region FileManager
 
+// an entry of a directory, as read by the directory scan thread
+struct IGFD_API DirScanEntry {
+    std::string fileNameExt;
+    FileType fileType;
+    bool hasStat = false;  // fileSize and fileModifTime are valid
+    size_t fileSize = 0U;
+    time_t fileModifTime = 0;
+
+    bool operator==(const DirScanEntry& rhs) const;
+    bool operator!=(const DirScanEntry& rhs) const;
+};
+typedef std::vector<DirScanEntry> DirScanListing;
+
+// a directory read on a background thread, shared by the thread and the file manager
+struct IGFD_API DirScanJob {
+    std::string path;
+    bool isRefresh = false;              // a cached listing is shown, the result replaces it only when complete
+    std::atomic<bool> cancelled{false};  // set by the file manager, the thread stops at the next entry
+    std::atomic<bool> done{false};       // set by the thread, the last entries are in pending
+    std::mutex pendingMutex;
+    DirScanListing pending;  // entries read but not taken yet by the file manager
+    DirScanListing listing;  // all entries read, only touched by the file manager once done
+};
+
 class IGFD_API FileManager {
 public:                            // types
     enum class SortingFieldEnum {  // sorting for filetering of the file lsit
@@ -1637,6 +1672,19 @@ private:
     std::set<std::string> m_SelectedFileNames;                   // the user selection of FilePathNames
     bool m_CreateDirectoryMode = false;                          // for create directory widget
 
+    struct DirScan {
+        std::shared_ptr<DirScanJob> job;
+        std::thread thread;
+    };
+    struct DirListingCacheEntry {
+        std::string path;
+        std::shared_ptr<const DirScanListing> listing;
+        std::chrono::steady_clock::time_point scanTime;
+    };
+    DirScan m_DirScan;                                 // scan of the current directory, if one is running
+    std::vector<DirScan> m_RetiredDirScans;            // cancelled scans whose thread isn't joined yet
+    std::list<DirListingCacheEntry> m_DirListingCache;  // recently visited directories, most recent first
+
 public:
     bool inputPathActivated = false;                             // show input for path edition
     bool drivesClicked = false;                                  // event when a drive button is clicked
@@ -1675,12 +1723,14 @@ private:
     static std::string m_RoundNumber(double vvalue, int n);                        // custom rounding number
     static std::string m_FormatFileSize(size_t vByteSize);                         // format file size field
     static void m_CompleteFileInfos(const std::shared_ptr<FileInfos>& FileInfos);  // set time and date infos of a file (detail view mode)
+    static void m_CompleteFileInfos(const std::shared_ptr<FileInfos>& vInfos,
+        size_t vFileSize,
+        time_t vModifTime);  // set time and date infos of a file from an already done stat
     void m_RemoveFileNameInSelection(const std::string& vFileName);                // selection : remove a file name
     void m_m_AddFileNameInSelection(const std::string& vFileName, bool vSetLastSelectionFileName);  // selection : add a file name
     void m_AddFile(const FileDialogInternal& vFileDialogInternal,
         const std::string& vPath,
-        const std::string& vFileName,
-        const FileType& vFileType);  // add file called by scandir
+        const DirScanEntry& vEntry);  // add file called by scandir
     void m_AddPath(const FileDialogInternal& vFileDialogInternal,
         const std::string& vPath,
         const std::string& vFileName,
@@ -1696,9 +1746,13 @@ private:
     void m_SortFields(const FileDialogInternal& vFileDialogInternal,
         std::vector<std::shared_ptr<FileInfos>>& vFileInfosList,
         std::vector<std::shared_ptr<FileInfos>>& vFileInfosFilteredList);  // will sort a column
+    void m_StartDirScan(const std::string& vPath, bool vIsRefresh);  // read a directory on a background thread
+    void m_CancelDirScan();                                          // abandon the running scan, if any
+    static void m_ThreadDirScanFunc(std::shared_ptr<DirScanJob> vJob);  // the thread who reads a directory
 
 public:
     FileManager();
+    ~FileManager();
     bool IsComposerEmpty();
     size_t GetComposerSize();
     bool IsFileListEmpty();
@@ -1736,6 +1790,8 @@ public:
     void SetCurrentDir(const std::string& vPath);   // define current directory for scan
     void ScanDir(const FileDialogInternal& vFileDialogInternal,
         const std::string& vPath);  // scan the directory for retrieve the file list
+    void UpdateDirScan(const FileDialogInternal& vFileDialogInternal);  // add what the scan thread read since the last frame
+    bool IsScanningDir() const;                                         // a directory is being read in the background
 
     std::string GetResultingPath();
     std::string GetResultingFileName(FileDialogInternal& vFileDialogInternal, IGFD_ResultMode vFlag);
@@ -2414,7 +2414,15 @@ void TextEditor::Colorize(int fromLine, int lineCount)
 	m_colorRangeMax = std::max(m_colorRangeMax, toLine);
 	m_colorRangeMin = std::max(0, m_colorRangeMin);
 	m_colorRangeMax = std::max(m_colorRangeMin, m_colorRangeMax);
-	m_checkComments = true;
+
+	// comments and strings are scanned again from the first changed line on
+	fromLine = std::max(0, fromLine);
+	if (fromLine < m_scanLine && fromLine < (int)m_lines.size())
+	{
+		m_scanLine = fromLine;
+		m_scanState = fromLine == 0 ? LineScanState() : m_lines[fromLine].scanState;
+	}
+	m_scanEnd = std::max(m_scanEnd, toLine);
 }
 
 void TextEditor::ColorizeRange(int fromLine, int toLine)
@@ -2524,152 +2532,185 @@ void TextEditor::ColorizeRange(int fromLine, int toLine)
 	}
 }
 
-void TextEditor::ColorizeInternal()
+void TextEditor::ScanLine(Line& line, LineScanState& state) const
 {
-	if (m_lines.empty() || !m_colorizerEnabled)
-		return;
+	constexpr int NoComment = std::numeric_limits<int>::max();
 
-	if (m_checkComments && m_languageDefinition.enabled)
+	if (!state.concatenate)
 	{
-		int endLine = (int)m_lines.size();
-		int endIndex = 0;
-		int commentStartLine = endLine;
-		int commentStartIndex = endIndex;
-		bool withinString = false;
-		bool withinSingleLineComment = false;
-		bool withinPreproc = false;
-		bool firstChar = true;          // there is no other non-whitespace characters in the line before
-		bool concatenate = false;       // '\' on the very end of the line
-		int currentLine = 0;
-		int currentIndex = 0;
+		state.withinSingleLineComment = false;
+		state.withinPreproc = false;
+		state.firstChar = true;
+	}
 
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			Line& line = m_lines[currentLine];
+	state.concatenate = false;
 
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
+	// index of the glyph the open multi-line comment starts at, -1 if it started on an earlier line
+	int commentStartIndex = state.withinComment ? -1 : NoComment;
+	int currentIndex = 0;
 
-			concatenate = false;
+	while (currentIndex < (int)line.glyphs.size())
+	{
+		Glyph& g = line.glyphs[currentIndex];
+		char c = g.ch;
 
-			if (!line.glyphs.empty())
-			{
-				Glyph& g = line.glyphs[currentIndex];
-				char c = g.ch;
+		if (c != m_languageDefinition.preprocChar && !isspace(c))
+			state.firstChar = false;
 
-				if (c != m_languageDefinition.preprocChar && !isspace(c))
-					firstChar = false;
+		if (currentIndex == (int)line.glyphs.size() - 1 && line.glyphs[line.glyphs.size() - 1].ch == '\\')
+			state.concatenate = true;
 
-				if (currentIndex == (int)line.glyphs.size() - 1 && line.glyphs[line.glyphs.size() - 1].ch == '\\')
-					concatenate = true;
+		bool inComment = commentStartIndex <= currentIndex;
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		if (state.withinString)
+		{
+			line.glyphs[currentIndex].multlineComment = inComment;
 
-				if (withinString)
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < (int)line.glyphs.size() && line.glyphs[currentIndex + 1].ch == '\"')
 				{
+					currentIndex += 1;
+					if (currentIndex < (int)line.glyphs.size())
+						line.glyphs[currentIndex].multlineComment = inComment;
+				}
+				else
+					state.withinString = false;
+			}
+			else if (c == '\\')
+			{
+				currentIndex += 1;
+				if (currentIndex < (int)line.glyphs.size())
 					line.glyphs[currentIndex].multlineComment = inComment;
+			}
+		}
+		else
+		{
+			if (state.firstChar && c == m_languageDefinition.preprocChar)
+				state.withinPreproc = true;
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.glyphs.size() && line.glyphs[currentIndex + 1].ch == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.glyphs.size())
-								line.glyphs[currentIndex].multlineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.glyphs.size())
-							line.glyphs[currentIndex].multlineComment = inComment;
-					}
+			if (c == '\"')
+			{
+				state.withinString = true;
+				line.glyphs[currentIndex].multlineComment = inComment;
+			}
+			else
+			{
+				auto pred = [](const char& a, const Glyph& b) { return a == b.ch; };
+				auto from = line.glyphs.begin() + currentIndex;
+
+				const std::string& startStr = m_languageDefinition.commentStart;
+				const std::string& singleStartStr = m_languageDefinition.singleLineComment;
+				const std::string& endStr = m_languageDefinition.commentEnd;
+
+				if (!state.withinSingleLineComment
+					&& currentIndex + startStr.size() <= line.glyphs.size()
+					&& equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+				{
+					commentStartIndex = currentIndex;
 				}
-				else
+				else if (!singleStartStr.empty()
+					&& currentIndex + singleStartStr.size() <= line.glyphs.size()
+					&& equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
 				{
-					if (firstChar && c == m_languageDefinition.preprocChar)
-						withinPreproc = true;
+					state.withinSingleLineComment = true;
+				}
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line.glyphs[currentIndex].multlineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.ch; };
-						auto from = line.glyphs.begin() + currentIndex;
+				inComment = commentStartIndex <= currentIndex;
 
-						const std::string& startStr = m_languageDefinition.commentStart;
-						const std::string& singleStartStr = m_languageDefinition.singleLineComment;
-						const std::string& endStr = m_languageDefinition.commentEnd;
+				line.glyphs[currentIndex].multlineComment = inComment;
+				line.glyphs[currentIndex].comment = state.withinSingleLineComment;
 
-						if (!withinSingleLineComment
-							&& currentIndex + startStr.size() <= line.glyphs.size()
-							&& equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
-						else if (!singleStartStr.empty()
-							&& currentIndex + singleStartStr.size() <= line.glyphs.size()
-							&& equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
+				if (currentIndex + 1 >= (int)endStr.size() &&
+					equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
+				{
+					commentStartIndex = NoComment;
+				}
+			}
+		}
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		if (currentIndex < (int)line.glyphs.size())
+			line.glyphs[currentIndex].preprocessor = state.withinPreproc;
+		currentIndex += UTF8CharLength(c);
+	}
 
-						line.glyphs[currentIndex].multlineComment = inComment;
-						line.glyphs[currentIndex].comment = withinSingleLineComment;
+	state.withinComment = commentStartIndex != NoComment;
+}
 
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
+void TextEditor::ColorizeInternal()
+{
+	if (m_lines.empty() || !m_colorizerEnabled)
+		return;
 
-				line.glyphs[currentIndex].preprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
+	// Both passes stop when the frame's share of time is spent and carry on next frame, so a large
+	// document is colored in over a few frames instead of stalling one. They check the clock every
+	// few lines, and always get through at least that many.
+	constexpr auto ColorizeBudget = std::chrono::microseconds(1000);
+	constexpr int LinesPerCheck = 4;
+	const auto deadline = std::chrono::steady_clock::now() + ColorizeBudget;
 
-				if (currentIndex >= (int)line.glyphs.size())
-				{
-					currentIndex = 0;
-					++currentLine;
-				}
-			}
-			else
+	const int lineCount = (int)m_lines.size();
+
+	if (m_scanLine < lineCount && m_languageDefinition.enabled)
+	{
+		const int firstLine = m_scanLine;
+		int currentLine = m_scanLine;
+		bool done = false;
+
+		while (true)
+		{
+			if (currentLine >= lineCount
+				|| (currentLine >= m_scanEnd && m_lines[currentLine].scanState == m_scanState))
 			{
-				currentIndex = 0;
-				++currentLine;
+				// past the edit and starting the same as last time, so the rest is unchanged
+				done = true;
+				break;
 			}
+
+			Line& line = m_lines[currentLine];
+			line.scanState = m_scanState;
+			ScanLine(line, m_scanState);
+			++currentLine;
+
+			if ((currentLine - firstLine) % LinesPerCheck == 0 && std::chrono::steady_clock::now() >= deadline)
+				break;
+		}
+
+		// lines past the edit that scanned differently need their colors redone too
+		m_colorRangeMin = std::min(m_colorRangeMin, firstLine);
+		m_colorRangeMax = std::max(m_colorRangeMax, currentLine);
+
+		if (done)
+		{
+			m_scanLine = std::numeric_limits<int>::max();
+			m_scanEnd = 0;
+		}
+		else
+		{
+			m_scanLine = currentLine;
 		}
-		m_checkComments = false;
+	}
+	else if (!m_languageDefinition.enabled)
+	{
+		m_scanLine = std::numeric_limits<int>::max();
+		m_scanEnd = 0;
 	}
 
-	if (m_colorRangeMin < m_colorRangeMax)
+	m_colorRangeMax = std::min(m_colorRangeMax, lineCount);
+	while (m_colorRangeMin < m_colorRangeMax)
 	{
-		const int increment = (m_languageDefinition.tokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(m_colorRangeMin + increment, m_colorRangeMax);
+		const int to = std::min(m_colorRangeMin + LinesPerCheck, m_colorRangeMax);
 		ColorizeRange(m_colorRangeMin, to);
 		m_colorRangeMin = to;
 
-		if (m_colorRangeMax == m_colorRangeMin)
-		{
-			m_colorRangeMin = std::numeric_limits<int>::max();
-			m_colorRangeMax = 0;
-		}
+		if (std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
 
-		return;
+	if (m_colorRangeMin >= m_colorRangeMax)
+	{
+		m_colorRangeMin = std::numeric_limits<int>::max();
+		m_colorRangeMax = 0;
 	}
 }
 
@@ -26,6 +26,7 @@
 #include <array>
 #include <chrono>
 #include <deque>
+#include <limits>
 #include <map>
 #include <memory>
 #include <regex>
@@ -197,9 +198,31 @@ using Glyphs = std::vector<Glyph>;
 
 //============================================================================
 
+// Where the comment and string scan stands at the start of a line. Kept with each line so that
+// after an edit the scan can start at the edited line and stop as soon as it reaches a line that
+// starts the same way it did before.
+struct LineScanState
+{
+	bool withinString = false;
+	bool withinComment = false;             // a multi-line comment is open
+	bool concatenate = false;               // the previous line ended in '\', the rest carry over only then
+	bool withinSingleLineComment = false;
+	bool withinPreproc = false;
+	bool firstChar = true;
+
+	bool operator==(const LineScanState& other) const
+	{
+		return withinString == other.withinString && withinComment == other.withinComment
+			&& concatenate == other.concatenate && withinSingleLineComment == other.withinSingleLineComment
+			&& withinPreproc == other.withinPreproc && firstChar == other.firstChar;
+	}
+	bool operator!=(const LineScanState& other) const { return !(*this == other); }
+};
+
 struct Line
 {
 	Glyphs glyphs;
+	LineScanState scanState;
 
 	std::string to_string() const;
 
@@ -396,6 +419,7 @@ private:
 	void Colorize(int fromLine = 0, int count = -1);
 	void ColorizeRange(int fromLine = 0, int toLine = 0);
 	void ColorizeInternal();
+	void ScanLine(Line& line, LineScanState& state) const;
 	float TextDistanceToLineStart(const Coordinates& from) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -464,7 +488,9 @@ private:
 	Palette m_palette;
 	LanguageDefinition m_languageDefinition;
 	RegexList m_regexList;
-	bool m_checkComments = true;
+	int m_scanLine = 0;                          // next line for the comment scan, int max when done
+	int m_scanEnd = std::numeric_limits<int>::max(); // the scan doesn't stop early before this line
+	LineScanState m_scanState;                   // state at the start of m_scanLine
 	Breakpoints m_breakPoints;
 	ErrorMarkers m_errorMarkers;
 	ImVec2 m_charAdvance;
@@ -23,8 +23,13 @@
 #include <shellapi.h>
 
 #include <wil/resource.h>
+#include <spdlog/spdlog.h>
+
+#include <deque>
 #include <filesystem>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <regex> // TODO: remove this and store account/server/char as separate fields in the profile struct
 
 #include <fmt/format.h>
@@ -749,6 +754,64 @@ bool ReadBlob(const std::string& profileName, const std::string& serverName, con
 	return false;
 }
 
+//============================================================================
+// Profile store
+//
+// Decrypting a profile means an ini read plus a DPAPI call, which adds up quickly with a few
+// hundred profiles. Profiles are decrypted once when the launcher starts and kept here, indexed by
+// profile, server and character. Edits are written through to the ini, which stays the on-disk
+// format because the autologin plugin reads it directly.
+
+struct StoredProfile
+{
+	ProfileRecord record;
+	std::string eqPath;
+};
+
+static std::unordered_map<std::string, StoredProfile> s_profileStore;
+static std::unordered_set<std::string> s_profileSections;
+static std::unordered_map<std::string, std::pair<std::string, HMENU>> s_profileMenus;
+
+static std::string GetProfileStoreKey(std::string_view profile, std::string_view server, std::string_view character)
+{
+	return to_lower_copy(fmt::format("{}:{}:{}", profile, server, character));
+}
+
+static StoredProfile& StoreProfile(const ProfileRecord& record, const std::string& eqPath)
+{
+	s_profileSections.insert(to_lower_copy(record.profileName));
+
+	StoredProfile& stored = s_profileStore[GetProfileStoreKey(record.profileName, record.serverName, record.characterName)];
+	stored.record = record;
+	stored.eqPath = eqPath;
+	return stored;
+}
+
+static StoredProfile* FindStoredProfile(const std::string& profileName, const std::string& serverName, const std::string& characterName)
+{
+	auto iter = s_profileStore.find(GetProfileStoreKey(profileName, serverName, characterName));
+	if (iter != s_profileStore.end())
+		return &iter->second;
+
+	// not something we loaded at startup, fall back to the ini
+	RawProfileRecord rawRecord;
+	if (!ReadBlob(profileName, serverName, characterName, rawRecord))
+		return nullptr;
+
+	ProfileRecord record = ProfileRecord::FromBlob(rawRecord.encryptedBlob);
+	record.profileName = profileName;
+	record.serverName = serverName;
+	record.characterName = characterName;
+	record.checked = rawRecord.checked;
+
+	return &StoreProfile(record, rawRecord.eqPath);
+}
+
+static void RemoveStoredProfile(const std::string& profileName, const std::string& serverName, const std::string& characterName)
+{
+	s_profileStore.erase(GetProfileStoreKey(profileName, serverName, characterName));
+}
+
 bool SaveBlob(const std::string& Profile, const std::string& Login, const std::string& Pass, const std::string& Server, const std::string& CharName,
 	const std::string& Path, const std::string& Hotkey, const std::string& CharClass, const int CharLevel, bool Checked, const std::string& lpINIPath)
 {
@@ -766,30 +829,36 @@ bool SaveBlob(const std::string& Profile, const std::string& Login, const std::s
 
 	WritePrivateProfileString(Profile, "EQPath", Path, lpINIPath);
 
-	// Find the matching profile and create it if it doesn't exist.
-	int NumProfiles = GetPrivateProfileInt("Profiles", "NumProfiles", 0, lpINIPath);
+	// Find the matching profile and create it if it doesn't exist. Profiles we already know
+	// about don't need the ini scanned again.
+	bool bProfileFound = lpINIPath == internal_paths::AutoLoginIni
+		&& s_profileSections.count(to_lower_copy(Profile)) != 0;
 
-	// Find the matching profile by searching the ini for an entry that matches the
-	// one we are trying to save. This works if there are no profiles, too.
-	bool bProfileFound = false;
-	for (int i = 0; i < NumProfiles; i++)
+	if (!bProfileFound)
 	{
-		std::string profileLabel = GetPrivateProfileString("Profiles", fmt::format("Profile{:d}", i + 1), "", lpINIPath);
-		if (ci_equals(profileLabel, Profile))
+		int NumProfiles = GetPrivateProfileInt("Profiles", "NumProfiles", 0, lpINIPath);
+
+		// Find the matching profile by searching the ini for an entry that matches the
+		// one we are trying to save. This works if there are no profiles, too.
+		for (int i = 0; i < NumProfiles; i++)
 		{
-			bProfileFound = true;
-			break;
+			std::string profileLabel = GetPrivateProfileString("Profiles", fmt::format("Profile{:d}", i + 1), "", lpINIPath);
+			if (ci_equals(profileLabel, Profile))
+			{
+				bProfileFound = true;
+				break;
+			}
 		}
-	}
 
-	if (!bProfileFound)
-	{
-		// Increase the number of profiles by 1 in the ini
-		NumProfiles++;
-		WritePrivateProfileInt("Profiles", "NumProfiles", NumProfiles, lpINIPath);
+		if (!bProfileFound)
+		{
+			// Increase the number of profiles by 1 in the ini
+			NumProfiles++;
+			WritePrivateProfileInt("Profiles", "NumProfiles", NumProfiles, lpINIPath);
 
-		// Write the new profile section name
-		WritePrivateProfileString("Profiles", fmt::format("Profile{:d}", NumProfiles), Profile, lpINIPath);
+			// Write the new profile section name
+			WritePrivateProfileString("Profiles", fmt::format("Profile{:d}", NumProfiles), Profile, lpINIPath);
+		}
 	}
 
 	std::string key = fmt::format("{}:{}_Blob", Server, CharName);
@@ -797,6 +866,22 @@ bool SaveBlob(const std::string& Profile, const std::string& Login, const std::s
 
 	WritePrivateProfileString(Profile, key, out, lpINIPath);
 
+	if (lpINIPath == internal_paths::AutoLoginIni)
+	{
+		ProfileRecord record;
+		record.profileName = Profile;
+		record.serverName = Server;
+		record.accountName = Login;
+		record.accountPassword = Pass;
+		record.characterName = CharName;
+		record.hotkey = Hotkey;
+		record.characterClass = CharClass;
+		record.characterLevel = CharLevel;
+		record.checked = Checked;
+
+		StoreProfile(record, Path);
+	}
+
 	return true;
 }
 
@@ -850,19 +935,25 @@ void SetLoaded(ProfileInfo pi, int id, HMENU hmenuPopup)
 	std::string server, characterName0;
 	ParseProfileMenuItem(pi.CharacterName, server, characterName0);
 
-	RawProfileRecord rawRecord;
-	ReadBlob(pi.profileName, server, characterName0, rawRecord);
+	StoredProfile* stored = FindStoredProfile(pi.profileName, server, characterName0);
+	if (!stored)
+		return;
 
 	if (!pi.PlayerLevel || (pi.PlayerLevel && pi.PlayerClass.length()))
 	{
-		ProfileRecord record = ProfileRecord::FromBlob(rawRecord.encryptedBlob);
-		record.hotkey = pi.Hotkey;
-		record.characterClass = pi.PlayerClass;
-		record.characterLevel = pi.PlayerLevel;
+		const ProfileRecord& record = stored->record;
+
+		// nothing to write if the character hasn't changed since we last saved it
+		if (record.hotkey == pi.Hotkey
+			&& record.characterClass == pi.PlayerClass
+			&& record.characterLevel == static_cast<int>(pi.PlayerLevel))
+		{
+			return;
+		}
 
 		SaveBlob(pi.profileName, record.accountName, record.accountPassword,
-			server, record.characterName, rawRecord.eqPath, record.hotkey, record.characterClass,
-			record.characterLevel, rawRecord.checked, pi.Inifile);
+			server, record.characterName, stored->eqPath, pi.Hotkey, pi.PlayerClass,
+			pi.PlayerLevel, record.checked, pi.Inifile);
 	}
 }
 
@@ -1001,6 +1092,221 @@ void DoPlainLogin(std::string_view Server, std::string_view Login, std::string_v
 	::CreateProcessA(nullptr, szParameters, nullptr, nullptr, FALSE, 0, nullptr, internal_paths::EQRoot.c_str(), &sei, &pi);
 }
 
+//============================================================================
+// Group launches
+//
+// Loading a whole profile group at once has every client hitting the login server and the
+// disk at the same moment. Instead, group launches go through a queue that starts a few
+// clients at a time. Each client reports its login phase back through the post office, and
+// the time it takes to get from the login screen to character select is used to widen or
+// narrow the number of clients that are allowed to be logging in at once.
+
+struct PendingLaunch
+{
+	std::string profileName;
+	DWORD id = 0;
+	int attempts = 0;
+};
+
+struct ActiveLaunch
+{
+	PendingLaunch launch;
+	std::chrono::steady_clock::time_point started;
+	std::chrono::steady_clock::time_point loginStarted;
+	bool atLogin = false;
+};
+
+static constexpr UINT_PTR LAUNCH_TIMER_ID = 0x4C41;
+static constexpr int MAX_LAUNCH_ATTEMPTS = 2;
+
+static std::deque<PendingLaunch> s_pendingLaunches;
+static std::unordered_map<DWORD, ActiveLaunch> s_activeLaunches;
+static std::chrono::steady_clock::time_point s_nextLaunchTime;
+static bool s_launchTimerActive = false;
+
+static int s_launchConcurrency = 3;
+static int s_launchWindow = 3;
+static std::chrono::milliseconds s_launchStagger{ 2000 };
+static std::chrono::seconds s_launchTimeout{ 180 };
+static double s_loginLatency = 0.0;        // smoothed login screen -> character select time, in ms
+static double s_loginLatencyBaseline = 0.0; // fastest login observed while the server was quiet
+
+static void CALLBACK LaunchTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+static void StopLaunchTimer()
+{
+	if (s_launchTimerActive)
+	{
+		KillTimer(hMainWnd, LAUNCH_TIMER_ID);
+		s_launchTimerActive = false;
+	}
+}
+
+static std::chrono::milliseconds GetLaunchStagger()
+{
+	// spread launches out so that login requests arrive about as fast as the server turns them around
+	auto paced = std::chrono::milliseconds(static_cast<int64_t>(s_loginLatency / std::max(s_launchWindow, 1)));
+	return std::max(s_launchStagger, paced);
+}
+
+static void RecordLoginLatency(std::chrono::steady_clock::duration elapsed)
+{
+	double sample = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+
+	s_loginLatency = s_loginLatency == 0.0 ? sample : s_loginLatency * 0.7 + sample * 0.3;
+	s_loginLatencyBaseline = s_loginLatencyBaseline == 0.0 ? sample : std::min(s_loginLatencyBaseline, sample);
+
+	if (s_loginLatency > s_loginLatencyBaseline * 2.0)
+	{
+		s_launchWindow = std::max(s_launchWindow - 1, 1);
+	}
+	else if (s_loginLatency < s_loginLatencyBaseline * 1.25)
+	{
+		s_launchWindow = std::min(s_launchWindow + 1, s_launchConcurrency);
+	}
+
+	SPDLOG_DEBUG("Login took {:.0f}ms (average {:.0f}ms, baseline {:.0f}ms), launching {} at a time",
+		sample, s_loginLatency, s_loginLatencyBaseline, s_launchWindow);
+}
+
+static void PumpLaunchQueue()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	for (auto it = s_activeLaunches.begin(); it != s_activeLaunches.end();)
+	{
+		if (now - it->second.started > s_launchTimeout)
+		{
+			SPDLOG_WARN("Login for profile {} (pid {}) timed out, releasing its launch slot", it->second.launch.profileName, it->first);
+			s_launchWindow = std::max(s_launchWindow - 1, 1);
+			it = s_activeLaunches.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	while (!s_pendingLaunches.empty()
+		&& static_cast<int>(s_activeLaunches.size()) < s_launchWindow
+		&& now >= s_nextLaunchTime)
+	{
+		PendingLaunch launch = std::move(s_pendingLaunches.front());
+		s_pendingLaunches.pop_front();
+
+		auto profile_it = LoginMap.find(launch.profileName);
+		if (profile_it == LoginMap.end())
+			continue;
+
+		auto login_it = profile_it->second.find(launch.id);
+		if (login_it == profile_it->second.end() || login_it->second.Loaded)
+			continue;
+
+		LoadIt(login_it->second, launch.id);
+
+		DWORD pid = login_it->second.PID;
+		if (login_it->second.Loaded && pid != 0)
+		{
+			++launch.attempts;
+			s_activeLaunches[pid] = ActiveLaunch{ std::move(launch), now };
+			s_nextLaunchTime = now + GetLaunchStagger();
+		}
+	}
+
+	if (s_pendingLaunches.empty() && s_activeLaunches.empty())
+	{
+		StopLaunchTimer();
+	}
+}
+
+static void CALLBACK LaunchTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+	PumpLaunchQueue();
+}
+
+static void QueueLaunch(const std::string& profileName, DWORD id)
+{
+	if (s_pendingLaunches.empty() && s_activeLaunches.empty())
+	{
+		s_launchConcurrency = std::clamp(GetPrivateProfileInt("Settings", "LaunchConcurrency", 3, internal_paths::AutoLoginIni), 1, 50);
+		s_launchStagger = std::chrono::milliseconds(std::max(GetPrivateProfileInt("Settings", "LaunchStagger", 2000, internal_paths::AutoLoginIni), 0));
+		s_launchTimeout = std::chrono::seconds(std::max(GetPrivateProfileInt("Settings", "LaunchTimeout", 180, internal_paths::AutoLoginIni), 30));
+		s_launchWindow = std::clamp(s_launchWindow, 1, s_launchConcurrency);
+	}
+
+	auto already_queued = [&](const PendingLaunch& launch) { return launch.profileName == profileName && launch.id == id; };
+	if (std::any_of(s_pendingLaunches.begin(), s_pendingLaunches.end(), already_queued))
+		return;
+
+	s_pendingLaunches.push_back(PendingLaunch{ profileName, id });
+
+	if (!s_launchTimerActive)
+	{
+		s_launchTimerActive = SetTimer(hMainWnd, LAUNCH_TIMER_ID, 250, LaunchTimerProc) != 0;
+	}
+
+	PumpLaunchQueue();
+}
+
+static void UpdateLaunchPhase(DWORD pid, proto::login::LoginPhaseMissive::Phase phase)
+{
+	auto it = s_activeLaunches.find(pid);
+	if (it == s_activeLaunches.end())
+		return;
+
+	ActiveLaunch& active = it->second;
+	auto now = std::chrono::steady_clock::now();
+
+	switch (phase)
+	{
+	case proto::login::LoginPhaseMissive::Login:
+		if (!active.atLogin)
+		{
+			active.atLogin = true;
+			active.loginStarted = now;
+		}
+		break;
+
+	case proto::login::LoginPhaseMissive::CharacterSelect:
+		if (active.atLogin)
+		{
+			RecordLoginLatency(now - active.loginStarted);
+			active.atLogin = false;
+		}
+		break;
+
+	case proto::login::LoginPhaseMissive::InGame:
+		// once in game the client is no longer competing for the login server
+		s_activeLaunches.erase(it);
+		PumpLaunchQueue();
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void RemoveLaunch(DWORD pid)
+{
+	auto it = s_activeLaunches.find(pid);
+	if (it == s_activeLaunches.end())
+		return;
+
+	// the client went away before making it in game, back off and give it another try
+	PendingLaunch launch = std::move(it->second.launch);
+	s_activeLaunches.erase(it);
+	s_launchWindow = std::max(s_launchWindow / 2, 1);
+
+	if (launch.attempts < MAX_LAUNCH_ATTEMPTS)
+	{
+		SPDLOG_WARN("Client for profile {} exited before logging in, retrying", launch.profileName);
+		s_pendingLaunches.push_front(std::move(launch));
+	}
+
+	s_nextLaunchTime = std::chrono::steady_clock::now() + GetLaunchStagger();
+	PumpLaunchQueue();
+}
+
 // Note that this function blindly assumes its related to autologin in the else case
 LRESULT HandleAutoLoginMenuRightclick(HMENU hSubMenu, int menuId, LPARAM lParam)
 {
@@ -1208,10 +1514,16 @@ bool HandleAutoLoginMenuCommand(WPARAM wParam, LPARAM lParam)
 
 								WritePrivateProfileString(pPopupinfo.CharacterName, keyName, blob, ini);
 							}
+
+							if (StoredProfile* stored = FindStoredProfile(pPopupinfo.CharacterName, szServer, szCharName))
+							{
+								stored->record.checked = bChecked;
+							}
 						}
 						else if (pPopupinfo.profileName == "Delete")
 						{
 							::WritePrivateProfileStringA(pPopupinfo.CharacterName.c_str(), keyName.c_str(), nullptr, ini.c_str());
+							RemoveStoredProfile(pPopupinfo.CharacterName, szServer, szCharName);
 							DeleteMenu(hProfilesMenu, pPopupinfo.PID, MF_BYCOMMAND);
 
 							piMap.erase(piIter);
@@ -1240,6 +1552,8 @@ bool HandleAutoLoginMenuCommand(WPARAM wParam, LPARAM lParam)
 									}
 								}
 
+								s_profileMenus.erase(to_lower_copy(pPopupinfo.CharacterName));
+
 								// delete the piMap too.
 								LoginMap.erase(iter);
 							}
@@ -1333,7 +1647,10 @@ bool HandleAutoLoginMenuCommand(WPARAM wParam, LPARAM lParam)
 
 					if (bChecked && pi.Loaded != loadAll)
 					{
-						LoadIt(pi, dwId);
+						if (loadAll)
+							QueueLaunch(szServer, dwId);
+						else
+							LoadIt(pi, dwId);
 					}
 				}
 			}
@@ -1486,72 +1803,40 @@ void FillProfile(const std::string& Profile, const std::string& Server, const st
 	sprintf_s(szStuff, "[%s] %s", Login.c_str(), Character.c_str());
 
 	bool bAddNewProfile = true;
-	auto szMenuDataBuffer = std::make_unique<char[]>(2048);
-
 	HMENU hAddMenu = nullptr;
 
-	int menuCount = GetMenuItemCount(hProfilesMenu);
-	for (int j = 0; j < menuCount; j++)
+	// profile submenus are indexed as they are created, so we don't have to walk the menus for
+	// every character when loading a large number of profiles.
+	auto menuIter = s_profileMenus.find(to_lower_copy(Profile));
+	if (menuIter != s_profileMenus.end())
 	{
-		// Get the title of this menu item
-		std::string menuTitle;
-
-		{
-			MENUITEMINFOA mi = { sizeof(MENUITEMINFOA) };
-			mi.fMask = MIIM_DATA | MIIM_SUBMENU | MIIM_ID | MIIM_STRING;
-			mi.dwTypeData = szMenuDataBuffer.get();
-			mi.cch = 2048;
-			GetMenuItemInfo(hProfilesMenu, j, TRUE, &mi);
+		const auto& [menuTitle, hMenuPopup2] = menuIter->second;
 
-			menuTitle = mi.dwTypeData ? mi.dwTypeData : "";
-		}
+		// Found the matching profile
+		bAddNewProfile = false;
 
-		// check if we found the menu we're looking for
-		if (ci_equals(menuTitle, Profile))
+		// Check if the character already exists in this profile.
+		ProfileMap& piMap = LoginMap[menuTitle];
+		for (auto& [menuId, pi] : piMap)
 		{
-			// Found the matching profile
-			bAddNewProfile = false;
-
-			// Look for matching character name
-			HMENU hMenuPopup2 = GetSubMenu(hProfilesMenu, j);
-			if (!hMenuPopup2)
-				continue;
-
-			// Search submenus for matching character menu
-			int subMenuCount = GetMenuItemCount(hMenuPopup2);
-			for (int i = 0; i < subMenuCount; i++)
+			if (ci_equals(pi.CharacterName, szStuff))
 			{
-				MENUITEMINFOA mi = { sizeof(MENUITEMINFOA) };
-				mi.dwTypeData = szMenuDataBuffer.get();
-				mi.fMask = MIIM_DATA | MIIM_SUBMENU | MIIM_ID | MIIM_STRING;
-				mi.cch = 2048;
-				GetMenuItemInfo(hMenuPopup2, i, TRUE, &mi);
+				// Update profile
+				pi.Hotkey = Hotkey;
+				pi.PlayerClass = CharClass;
+				pi.PlayerLevel = CharLevel;
 
-				const char* pMenuTitle2 = mi.dwTypeData;
+				if (pi.Loaded)
+					SetLoaded(pi, menuId, hMenuPopup2);
+				else
+					ResetLoaded(pi, menuId, hMenuPopup2);
 
-				// Check if the menu title starts with the expected prefix. If this matches it means the
-				// character menu item already exists.
-				if (pMenuTitle2 && pMenuTitle2[0] && _strnicmp(pMenuTitle2, szStuff, strlen(szStuff)) == 0)
-				{
-					// Update profile
-					ProfileInfo& pi = LoginMap[menuTitle][mi.wID];
-					pi.Hotkey = Hotkey;
-					pi.PlayerClass = CharClass;
-					pi.PlayerLevel = CharLevel;
-
-					if (pi.Loaded)
-						SetLoaded(pi, mi.wID, hMenuPopup2);
-					else
-						ResetLoaded(pi, mi.wID, hMenuPopup2);
-
-					return;
-				}
+				return;
 			}
-
-			// Profile exists but character doesn't. We'll add character to this menu
-			hAddMenu = hMenuPopup2;
-			break;
 		}
+
+		// Profile exists but character doesn't. We'll add character to this menu
+		hAddMenu = hMenuPopup2;
 	}
 
 	if (bAddNewProfile)
@@ -1569,6 +1854,8 @@ void FillProfile(const std::string& Profile, const std::string& Server, const st
 			SetMenuItemInfo(hProfilesMenu, parentMenuId, FALSE, &mi);
 		}
 
+		s_profileMenus[to_lower_copy(Profile)] = { Profile, hSubMenu };
+
 		// add "Load All" menu item
 		{
 			int menuId = ID_MENU_CHARACTER + gMenuItemCount;
@@ -1664,8 +1951,12 @@ void LoadProfiles()
 
 	for (ProfileGroup& pg : profiles)
 	{
+		std::string eqPath = GetPrivateProfileString(pg.profileName, "EQPath", "", internal_paths::AutoLoginIni);
+
 		for (ProfileRecord& record : pg.records)
 		{
+			StoreProfile(record, eqPath);
+
 			// add server name to character name
 			if (!record.serverName.empty())
 				record.characterName = fmt::format("{}->{}", record.serverName, record.characterName);
@@ -1680,6 +1971,8 @@ void LoadProfiles()
 // ideally we don't need to leak this function into Eventsink.
 void AutoLoginRemoveProcess(DWORD processId)
 {
+	RemoveLaunch(processId);
+
 	// eqgame terminated...
 	for (auto& i : LoginMap)
 	{
@@ -2072,6 +2365,17 @@ void ReceivedMessageHandler(ProtoMessagePtr&& message)
 
 		break;
 
+	case proto::login::MessageId::ProfileLoginPhase:
+		if (login_message.has_payload() && message->GetSender() && message->GetSender()->has_pid())
+		{
+			proto::login::LoginPhaseMissive phase;
+			phase.ParseFromString(login_message.payload());
+
+			UpdateLaunchPhase(message->GetSender()->pid(), phase.phase());
+		}
+
+		break;
+
 	case proto::login::MessageId::StartInstance:
 		if (login_message.has_payload())
 		{
@@ -2108,7 +2412,7 @@ void ReceivedMessageHandler(ProtoMessagePtr&& message)
 
 					if (login_it != login.end())
 					{
-						LoadIt(login_it->second, login_it->first);
+						QueueLaunch(start.profile().profile(), login_it->first);
 					}
 				}
 				break;
@@ -2206,5 +2510,12 @@ void InitializeAutoLogin()
 
 void ShutdownAutoLogin()
 {
+	StopLaunchTimer();
+	s_pendingLaunches.clear();
+	s_activeLaunches.clear();
+	s_profileStore.clear();
+	s_profileSections.clear();
+	s_profileMenus.clear();
+
 	s_dropbox.Remove();
 }
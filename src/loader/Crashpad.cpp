@@ -47,7 +47,7 @@ bool gEnableCrashpad = true;                                  // Indicates if we
 bool gEnableSharedCrashpad = true;                            // If using crashpad, use the shared crashpad process.
 bool gEnableSilentCrashpad = false;                           // If using crashpad, crash & report silently.
 bool gEnableCrashSubmissions = CRASHPAD_SUBMISSIONS_ENABLED;  // If using crashpad, we will submit them.
-bool gEnableRateLimit = false;                                // If using crashpad, upload rate limiting.
+bool gEnableRateLimit = CRASHPAD_SUBMISSIONS_RATELIMITED;     // If using crashpad, upload rate limiting.
 
 bool gCrashpadInitialized = false;                            // Internal state-tracking of initialization
 
@@ -61,6 +61,7 @@ bool InitializeCrashpad()
 	gEnableSilentCrashpad = GetPrivateProfileBool("Crash Handler", "EnableSilentCrashpad", gEnableSilentCrashpad, internal_paths::MQini);
 	gEnableCrashSubmissions = GetPrivateProfileBool("Crash Handler", "EnableCrashSubmissions", gEnableCrashSubmissions, internal_paths::MQini);
 	gCrashpadSubmissionURL = GetPrivateProfileString("Crash Handler", "CrashpadSubmissionURL", gCrashpadSubmissionURL.c_str(), internal_paths::MQini);
+	gEnableRateLimit = GetPrivateProfileBool("Crash Handler", "EnableRateLimit", gEnableRateLimit, internal_paths::MQini);
 
 	if (!gEnableCrashpad)
 	{
@@ -310,6 +310,12 @@ void SetForegroundWindowInternal(HWND hWnd)
 		if (IsIconic(hWnd))
 			ShowWindow(hWnd, SW_RESTORE);
 
+		// If the launcher is allowed to change the foreground right now (because of a hotkey or the
+		// tray), pass that on to every client, so that the next switch between them can be made
+		// by the clients themselves without coming back here.
+		for (DWORD processId : GetEQClientProcessIds())
+			::AllowSetForegroundWindow(processId);
+
 		if (!::SetForegroundWindow(hWnd) && !SendSetForegroundWindow(hWnd, gFocusProcessID))
 		{
 			SPDLOG_DEBUG("Failed to set foreground window. Doing it with min/restore.");
@@ -331,13 +337,20 @@ LRESULT HandleHotkey(WPARAM wParam, LPARAM lParam)
 		do
 		{
 			// Switch to the next or previous EQ window
-			auto eqGames = GetAllEqGameSessions();
+			auto eqGames = GetEQClientProcessIds();
 			if (eqGames.empty())
 			{
 				gLastEQGameSwitchedTo = 0;
 				return 0;
 			}
 
+			// go on from whichever client was brought up last, however that happened
+			if (retryCount == 0)
+			{
+				if (DWORD foreground = GetForegroundClientProcessId())
+					gLastEQGameSwitchedTo = foreground;
+			}
+
 			if (gLastEQGameSwitchedTo == 0)
 			{
 				gLastEQGameSwitchedTo = eqGames[0];
@@ -739,6 +752,11 @@ void HandleCommand(HWND hWnd, WPARAM wParam, LPARAM lParam)
 		SendUnloadAllCommand();
 		break;
 
+	case ID_ADVANCED_CLIENTPERFORMANCE:
+		UpdateShowConsole(true, false);
+		LogClientPerformance();
+		break;
+
 	case ID_MENU_CHECKAPPCOMPAT:
 	{
 		CheckAppCompat(true);
@@ -810,10 +828,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT MSG, WPARAM wParam, LPARAM lParam)
 		DWORD processId = (DWORD)wParam;
 		if (MSG == WM_USER_PROCESS_ADDED)
 		{
+			AddClientProcess(processId);
 			Inject(processId, 1s);
 		}
 		else
 		{
+			RemoveClientProcess(processId);
 			AutoLoginRemoveProcess(processId);
 		}
 		break;
@@ -1097,6 +1117,7 @@ int WINAPI CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR
 
 	InitializeNamedPipeServer();
 	InitializeWindows();
+	InitializeClientRegistry();
 	InitializeAutoLogin();
 
 	auto pMonitorEvents = std::make_unique<MQ2ProcessMonitorEvents>();
@@ -1185,6 +1206,7 @@ int WINAPI CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR
 	ShutdownInjector();
 	ShutdownNamedPipeServer();
 	StopProcessMonitor();
+	ShutdownClientRegistry();
 	if (injectOnce)
 		UpdateShowConsole(false, false);
 	ShutdownConsole();
@@ -130,6 +130,16 @@ void RefreshInjections();
 void ShutdownInjector();
 std::string GetInjecteePath();
 
+// Client registry (ProcessList)
+void InitializeClientRegistry();
+void ShutdownClientRegistry();
+void AddClientProcess(DWORD processId);
+void RemoveClientProcess(DWORD processId);
+void SetClientIdentity(DWORD processId, std::string_view account, std::string_view server, std::string_view character);
+void ClearClientIdentity(DWORD processId);
+std::vector<DWORD> GetEQClientProcessIds();
+DWORD GetForegroundClientProcessId();
+
 
 // Utility
 std::string GetVersionStringLocal(const std::filesystem::path& filePath);
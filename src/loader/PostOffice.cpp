@@ -25,8 +25,25 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
 
+#include <unordered_set>
+
 
 using namespace postoffice;
+
+// How long a frame budget lasts without being renewed. Clients report every 5 seconds, so this
+// covers a couple of missed reports before a client goes back to its own settings.
+static constexpr uint32_t FRAME_BUDGET_DURATION_MS = 15000;
+
+// Reports older than this aren't used to hand out budgets
+static constexpr std::chrono::seconds FRAME_BUDGET_REPORT_AGE = std::chrono::seconds(15);
+
+// Budgets are worked out again when a report comes in, but not more often than this
+static constexpr std::chrono::seconds FRAME_BUDGET_INTERVAL = std::chrono::seconds(1);
+
+// Most addresses that resolved recipients are remembered for. Scripts can make up addresses on
+// the fly, so the whole cache is dropped when it gets this big.
+static constexpr size_t MAX_RECIPIENT_CACHE_SIZE = 1024;
+
 class LauncherPostOffice : public PostOffice
 {
 private:
@@ -36,10 +53,35 @@ private:
 		std::string account;
 		std::string server;
 		std::string character;
+		std::string peerPipe;
+	};
+
+	struct ClientPerformance
+	{
+		MQMessagePerformanceReport report;
+		std::chrono::steady_clock::time_point received;
 	};
 
 	std::unordered_map<uint32_t, ClientIdentification> m_identities;
 	ci_unordered::map<std::string, uint32_t> m_names;
+
+	// the pids of every identified client by character, account and server, kept in step with
+	// m_identities so that resolving an address doesn't have to look at every client
+	ci_unordered::map<std::string, std::vector<uint32_t>> m_characterIndex;
+	ci_unordered::map<std::string, std::vector<uint32_t>> m_accountIndex;
+	ci_unordered::map<std::string, std::vector<uint32_t>> m_serverIndex;
+
+	// the clients that each address has resolved to, dropped whenever a client's identity changes
+	ci_unordered::map<std::string, std::vector<uint32_t>> m_recipientCache;
+	std::unordered_map<uint32_t, ClientPerformance> m_performance;
+
+	// main loop rate last given to each governed client
+	std::unordered_map<uint32_t, float> m_frameBudgets;
+	std::chrono::steady_clock::time_point m_lastFrameBudgets;
+
+	// the mailboxes of each client that has told us about them, for leaving clients out of mail
+	// for everyone that they would only drop
+	std::unordered_map<uint32_t, std::unordered_set<std::string>> m_clientMailboxes;
 	bool m_processing = false;
 	bool m_needsProcessing = false;
 
@@ -82,13 +124,16 @@ private:
 					}
 					else
 					{
-						m_postOffice->m_identities.insert_or_assign(id.pid(), ClientIdentification{
+						m_postOffice->AddIdentity(ClientIdentification{
 							id.pid(),
 							id.has_account() ? id.account() : "",
 							id.has_server() ? id.server() : "",
-							id.has_character() ? id.character() : ""
+							id.has_character() ? id.character() : "",
+							id.has_peer_pipe() ? id.peer_pipe() : ""
 							});
 
+						SetClientIdentity(id.pid(), id.account(), id.server(), id.character());
+
 						// only include the PID here, otherwise it's pseudonym-identifiable information from the logs
 						SPDLOG_INFO("Got identification from {}", id.pid());
 					}
@@ -112,6 +157,10 @@ private:
 
 						if (!client.character.empty())
 							id.set_character(client.character);
+
+						// the launcher doesn't use this, it only hands it out so clients can reach each other
+						if (!client.peerPipe.empty())
+							id.set_peer_pipe(client.peerPipe);
 						
 						m_postOffice->m_pipeServer.SendProtoMessage(
 							message->GetConnectionId(),
@@ -133,6 +182,15 @@ private:
 				}
 				break;
 
+			case mq::MQMessageId::MSG_MAILBOXES:
+				if (auto connection = m_postOffice->m_pipeServer.GetConnection(message->GetConnectionId()))
+				{
+					auto mailboxes = ProtoMessage::Parse<proto::routing::Mailboxes>(message);
+					m_postOffice->m_clientMailboxes.insert_or_assign(connection->GetProcessId(),
+						std::unordered_set<std::string>(mailboxes.names().begin(), mailboxes.names().end()));
+				}
+				break;
+
 			case mq::MQMessageId::MSG_MAIN_PROCESS_UNLOADED:
 				break;
 
@@ -146,6 +204,19 @@ private:
 				break;
 			}
 
+			case mq::MQMessageId::MSG_MAIN_PERFORMANCE_REPORT:
+				if (message->size() >= offsetof(MQMessagePerformanceReport, simulationFPS))
+				{
+					// older clients send a shorter report, leave the rest at the defaults
+					MQMessagePerformanceReport report;
+					memcpy(&report, message->get<MQMessagePerformanceReport>(), std::min<size_t>(message->size(), sizeof(report)));
+
+					m_postOffice->m_performance.insert_or_assign(report.processId,
+						ClientPerformance{ report, std::chrono::steady_clock::now() });
+					m_postOffice->UpdateFrameBudgets();
+				}
+				break;
+
 			case mq::MQMessageId::MSG_MAIN_FOCUS_REQUEST: {
 				if (message->size() >= sizeof(MQMessageFocusRequest))
 				{
@@ -237,8 +308,13 @@ private:
 						SPDLOG_INFO("Disconnection detected, dropping ID from {}", id.pid());
 				broadcast(std::move(id));
 
-				m_postOffice->m_identities.erase(ident_it);
+				m_postOffice->RemoveIdentity(processId);
+				ClearClientIdentity(processId);
 			}
+
+			m_postOffice->m_performance.erase(processId);
+			m_postOffice->m_frameBudgets.erase(processId);
+			m_postOffice->m_clientMailboxes.erase(processId);
 		}
 
 		private:
@@ -274,13 +350,112 @@ public:
 			(!address.has_character() || ci_equals(address.character(), id.character));
 	}
 
-	auto FindIdentity(
-		const proto::routing::Address& address,
-		const std::unordered_map<uint32_t, ClientIdentification>::iterator& from)
+	// Clients only deliver mail for everyone to a mailbox with exactly that name, so there is no
+	// point sending it to the ones that don't have one.
+	bool HasMailbox(uint32_t pid, const proto::routing::Address& address) const
 	{
-		return std::find_if(from, m_identities.end(),
-			[&address](const std::pair<uint32_t, ClientIdentification>& pair)
-			{ return IsRecipient(address, pair.second); });
+		if (!address.has_mailbox())
+			return true;
+
+		auto mailboxes_it = m_clientMailboxes.find(pid);
+		return mailboxes_it == m_clientMailboxes.end() || mailboxes_it->second.count(address.mailbox()) > 0;
+	}
+
+	void AddIdentity(ClientIdentification&& id)
+	{
+		// a client identifies again whenever it logs in or out, so forget what it was before
+		RemoveIdentity(id.pid);
+
+		m_characterIndex[id.character].push_back(id.pid);
+		m_accountIndex[id.account].push_back(id.pid);
+		m_serverIndex[id.server].push_back(id.pid);
+
+		m_identities.emplace(id.pid, std::move(id));
+		m_recipientCache.clear();
+	}
+
+	void RemoveIdentity(uint32_t pid)
+	{
+		auto ident_it = m_identities.find(pid);
+		if (ident_it == m_identities.end())
+			return;
+
+		auto unindex = [pid](ci_unordered::map<std::string, std::vector<uint32_t>>& index, const std::string& key)
+			{
+				auto index_it = index.find(key);
+				if (index_it == index.end())
+					return;
+
+				auto& pids = index_it->second;
+				pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+				if (pids.empty())
+					index.erase(index_it);
+			};
+
+		unindex(m_characterIndex, ident_it->second.character);
+		unindex(m_accountIndex, ident_it->second.account);
+		unindex(m_serverIndex, ident_it->second.server);
+
+		m_identities.erase(ident_it);
+		m_recipientCache.clear();
+	}
+
+	// Returns the pid of every identified client that the account, server and character of the
+	// address match. The result is only good until the next identity is added or removed.
+	const std::vector<uint32_t>& FindRecipients(const proto::routing::Address& address)
+	{
+		// separate the parts with characters that can't be in any of them, and mark the missing
+		// ones, since a missing part matches everything but an empty one doesn't
+		auto keyPart = [](bool has, const std::string& value) { return has ? value : std::string("\x1e"); };
+		std::string key = fmt::format("{}\x1f{}\x1f{}",
+			keyPart(address.has_account(), address.account()),
+			keyPart(address.has_server(), address.server()),
+			keyPart(address.has_character(), address.character()));
+
+		auto cache_it = m_recipientCache.find(key);
+		if (cache_it != m_recipientCache.end())
+			return cache_it->second;
+
+		if (m_recipientCache.size() >= MAX_RECIPIENT_CACHE_SIZE)
+			m_recipientCache.clear();
+
+		std::vector<uint32_t>& recipients = m_recipientCache[key];
+
+		// start from the most specific part of the address there is, and check the rest of it
+		// against each of those clients
+		const std::vector<uint32_t>* candidates = nullptr;
+		auto lookup = [&candidates](const ci_unordered::map<std::string, std::vector<uint32_t>>& index, const std::string& value)
+			{
+				auto index_it = index.find(value);
+				if (index_it != index.end())
+					candidates = &index_it->second;
+			};
+
+		if (address.has_character())
+			lookup(m_characterIndex, address.character());
+		else if (address.has_account())
+			lookup(m_accountIndex, address.account());
+		else if (address.has_server())
+			lookup(m_serverIndex, address.server());
+		else
+		{
+			recipients.reserve(m_identities.size());
+			for (const auto& [pid, _] : m_identities)
+				recipients.push_back(pid);
+
+			return recipients;
+		}
+
+		if (candidates != nullptr)
+		{
+			for (uint32_t pid : *candidates)
+			{
+				if (IsRecipient(address, m_identities.at(pid)))
+					recipients.push_back(pid);
+			}
+		}
+
+		return recipients;
 	}
 
 	void RouteMessage(PipeMessagePtr&& message, const PipeMessageResponseCb& callback) override
@@ -289,17 +464,20 @@ public:
 			RouteMessage(std::move(message));
 		else // routing will fail here if there are too many recipients
 		{
-			auto envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
-			auto identity = FindIdentity(envelope.address(), m_identities.begin());
+			// only the addresses are needed to route, the payload is passed on as it is
+			proto::routing::Envelope envelope;
+			std::string_view payload;
+			OpenEnvelope(*message, envelope, payload);
+			const std::vector<uint32_t>& recipients = FindRecipients(envelope.address());
 
-			if (identity == m_identities.end())
+			if (recipients.empty())
 				RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), callback);
-			else if (FindIdentity(envelope.address(), std::next(identity)) != m_identities.end())
+			else if (recipients.size() > 1)
 				RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), callback);
 			else
 			{
 				message->SetRequestMode(MQRequestMode::CallAndResponse);
-				SendMessageToPID(identity->first, std::move(message),
+				SendMessageToPID(recipients.front(), std::move(message),
 					[callback](const PipeConnectionPtr& connection, PipeMessagePtr&& message)
 					{ connection->SendMessageWithResponse(std::move(message), callback); },
 					[&envelope, callback](int status, PipeMessagePtr&& message)
@@ -311,7 +489,9 @@ public:
 	void RouteMessage(
 		PipeMessagePtr&& message)
 	{
-		auto envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
+		proto::routing::Envelope envelope;
+		std::string_view payload;
+		OpenEnvelope(*message, envelope, payload);
 		const auto& address = envelope.address();
 		auto routing_failed = [&envelope, this](int status, PipeMessagePtr&& message)
 			{
@@ -360,29 +540,38 @@ public:
 		}
 		else if (message->GetRequestMode() == MQRequestMode::CallAndResponse)
 		{
-			auto identity = FindIdentity(envelope.address(), m_identities.begin());
+			const std::vector<uint32_t>& recipients = FindRecipients(envelope.address());
 
-			if (identity == m_identities.end())
+			if (recipients.empty())
 				RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), nullptr);
-			else if (FindIdentity(envelope.address(), std::next(identity)) != m_identities.end())
+			else if (recipients.size() > 1)
 				RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), nullptr);
 			else
-				SendMessageToPID(identity->first, std::move(message), single_send, routing_failed);
+				SendMessageToPID(recipients.front(), std::move(message), single_send, routing_failed);
 		}
 		else
 		{
 			// we don't have a PID or a name and this is not an RPC, so we will send this message to 
-			// all clients that match the address -- it's important to copy these messages
-			for (const auto& identity : m_identities)
+			// all clients that match the address. They all get the same message, so it is shared
+			// instead of copied for each of them
+			SharedPipeMessagePtr shared;
+
+			for (uint32_t pid : FindRecipients(address))
 			{
-				if (IsRecipient(address, identity.second))
+				if (!HasMailbox(pid, address))
+					continue;
+
+				auto connection = m_pipeServer.GetConnectionForProcessId(pid);
+				if (connection == nullptr)
 				{
-					SendMessageToPID(
-						identity.first,
-						std::make_unique<PipeMessage>(*message->GetHeader(), message->get(), message->size()),
-						single_send,
-						routing_failed);
+					SPDLOG_WARN("Unable to get connection for PID {}, message route failed.", pid);
+					continue;
 				}
+
+				if (!shared)
+					shared = std::move(message);
+
+				connection->SendMessage(shared);
 			}
 		}
 	}
@@ -440,6 +629,170 @@ public:
 		m_pipeServer.BroadcastMessage(mq::MQMessageId::MSG_MAIN_REQ_FORCEUNLOAD, nullptr, 0);
 	}
 
+	void SendFrameBudget(uint32_t pid, float simulationFPS)
+	{
+		if (auto connection = m_pipeServer.GetConnectionForProcessId(pid))
+		{
+			MQMessageFrameBudget budget;
+			budget.simulationFPS = simulationFPS;
+			budget.durationMs = FRAME_BUDGET_DURATION_MS;
+
+			m_pipeServer.SendMessage(connection->GetConnectionId(), mq::MQMessageId::MSG_MAIN_FRAME_BUDGET,
+				&budget, sizeof(budget));
+		}
+	}
+
+	// With a cpu target set, splits it between the clients in the background by the frame rate each
+	// one is allowed, so that idle clients give up cpu to those that are fighting or casting. Clients
+	// in the foreground or zoning keep their own settings and their usage comes off the top.
+	void UpdateFrameBudgets()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (now - m_lastFrameBudgets < FRAME_BUDGET_INTERVAL)
+			return;
+
+		m_lastFrameBudgets = now;
+
+		const float cpuTarget = GetPrivateProfileFloat("Frame Governor", "CpuTarget", 0.0f, internal_paths::MQini);
+		if (cpuTarget <= 0.0f)
+		{
+			// hand control back to every client that has a budget
+			for (const auto& [pid, _] : m_frameBudgets)
+				SendFrameBudget(pid, 0.0f);
+
+			m_frameBudgets.clear();
+			return;
+		}
+
+		const float minFPS = std::max(GetPrivateProfileFloat("Frame Governor", "MinFPS", 1.0f, internal_paths::MQini), 0.1f);
+		const float maxFPS = std::max(GetPrivateProfileFloat("Frame Governor", "MaxFPS", 60.0f, internal_paths::MQini), minFPS);
+		const float activeWeight = std::max(GetPrivateProfileFloat("Frame Governor", "ActiveWeight", 4.0f, internal_paths::MQini), 1.0f);
+
+		struct Share
+		{
+			uint32_t pid;
+			float costPerFrame;                  // cpu percent for each frame per second
+			float weight;
+			float fps = 0.0f;
+		};
+
+		std::vector<Share> shares;
+		float available = cpuTarget;
+
+		for (const auto& [pid, client] : m_performance)
+		{
+			const MQMessagePerformanceReport& report = client.report;
+			if (now - client.received > FRAME_BUDGET_REPORT_AGE)
+				continue;
+
+			// clients that can't take a budget (too old to report their rate) only count against the target
+			if (report.simulationFPS <= 0.0f
+				|| (report.activity & (MQClientActivity_Foreground | MQClientActivity_Zoning)) != 0)
+			{
+				available -= report.cpuUsage;
+
+				if (m_frameBudgets.erase(pid) > 0)
+					SendFrameBudget(pid, 0.0f);
+				continue;
+			}
+
+			const bool active = (report.activity & (MQClientActivity_InCombat | MQClientActivity_Casting)) != 0;
+			shares.push_back({ pid, std::max(report.cpuUsage, 0.01f) / report.simulationFPS, active ? activeWeight : 1.0f });
+		}
+
+		available = std::max(available, 0.0f);
+
+		// Give each client its weighted part of what is left. Clients that would go past the maximum
+		// are capped there and the rest goes around again to those that are left.
+		std::vector<Share*> pending;
+		for (Share& share : shares)
+			pending.push_back(&share);
+
+		while (!pending.empty())
+		{
+			float totalWeight = 0.0f;
+			for (const Share* share : pending)
+				totalWeight += share->weight;
+
+			auto capped = std::stable_partition(pending.begin(), pending.end(),
+				[&](const Share* share) { return available * share->weight / totalWeight / share->costPerFrame < maxFPS; });
+			if (capped == pending.end())
+			{
+				for (Share* share : pending)
+					share->fps = std::max(available * share->weight / totalWeight / share->costPerFrame, minFPS);
+				break;
+			}
+
+			for (auto it = capped; it != pending.end(); ++it)
+			{
+				(*it)->fps = maxFPS;
+				available = std::max(available - maxFPS * (*it)->costPerFrame, 0.0f);
+			}
+
+			pending.erase(capped, pending.end());
+		}
+
+		for (const Share& share : shares)
+		{
+			SPDLOG_DEBUG("Frame budget for {}: {:.1f} fps", share.pid, share.fps);
+
+			m_frameBudgets.insert_or_assign(share.pid, share.fps);
+			SendFrameBudget(share.pid, share.fps);
+		}
+	}
+
+	// Writes the last performance report from every client as one table, slowest client first.
+	void LogClientPerformance()
+	{
+		if (m_performance.empty())
+		{
+			SPDLOG_INFO("No performance reports have been received from any clients.");
+			return;
+		}
+
+		std::vector<const ClientPerformance*> clients;
+		clients.reserve(m_performance.size());
+		for (const auto& [_, client] : m_performance)
+			clients.push_back(&client);
+
+		std::sort(clients.begin(), clients.end(),
+			[](const ClientPerformance* a, const ClientPerformance* b) { return a->report.frameTimeP95 > b->report.frameTimeP95; });
+
+		const auto now = std::chrono::steady_clock::now();
+
+		fmt::memory_buffer table;
+		fmt::format_to(std::back_inserter(table), "Client performance ({} clients, times in ms):\n", clients.size());
+		fmt::format_to(std::back_inserter(table), "{:>7}  {:<24} {:>6} {:>7} {:>7} {:>7} {:>7} {:>6} {:>8} {:>8} {:>9} {:>7} {:>6} {:>5}\n",
+			"PID", "Character", "Frames", "p50", "p95", "p99", "Max", "CPU%", "WS MB", "Priv MB", "Lines/s", "Lua", "Budget", "Age");
+
+		for (const ClientPerformance* client : clients)
+		{
+			const MQMessagePerformanceReport& report = client->report;
+
+			std::string name;
+			auto ident_it = m_identities.find(report.processId);
+			if (ident_it != m_identities.end() && !ident_it->second.character.empty())
+				name = fmt::format("{} ({})", ident_it->second.character, ident_it->second.server);
+
+			std::string budget = "-";
+			auto budget_it = m_frameBudgets.find(report.processId);
+			if (budget_it != m_frameBudgets.end())
+				budget = fmt::format("{:.1f}", budget_it->second);
+
+			fmt::format_to(std::back_inserter(table),
+				"{:>7}  {:<24} {:>6} {:>7.2f} {:>7.2f} {:>7.2f} {:>7.2f} {:>6.1f} {:>8.1f} {:>8.1f} {:>9.0f} {:>7.3f} {:>6} {:>4}s\n",
+				report.processId, name, report.frameCount,
+				report.frameTimeP50, report.frameTimeP95, report.frameTimeP99, report.frameTimeMax,
+				report.cpuUsage,
+				static_cast<double>(report.workingSet) / (1024 * 1024),
+				static_cast<double>(report.privateBytes) / (1024 * 1024),
+				report.macroLinesPerSecond, report.luaTimePerFrame, budget,
+				std::chrono::duration_cast<std::chrono::seconds>(now - client->received).count());
+		}
+
+		SPDLOG_INFO("{}", fmt::to_string(table));
+	}
+
 	void Initialize()
 	{
 		m_pipeServer.SetHandler(std::make_shared<PipeEventsHandler>(this));
@@ -520,6 +873,11 @@ void SendForceUnloadAllCommand()
 	static_cast<LauncherPostOffice&>(GetPostOffice()).SendForceUnloadAllCommand();
 }
 
+void LogClientPerformance()
+{
+	static_cast<LauncherPostOffice&>(GetPostOffice()).LogClientPerformance();
+}
+
 void ProcessPipeServer()
 {
 	static_cast<LauncherPostOffice&>(GetPostOffice()).ProcessPipeServer();
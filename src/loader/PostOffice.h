@@ -17,6 +17,7 @@
 bool SendSetForegroundWindow(HWND hWnd, uint32_t processID);
 void SendUnloadAllCommand();
 void SendForceUnloadAllCommand();
+void LogClientPerformance();
 void ProcessPipeServer();
 
 void InitializeNamedPipeServer();
@@ -25,6 +25,8 @@
 #include <filesystem>
 #include <thread>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #define _PEPARSE_WINDOWS_CONFLICTS
 #include <pe-parse/parse.h>
@@ -32,11 +34,14 @@
 namespace fs = std::filesystem;
 using namespace std::chrono_literals;
 
-static std::thread s_injectorThread;
+static std::vector<std::thread> s_injectorThreads;
 static std::condition_variable s_cv;
 static std::mutex s_mutex;
 static std::atomic_bool s_injectorRunning = false;
 
+// Injections are spread over a few workers, so that clients launched together don't wait on each other.
+const size_t MAX_INJECTOR_THREADS = 8;
+
 // Delay before a process is injected.
 const std::chrono::milliseconds NEW_PROCESS_INJECTION_DELAY_MS = 1s;
 
@@ -59,6 +64,9 @@ struct InjectRequest
 
 static std::vector<InjectRequest> s_injectRequests;
 
+// Processes that a worker is injecting right now. Their other requests wait until it is done.
+static std::unordered_set<uint32_t> s_injectingProcesses;
+
 using ParsedPeRef = std::unique_ptr<peparse::parsed_pe, void (*)(peparse::parsed_pe*)>;
 
 ParsedPeRef openExecutable(const std::string& path)
@@ -404,33 +412,53 @@ bool IsInjected(DWORD processId)
 	return bInjected;
 }
 
-bool IsEQGameProcessId(DWORD processId)
+static uint64_t GetProcessCreationTime(DWORD processId)
 {
-	wil::unique_tool_help_snapshot hSnapshot(CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, processId));
-	if (!hSnapshot.is_valid())
-		return false;
+	wil::unique_process_handle hProcess(::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId));
+	if (!hProcess.is_valid())
+		return 0;
 
-	MODULEENTRY32 me32 = { 0 };
-	me32.dwSize = sizeof(MODULEENTRY32);
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!::GetProcessTimes(hProcess.get(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0;
 
-	bool success = false;
+	return (static_cast<uint64_t>(creationTime.dwHighDateTime) << 32) | creationTime.dwLowDateTime;
+}
 
-	if (Module32First(hSnapshot.get(), &me32))
+// Returns the base address of eqgame.exe in the process, or 0 if the process isn't eqgame.exe. A
+// process keeps its main module where it was loaded, so this is only looked up once per process. The
+// creation time tells a process apart from a later one that reuses its id. Processes that aren't
+// eqgame.exe aren't remembered, a process that was just created may not list its modules yet.
+static uintptr_t FindEQGameModule(DWORD processId)
+{
+	struct CachedModule
 	{
-		if (!_stricmp(me32.szModule, "eqgame.exe"))
+		uint64_t creationTime;
+		uintptr_t baseAddress;
+	};
+
+	static std::mutex s_moduleMutex;
+	static std::unordered_map<DWORD, CachedModule> s_modules;
+
+	const uint64_t creationTime = GetProcessCreationTime(processId);
+
+	if (creationTime != 0)
+	{
+		std::scoped_lock lock(s_moduleMutex);
+
+		auto iter = s_modules.find(processId);
+		if (iter != s_modules.end())
 		{
-			success = true;
+			if (iter->second.creationTime == creationTime)
+				return iter->second.baseAddress;
+
+			s_modules.erase(iter);
 		}
 	}
 
-	return success;
-}
-
-uintptr_t GetEQGameBaseAddressByPID(DWORD processId)
-{
 	wil::unique_tool_help_snapshot hSnapshot(CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, processId));
 	if (!hSnapshot.is_valid())
-		return false;
+		return 0;
 
 	MODULEENTRY32 me32 = { 0 };
 	me32.dwSize = sizeof(MODULEENTRY32);
@@ -445,30 +473,29 @@ uintptr_t GetEQGameBaseAddressByPID(DWORD processId)
 		}
 	}
 
+	if (baseAddr != 0 && creationTime != 0)
+	{
+		std::scoped_lock lock(s_moduleMutex);
+		s_modules[processId] = CachedModule{ creationTime, baseAddr };
+	}
+
 	return baseAddr;
 }
 
-HMODULE GetEQGameModuleByPID(DWORD processId)
+bool IsEQGameProcessId(DWORD processId)
 {
-	HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, processId);
-	if (hSnapshot == INVALID_HANDLE_VALUE)
-		return nullptr;
-
-	MODULEENTRY32 me32 = { 0 };
-	me32.dwSize = sizeof(MODULEENTRY32);
-
-	HMODULE hModule = nullptr;
+	return FindEQGameModule(processId) != 0;
+}
 
-	if (Module32First(hSnapshot, &me32))
-	{
-		if (!_stricmp(me32.szModule, "eqgame.exe"))
-		{
-			hModule = me32.hModule;
-		}
-	}
+uintptr_t GetEQGameBaseAddressByPID(DWORD processId)
+{
+	return FindEQGameModule(processId);
+}
 
-	CloseHandle(hSnapshot);
-	return hModule;
+HMODULE GetEQGameModuleByPID(DWORD processId)
+{
+	// the module handle of an exe is its base address
+	return reinterpret_cast<HMODULE>(FindEQGameModule(processId));
 }
 
 std::pair<std::string, std::string> GetEQGameVersionStrings(const std::string& Path)
@@ -655,6 +682,68 @@ std::pair<std::string, std::string> GetEQGameVersionStrings(const std::string& P
 	return { eqDate, eqTime };
 }
 
+// Every client is usually the same eqgame.exe, so the version is only read out of the file again when it changes.
+// The lock is held while reading it, so clients that are launched together all wait on the first one to read it.
+// The versions are also kept in Config/VersionCache.ini, so that a restart doesn't have to read the file either.
+static std::pair<std::string, std::string> GetCachedEQGameVersionStrings(const std::string& path)
+{
+	struct CachedVersion
+	{
+		uintmax_t size;
+		int64_t writeTime;
+		std::string date;
+		std::string time;
+	};
+
+	static std::mutex s_versionMutex;
+	static std::unordered_map<std::string, CachedVersion> s_versions;
+
+	std::scoped_lock lock(s_versionMutex);
+
+	std::error_code ec;
+	const uintmax_t size = fs::file_size(path, ec);
+	const int64_t writeTime = ec ? 0 : fs::last_write_time(path, ec).time_since_epoch().count();
+
+	if (ec)
+	{
+		return GetEQGameVersionStrings(path);
+	}
+
+	auto iter = s_versions.find(path);
+	if (iter != s_versions.end() && iter->second.size == size && iter->second.writeTime == writeTime)
+	{
+		return { iter->second.date, iter->second.time };
+	}
+
+	const std::string cacheFile = (fs::path(internal_paths::Config) / "VersionCache.ini").string();
+
+	if (GetPrivateProfileString(path, "Size", "", cacheFile) == std::to_string(size)
+		&& GetPrivateProfileString(path, "WriteTime", "", cacheFile) == std::to_string(writeTime))
+	{
+		std::string date = GetPrivateProfileString(path, "Date", "", cacheFile);
+		std::string time = GetPrivateProfileString(path, "Time", "", cacheFile);
+
+		if (!date.empty() && !time.empty())
+		{
+			s_versions[path] = CachedVersion{ size, writeTime, date, time };
+			return { date, time };
+		}
+	}
+
+	auto [date, time] = GetEQGameVersionStrings(path);
+	if (!date.empty() && !time.empty())
+	{
+		s_versions[path] = CachedVersion{ size, writeTime, date, time };
+
+		WritePrivateProfileString(path, "Size", std::to_string(size), cacheFile);
+		WritePrivateProfileString(path, "WriteTime", std::to_string(writeTime), cacheFile);
+		WritePrivateProfileString(path, "Date", date, cacheFile);
+		WritePrivateProfileString(path, "Time", time, cacheFile);
+	}
+
+	return { date, time };
+}
+
 std::string GetInjecteePath()
 {
 	static std::string path;
@@ -815,8 +904,113 @@ bool ForceRemoteUnload()
 	return false;
 }
 
-// Get the EQ Window handle for the given process id
-HWND GetEQWindowHandleForProcessId(DWORD processId)
+//----------------------------------------------------------------------------
+// Client registry
+//
+// What the launcher knows about each running EQ client: its window, which character it is logged
+// into (as the client reports it over the post office) and whether its window is in the
+// foreground. Windows are picked up from window events rather than by enumerating every top level
+// window each time one is needed. All of this is updated on the main thread, the lock is for the
+// occasional lookup from elsewhere.
+
+struct EQClientInfo
+{
+	HWND hWnd = nullptr;
+	std::string account;
+	std::string server;
+	std::string character;
+	bool foreground = false;
+
+	// window creation and destruction in this client only
+	HWINEVENTHOOK hWindowHook = nullptr;
+};
+
+static std::mutex s_clientsMutex;
+static std::unordered_map<DWORD, EQClientInfo> s_clients;
+static HWINEVENTHOOK s_foregroundHook = nullptr;
+
+static bool IsEQWindow(HWND hWnd)
+{
+	char className[32];
+	return GetClassName(hWnd, className, 32) && strcmp(className, "_EverQuestwndclass") == 0;
+}
+
+static void CALLBACK OnClientWindowEvent(HWINEVENTHOOK, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD, DWORD);
+
+// Called with the lock held.
+static EQClientInfo& AddClientLocked(DWORD processId)
+{
+	auto [iter, added] = s_clients.try_emplace(processId);
+	if (added)
+	{
+		iter->second.hWindowHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, nullptr,
+			OnClientWindowEvent, processId, 0, WINEVENT_OUTOFCONTEXT);
+	}
+
+	return iter->second;
+}
+
+static void TrackEQWindow(HWND hWnd)
+{
+	DWORD processId = 0;
+	GetWindowThreadProcessId(hWnd, &processId);
+	if (processId == 0)
+		return;
+
+	std::scoped_lock lock(s_clientsMutex);
+	EQClientInfo& client = AddClientLocked(processId);
+	client.hWnd = hWnd;
+	client.foreground = hWnd == GetForegroundWindow();
+}
+
+static void CALLBACK OnClientWindowEvent(HWINEVENTHOOK, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD, DWORD)
+{
+	if (hWnd == nullptr || idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+		return;
+
+	switch (event)
+	{
+	case EVENT_OBJECT_CREATE:
+		if (GetAncestor(hWnd, GA_PARENT) == GetDesktopWindow() && IsEQWindow(hWnd))
+			TrackEQWindow(hWnd);
+		break;
+
+	case EVENT_OBJECT_DESTROY: {
+		std::scoped_lock lock(s_clientsMutex);
+		for (auto& [_, client] : s_clients)
+		{
+			if (client.hWnd == hWnd)
+			{
+				client.hWnd = nullptr;
+				client.foreground = false;
+			}
+		}
+		break;
+	}
+
+	case EVENT_SYSTEM_FOREGROUND: {
+		bool found = false;
+		{
+			std::scoped_lock lock(s_clientsMutex);
+			for (auto& [_, client] : s_clients)
+			{
+				client.foreground = client.hWnd == hWnd;
+				found |= client.foreground;
+			}
+		}
+
+		// a window created before its process was known
+		if (!found && IsEQWindow(hWnd))
+			TrackEQWindow(hWnd);
+		break;
+	}
+
+	default: break;
+	}
+}
+
+// Finds the window by looking at every top level window, for when the registry doesn't know it.
+static HWND FindEQWindowForProcessId(DWORD processId)
 {
 	struct Param
 	{
@@ -833,8 +1027,7 @@ HWND GetEQWindowHandleForProcessId(DWORD processId)
 		if (otherProcessId != param->processId)
 			return TRUE;
 
-		char className[32];
-		if (!GetClassName(hWnd, className, 32) || strcmp(className, "_EverQuestwndclass"))
+		if (!IsEQWindow(hWnd))
 			return TRUE;
 
 		param->outHWnd = hWnd;
@@ -846,30 +1039,149 @@ HWND GetEQWindowHandleForProcessId(DWORD processId)
 	return p.outHWnd;
 }
 
-// Returns list of currently active EQ window handles
-std::vector<HWND> GetEQWindowHandles()
+void InitializeClientRegistry()
 {
-	struct Param
+	s_foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr,
+		OnClientWindowEvent, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+
+	// pick up the clients that were running before the launcher
+	EnumWindows([](HWND hWnd, LPARAM) -> BOOL
+		{
+			if (IsEQWindow(hWnd))
+				TrackEQWindow(hWnd);
+
+			return TRUE;
+		}, 0);
+}
+
+void ShutdownClientRegistry()
+{
+	if (s_foregroundHook)
 	{
-		std::vector<HWND> hWnds;
-	};
+		UnhookWinEvent(s_foregroundHook);
+		s_foregroundHook = nullptr;
+	}
 
-	WNDENUMPROC enumProc = [](HWND hWnd, LPARAM lParam) -> BOOL
+	std::scoped_lock lock(s_clientsMutex);
+	for (auto& [_, client] : s_clients)
 	{
-		Param* param = reinterpret_cast<Param*>(lParam);
+		if (client.hWindowHook)
+			UnhookWinEvent(client.hWindowHook);
+	}
 
-		char className[32];
-		if (!GetClassName(hWnd, className, 32) || strcmp(className, "_EverQuestwndclass"))
-			return TRUE;
+	s_clients.clear();
+}
 
-		param->hWnds.push_back(hWnd);
-		return TRUE;
-	};
+void AddClientProcess(DWORD processId)
+{
+	std::scoped_lock lock(s_clientsMutex);
+	AddClientLocked(processId);
+}
 
-	Param p;
-	EnumWindows(enumProc, reinterpret_cast<LPARAM>(&p));
+void RemoveClientProcess(DWORD processId)
+{
+	std::scoped_lock lock(s_clientsMutex);
 
-	return p.hWnds;
+	auto iter = s_clients.find(processId);
+	if (iter != s_clients.end())
+	{
+		if (iter->second.hWindowHook)
+			UnhookWinEvent(iter->second.hWindowHook);
+
+		s_clients.erase(iter);
+	}
+}
+
+void SetClientIdentity(DWORD processId, std::string_view account, std::string_view server, std::string_view character)
+{
+	std::scoped_lock lock(s_clientsMutex);
+
+	EQClientInfo& client = AddClientLocked(processId);
+	client.account = account;
+	client.server = server;
+	client.character = character;
+}
+
+void ClearClientIdentity(DWORD processId)
+{
+	std::scoped_lock lock(s_clientsMutex);
+
+	auto iter = s_clients.find(processId);
+	if (iter != s_clients.end())
+	{
+		iter->second.account.clear();
+		iter->second.server.clear();
+		iter->second.character.clear();
+	}
+}
+
+// Returns the process ids of the clients that have a window, in process id order.
+std::vector<DWORD> GetEQClientProcessIds()
+{
+	std::vector<DWORD> processIds;
+
+	{
+		std::scoped_lock lock(s_clientsMutex);
+		for (const auto& [processId, client] : s_clients)
+		{
+			if (client.hWnd != nullptr)
+				processIds.push_back(processId);
+		}
+	}
+
+	std::sort(processIds.begin(), processIds.end());
+	return processIds;
+}
+
+// Returns the process id of the client whose window is in the foreground, or 0.
+DWORD GetForegroundClientProcessId()
+{
+	std::scoped_lock lock(s_clientsMutex);
+	for (const auto& [processId, client] : s_clients)
+	{
+		if (client.foreground)
+			return processId;
+	}
+
+	return 0;
+}
+
+// Get the EQ Window handle for the given process id
+HWND GetEQWindowHandleForProcessId(DWORD processId)
+{
+	{
+		std::scoped_lock lock(s_clientsMutex);
+
+		auto iter = s_clients.find(processId);
+		if (iter != s_clients.end() && iter->second.hWnd != nullptr)
+		{
+			if (IsWindow(iter->second.hWnd))
+				return iter->second.hWnd;
+
+			iter->second.hWnd = nullptr;
+		}
+	}
+
+	HWND hWnd = FindEQWindowForProcessId(processId);
+	if (hWnd != nullptr)
+		TrackEQWindow(hWnd);
+
+	return hWnd;
+}
+
+// Returns list of currently active EQ window handles
+std::vector<HWND> GetEQWindowHandles()
+{
+	std::vector<HWND> hWnds;
+
+	std::scoped_lock lock(s_clientsMutex);
+	for (const auto& [_, client] : s_clients)
+	{
+		if (client.hWnd != nullptr && IsWindow(client.hWnd))
+			hWnds.push_back(client.hWnd);
+	}
+
+	return hWnds;
 }
 
 // the preferred base of eqgame.exe
@@ -879,9 +1191,18 @@ constexpr uintptr_t EQGamePreferredAddress = 0x140000000;
 constexpr uintptr_t EQGamePreferredAddress = 0x400000;
 #endif // defined(_WIN64)
 
-// Read from an EQ process and find the name of the current character
+// Find the name of the current character in an EQ process. Clients identify themselves to the
+// post office when they log in, otherwise it is read out of the process.
 std::string GetLocalPlayer(DWORD pid)
 {
+	{
+		std::scoped_lock lock(s_clientsMutex);
+
+		auto iter = s_clients.find(pid);
+		if (iter != s_clients.end() && !iter->second.character.empty())
+			return iter->second.character;
+	}
+
 	// If its not eqgame.exe this will be empty
 	HMODULE hEQGameMod = GetEQGameModuleByPID(pid);
 	if (!hEQGameMod)
@@ -984,7 +1305,7 @@ static InjectResult DoInject(uint32_t PID)
 	char szOutPath[MAX_STRING] = { 0 };
 	::GetModuleFileNameExA(hEQGame.get(), hEqGameMod, szOutPath, MAX_STRING);
 
-	auto [clientDate, clientTime] = GetEQGameVersionStrings(szOutPath);
+	auto [clientDate, clientTime] = GetCachedEQGameVersionStrings(szOutPath);
 
 	if (clientDate.empty() || clientTime.empty())
 	{
@@ -1074,77 +1395,67 @@ void InjectorThread(bool injectOnce)
 {
 	SPDLOG_DEBUG("Injector thread started");
 
-	do
-	{
-		std::unique_lock lock(s_mutex);
-
-		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-		std::chrono::milliseconds wait_for = 5s;
-
-		// Grab a list of the requests that we should be processing *right now*
-		std::vector<InjectRequest> requests;
+	std::unique_lock lock(s_mutex);
 
-		const auto startRequests = s_injectRequests.size();
+	while (s_injectorRunning)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point wakeTime = now + 5s;
 
-		// Check the request list. Any element that has its inject time being >= than current time
-		// should be injected and then removed from the list.
-		s_injectRequests.erase(std::remove_if(std::begin(s_injectRequests), std::end(s_injectRequests),
-			[&now, &wait_for, &requests](InjectRequest& request)
+		// Take the first request that is due and whose process isn't already being injected.
+		auto next = std::find_if(std::begin(s_injectRequests), std::end(s_injectRequests),
+			[&now, &wakeTime](const InjectRequest& request)
 			{
-				if (now >= request.injectTime)
-				{
-					requests.push_back(request);
-					return true;
-				}
-				else
+				if (now < request.injectTime)
 				{
 					// calculate next wakeup time
-					auto remaining = request.injectTime - now;
-					if (remaining < wait_for)
-						wait_for = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+					wakeTime = std::min(wakeTime, request.injectTime);
+					return false;
 				}
 
-				return false;
-			}), std::end(s_injectRequests));
+				return s_injectingProcesses.count(request.processId) == 0;
+			});
 
-		// unlock the mutex while we try to process the list
-		lock.unlock();
+		if (next == std::end(s_injectRequests))
+		{
+			s_cv.wait_until(lock, wakeTime);
+			continue;
+		}
 
-		// Process entries and remove all the completions from the list.
-		requests.erase(std::remove_if(std::begin(requests), std::end(requests),
-			[&now, &wait_for](InjectRequest& request)
-			{
-				InjectResult result = DoInject(request.processId);
-				if (result == InjectResult::FailedRetry)
-				{
-					if (request.retries > 0)
-					{
-						SPDLOG_INFO("Scheduling injection for retry: pid={0} retriesLeft={1}", request.processId, request.retries - 1);
+		InjectRequest request = *next;
+		s_injectRequests.erase(next);
+		s_injectingProcesses.insert(request.processId);
 
-						--request.retries;
-						request.injectTime = now + 1s;
+		// unlock the mutex while we inject
+		lock.unlock();
 
+		InjectResult result = DoInject(request.processId);
+		bool retry = false;
 
-						return false;
-					}
-				}
-				return true;
-			}), std::end(requests));
+		if (result == InjectResult::FailedRetry && request.retries > 0)
+		{
+			SPDLOG_INFO("Scheduling injection for retry: pid={0} retriesLeft={1}", request.processId, request.retries - 1);
+
+			--request.retries;
+			request.injectTime = std::chrono::steady_clock::now() + 1s;
+			retry = true;
+		}
 
-		// Re-lock and copy back to the list
 		lock.lock();
 
-		for (const InjectRequest& request : requests)
-			s_injectRequests.push_back(request);
+		s_injectingProcesses.erase(request.processId);
 
-		s_cv.wait_for(lock, wait_for);
+		// other workers may be waiting on this process, or on a later wake time than the retry
+		if (retry)
+			s_injectRequests.push_back(request);
+		s_cv.notify_all();
 
-		if (injectOnce && s_injectRequests.size() < startRequests)
+		if (injectOnce && !retry)
 		{
 			SPDLOG_DEBUG("Injected at least once, stopping");
 			PostMessage(hMainWnd, WM_QUIT, 0, 0);
 		}
-	} while (s_injectorRunning);
+	}
 
 	SPDLOG_DEBUG("Injector thread finished");
 }
@@ -1204,9 +1515,14 @@ bool InitializeInjector(bool injectOnce)
 		return false;
 	}
 
-	// Start the injector thread
+	// Start the injector threads
 	s_injectorRunning = true;
-	s_injectorThread = std::thread(InjectorThread, injectOnce);
+
+	const size_t threadCount = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_INJECTOR_THREADS);
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		s_injectorThreads.emplace_back(InjectorThread, injectOnce);
+	}
 
 	InjectAllRunningProcesses();
 	return true;
@@ -1214,11 +1530,20 @@ bool InitializeInjector(bool injectOnce)
 
 void ShutdownInjector()
 {
-	s_injectorRunning = false;
-	s_cv.notify_one();
+	{
+		std::scoped_lock lock(s_mutex);
+		s_injectorRunning = false;
+	}
+
+	s_cv.notify_all();
+
+	for (std::thread& thread : s_injectorThreads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
 
-	if (s_injectorThread.joinable())
-		s_injectorThread.join();
+	s_injectorThreads.clear();
 }
 
 void RefreshInjections()
@@ -22,6 +22,9 @@
 #include <wil/resource.h>
 #include <spdlog/spdlog.h>
 #include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -266,6 +269,9 @@ bool StartWMIProcessMonitor()
 
 #pragma region ToolHelp Process Monitor
 
+// Finds new eqgame.exe processes by scanning the process list, and waits for them to exit on the thread
+// pool. A registered wait costs nothing until the process exits, and isn't limited to MAXIMUM_WAIT_OBJECTS
+// like waiting on all of them from this thread would be.
 class ToolHelpProcessMonitor : public ProcessMonitor
 {
 public:
@@ -276,11 +282,35 @@ public:
 	virtual void Stop() override;
 
 private:
+	struct WatchedProcess
+	{
+		ToolHelpProcessMonitor* monitor = nullptr;
+		DWORD processId = 0;
+		wil::unique_process_handle hProcess;
+		HANDLE hWait = nullptr;
+	};
+
 	void ThreadProc();
+	void ScanProcesses(bool initial);
+	void HandleExitedProcesses();
+	void UnwatchProcess(WatchedProcess& process);
+
+	static void CALLBACK OnProcessExit(void* context, BOOLEAN timedOut);
+
+	// how often to look for new processes
+	static constexpr DWORD SCAN_INTERVAL_MS = 5000;
 
 	wil::unique_event m_event;
+	wil::unique_event m_exitEvent;
 	std::atomic_bool m_running{ false };
 	std::thread m_thread;
+
+	// only touched by the monitor thread
+	std::unordered_map<DWORD, std::unique_ptr<WatchedProcess>> m_processes;
+
+	// processes that exited, from the thread pool
+	std::mutex m_exitMutex;
+	std::vector<DWORD> m_exited;
 };
 
 ToolHelpProcessMonitor::ToolHelpProcessMonitor()
@@ -297,9 +327,10 @@ void ToolHelpProcessMonitor::Start()
 	if (m_running)
 		return;
 
-	m_thread = std::thread([this]() { ThreadProc(); });
-	m_running = true;
 	m_event.create(wil::EventOptions::ManualReset);
+	m_exitEvent.create(wil::EventOptions::None);
+	m_running = true;
+	m_thread = std::thread([this]() { ThreadProc(); });
 }
 
 void ToolHelpProcessMonitor::Stop()
@@ -313,111 +344,125 @@ void ToolHelpProcessMonitor::Stop()
 		m_thread.join();
 }
 
-void ToolHelpProcessMonitor::ThreadProc()
+void CALLBACK ToolHelpProcessMonitor::OnProcessExit(void* context, BOOLEAN /*timedOut*/)
 {
-	// vector of open processes. the unique_process_handle will keep the handle
-	// open while we wait on it.
-	std::vector<std::pair<DWORD, wil::unique_process_handle>> allProcesses;
-	std::vector<DWORD> processList;
-	std::vector<HANDLE> waitList;
-	waitList.push_back(m_event.get());
-	bool initial = true;
-	bool switchToWMI = false;
+	WatchedProcess* process = static_cast<WatchedProcess*>(context);
+	ToolHelpProcessMonitor* monitor = process->monitor;
 
-	do
 	{
-		processList.clear();
-		processList.reserve(allProcesses.size()); // Assume that nothing changed
-
-		// Retrieve process list
-		wil::unique_tool_help_snapshot hSnapshot(CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0));
+		std::scoped_lock lock(monitor->m_exitMutex);
+		monitor->m_exited.push_back(process->processId);
+	}
 
-		if (hSnapshot.is_valid())
-		{
-			PROCESSENTRY32 proc = { sizeof(PROCESSENTRY32) };
+	monitor->m_exitEvent.SetEvent();
+}
 
-			if (Process32First(hSnapshot.get(), &proc))
-			{
-				do
-				{
-					if (ci_equals(proc.szExeFile, "eqgame.exe"))
-					{
-						processList.push_back(proc.th32ProcessID);
-					}
-				} while (Process32Next(hSnapshot.get(), &proc));
-			}
-		}
+void ToolHelpProcessMonitor::UnwatchProcess(WatchedProcess& process)
+{
+	// Waits for a callback that is already running, so the process can be freed after.
+	if (process.hWait)
+	{
+		::UnregisterWaitEx(process.hWait, INVALID_HANDLE_VALUE);
+		process.hWait = nullptr;
+	}
+}
 
-		// Compare with the currently known list.
-		for (DWORD processId : processList)
-		{
-			if (std::find_if(std::begin(allProcesses), std::end(allProcesses),
-				[processId](const auto& pi) { return pi.first == processId; })
-				== std::end(allProcesses))
-			{
-				// not found, this is a new process.
-				wil::unique_process_handle hProcess(OpenProcess(SYNCHRONIZE, FALSE, processId));
-				if (hProcess)
-				{
-					waitList.push_back(hProcess.get());
-					allProcesses.emplace_back(processId, std::move(hProcess));
+void ToolHelpProcessMonitor::ScanProcesses(bool initial)
+{
+	wil::unique_tool_help_snapshot hSnapshot(CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0));
+	if (!hSnapshot.is_valid())
+		return;
 
-					if (!initial)
-						gpProcessMonitorEvents->HandleProcessCreation(processId);
-				}
-			}
-		}
+	PROCESSENTRY32 proc = { sizeof(PROCESSENTRY32) };
 
-		// Now we wait. The first element is always the event.
-		DWORD result = ::WaitForMultipleObjects((DWORD)waitList.size(), &waitList[0], FALSE, 5000);
+	if (!Process32First(hSnapshot.get(), &proc))
+		return;
 
-		if (result == WAIT_FAILED)
+	do
+	{
+		if (!ci_equals(proc.szExeFile, "eqgame.exe"))
+			continue;
+
+		const DWORD processId = proc.th32ProcessID;
+		if (m_processes.count(processId) != 0)
+			continue;
+
+		// not found, this is a new process.
+		auto process = std::make_unique<WatchedProcess>();
+		process->monitor = this;
+		process->processId = processId;
+		process->hProcess.reset(OpenProcess(SYNCHRONIZE, FALSE, processId));
+		if (!process->hProcess)
+			continue;
+
+		if (!::RegisterWaitForSingleObject(&process->hWait, process->hProcess.get(), OnProcessExit, process.get(),
+			INFINITE, WT_EXECUTEONLYONCE))
 		{
-			if (waitList.size() >= MAXIMUM_WAIT_OBJECTS)
-			{
-				// SPDLOG_ERROR("Encountered more than the maximum number of proesses while waiting on ToolhelpThread: {}! "
-				// 	"Switching to WMI process monitor.", waitList.size());
-				// switchToWMI = true;
-				// m_running = false;
-			}
-			else
-			{
-				SPDLOG_WARN("{}",
-					fmt::windows_error(GetLastError(), "ToolHelpThread: failed in WaitForMultipleObjects").what());
-			}
+			SPDLOG_WARN("{}",
+				fmt::windows_error(GetLastError(), "ToolHelpThread: failed to wait on process {}", processId).what());
+			continue;
 		}
-		else if (result != WAIT_TIMEOUT)
-		{
-			if (result >= WAIT_OBJECT_0 && result <= WAIT_OBJECT_0 + waitList.size())
-			{
-				int index = result - WAIT_OBJECT_0;
-				HANDLE hHandle = waitList[index];
 
-				// If its index 0, then the wake up event was signaled. Everything else is a process handle.
-				if (index > 0)
-				{
-					waitList.erase(waitList.begin() + index);
+		m_processes.emplace(processId, std::move(process));
 
-					DWORD processId = allProcesses[index - 1].first;
-					allProcesses.erase(allProcesses.begin() + index - 1);
+		if (!initial)
+			gpProcessMonitorEvents->HandleProcessCreation(processId);
+	} while (Process32Next(hSnapshot.get(), &proc));
+}
 
-					gpProcessMonitorEvents->HandleProcessDestruction(processId);
-				}
-			}
-		}
+void ToolHelpProcessMonitor::HandleExitedProcesses()
+{
+	std::vector<DWORD> exited;
 
-		initial = false;
-	} while (m_running);
+	{
+		std::scoped_lock lock(m_exitMutex);
+		exited.swap(m_exited);
+	}
 
-	SPDLOG_DEBUG("Process Monitor Thread Exit");
+	for (DWORD processId : exited)
+	{
+		auto iter = m_processes.find(processId);
+		if (iter == m_processes.end())
+			continue;
+
+		UnwatchProcess(*iter->second);
+		m_processes.erase(iter);
 
-	if (switchToWMI)
+		gpProcessMonitorEvents->HandleProcessDestruction(processId);
+	}
+}
+
+void ToolHelpProcessMonitor::ThreadProc()
+{
+	HANDLE waitList[] = { m_event.get(), m_exitEvent.get() };
+	bool initial = true;
+
+	do
 	{
-		// Detach this thread so we can destroy the process monitor.
-		m_thread.detach();
+		ScanProcesses(initial);
+		initial = false;
 
-		StartWMIProcessMonitor();
+		// Now we wait, for either the stop event, a process exiting, or the next scan.
+		DWORD result = ::WaitForMultipleObjects((DWORD)std::size(waitList), waitList, FALSE, SCAN_INTERVAL_MS);
+
+		if (result == WAIT_FAILED)
+		{
+			SPDLOG_WARN("{}",
+				fmt::windows_error(GetLastError(), "ToolHelpThread: failed in WaitForMultipleObjects").what());
+		}
+		else if (result == WAIT_OBJECT_0 + 1)
+		{
+			HandleExitedProcesses();
+		}
+	} while (m_running);
+
+	for (auto& [processId, process] : m_processes)
+	{
+		UnwatchProcess(*process);
 	}
+	m_processes.clear();
+
+	SPDLOG_DEBUG("Process Monitor Thread Exit");
 }
 
 bool StartToolHelpProcessMonitor()
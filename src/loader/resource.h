@@ -72,13 +72,14 @@
 #define ID_MENU_CHECKFORUPDATES         40050
 #define ID_MENU_CHECKAPPCOMPAT          40060
 #define ID_UNLOADALLMQ                  40061
+#define ID_ADVANCED_CLIENTPERFORMANCE   40062
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        111
-#define _APS_NEXT_COMMAND_VALUE         40061
+#define _APS_NEXT_COMMAND_VALUE         40063
 #define _APS_NEXT_CONTROL_VALUE         1028
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
@@ -59,7 +59,9 @@ static bool gEnableCrashpad = true;                                  // Indicate
 static bool gEnableSharedCrashpad = true;                            // If using crashpad, use the shared crashpad process.
 static bool gEnableSilentCrashpad = false;                           // If using crashpad, crash & report silently.
 static bool gEnableCrashSubmissions = CRASHPAD_SUBMISSIONS_ENABLED;  // If using crashpad, we will submit them.
-static bool gEnableRateLimit = false;                                // If using crashpad, upload rate limiting.
+static bool gEnableRateLimit = CRASHPAD_SUBMISSIONS_RATELIMITED;     // If using crashpad, upload rate limiting.
+static int gCrashDumpDetail = 0;                                     // 0 = minidump, 1 = + referenced memory, 2 = + heap.
+static int gDuplicateCrashWindow = 3600;                             // Seconds a crash signature counts as a duplicate.
 
 static std::string gCrashpadSubmissionURL = CRASHPAD_SUBMISSIONS_URL;
 
@@ -77,6 +79,7 @@ static crashpad::StringAnnotation<32> buildTypeAnnotation("buildType");
 static crashpad::StringAnnotation<32> buildTimestampAnnotation("eqVersion");
 static crashpad::StringAnnotation<32> buildVersionAnnotation("mqVersion");
 static crashpad::StringAnnotation<36> buildCrashIdAnnotation("crashId");
+static crashpad::StringAnnotation<128> crashSignatureAnnotation("crashSignature");
 
 static std::string s_sessionUuid;
 
@@ -227,9 +230,73 @@ void InitializeCrashpadPipe(const std::string& pipeName)
 	}
 }
 
+// Tell crashpad how much memory to capture beyond the stacks for the given detail level. The
+// default is a fast minidump, which keeps dumps small when many clients crash at once.
+static void ApplyCrashDumpDetail(int detail)
+{
+	crashpad::CrashpadInfo* info = crashpad::CrashpadInfo::GetCrashpadInfo();
+
+	if (detail <= 0)
+		info->set_gather_indirectly_referenced_memory(crashpad::TriState::kDisabled, 0);
+	else if (detail == 1)
+		info->set_gather_indirectly_referenced_memory(crashpad::TriState::kEnabled, 16 * 1024 * 1024);
+	else
+		info->set_gather_indirectly_referenced_memory(crashpad::TriState::kEnabled, 256 * 1024 * 1024);
+}
+
+static MINIDUMP_TYPE GetMiniDumpType(int detail)
+{
+	if (detail <= 0)
+		return MINIDUMP_TYPE(MiniDumpWithUnloadedModules);
+	if (detail == 1)
+		return MINIDUMP_TYPE(MiniDumpWithUnloadedModules | MiniDumpWithIndirectlyReferencedMemory | MiniDumpScanMemory);
+
+	return MINIDUMP_TYPE(MiniDumpWithUnloadedModules | MiniDumpWithIndirectlyReferencedMemory | MiniDumpScanMemory
+		| MiniDumpWithPrivateReadWriteMemory | MiniDumpWithDataSegs);
+}
+
+// Identifies a crash by the faulting module, its offset into that module and the exception code,
+// so that the same crash in many clients can be recognized.
+static void FormatCrashSignature(char* buffer, size_t length, EXCEPTION_POINTERS* ex, HMODULE hModule,
+	const char* moduleFileName)
+{
+	const char* moduleName = strrchr(moduleFileName, '\\');
+	moduleName = moduleName ? moduleName + 1 : moduleFileName;
+
+	sprintf_s(buffer, length, "%s+%llx:%08x",
+		moduleName[0] ? moduleName : "unknown",
+		(unsigned long long)((uintptr_t)ex->ExceptionRecord->ExceptionAddress - (uintptr_t)hModule),
+		ex->ExceptionRecord->ExceptionCode);
+}
+
+// Records the signature in a file shared by every client on this machine. Returns true if the same
+// crash was already captured within the duplicate window, in which case it should not be reported
+// again. A mass crash after a patch then produces one report instead of one per client.
+static bool CheckDuplicateCrash(const char* signature)
+{
+	if (gDuplicateCrashWindow <= 0)
+		return false;
+
+	const std::string signaturesFile = mq::internal_paths::CrashDumps + "\\CrashSignatures.ini";
+	const long long now = static_cast<long long>(time(nullptr));
+
+	char szLastSeen[32] = { 0 };
+	::GetPrivateProfileStringA("Signatures", signature, "0", szLastSeen, lengthof(szLastSeen), signaturesFile.c_str());
+	const long long lastSeen = _atoi64(szLastSeen);
+
+	if (lastSeen != 0 && now - lastSeen < gDuplicateCrashWindow)
+		return true;
+
+	std::error_code ec;
+	fs::create_directories(mq::internal_paths::CrashDumps, ec);
+
+	::WritePrivateProfileStringA("Signatures", signature, std::to_string(now).c_str(), signaturesFile.c_str());
+	return false;
+}
+
 // If crashpad is not initialized we need a fallback plan. Returns the path to the minidump.
 // Try to avoid allocations here.
-static std::string MakeMiniDump(const std::string& filename, EXCEPTION_POINTERS* e)
+static std::string MakeMiniDump(const std::string& filename, EXCEPTION_POINTERS* e, int detail = gCrashDumpDetail)
 {
 	fs::path file = fs::path{ filename }.filename().replace_extension();
 
@@ -260,7 +327,7 @@ static std::string MakeMiniDump(const std::string& filename, EXCEPTION_POINTERS*
 		GetCurrentProcess(),
 		GetCurrentProcessId(),
 		hFile.get(),
-		MINIDUMP_TYPE(MiniDumpWithUnloadedModules | MiniDumpWithIndirectlyReferencedMemory | MiniDumpScanMemory),
+		GetMiniDumpType(detail),
 		e ? &exceptionInfo : nullptr,
 		nullptr,
 		nullptr);
@@ -277,11 +344,10 @@ void SetCrashId()
 	buildCrashIdAnnotation.Set(s_sessionUuid);
 }
 
-int MQ2CrashHandler(EXCEPTION_POINTERS* ex, const char* description)
+void InitializeSymbolHandler()
 {
 	SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
 	HANDLE hProcess = GetCurrentProcess();
-	DWORD processID = GetCurrentProcessId();
 
 	SymInitialize(hProcess, nullptr, true);
 
@@ -290,9 +356,22 @@ int MQ2CrashHandler(EXCEPTION_POINTERS* ex, const char* description)
 	GetPrivateProfileString("Debug", "SymbolsPath", "", szSymSearchPath, MAX_STRING, mq::internal_paths::MQini);
 	if (szSymSearchPath[0])
 		SymSetSearchPath(hProcess, szSymSearchPath);
-	SymGetSearchPath(hProcess, szSymSearchPath, MAX_STRING);
+}
+
+void ShutdownSymbolHandler()
+{
+	SymCleanup(GetCurrentProcess());
+}
+
+int MQ2CrashHandler(EXCEPTION_POINTERS* ex, const char* description)
+{
+	HANDLE hProcess = GetCurrentProcess();
+	DWORD processID = GetCurrentProcessId();
+
+	InitializeSymbolHandler();
 
-	// Reusing szSymSearchPath now, for the crashing module filename.
+	// Filename of the crashing module.
+	char szSymSearchPath[MAX_STRING] = { 0 };
 
 	DWORD64 dwAddress = (DWORD64)ex->ExceptionRecord->ExceptionAddress; // Address you want to check on.
 	HMODULE hModule = nullptr;
@@ -345,7 +424,13 @@ int MQ2CrashHandler(EXCEPTION_POINTERS* ex, const char* description)
 			processID, szSymSearchPath, (void*)(dwAddress - (uintptr_t)hModule), ShouldUploadCrash() ? s_sessionUuid.c_str() : "Not reported");
 	}
 
-	SymCleanup(hProcess);
+	ShutdownSymbolHandler();
+
+	char szSignature[128] = { 0 };
+	FormatCrashSignature(szSignature, lengthof(szSignature), ex, hModule, hModule ? szSymSearchPath : "");
+	crashSignatureAnnotation.Set(base::StringPiece(szSignature));
+
+	sprintf_s(szTemp + strlen(szTemp), lengthof(szTemp) - strlen(szTemp), "Signature: %s\n", szSignature);
 
 	if (description)
 	{
@@ -373,14 +458,17 @@ int MQ2CrashHandler(EXCEPTION_POINTERS* ex, const char* description)
 		return EXCEPTION_CONTINUE_EXECUTION;
 	}
 
+	// Duplicates of a recent crash only get a fast local minidump and are not reported.
+	const bool duplicate = CheckDuplicateCrash(szSignature);
+
 	// Call into crashpad if it is available.
-	if (lpCrashpadTopLevelExceptionFilter)
+	if (lpCrashpadTopLevelExceptionFilter && !duplicate)
 	{
 		return lpCrashpadTopLevelExceptionFilter(ex);
 	}
 
 	// We got here which means there is no crashpad handler available, so we gotta do a dump ourselves.
-	const std::string path = MakeMiniDump("eqgame.exe", ex);
+	const std::string path = MakeMiniDump("eqgame.exe", ex, duplicate ? 0 : gCrashDumpDetail);
 
 	if (!path.empty())
 	{
@@ -457,6 +545,11 @@ void InitializeCrashHandler()
 	gEnableSilentCrashpad = GetPrivateProfileBool("Crash Handler", "EnableSilentCrashpad", gEnableSilentCrashpad, internal_paths::MQini);
 	gEnableCrashSubmissions = GetPrivateProfileBool("Crash Handler", "EnableCrashSubmissions", gEnableCrashSubmissions, internal_paths::MQini);
 	gCrashpadSubmissionURL = GetPrivateProfileString("Crash Handler", "CrashpadSubmissionURL", gCrashpadSubmissionURL.c_str(), internal_paths::MQini);
+	gEnableRateLimit = GetPrivateProfileBool("Crash Handler", "EnableRateLimit", gEnableRateLimit, internal_paths::MQini);
+	gCrashDumpDetail = std::clamp(GetPrivateProfileInt("Crash Handler", "CrashDumpDetail", gCrashDumpDetail, internal_paths::MQini), 0, 2);
+	gDuplicateCrashWindow = GetPrivateProfileInt("Crash Handler", "DuplicateCrashWindow", gDuplicateCrashWindow, internal_paths::MQini);
+
+	ApplyCrashDumpDetail(gCrashDumpDetail);
 
 	// Configure / initialize crashpad
 
@@ -491,7 +584,18 @@ void DoCrash(SPAWNINFO* pChar, char* szLine)
 	auto pAnno = new crashpad::StringAnnotation<32>("synthesized");
 	pAnno->Set(base::StringPiece("true"));
 
-	if (ci_equals(szArg1, "force"))
+	// A heap capture can be asked for explicitly, regardless of the configured detail.
+	if (ci_equals(szArg1, "heap"))
+	{
+		ApplyCrashDumpDetail(2);
+
+		CONTEXT context;
+		crashpad::CaptureContext(&context);
+		crashpad::CrashpadClient::DumpWithoutCrash(context);
+
+		ApplyCrashDumpDetail(gCrashDumpDetail);
+	}
+	else if (ci_equals(szArg1, "force"))
 	{
 		int* pc = nullptr;
 		*pc = 18;
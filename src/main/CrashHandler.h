@@ -40,6 +40,11 @@ void InitializeCrashHandler();
 bool InitializeCrashpad();
 void InitializeCrashpadPipe(const std::string& pipeName);
 
+// Set up dbghelp to resolve symbols in this process, searching [Debug] SymbolsPath from the ini
+// if it is set. Not thread safe, like the rest of dbghelp.
+void InitializeSymbolHandler();
+void ShutdownSymbolHandler();
+
 // Init/Shutdown CrashHandler extra modules
 void InitializeMQ2CrashHandler();
 void ShutdownMQ2CrashHandler();
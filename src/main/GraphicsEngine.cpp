@@ -31,6 +31,10 @@ static bool s_flushNextMouse = false;
 
 // Pointer to our MQ graphics engine
 static MQGraphicsEngine* s_gfxEngine = nullptr;
+
+// Benchmarks for the work done from inside the render hooks
+static uint32_t bmRenderCallbacks = 0;
+static uint32_t bmRenderImGui = 0;
 eqlib::Direct3DDevice9* gpD3D9Device = nullptr;
 
 static bool s_enableImGuiDocking = true;
@@ -425,6 +429,7 @@ void MQGraphicsEngine::UpdateScene()
 	if (!m_deviceAcquired)
 		return;
 
+	MQScopedBenchmark bm(bmRenderCallbacks);
 	UpdateScene_Internal();
 }
 
@@ -443,8 +448,11 @@ void MQGraphicsEngine::PostUpdateScene()
 {
 	if (m_deviceAcquired && m_imguiReady && !m_needResetOverlay)
 	{
-		if (gGameState != GAMESTATE_LOGGINGIN && gbRenderImGui)
+		// Frames that the frame limiter isn't going to show skip building the ui entirely, plugins
+		// included.
+		if (gGameState != GAMESTATE_LOGGINGIN && gbRenderImGui && IsFrameLimiterPresenting())
 		{
+			MQScopedBenchmark bm(bmRenderImGui);
 			ImGui_DrawFrame();
 		}
 	}
@@ -632,6 +640,9 @@ void engine::Initialize()
 	s_gfxEngine = CreateRendererDX9();
 #endif
 	s_gfxEngine->Initialize();
+
+	bmRenderCallbacks = AddMQ2Benchmark("Render_Callbacks");
+	bmRenderImGui = AddMQ2Benchmark("Render_ImGui");
 }
 
 void engine::Shutdown()
@@ -644,6 +655,9 @@ void engine::Shutdown()
 	delete s_gfxEngine;
 	s_gfxEngine = nullptr;
 
+	RemoveMQ2Benchmark(bmRenderCallbacks);
+	RemoveMQ2Benchmark(bmRenderImGui);
+
 	RemoveDetour(__ProcessMouseEvents);
 #if defined(__HandleMouseWheel_x)
 	RemoveDetour(__HandleMouseWheel);
@@ -17,6 +17,11 @@
 
 #include "MQ2Main.h"
 
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
 namespace mq {
 
 //============================================================================
@@ -26,6 +31,112 @@ static bool s_shutdown = false;
 
 static int s_renderCallbacksId = -1;
 
+// How long the textures from CreateTextureAsync may take to finish loading in one frame. At least
+// one is loaded each frame regardless.
+static constexpr std::chrono::microseconds ASYNC_TEXTURE_FRAME_BUDGET{ 2000 };
+
+// Async textures by file name, for as long as something holds them.
+static ci_unordered::map<std::string, std::weak_ptr<MQTexture>> s_asyncTextures;
+
+// The game decodes and uploads an image in the same call, so that part has to stay on the render
+// thread. What the worker takes off of it is reading the file, which is where a cold load spends
+// most of its time. The files it has read are left in the file cache for the game to decode from.
+class TextureFileReader
+{
+public:
+	~TextureFileReader()
+	{
+		// GraphicsResources_Shutdown stops the thread. Joining it here could wait on the loader lock.
+		if (m_thread.joinable())
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_cv.notify_one();
+			m_thread.detach();
+		}
+	}
+
+	void Add(const std::string& filename)
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_requests.push_back(filename);
+		}
+
+		if (!m_thread.joinable())
+			m_thread = std::thread([this]() { ReaderThread(); });
+
+		m_cv.notify_one();
+	}
+
+	// Files that have been read since the last call, and whether they could be.
+	void TakeFinished(std::vector<std::pair<std::string, bool>>& finished)
+	{
+		std::scoped_lock lock(m_mutex);
+		finished.swap(m_finished);
+	}
+
+	void Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_stop = true;
+			m_requests.clear();
+		}
+
+		m_cv.notify_one();
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+		m_stop = false;
+		m_finished.clear();
+	}
+
+private:
+	void ReaderThread()
+	{
+		std::vector<char> buffer(64 * 1024);
+
+		while (true)
+		{
+			std::string filename;
+
+			{
+				std::unique_lock lock(m_mutex);
+				m_cv.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+				if (m_stop)
+					return;
+
+				filename = std::move(m_requests.front());
+				m_requests.erase(m_requests.begin());
+			}
+
+			std::ifstream file(filename, std::ios::binary);
+			const bool found = file.is_open();
+
+			while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+			{
+			}
+
+			std::scoped_lock lock(m_mutex);
+			m_finished.emplace_back(std::move(filename), found);
+		}
+	}
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<std::string> m_requests;
+	std::vector<std::pair<std::string, bool>> m_finished;
+	bool m_stop = false;
+};
+
+static TextureFileReader s_textureFileReader;
+
 //============================================================================
 
 MQTexture* CreateTexture(std::string_view filename)
@@ -63,19 +174,35 @@ MQTexturePtr CreateTexturePtr(std::string_view filename)
 	return std::shared_ptr<MQTexture>(CreateTexture(filename), [](MQTexture* tex) { DestroyTexture(tex); });
 }
 
+MQTexturePtr CreateTextureAsync(std::string_view filename)
+{
+	auto iter = s_asyncTextures.find(filename);
+	if (iter != s_asyncTextures.end())
+	{
+		if (MQTexturePtr texture = iter->second.lock())
+			return texture;
+	}
+
+	MQTexturePtr texture = std::shared_ptr<MQTexture>(new MQTexture(filename, false), [](MQTexture* tex) { DestroyTexture(tex); });
+
+	if (iter != s_asyncTextures.end())
+		iter->second = texture;
+	else
+		s_asyncTextures.emplace(std::string(filename), texture);
+
+	s_textureFileReader.Add(texture->GetFilename());
+	return texture;
+}
+
 //============================================================================
 
-MQTexture::MQTexture(std::string_view name)
+MQTexture::MQTexture(std::string_view name, bool loadNow /* = true */)
 	: m_name(name)
+	, m_loading(!loadNow)
 {
-	AcquireTexture();
-
-	if (m_bmi)
+	if (loadNow)
 	{
-		m_bmi->Name = m_name.c_str();
-		m_bmi->pBmp->m_nTrackingType = 2; // EQG
-
-		s_textures.push_back(this);
+		Load();
 	}
 }
 
@@ -92,6 +219,24 @@ MQTexture::~MQTexture()
 	}
 }
 
+void MQTexture::Load()
+{
+	m_loading = false;
+
+	if (m_bmi)
+		return;
+
+	AcquireTexture();
+
+	if (m_bmi)
+	{
+		m_bmi->Name = m_name.c_str();
+		m_bmi->pBmp->m_nTrackingType = 2; // EQG
+
+		s_textures.push_back(this);
+	}
+}
+
 void MQTexture::AcquireTexture()
 {
 	if (m_bmi == nullptr)
@@ -174,6 +319,57 @@ static void GraphicsResources_InvalidateDeviceObjects()
 	}
 }
 
+void GraphicsResources_OnPulse()
+{
+	static std::vector<std::pair<std::string, bool>> s_finished;
+	static size_t s_nextFinished = 0;
+
+	if (s_nextFinished == s_finished.size())
+	{
+		s_finished.clear();
+		s_nextFinished = 0;
+		s_textureFileReader.TakeFinished(s_finished);
+	}
+
+	if (s_finished.empty() || !pGraphicsEngine || !pGraphicsEngine->pResourceManager)
+		return;
+
+	const auto deadline = std::chrono::steady_clock::now() + ASYNC_TEXTURE_FRAME_BUDGET;
+	bool loadedAny = false;
+
+	while (s_nextFinished < s_finished.size())
+	{
+		const auto& [filename, found] = s_finished[s_nextFinished];
+
+		auto iter = s_asyncTextures.find(filename);
+		MQTexturePtr texture = iter != s_asyncTextures.end() ? iter->second.lock() : nullptr;
+
+		if (!texture || !texture->IsLoading())
+		{
+			// dropped before it was loaded, or already done by an earlier request for the same file
+			if (!texture && iter != s_asyncTextures.end())
+				s_asyncTextures.erase(iter);
+
+			++s_nextFinished;
+			continue;
+		}
+
+		if (!found)
+		{
+			texture->CancelLoad();
+			++s_nextFinished;
+			continue;
+		}
+
+		if (loadedAny && std::chrono::steady_clock::now() >= deadline)
+			break;
+
+		texture->Load();
+		loadedAny = true;
+		++s_nextFinished;
+	}
+}
+
 void GraphicsResources_Initialize()
 {
 	MQRenderCallbacks callbacks;
@@ -197,6 +393,9 @@ void GraphicsResources_Shutdown()
 
 	s_textures.clear();
 
+	s_textureFileReader.Stop();
+	s_asyncTextures.clear();
+
 	RemoveRenderCallbacks(s_renderCallbacksId);
 }
 
@@ -32,6 +32,10 @@
 #include <mq/utils/Benchmarks.h>
 
 #include "imgui/implot/implot_internal.h"
+#include <imgui/misc/freetype/imgui_freetype.h>
+
+#include <filesystem>
+#include <fstream>
 
 namespace ImGui
 {
@@ -424,6 +428,7 @@ struct FontInfo
 	bool fixedWidth = false;
 };
 std::vector<FontInfo> s_fontInfo;
+static bool s_fontInfoLoaded = false;
 
 int CALLBACK FontNameProc(
 	const ENUMLOGFONTEXW* lpelfe,   /* pointer to logical-font data */
@@ -463,15 +468,283 @@ void LoadFonts()
 	ReleaseDC(0, hdc);
 }
 
+// The built atlas is kept in the resources directory, so that injecting again with the same fonts
+// loads the texture and glyphs instead of rasterizing every icon range again. The file starts with
+// everything that went into the build, and is only used if that matches exactly.
+static constexpr uint32_t FONT_ATLAS_CACHE_VERSION = 1;
+
+static std::filesystem::path GetFontAtlasCachePath()
+{
+	return std::filesystem::path(mq::internal_paths::Resources) / "ImGuiFontAtlas.cache";
+}
+
+template <typename T>
+static void AppendBytes(std::string& out, const T& value)
+{
+	out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static std::string GetFontAtlasCacheKey(ImFontAtlas* atlas)
+{
+	std::string key;
+	AppendBytes(key, FONT_ATLAS_CACHE_VERSION);
+	AppendBytes(key, IMGUI_VERSION_NUM);
+	AppendBytes(key, sizeof(ImFontGlyph));
+	AppendBytes(key, atlas->Flags);
+	AppendBytes(key, atlas->TexDesiredWidth);
+	AppendBytes(key, atlas->TexGlyphPadding);
+	AppendBytes(key, atlas->FontBuilderFlags);
+	AppendBytes(key, atlas->Fonts.Size);
+
+	AppendBytes(key, atlas->CustomRects.Size);
+	for (const ImFontAtlasCustomRect& rect : atlas->CustomRects)
+	{
+		AppendBytes(key, rect.Width);
+		AppendBytes(key, rect.Height);
+	}
+
+	AppendBytes(key, atlas->ConfigData.Size);
+	for (const ImFontConfig& cfg : atlas->ConfigData)
+	{
+		AppendBytes(key, cfg.FontDataSize);
+		AppendBytes(key, ImHashData(cfg.FontData, cfg.FontDataSize));
+		AppendBytes(key, cfg.FontNo);
+		AppendBytes(key, cfg.SizePixels);
+		AppendBytes(key, cfg.OversampleH);
+		AppendBytes(key, cfg.OversampleV);
+		AppendBytes(key, cfg.PixelSnapH);
+		AppendBytes(key, cfg.GlyphExtraSpacing);
+		AppendBytes(key, cfg.GlyphOffset);
+		AppendBytes(key, cfg.GlyphMinAdvanceX);
+		AppendBytes(key, cfg.GlyphMaxAdvanceX);
+		AppendBytes(key, cfg.MergeMode);
+		AppendBytes(key, cfg.FontBuilderFlags);
+		AppendBytes(key, cfg.RasterizerMultiply);
+		AppendBytes(key, cfg.RasterizerDensity);
+		AppendBytes(key, cfg.EllipsisChar);
+		AppendBytes(key, atlas->Fonts.index_from_ptr(std::find(atlas->Fonts.begin(), atlas->Fonts.end(), cfg.DstFont)));
+
+		for (const ImWchar* range = cfg.GlyphRanges ? cfg.GlyphRanges : atlas->GetGlyphRangesDefault(); *range; ++range)
+			AppendBytes(key, *range);
+		AppendBytes(key, ImWchar(0));
+	}
+
+	return key;
+}
+
+template <typename T>
+static bool ReadBytes(std::istream& in, T& value)
+{
+	return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+static bool LoadFontAtlasCache(ImFontAtlas* atlas, const std::string& key)
+{
+	std::ifstream file(GetFontAtlasCachePath(), std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t keySize = 0;
+	if (!ReadBytes(file, keySize) || keySize != key.size())
+		return false;
+
+	std::string cachedKey(keySize, '\0');
+	if (!file.read(cachedKey.data(), keySize) || cachedKey != key)
+		return false;
+
+	int width = 0, height = 0;
+	bool useColors = false, rgba = false;
+	ImVec2 uvWhitePixel;
+	ImVec4 uvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+	if (!ReadBytes(file, width) || !ReadBytes(file, height) || !ReadBytes(file, useColors) || !ReadBytes(file, rgba)
+		|| !ReadBytes(file, uvWhitePixel) || !ReadBytes(file, uvLines) || width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	std::vector<std::pair<unsigned short, unsigned short>> rectPositions(atlas->CustomRects.Size);
+	for (auto& [x, y] : rectPositions)
+	{
+		if (!ReadBytes(file, x) || !ReadBytes(file, y))
+			return false;
+	}
+
+	struct FontData
+	{
+		float ascent = 0;
+		float descent = 0;
+		int metricsTotalSurface = 0;
+		ImVector<ImFontGlyph> glyphs;
+	};
+	std::vector<FontData> fonts(atlas->Fonts.Size);
+	for (FontData& font : fonts)
+	{
+		int glyphCount = 0;
+		if (!ReadBytes(file, font.ascent) || !ReadBytes(file, font.descent) || !ReadBytes(file, font.metricsTotalSurface)
+			|| !ReadBytes(file, glyphCount) || glyphCount < 0)
+		{
+			return false;
+		}
+
+		font.glyphs.resize(glyphCount);
+		if (!file.read(reinterpret_cast<char*>(font.glyphs.Data), font.glyphs.size_in_bytes()))
+			return false;
+	}
+
+	const size_t pixelsSize = static_cast<size_t>(width) * height * (rgba ? 4 : 1);
+	void* pixels = IM_ALLOC(pixelsSize);
+	if (!file.read(static_cast<char*>(pixels), pixelsSize))
+	{
+		IM_FREE(pixels);
+		return false;
+	}
+
+	// Everything was read, now put it in place the way the builder would have.
+	atlas->TexID = (ImTextureID)NULL;
+	atlas->ClearTexData();
+	atlas->TexWidth = width;
+	atlas->TexHeight = height;
+	atlas->TexUvScale = ImVec2(1.0f / width, 1.0f / height);
+	atlas->TexUvWhitePixel = uvWhitePixel;
+	std::copy(std::begin(uvLines), std::end(uvLines), atlas->TexUvLines);
+	atlas->TexPixelsUseColors = useColors;
+	if (rgba)
+		atlas->TexPixelsRGBA32 = static_cast<unsigned int*>(pixels);
+	else
+		atlas->TexPixelsAlpha8 = static_cast<unsigned char*>(pixels);
+
+	for (int i = 0; i < atlas->CustomRects.Size; ++i)
+	{
+		atlas->CustomRects[i].X = rectPositions[i].first;
+		atlas->CustomRects[i].Y = rectPositions[i].second;
+	}
+
+	for (ImFontConfig& cfg : atlas->ConfigData)
+	{
+		if (!cfg.MergeMode)
+		{
+			const FontData& font = fonts[atlas->Fonts.index_from_ptr(std::find(atlas->Fonts.begin(), atlas->Fonts.end(), cfg.DstFont))];
+			ImFontAtlasBuildSetupFont(atlas, cfg.DstFont, &cfg, font.ascent, font.descent);
+		}
+	}
+
+	for (int i = 0; i < atlas->Fonts.Size; ++i)
+	{
+		ImFont* font = atlas->Fonts[i];
+		font->Glyphs.swap(fonts[i].glyphs);
+		font->MetricsTotalSurface = fonts[i].metricsTotalSurface;
+		font->DirtyLookupTables = true;
+	}
+
+	ImFontAtlasBuildFinish(atlas);
+	return true;
+}
+
+static void SaveFontAtlasCache(const ImFontAtlas* atlas, const std::string& key)
+{
+	const bool rgba = atlas->TexPixelsAlpha8 == nullptr;
+	const void* pixels = rgba ? static_cast<const void*>(atlas->TexPixelsRGBA32) : atlas->TexPixelsAlpha8;
+	if (pixels == nullptr)
+		return;
+
+	// written under a name of its own and moved into place, in case another client is reading it
+	std::filesystem::path path = GetFontAtlasCachePath();
+	std::filesystem::path tempPath = path;
+	tempPath += fmt::format(".{}.tmp", GetCurrentProcessId());
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+
+		auto write = [&file](const auto& value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+		write(static_cast<uint32_t>(key.size()));
+		file.write(key.data(), key.size());
+
+		write(atlas->TexWidth);
+		write(atlas->TexHeight);
+		write(atlas->TexPixelsUseColors);
+		write(rgba);
+		write(atlas->TexUvWhitePixel);
+		write(atlas->TexUvLines);
+
+		for (const ImFontAtlasCustomRect& rect : atlas->CustomRects)
+		{
+			write(rect.X);
+			write(rect.Y);
+		}
+
+		for (const ImFont* font : atlas->Fonts)
+		{
+			write(font->Ascent);
+			write(font->Descent);
+			write(font->MetricsTotalSurface);
+			write(font->Glyphs.Size);
+			file.write(reinterpret_cast<const char*>(font->Glyphs.Data), font->Glyphs.size_in_bytes());
+		}
+
+		file.write(static_cast<const char*>(pixels), static_cast<size_t>(atlas->TexWidth) * atlas->TexHeight * (rgba ? 4 : 1));
+		if (!file)
+		{
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, path, ec);
+	if (ec)
+		std::filesystem::remove(tempPath, ec);
+}
+
+static bool CachedFontBuilder_Build(ImFontAtlas* atlas)
+{
+	// registers the default custom rects, which are part of the key
+	ImFontAtlasBuildInit(atlas);
+
+	// Glyphs that custom rects add to fonts are added again when the atlas is finished, so those
+	// atlases aren't cached.
+	const bool cacheable = std::none_of(atlas->CustomRects.begin(), atlas->CustomRects.end(),
+		[](const ImFontAtlasCustomRect& rect) { return rect.Font != nullptr; });
+
+	std::string key;
+	if (cacheable)
+	{
+		key = GetFontAtlasCacheKey(atlas);
+		if (LoadFontAtlasCache(atlas, key))
+			return true;
+	}
+
+	if (!ImGuiFreeType::GetBuilderForFreeType()->FontBuilder_Build(atlas))
+		return false;
+
+	if (cacheable)
+		SaveFontAtlasCache(atlas, key);
+
+	return true;
+}
+
+static const ImFontBuilderIO s_cachedFontBuilder = { &CachedFontBuilder_Build };
+
 void ImGuiManager_BuildFonts(ImFontAtlas* fontAtlas)
 {
-	LoadFonts();
+	fontAtlas->FontBuilderIO = &s_cachedFontBuilder;
 
 	mq::imgui::ConfigureFonts(fontAtlas);
 }
 
 void FontPicker()
 {
+	// enumerating the system's fonts takes a while, so it waits until someone looks at them
+	if (!s_fontInfoLoaded)
+	{
+		LoadFonts();
+		s_fontInfoLoaded = true;
+	}
+
 	static int currentfont = 0;
 	ImGui::ComboWithFilter("Fonts", &currentfont, s_fontInfo, [](const std::vector<FontInfo>& items, int index) -> const std::string& { return items[index].fullname; });
 }
@@ -122,10 +122,13 @@ private:
 	Anonymization strategy;
 	std::string target;
 	std::set<std::string> alternates;
-	std::regex search_string;
+
+	// only replacers whose names use regex syntax are matched with the regex, so it is built on first use
+	mutable std::regex search_string;
+	mutable bool search_string_valid = false;
 
 private:
-	void build_regex()
+	void build_regex() const
 	{
 		search_string = std::regex(
 			fmt::format("\\b({}{})\\b", name, std::accumulate(alternates.cbegin(), alternates.cend(), std::string(),
@@ -133,13 +136,39 @@ private:
 					return fmt::format("{}|{}", text, alt);
 				})),
 			std::regex_constants::icase);
+		search_string_valid = true;
+	}
+
+	static bool get_literal(std::string_view pattern, std::string& literal)
+	{
+		// "\s" is what spawn replacers put between first and last names, anything else that regex
+		// would treat specially means the pattern can't be matched as plain text
+		literal.clear();
+		for (size_t i = 0; i < pattern.length(); ++i)
+		{
+			char c = pattern[i];
+			if (c == '\\' && i + 1 < pattern.length() && pattern[i + 1] == 's')
+			{
+				literal.push_back(' ');
+				++i;
+			}
+			else if (strchr("^$\\.*+?()[]{}|", c))
+			{
+				return false;
+			}
+			else
+			{
+				literal.push_back(c);
+			}
+		}
+
+		return !literal.empty();
 	}
 
 public:
 	anon_replacer(std::string_view name, Anonymization strategy, std::string_view target = "")
 		: name(name), strategy(strategy), target(target)
 	{
-		build_regex();
 	}
 
 	anon_replacer(Yaml::Node& node)
@@ -152,8 +181,6 @@ public:
 			for (auto alt = node["alternates"].Begin(); alt != node["alternates"].End(); alt++)
 				alternates.emplace((*alt).second.As<std::string>());
 		}
-
-		build_regex();
 	}
 
 	anon_replacer(SPAWNINFO* pSpawn, Anonymization strategy, std::string_view target = "")
@@ -163,20 +190,18 @@ public:
 	{
 		if (pSpawn->Lastname[0])
 			add_alternate(pSpawn->Name);
-
-		build_regex();
 	}
 
 	void add_alternate(std::string_view alternate)
 	{
 		alternates.emplace(std::string(alternate));
-		build_regex();
+		search_string_valid = false;
 	}
 
 	void drop_alternate(std::string_view alternate)
 	{
 		alternates.erase(std::string(alternate));
-		build_regex();
+		search_string_valid = false;
 	}
 
 	void update_strategy(Anonymization strategy)
@@ -263,8 +288,34 @@ public:
 		}
 	}
 
+	// the name and its alternates in match order, as plain text. Returns false if any of them needs
+	// the regex to match.
+	bool get_literals(std::vector<std::string>& literals) const
+	{
+		literals.clear();
+
+		std::string literal;
+		if (get_literal(name, literal))
+			literals.push_back(literal);
+		else if (!name.empty())
+			return false;
+
+		for (const std::string& alternate : alternates)
+		{
+			if (get_literal(alternate, literal))
+				literals.push_back(literal);
+			else if (!alternate.empty())
+				return false;
+		}
+
+		return true;
+	}
+
 	std::string replace_text(std::string_view text) const
 	{
+		if (!search_string_valid)
+			build_regex();
+
 		std::string result;
 		std::regex_replace(std::back_inserter(result), std::cbegin(text), std::cend(text), search_string, anonymize());
 		return result;
@@ -294,6 +345,181 @@ static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> guild
 static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> raid_memoization;
 static std::unique_ptr<anon_replacer> self_replacer;
 
+// Every replacer whose names are plain text is folded into one case insensitive trie, so a string is
+// rewritten in a single pass no matter how many names are being anonymized. A match has to start
+// and end on a word boundary like the replacer regex requires, the leftmost match wins and ties go
+// to the replacer that was added first.
+class anon_matcher
+{
+	struct node
+	{
+		std::vector<std::pair<unsigned char, int>> next;
+		int pattern = -1;
+	};
+
+	std::vector<node> nodes;
+	std::vector<const anon_replacer*> patterns;
+	std::vector<const anon_replacer*> regex_replacers;
+	bool starts[256];
+
+	static unsigned char fold(unsigned char c)
+	{
+		if (c >= 'A' && c <= 'Z')
+			return static_cast<unsigned char>(c | 0x20);
+		if (isspace(c))
+			return ' ';
+		return c;
+	}
+
+	static bool is_word(unsigned char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	static bool is_boundary(std::string_view text, size_t pos)
+	{
+		bool before = pos > 0 && is_word(text[pos - 1]);
+		bool after = pos < text.length() && is_word(text[pos]);
+		return before != after;
+	}
+
+	int child(int index, unsigned char c) const
+	{
+		for (const auto& [key, next] : nodes[index].next)
+		{
+			if (key == c)
+				return next;
+		}
+
+		return -1;
+	}
+
+public:
+	anon_matcher()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		nodes.clear();
+		nodes.emplace_back();
+		patterns.clear();
+		regex_replacers.clear();
+		memset(starts, 0, sizeof(starts));
+	}
+
+	void add(const anon_replacer* replacer)
+	{
+		if (!replacer)
+			return;
+
+		std::vector<std::string> literals;
+		if (!replacer->get_literals(literals))
+		{
+			regex_replacers.push_back(replacer);
+			return;
+		}
+
+		for (const std::string& literal : literals)
+		{
+			int index = 0;
+			for (char ch : literal)
+			{
+				unsigned char c = fold(static_cast<unsigned char>(ch));
+				int next = child(index, c);
+				if (next == -1)
+				{
+					next = static_cast<int>(nodes.size());
+					nodes[index].next.emplace_back(c, next);
+					nodes.emplace_back();
+				}
+
+				index = next;
+			}
+
+			// the first pattern added for a string keeps it
+			if (nodes[index].pattern == -1)
+			{
+				nodes[index].pattern = static_cast<int>(patterns.size());
+				patterns.push_back(replacer);
+			}
+
+			starts[fold(static_cast<unsigned char>(literal[0]))] = true;
+		}
+	}
+
+	std::string replace_text(std::string_view text) const
+	{
+		// each replacer's replacement is only worked out once per string, and only if it's used
+		std::vector<std::pair<const anon_replacer*, std::string>> replacements;
+
+		std::string result;
+		size_t copied = 0;
+		size_t pos = 0;
+
+		while (pos < text.length())
+		{
+			if (!starts[fold(static_cast<unsigned char>(text[pos]))] || !is_boundary(text, pos))
+			{
+				++pos;
+				continue;
+			}
+
+			int best = -1;
+			size_t best_end = 0;
+			int index = 0;
+			for (size_t end = pos; end < text.length(); )
+			{
+				index = child(index, fold(static_cast<unsigned char>(text[end])));
+				if (index == -1)
+					break;
+
+				++end;
+				const int pattern = nodes[index].pattern;
+				if (pattern != -1 && (best == -1 || pattern < best) && is_boundary(text, end))
+				{
+					best = pattern;
+					best_end = end;
+				}
+			}
+
+			if (best == -1)
+			{
+				++pos;
+				continue;
+			}
+
+			const anon_replacer* replacer = patterns[best];
+			auto replacement = std::find_if(replacements.begin(), replacements.end(),
+				[replacer](const auto& r) { return r.first == replacer; });
+			if (replacement == replacements.end())
+			{
+				replacements.emplace_back(replacer, replacer->anonymize());
+				replacement = replacements.end() - 1;
+			}
+
+			result.append(text.data() + copied, pos - copied);
+			result.append(replacement->second);
+			copied = pos = best_end;
+		}
+
+		if (copied == 0)
+			result.assign(text);
+		else
+			result.append(text.data() + copied, text.length() - copied);
+
+		for (const anon_replacer* replacer : regex_replacers)
+			result = replacer->replace_text(result);
+
+		return result;
+	}
+};
+
+static anon_matcher matcher;
+static bool matcher_dirty = true;
+static uint64_t matcher_members = 0;
+
 // the source string_view here will be used to index
 // creating a regex that looks like `(source|all|the|alternates)`
 
@@ -313,6 +539,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_group = Strategy;
 			group_memoization.clear();
+			matcher_dirty = true;
 		}
 		break;
 
@@ -321,6 +548,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_fellowship = Strategy;
 			fellowship_memoization.clear();
+			matcher_dirty = true;
 		}
 		break;
 
@@ -329,6 +557,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_guild = Strategy;
 			guild_memoization.clear();
+			matcher_dirty = true;
 		}
 		break;
 
@@ -337,6 +566,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_raid = Strategy;
 			raid_memoization.clear();
+			matcher_dirty = true;
 		}
 		break;
 
@@ -348,6 +578,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 				self_replacer = std::make_unique<anon_replacer>(pLocalPlayer, anon_self);
 			else
 				self_replacer->update_strategy(Strategy);
+			matcher_dirty = true;
 		}
 		break;
 
@@ -377,6 +608,7 @@ static void AddAnonymization(std::string_view Name, Anonymization Strategy, std:
 	else
 	{
 		replacers.emplace_back(std::make_unique<anon_replacer>(Name, Strategy, Replace));
+		matcher_dirty = true;
 		WriteChatf("Added anonymization \at%s\ax with \at%s\ax%s",
 			Name.data(),
 			GetStringFromAnonymization(Strategy).data(),
@@ -391,6 +623,7 @@ static void DropAnonymization(std::string_view Name)
 	if (replacer_it != std::end(replacers))
 	{
 		replacers.erase(replacer_it);
+		matcher_dirty = true;
 		WriteChatf("Un-Anonymized \at%s\ax.", Name.data());
 	}
 	else
@@ -407,6 +640,7 @@ static void AddAlternate(std::string_view Name, std::string_view Alternate)
 	if (replacer_it != std::end(replacers))
 	{
 		(*replacer_it)->add_alternate(Alternate);
+		matcher_dirty = true;
 		WriteChatf("Added Alias \ay%s\ax to \at%s\ax.", Alternate.data(), Name.data());
 	}
 	else
@@ -423,6 +657,7 @@ static void DropAlternate(std::string_view Name, std::string_view Alternate)
 	if (replacer_it != std::end(replacers))
 	{
 		(*replacer_it)->drop_alternate(Alternate);
+		matcher_dirty = true;
 		WriteChatf("Dropped Alias \ay%s\ax from \at%s\ax.", Alternate.data(), Name.data());
 	}
 	else
@@ -442,6 +677,7 @@ static void DropAlternate(std::string_view Alternate)
 			{
 				r->drop_alternate(Alternate);
 				changed = true;
+				matcher_dirty = true;
 				WriteChatf("Dropped Alias \ay%s\ax from \at%s\ax.", Alternate.data(), r->name.c_str());
 			}
 		});
@@ -539,6 +775,7 @@ static void Deserialize()
 	guild_memoization.clear();
 	raid_memoization.clear();
 	self_replacer.reset();
+	matcher_dirty = true;
 	WriteChatf("Done.");
 }
 
@@ -557,128 +794,154 @@ CXStr& PluginAnonymize(CXStr& Text)
 	return Text;
 }
 
-CXStr Anonymize(const CXStr& Text)
+static const anon_replacer* GetMemoizedReplacer(ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>>& memoization,
+	std::string_view name, Anonymization strategy)
 {
-	if (!MaybeAnonymize(Text))
-		return Text;
+	auto memoized = memoization.find(name);
+	if (memoized == memoization.end())
+	{
+		// key on the replacer's copy of the name, the one we were given may be game memory
+		auto replacer = std::make_unique<anon_replacer>(name, strategy);
+		std::string_view key = replacer->name;
+		memoized = memoization.emplace(key, std::move(replacer)).first;
+	}
 
-	if (!pLocalPlayer || !pLocalPC)
-		return Text;
+	return memoized->second.get();
+}
 
-	EnterMQ2Benchmark(bmAnonymizer);
+static void HashMember(uint64_t& hash, std::string_view name)
+{
+	for (char c : name)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
 
-	auto new_text = std::accumulate(std::cbegin(replacers), std::cend(replacers), std::string(Text),
-		[](std::string& text, const std::unique_ptr<anon_replacer>& r) -> std::string {
-			return r ? r->replace_text(text) : text;
-		});
+	hash ^= 0xff;
+	hash *= 1099511628211ULL;
+}
+
+// Identifies who is in the group, fellowship, guild and raid so the matcher is only rebuilt
+// when one of them changes. Guild members are identified by their entries only, reading every
+// name of a large guild for each string would cost more than the matcher saves.
+static uint64_t GetMembersSignature()
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	if (anon_group != Anonymization::None && pLocalPC->Group)
+	{
+		for (const CGroupMember* pMember : *pLocalPC->Group)
+		{
+			if (pMember)
+				HashMember(hash, pMember->Name);
+		}
+	}
+
+	if (anon_fellowship != Anonymization::None)
+	{
+		for (const SFellowshipMember& member : pLocalPlayer->Fellowship.FellowshipMember)
+			HashMember(hash, member.Name);
+	}
+
+	if (anon_guild != Anonymization::None && pGuild)
+	{
+		hash ^= static_cast<uint64_t>(pLocalPC->GuildID);
+		hash *= 1099511628211ULL;
+
+		for (GuildMember* pMember = pGuild->pFirstGuildMember; pMember; pMember = pMember->pNext)
+		{
+			hash ^= reinterpret_cast<uintptr_t>(pMember);
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	if (anon_raid != Anonymization::None && pRaid)
+	{
+		for (const RaidMember& member : pRaid->RaidMember)
+			HashMember(hash, member.Name);
+	}
 
+	return hash;
+}
+
+static void UpdateMatcher()
+{
 	if (anon_self != Anonymization::None)
 	{
 		if (!self_replacer || ci_find_substr(self_replacer->name, pLocalPlayer->Name) != 0)
+		{
 			self_replacer = std::make_unique<anon_replacer>(pLocalPlayer, anon_self);
-
-		new_text = self_replacer->replace_text(new_text);
+			matcher_dirty = true;
+		}
 	}
 
+	uint64_t members = GetMembersSignature();
+	if (!matcher_dirty && members == matcher_members)
+		return;
+
+	matcher_dirty = false;
+	matcher_members = members;
+	matcher.clear();
+
+	for (const auto& replacer : replacers)
+		matcher.add(replacer.get());
+
+	if (anon_self != Anonymization::None)
+		matcher.add(self_replacer.get());
+
 	if (anon_group != Anonymization::None && pLocalPC->Group)
 	{
-		new_text = std::accumulate(
-			std::cbegin(*pLocalPC->Group),
-			std::cend(*pLocalPC->Group),
-			new_text,
-			[](std::string& text, const CGroupMember* pMember) -> std::string
-			{
-				if (pMember && pMember->Name[0] != '\0' && ci_equals(text, pMember->Name, false))
-				{
-					auto memoized = group_memoization.find(pMember->Name);
-					if (memoized == group_memoization.end())
-						memoized = group_memoization.emplace(
-							pMember->Name,
-							std::make_unique<anon_replacer>(pMember->Name, anon_group)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const CGroupMember* pMember : *pLocalPC->Group)
+		{
+			if (pMember && pMember->Name[0] != '\0')
+				matcher.add(GetMemoizedReplacer(group_memoization, pMember->Name, anon_group));
+		}
 	}
 
 	if (anon_fellowship != Anonymization::None)
 	{
-		auto& fellowship = pLocalPlayer->Fellowship;
-		new_text = std::accumulate(
-			std::cbegin(fellowship.FellowshipMember),
-			std::cend(fellowship.FellowshipMember),
-			new_text,
-			[](std::string& text, const SFellowshipMember& f) -> std::string
-			{
-				if (f.Name[0] != '\0' && ci_equals(text, f.Name, false))
-				{
-					auto memoized = fellowship_memoization.find(f.Name);
-					if (memoized == fellowship_memoization.end())
-						memoized = fellowship_memoization.emplace(
-							f.Name,
-							std::make_unique<anon_replacer>(f.Name, anon_fellowship)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const SFellowshipMember& member : pLocalPlayer->Fellowship.FellowshipMember)
+		{
+			if (member.Name[0] != '\0')
+				matcher.add(GetMemoizedReplacer(fellowship_memoization, member.Name, anon_fellowship));
+		}
 	}
 
 	if (anon_guild != Anonymization::None && pGuild)
 	{
 		const char* guild_name = pGuild->GetGuildName(pLocalPC->GuildID);
-		if (guild_name[0] != '\0' && ci_equals(new_text, guild_name, false))
-		{
-			auto memoized = guild_memoization.find(guild_name);
-			if (memoized == guild_memoization.end())
-				memoized = guild_memoization.emplace(
-					guild_name,
-					std::make_unique<anon_replacer>(guild_name, Anonymization::Asterisk)
-				).first;
-
-			new_text = memoized->second->replace_text(new_text);
-		}
+		if (guild_name[0] != '\0')
+			matcher.add(GetMemoizedReplacer(guild_memoization, guild_name, Anonymization::Asterisk));
 
 		for (GuildMember* pMember = pGuild->pFirstGuildMember; pMember; pMember = pMember->pNext)
 		{
-			if (pMember->Name[0] != '\0' && ci_equals(new_text, pMember->Name, false))
-			{
-				auto memoized = guild_memoization.find(pMember->Name);
-				if (memoized == guild_memoization.end())
-					memoized = guild_memoization.emplace(
-						pMember->Name,
-						std::make_unique<anon_replacer>(pMember->Name, anon_guild)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (pMember->Name[0] != '\0')
+				matcher.add(GetMemoizedReplacer(guild_memoization, pMember->Name, anon_guild));
 		}
 	}
 
-	if (anon_raid != Anonymization::None)
+	if (anon_raid != Anonymization::None && pRaid)
 	{
-		for (RaidMember& pMember : pRaid->RaidMember)
+		for (const RaidMember& member : pRaid->RaidMember)
 		{
-			if (pMember.Name[0] != '\0' && ci_equals(new_text, pMember.Name, false))
-			{
-				auto memoized = raid_memoization.find(pMember.Name);
-				if (memoized == raid_memoization.end())
-					memoized = raid_memoization.emplace(
-						pMember.Name,
-						std::make_unique<anon_replacer>(pMember.Name, anon_raid)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (member.Name[0] != '\0')
+				matcher.add(GetMemoizedReplacer(raid_memoization, member.Name, anon_raid));
 		}
 	}
+}
+
+CXStr Anonymize(const CXStr& Text)
+{
+	if (!MaybeAnonymize(Text))
+		return Text;
+
+	if (!pLocalPlayer || !pLocalPC)
+		return Text;
+
+	EnterMQ2Benchmark(bmAnonymizer);
+
+	UpdateMatcher();
+	std::string new_text = matcher.replace_text(Text);
 
 	ExitMQ2Benchmark(bmAnonymizer);
 
@@ -15,10 +15,328 @@
 #include "pch.h"
 #include "MQ2Main.h"
 
+#include <fstream>
+#include <new.h>
+
 namespace mq {
 
 std::vector<std::unique_ptr<MQBenchmark>> gBenchmarks;
 
+//----------------------------------------------------------------------------
+
+static size_t GetHistogramBucket(uint64_t value)
+{
+	constexpr uint64_t MaxValue = (uint64_t{ 1 } << MQBenchmarkHistogram::MaxValueBits) - 1;
+	value = std::min(value, MaxValue);
+
+	// The first two sets of sub buckets hold their values exactly, after that every power of two
+	// gets its own set, indexed by the bits just below the top one.
+	if (value < 2 * MQBenchmarkHistogram::SubBucketCount)
+		return static_cast<size_t>(value);
+
+	int topBit = 0;
+	while (value >> (topBit + 1))
+		++topBit;
+
+	const int shift = topBit - MQBenchmarkHistogram::SubBucketBits;
+	return static_cast<size_t>((shift + 1) * MQBenchmarkHistogram::SubBucketCount
+		+ ((value >> shift) - MQBenchmarkHistogram::SubBucketCount));
+}
+
+// The smallest value that lands in the bucket.
+static uint64_t GetHistogramBucketValue(size_t bucket)
+{
+	if (bucket < 2 * MQBenchmarkHistogram::SubBucketCount)
+		return bucket;
+
+	const int shift = static_cast<int>(bucket / MQBenchmarkHistogram::SubBucketCount) - 1;
+	return (bucket % MQBenchmarkHistogram::SubBucketCount + MQBenchmarkHistogram::SubBucketCount) << shift;
+}
+
+void MQBenchmarkHistogram::Record(std::chrono::nanoseconds time)
+{
+	const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(time.count(), 0));
+
+	++Buckets[GetHistogramBucket(value)];
+	++Count;
+	Max = std::max(Max, time);
+}
+
+void MQBenchmarkHistogram::Reset()
+{
+	Buckets.fill(0);
+	Count = 0;
+	Max = std::chrono::nanoseconds::zero();
+}
+
+std::chrono::nanoseconds MQBenchmarkHistogram::GetPercentile(double percentile) const
+{
+	if (Count == 0)
+		return std::chrono::nanoseconds::zero();
+
+	percentile = std::clamp(percentile, 0.0, 100.0);
+	const uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(percentile / 100.0 * Count)), 1);
+
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < BucketCount; ++bucket)
+	{
+		seen += Buckets[bucket];
+		if (seen >= target)
+		{
+			// report the top of the bucket, but never more than was actually seen
+			const uint64_t value = bucket + 1 < BucketCount ? GetHistogramBucketValue(bucket + 1) - 1 : GetHistogramBucketValue(bucket);
+			return std::min(std::chrono::nanoseconds(value), Max);
+		}
+	}
+
+	return Max;
+}
+
+//----------------------------------------------------------------------------
+
+struct MQTraceEvent
+{
+	uint32_t Name;                                      // index into s_traceNames
+	uint32_t Category;                                  // index into s_traceNames
+	uint32_t ThreadId;
+	int64_t Start;                                      // nanoseconds since the trace started
+	int64_t Duration;                                   // nanoseconds
+};
+
+// About 6MB while a trace is running. Once it is full the oldest events are overwritten.
+static constexpr size_t TRACE_EVENT_CAPACITY = 256 * 1024;
+
+static std::atomic<bool> s_traceActive = false;
+static std::mutex s_traceMutex;
+static std::vector<MQTraceEvent> s_traceEvents;
+static size_t s_traceNextEvent = 0;
+static uint64_t s_traceEventCount = 0;
+static std::chrono::steady_clock::time_point s_traceStart;
+
+// Names are stored once and referred to by index, so that recording an event doesn't allocate.
+static std::map<std::string, uint32_t, std::less<>> s_traceNameIndex;
+static std::vector<const std::string*> s_traceNames;
+
+static uint32_t GetTraceName(std::string_view name)
+{
+	auto iter = s_traceNameIndex.find(name);
+	if (iter == s_traceNameIndex.end())
+	{
+		iter = s_traceNameIndex.emplace(std::string(name), static_cast<uint32_t>(s_traceNames.size())).first;
+		s_traceNames.push_back(&iter->first);
+	}
+
+	return iter->second;
+}
+
+bool IsFrameTraceActive()
+{
+	return s_traceActive.load(std::memory_order_relaxed);
+}
+
+void AddTraceEvent(std::string_view Name, std::string_view Category,
+	std::chrono::steady_clock::time_point Start, std::chrono::steady_clock::time_point End)
+{
+	if (!IsFrameTraceActive())
+		return;
+
+	std::scoped_lock lock(s_traceMutex);
+	if (s_traceEvents.empty())
+		return;
+
+	// events that began before the trace are cut off at its start
+	Start = std::max(Start, s_traceStart);
+
+	MQTraceEvent& event = s_traceEvents[s_traceNextEvent];
+	event.Name = GetTraceName(Name);
+	event.Category = GetTraceName(Category);
+	event.ThreadId = ::GetCurrentThreadId();
+	event.Start = (Start - s_traceStart).count();
+	event.Duration = std::max<int64_t>((End - Start).count(), 0);
+
+	s_traceNextEvent = (s_traceNextEvent + 1) % s_traceEvents.size();
+	++s_traceEventCount;
+}
+
+static void StartFrameTrace()
+{
+	std::scoped_lock lock(s_traceMutex);
+
+	s_traceEvents.assign(TRACE_EVENT_CAPACITY, MQTraceEvent{});
+	s_traceNextEvent = 0;
+	s_traceEventCount = 0;
+	s_traceNameIndex.clear();
+	s_traceNames.clear();
+	s_traceStart = std::chrono::steady_clock::now();
+
+	s_traceActive = true;
+}
+
+static void AppendJsonString(std::string& out, const std::string& value)
+{
+	out += '"';
+
+	for (char ch : value)
+	{
+		switch (ch)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(ch) < 0x20)
+				fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(ch));
+			else
+				out += ch;
+			break;
+		}
+	}
+
+	out += '"';
+}
+
+// Stops the trace and writes it to the file. Returns false if the file could not be written.
+static bool StopFrameTrace(const std::string& fileName, size_t& count, uint64_t& droppedEvents)
+{
+	std::vector<MQTraceEvent> events;
+	std::vector<std::string> names;
+	size_t first = 0;
+
+	{
+		std::scoped_lock lock(s_traceMutex);
+		s_traceActive = false;
+
+		count = static_cast<size_t>(std::min<uint64_t>(s_traceEventCount, s_traceEvents.size()));
+		first = s_traceEventCount > s_traceEvents.size() ? s_traceNextEvent : 0;
+		droppedEvents = s_traceEventCount - count;
+
+		events.swap(s_traceEvents);
+		for (const std::string* name : s_traceNames)
+			names.push_back(*name);
+
+		s_traceNameIndex.clear();
+		s_traceNames.clear();
+	}
+
+	const DWORD processId = ::GetCurrentProcessId();
+
+	std::string out;
+	out.reserve(count * 96 + 256);
+	out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	// Name the main thread so that it is easy to find among the others.
+	fmt::format_to(std::back_inserter(out),
+		R"({{"name":"thread_name","ph":"M","pid":{},"tid":{},"args":{{"name":"MacroQuest Main"}}}})", processId, GetMainThreadId());
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const MQTraceEvent& event = events[(first + i) % events.size()];
+
+		out += ",\n{\"name\":";
+		AppendJsonString(out, names[event.Name]);
+		out += ",\"cat\":";
+		AppendJsonString(out, names[event.Category]);
+
+		// timestamps are in microseconds
+		fmt::format_to(std::back_inserter(out), R"(,"ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{}}})",
+			event.Start / 1000.0, event.Duration / 1000.0, processId, event.ThreadId);
+	}
+
+	out += "\n]}\n";
+
+	std::ofstream traceFile(fileName, std::ios::binary);
+	traceFile << out;
+
+	return static_cast<bool>(traceFile);
+}
+
+static void Cmd_MQTrace(SPAWNINFO* pChar, char* szLine)
+{
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szLine, 1);
+
+	if (ci_equals(szArg, "start"))
+	{
+		if (IsFrameTraceActive())
+		{
+			WriteChatf("\ay[MQTrace]\ax A trace is already running. Use \ay/mqtrace stop\ax to save it.");
+			return;
+		}
+
+		StartFrameTrace();
+		WriteChatf("\ay[MQTrace]\ax Trace started. Use \ay/mqtrace stop\ax to save it.");
+	}
+	else if (ci_equals(szArg, "stop"))
+	{
+		if (!IsFrameTraceActive())
+		{
+			WriteChatf("\ay[MQTrace]\ax No trace is running.");
+			return;
+		}
+
+		std::string fileName = GetArg(szArg, szLine, 2);
+		if (fileName.empty())
+		{
+			SYSTEMTIME t;
+			::GetLocalTime(&t);
+
+			fileName = fmt::format("mqtrace_{:04}{:02}{:02}_{:02}{:02}{:02}.json",
+				t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
+		}
+
+		std::error_code ec;
+		const std::filesystem::path tracePath = std::filesystem::path(gPathLogs) / "traces";
+		std::filesystem::create_directories(tracePath, ec);
+
+		const std::string filePath = (tracePath / fileName).string();
+
+		size_t count = 0;
+		uint64_t droppedEvents = 0;
+		if (StopFrameTrace(filePath, count, droppedEvents))
+		{
+			WriteChatf("\ay[MQTrace]\ax Saved \at%u\ax events to: %s", static_cast<uint32_t>(count), filePath.c_str());
+
+			if (droppedEvents)
+				WriteChatf("\ay[MQTrace]\ax The trace was full, the oldest \at%I64u\ax events were dropped.", droppedEvents);
+		}
+		else
+		{
+			WriteChatf("\ar[MQTrace]\ax Failed to write the trace to: %s", filePath.c_str());
+		}
+	}
+	else
+	{
+		WriteChatf("Usage: /mqtrace start|stop [filename]");
+	}
+}
+
+//----------------------------------------------------------------------------
+
+static MQAllocationCounters s_mainAllocations;
+
+// Allocations made on this thread while tracking, by any module. Benchmarks count the difference
+// between their entry and exit.
+static thread_local uint64_t s_threadAllocations = 0;
+static thread_local uint64_t s_threadAllocatedBytes = 0;
+
+void RecordAllocation(MQAllocationCounters& Counters, size_t Size)
+{
+	Counters.Count.fetch_add(1, std::memory_order_relaxed);
+	Counters.Bytes.fetch_add(Size, std::memory_order_relaxed);
+
+	++s_threadAllocations;
+	s_threadAllocatedBytes += Size;
+}
+
+const MQAllocationCounters& GetMainAllocations()
+{
+	return s_mainAllocations;
+}
+
+//----------------------------------------------------------------------------
+
 uint32_t AddMQ2Benchmark(const char* Name)
 {
 	DebugSpew("AddMQ2Benchmark(%s)", Name);
@@ -58,34 +376,185 @@ void RemoveMQ2Benchmark(uint32_t BMHandle)
 	}
 }
 
+//----------------------------------------------------------------------------
+
+struct MQActiveBenchmark
+{
+	uint32_t Handle;
+	std::chrono::steady_clock::time_point Entry;
+	std::chrono::nanoseconds ChildTime = std::chrono::nanoseconds::zero();
+	uint64_t EntryAllocations = 0;
+	uint64_t EntryAllocatedBytes = 0;
+	int Node = -1;                                      // node in s_frameTree, main thread only
+};
+
+// The benchmarks the current thread is inside of, innermost last.
+static thread_local std::vector<MQActiveBenchmark> s_benchmarkStack;
+
+// The tree for the frame in progress and the last complete one. Main thread only.
+static std::vector<MQBenchmarkNode> s_frameTree;
+static std::vector<MQBenchmarkNode> s_lastFrameTree;
+static std::chrono::steady_clock::time_point s_frameStart;
+static uint64_t s_frameStartAllocations = 0;
+static uint64_t s_frameStartAllocatedBytes = 0;
+
+static int GetBenchmarkNode(int parent, uint32_t BMHandle)
+{
+	int child = s_frameTree[parent].FirstChild;
+	int lastChild = -1;
+	while (child != -1)
+	{
+		if (s_frameTree[child].Benchmark == BMHandle)
+			return child;
+
+		lastChild = child;
+		child = s_frameTree[child].NextSibling;
+	}
+
+	child = static_cast<int>(s_frameTree.size());
+
+	MQBenchmarkNode& node = s_frameTree.emplace_back();
+	node.Benchmark = BMHandle;
+	node.Parent = parent;
+
+	if (lastChild == -1)
+		s_frameTree[parent].FirstChild = child;
+	else
+		s_frameTree[lastChild].NextSibling = child;
+
+	return child;
+}
+
+void BeginBenchmarkFrame()
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	if (!s_frameTree.empty())
+	{
+		if (IsFrameTraceActive())
+			AddTraceEvent("Frame", "frame", s_frameStart, now);
+
+		MQBenchmarkNode& root = s_frameTree[0];
+		root.Count = 1;
+		root.InclusiveTime = now - s_frameStart;
+		root.SelfTime = root.InclusiveTime;
+		root.Allocations = static_cast<uint32_t>(s_threadAllocations - s_frameStartAllocations);
+		root.AllocatedBytes = s_threadAllocatedBytes - s_frameStartAllocatedBytes;
+
+		for (int child = root.FirstChild; child != -1; child = s_frameTree[child].NextSibling)
+			root.SelfTime -= s_frameTree[child].InclusiveTime;
+		root.SelfTime = std::max(root.SelfTime, std::chrono::nanoseconds::zero());
+
+		std::swap(s_lastFrameTree, s_frameTree);
+	}
+
+	s_frameTree.clear();
+	s_frameTree.emplace_back();
+	s_frameStart = now;
+	s_frameStartAllocations = s_threadAllocations;
+	s_frameStartAllocatedBytes = s_threadAllocatedBytes;
+
+	// Benchmarks still running carry on in the new frame, and their time is reported in the
+	// frame that they finish in.
+	int parent = 0;
+	for (MQActiveBenchmark& active : s_benchmarkStack)
+	{
+		active.Node = GetBenchmarkNode(parent, active.Handle);
+		parent = active.Node;
+	}
+}
+
+const std::vector<MQBenchmarkNode>& GetBenchmarkFrameTree()
+{
+	return s_lastFrameTree;
+}
+
 void EnterMQ2Benchmark(uint32_t BMHandle)
 {
 	if (BMHandle < gBenchmarks.size() && gBenchmarks[BMHandle])
 	{
-		gBenchmarks[BMHandle]->Entry = std::chrono::steady_clock::now();
+		MQActiveBenchmark& active = s_benchmarkStack.emplace_back();
+		active.Handle = BMHandle;
+
+		if (!s_frameTree.empty() && IsMainThread())
+		{
+			const size_t depth = s_benchmarkStack.size();
+			const int parent = depth > 1 ? s_benchmarkStack[depth - 2].Node : 0;
+
+			active.Node = GetBenchmarkNode(parent != -1 ? parent : 0, BMHandle);
+		}
+
+		// take the counts and the time last so that setting up the entry is not counted
+		active.EntryAllocations = s_threadAllocations;
+		active.EntryAllocatedBytes = s_threadAllocatedBytes;
+		active.Entry = std::chrono::steady_clock::now();
+		gBenchmarks[BMHandle]->Entry = active.Entry;
 	}
 }
 
 void ExitMQ2Benchmark(uint32_t BMHandle)
 {
+	const auto now = std::chrono::steady_clock::now();
+
 	if (BMHandle < gBenchmarks.size() && gBenchmarks[BMHandle])
 	{
-		MQBenchmark& benchmark = *gBenchmarks[BMHandle];
+		auto iter = std::find_if(s_benchmarkStack.rbegin(), s_benchmarkStack.rend(),
+			[BMHandle](const MQActiveBenchmark& active) { return active.Handle == BMHandle; });
+		if (iter == s_benchmarkStack.rend())
+			return;
+
+		// Anything entered inside of this benchmark that was never left is dropped.
+		const MQActiveBenchmark active = *iter;
+		s_benchmarkStack.erase(std::prev(iter.base()), s_benchmarkStack.end());
+
+		const std::chrono::nanoseconds Time = now - active.Entry;
+		const std::chrono::nanoseconds SelfTime = std::max(Time - active.ChildTime, std::chrono::nanoseconds::zero());
+		const uint64_t Allocations = s_threadAllocations - active.EntryAllocations;
+		const uint64_t AllocatedBytes = s_threadAllocatedBytes - active.EntryAllocatedBytes;
 
-		std::chrono::microseconds Time = std::chrono::duration_cast<std::chrono::microseconds>(
-			std::chrono::steady_clock::now() - benchmark.Entry);
+		if (!s_benchmarkStack.empty())
+			s_benchmarkStack.back().ChildTime += Time;
+
+		// a re-entered benchmark is already counting this time in its outer entry
+		const bool outermost = std::none_of(s_benchmarkStack.begin(), s_benchmarkStack.end(),
+			[BMHandle](const MQActiveBenchmark& outer) { return outer.Handle == BMHandle; });
+
+		MQBenchmark& benchmark = *gBenchmarks[BMHandle];
 
-		benchmark.LastTime += Time;
 		if (benchmark.Count > 4000000000)
 		{
-			benchmark.Count = 1;
-			benchmark.TotalTime = Time;
+			benchmark.Count = 0;
+			benchmark.TotalTime = std::chrono::nanoseconds::zero();
+			benchmark.SelfTime = std::chrono::nanoseconds::zero();
+			benchmark.Allocations = 0;
+			benchmark.AllocatedBytes = 0;
+			benchmark.Histogram.Reset();
 		}
-		else
+
+		benchmark.Count++;
+		benchmark.SelfTime += SelfTime;
+		benchmark.Histogram.Record(Time);
+
+		if (outermost)
 		{
-			benchmark.Count++;
+			benchmark.LastTime += Time;
 			benchmark.TotalTime += Time;
+			benchmark.Allocations += Allocations;
+			benchmark.AllocatedBytes += AllocatedBytes;
 		}
+
+		if (active.Node != -1 && static_cast<size_t>(active.Node) < s_frameTree.size())
+		{
+			MQBenchmarkNode& node = s_frameTree[active.Node];
+			node.Count++;
+			node.InclusiveTime += Time;
+			node.SelfTime += SelfTime;
+			node.Allocations += static_cast<uint32_t>(Allocations);
+			node.AllocatedBytes += AllocatedBytes;
+		}
+
+		if (IsFrameTraceActive())
+			AddTraceEvent(benchmark.Name, "benchmark", active.Entry, now);
 	}
 }
 
@@ -100,9 +569,59 @@ bool GetMQ2Benchmark(uint32_t BMHandle, MQBenchmark& Dest)
 	return false;
 }
 
+bool FindMQ2Benchmark(std::string_view Name, uint32_t& BMHandle)
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(gBenchmarks.size()); ++i)
+	{
+		if (gBenchmarks[i] && ci_equals(gBenchmarks[i]->Name, Name))
+		{
+			BMHandle = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static float ToMilliseconds(std::chrono::nanoseconds time)
+{
+	return std::chrono::duration<float, std::milli>(time).count();
+}
+
+static void WriteBenchmarkNode(const std::vector<MQBenchmarkNode>& tree, int index, int depth)
+{
+	const MQBenchmarkNode& node = tree[index];
+
+	const char* name = "Frame";
+	if (node.Benchmark != MQBenchmarkNode::FrameRoot)
+	{
+		name = node.Benchmark < gBenchmarks.size() && gBenchmarks[node.Benchmark]
+			? gBenchmarks[node.Benchmark]->Name.c_str() : "(removed)";
+	}
+
+	WriteChatf("%*s[\ay%s\ax] \at%.3f\axms, \at%.3f\axms self, \at%u\ax calls",
+		depth * 2, "", name, ToMilliseconds(node.InclusiveTime), ToMilliseconds(node.SelfTime), node.Count);
+
+	for (int child = node.FirstChild; child != -1; child = tree[child].NextSibling)
+		WriteBenchmarkNode(tree, child, depth + 1);
+}
+
 void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 {
-	if (szLine && szLine[0] == '/')
+	if (szLine && ci_equals(szLine, "tree"))
+	{
+		const std::vector<MQBenchmarkNode>& tree = GetBenchmarkFrameTree();
+		if (tree.empty())
+		{
+			WriteChatf("No frame has been benchmarked yet.");
+			return;
+		}
+
+		WriteChatColor("MQ2 Benchmarks (last frame)");
+		WriteChatColor("---------------------------");
+		WriteBenchmarkNode(tree, 0, 0);
+	}
+	else if (szLine && szLine[0] == '/')
 	{
 		uint64_t Start = MQGetTickCount64();
 		HideDoCommand(pChar, szLine, false);
@@ -121,11 +640,14 @@ void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 			{
 				float AvgMS = 0;
 				if (pBenchmark->Count)
-					AvgMS = static_cast<float>(pBenchmark->TotalTime.count()) / static_cast<float>(pBenchmark->Count) / 1000.f;
-				float TotalMS = static_cast<float>(pBenchmark->TotalTime.count()) / 1000.f;
+					AvgMS = ToMilliseconds(pBenchmark->TotalTime) / static_cast<float>(pBenchmark->Count);
+				float TotalMS = ToMilliseconds(pBenchmark->TotalTime);
 
-				WriteChatf("[\ay%s\ax] \at%I64u\ax for \at%.3fu\axms, \at%.3f\axms avg",
-					pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS);
+				const MQBenchmarkHistogram& histogram = pBenchmark->Histogram;
+				WriteChatf("[\ay%s\ax] \at%I64u\ax for \at%.3fu\axms (\at%.3f\axms self), \at%.3f\axms avg, p50 \at%.3f\ax p95 \at%.3f\ax p99 \at%.3f\ax max \at%.3f\axms",
+					pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, ToMilliseconds(pBenchmark->SelfTime), AvgMS,
+					ToMilliseconds(histogram.GetPercentile(50)), ToMilliseconds(histogram.GetPercentile(95)),
+					ToMilliseconds(histogram.GetPercentile(99)), ToMilliseconds(histogram.Max));
 			}
 		}
 
@@ -145,11 +667,14 @@ void DumpBenchmarks()
 		{
 			float AvgMS = 0;
 			if (pBenchmark->Count)
-				AvgMS = static_cast<float>(pBenchmark->TotalTime.count()) / static_cast<float>(pBenchmark->Count) / 1000.f;
-			float TotalMS = static_cast<float>(pBenchmark->TotalTime.count()) / 1000.f;
+				AvgMS = ToMilliseconds(pBenchmark->TotalTime) / static_cast<float>(pBenchmark->Count);
+			float TotalMS = ToMilliseconds(pBenchmark->TotalTime);
 
-			DebugSpewAlways("%-40s  %d for %.3fms, %.3fms avg",
-				pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS);
+			const MQBenchmarkHistogram& histogram = pBenchmark->Histogram;
+			DebugSpewAlways("%-40s  %d for %.3fms, %.3fms avg, p50 %.3fms, p95 %.3fms, p99 %.3fms, max %.3fms",
+				pBenchmark->Name.c_str(), pBenchmark->Count, TotalMS, AvgMS,
+				ToMilliseconds(histogram.GetPercentile(50)), ToMilliseconds(histogram.GetPercentile(95)),
+				ToMilliseconds(histogram.GetPercentile(99)), ToMilliseconds(histogram.Max));
 		}
 	}
 
@@ -157,11 +682,125 @@ void DumpBenchmarks()
 	DebugSpewAlways("End Benchmarks");
 }
 
+#pragma region tlo
+
+namespace datatypes {
+
+enum class BenchmarkTypeMembers
+{
+	Name = 1,
+	Count,
+	Total,
+	Average,
+	Median,
+	P95,
+	P99,
+	Max,
+	Percentile,
+};
+
+MQ2BenchmarkType::MQ2BenchmarkType() : MQ2Type("benchmark")
+{
+	ScopedTypeMember(BenchmarkTypeMembers, Name);
+	ScopedTypeMember(BenchmarkTypeMembers, Count);
+	ScopedTypeMember(BenchmarkTypeMembers, Total);
+	ScopedTypeMember(BenchmarkTypeMembers, Average);
+	ScopedTypeMember(BenchmarkTypeMembers, Median);
+	ScopedTypeMember(BenchmarkTypeMembers, P95);
+	ScopedTypeMember(BenchmarkTypeMembers, P99);
+	ScopedTypeMember(BenchmarkTypeMembers, Max);
+	ScopedTypeMember(BenchmarkTypeMembers, Percentile);
+}
+
+// All of the times are in milliseconds.
+bool MQ2BenchmarkType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
+{
+	const uint32_t handle = VarPtr.DWord;
+	if (handle >= gBenchmarks.size() || !gBenchmarks[handle])
+		return false;
+
+	const MQBenchmark& benchmark = *gBenchmarks[handle];
+
+	auto pMember = MQ2BenchmarkType::FindMember(Member);
+	if (pMember == nullptr)
+		return false;
+
+	switch (static_cast<BenchmarkTypeMembers>(pMember->ID))
+	{
+	case BenchmarkTypeMembers::Name:
+		strcpy_s(DataTypeTemp, benchmark.Name.c_str());
+		Dest.Ptr = &DataTypeTemp[0];
+		Dest.Type = pStringType;
+		return true;
+
+	case BenchmarkTypeMembers::Count:
+		Dest.Int64 = benchmark.Count;
+		Dest.Type = pInt64Type;
+		return true;
+
+	case BenchmarkTypeMembers::Total:
+		Dest.Set(ToMilliseconds(benchmark.TotalTime));
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::Average:
+		Dest.Set(benchmark.Count ? ToMilliseconds(benchmark.TotalTime) / static_cast<float>(benchmark.Count) : 0.0f);
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::Median:
+		Dest.Set(ToMilliseconds(benchmark.Histogram.GetPercentile(50)));
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::P95:
+		Dest.Set(ToMilliseconds(benchmark.Histogram.GetPercentile(95)));
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::P99:
+		Dest.Set(ToMilliseconds(benchmark.Histogram.GetPercentile(99)));
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::Max:
+		Dest.Set(ToMilliseconds(benchmark.Histogram.Max));
+		Dest.Type = pFloatType;
+		return true;
+
+	case BenchmarkTypeMembers::Percentile:
+		if (!Index[0])
+			return false;
+
+		Dest.Set(ToMilliseconds(benchmark.Histogram.GetPercentile(GetDoubleFromString(Index, 0.0))));
+		Dest.Type = pFloatType;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool MQ2BenchmarkType::ToString(MQVarPtr VarPtr, char* Destination)
+{
+	const uint32_t handle = VarPtr.DWord;
+	if (handle >= gBenchmarks.size() || !gBenchmarks[handle])
+		return false;
+
+	strcpy_s(Destination, MAX_STRING, gBenchmarks[handle]->Name.c_str());
+	return true;
+}
+
+} // namespace datatypes
+
+#pragma endregion
+
 void InitializeMQ2Benchmarks()
 {
 	DebugSpew("Initializing MQ2 Benchmarks");;
 
 	AddCommand("/benchmark", Cmd_DumpBenchmarks, false, false);
+	AddCommand("/mqtrace", Cmd_MQTrace, false, false);
 }
 
 void ShutdownMQ2Benchmarks()
@@ -170,8 +809,35 @@ void ShutdownMQ2Benchmarks()
 
 	DumpBenchmarks();
 	RemoveCommand("/benchmark");
+	RemoveCommand("/mqtrace");
+
+	if (IsFrameTraceActive())
+	{
+		std::scoped_lock lock(s_traceMutex);
+		s_traceActive = false;
+		s_traceEvents.clear();
+	}
 
 	gBenchmarks.clear();
 }
 
 } // namespace mq
+
+//----------------------------------------------------------------------------
+// MQ2Main's operator new. The array and nothrow forms all come through here, the aligned ones do
+// not. Memory still comes from malloc, so the default operator delete frees it.
+
+void* operator new(size_t size)
+{
+	if (mq::gbTrackAllocations)
+		mq::RecordAllocation(mq::s_mainAllocations, size);
+
+	for (;;)
+	{
+		if (void* block = malloc(size))
+			return block;
+
+		if (_callnewh(size) == 0)
+			throw std::bad_alloc();
+	}
+}
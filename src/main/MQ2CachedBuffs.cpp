@@ -19,28 +19,245 @@
 
 namespace mq {
 
+static void CachedBuffs_Pulse();
+
+static MQModule s_cachedBuffsModule = {
+	"CachedBuffs",                 // Name
+	false,                         // CanUnload
+	nullptr,
+	nullptr,
+	CachedBuffs_Pulse,
+};
+DECLARE_MODULE_INITIALIZER(s_cachedBuffsModule);
+
+static constexpr DWORD CACHED_BUFF_FADING_TIME = 6000;     // ms before a buff fades that it is signalled as fading
+
+static bool IsCachedBuffExpired(int duration, DWORD timeStamp, DWORD now)
+{
+	if (pZoneInfo && pZoneInfo->bNoBuffExpiration)
+		return false;
+
+	return duration >= 0 && timeStamp + (duration * 6000) <= now;
+}
+
+// Where each spell is in the cached buffs, so finding every spawn with a spell doesn't have to go
+// through every spawn's buffs. Kept in step with SpawnBuffs as buffs are added and removed.
+struct CachedBuffLocation
+{
+	int spawnID;
+	int slot;
+	int duration;
+	DWORD timeStamp;
+};
+
+// spellID -> cached buffs with that spell
+static std::unordered_map<int, std::vector<CachedBuffLocation>> s_cachedBuffsBySpell;
+
+static void AddToSpellIndex(int spawnID, const CachedBuff& buff)
+{
+	s_cachedBuffsBySpell[buff.spellId].push_back({ spawnID, buff.slot, buff.duration, buff.timeStamp });
+}
+
+static void RemoveFromSpellIndex(int spawnID, const CachedBuff& buff)
+{
+	auto iter = s_cachedBuffsBySpell.find(buff.spellId);
+	if (iter == s_cachedBuffsBySpell.end())
+		return;
+
+	auto& locations = iter->second;
+	locations.erase(std::remove_if(std::begin(locations), std::end(locations),
+		[spawnID, &buff](const CachedBuffLocation& location)
+		{
+			return location.spawnID == spawnID && location.slot == buff.slot;
+		}), std::end(locations));
+
+	if (locations.empty())
+		s_cachedBuffsBySpell.erase(iter);
+}
+
+#pragma region Expiry Timer Wheel
+//----------------------------------------------------------------------------
+// Hierarchical timer wheel for cached buff expiries. Each level has 64 slots: a slot of the first
+// level is one tick, and a slot of every level after it covers the whole of the level below. Entries
+// move down a level as their time draws closer, so scheduling and firing them is constant time
+// however far out they are, and nothing has to scan the cached buffs to find the ones that expired.
+//----------------------------------------------------------------------------
+
+class CachedBuffExpiryWheel
+{
+public:
+	static constexpr DWORD TICK_MS = 100;
+
+	struct Entry
+	{
+		uint64_t tick;
+		int spawnID;
+		int slot;
+		int spellID;
+		DWORD timeStamp;
+		bool fading;                   // fading warning rather than the expiry itself
+	};
+
+private:
+	static constexpr int SLOT_BITS = 6;
+	static constexpr int NUM_SLOTS = 1 << SLOT_BITS;
+	static constexpr int NUM_LEVELS = 4;
+
+	std::vector<Entry> m_slots[NUM_LEVELS][NUM_SLOTS];
+	uint64_t m_currentTick = 0;
+	uint64_t m_clockMS = 0;            // EQGetTime without the wraparound
+	DWORD m_lastTime = 0;
+	bool m_started = false;
+
+	// minTick is the earliest tick whose slot hasn't been fired yet
+	void Place(const Entry& entry, uint64_t minTick)
+	{
+		uint64_t tick = std::max(entry.tick, minTick);
+		const uint64_t delta = tick - m_currentTick;
+
+		int level = 0;
+		while (level < NUM_LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))))
+			++level;
+
+		// past the top level it waits in the furthest slot and is placed again when that comes up
+		const uint64_t maxDelta = (1ULL << (SLOT_BITS * NUM_LEVELS)) - 1;
+		if (delta > maxDelta)
+			tick = m_currentTick + maxDelta;
+
+		m_slots[level][(tick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1)].push_back(entry);
+	}
+
+	void UpdateClock()
+	{
+		const DWORD now = EQGetTime();
+		if (!m_started)
+		{
+			m_started = true;
+			m_lastTime = now;
+			m_clockMS = static_cast<uint64_t>(TICK_MS);
+			m_currentTick = 1;
+		}
+
+		m_clockMS += static_cast<DWORD>(now - m_lastTime);
+		m_lastTime = now;
+	}
+
+public:
+	void Clear()
+	{
+		for (auto& level : m_slots)
+		{
+			for (auto& slot : level)
+				slot.clear();
+		}
+	}
+
+	// expiresAt is in EQGetTime milliseconds
+	void Schedule(int spawnID, const CachedBuff& buff, DWORD expiresAt, bool fading)
+	{
+		UpdateClock();
+
+		const int32_t remaining = static_cast<int32_t>(expiresAt - m_lastTime);
+		const uint64_t expiresMS = remaining > 0 ? m_clockMS + remaining : m_clockMS;
+
+		// anything already due fires on the next advance
+		Place({ (expiresMS + TICK_MS - 1) / TICK_MS, spawnID, buff.slot, buff.spellId, buff.timeStamp, fading },
+			m_currentTick + 1);
+	}
+
+	template <typename Func>
+	void Advance(Func&& func)
+	{
+		UpdateClock();
+
+		std::vector<Entry> due;
+		const uint64_t nowTick = m_clockMS / TICK_MS;
+
+		while (m_currentTick < nowTick)
+		{
+			++m_currentTick;
+
+			// move the next slot of each level down, from the top so they land in the right place
+			for (int level = NUM_LEVELS - 1; level > 0; --level)
+			{
+				if ((m_currentTick & ((1ULL << (SLOT_BITS * level)) - 1)) != 0)
+					continue;
+
+				auto& slot = m_slots[level][(m_currentTick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1)];
+				std::vector<Entry> entries;
+				entries.swap(slot);
+
+				for (const Entry& entry : entries)
+					Place(entry, m_currentTick);
+			}
+
+			auto& slot = m_slots[0][m_currentTick & (NUM_SLOTS - 1)];
+			due.insert(due.end(), slot.begin(), slot.end());
+			slot.clear();
+		}
+
+		for (const Entry& entry : due)
+			func(entry);
+	}
+};
+
+static CachedBuffExpiryWheel s_expiryWheel;
+
+static void ScheduleCachedBuffExpiry(int spawnID, const CachedBuff& buff)
+{
+	if (buff.duration < 0)
+		return;
+
+	const DWORD expiresAt = buff.timeStamp + (buff.duration * 6000);
+	const DWORD now = EQGetTime();
+
+	if (static_cast<int32_t>(expiresAt - now) > static_cast<int32_t>(CACHED_BUFF_FADING_TIME))
+		s_expiryWheel.Schedule(spawnID, buff, expiresAt - CACHED_BUFF_FADING_TIME, true);
+
+	s_expiryWheel.Schedule(spawnID, buff, expiresAt, false);
+}
+
+#pragma endregion
+
 class SpawnBuffs
 {
 public:
+	explicit SpawnBuffs(int spawnID) : spawnID(spawnID) {}
+
+	int spawnID;
+
 	// timestamp of buff packet, target buff received in packet
 	std::vector<CachedBuff> cachedBuffs;
 
-	void Clear() noexcept { cachedBuffs.clear(); }
+	void Clear() noexcept
+	{
+		for (const CachedBuff& buff : cachedBuffs)
+			RemoveFromSpellIndex(spawnID, buff);
+
+		cachedBuffs.clear();
+	}
 
 	void Audit()
 	{
-		if (!pZoneInfo || !pZoneInfo->bNoBuffExpiration)
-		{
-			cachedBuffs.erase(std::remove_if(std::begin(cachedBuffs), std::end(cachedBuffs),
-				[](const CachedBuff& buff) { return buff.duration >= 0 && buff.Duration() == 0U; }), std::end(cachedBuffs));
-		}
+		const DWORD now = EQGetTime();
+
+		cachedBuffs.erase(std::remove_if(std::begin(cachedBuffs), std::end(cachedBuffs),
+			[this, now](const CachedBuff& buff)
+			{
+				if (!IsCachedBuffExpired(buff.duration, buff.timeStamp, now))
+					return false;
+
+				RemoveFromSpellIndex(spawnID, buff);
+				return true;
+			}), std::end(cachedBuffs));
 	}
 
-	template <typename ...Args>
-	void Emplace(Args&& ... args)
+	void Emplace(const CachedBuff& buff)
 	{
 		// by virtue of how we add to this vector, we won't have duplicates since we always clear before
-		cachedBuffs.emplace_back(std::forward<Args>(args)...);
+		cachedBuffs.push_back(buff);
+		AddToSpellIndex(spawnID, buff);
+		ScheduleCachedBuffExpiry(spawnID, buff);
 	}
 
 	auto Drop(std::function<bool(CachedBuff)> predicate)
@@ -51,14 +268,28 @@ public:
 
 	void Drop(int index)
 	{
+		RemoveFromSpellIndex(spawnID, cachedBuffs[index]);
 		cachedBuffs.erase(std::begin(cachedBuffs) + index);
 	}
 
+	// The index of the buff in a slot if it is still the one from the given packet, otherwise -1.
+	int Find(int slot, int spellID, DWORD timeStamp) const
+	{
+		for (size_t index = 0; index < cachedBuffs.size(); ++index)
+		{
+			const CachedBuff& buff = cachedBuffs[index];
+			if (buff.slot == slot)
+				return buff.spellId == spellID && buff.timeStamp == timeStamp ? static_cast<int>(index) : -1;
+		}
+
+		return -1;
+	}
+
 	std::optional<CachedBuff> Get(const std::function<bool(CachedBuff)>& predicate)
 	{
 		Audit();
 		auto buff_it = std::find_if(std::begin(cachedBuffs), std::end(cachedBuffs),
-			[&predicate](CachedBuff buff) { return predicate(buff); });
+			[&predicate](const CachedBuff& buff) { return predicate(buff); });
 
 		if (buff_it != std::end(cachedBuffs))
 			return *buff_it;
@@ -79,7 +310,7 @@ public:
 	{
 		Audit();
 		std::vector<CachedBuff> ret;
-		for (auto b : cachedBuffs)
+		for (const auto& b : cachedBuffs)
 		{
 			if (predicate(b))
 				ret.emplace_back(b);
@@ -92,6 +323,46 @@ public:
 // spawnID -> spawn buffs
 static std::map<int, std::unique_ptr<SpawnBuffs>> gCachedBuffMap;
 
+static Signal<uint32_t, const CachedBuff&> s_cachedBuffFadingSignal;
+static Signal<uint32_t, const CachedBuff&> s_cachedBuffFadedSignal;
+
+Signal<uint32_t, const CachedBuff&>& GetCachedBuffFadingSignal()
+{
+	return s_cachedBuffFadingSignal;
+}
+
+Signal<uint32_t, const CachedBuff&>& GetCachedBuffFadedSignal()
+{
+	return s_cachedBuffFadedSignal;
+}
+
+static void CachedBuffs_Pulse()
+{
+	s_expiryWheel.Advance([](const CachedBuffExpiryWheel::Entry& entry)
+		{
+			auto buffs = gCachedBuffMap.find(entry.spawnID);
+			if (buffs == std::end(gCachedBuffMap))
+				return;
+
+			// buffs that were replaced by a newer packet since this was scheduled are left alone
+			SpawnBuffs& spawnBuffs = *buffs->second;
+			int index = spawnBuffs.Find(entry.slot, entry.spellID, entry.timeStamp);
+			if (index < 0)
+				return;
+
+			const CachedBuff buff = spawnBuffs.cachedBuffs[index];
+			if (entry.fading)
+			{
+				s_cachedBuffFadingSignal(static_cast<uint32_t>(entry.spawnID), buff);
+			}
+			else if (!pZoneInfo || !pZoneInfo->bNoBuffExpiration)
+			{
+				spawnBuffs.Drop(index);
+				s_cachedBuffFadedSignal(static_cast<uint32_t>(entry.spawnID), buff);
+			}
+		});
+}
+
 class CEverQuestHook
 {
 public:
@@ -125,7 +396,7 @@ public:
 		// full buff messages.
 		if (header.m_bComplete)
 		{
-			auto [it, result] = gCachedBuffMap.try_emplace(header.m_id, std::make_unique<SpawnBuffs>());
+			auto [it, result] = gCachedBuffMap.try_emplace(header.m_id, std::make_unique<SpawnBuffs>(header.m_id));
 			it->second->Clear();
 
 			for (int i = 0; i < header.m_count; i++)
@@ -197,14 +468,63 @@ int GetCachedBuffAt(SPAWNINFO* pSpawn, size_t index, const std::function<bool(co
 {
 	if (pSpawn)
 	{
-		auto buffs = FilterCachedBuffs(pSpawn, predicate);
-		if (index >= 0 && index < buffs.size())
-			return buffs.at(index).slot;
+		auto buffs = gCachedBuffMap.find(pSpawn->SpawnID);
+		if (buffs != std::end(gCachedBuffMap))
+		{
+			buffs->second->Audit();
+			for (const CachedBuff& buff : buffs->second->cachedBuffs)
+			{
+				if (predicate(buff) && index-- == 0)
+					return buff.slot;
+			}
+		}
+	}
+
+	return -1;
+}
+
+int GetCachedBuffSlotBySpellID(SPAWNINFO* pSpawn, int spellID)
+{
+	if (!pSpawn)
+		return -1;
+
+	auto iter = s_cachedBuffsBySpell.find(spellID);
+	if (iter == s_cachedBuffsBySpell.end())
+		return -1;
+
+	const DWORD now = EQGetTime();
+	for (const CachedBuffLocation& location : iter->second)
+	{
+		if (location.spawnID == pSpawn->SpawnID && !IsCachedBuffExpired(location.duration, location.timeStamp, now))
+			return location.slot;
 	}
 
 	return -1;
 }
 
+size_t GetSpawnsWithCachedBuff(int spellID, std::vector<uint32_t>& spawnIDs)
+{
+	auto iter = s_cachedBuffsBySpell.find(spellID);
+	if (iter == s_cachedBuffsBySpell.end())
+		return 0;
+
+	const DWORD now = EQGetTime();
+	size_t count = 0;
+	int lastSpawnID = 0;
+	for (const CachedBuffLocation& location : iter->second)
+	{
+		// a spawn's buffs are added together, so the same spell in two of its slots is side by side
+		if (location.spawnID != lastSpawnID && !IsCachedBuffExpired(location.duration, location.timeStamp, now))
+		{
+			lastSpawnID = location.spawnID;
+			spawnIDs.push_back(static_cast<uint32_t>(location.spawnID));
+			++count;
+		}
+	}
+
+	return count;
+}
+
 std::vector<CachedBuff> FilterCachedBuffs(SPAWNINFO* pSpawn, const std::function<bool(const CachedBuff&)>& predicate)
 {
 	if (pSpawn)
@@ -262,6 +582,8 @@ void ClearCachedBuffsSpawn(SPAWNINFO* pSpawn)
 void ClearCachedBuffs()
 {
 	gCachedBuffMap.clear();
+	s_cachedBuffsBySpell.clear();
+	s_expiryWheel.Clear();
 }
 
 void CachedBuffsCommand(SPAWNINFO* pChar, char* szLine)
@@ -301,6 +623,8 @@ void InitializeCachedBuffs()
 void ShutdownCachedBuffs()
 {
 	RemoveDetour(CTargetWnd__RefreshTargetBuffs);
+
+	s_expiryWheel.Clear();
 }
 
 } // namespace mq
@@ -43,28 +43,7 @@ public:
 			CheckChatForEvent(szMsg);
 		}
 
-		bool Filtered = false;
-		MQFilter* Filter = gpFilters;
-
-		while (Filter && !Filtered)
-		{
-			if (!Filter->pEnabled || *Filter->pEnabled)
-			{
-				if (*Filter->FilterText == '*')
-				{
-					if (strstr(szMsg, Filter->FilterText + 1))
-						Filtered = true;
-				}
-				else
-				{
-					if (!_strnicmp(szMsg, Filter->FilterText, Filter->Length))
-						Filtered = true;
-				}
-			}
-			Filter = Filter->pNext;
-		}
-
-		if (!Filtered)
+		if (!IsChatFiltered(szMsg))
 		{
 			bool SkipTrampoline = false;
 			Benchmark(bmPluginsIncomingChat, SkipTrampoline = PluginsIncomingChat(szMsg, dwColor));
@@ -99,9 +78,23 @@ public:
 		gbInChat = true;
 		bool SkipTrampoline = false;
 
-		size_t len = strlen(message) + 64;
-		auto pBuffer = std::make_unique<char[]>(len);
-		char* szMsg = pBuffer.get();
+		// a tell is worth answering quickly, even on an idle client
+		NotifyFrameLimiterActivity();
+
+		size_t len = strlen(message) + strlen(from) + 64;
+		char szBuffer[MAX_STRING];
+		std::unique_ptr<char[]> pBuffer;
+		char* szMsg = szBuffer;
+
+		if (len > MAX_STRING)
+		{
+			pBuffer = std::make_unique<char[]>(len);
+			szMsg = pBuffer.get();
+		}
+		else
+		{
+			len = MAX_STRING;
+		}
 
 		if (szMsg)
 		{
@@ -305,6 +298,11 @@ void InitializeChatHook()
 	pEventBlech = new Blech('#', '|', MQ2DataVariableLookup);
 	pMQ2Blech = new Blech('#', '|', MQ2DataVariableLookup);
 
+	// Match all #events against a line in one pass instead of walking the event tree.
+	const bool compiledEvents = GetPrivateProfileBool("MacroQuest", "CompiledEvents", false, mq::internal_paths::MQini);
+	pEventBlech->SetCompiled(compiledEvents);
+	pMQ2Blech->SetCompiled(compiledEvents);
+
 	EzDetour(CEverQuest__dsp_chat, &CChatHook::Detour, &CChatHook::Trampoline);
 	EzDetour(CEverQuest__DoTellWindow, &CChatHook::TellWnd_Detour, &CChatHook::TellWnd_Trampoline);
 	EzDetour(CEverQuest__UPCNotificationFlush, &CChatHook::UPCNotificationFlush_Detour, &CChatHook::UPCNotificationFlush_Trampoline);
@@ -30,12 +30,14 @@ public:
 			PluginsCleanUI();
 		}
 
+		ClearWindowChildIndex();
 		CleanUI_Trampoline();
 	}
 
 	void ReloadUI_Hook()
 	{
 		InitializeInGameUI();
+		ClearWindowChildIndex();
 
 		{
 			MQScopedBenchmark bm(bmPluginsReloadUI);
@@ -84,6 +86,15 @@ void DrawNetStatus_Detour(uint16_t x, uint16_t y, void* udpConnection, uint32_t
 
 void DrawHUD()
 {
+	ClearHUDTextBatch();
+
+	// nothing drawn now would make it to the screen
+	if (!IsFrameLimiterRendering())
+	{
+		DrawHUDParams[0] = 0;
+		return;
+	}
+
 	// no point in drawing hud anywhere else
 	if (gGameState == GAMESTATE_INGAME || gGameState == GAMESTATE_CHARSELECT)
 	{
@@ -106,6 +117,12 @@ void DrawHUD()
 
 void DrawHUDText(const char* Text, int X, int Y, unsigned int Argb, int Font)
 {
+	if (gbHUDOverlay)
+	{
+		AddHUDTextToBatch(Text, X, Y, Argb, Font);
+		return;
+	}
+
 	CTextureFont* pFont = pWndMgr->GetFont(Font);
 	if (!pFont)
 		return;
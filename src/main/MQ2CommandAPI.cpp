@@ -24,11 +24,30 @@ void FailIf(SPAWNINFO* pChar, const char* szCommand, int pStartLine, bool All);
 
 struct MQTimedCommand
 {
-	uint64_t      Time;
-	char          Command[MAX_STRING];
+	uint64_t      Time = 0;
+	uint64_t      Sequence = 0;
+	std::string   Command;
 
-	MQTimedCommand* pLast;
-	MQTimedCommand* pNext;
+	MQTimedCommand* pNext = nullptr;      // while waiting in s_pendingTimedCommands
+};
+
+// Orders s_timedCommands so the front is the first due. Commands due at the same time run newest
+// first, which is the order they always ran in.
+struct MQTimedCommandCompare
+{
+	bool operator()(const MQTimedCommand* a, const MQTimedCommand* b) const
+	{
+		if (a->Time != b->Time)
+			return a->Time > b->Time;
+
+		return a->Sequence < b->Sequence;
+	}
+};
+
+struct MQDelayedCommand
+{
+	std::string      Command;
+	MQDelayedCommand* pNext = nullptr;
 };
 
 struct MQCommand
@@ -43,34 +62,180 @@ struct MQCommand
 	MQCommand* pNext;
 };
 
-struct MQSubstitution
-{
-	char szOrig[MAX_STRING];
-	char szSub[MAX_STRING];
+static MQCommand* s_pCommands = nullptr;
 
-	MQSubstitution* pNext;
-	MQSubstitution* pLast;
-};
+// Exact lookup into s_pCommands, keyed by the command's own name. When a command is added more
+// than once this points at the newest one, which is also the first in the list.
+static ci_unordered::map<std::string_view, MQCommand*> s_commandsByName;
 
-static MQCommand* s_pCommands = nullptr;
-static MQTimedCommand* s_pTimedCommands = nullptr;
-static MQSubstitution* s_pSubstitutions = nullptr;
-static std::vector<std::string> s_delayedCommands;
-static std::map<std::string, std::string> mAliases;
+// Delayed and timed commands can be queued from any thread. They are pushed onto these lock free
+// stacks, and PulseCommands takes the whole stack in one exchange, so nothing waits on the main
+// thread while it runs commands.
+static std::atomic<MQDelayedCommand*> s_delayedCommands = nullptr;
+static std::atomic<MQTimedCommand*> s_pendingTimedCommands = nullptr;
+static std::atomic<uint64_t> s_timedCommandSequence = 0;
+
+// Timed commands waiting to run, as a heap ordered by MQTimedCommandCompare. Main thread only.
+static std::vector<MQTimedCommand*> s_timedCommands;
+static std::map<std::string, std::string, ci_less> mAliases;
+static std::map<std::string, std::string, ci_less> s_substitutions;
+
+// Changes whenever a command or alias is added or removed, invalidating compiled macro lines.
+static uint32_t s_commandGeneration = 1;
 
 
 void PopMacroLoop();
 
-void HideDoCommand(SPAWNINFO* pChar, const char* szLine, bool delayed)
+template <typename T>
+static void PushCommand(std::atomic<T*>& stack, T* pCommand)
 {
-	std::unique_lock lock(s_commandMutex);
+	pCommand->pNext = stack.load(std::memory_order_relaxed);
+	while (!stack.compare_exchange_weak(pCommand->pNext, pCommand, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+// Takes everything pushed so far, in the order it was pushed.
+template <typename T>
+static T* TakeCommands(std::atomic<T*>& stack)
+{
+	T* pCommand = stack.exchange(nullptr, std::memory_order_acquire);
+
+	T* pOrdered = nullptr;
+	while (pCommand)
+	{
+		T* pNext = pCommand->pNext;
+		pCommand->pNext = pOrdered;
+		pOrdered = pCommand;
+		pCommand = pNext;
+	}
+
+	return pOrdered;
+}
+
+// Resolves a command name the way the sorted command list always has: an exact match if there is
+// one, otherwise the first command that the name is an abbreviation of.
+static MQCommand* FindCommand(const char* szName)
+{
+	auto iter = s_commandsByName.find(std::string_view(szName));
+	if (iter != s_commandsByName.end()
+		&& (!iter->second->InGameOnly || gGameState == GAMESTATE_INGAME))
+	{
+		return iter->second;
+	}
+
+	const size_t length = strlen(szName);
+
+	MQCommand* pCommand = s_pCommands;
+	while (pCommand)
+	{
+		if (pCommand->InGameOnly && gGameState != GAMESTATE_INGAME)
+		{
+			pCommand = pCommand->pNext;
+			continue;
+		}
+
+		int Pos = _strnicmp(szName, pCommand->Command, length);
+		if (Pos < 0)
+		{
+			// command not found
+			break;
+		}
+
+		if (Pos == 0)
+			return pCommand;
+
+		pCommand = pCommand->pNext;
+	}
+
+	return nullptr;
+}
+
+// Replaces szName at the start of szLine with its alias, in place. Returns false if szName is not
+// an alias, or if the expanded line would not fit, in which case the line is left as it is.
+template <size_t Size>
+static bool ExpandAlias(char (&szLine)[Size], const char* szName)
+{
+	auto iter = mAliases.find(std::string_view(szName));
+	if (iter == mAliases.end())
+		return false;
+
+	const std::string& expansion = iter->second;
+	const size_t nameLength = strlen(szName);
+	const size_t lineLength = strlen(szLine);
+
+	if (expansion.length() + lineLength - nameLength >= Size)
+		return false;
+
+	memmove(szLine + expansion.length(), szLine + nameLength, lineLength - nameLength + 1);
+	memcpy(szLine, expansion.data(), expansion.length());
+	return true;
+}
+
+// Replaces each %name in the line with its substitution, reading the line once from left to right.
+// %m, %o, %p, %r, %s and %t are left for EverQuest to expand.
+template <size_t Size>
+static void ApplySubstitutions(char (&szLine)[Size])
+{
+	if (s_substitutions.empty() || !strchr(szLine, '%'))
+		return;
+
+	const size_t length = strlen(szLine);
+
+	std::string result;
+	result.reserve(length);
+
+	size_t i = 0;
+	while (i < length)
+	{
+		if (szLine[i] != '%' || i + 2 >= length)
+		{
+			result += szLine[i++];
+			continue;
+		}
+
+		size_t nameLength = 0;
+		if (!isalnum(static_cast<unsigned char>(szLine[i + 2])))
+		{
+			if (strchr("mMoOpPrRsStT", szLine[i + 1]))
+			{
+				result += szLine[i++];
+				continue;
+			}
+
+			nameLength = 1;
+		}
+		else
+		{
+			while (i + 1 + nameLength < length && isalnum(static_cast<unsigned char>(szLine[i + 1 + nameLength])))
+				++nameLength;
+		}
+
+		auto iter = nameLength ? s_substitutions.find(std::string_view(szLine + i + 1, nameLength)) : s_substitutions.end();
+		if (iter != s_substitutions.end())
+		{
+			result += iter->second;
+			i += nameLength + 1;
+		}
+		else
+		{
+			result += szLine[i++];
+		}
+	}
+
+	strncpy_s(szLine, result.c_str(), _TRUNCATE);
+}
 
+void HideDoCommand(SPAWNINFO* pChar, const char* szLine, bool delayed)
+{
 	if (delayed)
 	{
-		s_delayedCommands.emplace_back(szLine);
+		PushCommand(s_delayedCommands, new MQDelayedCommand{ szLine });
 		return;
 	}
 
+	std::unique_lock lock(s_commandMutex);
+
 	char szTheCmd[MAX_STRING] = { 0 };
 	strcpy_s(szTheCmd, szLine);
 
@@ -82,15 +247,9 @@ void HideDoCommand(SPAWNINFO* pChar, const char* szLine, bool delayed)
 	char szArg1[MAX_STRING] = { 0 };
 	GetArg(szArg1, szTheCmd, 1);
 
-	std::string sName = szArg1;
-	MakeLower(sName);
+	if (ExpandAlias(szTheCmd, szArg1))
+		GetArg(szArg1, szTheCmd, 1);
 
-	if (mAliases.find(sName) != mAliases.end())
-	{
-		sprintf_s(szTheCmd, "%s%s", mAliases[sName].c_str(), szOriginalLine + sName.size());
-	}
-
-	GetArg(szArg1, szTheCmd, 1);
 	if (szArg1[0] == 0)
 		return;
 
@@ -161,41 +320,22 @@ void HideDoCommand(SPAWNINFO* pChar, const char* szLine, bool delayed)
 		return;
 	}
 
-	MQCommand* pCommand = s_pCommands;
-	while (pCommand)
+	if (MQCommand* pCommand = FindCommand(szArg1))
 	{
-		if (pCommand->InGameOnly && gGameState != GAMESTATE_INGAME)
-		{
-			pCommand = pCommand->pNext;
-			continue;
-		}
+		lock.unlock();
 
-		int Pos = _strnicmp(szArg1, pCommand->Command, strlen(szArg1));
-		if (Pos < 0)
+		// the parser version is 2 or It's not version 2 and we're allowing command parses
+		if (pCommand->Parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
 		{
-			// command not found
-			break;
+			pCommand->Function(pChar, ParseMacroParameter(szParam));
 		}
-
-		if (Pos == 0)
+		else
 		{
-			lock.unlock();
-
-			// the parser version is 2 or It's not version 2 and we're allowing command parses
-			if (pCommand->Parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
-			{
-				pCommand->Function(pChar, ParseMacroParameter(szParam));
-			}
-			else
-			{
-				pCommand->Function(pChar, szParam);
-			}
-
-			strcpy_s(szLastCommand, szOriginalLine);
-			return;
+			pCommand->Function(pChar, szParam);
 		}
 
-		pCommand = pCommand->pNext;
+		strcpy_s(szLastCommand, szOriginalLine);
+		return;
 	}
 
 	MQBindList* pBind = pBindList;
@@ -265,6 +405,162 @@ void HideDoCommand(SPAWNINFO* pChar, const char* szLine, bool delayed)
 	}
 }
 
+// Resolves a macro line the same way HideDoCommand would, so that it can be dispatched without
+// repeating the alias and command lookups. Anything that depends on the state of the macro at the
+// time it runs (end of blocks, binds, EQ commands) is left to HideDoCommand.
+static void CompileMacroCommand(const std::string& strLine, MQCompiledCommand& compiled)
+{
+	compiled = MQCompiledCommand();
+	compiled.CommandKind = MQCompiledCommand::Kind::Fallback;
+	compiled.Generation = s_commandGeneration;
+	compiled.GameState = static_cast<int>(gGameState);
+
+	if (strLine.length() >= MAX_STRING)
+		return;
+
+	char szTheCmd[MAX_STRING] = { 0 };
+	strcpy_s(szTheCmd, strLine.c_str());
+
+	char szArg1[MAX_STRING] = { 0 };
+	GetArg(szArg1, szTheCmd, 1);
+
+	if (ExpandAlias(szTheCmd, szArg1))
+		GetArg(szArg1, szTheCmd, 1);
+
+	if (szArg1[0] == 0)
+		return;
+
+	if ((szArg1[0] == ':') || (szArg1[0] == '{'))
+	{
+		compiled.CommandKind = MQCompiledCommand::Kind::Skip;
+		return;
+	}
+
+	if (szArg1[0] == '}' || szArg1[0] == ';' || szArg1[0] == '[')
+		return;
+
+	if (MQCommand* pCommand = FindCommand(szArg1))
+	{
+		compiled.CommandKind = MQCompiledCommand::Kind::Command;
+		compiled.Command = pCommand;
+		compiled.Parameters = GetNextArg(szTheCmd);
+
+		if (pCommand->Parse && compiled.Parameters.find("${") != std::string::npos)
+		{
+			compiled.CompiledParameters = CompileMacroString(compiled.Parameters);
+
+			// The condition of an /if or /while is compiled on its own so that it can be calculated
+			// without being expanded into text first.
+			if (ci_equals(szArg1, "/if") || ci_equals(szArg1, "/while"))
+			{
+				const std::string_view parameters = compiled.Parameters;
+				const size_t conditionEnd = FindMacroConditionEnd(parameters);
+
+				if (conditionEnd != std::string::npos)
+				{
+					compiled.CompiledCondition = CompileMacroString(parameters.substr(0, conditionEnd));
+					compiled.CompiledConditionRest = CompileMacroString(parameters.substr(conditionEnd));
+				}
+			}
+		}
+	}
+}
+
+void CompileMacroLine(MQMacroLine& line)
+{
+	std::scoped_lock lock(s_commandMutex);
+
+	CompileMacroCommand(line.Command, line.Compiled);
+}
+
+void DoMacroLine(SPAWNINFO* pChar, MQMacroLine& line)
+{
+	std::unique_lock lock(s_commandMutex);
+
+	MQCompiledCommand& compiled = line.Compiled;
+	if (compiled.Generation != s_commandGeneration || compiled.GameState != static_cast<int>(gGameState))
+	{
+		CompileMacroCommand(line.Command, compiled);
+	}
+
+	switch (compiled.CommandKind)
+	{
+	case MQCompiledCommand::Kind::Skip:
+		WeDidStuff();
+		bRunNextCommand = true;
+		return;
+
+	case MQCompiledCommand::Kind::Command:
+		break;
+
+	default:
+		lock.unlock();
+		HideDoCommand(pChar, line.Command.c_str(), FromPlugin);
+		return;
+	}
+
+	WeDidStuff();
+
+	// The command may end the macro and destroy the line, so keep what we need beyond that point.
+	char szOriginalLine[MAX_STRING] = { 0 };
+	strcpy_s(szOriginalLine, line.Command.c_str());
+
+	char szParam[MAX_STRING] = { 0 };
+	strcpy_s(szParam, compiled.Parameters.c_str());
+
+	MQCommand* pCommand = compiled.Command;
+	std::shared_ptr<const MQCompiledMacroString> pCompiledParameters = compiled.CompiledParameters;
+	std::shared_ptr<const MQCompiledMacroString> pCompiledCondition = compiled.CompiledCondition;
+	std::shared_ptr<const MQCompiledMacroString> pCompiledConditionRest = compiled.CompiledConditionRest;
+
+	lock.unlock();
+
+	// the parser version is 2 or It's not version 2 and we're allowing command parses
+	if (pCommand->Parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
+	{
+		if (pCompiledCondition && gParserVersion == 2)
+		{
+			double Result = 0;
+			std::string strParam;
+
+			const int rc = EvaluateCompiledCondition(*pCompiledCondition, Result, strParam);
+			if (rc == 0)
+			{
+				FatalError("Failed to parse %s condition '%s', non-numeric encountered", pCommand->Command, strParam.c_str());
+				strcpy_s(szLastCommand, szOriginalLine);
+				return;
+			}
+
+			// The command still calculates its condition, which is trivial once it is reduced to a value.
+			if (rc == 1)
+				strParam = Result != 0 ? "(1)" : "(0)";
+
+			strParam.append(EvaluateCompiledMacroString(*pCompiledConditionRest));
+
+			if (strParam.length() >= MAX_STRING)
+			{
+				MacroError("Data Truncated in %s, Line: %d.  Expanded Length was greater than %d",
+					line.SourceFile.c_str(), line.LineNumber, MAX_STRING);
+				strParam.resize(MAX_STRING - 1);
+			}
+
+			strcpy_s(szParam, strParam.c_str());
+		}
+		else if (pCompiledParameters && gParserVersion == 2)
+		{
+			ParseCompiledMacroData(*pCompiledParameters, szParam, MAX_STRING);
+		}
+		else
+		{
+			ParseMacroParameter(szParam);
+		}
+	}
+
+	pCommand->Function(pChar, szParam);
+
+	strcpy_s(szLastCommand, szOriginalLine);
+}
+
 void DoCommandf(const char* szFormat, ...)
 {
 	va_list vaList;
@@ -290,13 +586,6 @@ public:
 		char szFullCommand[MAX_STRING] = { 0 };
 		char szCommand[MAX_STRING] = { 0 };
 		char szArgs[MAX_STRING] = { 0 };
-		char szOrig[MAX_STRING] = { 0 };
-		char szSub[MAX_STRING] = { 0 };
-
-		std::string szSubFullCommand = "";
-		unsigned int k = 0;
-		bool OneCharacterSub = false;
-		MQSubstitution* pSubLoop = s_pSubstitutions;
 
 		if (szFullLine[0] != 0)
 		{
@@ -311,123 +600,33 @@ public:
 				}
 			}
 
-			szSubFullCommand = szFullCommand;
-			size_t len = strnlen_s(szFullCommand, MAX_STRING);
-			for (unsigned int i = 0; i < sizeof(szFullCommand); i++)
-			{
-				if (szFullCommand[i] == '%' && ((i + 2) < len))
-				{
-					if (szFullCommand[i + 2] == ' ' || szFullCommand[i + 2] == '\0' ||
-						!isalnum(szFullCommand[i + 2]))
-					{
-						if (szFullCommand[i + 1] == 'm' || szFullCommand[i + 1] == 'M' ||
-							szFullCommand[i + 1] == 'o' || szFullCommand[i + 1] == 'O' ||
-							szFullCommand[i + 1] == 'p' || szFullCommand[i + 1] == 'P' ||
-							szFullCommand[i + 1] == 'r' || szFullCommand[i + 1] == 'R' ||
-							szFullCommand[i + 1] == 's' || szFullCommand[i + 1] == 'S' ||
-							szFullCommand[i + 1] == 't' || szFullCommand[i + 1] == 'T')
-						{
-							continue;
-						}
-						else
-						{
-							szOrig[0] = szFullCommand[i + 1];
-							szOrig[1] = '\0';
-							k = 1;
-							OneCharacterSub = true;
-						}
-					}
-
-					if (!OneCharacterSub)
-					{
-						for (unsigned int j = i + 1; j < sizeof(szFullCommand); j++)
-						{
-							if (szFullCommand[j] == ' ' || szFullCommand[j] == '\0')
-								break;
-							if (!isalnum(szFullCommand[j]))
-								break;
-
-							szOrig[k] = szFullCommand[j];
-							k++;
-						}
-					}
-
-					while (pSubLoop)
-					{
-						if (!_stricmp(szOrig, pSubLoop->szOrig))
-						{
-							sprintf_s(szSub, "%s", pSubLoop->szSub);
-							break;
-						}
-						pSubLoop = pSubLoop->pNext;
-					}
-
-					if (szSub[0] != 0)
-					{
-						szSubFullCommand.replace(i, k + 1, szSub);
-						sprintf_s(szFullCommand, "%s", szSubFullCommand.c_str());
-					}
-
-					szOrig[0] = 0;
-					szSub[0] = 0;
-					k = 0;
-					OneCharacterSub = false;
-					pSubLoop = s_pSubstitutions;
-				}
-			}
-
-			sprintf_s(szFullCommand, "%s", szSubFullCommand.c_str());
-			std::string sName = szCommand;
-			MakeLower(sName);
-
-			if (mAliases.find(sName) != mAliases.end())
-			{
-				sprintf_s(szCommand, "%s%s", mAliases[sName].c_str(), szFullCommand + sName.size());
-				strcpy_s(szFullCommand, szCommand);
-			}
+			ApplySubstitutions(szFullCommand);
+			ExpandAlias(szFullCommand, szCommand);
 
 			GetArg(szCommand, szFullCommand, 1);
 			strcpy_s(szArgs, GetNextArg(szFullCommand));
 
-			MQCommand* pCommand = s_pCommands;
-			while (pCommand)
+			if (MQCommand* pCommand = FindCommand(szCommand))
 			{
-				if (pCommand->InGameOnly && gGameState != GAMESTATE_INGAME)
+				// the parser version is 2 or It's not version 2 and we're allowing command parses
+				if (pCommand->Parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
 				{
-					pCommand = pCommand->pNext;
-					continue;
+					ParseMacroParameter(szArgs);
 				}
 
-				int Pos = _strnicmp(szCommand, pCommand->Command, strlen(szCommand));
-				if (Pos < 0)
+				if (pCommand->EQ)
 				{
-					// command not found
-					break;
+					strcat_s(szCommand, " ");
+					strcat_s(szCommand, szArgs);
+					Trampoline(pChar, szCommand);
 				}
-
-				if (Pos == 0)
+				else
 				{
-					// the parser version is 2 or It's not version 2 and we're allowing command parses
-					if (pCommand->Parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
-					{
-						ParseMacroParameter(szArgs);
-					}
-
-					if (pCommand->EQ)
-					{
-						strcat_s(szCommand, " ");
-						strcat_s(szCommand, szArgs);
-						Trampoline(pChar, szCommand);
-					}
-					else
-					{
-						pCommand->Function(pChar, szArgs);
-					}
-
-					strcpy_s(szLastCommand, szFullCommand);
-					return;
+					pCommand->Function(pChar, szArgs);
 				}
-				pCommand = pCommand->pNext;
+
+				strcpy_s(szLastCommand, szFullCommand);
+				return;
 			}
 
 			MQBindList* pBind = pBindList;
@@ -503,6 +702,12 @@ void AddCommand(const char* Command, std::function<void(PlayerClient*, const cha
 	pCommand->Function = std::move(Function);
 	pCommand->InGameOnly = InGame;
 
+	++s_commandGeneration;
+
+	// The key views the command's own name, so replace the entry rather than just its value.
+	s_commandsByName.erase(std::string_view(pCommand->Command));
+	s_commandsByName.emplace(pCommand->Command, pCommand);
+
 	// perform insertion sort
 	if (!s_pCommands)
 	{
@@ -557,6 +762,16 @@ bool RemoveCommand(const char* Command)
 
 		if (Pos == 0)
 		{
+			auto iter = s_commandsByName.find(std::string_view(pCommand->Command));
+			if (iter != s_commandsByName.end() && iter->second == pCommand)
+			{
+				s_commandsByName.erase(iter);
+
+				// an older command of the same name takes its place
+				if (pCommand->pNext && !_stricmp(pCommand->pNext->Command, pCommand->Command))
+					s_commandsByName.emplace(pCommand->pNext->Command, pCommand->pNext);
+			}
+
 			if (pCommand->pNext)
 				pCommand->pNext->pLast = pCommand->pLast;
 			if (pCommand->pLast)
@@ -565,6 +780,8 @@ bool RemoveCommand(const char* Command)
 				s_pCommands = pCommand->pNext;
 			delete pCommand;
 
+			++s_commandGeneration;
+
 			return true;
 		}
 
@@ -576,16 +793,7 @@ bool RemoveCommand(const char* Command)
 
 bool IsCommand(const char* command)
 {
-	MQCommand* pCommand = s_pCommands;
-	while (pCommand)
-	{
-		if (_stricmp(command, pCommand->Command) == 0)
-			return true;
-
-		pCommand = pCommand->pNext;
-	}
-
-	return false;
+	return s_commandsByName.count(std::string_view(command)) != 0;
 }
 
 //============================================================================
@@ -597,6 +805,7 @@ void AddAlias(const char* ShortCommand, const char* LongCommand)
 
 	DebugSpew("AddAlias(%s,%s)", sName.c_str(), LongCommand);
 	mAliases[sName] = LongCommand;
+	++s_commandGeneration;
 }
 
 bool RemoveAlias(const char* ShortCommand)
@@ -610,6 +819,7 @@ bool RemoveAlias(const char* ShortCommand)
 	if (iter != mAliases.end())
 	{
 		mAliases.erase(iter);
+		++s_commandGeneration;
 		return true;
 	}
 
@@ -618,27 +828,24 @@ bool RemoveAlias(const char* ShortCommand)
 
 bool IsAlias(const char* alias)
 {
-	std::string sName = alias;
-	MakeLower(sName);
-
-	return mAliases.find(sName) != mAliases.end();
+	return mAliases.find(std::string_view(alias)) != mAliases.end();
 }
 
 // this function is SUPER expensive, DO NOT use it unless you absolutely have to.
 void RewriteAliases()
 {
-	WritePrivateProfileSection("Aliases", "", mq::internal_paths::MQini);
+	WriteCachedPrivateProfileString("Aliases", nullptr, nullptr, mq::internal_paths::MQini);
 
 	for (const auto& [key, value] : mAliases)
 	{
-		WritePrivateProfileString("Aliases", key, value, mq::internal_paths::MQini);
+		WriteCachedPrivateProfileString("Aliases", key.c_str(), value.c_str(), mq::internal_paths::MQini);
 	}
 }
 
 // better single write them instead...
 void WriteAliasToIni(const char* Name, const char* Command)
 {
-	WritePrivateProfileString("Aliases", Name, Command, mq::internal_paths::MQini);
+	WriteCachedPrivateProfileString("Aliases", Name, Command, mq::internal_paths::MQini);
 }
 
 void LoadAliases()
@@ -682,91 +889,28 @@ void AddSubstitute(const char* Original, const char* Substitution)
 {
 	DebugSpew("AddSubstitute(%s,%s)", Original, Substitution);
 
-	// perform insertion sort
-	if (!s_pSubstitutions)
-	{
-		MQSubstitution* pSub = new MQSubstitution;
-		memset(pSub, 0, sizeof(MQSubstitution));
-		strcpy_s(pSub->szOrig, Original);
-		strcpy_s(pSub->szSub, Substitution);
-		s_pSubstitutions = pSub;
-		return;
-	}
-
-	MQSubstitution* pInsert = s_pSubstitutions;
-	MQSubstitution* pLast = nullptr;
-
-	while (pInsert)
-	{
-		int Pos = _stricmp(Original, pInsert->szOrig);
-		if (Pos < 0)
-		{
-			// insert here.
-			MQSubstitution* pSub = new MQSubstitution;
-			memset(pSub, 0, sizeof(MQSubstitution));
-			strcpy_s(pSub->szOrig, Original);
-			strcpy_s(pSub->szSub, Substitution);
-			if (pLast)
-				pLast->pNext = pSub;
-			else
-				s_pSubstitutions = pSub;
-			pSub->pLast = pLast;
-			pInsert->pLast = pSub;
-			pSub->pNext = pInsert;
-			return;
-		}
-
-		if (Pos == 0)
-		{
-			strcpy_s(pInsert->szOrig, Original);
-			strcpy_s(pInsert->szSub, Substitution);
-			return;
-		}
-
-		pLast = pInsert;
-		pInsert = pInsert->pNext;
-	}
-
-	// End of list
-	MQSubstitution* pSub = new MQSubstitution;
-	memset(pSub, 0, sizeof(MQSubstitution));
-	strcpy_s(pSub->szOrig, Original);
-	strcpy_s(pSub->szSub, Substitution);
-	pLast->pNext = pSub;
-	pSub->pLast = pLast;
+	// replacing an existing substitution also takes the new spelling of its name
+	s_substitutions.erase(std::string_view(Original));
+	s_substitutions.emplace(Original, Substitution);
 }
 
 bool RemoveSubstitute(const char* Original)
 {
-	MQSubstitution* pSub = s_pSubstitutions;
-	while (pSub)
-	{
-		if (!_stricmp(Original, pSub->szOrig))
-		{
-			if (pSub->pNext)
-				pSub->pNext->pLast = pSub->pLast;
-			if (pSub->pLast)
-				pSub->pLast->pNext = pSub->pNext;
-			else
-				s_pSubstitutions = pSub->pNext;
-			delete pSub;
-			return true;
-		}
-		pSub = pSub->pNext;
-	}
+	auto iter = s_substitutions.find(std::string_view(Original));
+	if (iter == s_substitutions.end())
+		return false;
 
-	return false;
+	s_substitutions.erase(iter);
+	return true;
 }
 
 void RewriteSubstitutions()
 {
-	MQSubstitution* pSubLoop = s_pSubstitutions;
-	WritePrivateProfileSection("Substitutions", "", mq::internal_paths::MQini);
+	WriteCachedPrivateProfileString("Substitutions", nullptr, nullptr, mq::internal_paths::MQini);
 
-	while (pSubLoop)
+	for (const auto& [key, value] : s_substitutions)
 	{
-		WritePrivateProfileString("Substitutions", pSubLoop->szOrig, pSubLoop->szSub, mq::internal_paths::MQini);
-		pSubLoop = pSubLoop->pNext;
+		WriteCachedPrivateProfileString("Substitutions", key.c_str(), value.c_str(), mq::internal_paths::MQini);
 	}
 }
 
@@ -1040,96 +1184,93 @@ void ShutdownMQ2Commands()
 		delete s_pCommands;
 		s_pCommands = pNext;
 	}
+	s_commandsByName.clear();
 
-	s_delayedCommands.clear();
+	MQDelayedCommand* pDelayed = TakeCommands(s_delayedCommands);
+	while (pDelayed)
+	{
+		MQDelayedCommand* pNext = pDelayed->pNext;
+		delete pDelayed;
+		pDelayed = pNext;
+	}
 
-	while (s_pTimedCommands)
+	MQTimedCommand* pPending = TakeCommands(s_pendingTimedCommands);
+	while (pPending)
 	{
-		MQTimedCommand* pNext = s_pTimedCommands->pNext;
-		delete s_pTimedCommands;
-		s_pTimedCommands = pNext;
+		MQTimedCommand* pNext = pPending->pNext;
+		delete pPending;
+		pPending = pNext;
 	}
 
+	for (MQTimedCommand* pTimed : s_timedCommands)
+		delete pTimed;
+	s_timedCommands.clear();
+
 	mAliases.clear();
-	while (s_pSubstitutions)
+	s_substitutions.clear();
+}
+
+static void AddPendingTimedCommands()
+{
+	MQTimedCommand* pPending = TakeCommands(s_pendingTimedCommands);
+	while (pPending)
 	{
-		MQSubstitution* pNext = s_pSubstitutions->pNext;
-		delete s_pSubstitutions;
-		s_pSubstitutions = pNext;
+		MQTimedCommand* pNext = pPending->pNext;
+		pPending->pNext = nullptr;
+
+		s_timedCommands.push_back(pPending);
+		std::push_heap(s_timedCommands.begin(), s_timedCommands.end(), MQTimedCommandCompare());
+
+		pPending = pNext;
 	}
 }
 
 void PulseCommands()
 {
-	if (s_delayedCommands.empty() && !s_pTimedCommands)
+	if (!s_delayedCommands.load(std::memory_order_relaxed)
+		&& !s_pendingTimedCommands.load(std::memory_order_relaxed)
+		&& s_timedCommands.empty())
 	{
 		return;
 	}
 
-	std::scoped_lock lock(s_commandMutex);
-
+	// Take the delayed commands that are here now. Running DoCommand may add more, those wait
+	// for the next pulse.
+	MQDelayedCommand* pDelayed = TakeCommands(s_delayedCommands);
+	while (pDelayed)
 	{
-		// Swap with empty container to get our delayed commands. Running DoCommand
-		// may add something to the container. We don't want to process that, so we
-		// work with it from a temporary instead.
-		decltype(s_delayedCommands) delayedCommands;
-		std::swap(delayedCommands, s_delayedCommands);
-
-		// handle delayed commands
-		for (const std::string& delayedCommand : delayedCommands)
-		{
-			DoCommand(pLocalPlayer, delayedCommand.c_str());
-		}
+		MQDelayedCommand* pNext = pDelayed->pNext;
+		DoCommand(pLocalPlayer, pDelayed->Command.c_str());
+
+		delete pDelayed;
+		pDelayed = pNext;
 	}
 
-	// handle timed commands
+	// handle timed commands, including any that are queued while running them and are already due
 	uint64_t Now = MQGetTickCount64();
 
-	while (s_pTimedCommands && s_pTimedCommands->Time <= Now)
+	AddPendingTimedCommands();
+	while (!s_timedCommands.empty() && s_timedCommands.front()->Time <= Now)
 	{
-		MQTimedCommand* pNext = s_pTimedCommands->pNext;
-		DoCommand(pLocalPlayer, s_pTimedCommands->Command);
+		std::pop_heap(s_timedCommands.begin(), s_timedCommands.end(), MQTimedCommandCompare());
+		std::unique_ptr<MQTimedCommand> pTimed{ s_timedCommands.back() };
+		s_timedCommands.pop_back();
 
-		delete s_pTimedCommands;
-		s_pTimedCommands = pNext;
+		DoCommand(pLocalPlayer, pTimed->Command.c_str());
+
+		AddPendingTimedCommands();
 	}
 }
 
 void TimedCommand(const char* Command, int msDelay)
 {
-	std::scoped_lock lock(s_commandMutex);
-
 	MQTimedCommand* pNew = new MQTimedCommand;
 
 	pNew->Time = msDelay + MQGetTickCount64();
-	strcpy_s(pNew->Command, Command);
-
-	// insert into list
-	if (!s_pTimedCommands || s_pTimedCommands->Time >= pNew->Time)
-	{
-		pNew->pNext = s_pTimedCommands;
-		pNew->pLast = nullptr;
-		s_pTimedCommands = pNew;
-		return;
-	}
-
-	MQTimedCommand* pLast = s_pTimedCommands;
-	MQTimedCommand* pNode = s_pTimedCommands->pNext;
-
-	while (pNode)
-	{
-		if (pNew->Time <= pNode->Time)
-		{
-			break;
-		}
-
-		pLast = pNode;
-		pNode = pNode->pNext;
-	}
+	pNew->Sequence = ++s_timedCommandSequence;
+	pNew->Command = Command;
 
-	pLast->pNext = pNew;
-	pNew->pLast = pLast;
-	pNew->pNext = pNode;
+	PushCommand(s_pendingTimedCommands, pNew);
 }
 
 //============================================================================
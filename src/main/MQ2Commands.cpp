@@ -1381,6 +1381,7 @@ void Filter(SPAWNINFO* pChar, char* szLine)
 						}
 					}
 
+					InvalidateChatFilters();
 					WriteChatColor("Cleared all name filters.");
 					WriteFilterNames();
 					return;
@@ -1403,6 +1404,7 @@ void Filter(SPAWNINFO* pChar, char* szLine)
 						}
 
 						delete pFilter;
+						InvalidateChatFilters();
 
 						WriteChatf("Stopped filtering on: %s", szRest);
 						WriteFilterNames();
@@ -1793,6 +1795,8 @@ bool CMQ2Alerts::RemoveAlertFromList(uint32_t Id, MQSpawnSearch* pSearchSpawn)
 			if (SearchSpawnMatchesSearchSpawn(pSearch, pSearchSpawn))
 			{
 				alertMap.erase(iter);
+				++m_version;
+				InvalidateSpawnSearchCache();
 				return true;
 			}
 		}
@@ -1820,6 +1824,8 @@ bool CMQ2Alerts::AddNewAlertList(uint32_t Id, MQSpawnSearch* pSearchSpawn)
 	}
 
 	m_alertMap[Id].push_back(*pSearchSpawn);
+	++m_version;
+	InvalidateSpawnSearchCache();
 	return true;
 }
 
@@ -1833,6 +1839,8 @@ void CMQ2Alerts::FreeAlerts(uint32_t id)
 	if (alertIter != m_alertMap.end())
 	{
 		m_alertMap.erase(alertIter);
+		++m_version;
+		InvalidateSpawnSearchCache();
 		WriteChatf("Alert list %d cleared.", id);
 	}
 	else
@@ -2164,26 +2172,8 @@ void MacroLog(SPAWNINFO* pChar, char* szLine)
 
 	if (!_stricmp(szLine, "clear"))
 	{
-		FILE* fOut = _fsopen(logFilePath.string().c_str(), "wt", _SH_DENYWR);
-		if (!fOut)
-		{
-			MacroError("Couldn't open log file: %s", logFilePath.string().c_str());
-			return;
-		}
-
+		ClearLogFile(logFilePath);
 		WriteChatColor("Cleared log.", USERCOLOR_DEFAULT);
-		fclose(fOut);
-		return;
-	}
-
-	// Don't need to check errors since the log file write itself will error, but we don't want to throw
-	std::error_code ec;
-	create_directories(logFilePath.parent_path(), ec);
-
-	FILE* fOut = _fsopen(logFilePath.string().c_str(), "at", _SH_DENYWR);
-	if (!fOut)
-	{
-		MacroError("Couldn't open log file: %s", logFilePath.string().c_str());
 		return;
 	}
 
@@ -2193,10 +2183,8 @@ void MacroLog(SPAWNINFO* pChar, char* szLine)
 		fmt::arg("DateTime", now),
 		fmt::arg("LogMessage", szLine));
 
-	fprintf(fOut, "%s\n", strLogMessage.c_str());
+	AppendToLogFile(logFilePath, strLogMessage + "\n");
 	DebugSpew("MacroLog - %s", strLogMessage.c_str());
-
-	fclose(fOut);
 }
 
 static void FaceObject(const MQGameObject& faceTarget, int flags)
@@ -2883,10 +2871,7 @@ void Cast(SPAWNINFO* pChar, char* szLine)
 	if (!cmdCast)
 		return;
 
-	char szArg1[MAX_STRING] = { 0 };
-	GetArg(szArg1, szLine, 1);
-	char szArg2[MAX_STRING] = { 0 };
-	GetArg(szArg2, szLine, 2);
+	CommandArgs args(szLine);
 
 	if (szLine[0] == 0 || GetIntFromString(szLine, 0))
 	{
@@ -2899,20 +2884,14 @@ void Cast(SPAWNINFO* pChar, char* szLine)
 				if (pSpell->TargetType == TT_SPLASH)
 				{
 					// is it a splashspell?
-					if (!_stricmp(szArg2, "loc"))
+					if (ci_equals(args[1], "loc"))
 					{
 						CVector3 castLoc;
 
 						// they want to cast it at a specific location
-						char loc[32] = { 0 };
-						GetArg(loc, szLine, 3);
-						castLoc.X = GetFloatFromString(loc, 0);
-
-						GetArg(loc, szLine, 4);
-						castLoc.Y = GetFloatFromString(loc, 0);
-
-						GetArg(loc, szLine, 5);
-						castLoc.Z = GetFloatFromString(loc, 0);
+						castLoc.X = GetFloatFromString(args[2], 0);
+						castLoc.Y = GetFloatFromString(args[3], 0);
+						castLoc.Z = GetFloatFromString(args[4], 0);
 
 						CastSplash(Index, pSpell, &castLoc);
 					}
@@ -2953,10 +2932,12 @@ void Cast(SPAWNINFO* pChar, char* szLine)
 		return;
 	}
 
-	if (!_stricmp(szArg1, "item"))
+	if (ci_equals(args[0], "item"))
 	{
+		std::string itemName(args[1]);
+
 		// Find the item
-		if (ItemClient* pItem = FindItemByName(szArg2, true))
+		if (ItemClient* pItem = FindItemByName(itemName.c_str(), true))
 		{
 			int spellId = pItem->GetItemDefinition()->Clicky.SpellID;
 
@@ -2969,37 +2950,28 @@ void Cast(SPAWNINFO* pChar, char* szLine)
 		}
 		else
 		{
-			WriteChatf("Item '%s' not found.", szArg2);
+			WriteChatf("Item '%s' not found.", itemName.c_str());
 		}
 
 		return;
 	}
 
-	// Check this, but i think it isn't necessary.
-	GetArg(szArg1, szLine, 1);
-
 	for (int Index = 0; Index < NUM_SPELL_GEMS; Index++)
 	{
 		EQ_Spell* pSpell = GetSpellByID(GetMemorizedSpell(Index));
-		if (pSpell && ci_starts_with(pSpell->Name, szArg1))
+		if (pSpell && ci_starts_with(pSpell->Name, args[0]))
 		{
 			if (pSpell->TargetType == TT_SPLASH)
 			{
 				// is it a splashspell?
-				if (!_stricmp(szArg2, "loc"))
+				if (ci_equals(args[1], "loc"))
 				{
 					CVector3 castLoc;
 
 					// they want to cast it at a specific location
-					char loc[32] = { 0 };
-					GetArg(loc, szLine, 3);
-					castLoc.X = GetFloatFromString(loc, 0);
-
-					GetArg(loc, szLine, 4);
-					castLoc.Y = GetFloatFromString(loc, 0);
-
-					GetArg(loc, szLine, 5);
-					castLoc.Z = GetFloatFromString(loc, 0);
+					castLoc.X = GetFloatFromString(args[2], 0);
+					castLoc.Y = GetFloatFromString(args[3], 0);
+					castLoc.Z = GetFloatFromString(args[4], 0);
 
 					CastSplash(Index, pSpell, &castLoc);
 				}
@@ -3011,8 +2983,9 @@ void Cast(SPAWNINFO* pChar, char* szLine)
 			else
 			{
 				// nope normal, so just pipe it through
-				_itoa_s(Index + 1, szArg1, 10);
-				cmdCast(pChar, szArg1);
+				char szGem[16] = { 0 };
+				_itoa_s(Index + 1, szGem, 10);
+				cmdCast(pChar, szGem);
 			}
 
 			return;
@@ -3200,7 +3173,7 @@ void SetAutoRun(SPAWNINFO* pChar, char* szLine)
 
 // ***************************************************************************
 // Function:   IniOutput our /ini command
-// Description:   Outputs string data to an INI file using WritePrivateProfileString.
+// Description:   Outputs string data to an INI file through the ini cache.
 // If the inifile doesn't exist one will be created.
 // Usage:
 //
@@ -3231,12 +3204,6 @@ void IniOutput(SPAWNINFO* pChar, char* szLine)
 
 	const std::filesystem::path iniFile = GetMacroIni(internal_paths::Config, internal_paths::Macros, szArg1);
 
-	std::error_code ec;
-
-	// Make sure the directory exists for the ini file.
-	std::filesystem::path iniDirectory = iniFile.parent_path();
-	std::filesystem::create_directories(iniDirectory, ec);
-
 	const char* szKey = nullptr;
 	const char* szValue = nullptr;
 
@@ -3254,15 +3221,10 @@ void IniOutput(SPAWNINFO* pChar, char* szLine)
 		szValue = szArg4;
 	}
 
-	if (!WritePrivateProfileStringA(szArg2, szKey, szValue, iniFile.string().c_str()))
-	{
-		DebugSpew("IniOutput ERROR -- during WritePrivateProfileString: %s", szLine);
-		WriteChatf("Failed to write to INI: %s", iniFile.string().c_str());
-	}
-	else
-	{
-		DebugSpew("IniOutput Write Successful: %s", szLine);
-	}
+	// Writes go through the ini cache so that macros writing in a loop don't hit the disk every time.
+	// The cache creates the directory and writes the file shortly after.
+	WriteCachedPrivateProfileString(szArg2, szKey, szValue, iniFile.string());
+	DebugSpew("IniOutput Write Queued: %s", szLine);
 }
 
 // ***************************************************************************
@@ -4132,8 +4094,9 @@ void HudCmd(SPAWNINFO* pChar, char* szLine)
 {
 	if (!szLine[0])
 	{
-		SyntaxError("Usage: /hud <normal|underui|always>");
+		SyntaxError("Usage: /hud <normal|underui|always|overlay>");
 		WriteChatColor("Note: 'always' forces 'underui' also. The Network Status indicator is not 'always' drawn and is toggled with F11.");
+		WriteChatColor("Note: 'overlay' is 'always', with the text drawn by the overlay all at once instead of by the game.");
 		return;
 	}
 	else if (!_stricmp(szLine, "normal"))
@@ -4141,18 +4104,28 @@ void HudCmd(SPAWNINFO* pChar, char* szLine)
 		WritePrivateProfileString("MacroQuest", "HUDMode", "Normal", mq::internal_paths::MQini);
 		gbAlwaysDrawMQHUD = false;
 		gbHUDUnderUI = false;
+		gbHUDOverlay = false;
 	}
 	else if (!_stricmp(szLine, "underui"))
 	{
 		WritePrivateProfileString("MacroQuest", "HUDMode", "UnderUI", mq::internal_paths::MQini);
 		gbHUDUnderUI = true;
 		gbAlwaysDrawMQHUD = false;
+		gbHUDOverlay = false;
 	}
 	else if (!_stricmp(szLine, "always"))
 	{
 		WritePrivateProfileString("MacroQuest", "HUDMode", "Always", mq::internal_paths::MQini);
 		gbHUDUnderUI = true;
 		gbAlwaysDrawMQHUD = true;
+		gbHUDOverlay = false;
+	}
+	else if (!_stricmp(szLine, "overlay"))
+	{
+		WritePrivateProfileString("MacroQuest", "HUDMode", "Overlay", mq::internal_paths::MQini);
+		gbHUDUnderUI = true;
+		gbAlwaysDrawMQHUD = true;
+		gbHUDOverlay = true;
 	}
 }
 
@@ -4556,6 +4529,7 @@ void MercSwitchCmd(SPAWNINFO* pChar, char* szLine)
 // Usage: /advloot personal #(listid)| loot,leave,an,ag,never
 // Or:    /advloot shared #(listid) item,status,action,manage,autoroll,nd,gd,no,an,ag,nv,name
 // Or:    /advloot shared set "item from the shared set to all combo box, can be player name any of the other items that exist in that box..."
+// Or:    /advloot personal|shared decide #(listid)=action "item name"=action ... to act on many items at once
 // ***************************************************************************
 
 void AdvLootCmd(SPAWNINFO* pChar, char* szLine)
@@ -4576,6 +4550,7 @@ void AdvLootCmd(SPAWNINFO* pChar, char* szLine)
 			WriteChatColor(R"(           you can "Leave on Corpse" /advloot shared <#(listid) or "Item Name"> leave)");
 			WriteChatColor(R"(       /advloot shared set "Option from the 'Set all to:` combo box")");
 			WriteChatColor(R"(           this can be a player name or any of the other names that exist in that combo box")");
+			WriteChatColor(R"(       /advloot <personal or shared> decide <#(listid) or "item name">=<action> [...] to act on many items at once)");
 		}
 		cmdAdvLoot(pChar, szLine);
 		return;
@@ -4604,6 +4579,32 @@ void AdvLootCmd(SPAWNINFO* pChar, char* szLine)
 		char szID[MAX_STRING] = { 0 };
 		GetArg(szID, szLine, 2);
 
+		if (ci_equals(szID, "decide") && (ci_equals(szCmd, "personal") || ci_equals(szCmd, "shared")))
+		{
+			CommandArgs args(szLine);
+
+			std::vector<std::pair<std::string, std::string>> actions;
+			actions.reserve(args.size() - 2);
+
+			for (size_t i = 2; i < args.size(); ++i)
+			{
+				std::string_view decision = args[i];
+
+				size_t equals = decision.rfind('=');
+				if (equals == std::string_view::npos || equals == 0)
+				{
+					MacroError("/advloot %s decide: expected <item>=<action>, not '%.*s'", szCmd,
+						static_cast<int>(decision.size()), decision.data());
+					return;
+				}
+
+				actions.emplace_back(decision.substr(0, equals), decision.substr(equals + 1));
+			}
+
+			DoAdvLootActions(ci_equals(szCmd, "shared"), actions);
+			return;
+		}
+
 		// Built-In EQ Command uses setallto
 		if (!ci_equals(szID, "setallto"))
 		{
@@ -4620,23 +4621,7 @@ void AdvLootCmd(SPAWNINFO* pChar, char* szLine)
 					else
 					{
 						// if its not a number its a itemname
-						// need to roll through the list to get the index
-						if (pAdvancedLootWnd->pPLootList)
-						{
-							for (int k = 0; k < pPersonalList->ItemsArray.Count; k++)
-							{
-								int listindex = (int)pPersonalList->GetItemData(k);
-								if (listindex != -1)
-								{
-									AdvancedLootItem& item = pAdvancedLootWnd->pPLootList->Items[listindex];
-									if (!_stricmp(item.Name, szID))
-									{
-										index = k;
-										break;
-									}
-								}
-							}
-						}
+						index = FindAdvLootRowByName(false, szID);
 					}
 
 					int listindex = (int)pPersonalList->GetItemData(index);
@@ -4748,23 +4733,7 @@ void AdvLootCmd(SPAWNINFO* pChar, char* szLine)
 				else
 				{
 					// if its not a number its a itemname
-					// need to roll through the list to get the index
-					if (pSharedList)
-					{
-						for (int k = 0; k < pSharedList->ItemsArray.Count; k++)
-						{
-							int listindex = (int)pSharedList->GetItemData(k);
-							if (listindex != -1)
-							{
-								AdvancedLootItem& item = pAdvancedLootWnd->pCLootList->Items[listindex];
-								if (!_stricmp(item.Name, szID))
-								{
-									index = k;
-									break;
-								}
-							}
-						}
-					}
+					index = FindAdvLootRowByName(true, szID);
 				}
 
 				if (index != -1)
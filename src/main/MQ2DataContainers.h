@@ -30,10 +30,38 @@ public:
 		: GlobalIndex(GlobalIndex), Slot(Slot) {}
 };
 
+class MQTransient;
+
+// Observed objects are tracked in a handle table in MQDataAPI.cpp so that they can be invalidated by
+// address without scanning. Their memory comes from a pool there as well.
+MQLIB_OBJECT uint64_t AddObservedEQObject(MQTransient* Object, void* Address);
+MQLIB_OBJECT void RemoveObservedEQObject(uint64_t Handle);
+MQLIB_OBJECT void* AllocateObservedEQObject(size_t Size);
+MQLIB_OBJECT void FreeObservedEQObject(void* Ptr, size_t Size);
+
+template <typename T>
+struct MQObservedAllocator
+{
+	using value_type = T;
+
+	MQObservedAllocator() = default;
+	template <typename U>
+	MQObservedAllocator(const MQObservedAllocator<U>&) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(AllocateObservedEQObject(n * sizeof(T))); }
+	void deallocate(T* p, size_t n) { FreeObservedEQObject(p, n * sizeof(T)); }
+
+	template <typename U>
+	bool operator==(const MQObservedAllocator<U>&) const { return true; }
+	template <typename U>
+	bool operator!=(const MQObservedAllocator<U>&) const { return false; }
+};
+
 class MQTransient : public std::enable_shared_from_this<MQTransient>
 {
 protected:
 	bool m_invalidated = false; // let's track if this got invalidated to help troubleshooting things
+	uint64_t m_observedHandle = 0; // slot in the observed object table, 0 if not observed
 
 	template <typename T>
 	std::shared_ptr<T> SharedFromBase()
@@ -47,6 +75,12 @@ public:
 	virtual bool operator==(void*) const = 0;
 
 	MQTransient() = default;
+
+	virtual ~MQTransient()
+	{
+		if (m_observedHandle != 0)
+			RemoveObservedEQObject(m_observedHandle);
+	}
 };
 
 template <typename EQType>
@@ -103,9 +137,12 @@ private:
 				std::string("The underlying object has changed (likely deleted). Type: ") + typeid(EQType).name());
 	}
 
-	MQEQObject(EQType* Object) : m_object(Object), m_ID(EQObjectID(Object)) {}
+	struct ConstructTag {};
 
 public:
+	// Only ObserveEQObject can name the tag, it needs a public constructor for allocate_shared.
+	MQEQObject(ConstructTag, EQType* Object) : m_object(Object), m_ID(EQObjectID(Object)) {}
+
 	void Invalidate() override { m_object = nullptr; m_invalidated = true; }
 
 	operator bool() const override
@@ -150,8 +187,10 @@ using MQEQObjectPtr = std::shared_ptr<MQEQObject<T>>;
 template <typename U>
 MQEQObjectPtr<U> ObserveEQObject(U* Object)
 {
-	auto ptr = MQEQObjectPtr<U>(new MQEQObject<U>(Object), [](MQEQObject<U>* ptr) { delete ptr; });
-	AddObservedEQObject(ptr);
+	// the object and its control block share one allocation from the observed object pool
+	auto ptr = std::allocate_shared<MQEQObject<U>>(MQObservedAllocator<MQEQObject<U>>(),
+		typename MQEQObject<U>::ConstructTag{}, Object);
+	ptr->m_observedHandle = AddObservedEQObject(ptr.get(), Object);
 	return ptr;
 }
 
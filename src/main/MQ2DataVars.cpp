@@ -22,12 +22,76 @@ namespace mq {
 
 static std::recursive_mutex s_dataVarMutex;
 
+// Returns the macro stack frame that owns the given variable list, if it is a list of parameters
+// or local variables.
+static MQMacroStack* FindVariableStack(MQDataVar** ppHead)
+{
+	for (MQMacroStack* pStack = gMacroStack; pStack != nullptr; pStack = pStack->pNext)
+	{
+		if (ppHead == &pStack->Parameters || ppHead == &pStack->LocalVariables)
+			return pStack;
+	}
+
+	return nullptr;
+}
+
+// Parameters take precedence over local variables. Within a list, the most recently added variable
+// (the one closest to the head) wins. Keys always refer to the name of the variable they map to.
+static void IndexStackVariable(MQMacroStack* pStack, MQDataVar* pVar)
+{
+	if (!pStack->VariableIndexValid)
+		return;
+
+	auto [iter, inserted] = pStack->VariableIndex.try_emplace(pVar->Name, pVar);
+	if (!inserted && (pVar->ppHead == &pStack->Parameters || iter->second->ppHead == pVar->ppHead))
+	{
+		pStack->VariableIndex.erase(iter);
+		pStack->VariableIndex.emplace(pVar->Name, pVar);
+	}
+}
+
+static void RebuildStackVariableIndex(MQMacroStack* pStack)
+{
+	pStack->VariableIndex.clear();
+
+	for (MQDataVar* pVar = pStack->Parameters; pVar != nullptr; pVar = pVar->pNext)
+		pStack->VariableIndex.try_emplace(pVar->Name, pVar);
+
+	for (MQDataVar* pVar = pStack->LocalVariables; pVar != nullptr; pVar = pVar->pNext)
+		pStack->VariableIndex.try_emplace(pVar->Name, pVar);
+
+	pStack->VariableIndexValid = true;
+}
+
+static void AddStackVariable(MQDataVar* pVar)
+{
+	if (MQMacroStack* pStack = FindVariableStack(pVar->ppHead))
+		IndexStackVariable(pStack, pVar);
+}
+
+static void RemoveStackVariable(MQDataVar* pVar)
+{
+	MQMacroStack* pStack = FindVariableStack(pVar->ppHead);
+	if (!pStack || !pStack->VariableIndexValid)
+		return;
+
+	auto iter = pStack->VariableIndex.find(pVar->Name);
+	if (iter != pStack->VariableIndex.end() && iter->second == pVar)
+	{
+		// Another variable with the same name may have been hidden by this one.
+		pStack->VariableIndex.clear();
+		pStack->VariableIndexValid = false;
+	}
+}
+
 void DeleteMQ2DataVariable(MQDataVar* pVar)
 {
 	std::scoped_lock lock(s_dataVarMutex);
 
 	if (pVar->ppHead == &pMacroVariables || pVar->ppHead == &pGlobalVariables)
-		VariableMap.erase(pVar->szName);
+		VariableMap.erase(pVar->Name);
+	else
+		RemoveStackVariable(pVar);
 	if (pVar->pNext)
 		pVar->pNext->pPrev = pVar->pPrev;
 	if (pVar->pPrev)
@@ -40,7 +104,13 @@ void DeleteMQ2DataVariable(MQDataVar* pVar)
 
 MQDataVar* FindMQ2DataVariable(const char* Name)
 {
-	std::scoped_lock lock(s_dataVarMutex);
+	// Variables are only added and removed on the main thread, under the lock. The main thread can
+	// therefore read them without locking, while other threads are serialized against it.
+	const bool lockFree = gbLockFreeVariableReads && IsMainThread();
+
+	std::unique_lock lock(s_dataVarMutex, std::defer_lock);
+	if (!lockFree)
+		lock.lock();
 
 	MQDataVar* pFind = nullptr;
 	auto it = VariableMap.find(Name);
@@ -53,21 +123,19 @@ MQDataVar* FindMQ2DataVariable(const char* Name)
 	// local?
 	if (gMacroStack)
 	{
-		MQDataVar* pVar = gMacroStack->Parameters;
-		while (pVar)
+		if (!gMacroStack->VariableIndexValid)
 		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
-		}
+			// Rebuilding modifies the index, which other threads may be reading.
+			std::unique_lock rebuildLock(s_dataVarMutex, std::defer_lock);
+			if (lockFree)
+				rebuildLock.lock();
 
-		pVar = gMacroStack->LocalVariables;
-		while (pVar)
-		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
+			RebuildStackVariableIndex(gMacroStack);
 		}
+
+		auto localIter = gMacroStack->VariableIndex.find(Name);
+		if (localIter != gMacroStack->VariableIndex.end())
+			return localIter->second;
 	}
 
 	return nullptr;
@@ -155,7 +223,7 @@ static bool AddMQ2DataEventVariable(const char* Name, char* Index, MQ2Type* pTyp
 	pVar->pPrev = nullptr;
 	if (pVar->pNext)
 		pVar->pNext->pPrev = pVar;
-	strcpy_s(pVar->szName, Name);
+	pVar->Name = Name;
 
 	if (Index[0])
 	{
@@ -177,6 +245,10 @@ static bool AddMQ2DataEventVariable(const char* Name, char* Index, MQ2Type* pTyp
 	{
 		VariableMap[Name] = pVar;
 	}
+	else
+	{
+		AddStackVariable(pVar);
+	}
 
 	return true;
 }
@@ -203,7 +275,7 @@ static bool AddMQ2DataVariableBy(const char* Name, const char* Index, MQ2Type* p
 	pVar->pPrev = nullptr;
 	if (pVar->pNext)
 		pVar->pNext->pPrev = pVar;
-	strcpy_s(pVar->szName, Name);
+	pVar->Name = Name;
 
 	if (Index[0])
 	{
@@ -218,6 +290,10 @@ static bool AddMQ2DataVariableBy(const char* Name, const char* Index, MQ2Type* p
 		}
 		else
 		{
+			// The variable stays in its list, keep the index in sync with it.
+			if (MQMacroStack* pStack = FindVariableStack(ppHead))
+				pStack->VariableIndexValid = false;
+
 			return false;
 		}
 	}
@@ -233,6 +309,10 @@ static bool AddMQ2DataVariableBy(const char* Name, const char* Index, MQ2Type* p
 	{
 		VariableMap[Name] = pVar;
 	}
+	else
+	{
+		IndexStackVariable(gMacroStack, pVar);
+	}
 
 	return true;
 }
@@ -421,17 +501,21 @@ void NewVarset(SPAWNINFO* pChar, char* szLine)
 		return;
 	}
 
-	char szName[MAX_STRING] = { 0 };
-	GetArg(szName, szLine, 1);
+	CommandArgs args(szLine);
+	std::string_view name = args[0];
+	const char* szRest = args.Rest(1).data();
 
-	const char* szRest = GetNextArg(szLine);
-	char szIndex[MAX_STRING] = { 0 };
-	if (char* pBracket = strchr(szName, '['))
+	std::string_view index;
+	size_t bracket = name.find('[');
+	if (bracket != std::string_view::npos)
 	{
-		*pBracket = 0;
-		strcpy_s(szIndex, &pBracket[1]);
+		index = name.substr(bracket + 1);
+		name = name.substr(0, bracket);
 	}
 
+	std::string varName(name);
+	const char* szName = varName.c_str();
+
 	MQDataVar* pVar = FindMQ2DataVariable(szName);
 	if (!pVar)
 	{
@@ -439,7 +523,7 @@ void NewVarset(SPAWNINFO* pChar, char* szLine)
 		return;
 	}
 
-	if (szIndex[0])
+	if (!index.empty())
 	{
 		if (pVar->Var.Type != pArrayType)
 		{
@@ -448,16 +532,16 @@ void NewVarset(SPAWNINFO* pChar, char* szLine)
 		}
 
 		auto pArray = pVar->Var.Get<CDataArray>();
-		int index = pArray->GetElement(szIndex);
-		if (index == -1)
+		int element = pArray->GetElement(index);
+		if (element == -1)
 		{
-			MacroError("/varset '%s[%d]' failed, out of bounds on array", szName, index);
+			MacroError("/varset '%s[%d]' failed, out of bounds on array", szName, element);
 			return;
 		}
 
-		if (!pArray->GetType()->FromString(pArray->GetData(index), szRest))
+		if (!pArray->GetType()->FromString(pArray->GetData(element), szRest))
 		{
-			MacroError("/varset '%s[%d]' failed, array element type rejected new value", szName, index);
+			MacroError("/varset '%s[%d]' failed, array element type rejected new value", szName, element);
 		}
 	}
 	else
@@ -633,16 +717,203 @@ void NewVardata(SPAWNINFO* pChar, char* szLine)
 	}
 }
 
+//============================================================================
+// Macro event queue
+
+struct MQEventFifo
+{
+	MQEventQueue* pHead = nullptr;
+	MQEventQueue* pTail = nullptr;
+};
+
+// Built-in events are indexed by type, custom events by the #event that queued them.
+static MQEventFifo s_eventQueues[NUM_EVENTS];
+static std::unordered_map<const MQEventList*, MQEventFifo> s_customEventQueues;
+static MQEventQueue* s_eventQueueTail = nullptr;
+static uint64_t s_eventSequence = 0;
+
+// Entries are recycled so that a chatty #event does not allocate for every line it matches.
+static std::vector<MQEventQueue*> s_eventPool;
+static constexpr size_t MAX_POOLED_EVENTS = 64;
+
+static MQEventFifo* GetEventFifo(const MQEventQueue* pEvent, bool create)
+{
+	if (pEvent->Type != EVENT_CUSTOM)
+		return &s_eventQueues[pEvent->Type];
+
+	if (create)
+		return &s_customEventQueues[pEvent->pEventList];
+
+	auto iter = s_customEventQueues.find(pEvent->pEventList);
+	return iter != s_customEventQueues.end() ? &iter->second : nullptr;
+}
+
+MQEventQueue* AllocateMacroEvent()
+{
+	if (s_eventPool.empty())
+		return new MQEventQueue();
+
+	MQEventQueue* pEvent = s_eventPool.back();
+	s_eventPool.pop_back();
+	return pEvent;
+}
+
+void FreeMacroEvent(MQEventQueue* pEvent)
+{
+	ClearMQ2DataVariables(&pEvent->Parameters);
+
+	if (s_eventPool.size() >= MAX_POOLED_EVENTS)
+	{
+		delete pEvent;
+		return;
+	}
+
+	pEvent->Name.clear();
+	pEvent->Type = EVENT_CHAT;
+	pEvent->pEventList = nullptr;
+	pEvent->pPrev = pEvent->pNext = nullptr;
+	pEvent->pPrevSame = pEvent->pNextSame = nullptr;
+	pEvent->Sequence = 0;
+	s_eventPool.push_back(pEvent);
+}
+
+void QueueMacroEvent(MQEventQueue* pEvent)
+{
+	pEvent->Sequence = ++s_eventSequence;
+
+	// The tail is only trusted while it still belongs to gEventQueue.
+	if (!gEventQueue)
+		s_eventQueueTail = nullptr;
+
+	pEvent->pNext = nullptr;
+	pEvent->pPrev = s_eventQueueTail;
+	if (s_eventQueueTail)
+		s_eventQueueTail->pNext = pEvent;
+	else
+		gEventQueue = pEvent;
+	s_eventQueueTail = pEvent;
+
+	MQEventFifo* fifo = GetEventFifo(pEvent, true);
+	pEvent->pNextSame = nullptr;
+	pEvent->pPrevSame = fifo->pTail;
+	if (fifo->pTail)
+		fifo->pTail->pNextSame = pEvent;
+	else
+		fifo->pHead = pEvent;
+	fifo->pTail = pEvent;
+}
+
+void UnlinkMacroEvent(MQEventQueue* pEvent)
+{
+	if (pEvent->pPrev)
+		pEvent->pPrev->pNext = pEvent->pNext;
+	else
+		gEventQueue = pEvent->pNext;
+	if (pEvent->pNext)
+		pEvent->pNext->pPrev = pEvent->pPrev;
+	else
+		s_eventQueueTail = pEvent->pPrev;
+
+	if (MQEventFifo* fifo = GetEventFifo(pEvent, false))
+	{
+		if (pEvent->pPrevSame)
+			pEvent->pPrevSame->pNextSame = pEvent->pNextSame;
+		else
+			fifo->pHead = pEvent->pNextSame;
+		if (pEvent->pNextSame)
+			pEvent->pNextSame->pPrevSame = pEvent->pPrevSame;
+		else
+			fifo->pTail = pEvent->pPrevSame;
+
+		if (!fifo->pHead && pEvent->Type == EVENT_CUSTOM)
+			s_customEventQueues.erase(pEvent->pEventList);
+	}
+
+	pEvent->pPrev = pEvent->pNext = nullptr;
+	pEvent->pPrevSame = pEvent->pNextSame = nullptr;
+}
+
+// Collects the queues that feed "Sub Event_<name>". Several #event lines may share a sub.
+template <typename Func>
+static void ForEachEventFifo(const char* szName, Func&& func)
+{
+	char szSub[MAX_STRING] = { 0 };
+	sprintf_s(szSub, "Sub Event_%s", szName);
+
+	if (!_stricmp(szSub, "Sub Event_Chat"))
+		func(s_eventQueues[EVENT_CHAT]);
+	else if (!_stricmp(szSub, "Sub Event_Timer"))
+		func(s_eventQueues[EVENT_TIMER]);
+
+	for (auto& [pList, fifo] : s_customEventQueues)
+	{
+		if (!_stricmp(pList->Name.c_str(), szSub))
+			func(fifo);
+	}
+}
+
+MQEventQueue* FindMacroEvent(const char* szName)
+{
+	if (!szName || !szName[0])
+		return gEventQueue;
+
+	MQEventQueue* pOldest = nullptr;
+	ForEachEventFifo(szName, [&pOldest](const MQEventFifo& fifo)
+		{
+			if (fifo.pHead && (!pOldest || fifo.pHead->Sequence < pOldest->Sequence))
+				pOldest = fifo.pHead;
+		});
+
+	return pOldest;
+}
+
+void FlushMacroEvents(const char* szName)
+{
+	if (!szName || !szName[0])
+	{
+		while (gEventQueue)
+		{
+			MQEventQueue* pEvent = gEventQueue;
+			DebugSpewNoFile("FlushMacroEvents: Deleting event %d %s", pEvent->Type, pEvent->Name.c_str());
+
+			gEventQueue = pEvent->pNext;
+			FreeMacroEvent(pEvent);
+		}
+
+		for (MQEventFifo& fifo : s_eventQueues)
+			fifo = MQEventFifo();
+		s_customEventQueues.clear();
+		s_eventQueueTail = nullptr;
+		return;
+	}
+
+	// Unlinking may erase the custom queue being visited, so gather the events first.
+	std::vector<MQEventQueue*> events;
+	ForEachEventFifo(szName, [&events](const MQEventFifo& fifo)
+		{
+			for (MQEventQueue* pEvent = fifo.pHead; pEvent; pEvent = pEvent->pNextSame)
+				events.push_back(pEvent);
+		});
+
+	for (MQEventQueue* pEvent : events)
+	{
+		DebugSpewNoFile("FlushMacroEvents: Deleting event %d %s", pEvent->Type, pEvent->Name.c_str());
+
+		UnlinkMacroEvent(pEvent);
+		FreeMacroEvent(pEvent);
+	}
+}
+
 static void AddEvent(MQEventType Event, const char* FirstArg, ...)
 {
 	MQEventQueue* pEvent = nullptr;
 	if (!gEventFunc[Event])
 		return;
 
-	// this is deleted in 2 locations DoEvents and EndMacro
+	// this is released by DoEvents or FlushMacroEvents
 	DebugSpewNoFile("Adding Event %d %s", Event, FirstArg);
 
-	pEvent = new MQEventQueue();
+	pEvent = AllocateMacroEvent();
 	pEvent->Name = FirstArg;
 	pEvent->Type = Event;
 
@@ -679,17 +950,7 @@ static void AddEvent(MQEventType Event, const char* FirstArg, ...)
 		va_end(marker);
 	}
 
-	if (!gEventQueue)
-	{
-		gEventQueue = pEvent;
-	}
-	else
-	{
-		MQEventQueue* pTemp = nullptr;
-		for (pTemp = gEventQueue; pTemp->pNext; pTemp = pTemp->pNext);
-		pTemp->pNext = pEvent;
-		pEvent->pPrev = pTemp;
-	}
+	QueueMacroEvent(pEvent);
 }
 
 void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValues)
@@ -705,11 +966,7 @@ void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValu
 		return;
 	}
 
-	pEvent = new MQEventQueue();
-	if (!pEvent)
-		return;
-
-	ZeroMemory(pEvent, sizeof(MQEventQueue));
+	pEvent = AllocateMacroEvent();
 	pEvent->Type = EVENT_CUSTOM;
 	pEvent->pEventList = pEList;
 	char szParamName[MAX_STRING] = { 0 };
@@ -747,17 +1004,7 @@ void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValu
 		pValues = pValues->pNext;
 	}
 
-	if (!gEventQueue)
-	{
-		gEventQueue = pEvent;
-	}
-	else
-	{
-		MQEventQueue* pTemp;
-		for (pTemp = gEventQueue; pTemp->pNext; pTemp = pTemp->pNext);
-		pTemp->pNext = pEvent;
-		pEvent->pPrev = pTemp;
-	}
+	QueueMacroEvent(pEvent);
 }
 
 static DWORD CALLBACK BeepOnTellThread(void* pData)
@@ -856,24 +1103,26 @@ static void TellCheck(const char* szClean)
 
 void CheckChatForEvent(const char* szMsg)
 {
-	size_t len = strlen(szMsg);
+	RecordSessionChat(szMsg);
 
-	auto pszCleanOrg = std::make_unique<char[]>(len + 64);
-	char* szClean = pszCleanOrg.get();
+	// The line is only copied when it has item tags to strip, every consumer below reads the
+	// same cleaned text.
+	const char* szClean = szMsg;
+	CXStr cleaned;
 
-	strcpy_s(szClean, len + 64, szMsg);
-
-	if (strchr(szClean, '\x12'))
+	if (strchr(szMsg, '\x12'))
 	{
-		CXStr out = CleanItemTags(szClean, false);
-		strcpy_s(szClean, len + 64, out.c_str());
+		cleaned = CleanItemTags(szMsg, false);
+		szClean = cleaned.c_str();
 	}
 
-	strncpy_s(EventMsg, szClean, MAX_STRING - 1);
-	EventMsg[MAX_STRING - 1] = 0;
-	if (pMQ2Blech)
+	if (pMQ2Blech && pMQ2Blech->MayMatch(szClean))
+	{
+		strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+		EventMsg[MAX_STRING - 1] = 0;
 		pMQ2Blech->Feed(EventMsg);
-	EventMsg[0] = 0;
+		EventMsg[0] = 0;
+	}
 	TellCheck(szClean);
 
 	MQMacroBlockPtr pBlock = GetCurrentMacroBlock();
@@ -882,7 +1131,7 @@ void CheckChatForEvent(const char* szMsg)
 		char SpeakerName[MAX_STRING] = { 0 };
 		char Content[MAX_STRING] = { 0 };
 		char Channel[MAX_STRING] = { 0 };
-		char* pDest = nullptr;
+		const char* pDest = nullptr;
 
 		int StartCopyAt = 0;
 
@@ -979,31 +1228,66 @@ void CheckChatForEvent(const char* szMsg)
 			AddEvent(EVENT_CHAT, Channel, SpeakerName, Content, NULL);
 		}
 
-		strncpy_s(EventMsg, szClean, MAX_STRING - 1);
-		EventMsg[MAX_STRING - 1] = 0;
-		pEventBlech->Feed(EventMsg);
-		EventMsg[0] = '\0';
+		if (pEventBlech->MayMatch(szClean))
+		{
+			strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+			EventMsg[MAX_STRING - 1] = 0;
+			pEventBlech->Feed(EventMsg);
+			EventMsg[0] = '\0';
+		}
 	}
 }
 
-void DropTimers()
+// Timers count down in the 100ms ticks of the heartbeat. Instead of each of them being decremented
+// every tick, they keep the tick they run out on and are ordered by it, so a tick only has to look at
+// the ones that are due.
+static uint64_t s_timerTick = 0;
+static std::multimap<uint64_t, MQTimer*> s_timerDeadlines;
+
+MQTimer::~MQTimer()
 {
-	MQTimer* pTimer = gTimer;
+	SetCurrent(0);
+}
 
-	char szOrig[MAX_STRING] = { 0 };
+uint32_t MQTimer::GetCurrent() const
+{
+	return Deadline > s_timerTick ? static_cast<uint32_t>(Deadline - s_timerTick) : 0;
+}
 
-	while (pTimer)
+void MQTimer::SetCurrent(uint32_t value)
+{
+	if (Deadline != 0)
 	{
-		if (pTimer->Current)
+		auto range = s_timerDeadlines.equal_range(Deadline);
+		for (auto iter = range.first; iter != range.second; ++iter)
 		{
-			pTimer->Current--;
-			if (!pTimer->Current)
+			if (iter->second == this)
 			{
-				_itoa_s(pTimer->Original, szOrig, 10);
-				AddEvent(EVENT_TIMER, pTimer->Name.c_str(), szOrig, NULL);
+				s_timerDeadlines.erase(iter);
+				break;
 			}
 		}
-		pTimer = pTimer->pNext;
+	}
+
+	Deadline = value ? s_timerTick + value : 0;
+
+	if (Deadline != 0)
+		s_timerDeadlines.emplace(Deadline, this);
+}
+
+void DropTimers()
+{
+	++s_timerTick;
+
+	char szOrig[MAX_STRING] = { 0 };
+
+	while (!s_timerDeadlines.empty() && s_timerDeadlines.begin()->first <= s_timerTick)
+	{
+		MQTimer* pTimer = s_timerDeadlines.begin()->second;
+		s_timerDeadlines.erase(s_timerDeadlines.begin());
+
+		_itoa_s(pTimer->Original, szOrig, 10);
+		AddEvent(EVENT_TIMER, pTimer->Name.c_str(), szOrig, NULL);
 	}
 }
 
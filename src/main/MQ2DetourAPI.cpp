@@ -28,6 +28,27 @@ int gbInMemCheck4 = 0;
 class Detour;
 static Detour* s_detourList = nullptr;
 
+// How deep in detour batches we are, and how many detours are waiting on the outermost one
+static int s_detourBatchDepth = 0;
+static int s_detourBatchCount = 0;
+
+// Starts a detours transaction unless a batch already has one open.
+static void BeginDetourTransaction()
+{
+	if (s_detourBatchDepth == 0)
+		DetourTransactionBegin();
+	else
+		++s_detourBatchCount;
+}
+
+static LONG CommitDetourTransaction()
+{
+	if (s_detourBatchDepth == 0)
+		return DetourTransactionCommit();
+
+	return NO_ERROR;
+}
+
 class Detour final
 {
 public:
@@ -43,9 +64,9 @@ public:
 		//SPDLOG_DEBUG("Add detour: {} at {}: {} -> {}", m_name, (void*)m_address,
 		//	(void*)m_target, (void*)m_detour);
 
-		DetourTransactionBegin();
+		BeginDetourTransaction();
 		DetourAttach(m_target, m_detour);
-		LONG result = DetourTransactionCommit();
+		LONG result = CommitDetourTransaction();
 		if (result != NO_ERROR)
 		{
 			SPDLOG_ERROR("Failed to commit detour: {} -> {}", m_name, result);
@@ -65,9 +86,13 @@ public:
 	{
 		//SPDLOG_DEBUG("Remove detour: {} at {}", m_name, (void*)m_address);
 
-		DetourTransactionBegin();
+		// patches don't have anything to detach
+		if (m_target == nullptr)
+			return;
+
+		BeginDetourTransaction();
 		DetourDetach(m_target, m_detour);
-		DetourTransactionCommit();
+		CommitDetourTransaction();
 	}
 
 	uintptr_t Address() const { return m_address; }
@@ -160,8 +185,31 @@ void RemoveDetour(uintptr_t address)
 	}
 }
 
+void BeginDetourBatch()
+{
+	if (s_detourBatchDepth++ == 0)
+	{
+		s_detourBatchCount = 0;
+		DetourTransactionBegin();
+	}
+}
+
+void CommitDetourBatch()
+{
+	if (s_detourBatchDepth == 0 || --s_detourBatchDepth > 0)
+		return;
+
+	LONG result = DetourTransactionCommit();
+	if (result != NO_ERROR)
+	{
+		SPDLOG_ERROR("Failed to commit batch of {} detours: {}", s_detourBatchCount, result);
+	}
+}
+
 void RemoveDetours()
 {
+	DetourBatch batch;
+
 	auto detour = s_detourList;
 	while (detour != nullptr)
 	{
@@ -637,6 +685,7 @@ void InitializeDetours()
 
 	extern_array0 = reinterpret_cast<uint32_t*>(__EncryptPad0);
 
+	DetourBatch batch;
 	HookMemChecker(true);
 
 	uintptr_t GetProcAddress_Addr = (uintptr_t)&::GetProcAddress;
@@ -651,6 +700,8 @@ void InitializeDetours()
 
 void ShutdownDetours()
 {
+	DetourBatch batch;
+
 	uintptr_t GetProcAddress_Addr = (uintptr_t)&::GetProcAddress;
 	RemoveDetour(GetProcAddress_Addr);
 	RemoveDetour(__ModuleList);
@@ -14,6 +14,7 @@
 
 #include "pch.h"
 #include "MQ2DeveloperTools.h"
+#include "MQPostOffice.h"
 
 #include "imgui/ImGuiUtils.h"
 #include "imgui/fonts/IconsFontAwesome.h"
@@ -51,7 +52,7 @@ static MQModule s_developerToolsModule = {
 	DeveloperTools_SetGameState,
 	DeveloperTools_UpdateImGui,
 };
-DECLARE_MODULE_INITIALIZER(s_developerToolsModule);
+DECLARE_DEFERRED_MODULE_INITIALIZER(s_developerToolsModule);
 
 extern std::vector<std::unique_ptr<MQBenchmark>> gBenchmarks;
 
@@ -4158,7 +4159,7 @@ public:
 		for (auto& bm : gBenchmarks)
 		{
 			if (bm != nullptr)
-				bm->LastTime = std::chrono::microseconds::zero();
+				bm->LastTime = std::chrono::nanoseconds::zero();
 		}
 	}
 
@@ -4183,6 +4184,16 @@ public:
 			DrawTable();
 		}
 
+		if (ImGui::CollapsingHeader("Frame Tree"))
+		{
+			DrawFrameTree();
+		}
+
+		if (ImGui::CollapsingHeader("Plugin Callbacks"))
+		{
+			DrawPluginCallbacks();
+		}
+
 		ResetLastTimes();
 	}
 
@@ -4230,7 +4241,7 @@ public:
 					data = iter->second.get();
 				}
 
-				data->AddPoint(m_time, static_cast<float>(bm->LastTime.count()) / 1000.f);
+				data->AddPoint(m_time, std::chrono::duration<float, std::milli>(bm->LastTime).count());
 				data->Updated = true;
 			}
 
@@ -4301,23 +4312,145 @@ public:
 
 	void DrawTable()
 	{
-		if (ImGui::BeginTable("##BenchmarksTable", 4))
+		if (ImGui::BeginTable("##BenchmarksTable", 9))
 		{
 			ImGui::TableSetupColumn("Name");
 			ImGui::TableSetupColumn("Count");
 			ImGui::TableSetupColumn("Total");
 			ImGui::TableSetupColumn("Last");
+			ImGui::TableSetupColumn("p50");
+			ImGui::TableSetupColumn("p95");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableSetupColumn("Max");
+			ImGui::TableSetupColumn("Allocations");
 			ImGui::TableHeadersRow();
 
+			auto toMilliseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<float, std::milli>(time).count(); };
+
 			for (const auto& bm : gBenchmarks)
 			{
+				if (bm == nullptr)
+					continue;
+
 				ImGui::TableNextRow();
 				ImGui::TableNextColumn();
 
 				ImGui::Text(bm->Name.c_str()); ImGui::TableNextColumn();
 				ImGui::Text("%d", bm->Count); ImGui::TableNextColumn();
-				ImGui::Text("%.3f ms", static_cast<float>(bm->TotalTime.count() / 1000.f)); ImGui::TableNextColumn();
-				ImGui::Text("%.3f ms", static_cast<float>(bm->LastTime.count() / 1000.f));
+				ImGui::Text("%.3f ms", toMilliseconds(bm->TotalTime)); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", toMilliseconds(bm->LastTime)); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", toMilliseconds(bm->Histogram.GetPercentile(50))); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", toMilliseconds(bm->Histogram.GetPercentile(95))); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", toMilliseconds(bm->Histogram.GetPercentile(99))); ImGui::TableNextColumn();
+				ImGui::Text("%.3f ms", toMilliseconds(bm->Histogram.Max)); ImGui::TableNextColumn();
+				ImGui::Text("%llu", bm->Allocations);
+			}
+
+			ImGui::EndTable();
+		}
+	}
+
+	void DrawFrameTree()
+	{
+		const std::vector<MQBenchmarkNode>& tree = GetBenchmarkFrameTree();
+		if (tree.empty())
+			return;
+
+		if (ImGui::BeginTable("##BenchmarkFrameTree", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_NoHide);
+			ImGui::TableSetupColumn("Inclusive");
+			ImGui::TableSetupColumn("Self");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Allocations");
+			ImGui::TableSetupColumn("Allocated");
+			ImGui::TableHeadersRow();
+
+			DrawFrameTreeNode(tree, 0);
+
+			ImGui::EndTable();
+		}
+	}
+
+	void DrawFrameTreeNode(const std::vector<MQBenchmarkNode>& tree, int index)
+	{
+		const MQBenchmarkNode& node = tree[index];
+
+		const char* name = "Frame";
+		if (node.Benchmark != MQBenchmarkNode::FrameRoot)
+		{
+			name = node.Benchmark < gBenchmarks.size() && gBenchmarks[node.Benchmark]
+				? gBenchmarks[node.Benchmark]->Name.c_str() : "(removed)";
+		}
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+
+		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_DefaultOpen;
+		if (node.FirstChild == -1)
+			flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+
+		// the path of benchmarks leading here is what makes a node unique, so use its index as the id
+		bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<intptr_t>(index)), flags, "%s", name);
+
+		auto toMilliseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<float, std::milli>(time).count(); };
+
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", toMilliseconds(node.InclusiveTime));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f ms", toMilliseconds(node.SelfTime));
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", node.Count);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", node.Allocations);
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu bytes", node.AllocatedBytes);
+
+		if (open && node.FirstChild != -1)
+		{
+			for (int child = node.FirstChild; child != -1; child = tree[child].NextSibling)
+				DrawFrameTreeNode(tree, child);
+
+			ImGui::TreePop();
+		}
+	}
+
+	void DrawPluginCallbacks()
+	{
+		if (ImGui::BeginTable("##PluginCallbacks", 8, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Plugin");
+			ImGui::TableSetupColumn("Callback");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Total");
+			ImGui::TableSetupColumn("Average");
+			ImGui::TableSetupColumn("Max");
+			ImGui::TableSetupColumn("Last");
+			ImGui::TableSetupColumn("Slow");
+			ImGui::TableHeadersRow();
+
+			auto toMilliseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<float, std::milli>(time).count(); };
+
+			for (const MQPlugin* pPlugin = pPlugins; pPlugin; pPlugin = pPlugin->pNext)
+			{
+				for (size_t i = 0; i < pPlugin->CallbackTimings.size(); ++i)
+				{
+					const MQPluginCallbackTiming& timing = pPlugin->CallbackTimings[i];
+					if (timing.Count == 0)
+						continue;
+
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+
+					ImGui::Text("%s", pPlugin->name.c_str()); ImGui::TableNextColumn();
+					ImGui::Text("%s", GetPluginCallbackName(static_cast<PluginCallback>(i))); ImGui::TableNextColumn();
+					ImGui::Text("%llu", timing.Count); ImGui::TableNextColumn();
+					ImGui::Text("%.3f ms", toMilliseconds(timing.TotalTime)); ImGui::TableNextColumn();
+					ImGui::Text("%.3f ms", toMilliseconds(timing.TotalTime) / static_cast<float>(timing.Count)); ImGui::TableNextColumn();
+					ImGui::Text("%.3f ms", toMilliseconds(timing.MaxTime)); ImGui::TableNextColumn();
+					ImGui::Text("%.3f ms", toMilliseconds(timing.LastTime)); ImGui::TableNextColumn();
+					ImGui::Text("%u", timing.SlowCount);
+				}
 			}
 
 			ImGui::EndTable();
@@ -4339,6 +4472,340 @@ static BenchmarksInspector* s_benchmarksInspector = nullptr;
 
 #pragma endregion
 
+#pragma region Performance Dashboard
+
+extern uint64_t s_commandCount;
+
+class PerformanceDashboard : public ImGuiWindowBase
+{
+	// These benchmarks time the game's own work, so they count towards EverQuest's share of the
+	// frame rather than ours. Anything of ours that runs inside of them still counts as ours.
+	static constexpr const char* GameBenchmarks[] = {
+		"ProcessGameEvents",
+		"Render_Scene",
+		"Render_Simulation",
+		"Render_Throttle",
+	};
+
+	// how often the rates and per plugin costs are sampled
+	static constexpr std::chrono::milliseconds SampleInterval = 250ms;
+
+public:
+	PerformanceDashboard() : ImGuiWindowBase("Performance Dashboard")
+	{
+		SetDefaultSize(ImVec2(800, 900));
+	}
+
+	virtual void Draw() override
+	{
+		ImGui::SliderFloat("History", &m_history, 10.0f, 120.0f, "%.1f s");
+
+		ImGui::SameLine();
+		if (ImGui::Button("Clear"))
+			Clear();
+
+		ImGui::SameLine();
+		if (ImGui::Button(m_paused ? "Resume" : "Pause"))
+			m_paused = !m_paused;
+
+		ImGui::SameLine();
+		ImGui::Checkbox("Track Allocations", &gbTrackAllocations);
+
+		if (!m_paused)
+			Update();
+
+		const float plotHeight = std::max((ImGui::GetContentRegionAvail().y - 4 * ImGui::GetStyle().ItemSpacing.y) / 5, 100.0f);
+
+		if (BeginTimePlot("Frame Time", "Milliseconds", plotHeight))
+		{
+			PlotData("Frame", m_frameData);
+			PlotData("MacroQuest", m_mqData);
+			PlotData("EverQuest", m_eqData);
+
+			ImPlot::EndPlot();
+		}
+
+		if (BeginTimePlot("Plugin Cost", "Milliseconds per Frame", plotHeight))
+		{
+			for (const auto& [name, data] : m_pluginData)
+				PlotData(name.c_str(), *data);
+
+			ImPlot::EndPlot();
+		}
+
+		if (BeginTimePlot("Scripts", "Milliseconds per Frame", plotHeight, "Macro Lines per Second"))
+		{
+			PlotData("Lua Threads", m_luaData);
+
+			ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+			PlotData("Macro Lines", m_macroData);
+
+			ImPlot::EndPlot();
+		}
+
+		if (BeginTimePlot("Pipe Messages", "Messages per Second", plotHeight))
+		{
+			PlotData("Sent", m_pipeSentData);
+			PlotData("Received", m_pipeReceivedData);
+
+			ImPlot::EndPlot();
+		}
+
+		if (BeginTimePlot("Allocations", "Allocations per Frame", plotHeight))
+		{
+			for (const auto& [name, data] : m_allocationData)
+				PlotData(name.c_str(), *data);
+
+			ImPlot::EndPlot();
+		}
+	}
+
+private:
+	void Clear()
+	{
+		m_frameData.Erase();
+		m_mqData.Erase();
+		m_eqData.Erase();
+		m_luaData.Erase();
+		m_macroData.Erase();
+		m_pipeSentData.Erase();
+		m_pipeReceivedData.Erase();
+		m_pluginData.clear();
+		m_allocationData.clear();
+	}
+
+	void Update()
+	{
+		m_time += ImGui::GetIO().DeltaTime;
+
+		const std::vector<MQBenchmarkNode>& tree = GetBenchmarkFrameTree();
+		if (!tree.empty())
+		{
+			for (size_t i = 0; i < lengthof(GameBenchmarks); ++i)
+			{
+				if (!FindMQ2Benchmark(GameBenchmarks[i], m_gameBenchmarks[i]))
+					m_gameBenchmarks[i] = MQBenchmarkNode::FrameRoot;
+			}
+
+			const std::chrono::nanoseconds frameTime = tree[0].InclusiveTime;
+			const std::chrono::nanoseconds mqTime = std::min(GetMQTime(tree, 0), frameTime);
+
+			m_frameData.AddPoint(m_time, ToMilliseconds(frameTime));
+			m_mqData.AddPoint(m_time, ToMilliseconds(mqTime));
+			m_eqData.AddPoint(m_time, ToMilliseconds(frameTime - mqTime));
+		}
+
+		++m_framesSinceSample;
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now - m_lastSample < SampleInterval)
+			return;
+
+		const bool firstSample = m_lastSample == std::chrono::steady_clock::time_point{};
+		const float seconds = std::chrono::duration<float>(now - m_lastSample).count();
+		const float frames = static_cast<float>(m_framesSinceSample);
+
+		m_lastSample = now;
+		m_framesSinceSample = 0;
+
+		// Plugins
+		for (const auto& [name, data] : m_pluginData)
+			data->Updated = false;
+
+		for (const MQPlugin* pPlugin = pPlugins; pPlugin; pPlugin = pPlugin->pNext)
+		{
+			std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+			for (const MQPluginCallbackTiming& timing : pPlugin->CallbackTimings)
+				total += timing.TotalTime;
+
+			auto& data = m_pluginData[pPlugin->name];
+			if (!data)
+				data = std::make_unique<ScrollingData>();
+
+			auto& lastTotal = m_pluginTotals[pPlugin->name];
+			if (!firstSample && total >= lastTotal)
+				data->AddPoint(m_time, ToMilliseconds(total - lastTotal) / frames);
+
+			lastTotal = total;
+			data->Updated = true;
+		}
+
+		for (auto iter = m_pluginData.begin(); iter != m_pluginData.end();)
+		{
+			if (iter->second->Updated)
+			{
+				++iter;
+			}
+			else
+			{
+				m_pluginTotals.erase(iter->first);
+				iter = m_pluginData.erase(iter);
+			}
+		}
+
+		// Allocations, by the module that made them
+		for (const auto& [name, data] : m_allocationData)
+			data->Updated = false;
+
+		if (gbTrackAllocations)
+		{
+			AddAllocationSample("MQ2Main", GetMainAllocations(), frames);
+
+			for (const MQPlugin* pPlugin = pPlugins; pPlugin; pPlugin = pPlugin->pNext)
+			{
+				if (pPlugin->Allocations)
+					AddAllocationSample(pPlugin->name, *pPlugin->Allocations, frames);
+			}
+		}
+
+		for (auto iter = m_allocationData.begin(); iter != m_allocationData.end();)
+		{
+			if (iter->second->Updated)
+			{
+				++iter;
+			}
+			else
+			{
+				m_allocationTotals.erase(iter->first);
+				iter = m_allocationData.erase(iter);
+			}
+		}
+
+		// Lua threads
+		std::chrono::nanoseconds luaTotal = std::chrono::nanoseconds::zero();
+		uint32_t luaBenchmark = 0;
+		if (FindMQ2Benchmark("Lua_Threads", luaBenchmark))
+			luaTotal = gBenchmarks[luaBenchmark]->TotalTime;
+
+		if (!firstSample && luaTotal >= m_lastLuaTotal)
+			m_luaData.AddPoint(m_time, ToMilliseconds(luaTotal - m_lastLuaTotal) / frames);
+		m_lastLuaTotal = luaTotal;
+
+		// Macro lines. The count starts over with every macro.
+		const uint64_t commandCount = s_commandCount;
+		if (!firstSample)
+		{
+			const uint64_t lines = commandCount >= m_lastCommandCount ? commandCount - m_lastCommandCount : commandCount;
+			m_macroData.AddPoint(m_time, static_cast<float>(lines) / seconds);
+		}
+		m_lastCommandCount = commandCount;
+
+		// Pipe
+		uint64_t sent = 0, received = 0;
+		pipeclient::GetPipeMessageCounts(sent, received);
+
+		if (!firstSample)
+		{
+			m_pipeSentData.AddPoint(m_time, static_cast<float>(sent - m_lastPipeSent) / seconds);
+			m_pipeReceivedData.AddPoint(m_time, static_cast<float>(received - m_lastPipeReceived) / seconds);
+		}
+		m_lastPipeSent = sent;
+		m_lastPipeReceived = received;
+	}
+
+	void AddAllocationSample(const std::string& name, const MQAllocationCounters& counters, float frames)
+	{
+		const uint64_t count = counters.Count.load(std::memory_order_relaxed);
+
+		auto& data = m_allocationData[name];
+		if (!data)
+			data = std::make_unique<ScrollingData>();
+
+		// the first sample of a module only sets where its count starts from
+		auto iter = m_allocationTotals.find(name);
+		if (iter != m_allocationTotals.end() && count >= iter->second)
+			data->AddPoint(m_time, static_cast<float>(count - iter->second) / frames);
+
+		m_allocationTotals[name] = count;
+		data->Updated = true;
+	}
+
+	bool IsGameBenchmark(uint32_t benchmark) const
+	{
+		return std::find(std::begin(m_gameBenchmarks), std::end(m_gameBenchmarks), benchmark) != std::end(m_gameBenchmarks);
+	}
+
+	// Time spent in our own benchmarks below the node, looking through the ones that belong to the game.
+	std::chrono::nanoseconds GetMQTime(const std::vector<MQBenchmarkNode>& tree, int index) const
+	{
+		std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+
+		for (int child = tree[index].FirstChild; child != -1; child = tree[child].NextSibling)
+		{
+			if (IsGameBenchmark(tree[child].Benchmark))
+				total += GetMQTime(tree, child);
+			else
+				total += tree[child].InclusiveTime;
+		}
+
+		return total;
+	}
+
+	bool BeginTimePlot(const char* title, const char* axisLabel, float height, const char* secondAxisLabel = nullptr)
+	{
+		ImPlot::SetNextAxisLimits(ImAxis_X1, static_cast<double>(m_time) - m_history, m_time, ImGuiCond_Always);
+
+		if (!ImPlot::BeginPlot(title, ImVec2(-1, height)))
+			return false;
+
+		ImPlot::SetupAxis(ImAxis_X1, nullptr, ImPlotAxisFlags_NoTickLabels);
+		ImPlot::SetupAxis(ImAxis_Y1, axisLabel, ImPlotAxisFlags_LockMin | ImPlotAxisFlags_AutoFit);
+		if (secondAxisLabel)
+			ImPlot::SetupAxis(ImAxis_Y2, secondAxisLabel, ImPlotAxisFlags_LockMin | ImPlotAxisFlags_AutoFit | ImPlotAxisFlags_Opposite);
+
+		ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+		return true;
+	}
+
+	static void PlotData(const char* label, const ScrollingData& data)
+	{
+		if (data.Data.empty())
+			return;
+
+		ImPlot::PlotLine(label, &data.Data[0].x, &data.Data[0].y,
+			data.Data.size(), ImPlotLineFlags_None, data.Offset, sizeof(ImVec2));
+	}
+
+	static float ToMilliseconds(std::chrono::nanoseconds time)
+	{
+		return std::chrono::duration<float, std::milli>(time).count();
+	}
+
+private:
+	float m_history = 30.0f; // 30 seconds
+	float m_time = 0.0f;
+	bool m_paused = false;
+
+	uint32_t m_gameBenchmarks[lengthof(GameBenchmarks)] = {};
+
+	ScrollingData m_frameData;
+	ScrollingData m_mqData;
+	ScrollingData m_eqData;
+
+	std::chrono::steady_clock::time_point m_lastSample;
+	int m_framesSinceSample = 0;
+
+	std::map<std::string, std::unique_ptr<ScrollingData>> m_pluginData;
+	std::map<std::string, std::chrono::nanoseconds> m_pluginTotals;
+
+	std::map<std::string, std::unique_ptr<ScrollingData>> m_allocationData;
+	std::map<std::string, uint64_t> m_allocationTotals;
+
+	ScrollingData m_luaData;
+	std::chrono::nanoseconds m_lastLuaTotal = std::chrono::nanoseconds::zero();
+
+	ScrollingData m_macroData;
+	uint64_t m_lastCommandCount = 0;
+
+	ScrollingData m_pipeSentData;
+	ScrollingData m_pipeReceivedData;
+	uint64_t m_lastPipeSent = 0;
+	uint64_t m_lastPipeReceived = 0;
+};
+static PerformanceDashboard* s_performanceDashboard = nullptr;
+
+#pragma endregion
+
 #pragma region String Inspector
 
 class StringInspector : public ImGuiWindowBase
@@ -5518,6 +5985,9 @@ static void DeveloperTools_Initialize()
 	s_benchmarksInspector = new BenchmarksInspector();
 	DeveloperTools_RegisterMenuItem(s_benchmarksInspector, "Benchmarks", s_menuNameInspectors);
 
+	s_performanceDashboard = new PerformanceDashboard();
+	DeveloperTools_RegisterMenuItem(s_performanceDashboard, "Performance Dashboard", s_menuNameInspectors);
+
 	s_achievementsInspector = new AchievementsInspector();
 	DeveloperTools_RegisterMenuItem(s_achievementsInspector, "Achievements", s_menuNameInspectors);
 
@@ -5566,6 +6036,9 @@ static void DeveloperTools_Shutdown()
 	DeveloperTools_UnregisterMenuItem(s_benchmarksInspector);
 	delete s_benchmarksInspector; s_benchmarksInspector = nullptr;
 
+	DeveloperTools_UnregisterMenuItem(s_performanceDashboard);
+	delete s_performanceDashboard; s_performanceDashboard = nullptr;
+
 	DeveloperTools_UnregisterMenuItem(s_achievementsInspector);
 	delete s_achievementsInspector; s_achievementsInspector = nullptr;
 
@@ -21,6 +21,7 @@
 
 #include <mq/utils/Args.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <chrono>
 #include <utility>
@@ -194,6 +195,103 @@ private:
 	std::chrono::microseconds m_minDuration;
 };
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Sleeps until a deadline on a high resolution waitable timer, waking a little early and spinning
+// the rest of the way. How early is worked out from how late the timer has been waking up, so the
+// spin stays short. Falls back to a regular sleep where high resolution timers aren't available
+// (before Windows 10 1803).
+class FramePacer
+{
+	using hundred_ns = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+
+	// least and most time to leave for spinning
+	static constexpr std::chrono::microseconds MIN_SPIN_WINDOW = 100us;
+	static constexpr std::chrono::microseconds MAX_SPIN_WINDOW = 2000us;
+
+public:
+	FramePacer() = default;
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	~FramePacer()
+	{
+		if (m_timer)
+			::CloseHandle(m_timer);
+	}
+
+	bool IsHighResolution() const { return m_timer != nullptr; }
+
+	// running averages, in microseconds
+	float GetAverageOvershoot() const { return static_cast<float>(m_overshoot.Average()); }
+	float GetAverageSpin() const { return static_cast<float>(m_spin.Average()); }
+	float GetAverageLateness() const { return static_cast<float>(m_lateness.Average()); }
+
+	void SleepUntil(std::chrono::steady_clock::time_point deadline)
+	{
+		if (!m_timer && !m_timerFailed)
+		{
+			m_timer = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+			m_timerFailed = m_timer == nullptr;
+		}
+
+		if (!m_timer)
+		{
+			std::this_thread::sleep_until(deadline);
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (deadline <= now)
+			return;
+
+		// wake up early by how late the timer has been, plus a little to spare
+		const auto spinWindow = std::clamp(
+			std::chrono::microseconds(static_cast<int64_t>(m_overshoot.Average() * 1.5)) + MIN_SPIN_WINDOW,
+			MIN_SPIN_WINDOW, MAX_SPIN_WINDOW);
+
+		const auto wakeAt = deadline - spinWindow;
+		if (wakeAt > now)
+		{
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -std::chrono::duration_cast<hundred_ns>(wakeAt - now).count(); // negative for relative time
+
+			if (::SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+			{
+				::WaitForSingleObject(m_timer, INFINITE);
+
+				now = std::chrono::steady_clock::now();
+				m_overshoot.AddSample(std::max<int64_t>(
+					std::chrono::duration_cast<std::chrono::microseconds>(now - wakeAt).count(), 0));
+			}
+			else
+			{
+				std::this_thread::sleep_until(wakeAt);
+				now = std::chrono::steady_clock::now();
+			}
+		}
+
+		const auto spinStart = now;
+		while (now < deadline)
+		{
+			YieldProcessor();
+			now = std::chrono::steady_clock::now();
+		}
+
+		m_spin.AddSample(std::chrono::duration_cast<std::chrono::microseconds>(now - spinStart).count());
+		m_lateness.AddSample(std::chrono::duration_cast<std::chrono::microseconds>(now - deadline).count());
+	}
+
+private:
+	HANDLE m_timer = nullptr;
+	bool m_timerFailed = false;
+	FrameCounter m_overshoot;                // how late the timer woke up
+	FrameCounter m_spin;                     // how long was spent spinning
+	FrameCounter m_lateness;                 // how far past the deadline the wait returned
+};
+
 #pragma endregion
 
 #pragma region Detours
@@ -388,6 +486,7 @@ class FrameLimiter
 	CpuUsage m_cpuUsageCalc;
 	FrameCounter m_cpuUsage;
 	FrameThrottler m_frameThrottler;          // throttler for framerate
+	FramePacer m_framePacer;                  // precise sleeps for the main loop
 	std::chrono::steady_clock::time_point m_startTime;
 	std::chrono::steady_clock::time_point m_prevFrame;
 	std::chrono::microseconds m_gameLoopDuration = 0us;
@@ -400,6 +499,15 @@ class FrameLimiter
 	int m_updateDisplayCount = 0;
 	std::string m_characterIni;
 
+	// Main loop rate assigned by the launcher when it governs cpu across the host. Zero when it
+	// doesn't, and only applies in the background.
+	float m_hostSimulationFPS = 0.0f;
+	std::chrono::steady_clock::time_point m_hostBudgetExpires;
+
+	// With adaptive simulation, the last time something needed the game to respond quickly
+	std::chrono::steady_clock::time_point m_lastActivity;
+	bool m_simulationActive = true;
+
 	// Settings
 	bool m_enabled = false;
 	bool m_enabledInForeground = false;
@@ -409,9 +517,12 @@ class FrameLimiter
 	bool m_tieImGuiToSimulation = false;
 	bool m_tieUiToSimulation = false;
 	bool m_clearScreen = false;
+	bool m_adaptiveSimulation = false;
+	bool m_precisePacing = false;
 	float m_backgroundFPS = 1.0f;
 	float m_foregroundFPS = 60.0f;
 	float m_minSimulationFPS = 30.0f;
+	float m_idleSimulationFPS = 10.0f;
 
 public:
 	FrameLimiter() :
@@ -430,9 +541,12 @@ public:
 		m_tieImGuiToSimulation = GetSetting<bool, LimiterSetting::TieImGuiToSimulation>();
 		m_tieUiToSimulation = GetSetting<bool, LimiterSetting::TieUiToSimulation>();
 		m_clearScreen = GetSetting<bool, LimiterSetting::ClearScreen>();
+		m_adaptiveSimulation = GetSetting<bool, LimiterSetting::AdaptiveSimulation>();
+		m_precisePacing = GetSetting<bool, LimiterSetting::PrecisePacing>();
 		m_backgroundFPS = GetSetting<float, LimiterSetting::BackgroundFPS>();
 		m_foregroundFPS = GetSetting<float, LimiterSetting::ForegroundFPS>();
 		m_minSimulationFPS = GetSetting<float, LimiterSetting::MinSimulationFPS>();
+		m_idleSimulationFPS = GetSetting<float, LimiterSetting::IdleSimulationFPS>();
 
 		UpdateThrottler();
 	}
@@ -485,6 +599,41 @@ public:
 
 	float GetMinimumSimulationFPS() const { return m_minSimulationFPS; }
 
+	// The floor for the main loop rate. With adaptive simulation it drops to the idle rate while
+	// nothing needs the game to respond quickly.
+	float GetSimulationFloor() const
+	{
+		if (HasHostBudget())
+			return m_hostSimulationFPS;
+
+		if (m_adaptiveSimulation && !m_simulationActive)
+			return std::min(m_idleSimulationFPS, m_minSimulationFPS);
+
+		return m_minSimulationFPS;
+	}
+
+	bool IsSimulationIdle() const { return m_adaptiveSimulation && !m_simulationActive; }
+
+	// precise pacing spins for part of each frame, so it is only worth it in the foreground
+	bool IsPrecisePacing() const { return m_precisePacing && IsForeground(); }
+	const FramePacer& GetFramePacer() const { return m_framePacer; }
+
+	void NotifyActivity()
+	{
+		m_lastActivity = std::chrono::steady_clock::now();
+	}
+
+	bool HasHostBudget() const { return m_hostSimulationFPS > 0.f && IsBackground(); }
+	float GetHostSimulationFPS() const { return m_hostSimulationFPS; }
+
+	void SetHostBudget(float simulationFPS, std::chrono::milliseconds duration)
+	{
+		m_hostSimulationFPS = std::max(simulationFPS, 0.f);
+		m_hostBudgetExpires = std::chrono::steady_clock::now() + duration;
+
+		UpdateThrottler();
+	}
+
 	bool GetTieImGuiToSimulation() const { return m_tieImGuiToSimulation && IsBackground(); }
 	bool GetTieUiToSimulation() const { return m_tieUiToSimulation && GetTieImGuiToSimulation(); }
 
@@ -550,7 +699,10 @@ public:
 		//DebugSpewAlways("Sleep for: %d -- gameRemaining: %d -- frameRemaining: %d", (int)waitTime.count(),
 		//	(int)gameRemaining.count(), (int)frameRemaining.count());
 		//std::this_thread::sleep_for(waitTime);
-		std::this_thread::sleep_until(m_prevFrame + m_gameLoopDuration);
+		if (IsPrecisePacing())
+			m_framePacer.SleepUntil(m_prevFrame + m_gameLoopDuration);
+		else
+			std::this_thread::sleep_until(m_prevFrame + m_gameLoopDuration);
 		m_prevFrame += m_gameLoopDuration;
 
 		return true;
@@ -587,6 +739,16 @@ public:
 			|| m_updateDisplayCount >= 2;             // if this is the 2nd+ call this frame. This happens when logging out.
 	}
 
+	// Whether the scene that is ending now goes to the screen: the game rendered this frame, the
+	// limiter is presenting a frame of just ImGui, or the game's UI is being drawn on its own.
+	// Anything else that ends a scene is thrown away, so there's no point building ImGui for it.
+	bool IsPresentingFrame() const
+	{
+		return !IsEnabled() || m_doRender || m_renderingImGuiScene || GetTieUiToSimulation()
+			|| gGameState != GAMESTATE_INGAME
+			|| m_updateDisplayCount >= 2;
+	}
+
 	void PauseForZone()
 	{
 		m_pauseForZone = true;
@@ -602,6 +764,15 @@ public:
 		gCurrentFPS = static_cast<float>(1000000 / m_renderFPS.Average());
 		gCurrentCPU = static_cast<float>(m_cpuUsage.Average() / 1000.f);
 
+		// the launcher renews the budget with every report, so if it stops, so does the budget
+		if (m_hostSimulationFPS > 0.f && std::chrono::steady_clock::now() >= m_hostBudgetExpires)
+		{
+			m_hostSimulationFPS = 0.f;
+			UpdateThrottler();
+		}
+
+		UpdateSimulationActivity();
+
 #if HAS_DIRECTX_9
 		if (m_resetOnNextPulse)
 		{
@@ -636,6 +807,61 @@ public:
 		}
 	}
 
+	// Anything that needs the game to respond quickly keeps the simulation at its full rate for a
+	// little while after it stops.
+	static constexpr std::chrono::seconds ADAPTIVE_HOLD_TIME = std::chrono::seconds(3);
+
+	static bool IsLatencySensitive()
+	{
+		// a waiting /delay condition is checked every frame
+		if (gDelay && gDelayCondition[0])
+			return true;
+
+		if (IsMouseWaiting())
+			return true;
+
+		if (gGameState != GAMESTATE_INGAME || !pLocalPC)
+			return false;
+
+		const bool inCombat = (pEverQuestInfo && pEverQuestInfo->bAutoAttack)
+			|| (pPlayerWnd && pPlayerWnd->CombatState == eCombatState_Combat);
+
+		// a macro that is running its combat loop
+		if (inCombat && gMacroBlock && !gMacroBlock->Paused)
+			return true;
+
+		// anything on the extended target list that is hating on us
+		if (pLocalPC->pExtendedTargetList)
+		{
+			for (const ExtendedTargetSlot& xts : *pLocalPC->pExtendedTargetList)
+			{
+				if (xts.xTargetType == XTARGET_AUTO_HATER && xts.XTargetSlotStatus != eXTSlotEmpty && xts.SpawnID != 0)
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	void UpdateSimulationActivity()
+	{
+		if (!m_adaptiveSimulation)
+		{
+			if (mq::test_and_set(m_simulationActive, true))
+				UpdateThrottler();
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (IsLatencySensitive())
+			m_lastActivity = now;
+
+		if (mq::test_and_set(m_simulationActive, now - m_lastActivity < ADAPTIVE_HOLD_TIME))
+		{
+			UpdateThrottler();
+		}
+	}
+
 	void UpdateForegroundState()
 	{
 		UpdateThrottler();
@@ -647,11 +873,12 @@ public:
 	void UpdateThrottler()
 	{
 		float desiredRenderRate = m_lastInForeground ? m_foregroundFPS : m_backgroundFPS;
+		if (HasHostBudget()) desiredRenderRate = std::min(desiredRenderRate, m_hostSimulationFPS);
 		if (desiredRenderRate == 0.f) desiredRenderRate = 0.001f; // prevent division by zero if someone forces the render rate
 		m_frameThrottler.SetMinDuration(std::chrono::microseconds(static_cast<int64_t>(1000000 / desiredRenderRate)));
 
-		// Cap the main loop at a minimum of m_minSimulationFPS.
-		float desiredGameRate = std::max(m_minSimulationFPS, desiredRenderRate);
+		// Cap the main loop at a minimum of the simulation floor.
+		float desiredGameRate = std::max(GetSimulationFloor(), desiredRenderRate);
 		m_gameLoopDuration = std::chrono::microseconds(static_cast<int64_t>(1000000 / desiredGameRate));
 	}
 
@@ -671,6 +898,10 @@ public:
 			ImGui::TextColored(ImColor(255, 255, 0), "Inactive");
 
 		ImGui::Text("CPU Usage: %.2f%%", GetCPUUsage());
+		if (m_hostSimulationFPS > 0.f)
+		{
+			ImGui::Text("Launcher budget: %.1f FPS in the background", m_hostSimulationFPS);
+		}
 		ImGui::Columns(2, nullptr, false);
 		ImGui::Text("Render FPS: %.2f", GetRecordedRenderFPS());
 		ImGui::NextColumn();
@@ -794,6 +1025,33 @@ public:
 				WriteSetting<LimiterSetting::ForegroundFPS>(m_foregroundFPS);
 				UpdateThrottler();
 			}
+
+			if (ImGui::Checkbox("Precise frame pacing", &m_precisePacing))
+			{
+				WriteSetting<LimiterSetting::PrecisePacing>(m_precisePacing);
+			}
+			ImGui::SameLine(); mq::imgui::HelpMarker(
+				"This setting applies when frame limiting is active and the game is in the foreground.\n"
+				"\n"
+				"Waits for each frame on a high resolution timer and spins for the last moment, for "
+				"steadier frame times than a regular sleep gives. The spin is kept as short as the "
+				"timer allows.");
+
+			if (m_precisePacing)
+			{
+				ImGui::Indent();
+				if (m_framePacer.IsHighResolution())
+				{
+					ImGui::Text("Timer overshoot: %.0f us, spin: %.0f us, late by: %.0f us",
+						m_framePacer.GetAverageOvershoot(), m_framePacer.GetAverageSpin(), m_framePacer.GetAverageLateness());
+				}
+				else
+				{
+					ImGui::TextColored(ImColor(255, 255, 0), "High resolution timers are not in use");
+				}
+				ImGui::Unindent();
+			}
+
 			ImGui::Unindent(); 
 		}
 
@@ -824,6 +1082,40 @@ public:
 				UpdateThrottler();
 			}
 
+			if (ImGui::Checkbox("Lower simulation rate when idle", &m_adaptiveSimulation))
+			{
+				WriteSetting<LimiterSetting::AdaptiveSimulation>(m_adaptiveSimulation);
+				UpdateSimulationActivity();
+				UpdateThrottler();
+			}
+			ImGui::SameLine();
+			mq::imgui::HelpMarker(
+				"This setting applies when frame limiting is active.\n"
+				"\n"
+				"Drops the simulation rate to the idle rate while nothing needs the game to respond quickly, "
+				"and goes back to the minimum simulation rate above as soon as something does: a macro "
+				"running in combat, a /delay waiting on a condition, an incoming tell, anything hating on "
+				"you on the extended target list, or a mouse click in progress.");
+
+			if (m_adaptiveSimulation)
+			{
+				ImGui::Indent();
+
+				if (ImGui::SliderFloat("Idle FPS", &m_idleSimulationFPS, 1.0f, 120.0f))
+				{
+					WriteSetting<LimiterSetting::IdleSimulationFPS>(m_idleSimulationFPS);
+					UpdateThrottler();
+				}
+
+				ImGui::Text("Simulation is: "); ImGui::SameLine(0, 0);
+				if (IsSimulationIdle())
+					ImGui::TextColored(ImColor(255, 255, 0), "Idle");
+				else
+					ImGui::TextColored(ImColor(0, 255, 0), "Active");
+
+				ImGui::Unindent();
+			}
+
 			if (ImGui::Checkbox("Clear screen when not rendering", &m_clearScreen))
 			{
 				WriteSetting<LimiterSetting::ClearScreen>(m_clearScreen);
@@ -896,7 +1188,10 @@ private:
 		}
 
 		// Draw Hud
+		m_renderingImGuiScene = true;
 		gpD3D9Device->EndScene();
+		m_renderingImGuiScene = false;
+
 		gpD3D9Device->Present(nullptr, nullptr, nullptr, nullptr);
 	}
 
@@ -912,9 +1207,12 @@ public:
 		TieImGuiToSimulation,
 		TieUiToSimulation,
 		ClearScreen,
+		AdaptiveSimulation,
+		PrecisePacing,
 		BackgroundFPS,
 		ForegroundFPS,
-		MinSimulationFPS
+		MinSimulationFPS,
+		IdleSimulationFPS
 	};
 
 	template <LimiterSetting Value>
@@ -928,9 +1226,12 @@ public:
 	template <> static constexpr const char* SettingName<LimiterSetting::TieImGuiToSimulation>() { return "TieImGuiToSimulation"; }
 	template <> static constexpr const char* SettingName<LimiterSetting::TieUiToSimulation>() { return "TieUiToSimulation"; }
 	template <> static constexpr const char* SettingName<LimiterSetting::ClearScreen>() { return "ClearScreen"; }
+	template <> static constexpr const char* SettingName<LimiterSetting::AdaptiveSimulation>() { return "AdaptiveSimulation"; }
+	template <> static constexpr const char* SettingName<LimiterSetting::PrecisePacing>() { return "PrecisePacing"; }
 	template <> static constexpr const char* SettingName<LimiterSetting::BackgroundFPS>() { return "BackgroundFPS"; }
 	template <> static constexpr const char* SettingName<LimiterSetting::ForegroundFPS>() { return "ForegroundFPS"; }
 	template <> static constexpr const char* SettingName<LimiterSetting::MinSimulationFPS>() { return "MinSimulationFPS"; }
+	template <> static constexpr const char* SettingName<LimiterSetting::IdleSimulationFPS>() { return "IdleSimulationFPS"; }
 
 private:
 	template <typename T, LimiterSetting Value>
@@ -944,9 +1245,12 @@ private:
 	template <> static constexpr bool GetDefault<bool, LimiterSetting::TieImGuiToSimulation>() { return false; }
 	template <> static constexpr bool GetDefault<bool, LimiterSetting::TieUiToSimulation>() { return false; }
 	template <> static constexpr bool GetDefault<bool, LimiterSetting::ClearScreen>() { return false; }
+	template <> static constexpr bool GetDefault<bool, LimiterSetting::AdaptiveSimulation>() { return false; }
+	template <> static constexpr bool GetDefault<bool, LimiterSetting::PrecisePacing>() { return false; }
 	template <> static constexpr float GetDefault<float, LimiterSetting::BackgroundFPS>() { return 1.f; }
 	template <> static constexpr float GetDefault<float, LimiterSetting::ForegroundFPS>() { return 60.f; }
 	template <> static constexpr float GetDefault<float, LimiterSetting::MinSimulationFPS>() { return 30.f; }
+	template <> static constexpr float GetDefault<float, LimiterSetting::IdleSimulationFPS>() { return 10.f; }
 
 	std::string& GetINIFileName(LimiterSetting value)
 	{
@@ -1007,6 +1311,12 @@ private:
 		WriteSetting<LimiterSetting::ForegroundFPS>(m_foregroundFPS);
 		m_minSimulationFPS = GetDefault<float, LimiterSetting::MinSimulationFPS>();
 		WriteSetting<LimiterSetting::MinSimulationFPS>(m_minSimulationFPS);
+		m_adaptiveSimulation = GetDefault<bool, LimiterSetting::AdaptiveSimulation>();
+		WriteSetting<LimiterSetting::AdaptiveSimulation>(m_adaptiveSimulation);
+		m_idleSimulationFPS = GetDefault<float, LimiterSetting::IdleSimulationFPS>();
+		WriteSetting<LimiterSetting::IdleSimulationFPS>(m_idleSimulationFPS);
+		m_precisePacing = GetDefault<bool, LimiterSetting::PrecisePacing>();
+		WriteSetting<LimiterSetting::PrecisePacing>(m_precisePacing);
 	}
 
 	template <typename T, LimiterSetting Setting>
@@ -1048,6 +1358,8 @@ public:
 	template<> bool Set<LimiterSetting::RenderInForeground>(bool Value) { return InternalSet<bool, LimiterSetting::RenderInForeground>(m_renderInForeground, Value); }
 	template<> bool Set<LimiterSetting::TieImGuiToSimulation>(bool Value) { return InternalSet<bool, LimiterSetting::TieImGuiToSimulation>(m_tieImGuiToSimulation, Value); }
 	template<> bool Set<LimiterSetting::TieUiToSimulation>(bool Value) { return InternalSet<bool, LimiterSetting::TieUiToSimulation>(m_tieUiToSimulation, Value); }
+	template<> bool Set<LimiterSetting::AdaptiveSimulation>(bool Value) { return InternalSet<bool, LimiterSetting::AdaptiveSimulation>(m_adaptiveSimulation, Value); }
+	template<> bool Set<LimiterSetting::PrecisePacing>(bool Value) { return InternalSet<bool, LimiterSetting::PrecisePacing>(m_precisePacing, Value); }
 
 	template <LimiterSetting Setting>
 	bool Toggle() { return Set<Setting>(!GetSetting<bool, Setting>()); }
@@ -1057,6 +1369,7 @@ public:
 	template<> float Set<LimiterSetting::BackgroundFPS>(float Value) { return InternalSet<float, LimiterSetting::BackgroundFPS>(m_backgroundFPS, Value); }
 	template<> float Set<LimiterSetting::ForegroundFPS>(float Value) { return InternalSet<float, LimiterSetting::ForegroundFPS>(m_foregroundFPS, Value); }
 	template<> float Set<LimiterSetting::MinSimulationFPS>(float Value) { return InternalSet<float, LimiterSetting::MinSimulationFPS>(m_minSimulationFPS, Value); }
+	template<> float Set<LimiterSetting::IdleSimulationFPS>(float Value) { return InternalSet<float, LimiterSetting::IdleSimulationFPS>(m_idleSimulationFPS, Value); }
 };
 static FrameLimiter s_frameLimiter;
 
@@ -1105,6 +1418,32 @@ static void FrameLimiterSettings()
 	s_frameLimiter.UpdateSettingsPanel();
 }
 
+float GetFrameLimiterSimulationFPS()
+{
+	return s_frameLimiter.IsEnabled() ? s_frameLimiter.GetRecordedSimulationFPS() : gCurrentFPS;
+}
+
+void SetFrameLimiterHostBudget(float simulationFPS, std::chrono::milliseconds duration)
+{
+	s_frameLimiter.SetHostBudget(simulationFPS, duration);
+}
+
+// False when the limiter has rendering turned off for the window's current state.
+bool IsFrameLimiterRendering()
+{
+	return !s_frameLimiter.IsEnabled() || s_frameLimiter.IsRenderingEnabled();
+}
+
+bool IsFrameLimiterPresenting()
+{
+	return s_frameLimiter.IsPresentingFrame();
+}
+
+void NotifyFrameLimiterActivity()
+{
+	s_frameLimiter.NotifyActivity();
+}
+
 #pragma endregion
 
 #pragma region command
@@ -1201,6 +1540,12 @@ void FrameLimiterCommand(SPAWNINFO* pChar, char* szLine)
 
 	args::Command simfps(commands, "simfps", "sets the minimum FPS the simulation will run", SetFrameLimiterFloat<FrameLimiter::LimiterSetting::MinSimulationFPS>);
 
+	args::Command precisepacing(commands, "precisepacing", "set/toggle precise frame pacing in the foreground", SetFrameLimiterBool<FrameLimiter::LimiterSetting::PrecisePacing>);
+
+	args::Command adaptive(commands, "adaptive", "set/toggle lowering the simulation rate when idle", SetFrameLimiterBool<FrameLimiter::LimiterSetting::AdaptiveSimulation>);
+
+	args::Command idlesimfps(commands, "idlesimfps", "sets the FPS the simulation will run at when idle", SetFrameLimiterFloat<FrameLimiter::LimiterSetting::IdleSimulationFPS>);
+
 	args::Command reload(commands, "reloadsettings", "reload settings from ini", FrameLimiterReloadSettings);
 
 	MQ2HelpArgument h(commands);
@@ -1326,7 +1671,11 @@ enum class FrameLimiterTypeMembers
 	BackgroundFPS,
 	ForegroundFPS,
 	MinSimulationFPS,
-	ClearScreen
+	ClearScreen,
+	PrecisePacing,
+	TimerOvershoot,
+	PacingSpin,
+	PacingLateness,
 };
 
 MQ2FrameLimiterType::MQ2FrameLimiterType() : MQ2Type("framelimiter")
@@ -1341,6 +1690,10 @@ MQ2FrameLimiterType::MQ2FrameLimiterType() : MQ2Type("framelimiter")
 	ScopedTypeMember(FrameLimiterTypeMembers, ForegroundFPS);
 	ScopedTypeMember(FrameLimiterTypeMembers, MinSimulationFPS);
 	ScopedTypeMember(FrameLimiterTypeMembers, ClearScreen);
+	ScopedTypeMember(FrameLimiterTypeMembers, PrecisePacing);
+	ScopedTypeMember(FrameLimiterTypeMembers, TimerOvershoot);
+	ScopedTypeMember(FrameLimiterTypeMembers, PacingSpin);
+	ScopedTypeMember(FrameLimiterTypeMembers, PacingLateness);
 }
 
 bool MQ2FrameLimiterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -1402,6 +1755,27 @@ bool MQ2FrameLimiterType::GetMember(MQVarPtr VarPtr, const char* Member, char* I
 		Dest.Set(s_frameLimiter.GetClearScreen());
 		return true;
 
+	case FrameLimiterTypeMembers::PrecisePacing:
+		Dest.Type = pBoolType;
+		Dest.Set(s_frameLimiter.IsPrecisePacing() && s_frameLimiter.GetFramePacer().IsHighResolution());
+		return true;
+
+	// pacing averages are in milliseconds
+	case FrameLimiterTypeMembers::TimerOvershoot:
+		Dest.Type = pFloatType;
+		Dest.Set(s_frameLimiter.GetFramePacer().GetAverageOvershoot() / 1000.f);
+		return true;
+
+	case FrameLimiterTypeMembers::PacingSpin:
+		Dest.Type = pFloatType;
+		Dest.Set(s_frameLimiter.GetFramePacer().GetAverageSpin() / 1000.f);
+		return true;
+
+	case FrameLimiterTypeMembers::PacingLateness:
+		Dest.Type = pFloatType;
+		Dest.Set(s_frameLimiter.GetFramePacer().GetAverageLateness() / 1000.f);
+		return true;
+
 	default:
 		return false;
 	}
@@ -0,0 +1,142 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include "mq/api/GameSnapshot.h"
+
+namespace mq {
+
+static void GameSnapshot_Pulse();
+
+// Modules pulse before plugins do, so every plugin sees this frame's snapshot.
+static MQModule s_gameSnapshotModule = {
+	"GameSnapshot",                // Name
+	false,                         // CanUnload
+	nullptr,
+	nullptr,
+	GameSnapshot_Pulse,
+};
+DECLARE_MODULE_INITIALIZER(s_gameSnapshotModule);
+
+static MQGameSnapshot s_snapshot = {};
+
+static int GetPercent(int64_t current, int64_t max)
+{
+	return max > 0 ? static_cast<int>(current * 100 / max) : 0;
+}
+
+static void FillSpawnSnapshot(MQSpawnSnapshot& snapshot, SPAWNINFO* pSpawn)
+{
+	snapshot = {};
+
+	if (!pSpawn)
+		return;
+
+	snapshot.Valid = true;
+	snapshot.Dead = pSpawn->StandState == STANDSTATE_DEAD;
+	snapshot.SpawnID = pSpawn->SpawnID;
+	strcpy_s(snapshot.Name, pSpawn->Name);
+	snapshot.Level = pSpawn->Level;
+	snapshot.Class = pSpawn->GetClass();
+	snapshot.Type = GetSpawnType(pSpawn);
+	snapshot.X = pSpawn->X;
+	snapshot.Y = pSpawn->Y;
+	snapshot.Z = pSpawn->Z;
+	snapshot.Heading = pSpawn->Heading * 0.703125f;
+	snapshot.Distance = pControlledPlayer ? GetDistance(pSpawn->X, pSpawn->Y) : 0.0f;
+	snapshot.PctHPs = GetPercent(pSpawn->HPCurrent, pSpawn->HPMax);
+	snapshot.PctMana = GetPercent(pSpawn->GetCurrentMana(), pSpawn->GetMaxMana());
+	snapshot.PctEndurance = GetPercent(pSpawn->GetCurrentEndurance(), pSpawn->GetMaxEndurance());
+}
+
+static void GameSnapshot_Pulse()
+{
+	const uint64_t frame = s_snapshot.Frame + 1;
+	s_snapshot = {};
+	s_snapshot.Frame = frame;
+
+	if (gGameState != GAMESTATE_INGAME || !pLocalPC || !pLocalPlayer)
+		return;
+
+	s_snapshot.InGame = true;
+
+	FillSpawnSnapshot(s_snapshot.Self, pLocalPlayer);
+	s_snapshot.CurrentHPs = GetCurHPS();
+	s_snapshot.MaxHPs = GetMaxHPS();
+	s_snapshot.CurrentEndurance = GetCurEndurance();
+	s_snapshot.MaxEndurance = GetMaxEndurance();
+	s_snapshot.CurrentMana = GetCurMana();
+	s_snapshot.MaxMana = GetMaxMana();
+	s_snapshot.ZoneID = pLocalPC->zoneId;
+
+	FillSpawnSnapshot(s_snapshot.Target, pTarget);
+
+	if (pLocalPC->Group)
+	{
+		for (int i = 1; i < MAX_GROUP_SIZE; ++i)
+		{
+			CGroupMember* pMember = pLocalPC->Group->GetGroupMember(i);
+			if (!pMember)
+				continue;
+
+			MQSpawnSnapshot& member = s_snapshot.Group[s_snapshot.GroupCount++];
+			FillSpawnSnapshot(member, pMember->GetPlayer());
+
+			// Members out of zone have no spawn, but are still worth listing by name.
+			if (!member.Valid)
+				strcpy_s(member.Name, pMember->GetName());
+		}
+	}
+
+	if (pLocalPC->pExtendedTargetList)
+	{
+		for (const ExtendedTargetSlot& xts : *pLocalPC->pExtendedTargetList)
+		{
+			if (s_snapshot.XTargetCount >= MAX_SNAPSHOT_XTARGETS)
+				break;
+
+			if (xts.XTargetSlotStatus == eXTSlotEmpty || xts.SpawnID == 0)
+				continue;
+
+			SPAWNINFO* pSpawn = GetSpawnByID(xts.SpawnID);
+			if (!pSpawn)
+				continue;
+
+			FillSpawnSnapshot(s_snapshot.XTargets[s_snapshot.XTargetCount++], pSpawn);
+		}
+	}
+
+	if (PcProfile* pProfile = GetPcProfile())
+	{
+		for (int i = 0; i < MAX_SNAPSHOT_BUFFS; ++i)
+		{
+			const EQ_Affect& affect = pProfile->GetEffect(i);
+			if (affect.SpellID <= 0)
+				continue;
+
+			s_snapshot.Buffs[i].SpellID = affect.SpellID;
+			s_snapshot.Buffs[i].Duration = affect.Duration;
+			++s_snapshot.BuffCount;
+		}
+	}
+}
+
+const MQGameSnapshot& GetGameSnapshot()
+{
+	return s_snapshot;
+}
+
+} // namespace mq
@@ -121,9 +121,17 @@ MQEventList* pEventList = nullptr;
 
 DWORD gEventChat = 0;
 uint64_t gRunning = 0;
+uint32_t gPulseCount = 0;
 bool gbMoving = false;
 int gMaxTurbo = 80;
 int gTurboLimit = 240;
+int gTurboBudget = 0;
+int gDefaultTurboBudget = 0;
+int gSlowPluginCallbackTime = 0;
+bool gbTrackAllocations = false;
+bool gbPeerRouting = false;
+bool gbSharedSpawns = false;
+int gSharedSpawnRate = 4;
 bool gReturn = true;
 bool gTargetbuffs = false;
 bool gItemsReceived = false;
@@ -238,6 +246,7 @@ ITEMDB* gItemDB = nullptr;
 bool bRunNextCommand = false;
 bool gTurbo = false;
 bool gWarning = false;
+bool gLazyConditions = false;
 MQDefine* pDefines = nullptr;
 MQBindList* pBindList = nullptr;
 char gLastFindSlot[MAX_STRING] = { 0 };
@@ -255,6 +264,13 @@ EQSwitch* pDoorTarget = nullptr;
 // Alternatively, move it into the macro block.
 int gParserVersion = 1;
 
+// Macro variables are only modified on the main thread. When set, the main thread looks them up
+// without taking the variable lock.
+bool gbLockFreeVariableReads = true;
+
+// When set, spawns are only sorted by distance in pulses where something asks for them.
+bool gbLazySpawnSort = true;
+
 // EQ Functions Initialization
 fEQCommand cmdHelp = nullptr;
 fEQCommand cmdWho = nullptr;
@@ -736,6 +752,7 @@ bool bAllErrorsDumpStack = true;
 bool bAllErrorsLog = false;
 bool gbHUDUnderUI = true;
 bool gbAlwaysDrawMQHUD = false;
+bool gbHUDOverlay = false;
 bool gbMQ2LoadingMsg = true;
 bool gbExactSearchCleanNames = false;
 
@@ -150,9 +150,17 @@ MQLIB_VAR uintptr_t DrawHUDParams[4];
 
 MQLIB_VAR DWORD gEventChat;
 MQLIB_VAR uint64_t gRunning;
+MQLIB_VAR uint32_t gPulseCount;                 // incremented at the start of every pulse, for caches that refresh once per frame
 MQLIB_VAR bool gbMoving;
 MQLIB_VAR int gMaxTurbo;
 MQLIB_VAR int gTurboLimit;
+MQLIB_VAR int gTurboBudget;                    // microseconds per frame the running macro may use, 0 to count lines
+MQLIB_VAR int gDefaultTurboBudget;
+MQLIB_VAR int gSlowPluginCallbackTime;         // milliseconds a plugin callback may take before it is reported, 0 to never
+MQLIB_VAR bool gbTrackAllocations;             // count heap allocations per module and per benchmark
+MQLIB_VAR bool gbPeerRouting;                  // send mail for a single client straight to it instead of through the launcher
+MQLIB_VAR bool gbSharedSpawns;                 // share one client's view of the spawns with the others in the same zone
+MQLIB_VAR int gSharedSpawnRate;                // updates per second sent by the client sharing its spawns
 
 MQLIB_VAR bool gReturn;
 MQLIB_VAR bool gTargetbuffs;
@@ -186,6 +194,7 @@ MQLIB_VAR bool gbInForeground;
 
 MQLIB_VAR bool gbHUDUnderUI;
 MQLIB_VAR bool gbAlwaysDrawMQHUD;
+MQLIB_VAR bool gbHUDOverlay;
 
 
 MQLIB_VAR char gIfDelimiter;
@@ -231,6 +240,7 @@ MQLIB_VAR bool bRunNextCommand;
 MQLIB_VAR bool bAllowCommandParse;
 MQLIB_VAR bool gTurbo;
 MQLIB_VAR bool gWarning;
+MQLIB_VAR bool gLazyConditions;               // #lazyconditions: && and || in /if and /while stop at the first deciding operand
 MQLIB_VAR MQDefine* pDefines;
 MQLIB_VAR MQBindList* pBindList;
 MQLIB_VAR MQFilter* gpFilters;
@@ -327,6 +337,8 @@ const std::string PARSE_PARAM_BEG = "${Parse[";
 const std::string PARSE_PARAM_END = "]}";
 
 MQLIB_VAR int gParserVersion;
+MQLIB_VAR bool gbLockFreeVariableReads;
+MQLIB_VAR bool gbLazySpawnSort;
 
 /* DEPRECATION GLOBALS */
 MQLIB_VAR int gbGroundDeprecateCount;
@@ -29,6 +29,253 @@ static MQModule s_GroundSpawnsModule = {
 };
 MQModule* GetGroundSpawnsModule() { return &s_GroundSpawnsModule; }
 
+#pragma region Ground Spawn Index
+//----------------------------------------------------------------------------
+// Ground items don't move, so their friendly names and grid cells are worked out once after they
+// are added and searches only look at the cells around the player. The grid uses the same cells as
+// the spawn grid. Placed items can be moved by their owner, so they are still checked every time
+// and only their names are kept.
+//----------------------------------------------------------------------------
+
+static CXStr LookupFriendlyNameForGroundItem(const EQGroundItem* pItem);
+static CXStr LookupFriendlyNameForPlacedItem(const EQPlacedItem* pItem, bool* pResolved);
+
+class GroundSpawnIndex
+{
+	struct Entry
+	{
+		int64_t Cell;
+		EQGroundItem* pItem;
+
+		bool operator<(const Entry& other) const { return Cell < other.Cell; }
+	};
+
+	struct PlacedName
+	{
+		int RealEstateID;
+		int RealEstateItemID;
+		CXStr Name;
+	};
+
+	// Sorted by row then column, so each row of a query is one contiguous range
+	std::vector<Entry> m_entries;
+
+	// Ground items added since the last query, their names and cells haven't been worked out yet
+	std::vector<EQGroundItem*> m_unindexed;
+
+	std::unordered_map<const EQGroundItem*, CXStr> m_groundNames;
+	std::unordered_map<const EQPlacedItem*, PlacedName> m_placedNames;
+
+	// only ever grows until the index is cleared, which just makes some rings come back empty
+	int m_minX = INT_MAX, m_maxX = INT_MIN;
+	int m_minY = INT_MAX, m_maxY = INT_MIN;
+	bool m_built = false;
+
+	static int GetCellCoord(float value)
+	{
+		return static_cast<int>(std::floor(value / SPAWN_GRID_CELL_SIZE));
+	}
+
+	static int64_t GetCell(int cellX, int cellY)
+	{
+		return static_cast<int64_t>(cellY) * 0x100000000LL + (static_cast<int64_t>(cellX) + 0x80000000LL);
+	}
+
+	void GatherRow(int cellY, int minX, int maxX, std::vector<EQGroundItem*>& items) const
+	{
+		if (cellY < m_minY || cellY > m_maxY)
+			return;
+
+		minX = std::max(minX, m_minX);
+		maxX = std::min(maxX, m_maxX);
+		if (minX > maxX)
+			return;
+
+		auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), Entry{ GetCell(minX, cellY), nullptr });
+		const int64_t last = GetCell(maxX, cellY);
+
+		for (; iter != m_entries.end() && iter->Cell <= last; ++iter)
+			items.push_back(iter->pItem);
+	}
+
+	void Update()
+	{
+		if (!m_built)
+		{
+			if (!pItemList)
+				return;
+
+			// everything on the ground when we first look goes through the same path as new items
+			for (EQGroundItem* pItem = pItemList->Top; pItem; pItem = pItem->pNext)
+				m_unindexed.push_back(pItem);
+
+			m_built = true;
+		}
+
+		if (m_unindexed.empty())
+			return;
+
+		for (EQGroundItem* pItem : m_unindexed)
+		{
+			const int cellX = GetCellCoord(pItem->X);
+			const int cellY = GetCellCoord(pItem->Y);
+
+			m_minX = std::min(m_minX, cellX);
+			m_maxX = std::max(m_maxX, cellX);
+			m_minY = std::min(m_minY, cellY);
+			m_maxY = std::max(m_maxY, cellY);
+
+			m_entries.push_back({ GetCell(cellX, cellY), pItem });
+			m_groundNames[pItem] = LookupFriendlyNameForGroundItem(pItem);
+		}
+
+		m_unindexed.clear();
+		std::sort(m_entries.begin(), m_entries.end());
+	}
+
+public:
+	void Clear()
+	{
+		m_entries.clear();
+		m_unindexed.clear();
+		m_groundNames.clear();
+		m_placedNames.clear();
+		m_minX = m_minY = INT_MAX;
+		m_maxX = m_maxY = INT_MIN;
+		m_built = false;
+	}
+
+	void Add(EQGroundItem* pItem)
+	{
+		// names are looked up on the next query, the item isn't always filled in yet when it is added
+		if (m_built)
+			m_unindexed.push_back(pItem);
+	}
+
+	void Remove(EQGroundItem* pItem)
+	{
+		if (!m_built)
+			return;
+
+		m_entries.erase(
+			std::remove_if(m_entries.begin(), m_entries.end(),
+				[pItem](const Entry& entry) { return entry.pItem == pItem; }),
+			m_entries.end());
+
+		m_unindexed.erase(std::remove(m_unindexed.begin(), m_unindexed.end(), pItem), m_unindexed.end());
+		m_groundNames.erase(pItem);
+	}
+
+	// Calls func(pItem, name) for every ground item.
+	template <typename Func>
+	void ForEachGroundItem(Func&& func)
+	{
+		Update();
+
+		for (const Entry& entry : m_entries)
+			func(entry.pItem, m_groundNames[entry.pItem]);
+	}
+
+	// Returns nullptr for ground items the index doesn't know about.
+	const CXStr* FindName(const EQGroundItem* pItem)
+	{
+		Update();
+
+		auto iter = m_groundNames.find(pItem);
+		return iter != m_groundNames.end() ? &iter->second : nullptr;
+	}
+
+	CXStr GetName(const EQPlacedItem* pItem)
+	{
+		auto iter = m_placedNames.find(pItem);
+		if (iter != m_placedNames.end()
+			&& iter->second.RealEstateID == pItem->RealEstateID
+			&& iter->second.RealEstateItemID == pItem->RealEstateItemID)
+		{
+			return iter->second.Name;
+		}
+
+		// the real estate items can show up after the placed items, so made up names aren't kept
+		bool resolved = false;
+		CXStr name = LookupFriendlyNameForPlacedItem(pItem, &resolved);
+		if (resolved)
+			m_placedNames[pItem] = PlacedName{ pItem->RealEstateID, pItem->RealEstateItemID, name };
+
+		return name;
+	}
+
+	// Rings before this one don't have any ground items in them.
+	int GetFirstRing(float X, float Y)
+	{
+		Update();
+
+		if (m_entries.empty())
+			return 0;
+
+		const int centerX = GetCellCoord(X);
+		const int centerY = GetCellCoord(Y);
+
+		return std::max({ m_minX - centerX, centerX - m_maxX, m_minY - centerY, centerY - m_maxY, 0 });
+	}
+
+	// Ring 0 is the cell X,Y is in and each ring after it the cells one further out. Returns false
+	// once the ring covers every ground item.
+	bool GatherRing(float X, float Y, int Ring, std::vector<EQGroundItem*>& items)
+	{
+		Update();
+
+		if (m_entries.empty())
+			return false;
+
+		const int centerX = GetCellCoord(X);
+		const int centerY = GetCellCoord(Y);
+
+		if (Ring == 0)
+		{
+			GatherRow(centerY, centerX, centerX, items);
+		}
+		else
+		{
+			GatherRow(centerY - Ring, centerX - Ring, centerX + Ring, items);
+			GatherRow(centerY + Ring, centerX - Ring, centerX + Ring, items);
+
+			for (int cellY = centerY - Ring + 1; cellY < centerY + Ring; ++cellY)
+			{
+				GatherRow(cellY, centerX - Ring, centerX - Ring, items);
+				GatherRow(cellY, centerX + Ring, centerX + Ring, items);
+			}
+		}
+
+		return !(centerX - Ring <= m_minX && centerX + Ring >= m_maxX
+			&& centerY - Ring <= m_minY && centerY + Ring >= m_maxY);
+	}
+};
+
+static GroundSpawnIndex s_groundSpawnIndex;
+
+void AddGroundSpawnToIndex(EQGroundItem* pItem)
+{
+	s_groundSpawnIndex.Add(pItem);
+}
+
+void RemoveGroundSpawnFromIndex(EQGroundItem* pItem)
+{
+	s_groundSpawnIndex.Remove(pItem);
+}
+
+static float GetGroundItemDistanceSquared(SPAWNINFO* pSpawn, const EQGroundItem* pGround)
+{
+	return Get3DDistanceSquared(pSpawn->X, pSpawn->Y, pSpawn->Z, pGround->X, pGround->Y,
+		pGround->pActor ? pGround->pActor->GetPosition().Z : pGround->Z); // why pActor?
+}
+
+static float GetPlacedItemDistanceSquared(SPAWNINFO* pSpawn, const EQPlacedItem* pPlaced)
+{
+	return Get3DDistanceSquared(pSpawn->X, pSpawn->Y, pSpawn->Z, pPlaced->X, pPlaced->Y, pPlaced->Z);
+}
+
+#pragma endregion
+
 class GroundSpawnSearch
 {
 private:
@@ -37,8 +284,28 @@ private:
 	std::vector<MQGroundSpawn>::iterator m_currentResult;
 	bool m_valid;
 
+	// Searches for the nearest ground spawns only find as many as were asked for. The rest of the
+	// list is filled in from this spawn the first time something past them is needed.
+	SPAWNINFO* m_nearestOrigin = nullptr;
+
 	GroundSpawnSearch() : m_searchResults(), m_currentResult(m_searchResults.end()), m_valid(false) {}
 
+	bool IsComplete() const { return m_nearestOrigin == nullptr; }
+
+	void Complete()
+	{
+		if (IsComplete())
+			return;
+
+		SPAWNINFO* pSpawn = m_nearestOrigin;
+		const auto current = std::distance(m_searchResults.begin(), m_currentResult);
+
+		Filter(pSpawn);
+		Sort(pSpawn);
+
+		m_currentResult = m_searchResults.begin() + std::min<ptrdiff_t>(current, m_searchResults.size());
+	}
+
 public:
 	GroundSpawnSearch(const GroundSpawnSearch&) = delete;
 	GroundSpawnSearch& operator=(const GroundSpawnSearch&) = delete;
@@ -53,6 +320,7 @@ public:
 	{
 		Instance().m_searchResults.clear();
 		Instance().m_currentResult = Instance().m_searchResults.end();
+		Instance().m_nearestOrigin = nullptr;
 		Instance().m_valid = false;
 	}
 
@@ -105,23 +373,31 @@ public:
 		return Instance();
 	}
 
+	// Same as Search(pSpawn), but only the first Count results are looked for until more are needed.
+	static GroundSpawnSearch& SearchNearest(SPAWNINFO* pSpawn, size_t Count)
+	{
+		if (!Instance().m_valid)
+			Instance().FilterNearest(pSpawn, Count);
+
+		return Instance();
+	}
+
 	template <typename GroundPred, typename PlacedPred>
 	void Filter(SPAWNINFO* pSpawn, GroundPred GroundPredicate, PlacedPred PlacedPredicate)
 	{
 		m_searchResults.clear();
+		m_nearestOrigin = nullptr;
 
-		if (pItemList)
-		{
-			for (auto pGround = pItemList->Top; pGround; pGround = pGround->pNext)
+		s_groundSpawnIndex.ForEachGroundItem(
+			[&](EQGroundItem* pGround, const CXStr& name)
 			{
 				// z filters are universal
 				if (gZFilter < 10000.f && (pGround->Z > pSpawn->Z + gZFilter || pGround->Z < pSpawn->Z - gZFilter))
-					continue;
+					return;
 
-				if (GroundPredicate(pGround))
+				if (GroundPredicate(pGround, name))
 					m_searchResults.emplace_back(pGround);
-			}
-		}
+			});
 
 		const auto& placed_item_mgr = EQPlacedItemManager::Instance();
 		for (auto pPlaced = placed_item_mgr.Top; pPlaced; pPlaced = pPlaced->pNext)
@@ -140,7 +416,7 @@ public:
 	void Filter(SPAWNINFO* pSpawn, int ID)
 	{
 		Filter(pSpawn,
-			[&ID](EQGroundItem* ground)
+			[&ID](EQGroundItem* ground, const CXStr&)
 			{
 				return ground->DropID == ID;
 			},
@@ -159,13 +435,13 @@ public:
 		else
 		{
 			Filter(pSpawn,
-				[&Name](EQGroundItem* ground)
+				[&Name](EQGroundItem*, const CXStr& name)
 				{
-					return ci_find_substr(GetFriendlyNameForGroundItem(ground), Name) >= 0;
+					return ci_find_substr(name, Name) >= 0;
 				},
 				[&Name](EQPlacedItem* placed)
 				{
-					return ci_find_substr(GetFriendlyNameForPlacedItem(placed), Name) >= 0;
+					return ci_find_substr(s_groundSpawnIndex.GetName(placed), Name) >= 0;
 				});
 		}
 	}
@@ -173,7 +449,7 @@ public:
 	void Filter(SPAWNINFO* pSpawn, const MQGroundSpawn& groundSpawn)
 	{
 		Filter(pSpawn,
-			[&groundSpawn](EQGroundItem* ground)
+			[&groundSpawn](EQGroundItem* ground, const CXStr&)
 			{
 				return ground == groundSpawn;
 			},
@@ -185,33 +461,108 @@ public:
 
 	void Filter(SPAWNINFO* pSpawn)
 	{
-		Filter(pSpawn, [](EQGroundItem*) { return true; }, [](EQPlacedItem*) { return true; });
+		Filter(pSpawn, [](EQGroundItem*, const CXStr&) { return true; }, [](EQPlacedItem*) { return true; });
+	}
+
+	void FilterNearest(SPAWNINFO* pSpawn, size_t Count)
+	{
+		struct Candidate
+		{
+			float Distance;
+			EQGroundItem* pGround;
+			EQPlacedItem* pPlaced;
+		};
+
+		std::vector<Candidate> candidates;
+
+		const auto& placed_item_mgr = EQPlacedItemManager::Instance();
+		for (auto pPlaced = placed_item_mgr.Top; pPlaced; pPlaced = pPlaced->pNext)
+		{
+			if (gZFilter < 10000.f && (pPlaced->Z > pSpawn->Z + gZFilter || pPlaced->Z < pSpawn->Z - gZFilter))
+				continue;
+
+			candidates.push_back({ GetPlacedItemDistanceSquared(pSpawn, pPlaced), nullptr, pPlaced });
+		}
+
+		// Walk out ring by ring until enough have been found closer than anything in the rings
+		// that haven't been looked at yet.
+		std::vector<EQGroundItem*> ring;
+		bool searchedAll = false;
+		for (int Ring = s_groundSpawnIndex.GetFirstRing(pSpawn->X, pSpawn->Y); ; ++Ring)
+		{
+			ring.clear();
+			const bool more = s_groundSpawnIndex.GatherRing(pSpawn->X, pSpawn->Y, Ring, ring);
+
+			for (EQGroundItem* pGround : ring)
+			{
+				if (gZFilter < 10000.f && (pGround->Z > pSpawn->Z + gZFilter || pGround->Z < pSpawn->Z - gZFilter))
+					continue;
+
+				candidates.push_back({ GetGroundItemDistanceSquared(pSpawn, pGround), pGround, nullptr });
+			}
+
+			if (!more)
+			{
+				searchedAll = true;
+				break;
+			}
+
+			const float seen = Ring * SPAWN_GRID_CELL_SIZE;
+			const size_t found = std::count_if(candidates.begin(), candidates.end(),
+				[seen](const Candidate& candidate) { return candidate.Distance <= seen * seen; });
+			if (found >= Count)
+				break;
+		}
+
+		const size_t found = std::min(Count, candidates.size());
+		std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end(),
+			[](const Candidate& a, const Candidate& b) { return a.Distance < b.Distance; });
+
+		m_searchResults.clear();
+		for (size_t i = 0; i < found; ++i)
+		{
+			if (candidates[i].pGround)
+				m_searchResults.emplace_back(candidates[i].pGround);
+			else
+				m_searchResults.emplace_back(candidates[i].pPlaced);
+		}
+
+		// if everything was looked at and kept there's nothing left to fill in
+		m_nearestOrigin = searchedAll && found == candidates.size() ? nullptr : pSpawn;
+		m_currentResult = m_searchResults.begin();
+		m_valid = true;
 	}
 
 	void Sort(SPAWNINFO* pSpawn)
 	{
-		DistanceSort(pSpawn, m_searchResults,
-			[](SPAWNINFO* pSpawn, const MQGroundSpawn& ground)
+		// work out each distance once instead of for every comparison
+		std::vector<std::pair<float, MQGroundSpawn>> sorted;
+		sorted.reserve(m_searchResults.size());
+
+		for (MQGroundSpawn& ground : m_searchResults)
+		{
+			// if the object isn't valid or is nullptr, then stick them at the end of the list
+			float distance = std::numeric_limits<float>::max();
+
+			if (ground.Type == MQGroundSpawnType::Ground)
 			{
-				if (ground)
-				{
-					if (ground.Type == MQGroundSpawnType::Ground)
-					{
-						auto& pGround = *std::get<EQGroundItemPtr>(ground.Object);
-						if (pGround)
-							return Get3DDistanceSquared(pSpawn->X, pSpawn->Y, pSpawn->Z, pGround->X, pGround->Y, pGround->pActor->GetPosition().Z); // why pActor?
-					}
-					else if (ground.Type == MQGroundSpawnType::Placed)
-					{
-						auto& pPlaced = *std::get<EQPlacedItemPtr>(ground.Object);
-						if (pPlaced)
-							return Get3DDistanceSquared(pSpawn->X, pSpawn->Y, pSpawn->Z, pPlaced->X, pPlaced->Y, pPlaced->Z);
-					}
-				}
-
-				// if the object isn't valid or is nullptr, then stick them at the end of the list
-				return std::numeric_limits<float>::max();
-			});
+				if (EQGroundItem* pGround = ground.Get<EQGroundItem>())
+					distance = GetGroundItemDistanceSquared(pSpawn, pGround);
+			}
+			else if (ground.Type == MQGroundSpawnType::Placed)
+			{
+				if (EQPlacedItem* pPlaced = ground.Get<EQPlacedItem>())
+					distance = GetPlacedItemDistanceSquared(pSpawn, pPlaced);
+			}
+
+			sorted.emplace_back(distance, std::move(ground));
+		}
+
+		std::stable_sort(sorted.begin(), sorted.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+
+		for (size_t i = 0; i < sorted.size(); ++i)
+			m_searchResults[i] = std::move(sorted[i].second);
 
 		m_currentResult = m_searchResults.begin();
 	}
@@ -235,6 +586,8 @@ public:
 
 	MQGroundSpawn Last()
 	{
+		Complete();
+
 		if (m_searchResults.empty())
 			return MQGroundSpawn();
 
@@ -244,6 +597,9 @@ public:
 
 	MQGroundSpawn Next()
 	{
+		if (!m_searchResults.empty() && m_currentResult == std::prev(m_searchResults.end()))
+			Complete();
+
 		if (m_searchResults.empty() || m_currentResult == std::prev(m_searchResults.end()))
 			return MQGroundSpawn();
 
@@ -263,6 +619,9 @@ public:
 
 	MQGroundSpawn At(size_t Idx)
 	{
+		if (Idx >= m_searchResults.size())
+			Complete();
+
 		if (Idx >= m_searchResults.size())
 			return MQGroundSpawn();
 
@@ -271,13 +630,44 @@ public:
 
 	int Count()
 	{
+		Complete();
+
 		return static_cast<int>(m_searchResults.size());
 	}
+
+	// Counts the ground spawns matching Name without keeping or sorting them.
+	static int CountByName(SPAWNINFO* pSpawn, std::string_view Name)
+	{
+		int count = 0;
+
+		s_groundSpawnIndex.ForEachGroundItem(
+			[&](EQGroundItem* pGround, const CXStr& name)
+			{
+				if (gZFilter < 10000.f && (pGround->Z > pSpawn->Z + gZFilter || pGround->Z < pSpawn->Z - gZFilter))
+					return;
+
+				if (Name.empty() || ci_find_substr(name, Name) >= 0)
+					++count;
+			});
+
+		const auto& placed_item_mgr = EQPlacedItemManager::Instance();
+		for (auto pPlaced = placed_item_mgr.Top; pPlaced; pPlaced = pPlaced->pNext)
+		{
+			if (gZFilter < 10000.f && (pPlaced->Z > pSpawn->Z + gZFilter || pPlaced->Z < pSpawn->Z - gZFilter))
+				continue;
+
+			if (Name.empty() || ci_find_substr(s_groundSpawnIndex.GetName(pPlaced), Name) >= 0)
+				++count;
+		}
+
+		return count;
+	}
 };
 
 static void SetGameStateGroundSpawns(DWORD)
 {
 	GroundSpawnSearch::Reset();
+	s_groundSpawnIndex.Clear();
 }
 
 MQGroundSpawn GetGroundSpawnByName(std::string_view Name)
@@ -295,24 +685,24 @@ MQGroundSpawn GetGroundSpawnByID(int ID)
 MQGroundSpawn GetNearestGroundSpawn()
 {
 	GroundSpawnSearch::Reset();
-	return GroundSpawnSearch::Search(pControlledPlayer).First();
+	return GroundSpawnSearch::SearchNearest(pControlledPlayer, 1).First();
 }
 
 MQGroundSpawn GetNthGroundSpawnFromMe(size_t N)
 {
-	return GroundSpawnSearch::Search(pControlledPlayer).At(N);
+	return GroundSpawnSearch::SearchNearest(pControlledPlayer, N + 1).At(N);
 }
 
 int GetGroundSpawnCount()
 {
 	GroundSpawnSearch::Reset();
-	return GroundSpawnSearch::Search(pControlledPlayer).Count();
+	return GroundSpawnSearch::CountByName(pControlledPlayer, {});
 }
 
 int GetGroundSpawnCountByName(std::string_view Name)
 {
 	GroundSpawnSearch::Reset();
-	return GroundSpawnSearch::Search(pControlledPlayer, Name).Count();
+	return GroundSpawnSearch::CountByName(pControlledPlayer, Name);
 }
 
 MQGroundSpawn CurrentGroundSpawn()
@@ -449,6 +839,14 @@ CXStr GetFriendlyNameForGroundItem(const EQGroundItem* pItem)
 	if (!pItem)
 		return CXStr();
 
+	if (const CXStr* name = s_groundSpawnIndex.FindName(pItem))
+		return *name;
+
+	return LookupFriendlyNameForGroundItem(pItem);
+}
+
+static CXStr LookupFriendlyNameForGroundItem(const EQGroundItem* pItem)
+{
 	int item_def = GetIntFromString(&pItem->Name[2], 0);
 	for (auto actor = ActorDefList; actor->Def; ++actor)
 	{
@@ -465,6 +863,13 @@ CXStr GetFriendlyNameForPlacedItem(const EQPlacedItem* pItem)
 	if (!pItem)
 		return CXStr();
 
+	return s_groundSpawnIndex.GetName(pItem);
+}
+
+static CXStr LookupFriendlyNameForPlacedItem(const EQPlacedItem* pItem, bool* pResolved)
+{
+	*pResolved = true;
+
 	const RealEstateManagerClient& real_estate = RealEstateManagerClient::Instance();
 	auto pRealEstateItem = real_estate.GetItemByRealEstateAndItemIds(pItem->RealEstateID, pItem->RealEstateItemID);
 	if (pRealEstateItem && pRealEstateItem->GetItem())
@@ -478,6 +883,7 @@ CXStr GetFriendlyNameForPlacedItem(const EQPlacedItem* pItem)
 		return pItem->Name;
 
 	// didn't find a real estate item, so construct a name
+	*pResolved = false;
 	return CXStr(fmt::format("Placed{:05d}/{:d}", pItem->RealEstateID, pItem->RealEstateItemID));
 }
 
@@ -0,0 +1,206 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// With /hud overlay, DrawHUDText doesn't draw through the game's fonts. The text is collected while
+// plugins draw their HUDs, and the overlay draws all of it into the background draw list in one
+// go. The vertices of each string are kept, so a string that is the same as in recent frames is
+// copied into place instead of being laid out again.
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include <imgui/imgui.h>
+
+namespace mq {
+
+static void HUDText_Shutdown();
+static void HUDText_UpdateImGui();
+
+static MQModule s_hudTextModule = {
+	"HUDText",                     // Name
+	false,                         // CanUnload
+	nullptr,
+	HUDText_Shutdown,
+	nullptr,
+	nullptr,
+	HUDText_UpdateImGui,
+};
+DECLARE_MODULE_INITIALIZER(s_hudTextModule);
+
+// Strings that haven't been drawn for this many frames are let go.
+static constexpr int HUD_TEXT_RUN_LIFETIME = 120;
+static constexpr size_t MAX_HUD_TEXT_RUNS = 2048;
+
+// Roughly the heights of the game's fonts, by the font index that DrawHUDText is given.
+static constexpr float s_fontHeights[] = { 10.f, 12.f, 14.f, 15.f, 16.f, 20.f, 24.f, 32.f, 40.f };
+
+struct HUDTextItem
+{
+	std::string text;
+	int x;
+	int y;
+	ImU32 color;
+	int font;
+};
+
+// A string laid out at 0,0 in white. Text vertices are all the same color, so the color is
+// swapped in as they are copied.
+struct HUDTextRun
+{
+	std::vector<ImDrawVert> vertices;
+	std::vector<ImDrawIdx> indices;
+	int lastUsed = 0;
+};
+
+struct HUDTextRunKey
+{
+	std::string text;
+	int font;
+	int wrapWidth;
+
+	bool operator==(const HUDTextRunKey& other) const
+	{
+		return font == other.font && wrapWidth == other.wrapWidth && text == other.text;
+	}
+};
+
+struct HUDTextRunKeyHash
+{
+	size_t operator()(const HUDTextRunKey& key) const
+	{
+		return std::hash<std::string>{}(key.text) ^ (static_cast<size_t>(key.font) << 20) ^ static_cast<size_t>(key.wrapWidth);
+	}
+};
+
+static std::vector<HUDTextItem> s_hudText;
+static std::unordered_map<HUDTextRunKey, HUDTextRun, HUDTextRunKeyHash> s_hudTextRuns;
+static ImTextureID s_hudTextFontTexture = nullptr;
+static int s_hudTextFrame = 0;
+
+void AddHUDTextToBatch(const char* Text, int X, int Y, unsigned int Argb, int Font)
+{
+	if (!Text[0])
+		return;
+
+	// ARGB to the ABGR that imgui uses
+	const ImU32 color = (Argb & 0xff00ff00) | ((Argb & 0x00ff0000) >> 16) | ((Argb & 0x000000ff) << 16);
+
+	s_hudText.push_back(HUDTextItem{ Text, X, Y, color, Font });
+}
+
+void ClearHUDTextBatch()
+{
+	s_hudText.clear();
+}
+
+static const HUDTextRun& GetHUDTextRun(ImDrawList* scratch, ImFont* font, const HUDTextItem& item, int wrapWidth)
+{
+	HUDTextRunKey key{ item.text, item.font, wrapWidth };
+
+	auto iter = s_hudTextRuns.find(key);
+	if (iter == s_hudTextRuns.end())
+	{
+		const float fontHeight = s_fontHeights[std::clamp<int>(item.font, 0, lengthof(s_fontHeights) - 1)];
+
+		scratch->_ResetForNewFrame();
+		scratch->PushTextureID(font->ContainerAtlas->TexID);
+		scratch->PushClipRectFullScreen();
+		scratch->AddText(font, fontHeight, ImVec2(0, 0), IM_COL32_WHITE, item.text.c_str(), nullptr,
+			static_cast<float>(wrapWidth));
+
+		HUDTextRun run;
+		run.vertices.assign(scratch->VtxBuffer.begin(), scratch->VtxBuffer.end());
+		run.indices.assign(scratch->IdxBuffer.begin(), scratch->IdxBuffer.end());
+
+		iter = s_hudTextRuns.emplace(std::move(key), std::move(run)).first;
+	}
+
+	iter->second.lastUsed = s_hudTextFrame;
+	return iter->second;
+}
+
+static void HUDText_UpdateImGui()
+{
+	++s_hudTextFrame;
+
+	// a new font atlas leaves the cached uvs pointing at the wrong glyphs
+	ImFont* font = ImGui::GetFont();
+	if (font->ContainerAtlas->TexID != s_hudTextFontTexture)
+	{
+		s_hudTextFontTexture = font->ContainerAtlas->TexID;
+		s_hudTextRuns.clear();
+	}
+
+	if (!s_hudText.empty())
+	{
+		ImGuiViewport* viewport = ImGui::GetMainViewport();
+		ImDrawList* dest = ImGui::GetBackgroundDrawList(viewport);
+		ImDrawList scratch(ImGui::GetDrawListSharedData());
+
+		const int screenWidth = static_cast<int>(viewport->Size.x);
+
+		dest->PushTextureID(s_hudTextFontTexture);
+
+		for (const HUDTextItem& item : s_hudText)
+		{
+			// The game wraps HUD text at the edge of the screen, so this does too.
+			const int wrapWidth = std::max(screenWidth - item.x, 1);
+			const HUDTextRun& run = GetHUDTextRun(&scratch, font, item, wrapWidth);
+			if (run.indices.empty())
+				continue;
+
+			const ImVec2 offset(viewport->Pos.x + item.x, viewport->Pos.y + item.y);
+
+			dest->PrimReserve(static_cast<int>(run.indices.size()), static_cast<int>(run.vertices.size()));
+
+			const unsigned int base = dest->_VtxCurrentIdx;
+			for (const ImDrawVert& vert : run.vertices)
+			{
+				dest->PrimWriteVtx(ImVec2(vert.pos.x + offset.x, vert.pos.y + offset.y), vert.uv, item.color);
+			}
+
+			for (ImDrawIdx idx : run.indices)
+			{
+				dest->PrimWriteIdx(static_cast<ImDrawIdx>(base + idx));
+			}
+		}
+
+		dest->PopTextureID();
+	}
+
+	// let go of the strings that stopped being drawn, which for values that keep changing is most
+	// of what was cached
+	if (s_hudTextRuns.size() > MAX_HUD_TEXT_RUNS || s_hudTextFrame % HUD_TEXT_RUN_LIFETIME == 0)
+	{
+		for (auto iter = s_hudTextRuns.begin(); iter != s_hudTextRuns.end();)
+		{
+			if (s_hudTextFrame - iter->second.lastUsed >= HUD_TEXT_RUN_LIFETIME)
+				iter = s_hudTextRuns.erase(iter);
+			else
+				++iter;
+		}
+
+		if (s_hudTextRuns.size() > MAX_HUD_TEXT_RUNS)
+			s_hudTextRuns.clear();
+	}
+}
+
+static void HUDText_Shutdown()
+{
+	s_hudText.clear();
+	s_hudTextRuns.clear();
+	s_hudTextFontTexture = nullptr;
+}
+
+} // namespace mq
@@ -17,7 +17,6 @@
 #include "MQ2DeveloperTools.h"
 #include "MQ2ImGuiTools.h"
 #include "MQ2Utilities.h"
-#include "ImGuiZepEditor.h"
 #include "ImGuiManager.h"
 
 #include "imgui/ImGuiTreePanelWindow.h"
@@ -25,7 +24,6 @@
 
 #include <imgui/imgui_internal.h>
 
-#include "zep.h"
 #include <optional>
 #include "sqlite3.h"
 
@@ -44,21 +42,21 @@ bool gbAutoDockspaceViewport = false;
 bool gbAutoDockspacePreserveRatio = false;
 
 
-static const ImU32 s_defaultColor = Zep::ZepColor(240, 240, 240, 255);
+static const ImU32 s_defaultColor = IM_COL32(240, 240, 240, 255);
 static ImGuiID s_dockspaceId = 0;
 static ImGuiID s_dockspaceTopSegmentId = 0;
 
 // Some plain default colors
-static const ImU32 s_defaultLinkColor = Zep::ZepColor(0, 128, 255);
-static const ImU32 s_defaultLinkColorHover = Zep::ZepColor(255, 255, 128);
+static const ImU32 s_defaultLinkColor = IM_COL32(0, 128, 255, 255);
+static const ImU32 s_defaultLinkColorHover = IM_COL32(255, 255, 128, 255);
 
 // Some default color constants to patch eq style links
-static const ImU32 s_linkHoverColorDefault = Zep::ZepColor(0, 0, 255);
-static const ImU32 s_linkHoverColorSpam = Zep::ZepColor(0, 255, 0);
-static const ImU32 s_linkHoverColorPlayer = Zep::ZepColor(138, 163, 255);
-static const ImU32 s_linkColorDefault = Zep::ZepColor(0, 255, 255);
-static const ImU32 s_linkColorSpam = Zep::ZepColor(128, 128, 0);
-static const ImU32 s_linkColorPlayer = Zep::ZepColor(0, 0, 0, 0); // use current color
+static const ImU32 s_linkHoverColorDefault = IM_COL32(0, 0, 255, 255);
+static const ImU32 s_linkHoverColorSpam = IM_COL32(0, 255, 0, 255);
+static const ImU32 s_linkHoverColorPlayer = IM_COL32(138, 163, 255, 255);
+static const ImU32 s_linkColorDefault = IM_COL32(0, 255, 255, 255);
+static const ImU32 s_linkColorSpam = IM_COL32(128, 128, 0, 255);
+static const ImU32 s_linkColorPlayer = IM_COL32(0, 0, 0, 0); // use current color
 
 static const int s_userColorItemLink = USERCOLOR_LINK;
 #if IS_EXPANSION_LEVEL(EXPANSION_LEVEL_ROF + 1)
@@ -247,467 +245,446 @@ static std::pair<std::string_view, ImU32> ParseColorTags(std::string_view line,
 
 //============================================================================
 
-#pragma region Zep Integration
+#pragma region Console Widget
 
-// This theme extends the default theme to support arbitrary coloring via extended
-// UserColor values of the ThemeColor enum.
-class ZepConsoleTheme : public Zep::ZepTheme
+// A run of a line's text in one color. Links are runs too, with the index of their data in the
+// line's links.
+struct ConsoleLineSpan
 {
-	static inline constexpr int UserColorStart = static_cast<int>(Zep::ThemeColor::UniqueColorLast) + 1;
+	uint32_t begin;
+	uint32_t end;
+	ImU32 color;
+	ImU32 hoverColor = 0;
+	int link = -1;
+};
+
+struct ConsoleLine
+{
+	std::string text;
+	std::vector<ConsoleLineSpan> spans;
+	std::vector<std::string> links;
+
+	// Where each wrapped row after the first starts, for the width and font size it was laid out at.
+	std::vector<uint32_t> wraps;
+	float layoutWidth = -1.0f;
+	float layoutFontSize = 0.0f;
+	float height = 0.0f;
+
+	// Offset from the top of everything that was ever added, so that lines dropped from the front
+	// don't move the rest.
+	double top = 0.0;
+
+	// Keeps the memory of the line it is reused for.
+	void Reset()
+	{
+		text.clear();
+		spans.clear();
+		links.clear();
+		wraps.clear();
+		layoutWidth = -1.0f;
+		height = 0.0f;
+	}
+};
 
+// A fixed number of lines, where adding a line to a full buffer replaces the oldest one. Each line
+// also gets a sequence number that stays the same as lines in front of it are dropped.
+class ConsoleLineBuffer
+{
 public:
-	ZepConsoleTheme()
+	explicit ConsoleLineBuffer(size_t capacity)
+		: m_capacity(std::max<size_t>(capacity, 1))
 	{
 	}
 
-	virtual Zep::ZepColor GetColor(Zep::ThemeColor themeColor) const override
+	size_t Size() const { return m_count; }
+	bool Empty() const { return m_count == 0; }
+	size_t Capacity() const { return m_capacity; }
+
+	ConsoleLine& operator[](size_t index) { return m_lines[(m_start + index) % m_lines.size()]; }
+	const ConsoleLine& operator[](size_t index) const { return m_lines[(m_start + index) % m_lines.size()]; }
+	ConsoleLine& Back() { return (*this)[m_count - 1]; }
+
+	uint64_t FrontSequence() const { return m_dropped; }
+	uint64_t EndSequence() const { return m_dropped + m_count; }
+
+	ConsoleLine& PushBack()
 	{
-		Zep::ZepColor finalColor;
-		
-		if (static_cast<int>(themeColor) >= UserColorStart)
-			finalColor = m_userColors[static_cast<size_t>(themeColor) - UserColorStart];
-		else if (themeColor == Zep::ThemeColor::Background)
-			finalColor = Zep::ZepColor(0, 0, 0, 0);
-		else if (themeColor == Zep::ThemeColor::VisualSelectBackground)
-			finalColor = Zep::ZepColor(66, 150, 249, 89);
-		else
-			finalColor = Zep::ZepTheme::GetColor(themeColor);
-		
-		// apply user alpha
-		finalColor.a = static_cast<uint8_t>(finalColor.a * m_opacity);
+		if (m_count == m_capacity)
+		{
+			ConsoleLine& line = m_lines[m_start];
+			m_start = (m_start + 1) % m_lines.size();
+			++m_dropped;
+
+			line.Reset();
+			return line;
+		}
 
-		return finalColor;
+		if (m_count == m_lines.size())
+		{
+			++m_count;
+			return m_lines.emplace_back();
+		}
+
+		ConsoleLine& line = (*this)[m_count++];
+		line.Reset();
+		return line;
 	}
 
-	// This overrides GetUniqueColor to treat any value over UniqueColorLast as a color value.
-	// It will be inserted into the user color map and the index + UserColorStart will be returned.
-	Zep::ThemeColor GetUserColor(Zep::ZepColor color)
+	void Clear()
 	{
-		uint32_t id = color.ABGR;
-		if (id < static_cast<int>(Zep::ThemeColor::UniqueColorLast) - static_cast<int>(Zep::ThemeColor::UniqueColor0))
-			return Zep::ZepTheme::GetUniqueColor(id);
+		m_dropped += m_count;
+		m_count = 0;
+		m_start = 0;
+	}
 
-		auto iter = std::find(std::begin(m_userColors), std::end(m_userColors), color);
-		if (iter == std::end(m_userColors))
+	void SetCapacity(size_t capacity)
+	{
+		capacity = std::max<size_t>(capacity, 1);
+		if (capacity == m_capacity)
+			return;
+
+		// put the lines back in order, then drop the oldest ones that no longer fit
+		std::rotate(m_lines.begin(), m_lines.begin() + m_start, m_lines.end());
+		m_start = 0;
+
+		if (m_count > capacity)
 		{
-			m_userColors.emplace_back(id);
-			return static_cast<Zep::ThemeColor>(m_userColors.size() - 1 + UserColorStart);
+			const size_t dropped = m_count - capacity;
+			m_lines.erase(m_lines.begin(), m_lines.begin() + dropped);
+			m_dropped += dropped;
+			m_count = capacity;
 		}
 
-		int index = static_cast<int>(std::distance(std::begin(m_userColors), iter));
-		return static_cast<Zep::ThemeColor>(index + UserColorStart);
-	}
+		if (m_lines.size() > capacity)
+			m_lines.resize(capacity);
 
-	float GetOpacity() { return m_opacity; }
-	void SetOpacity(const float opacity) { m_opacity = opacity; }
+		m_capacity = capacity;
+	}
 
 private:
-	std::vector<Zep::ZepColor> m_userColors;
-	float m_opacity = 1.0f;
+	std::vector<ConsoleLine> m_lines;
+	size_t m_capacity;
+	size_t m_start = 0;
+	size_t m_count = 0;
+	uint64_t m_dropped = 0;
 };
 
 //----------------------------------------------------------------------------
 
-enum class ZepAttributeType
+// The console's scrollback. Lines are laid out once for the width they are shown at, and only the
+// lines that are scrolled into view are drawn.
+class ImGuiConsoleLines : public mq::imgui::ConsoleWidget
 {
-	Color,
-	Hyperlink,
-};
+public:
+	ImGuiConsoleLines(std::string_view id)
+		: m_id(id)
+		, m_lines(m_maxBufferLines)
+	{
+	}
 
-struct ZepAttribute
-{
-	struct ColorAttributeData
+	void Clear() override
 	{
-		uint32_t color;
-	};
+		m_lines.Clear();
+		m_lineOpen = false;
+		m_layoutFrom = m_lines.EndSequence();
+		m_selectionStart = m_selectionEnd = NO_SELECTION;
+	}
 
-	struct HyperlinkAttributeData
+	// This accepts color in ABGR.
+	void AppendFormattedText(std::string_view text, ImU32 defaultColor = s_defaultColor, bool newline = false)
 	{
-		std::string linkData;
-		uint32_t color = s_defaultLinkColor;
-		uint32_t hoverColor = s_defaultLinkColorHover;
-	};
+		std::string_view lineView = text;
+		ImU32 currentColor = defaultColor;
+
+		std::vector<ImU32> colorStack;
 
-	using ZepAttributeData = std::variant<ColorAttributeData, HyperlinkAttributeData>;
+		while (!lineView.empty())
+		{
+			auto colorPos = lineView.find("\a");
 
-	ZepAttributeType type;
-	ZepAttributeData data;
+			// this is everything before the color code.
+			auto beforeColor = lineView.substr(0, colorPos);
+			if (!beforeColor.empty())
+			{
+				// no color codes, write out with current color
+				AddFormattedText(beforeColor, currentColor);
+			}
 
-	ZepAttribute(ZepAttributeType type, ZepAttributeData data)
-		: type(type)
-		, data(std::move(data))
-	{
-	}
+			// did we find a color?
+			if (colorPos == std::string_view::npos)
+				break;
 
-	ZepAttribute() = default;
-};
+			lineView = lineView.substr(colorPos);
 
-struct ZepTextAttribute
-{
-	int startIndex;
-	int endIndex;
-	ZepAttribute attribute;
-};
+			// Parse the color and get the next segment. We pass in the
+			// default color to handle \ax properly
+			auto [nextSegment, nextColor] = ParseColorTags(lineView, colorStack, defaultColor);
 
-struct ZepBufferAttribute
-{
-	Zep::GlyphIterator start;
-	int startIndex;
-	int endIndex;
-	ZepAttribute attribute;
-};
+			if (nextSegment.empty())
+				break;
 
-using ZepAttributes = std::vector<ZepBufferAttribute>;
+			currentColor = nextColor;
+			lineView = nextSegment;
+		}
 
-constexpr const Zep::Msg UserEvent_HyperlinkLeftClick = static_cast<Zep::Msg>(static_cast<int>(Zep::Msg::UserEvent) + 1);
-constexpr const Zep::Msg UserEvent_HyperlinkRightClick = static_cast<Zep::Msg>(static_cast<int>(Zep::Msg::UserEvent) + 2);
+		if (newline)
+			AddText("\n", defaultColor);
 
-// This custom syntax makes use of ranged-based "attributes" that annotate the text to produce
-// colorization and hyperlinks for the editor.
-class ZepConsoleSyntax : public Zep::ZepSyntax
-{
-public:
-	ZepConsoleSyntax(Zep::ZepBuffer& buffer, const std::shared_ptr<ZepConsoleTheme>& theme, Zep::ZepWindow* window)
-		: Zep::ZepSyntax(buffer)
-		, m_theme(theme)
-	{
-		SetWindow(window);
+		OnTextAdded();
 	}
 
-	void SetWindow(Zep::ZepWindow* window)
+	void AppendText(std::string_view text, MQColor defaultColor /* = DEFAULT_COLOR */, bool appendNewLine /* = false */) override
 	{
-		onMouseCursorChanged = window->sigMouseCursorChanged.connect(
-			[=](Zep::ZepBuffer& buffer, const Zep::GlyphIterator& mousePos)
-			{
-				if (&buffer != &m_buffer)
-					return;
-				UpdateMouseCursor(mousePos);
-			});
+		AppendFormattedText(text, defaultColor.ToImU32(), appendNewLine);
 	}
 
-	struct SyntaxData
+	void AppendHyperlink(std::string_view text, const std::string& linkData, ImU32 color = s_defaultLinkColor,
+		ImU32 hoverColor = s_defaultLinkColorHover)
 	{
-		Zep::ThemeColor foreground = Zep::ThemeColor::Normal;
-		uint32_t hyperlinkId = 0;
-	};
+		AddText(text, color, &linkData, hoverColor);
+		OnTextAdded();
+	}
 
-	Zep::SyntaxResult GetSyntaxAt(const Zep::GlyphIterator& offset) const
+	void ScrollToBottom() override
 	{
-		Zep::SyntaxResult result{};
-
-		if (m_latestPosition < offset.Index() || (long)m_syntax.size() <= offset.Index())
-		{
-			return result;
-		}
-
-		const SyntaxData& syntaxData = m_syntax[offset.Index()];
-
-		if (syntaxData.hyperlinkId)
-		{
-			result.foreground = GetHyperlinkColor(syntaxData.hyperlinkId, m_hoveredHyperlink == syntaxData.hyperlinkId);
-		}
-		else
-		{
-			result.foreground = syntaxData.foreground;
-		}
+		m_scrollToBottom = true;
+	}
 
-		return result;
+	bool IsCursorAtEnd() const override
+	{
+		return m_atBottom;
 	}
 
-	Zep::ThemeColor GetHyperlinkColor(uint32_t linkId, bool hovered) const
+	void Render(const ImVec2& displaySize = ImVec2()) override
 	{
-		// Get the color tied to this hyperlink.
-		auto iter = m_hyperlinkData.find(linkId);
-		if (iter != m_hyperlinkData.end())
+		ImGui::PushFont(mq::imgui::ConsoleFont);
+
+		if (!ImGui::BeginChild(m_id.c_str(), displaySize, false, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoBackground))
 		{
-			return m_theme->GetUserColor(hovered ? iter->second.hoverColor : iter->second.color);
+			ImGui::EndChild();
+			ImGui::PopFont();
+			return;
 		}
 
-		return m_theme->GetUserColor(hovered ? s_defaultLinkColorHover : s_defaultLinkColor);
-	}
+		const float fontSize = ImGui::GetFontSize();
+		const float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+		UpdateLayout(ImGui::GetFont(), fontSize, width);
 
-	void Notify(std::shared_ptr<Zep::ZepMessage> spMsg)
-	{
-		if (spMsg->messageId == Zep::Msg::Buffer)
-		{
-			auto spBufferMsg = std::static_pointer_cast<Zep::BufferMessage>(spMsg);
-			if (spBufferMsg->pBuffer != &m_buffer)
-			{
-				return;
-			}
+		const ImVec2 startPos = ImGui::GetCursorPos();
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		const float scrollY = ImGui::GetScrollY();
+		const float visibleHeight = ImGui::GetContentRegionAvail().y;
+		const double frontTop = m_lines.Empty() ? 0.0 : m_lines[0].top;
+		const float totalHeight = m_lines.Empty() ? 0.0f
+			: static_cast<float>(m_lines.Back().top + m_lines.Back().height - frontTop);
 
-			if (spBufferMsg->type == Zep::BufferMessageType::PreBufferChange)
-			{
-			}
-			else if (spBufferMsg->type == Zep::BufferMessageType::TextDeleted)
-			{
-				// Remove any hyperlinks in deleted text.
-				for (int pos = spBufferMsg->startLocation.Index(); pos != spBufferMsg->endLocation.Index(); ++pos)
-				{
-					if (m_syntax[pos].hyperlinkId != 0)
-					{
-						RemoveHyperlink(m_syntax[pos].hyperlinkId);
-					}
-				}
+		m_atBottom = scrollY >= ImGui::GetScrollMaxY() - 1.0f;
 
-				m_syntax.erase(m_syntax.begin() + spBufferMsg->startLocation.Index(),
-					m_syntax.begin() + spBufferMsg->endLocation.Index());
+		const ImGuiIO& io = ImGui::GetIO();
+		const bool hovered = ImGui::IsWindowHovered();
 
-				m_latestPosition -= (spBufferMsg->endLocation.Index() - spBufferMsg->endLocation.Index());
-			}
-			else if (spBufferMsg->type == Zep::BufferMessageType::TextAdded
-				|| spBufferMsg->type == Zep::BufferMessageType::Loaded)
-			{
-				auto dist = Zep::ByteDistance(spBufferMsg->startLocation, spBufferMsg->endLocation);
-				m_syntax.insert(m_syntax.begin() + spBufferMsg->startLocation.Index(), dist, SyntaxData{});
+		std::string clickedLink;
+		const std::string* hoveredLink = nullptr;
 
-				// Fill in syntax data from attributes.
-				for (const ZepBufferAttribute& attribute : m_pendingAttributes)
-				{
-					if (attribute.attribute.type == ZepAttributeType::Color)
-					{
-						uint32_t color = std::get<(int)ZepAttributeType::Color>(attribute.attribute.data).color;
-						Zep::ThemeColor themeColor = m_theme->GetUserColor(color);
+		// the lines that are at least partly in view
+		const size_t first = FindLineAt(frontTop + scrollY);
+		size_t last = first;
 
-						Zep::GlyphRange range = { attribute.start + attribute.startIndex, attribute.start + attribute.endIndex };
-						for (Zep::GlyphIterator iter = range.first; iter != range.second; iter++)
-						{
-							m_syntax[iter.Index()].foreground = themeColor;
-						}
-					}
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		ImFont* font = ImGui::GetFont();
 
-					if (attribute.attribute.type == ZepAttributeType::Hyperlink)
-					{
-						auto& hyperlinkData = std::get<(int)ZepAttributeType::Hyperlink>(attribute.attribute.data);
-						uint32_t hyperlinkId = MakeHyperlink(hyperlinkData);
+		for (; last < m_lines.Size(); ++last)
+		{
+			const ConsoleLine& line = m_lines[last];
+			const float lineY = origin.y + static_cast<float>(line.top - frontTop);
+			if (lineY > origin.y + scrollY + visibleHeight)
+				break;
 
-						Zep::GlyphRange range = { attribute.start + attribute.startIndex, attribute.start + attribute.endIndex };
-						for (Zep::GlyphIterator iter = range.first; iter != range.second; iter++)
-						{
-							m_syntax[iter.Index()].hyperlinkId = hyperlinkId;
-						}
-					}
-				}
-				m_pendingAttributes.clear();
-				m_latestPosition += (spBufferMsg->endLocation.Index() - spBufferMsg->startLocation.Index());
-			}
-			else if (spBufferMsg->type == Zep::BufferMessageType::TextChanged)
+			const uint64_t sequence = m_lines.FrontSequence() + last;
+			if (IsSelected(sequence))
 			{
-				auto dist = Zep::ByteDistance(spBufferMsg->startLocation, spBufferMsg->endLocation);
-
-				// Just clear syntax data. Changed text has no new attributes.
-				std::fill_n(m_syntax.begin() + spBufferMsg->startLocation.Index(), dist, SyntaxData{});
+				drawList->AddRectFilled(ImVec2(origin.x, lineY), ImVec2(origin.x + width, lineY + line.height),
+					ImGui::GetColorU32(ImGuiCol_TextSelectedBg));
 			}
+
+			DrawLine(drawList, font, fontSize, line, ImVec2(origin.x, lineY), hovered ? io.MousePos : ImVec2(-FLT_MAX, -FLT_MAX),
+				hoveredLink);
 		}
-	}
 
-	void DispatchMouseEvent(std::shared_ptr<Zep::ZepMessage> message)
-	{
-		if (message->messageId == Zep::Msg::MouseDown
-			&& m_hoveredHyperlink != 0)
+		// One item over the visible lines takes the clicks. It stops at the last line so that it doesn't
+		// hold the scroll range open after the lines are cleared.
+		ImGui::SetCursorPos(ImVec2(startPos.x, startPos.y + scrollY));
+		ImGui::InvisibleButton("##lines", ImVec2(width, std::max(std::min(visibleHeight, totalHeight - scrollY), 1.0f)));
+
+		if (hoveredLink)
 		{
-			if (message->button == Zep::ZepMouseButton::Left)
-			{
-				auto hyperlinkMsg = std::make_shared<Zep::ZepMessage>(UserEvent_HyperlinkLeftClick, m_hyperlinkData[m_hoveredHyperlink].linkData);
-				GetEditor().Broadcast(hyperlinkMsg);
+			ImGui::SetMouseCursor(ImGuiMouseCursor_Hand);
 
-				message->handled = true;
-			}
+			if (ImGui::IsItemClicked(ImGuiMouseButton_Left))
+				clickedLink = *hoveredLink;
 		}
-		else if (message->messageId == Zep::Msg::MouseMove
-			&& message->button == Zep::ZepMouseButton::Left)
+		else if (ImGui::IsItemActivated() && !m_lines.Empty())
 		{
-			// Don't drag from links.
-			message->handled = true;
+			m_selectionStart = m_selectionEnd = LineSequenceAt(frontTop + io.MousePos.y - origin.y);
+		}
+		else if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left) && m_selectionStart != NO_SELECTION)
+		{
+			m_selectionEnd = LineSequenceAt(frontTop + io.MousePos.y - origin.y);
 		}
-	}
 
-	void AddAttribute(const Zep::GlyphIterator& position, ZepTextAttribute attr)
-	{
-		ZepBufferAttribute& buffAttr = m_pendingAttributes.emplace_back();
-		buffAttr.start = position;
-		buffAttr.startIndex = attr.startIndex;
-		buffAttr.endIndex = attr.endIndex;
-		buffAttr.attribute = std::move(attr.attribute);
-	}
+		if (ImGui::IsWindowFocused() && io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_C, false))
+			CopySelection();
 
-	uint32_t MakeHyperlink(const ZepAttribute::HyperlinkAttributeData& hyperlinkData)
-	{
-		uint32_t hyperlinkId = m_nextHyperlinkId++;
-		m_hyperlinkData[hyperlinkId] = hyperlinkData;
-		return hyperlinkId;
-	}
+		if (ImGui::BeginPopupContextItem("##lines_menu"))
+		{
+			if (ImGui::Selectable("Copy", false, m_selectionStart == NO_SELECTION ? ImGuiSelectableFlags_Disabled : 0))
+				CopySelection();
 
-	void RemoveHyperlink(uint32_t hyperlinkId)
-	{
-		m_hyperlinkData.erase(hyperlinkId);
-		m_hoveredHyperlink = 0;
-	}
+			if (ImGui::Selectable("Select All") && !m_lines.Empty())
+			{
+				m_selectionStart = m_lines.FrontSequence();
+				m_selectionEnd = m_lines.EndSequence() - 1;
+			}
 
-	void UpdateMouseCursor(const Zep::GlyphIterator& offset)
-	{
-		m_hoveredHyperlink = 0;
+			if (ImGui::Selectable("Clear"))
+				Clear();
 
-		if (m_latestPosition < offset.Index() || (long)m_syntax.size() <= offset.Index())
-		{
-			return;
+			ImGui::EndPopup();
 		}
 
-		if (offset.Valid())
+		// the extent of every line, for the scrollbar
+		ImGui::SetCursorPos(startPos);
+		ImGui::Dummy(ImVec2(width, totalHeight));
+
+		if (m_scrollToBottom)
 		{
-			m_hoveredHyperlink = m_syntax[offset.Index()].hyperlinkId;
+			m_scrollToBottom = false;
+			ImGui::SetScrollHereY(1.0f);
 		}
-	}
 
-private:
-	std::vector<SyntaxData> m_syntax;
-	std::shared_ptr<ZepConsoleTheme> m_theme;
-	std::vector<ZepBufferAttribute> m_pendingAttributes;
-	uint32_t m_nextHyperlinkId = 1;
-	std::map<uint32_t, ZepAttribute::HyperlinkAttributeData> m_hyperlinkData;
-	uint32_t m_hoveredHyperlink = 0;
-	Zep::scoped_connection onMouseCursorChanged;
-	int m_latestPosition = 0;
-};
-
-//----------------------------------------------------------------------------
+		ImGui::EndChild();
+		ImGui::PopFont();
 
-class ZepMode_ImGuiConsole : public Zep::ZepMode_Standard
-{
-public:
-	using ZepMode_Standard::ZepMode_Standard;
+		if (!clickedLink.empty())
+			OnLinkClicked(clickedLink);
+	}
 
-	virtual Zep::CursorType GetCursorType() const override { return Zep::CursorType::None; }
+	bool GetAutoScroll() const override { return m_autoScroll; }
 
-	static const char* StaticName()
+	void SetAutoScroll(bool autoScroll) override
 	{
-		return "Console";
+		m_autoScroll = autoScroll;
 	}
 
-	virtual const char* Name() const override
+	int GetMaxBufferLines() const override { return m_maxBufferLines; }
+
+	void SetMaxBufferLines(int maxBufferLines) override
 	{
-		return StaticName();
+		m_maxBufferLines = std::max(maxBufferLines, 1);
+		m_lines.SetCapacity(m_maxBufferLines);
+		m_layoutFrom = std::max(m_layoutFrom, m_lines.FrontSequence());
 	}
-};
 
-//----------------------------------------------------------------------------
+	float GetOpacity() const override { return m_opacity; }
 
-// This is the imgui container for the Zep component.
-struct ImGuiZepConsole : public mq::imgui::ConsoleWidget, public mq::imgui::ImGuiZepEditor
-{
-	Zep::ZepBuffer* m_buffer = nullptr;
-	Zep::ZepWindow* m_window = nullptr;
-	bool m_deferredCursorToEnd = false;
-	std::shared_ptr<ZepConsoleTheme> m_theme;
-	std::shared_ptr<ZepConsoleSyntax> m_syntax;
-	int m_maxBufferLines = 10000;
-	bool m_autoScroll = true;
-	std::string m_id;
-
-	ImGuiZepConsole(std::string_view id)
-		: m_id(std::string(id))
+	void SetOpacity(float opacity) override
 	{
-		SetFont(Zep::ZepTextType::UI, mq::imgui::DefaultFont, 16);
-		SetFont(Zep::ZepTextType::Text, mq::imgui::ConsoleFont, 13);
-		SetFont(Zep::ZepTextType::Heading1, mq::imgui::DefaultFont, 28);
-		SetFont(Zep::ZepTextType::Heading2, mq::imgui::DefaultFont, 14);
-		SetFont(Zep::ZepTextType::Heading3, mq::imgui::DefaultFont, 20);
+		m_opacity = opacity;
+	}
 
-		GetEditor().RegisterGlobalMode(std::make_shared<ZepMode_ImGuiConsole>(GetEditor()));
-		GetEditor().SetGlobalMode(ZepMode_ImGuiConsole::StaticName());
+private:
+	static constexpr uint64_t NO_SELECTION = UINT64_MAX;
 
-		m_window = GetEditor().GetActiveTabWindow()->GetActiveWindow();
-		m_theme = std::make_shared<ZepConsoleTheme>();
-		GetEditor().SetTheme(m_theme);
+	// Where the next text goes. Text is added to the last line until a newline closes it.
+	ConsoleLine& GetOpenLine()
+	{
+		if (!m_lineOpen)
+		{
+			const bool wasEmpty = m_lines.Empty();
+			const double top = wasEmpty ? 0.0 : m_lines.Back().top + m_lines.Back().height;
 
-		GetEditor().GetConfig().style = Zep::EditorStyle::Minimal;
-		m_window->SetWindowFlags(Zep::WindowFlags::WrapText);
+			ConsoleLine& line = m_lines.PushBack();
+			line.top = top;
+			m_lineOpen = true;
 
-		GetEditor().RegisterSyntaxFactory(
-			{ "Console" },
-			Zep::SyntaxProvider{ "Console", Zep::tSyntaxFactory([this](Zep::ZepBuffer* pBuffer) {
-				return std::make_shared<ZepConsoleSyntax>(*pBuffer, m_theme, m_window);
-			})
-		});
+			m_layoutFrom = std::min(m_layoutFrom, m_lines.EndSequence() - 1);
+			return line;
+		}
 
-		m_buffer = GetEditor().InitWithText("Console", "");
-		m_buffer->SetTheme(m_theme);
-		m_window->SetBufferCursor(m_buffer->End());
-		m_window->ToggleFlag(Zep::WindowFlags::HideTrailingNewline);
-		m_buffer->SetFileFlags(Zep::FileFlags::ReadOnly | Zep::FileFlags::CrudeUtf8Vaidate);
+		m_layoutFrom = std::min(m_layoutFrom, m_lines.EndSequence() - 1);
+		return m_lines.Back();
 	}
 
-	void Clear() override
+	void AddText(std::string_view text, ImU32 color, const std::string* linkData = nullptr, ImU32 hoverColor = 0)
 	{
-		m_buffer->Clear();
-	}
+		while (true)
+		{
+			const size_t newline = text.find('\n');
+			const std::string_view segment = text.substr(0, newline);
 
-	Zep::ZepWindow* GetWindow() const { return m_window; }
-	Zep::ZepBuffer* GetBuffer() const { return m_buffer; }
+			if (!segment.empty() || newline != std::string_view::npos)
+			{
+				ConsoleLine& line = GetOpenLine();
 
-	Zep::GlyphIterator InsertText(Zep::GlyphIterator position, std::string_view text, ImU32 color = -1)
-	{
-		if (color != -1)
-		{
-			ZepTextAttribute attribute;
-			attribute.startIndex = 0;
-			attribute.endIndex = static_cast<int>(text.length());
-			attribute.attribute.type = ZepAttributeType::Color;
-			attribute.attribute.data = ZepAttribute::ColorAttributeData{ color };
-
-			ZepConsoleSyntax* syntax = static_cast<ZepConsoleSyntax*>(m_buffer->GetSyntax());
-			syntax->AddAttribute(position, std::move(attribute));
-		}
+				if (!segment.empty())
+				{
+					const uint32_t begin = static_cast<uint32_t>(line.text.size());
+					line.text.append(segment);
+					const uint32_t end = static_cast<uint32_t>(line.text.size());
+
+					if (linkData)
+					{
+						line.spans.push_back(ConsoleLineSpan{ begin, end, color, hoverColor, static_cast<int>(line.links.size()) });
+						line.links.push_back(*linkData);
+					}
+					else if (!line.spans.empty() && line.spans.back().link == -1 && line.spans.back().color == color)
+					{
+						line.spans.back().end = end;
+					}
+					else
+					{
+						line.spans.push_back(ConsoleLineSpan{ begin, end, color });
+					}
+				}
+			}
 
-		Zep::ChangeRecord changeRecord;
-		m_buffer->Insert(position, text, changeRecord);
+			if (newline == std::string_view::npos)
+				break;
 
-		return position.Move(static_cast<long>(text.length()));
+			m_lineOpen = false;
+			text = text.substr(newline + 1);
+		}
 	}
 
-	void InsertFormattedText(Zep::GlyphIterator position, std::string_view text, ImU32 color)
+	void AddFormattedText(std::string_view text, ImU32 color)
 	{
 		// Parse hyperlink data
 		static TextTagInfo textTagInfo[MAX_EXTRACT_LINKS];
 		size_t linkCount = eqlib::ExtractLinks(text, textTagInfo, MAX_EXTRACT_LINKS);
 
-		if (linkCount > 0)
-		{
-			// Insert text in segments, broken up by the links.
-			size_t segPos = 0;
-
-			for (size_t curTag = 0; curTag < linkCount; ++curTag)
-			{
-				TextTagInfo& tagInfo = textTagInfo[curTag];
+		// Add text in segments, broken up by the links.
+		size_t segPos = 0;
 
-				// Get text before.
-				std::string_view curSeg = text.substr(segPos, tagInfo.link.data() - text.data() - segPos);
-				if (!curSeg.empty())
-				{
-					position = InsertText(position, curSeg, color);
-					segPos += curSeg.length();
-				}
+		for (size_t curTag = 0; curTag < linkCount; ++curTag)
+		{
+			TextTagInfo& tagInfo = textTagInfo[curTag];
 
-				// Insert hyperlink.
-				InsertHyperlink(position, tagInfo);
-				position = position.Move(static_cast<long>(tagInfo.text.length()));
-				segPos = tagInfo.link.data() - text.data() + tagInfo.link.size();
-			}
+			// Get text before.
+			std::string_view curSeg = text.substr(segPos, tagInfo.link.data() - text.data() - segPos);
+			if (!curSeg.empty())
+				AddText(curSeg, color);
 
-			// If there is anything at the end, do that too.
-			std::string_view endSeg = text.substr(segPos);
-			if (!endSeg.empty())
-			{
-				position = InsertText(position, endSeg, color);
-			}
-		}
-		else
-		{
-			InsertText(position, text, color);
+			AddHyperlink(tagInfo, color);
+			segPos = tagInfo.link.data() - text.data() + tagInfo.link.size();
 		}
+
+		// If there is anything at the end, do that too.
+		std::string_view endSeg = text.substr(segPos);
+		if (!endSeg.empty())
+			AddText(endSeg, color);
 	}
 
-	void InsertHyperlink(Zep::GlyphIterator position, const TextTagInfo& tagInfo)
+	void AddHyperlink(const TextTagInfo& tagInfo, ImU32 textColor)
 	{
 		uint32_t color = s_linkColorDefault;
 		uint32_t hoverColor = s_linkHoverColorDefault;
@@ -724,7 +701,7 @@ struct ImGuiZepConsole : public mq::imgui::ConsoleWidget, public mq::imgui::ImGu
 			break;
 		case ETAG_SPAM:
 			color = s_linkColorSpam;
-			color = s_linkHoverColorSpam;
+			hoverColor = s_linkHoverColorSpam;
 			break;
 #if IS_EXPANSION_LEVEL(EXPANSION_LEVEL_ROF + 1)
 		case ETAG_ACHIEVEMENT:
@@ -744,171 +721,206 @@ struct ImGuiZepConsole : public mq::imgui::ConsoleWidget, public mq::imgui::ImGu
 			break;
 		}
 
-		InsertHyperlink(position, tagInfo.text, std::string(tagInfo.link), color, hoverColor);
+		// a fully transparent link color means to use the color of the text around it
+		if (color == 0)
+			color = textColor;
+
+		const std::string linkData{ tagInfo.link };
+		AddText(tagInfo.text, color, &linkData, hoverColor);
 	}
 
-	void InsertHyperlink(Zep::GlyphIterator position, std::string_view text, std::string hyperlinkData, uint32_t color, uint32_t hoverColor)
+	void OnTextAdded()
 	{
-		ZepTextAttribute attribute;
-		attribute.startIndex = 0;
-		attribute.endIndex = static_cast<int>(text.length());
-		attribute.attribute.type = ZepAttributeType::Hyperlink;
-		attribute.attribute.data = ZepAttribute::HyperlinkAttributeData{ std::move(hyperlinkData), color, hoverColor };
-
-		ZepConsoleSyntax* syntax = static_cast<ZepConsoleSyntax*>(m_buffer->GetSyntax());
-		syntax->AddAttribute(position, std::move(attribute));
-
-		Zep::ChangeRecord changeRecord;
-		m_buffer->Insert(position, text, changeRecord);
+		if (m_autoScroll && m_atBottom)
+			m_scrollToBottom = true;
 	}
 
-	// This accepts color in ABGR.
-	void AppendFormattedText(std::string_view text, uint32_t defaultColor = s_defaultColor, bool newline = false)
+	void LayoutLine(ConsoleLine& line, ImFont* font, float fontSize, float width)
 	{
-		Zep::GlyphIterator cursor = m_window->GetBufferCursor();
-		bool cursorAtEnd = m_window->IsAtBottom();
+		line.wraps.clear();
 
-		std::string_view lineView = text;
-		ImU32 currentColor = defaultColor;
+		const float scale = fontSize / font->FontSize;
+		const char* begin = line.text.c_str();
+		const char* end = begin + line.text.size();
+		const char* pos = begin;
 
-		std::vector<ImU32> colorStack;
-
-		while (!lineView.empty())
+		while (pos < end)
 		{
-			auto colorPos = lineView.find("\a");
-
-			// this is everything before the color code.
-			auto beforeColor = lineView.substr(0, colorPos);
-			if (!beforeColor.empty())
+			const char* next = font->CalcWordWrapPositionA(scale, pos, end, width);
+			if (next <= pos)
 			{
-				// no color codes, write out with current color
-				InsertFormattedText(m_buffer->End(), beforeColor, currentColor);
+				// always make progress, even if a single character is wider than the window
+				unsigned int c;
+				next = pos + std::max(ImTextCharFromUtf8(&c, pos, end), 1);
 			}
 
-			// did we find a color?
-			if (colorPos == std::string_view::npos)
-				break;
+			// like imgui's own wrapping, the spaces that a row wraps at aren't carried to the next
+			while (next < end && (*next == ' ' || *next == '\t'))
+				++next;
 
-			lineView = lineView.substr(colorPos);
+			if (next < end)
+				line.wraps.push_back(static_cast<uint32_t>(next - begin));
 
-			auto& [nextSegment, nextColor] = ParseColorTags(lineView, colorStack, defaultColor);
-			// Parse the color and get the next segment. We pass in the
-			// default color to handle \ax properly
-
-			if (nextSegment.empty())
-				break;
-
-			currentColor = nextColor;
-			lineView = nextSegment;
+			pos = next;
 		}
 
-		if (newline)
-			InsertText(m_buffer->End(), "\n");
+		line.layoutWidth = width;
+		line.layoutFontSize = fontSize;
+		line.height = (line.wraps.size() + 1) * fontSize;
+	}
 
-		PruneBuffer();
+	// Lays out the lines added since the last frame. Everything is laid out again only when the
+	// width or the font size changes.
+	void UpdateLayout(ImFont* font, float fontSize, float width)
+	{
+		if (m_lines.Empty())
+			return;
+
+		uint64_t from = std::max(m_layoutFrom, m_lines.FrontSequence());
+		const ConsoleLine& front = m_lines[0];
+		if (front.layoutWidth != width || front.layoutFontSize != fontSize)
+			from = m_lines.FrontSequence();
 
-		if (cursorAtEnd)
+		for (size_t index = static_cast<size_t>(from - m_lines.FrontSequence()); index < m_lines.Size(); ++index)
 		{
-			TriggerAutoScroll();
+			ConsoleLine& line = m_lines[index];
+			if (index > 0)
+				line.top = m_lines[index - 1].top + m_lines[index - 1].height;
+
+			LayoutLine(line, font, fontSize, width);
 		}
-	}
 
-	void AppendText(std::string_view text, MQColor defaultColor /* = DEFAULT_COLOR */, bool appendNewLine /* = false */) override
-	{
-		AppendFormattedText(text, defaultColor.ToImU32(), appendNewLine);
+		m_layoutFrom = m_lines.EndSequence();
 	}
 
-	void TriggerAutoScroll()
+	// The index of the line that covers the given offset, or the last line if it is past the end.
+	size_t FindLineAt(double top) const
 	{
-		if (m_autoScroll)
+		size_t low = 0;
+		size_t high = m_lines.Size();
+
+		while (low < high)
 		{
-			m_deferredCursorToEnd = true;
+			const size_t mid = low + (high - low) / 2;
+			const ConsoleLine& line = m_lines[mid];
+
+			if (line.top + line.height <= top)
+				low = mid + 1;
+			else
+				high = mid;
 		}
-	}
 
-	void ScrollToBottom() override
-	{
-		m_deferredCursorToEnd = true;
+		return low;
 	}
 
-	bool IsCursorAtEnd() const override
+	uint64_t LineSequenceAt(double top) const
 	{
-		return m_window->IsAtBottom();
+		const size_t index = std::min(FindLineAt(top), m_lines.Size() - 1);
+		return m_lines.FrontSequence() + index;
 	}
 
-	void PruneBuffer()
+	bool IsSelected(uint64_t sequence) const
 	{
-		int lineCount = m_buffer->GetLineCount();
-		if (lineCount > m_maxBufferLines + 1)
-		{
-			int linesToDelete = lineCount - (m_maxBufferLines + 1);
-
-			Zep::ByteRange range;
-			if (m_buffer->GetLineOffsets(linesToDelete, range))
-			{
-				Zep::GlyphIterator end(m_buffer, range.first);
+		if (m_selectionStart == NO_SELECTION)
+			return false;
 
-				Zep::ChangeRecord changeRecord;
-				m_buffer->Delete(m_buffer->Begin(), end, changeRecord);
-			}
-		}
+		return sequence >= std::min(m_selectionStart, m_selectionEnd)
+			&& sequence <= std::max(m_selectionStart, m_selectionEnd);
 	}
 
-	void Render(const ImVec2& displaySize = ImVec2()) override
+	void CopySelection()
 	{
-		if (m_deferredCursorToEnd)
+		if (m_selectionStart == NO_SELECTION || m_lines.Empty())
+			return;
+
+		const uint64_t from = std::max(std::min(m_selectionStart, m_selectionEnd), m_lines.FrontSequence());
+		const uint64_t to = std::min(std::max(m_selectionStart, m_selectionEnd) + 1, m_lines.EndSequence());
+
+		std::string text;
+		for (uint64_t sequence = from; sequence < to; ++sequence)
 		{
-			m_deferredCursorToEnd = false;
-			m_window->ScrollToBottom();
+			text.append(m_lines[static_cast<size_t>(sequence - m_lines.FrontSequence())].text);
+			text.push_back('\n');
 		}
 
-		ImGuiZepEditor::Render(m_id.c_str(), displaySize);
+		ImGui::SetClipboardText(text.c_str());
 	}
 
-	void Notify(std::shared_ptr<Zep::ZepMessage> message) override
+	void DrawLine(ImDrawList* drawList, ImFont* font, float fontSize, const ConsoleLine& line, ImVec2 pos,
+		const ImVec2& mousePos, const std::string*& hoveredLink) const
 	{
-		if (message->messageId == UserEvent_HyperlinkLeftClick)
+		const char* text = line.text.c_str();
+		size_t spanIndex = 0;
+
+		for (size_t row = 0; row <= line.wraps.size(); ++row)
 		{
-			if (starts_with(message->str, "testlink:"))
-			{
-				std::string text = fmt::format("Clicked hyperlink: {}\n", std::string_view{ message->str }.substr(9));
+			const uint32_t rowBegin = row == 0 ? 0 : line.wraps[row - 1];
+			const uint32_t rowEnd = row < line.wraps.size() ? line.wraps[row] : static_cast<uint32_t>(line.text.size());
+			float x = pos.x;
 
-				AppendFormattedText(text, Zep::ZepColor(255, 255, 0));
-			}
-			else
+			// rows are drawn in order, so the spans are walked once for the whole line
+			while (spanIndex < line.spans.size() && line.spans[spanIndex].end <= rowBegin)
+				++spanIndex;
+
+			for (size_t i = spanIndex; i < line.spans.size() && line.spans[i].begin < rowEnd; ++i)
 			{
-				TextTagInfo tagInfo = ExtractLink(message->str);
+				const ConsoleLineSpan& span = line.spans[i];
+				const char* segBegin = text + std::max(span.begin, rowBegin);
+				const char* segEnd = text + std::min(span.end, rowEnd);
+
+				const float segWidth = font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, segBegin, segEnd).x;
+				ImU32 color = span.color;
 
-				if (!ExecuteTextLink(tagInfo))
+				if (span.link != -1 && ImRect(x, pos.y, x + segWidth, pos.y + fontSize).Contains(mousePos))
 				{
-					AppendFormattedText(fmt::format("Clicked link: {}\n", message->str));
+					hoveredLink = &line.links[span.link];
+					if (span.hoverColor != 0)
+						color = span.hoverColor;
 				}
+
+				drawList->AddText(font, fontSize, ImVec2(x, pos.y), ApplyOpacity(color), segBegin, segEnd);
+				x += segWidth;
 			}
-		}
 
-		ImGuiZepEditor::Notify(message);
+			pos.y += fontSize;
+		}
 	}
 
-	bool GetAutoScroll() const override { return m_autoScroll; }
-
-	void SetAutoScroll(bool autoScroll) override
+	ImU32 ApplyOpacity(ImU32 color) const
 	{
-		m_autoScroll = autoScroll;
+		const ImU32 alpha = static_cast<ImU32>(((color >> IM_COL32_A_SHIFT) & 0xff) * m_opacity);
+		return (color & ~IM_COL32_A_MASK) | (std::min<ImU32>(alpha, 255) << IM_COL32_A_SHIFT);
 	}
 
-	int GetMaxBufferLines() const override { return m_maxBufferLines; }
-
-	void SetMaxBufferLines(int maxBufferLines) override
+	void OnLinkClicked(const std::string& linkData)
 	{
-		m_maxBufferLines = maxBufferLines;
-	}
-
-	float GetOpacity() const override { return m_theme->GetOpacity(); }
+		if (starts_with(linkData, "testlink:"))
+		{
+			AppendFormattedText(fmt::format("Clicked hyperlink: {}\n", std::string_view{ linkData }.substr(9)),
+				IM_COL32(255, 255, 0, 255));
+		}
+		else
+		{
+			TextTagInfo tagInfo = ExtractLink(linkData);
 
-	void SetOpacity(float opacity) override
-	{
-		m_theme->SetOpacity(opacity);
+			if (!ExecuteTextLink(tagInfo))
+			{
+				AppendFormattedText(fmt::format("Clicked link: {}\n", linkData));
+			}
+		}
 	}
+
+	std::string m_id;
+	int m_maxBufferLines = 10000;
+	ConsoleLineBuffer m_lines;
+	bool m_lineOpen = false;
+	uint64_t m_layoutFrom = 0;               // sequence of the first line that needs to be laid out
+	uint64_t m_selectionStart = NO_SELECTION;
+	uint64_t m_selectionEnd = NO_SELECTION;
+	bool m_autoScroll = true;
+	bool m_scrollToBottom = false;
+	bool m_atBottom = true;
+	float m_opacity = 1.0f;
 };
 
 #pragma endregion
@@ -917,7 +929,7 @@ namespace imgui
 {
 	std::shared_ptr<mq::imgui::ConsoleWidget> ConsoleWidget::Create(std::string_view id)
 	{
-		return std::make_shared<ImGuiZepConsole>(id);
+		return std::make_shared<ImGuiConsoleLines>(id);
 	}
 }
 
@@ -1071,22 +1083,22 @@ public:
 	int current_pid = GetCurrentProcessId();
 	int m_historyPos = -1;    // -1: new line, 0..History.Size-1 browsing history.
 	bool m_scrollToBottom = true;
-	std::unique_ptr<ImGuiZepConsole> m_zepEditor;
+	std::unique_ptr<ImGuiConsoleLines> m_console;
 	bool m_localEcho = true;
 
 
 	ImGuiConsole()
 	{
 		ZeroMemory(m_inputBuffer, lengthof(m_inputBuffer));
-		m_zepEditor = std::make_unique<ImGuiZepConsole>("##ZepConsole");
+		m_console = std::make_unique<ImGuiConsoleLines>("##ConsoleLines");
 
 		m_localEcho = GetPrivateProfileBool("Console", "LocalEcho", m_localEcho, internal_paths::MQini);
 
-		bool autoScroll = GetPrivateProfileBool("Console", "AutoScroll", m_zepEditor->GetAutoScroll(), internal_paths::MQini);
-		m_zepEditor->SetAutoScroll(autoScroll);
+		bool autoScroll = GetPrivateProfileBool("Console", "AutoScroll", m_console->GetAutoScroll(), internal_paths::MQini);
+		m_console->SetAutoScroll(autoScroll);
 
-		int maxBufferLines = GetPrivateProfileInt("Console", "MaxBufferLines", m_zepEditor->GetMaxBufferLines(), internal_paths::MQini);
-		m_zepEditor->SetMaxBufferLines(maxBufferLines);
+		int maxBufferLines = GetPrivateProfileInt("Console", "MaxBufferLines", m_console->GetMaxBufferLines(), internal_paths::MQini);
+		m_console->SetMaxBufferLines(maxBufferLines);
 		m_history = InitConsoleDatabase(m_db, current_pid);
 	}
 
@@ -1101,7 +1113,7 @@ public:
 
 	void ClearLog()
 	{
-		m_zepEditor->Clear();
+		m_console->Clear();
 	}
 
 	template <typename... Args>
@@ -1110,7 +1122,7 @@ public:
 		fmt::basic_memory_buffer<char> buf;
 		fmt::format_to(fmt::appender(buf), fmt, args...);
 
-		m_zepEditor->AppendFormattedText(std::string_view(buf.data(), buf.size()), color, false);
+		m_console->AppendFormattedText(std::string_view(buf.data(), buf.size()), color, false);
 	}
 
 	template <typename... Args>
@@ -1121,7 +1133,7 @@ public:
 
 	void AddWriteChatColorLog(const char* line, ImU32 defaultColor = s_defaultColor, bool newline = false)
 	{
-		m_zepEditor->AppendFormattedText(line, defaultColor, newline);
+		m_console->AppendFormattedText(line, defaultColor, newline);
 	}
 
 	void Draw(bool* pOpen)
@@ -1149,10 +1161,10 @@ public:
 		{
 			if (ImGui::BeginMenu("Options"))
 			{
-				bool autoScroll = m_zepEditor->GetAutoScroll();
+				bool autoScroll = m_console->GetAutoScroll();
 				if (ImGui::MenuItem("Auto-scroll", nullptr, &autoScroll))
 				{
-					m_zepEditor->SetAutoScroll(autoScroll);
+					m_console->SetAutoScroll(autoScroll);
 					WritePrivateProfileBool("Console", "AutoScroll", autoScroll, internal_paths::MQini);
 				}
 
@@ -1190,7 +1202,7 @@ public:
 						MakeColorGradient(.3f, .3f, .3f, 0, 2, 4);
 					}
 
-					if (m_zepEditor)
+					if (m_console)
 					{
 						if (ImGui::MenuItem("Hyperlink Test"))
 						{
@@ -1234,7 +1246,7 @@ public:
 		ImVec2 contentSize = ImGui::GetContentRegionAvail();
 		contentSize.y -= footer_height_to_reserve;
 
-		m_zepEditor->Render(contentSize);
+		m_console->Render(contentSize);
 
 		// Command-line
 		ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(2, 4));
@@ -1283,7 +1295,7 @@ public:
 	void ExecCommand(const char* commandLine)
 	{
 		if (GetLocalEcho())
-			AddLog(Zep::ZepColor(128, 128, 128), "> {0}\n", commandLine);
+			AddLog(IM_COL32(128, 128, 128, 255), "> {0}\n", commandLine);
 
 		// Insert into history. First find match and delete it so i can be pushed to the back. This isn't
 		// trying to be smart or optimal.
@@ -1444,35 +1456,16 @@ public:
 	void DoAchievementLinkTest()
 	{
 		std::string_view line = "You say to your guild, '\x12" "3TestToon^500010200^1^0^0^0^0^0^'Welcome to Crescent Reach (1+)\x12'";
-		m_zepEditor->AppendFormattedText(line, s_defaultColor, true);
+		m_console->AppendFormattedText(line, s_defaultColor, true);
 	}
 
 	void DoHyperlinkTest()
 	{
-		bool cursorAtEnd = m_zepEditor->GetWindow()->IsAtBottom();
-
 		static int hyperlinkNum = 1;
 		std::string text = fmt::format("This is hyperlink {}", hyperlinkNum++);
 
-		ZepTextAttribute attribute;
-		attribute.startIndex = 0;
-		attribute.endIndex = static_cast<int>(text.length());
-		attribute.attribute.type = ZepAttributeType::Hyperlink;
-		attribute.attribute.data = ZepAttribute::HyperlinkAttributeData{ fmt::format("testlink:{}'s data", text) };
-
-		// Append to end of buffer
-		Zep::GlyphIterator position = m_zepEditor->GetBuffer()->End();
-
-		ZepConsoleSyntax* syntax = static_cast<ZepConsoleSyntax*>(m_zepEditor->GetBuffer()->GetSyntax());
-		syntax->AddAttribute(position, std::move(attribute));
-
-		Zep::ChangeRecord changeRecord;
-		m_zepEditor->GetBuffer()->Insert(position, text + "\n", changeRecord);
-
-		if (cursorAtEnd)
-		{
-			m_zepEditor->TriggerAutoScroll();
-		}
+		m_console->AppendHyperlink(text, fmt::format("testlink:{}'s data", text));
+		m_console->AppendFormattedText("\n");
 	}
 
 	bool GetLocalEcho() const { return m_localEcho; }
@@ -1769,11 +1762,11 @@ static void ConsoleSettings()
 	{
 		ImGui::Text("Maximum Number of Buffer Lines");
 
-		int maxBufferLines = gImGuiConsole->m_zepEditor->GetMaxBufferLines();
+		int maxBufferLines = gImGuiConsole->m_console->GetMaxBufferLines();
 		if (ImGui::InputInt("##BufferLineMaxEntry", &maxBufferLines))
 		{
 			WritePrivateProfileInt("Console", "MaxBufferLines", maxBufferLines, internal_paths::MQini);
-			gImGuiConsole->m_zepEditor->SetMaxBufferLines(maxBufferLines);
+			gImGuiConsole->m_console->SetMaxBufferLines(maxBufferLines);
 		}
 
 		ImGui::SameLine();
@@ -0,0 +1,679 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace mq {
+
+static void IniCache_Initialize();
+static void IniCache_Shutdown();
+
+static MQModule s_iniCacheModule = {
+	"IniCache",                    // Name
+	false,                         // CanUnload
+	IniCache_Initialize,
+	IniCache_Shutdown,
+};
+DECLARE_MODULE_INITIALIZER(s_iniCacheModule);
+
+static uint32_t gIniCacheCheckInterval = 500;           // ms between checks for changes made by someone else
+static uint32_t gIniCacheFlushDelay = 1000;             // ms that writes are held before they go to disk
+
+// An ini file parsed into memory. Lookups follow the profile api: sections and keys are case
+// insensitive, the first of any duplicates wins, and values are trimmed with one pair of
+// surrounding quotes removed.
+struct MQCachedIniSection
+{
+	std::string Name;
+	std::vector<std::pair<std::string, std::string>> Entries;
+	ci_unordered::map<std::string, size_t> Keys;
+
+	const std::string* Find(const std::string& key) const
+	{
+		auto iter = Keys.find(key);
+		return iter == Keys.end() ? nullptr : &Entries[iter->second].second;
+	}
+
+	void Set(const std::string& key, const std::string& value)
+	{
+		auto iter = Keys.find(key);
+		if (iter != Keys.end())
+		{
+			Entries[iter->second].second = value;
+			return;
+		}
+
+		Keys.emplace(key, Entries.size());
+		Entries.emplace_back(key, value);
+	}
+
+	void Remove(const std::string& key)
+	{
+		auto iter = Keys.find(key);
+		if (iter == Keys.end())
+			return;
+
+		Entries.erase(Entries.begin() + iter->second);
+		Keys.clear();
+
+		for (size_t i = 0; i < Entries.size(); ++i)
+			Keys.emplace(Entries[i].first, i);
+	}
+};
+
+struct MQCachedIniWrite
+{
+	std::string Section;
+	std::optional<std::string> Key;                     // no key removes the section
+	std::optional<std::string> Value;                   // no value removes the key
+};
+
+struct MQCachedIniFile
+{
+	bool Exists = false;
+	std::filesystem::file_time_type LastWrite;
+	uintmax_t Size = 0;
+	std::chrono::steady_clock::time_point LastCheck;
+
+	std::vector<MQCachedIniSection> Sections;
+	ci_unordered::map<std::string, size_t> SectionIndex;
+
+	std::vector<MQCachedIniWrite> PendingWrites;
+	std::vector<MQCachedIniWrite> FlushingWrites;       // handed to the flush thread, not on disk yet
+	std::chrono::steady_clock::time_point FlushTime;
+
+	MQCachedIniSection* FindSection(const std::string& section)
+	{
+		auto iter = SectionIndex.find(section);
+		return iter == SectionIndex.end() ? nullptr : &Sections[iter->second];
+	}
+
+	void Apply(const MQCachedIniWrite& write)
+	{
+		if (!write.Key)
+		{
+			auto iter = SectionIndex.find(write.Section);
+			if (iter == SectionIndex.end())
+				return;
+
+			Sections.erase(Sections.begin() + iter->second);
+			SectionIndex.clear();
+
+			for (size_t i = 0; i < Sections.size(); ++i)
+				SectionIndex.emplace(Sections[i].Name, i);
+			return;
+		}
+
+		MQCachedIniSection* pSection = FindSection(write.Section);
+
+		if (!write.Value)
+		{
+			if (pSection)
+				pSection->Remove(*write.Key);
+			return;
+		}
+
+		if (!pSection)
+		{
+			SectionIndex.emplace(write.Section, Sections.size());
+			pSection = &Sections.emplace_back();
+			pSection->Name = write.Section;
+		}
+
+		pSection->Set(*write.Key, *write.Value);
+		Exists = true;
+	}
+};
+
+static std::string_view TrimIniText(std::string_view text)
+{
+	while (!text.empty() && (text.front() == ' ' || text.front() == '\t' || text.front() == '\r'))
+		text.remove_prefix(1);
+	while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+		text.remove_suffix(1);
+
+	return text;
+}
+
+static void ParseIniFile(MQCachedIniFile& file, const std::filesystem::path& path)
+{
+	file.Sections.clear();
+	file.SectionIndex.clear();
+
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return;
+
+	std::string line;
+	MQCachedIniSection* pSection = nullptr;
+	bool firstLine = true;
+
+	while (std::getline(stream, line))
+	{
+		std::string_view text = line;
+
+		if (firstLine && text.substr(0, 3) == "\xEF\xBB\xBF")
+			text.remove_prefix(3);
+		firstLine = false;
+
+		text = TrimIniText(text);
+		if (text.empty() || text[0] == ';')
+			continue;
+
+		if (text[0] == '[')
+		{
+			size_t end = text.find(']');
+			std::string name{ TrimIniText(text.substr(1, end == std::string_view::npos ? std::string_view::npos : end - 1)) };
+
+			auto iter = file.SectionIndex.find(name);
+			if (iter != file.SectionIndex.end())
+			{
+				pSection = &file.Sections[iter->second];
+			}
+			else
+			{
+				file.SectionIndex.emplace(name, file.Sections.size());
+				pSection = &file.Sections.emplace_back();
+				pSection->Name = std::move(name);
+			}
+			continue;
+		}
+
+		if (!pSection)
+			continue;
+
+		size_t pos = text.find('=');
+		std::string key{ TrimIniText(text.substr(0, pos)) };
+		std::string_view value = pos == std::string_view::npos ? std::string_view{} : TrimIniText(text.substr(pos + 1));
+
+		if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+		{
+			value = value.substr(1, value.size() - 2);
+		}
+
+		if (pSection->Keys.find(key) == pSection->Keys.end())
+		{
+			pSection->Keys.emplace(key, pSection->Entries.size());
+			pSection->Entries.emplace_back(std::move(key), std::string{ value });
+		}
+	}
+}
+
+// Drops writes that a later write in the same batch makes redundant, keeping the rest in order: an
+// earlier value for the same key, or anything in a section that is removed afterwards.
+static void CoalesceIniWrites(std::vector<MQCachedIniWrite>& writes)
+{
+	if (writes.size() < 2)
+		return;
+
+	ci_unordered::set<std::string> seenKeys;
+	ci_unordered::set<std::string> removedSections;
+	std::vector<MQCachedIniWrite> coalesced;
+
+	for (auto iter = writes.rbegin(); iter != writes.rend(); ++iter)
+	{
+		if (removedSections.count(iter->Section))
+			continue;
+
+		if (!iter->Key)
+		{
+			removedSections.insert(iter->Section);
+		}
+		else if (!seenKeys.insert(iter->Section + '\n' + *iter->Key).second)
+		{
+			continue;
+		}
+
+		coalesced.push_back(std::move(*iter));
+	}
+
+	writes.assign(std::make_move_iterator(coalesced.rbegin()), std::make_move_iterator(coalesced.rend()));
+}
+
+static void WriteIniFile(const std::string& iniFile, const std::vector<MQCachedIniWrite>& writes)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path{ iniFile }.parent_path(), ec);
+
+	for (const MQCachedIniWrite& write : writes)
+	{
+		if (!::WritePrivateProfileStringA(write.Section.c_str(),
+			write.Key ? write.Key->c_str() : nullptr,
+			write.Value ? write.Value->c_str() : nullptr,
+			iniFile.c_str()))
+		{
+			DebugSpewAlways("Failed to write to INI: %s", iniFile.c_str());
+		}
+	}
+}
+
+// Keeps every ini file that has been read through it parsed in memory. Files are checked for
+// outside changes at most every gIniCacheCheckInterval. Writes are applied to the cached copy right
+// away and written out by a background thread once they have waited gIniCacheFlushDelay, so a
+// window being dragged or a macro writing in a loop only touches the disk once per file, and never
+// on the game thread.
+class IniCache
+{
+public:
+	~IniCache()
+	{
+		// IniCache_Shutdown stops the thread. Joining it here could wait on the loader lock.
+		if (m_thread.joinable())
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_cv.notify_one();
+			m_thread.detach();
+		}
+	}
+
+	void Start()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (!m_thread.joinable())
+		{
+			m_stop = false;
+			m_thread = std::thread([this]() { FlushThread(); });
+		}
+	}
+
+	void Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_cv.notify_one();
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+		Flush();
+	}
+
+	template <typename T>
+	auto Read(const std::string& iniFile, T&& reader)
+	{
+		std::scoped_lock lock(m_mutex);
+		return reader(GetFile(iniFile));
+	}
+
+	void Write(const std::string& iniFile, MQCachedIniWrite write)
+	{
+		bool direct = false;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			MQCachedIniFile& file = GetFile(iniFile);
+
+			// Settings are often saved back unchanged, like a window's position every time the UI
+			// reloads. Those don't need to go to disk.
+			if (write.Key && write.Value)
+			{
+				MQCachedIniSection* pSection = file.FindSection(write.Section);
+				const std::string* current = pSection ? pSection->Find(*write.Key) : nullptr;
+				if (current && *current == *write.Value)
+					return;
+			}
+
+			file.Apply(write);
+
+			direct = m_stop || !m_thread.joinable();
+			if (!direct)
+			{
+				if (file.PendingWrites.empty())
+					file.FlushTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(gIniCacheFlushDelay);
+				file.PendingWrites.push_back(std::move(write));
+			}
+		}
+
+		// without the flush thread there is nobody to hand the write to
+		if (direct)
+		{
+			std::scoped_lock writeLock(m_writeMutex);
+			WriteIniFile(iniFile, { std::move(write) });
+		}
+	}
+
+	// Writes out everything that is pending, regardless of how long it has been waiting.
+	void Flush()
+	{
+		FlushDue(std::chrono::steady_clock::time_point::max());
+	}
+
+	void Clear()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_files.clear();
+	}
+
+private:
+	MQCachedIniFile& GetFile(const std::string& iniFile)
+	{
+		auto [iter, inserted] = m_files.try_emplace(iniFile);
+		MQCachedIniFile& file = iter->second;
+
+		auto now = std::chrono::steady_clock::now();
+		if (inserted || now - file.LastCheck >= std::chrono::milliseconds(gIniCacheCheckInterval))
+		{
+			file.LastCheck = now;
+
+			std::error_code ec;
+			const std::filesystem::path path = iniFile;
+			bool exists = std::filesystem::exists(path, ec);
+			auto lastWrite = exists ? std::filesystem::last_write_time(path, ec) : std::filesystem::file_time_type{};
+			uintmax_t size = exists ? std::filesystem::file_size(path, ec) : 0;
+
+			if (inserted || exists != file.Exists || lastWrite != file.LastWrite || size != file.Size)
+			{
+				file.Exists = exists;
+				file.LastWrite = lastWrite;
+				file.Size = size;
+
+				ParseIniFile(file, path);
+
+				// anything that hasn't made it to disk yet still needs to be visible
+				for (const MQCachedIniWrite& write : file.FlushingWrites)
+					file.Apply(write);
+				for (const MQCachedIniWrite& write : file.PendingWrites)
+					file.Apply(write);
+			}
+		}
+
+		return file;
+	}
+
+	// Writes out every file whose oldest pending write is due by the given time. Returns when the
+	// next file will be due. m_writeMutex keeps writes to a file in order when a Flush() from the game
+	// thread overlaps with the flush thread.
+	std::chrono::steady_clock::time_point FlushDue(std::chrono::steady_clock::time_point due)
+	{
+		std::scoped_lock writeLock(m_writeMutex);
+		std::vector<std::pair<std::string, std::vector<MQCachedIniWrite>>> batches;
+		auto next = std::chrono::steady_clock::time_point::max();
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			for (auto& [path, file] : m_files)
+			{
+				if (file.PendingWrites.empty())
+					continue;
+
+				if (file.FlushTime > due)
+				{
+					next = std::min(next, file.FlushTime);
+					continue;
+				}
+
+				file.FlushingWrites = std::move(file.PendingWrites);
+				file.PendingWrites.clear();
+				CoalesceIniWrites(file.FlushingWrites);
+
+				batches.emplace_back(path, file.FlushingWrites);
+			}
+		}
+
+		for (const auto& [path, writes] : batches)
+		{
+			WriteIniFile(path, writes);
+		}
+
+		if (!batches.empty())
+		{
+			std::scoped_lock lock(m_mutex);
+
+			for (const auto& batch : batches)
+			{
+				auto iter = m_files.find(batch.first);
+				if (iter == m_files.end())
+					continue;
+
+				// pick up the result on the next read, the profile api may have formatted things differently.
+				iter->second.FlushingWrites.clear();
+				iter->second.LastCheck = {};
+				iter->second.LastWrite = {};
+			}
+		}
+
+		return next;
+	}
+
+	void FlushThread()
+	{
+		auto next = std::chrono::steady_clock::time_point::max();
+
+		while (true)
+		{
+			{
+				std::unique_lock lock(m_mutex);
+				if (m_stop)
+					return;
+
+				// a new write may be due sooner than anything we knew about
+				std::chrono::steady_clock::time_point wakeTime = std::min(next,
+					std::chrono::steady_clock::now() + std::chrono::milliseconds(gIniCacheFlushDelay));
+				m_cv.wait_until(lock, wakeTime, [this]() { return m_stop; });
+
+				if (m_stop)
+					return;
+			}
+
+			next = FlushDue(std::chrono::steady_clock::now());
+		}
+	}
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::mutex m_writeMutex;
+	std::condition_variable m_cv;
+	ci_unordered::map<std::string, MQCachedIniFile> m_files;
+	bool m_stop = false;
+};
+static IniCache s_iniCache;
+
+// Copies strings into a profile api style buffer: each one null terminated, with an extra null at
+// the end of the list. Returns the number of characters copied, not counting the final null.
+static int CopyIniList(const std::vector<std::string_view>& strings, char* buffer, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	if (size < 2 || strings.empty())
+	{
+		buffer[0] = 0;
+		if (size >= 2)
+			buffer[1] = 0;
+		return 0;
+	}
+
+	size_t pos = 0;
+	for (std::string_view str : strings)
+	{
+		if (pos + str.size() + 2 > size)
+		{
+			// truncated, the api reports this as size - 2
+			size_t count = size - 2 - pos;
+			memcpy(buffer + pos, str.data(), count);
+			buffer[size - 2] = 0;
+			buffer[size - 1] = 0;
+			return static_cast<int>(size - 2);
+		}
+
+		memcpy(buffer + pos, str.data(), str.size());
+		pos += str.size();
+		buffer[pos++] = 0;
+	}
+
+	buffer[pos] = 0;
+	return static_cast<int>(pos);
+}
+
+static int CopyIniValue(std::string_view value, char* buffer, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	size_t count = std::min(value.size(), size - 1);
+	memcpy(buffer, value.data(), count);
+	buffer[count] = 0;
+	return static_cast<int>(count);
+}
+
+int GetCachedPrivateProfileString(const std::string& section, const std::string& key, const std::string& defaultValue,
+	char* buffer, size_t size, const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [&](MQCachedIniFile& file)
+		{
+			if (section.empty())
+			{
+				std::vector<std::string_view> names;
+				for (const MQCachedIniSection& iniSection : file.Sections)
+					names.push_back(iniSection.Name);
+
+				return CopyIniList(names, buffer, size);
+			}
+
+			MQCachedIniSection* pSection = file.FindSection(section);
+
+			if (key.empty())
+			{
+				std::vector<std::string_view> keys;
+				if (pSection)
+				{
+					for (const auto& entry : pSection->Entries)
+						keys.push_back(entry.first);
+				}
+
+				return CopyIniList(keys, buffer, size);
+			}
+
+			const std::string* value = pSection ? pSection->Find(key) : nullptr;
+			return CopyIniValue(value ? std::string_view{ *value } : TrimIniText(defaultValue), buffer, size);
+		});
+}
+
+std::string GetCachedPrivateProfileString(const std::string& section, const std::string& key, const std::string& defaultValue,
+	const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [&](MQCachedIniFile& file)
+		{
+			MQCachedIniSection* pSection = file.FindSection(section);
+			const std::string* value = pSection ? pSection->Find(key) : nullptr;
+
+			return value ? *value : std::string{ TrimIniText(defaultValue) };
+		});
+}
+
+int GetCachedPrivateProfileInt(const std::string& section, const std::string& key, int defaultValue, const std::string& iniFile)
+{
+	std::string value = GetCachedPrivateProfileString(section, key, "", iniFile);
+	if (value.empty())
+		return defaultValue;
+
+	// GetPrivateProfileInt reads leading digits and ignores the rest
+	return static_cast<int>(strtol(value.c_str(), nullptr, 10));
+}
+
+bool GetCachedPrivateProfileBool(const std::string& section, const std::string& key, bool defaultValue, const std::string& iniFile)
+{
+	return GetBoolFromString(GetCachedPrivateProfileString(section, key, "", iniFile), defaultValue);
+}
+
+std::vector<std::string> GetCachedPrivateProfileSections(const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [&](MQCachedIniFile& file)
+		{
+			std::vector<std::string> sections;
+			sections.reserve(file.Sections.size());
+
+			for (const MQCachedIniSection& section : file.Sections)
+				sections.push_back(section.Name);
+
+			return sections;
+		});
+}
+
+std::vector<std::pair<std::string, std::string>> GetCachedPrivateProfileKeyValues(const std::string& section, const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [&](MQCachedIniFile& file)
+		{
+			MQCachedIniSection* pSection = file.FindSection(section);
+			return pSection ? pSection->Entries : std::vector<std::pair<std::string, std::string>>{};
+		});
+}
+
+bool CachedIniFileExists(const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [](MQCachedIniFile& file) { return file.Exists; });
+}
+
+bool CachedIniKeyExists(const std::string& section, const std::string& key, const std::string& iniFile)
+{
+	return s_iniCache.Read(iniFile, [&](MQCachedIniFile& file)
+		{
+			MQCachedIniSection* pSection = file.FindSection(section);
+			return pSection && pSection->Find(key) != nullptr;
+		});
+}
+
+void WriteCachedPrivateProfileString(const std::string& section, const char* key, const char* value, const std::string& iniFile)
+{
+	MQCachedIniWrite write;
+	write.Section = section;
+	if (key)
+		write.Key = key;
+	if (value)
+		write.Value = value;
+
+	s_iniCache.Write(iniFile, std::move(write));
+}
+
+void FlushIniCache()
+{
+	s_iniCache.Flush();
+}
+
+static void IniCache_Initialize()
+{
+	gIniCacheCheckInterval = GetPrivateProfileInt("MacroQuest", "IniCacheCheckInterval", gIniCacheCheckInterval, mq::internal_paths::MQini);
+	gIniCacheFlushDelay = GetPrivateProfileInt("MacroQuest", "IniCacheFlushDelay", gIniCacheFlushDelay, mq::internal_paths::MQini);
+	if (gbWriteAllConfig)
+	{
+		WritePrivateProfileInt("MacroQuest", "IniCacheCheckInterval", gIniCacheCheckInterval, mq::internal_paths::MQini);
+		WritePrivateProfileInt("MacroQuest", "IniCacheFlushDelay", gIniCacheFlushDelay, mq::internal_paths::MQini);
+	}
+
+	s_iniCache.Start();
+}
+
+static void IniCache_Shutdown()
+{
+	s_iniCache.Stop();
+	s_iniCache.Clear();
+}
+
+} // namespace mq
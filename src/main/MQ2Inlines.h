@@ -428,10 +428,7 @@ inline bool LineOfSight(SPAWNINFO* Origin, const CVector3& position)
 
 inline bool LineOfSight(SPAWNINFO* Origin, SPAWNINFO* CanISeeThis)
 {
-	if (!Origin || !CanISeeThis)
-		return false;
-
-	return Origin->CanSee(*CanISeeThis);
+	return CanSeeSpawn(Origin, CanISeeThis);
 }
 
 inline bool IsMobFleeing(SPAWNINFO* pChar, SPAWNINFO* pSpawn)
@@ -18,9 +18,14 @@
 #include "mq/api/Main.h"
 #include "mq/api/Plugin.h"
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 
@@ -229,34 +234,189 @@ struct MQWhoSort
 using WHOSORT DEPRECATE("Use MQWhoSort instead of WHOSORT") = MQWhoSort;
 using PWHOSORT DEPRECATE("Use MQWhoSort* instead PWHOSORT") = MQWhoSort*;
 
+struct MQCommand;
+struct MQCompiledMacroString;
+
+// A macro line with its command already resolved. Produced by CompileMacroLine when the macro is
+// loaded, and checked against the command generation before every use so that commands and aliases
+// that change while the macro runs are picked up again.
+struct MQCompiledCommand
+{
+	enum class Kind
+	{
+		Unresolved,                            // not compiled yet, or needs to be compiled again
+		Fallback,                              // executed through DoCommand
+		Skip,                                  // labels and opening braces
+		Command,                               // dispatched directly to Command
+	};
+
+	Kind CommandKind = Kind::Unresolved;
+	MQCommand* Command = nullptr;
+	std::string Parameters;
+	std::shared_ptr<const MQCompiledMacroString> CompiledParameters;
+
+	// For /if and /while, the "(condition)" and the rest of the parameters, compiled separately.
+	std::shared_ptr<const MQCompiledMacroString> CompiledCondition;
+	std::shared_ptr<const MQCompiledMacroString> CompiledConditionRest;
+
+	uint32_t Generation = 0;
+	int GameState = -1;
+};
+
+// The name of a macro source file. Every line loaded from a file shares one copy of its name,
+// held in a pool for the rest of the session. The pool only grows by the files that get loaded.
+class MQSourceFileName
+{
+public:
+	MQSourceFileName() = default;
+	explicit MQSourceFileName(std::string_view name);
+
+	const std::string& str() const
+	{
+		static const std::string empty;
+		return m_name ? *m_name : empty;
+	}
+
+	const char* c_str() const { return str().c_str(); }
+
+private:
+	const std::string* m_name = nullptr;
+};
+
 struct MQMacroLine
 {
 	std::string Command;
+	MQCompiledCommand Compiled;
 
 	int LoopStart = 0;
 	// used for loops/while if its 0 no action is taken, otherwise it will jump to the line indicated.
 	int LoopEnd = 0;
 
-	std::string SourceFile;
+	MQSourceFileName SourceFile;
 	int LineNumber = 0;
 
-#ifdef MQ2_PROFILING
+	// Filled in while a /profile session is running.
 	int ExecutionCount = 0;
-	uint64_t ExecutionTime = 0;
-#endif
+	uint64_t ExecutionTime = 0;                 // nanoseconds
 
-	MQMacroLine(std::string Line, std::string sourceFile, int lineNumber)
+	MQMacroLine(std::string Line, MQSourceFileName sourceFile, int lineNumber)
 		: Command(std::move(Line))
-		, SourceFile(std::move(sourceFile))
+		, SourceFile(sourceFile)
 		, LineNumber(lineNumber)
 	{}
 
 	MQMacroLine(const MQMacroLine&) = delete;
 	MQMacroLine& operator=(const MQMacroLine&) = delete;
+
+	MQMacroLine(MQMacroLine&&) = default;
+	MQMacroLine& operator=(MQMacroLine&&) = default;
 };
 using MACROLINE DEPRECATE("Use MQMacroLine instead MACROLINE") = MQMacroLine;
 using PMACROLINE DEPRECATE("Use MQMacroLine* instead of PMACROLINE") = MQMacroLine;
 
+// The lines of a macro, ordered by macro line number. Lines are stored contiguously and a line
+// number is resolved to its slot through a dense table, so finding a line and stepping to the next
+// one are both constant time. Lines are only added while the macro is loaded, references to lines
+// are not stable until loading has finished.
+class MQMacroLines
+{
+public:
+	using value_type = std::pair<int, MQMacroLine>;
+	using container_type = std::vector<value_type>;
+	using iterator = container_type::iterator;
+	using const_iterator = container_type::const_iterator;
+	using reverse_iterator = container_type::reverse_iterator;
+	using const_reverse_iterator = container_type::const_reverse_iterator;
+
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(int lineNumber, Args&&... args)
+	{
+		if (lineNumber < 0)
+			return { m_lines.end(), false };
+
+		if (lineNumber >= static_cast<int>(m_slots.size()))
+			m_slots.resize(lineNumber + 1, -1);
+		else if (m_slots[lineNumber] != -1)
+			return { m_lines.begin() + m_slots[lineNumber], false };
+
+		// Line numbers are increasing while loading, so this is almost always an append.
+		auto pos = m_lines.end();
+		if (!m_lines.empty() && m_lines.back().first > lineNumber)
+		{
+			pos = std::lower_bound(m_lines.begin(), m_lines.end(), lineNumber,
+				[](const value_type& line, int number) { return line.first < number; });
+		}
+
+		auto iter = m_lines.emplace(pos, std::piecewise_construct,
+			std::forward_as_tuple(lineNumber), std::forward_as_tuple(std::forward<Args>(args)...));
+
+		for (auto update = iter; update != m_lines.end(); ++update)
+			m_slots[update->first] = static_cast<int>(update - m_lines.begin());
+
+		return { iter, true };
+	}
+
+	iterator find(int lineNumber)
+	{
+		const int slot = GetSlot(lineNumber);
+		return slot == -1 ? m_lines.end() : m_lines.begin() + slot;
+	}
+
+	const_iterator find(int lineNumber) const
+	{
+		const int slot = GetSlot(lineNumber);
+		return slot == -1 ? m_lines.end() : m_lines.begin() + slot;
+	}
+
+	MQMacroLine& at(int lineNumber)
+	{
+		const int slot = GetSlot(lineNumber);
+		if (slot == -1)
+			throw std::out_of_range("invalid macro line");
+
+		return m_lines[slot].second;
+	}
+
+	const MQMacroLine& at(int lineNumber) const
+	{
+		const int slot = GetSlot(lineNumber);
+		if (slot == -1)
+			throw std::out_of_range("invalid macro line");
+
+		return m_lines[slot].second;
+	}
+
+	iterator begin() { return m_lines.begin(); }
+	iterator end() { return m_lines.end(); }
+	const_iterator begin() const { return m_lines.begin(); }
+	const_iterator end() const { return m_lines.end(); }
+	reverse_iterator rbegin() { return m_lines.rbegin(); }
+	reverse_iterator rend() { return m_lines.rend(); }
+	const_reverse_iterator rbegin() const { return m_lines.rbegin(); }
+	const_reverse_iterator rend() const { return m_lines.rend(); }
+
+	bool empty() const { return m_lines.empty(); }
+	size_t size() const { return m_lines.size(); }
+
+	void clear()
+	{
+		m_lines.clear();
+		m_slots.clear();
+	}
+
+private:
+	int GetSlot(int lineNumber) const
+	{
+		if (lineNumber < 0 || lineNumber >= static_cast<int>(m_slots.size()))
+			return -1;
+
+		return m_slots[lineNumber];
+	}
+
+	container_type m_lines;
+	std::vector<int> m_slots;                   // line number -> index into m_lines, or -1
+};
+
 struct MQMacroBlock
 {
 	std::string Name;                           // our macro Name
@@ -264,7 +424,7 @@ struct MQMacroBlock
 	int CurrIndex = 0;                          // the current macro line we are on
 	int BindStackIndex = -1;                    // where we were at before calling the bind.
 	std::string BindCmd;                        // the actual command including parameters
-	std::map<int, MQMacroLine> Line;
+	MQMacroLines Line;
 	bool Removed = false;
 
 	MQMacroBlock(std::string name) : Name(std::move(name)) {}
@@ -281,9 +441,19 @@ struct MQTimer
 {
 	std::string Name;
 	uint32_t Original = 0;
-	uint32_t Current = 0;
+	uint64_t Deadline = 0;                      // timer tick this runs out on, 0 if it isn't running
 	MQTimer* pNext = nullptr;
 	MQTimer* pPrev = nullptr;
+
+	MQTimer() = default;
+	MQLIB_OBJECT ~MQTimer();
+
+	MQTimer(const MQTimer&) = delete;
+	MQTimer& operator=(const MQTimer&) = delete;
+
+	// Remaining time in 100ms ticks
+	MQLIB_OBJECT uint32_t GetCurrent() const;
+	MQLIB_OBJECT void SetCurrent(uint32_t value);
 };
 using MQTIMER DEPRECATE("Use MQTimer instead of MQTIMER") = MQTimer;
 using PMQTIMER DEPRECATE("Use MQTimer* instead of PMQTIMER") = MQTimer*;
@@ -307,16 +477,16 @@ using PITEMDB DEPRECATE("Use ITEMDB* instead of PITEMDB") = ITEMDB*;
 
 struct MQDefine
 {
-	char szName[MAX_STRING];
-	char szReplace[MAX_STRING];
+	std::string Name;
+	std::string Replace;
 
 	MQDefine* pNext = nullptr;
 };
 
 struct MQEventList
 {
-	char szName[MAX_STRING];
-	char szMatch[MAX_STRING];
+	std::string Name;
+	std::string Match;
 	int pEventFunc = 0;
 	DWORD BlechID = 0;
 
@@ -384,6 +554,7 @@ struct MQModule
 };
 
 void InitializeInternalModules();
+void InitializeDeferredModules();
 void AddInternalModule(MQModule* module, bool manualUnload = false);
 void RemoveInternalModule(MQModule* module);
 
@@ -392,14 +563,19 @@ void AddStaticInitializationModule(ModuleInitializer* module);
 
 struct ModuleInitializer
 {
-	ModuleInitializer(MQModule* thisModule)
+	ModuleInitializer(MQModule* thisModule, bool deferred = false)
 		: module(thisModule)
+		, deferred(deferred)
 	{
 		AddStaticInitializationModule(this);
 	}
 
 	ModuleInitializer* next = nullptr;
 	MQModule* module = nullptr;
+
+	// Deferred modules are not initialized during startup. They are brought up one per
+	// pulse once the ui is running.
+	bool deferred = false;
 };
 
 #if _M_AMD64
@@ -412,6 +588,10 @@ struct ModuleInitializer
 		extern "C" ModuleInitializer s_moduleInitializer ## moduleRecord { &moduleRecord } \
 		FORCE_UNDEFINED_SYMBOL(s_moduleInitializer ## moduleRecord);
 
+#define DECLARE_DEFERRED_MODULE_INITIALIZER(moduleRecord) \
+		extern "C" ModuleInitializer s_moduleInitializer ## moduleRecord { &moduleRecord, true } \
+		FORCE_UNDEFINED_SYMBOL(s_moduleInitializer ## moduleRecord);
+
 //============================================================================
 
 class CMQ2Alerts
@@ -430,9 +610,13 @@ public:
 	MQLIB_OBJECT bool ListAlerts(char* szOut, size_t max);
 	MQLIB_OBJECT void FreeAlerts(uint32_t id);
 
+	// Changes whenever any alert list changes.
+	uint32_t GetVersion() const { return m_version; }
+
 private:
 	mutable std::mutex m_mutex;
 	std::map<uint32_t, std::vector<MQSpawnSearch>> m_alertMap;
+	std::atomic<uint32_t> m_version{ 0 };
 };
 
 //============================================================================
@@ -666,6 +850,12 @@ struct MQMacroStack
 	int LocationIndex = 0;
 	MQDataVar* Parameters = nullptr;
 	MQDataVar* LocalVariables = nullptr;
+
+	// Name lookup for Parameters and LocalVariables, maintained by the variable functions in
+	// MQ2DataVars.cpp. It is rebuilt from the lists on the next lookup when not valid.
+	std::unordered_map<std::string_view, MQDataVar*> VariableIndex;
+	bool VariableIndexValid = false;
+
 	std::vector<MQLoop> loopStack;
 	std::string Return;
 
@@ -702,6 +892,11 @@ struct MQEventQueue
 	std::string   Name;
 	MQEventList*  pEventList = nullptr;
 	MQDataVar*    Parameters = nullptr;
+
+	// Links to the other queued events that run the same sub, oldest first.
+	MQEventQueue* pPrevSame = nullptr;
+	MQEventQueue* pNextSame = nullptr;
+	uint64_t      Sequence = 0;
 };
 using EVENTQUEUE DEPRECATE("Use MQEventQueue instead of EVENTQUEUE") = MQEventQueue;
 using PEVENTQUEUE DEPRECATE("Use MQEventQueue* instead of PEVENTQUEUE") = MQEventQueue *;
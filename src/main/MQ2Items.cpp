@@ -16,10 +16,12 @@
 #include "MQ2Main.h"
 #include "MQ2DeveloperTools.h"
 
+#include <mq/api/Inventory.h>
 #include <mq/imgui/ImGuiUtils.h>
 #include <mq/imgui/Widgets.h>
 
 #include <chrono>
+#include <deque>
 
 using namespace std::chrono_literals;
 
@@ -538,6 +540,337 @@ ItemContainerInspector* s_itemContainerInspector = nullptr;
 
 //----------------------------------------------------------------------------
 
+#pragma region Item Moves
+
+// A slot that an item could be moved into, as it will be once the moves planned so far are made.
+struct PlannedSlot
+{
+	ItemGlobalIndex index;
+	ItemPtr pBag;                            // the bag the slot is in, null for a top level slot
+	int itemID = 0;                          // zero while the slot is empty
+	int count = 0;
+	int maxCount = 0;
+};
+
+static void AddPlannedSlots(std::vector<PlannedSlot>& slots, ItemContainer& container,
+	ItemContainerInstance location, int firstSlot, int lastSlot)
+{
+	for (int slot = firstSlot; slot <= lastSlot; ++slot)
+	{
+		ItemPtr pItem = container.GetItem(slot);
+
+		if (!pItem)
+		{
+			slots.push_back({ ItemGlobalIndex(location, slot, -1) });
+		}
+		else if (pItem->IsContainer())
+		{
+			ItemContainer& heldItems = pItem->GetHeldItems();
+
+			for (int bagSlot = 0; bagSlot < static_cast<int>(heldItems.GetSize()); ++bagSlot)
+			{
+				PlannedSlot& planned = slots.emplace_back();
+				planned.index = ItemGlobalIndex(location, slot, bagSlot);
+				planned.pBag = pItem;
+
+				if (ItemPtr pHeld = heldItems.GetItem(bagSlot))
+				{
+					planned.itemID = pHeld->GetID();
+					planned.count = pHeld->IsStackable() ? pHeld->GetItemCount() : 0;
+					planned.maxCount = pHeld->IsStackable() ? pHeld->GetMaxItemCount() : 0;
+				}
+			}
+		}
+		else if (pItem->IsStackable())
+		{
+			PlannedSlot& planned = slots.emplace_back();
+			planned.index = ItemGlobalIndex(location, slot, -1);
+			planned.itemID = pItem->GetID();
+			planned.count = pItem->GetItemCount();
+			planned.maxCount = pItem->GetMaxItemCount();
+		}
+	}
+}
+
+static PlannedSlot* FindPlannedSlot(std::vector<PlannedSlot>& slots, const ItemPtr& pItem)
+{
+	const int itemID = pItem->GetID();
+	const int count = pItem->GetItemCount();
+
+	if (pItem->IsStackable())
+	{
+		for (PlannedSlot& slot : slots)
+		{
+			if (slot.itemID == itemID && slot.count + count <= slot.maxCount)
+				return &slot;
+		}
+	}
+
+	// Bag slots first, so that top level slots are left for bags.
+	for (PlannedSlot& slot : slots)
+	{
+		if (slot.itemID == 0 && slot.pBag && pItem->CanGoInBag(slot.pBag))
+			return &slot;
+	}
+
+	for (PlannedSlot& slot : slots)
+	{
+		if (slot.itemID == 0 && !slot.pBag)
+			return &slot;
+	}
+
+	return nullptr;
+}
+
+std::vector<MQItemMove> PlanItemMoves(const std::vector<ItemGlobalIndex>& items, ItemContainerInstance destination)
+{
+	std::vector<MQItemMove> moves;
+
+	PcProfile* pProfile = GetPcProfile();
+	if (!pLocalPC || !pProfile)
+		return moves;
+
+	std::vector<PlannedSlot> slots;
+
+	if (destination == eItemContainerBank)
+		AddPlannedSlots(slots, pLocalPC->BankItems, eItemContainerBank, 0, GetAvailableBankSlots() - 1);
+	else if (destination == eItemContainerPossessions)
+		AddPlannedSlots(slots, pProfile->InventoryContainer, eItemContainerPossessions, InvSlot_FirstBagSlot, GetHighestAvailableBagSlot());
+	else
+		return moves;
+
+	// Going through the sources bag by bag keeps each bag from being opened more than once.
+	std::vector<ItemGlobalIndex> sources = items;
+	std::sort(std::begin(sources), std::end(sources),
+		[](const ItemGlobalIndex& a, const ItemGlobalIndex& b)
+		{
+			return std::make_tuple(a.GetLocation(), a.GetTopSlot(), a.GetIndex().GetSlot(1))
+				< std::make_tuple(b.GetLocation(), b.GetTopSlot(), b.GetIndex().GetSlot(1));
+		});
+
+	moves.reserve(sources.size());
+
+	for (const ItemGlobalIndex& source : sources)
+	{
+		ItemPtr pItem = pLocalPC->GetItemByGlobalIndex(source);
+		if (!pItem)
+			continue;
+
+		// A bag can only be moved once it is empty.
+		if (pItem->IsContainer() && !pItem->IsEmpty())
+			continue;
+
+		PlannedSlot* pSlot = FindPlannedSlot(slots, pItem);
+		if (!pSlot)
+			continue;
+
+		moves.push_back({ source, pSlot->index, 0 });
+
+		if (pSlot->itemID == 0)
+		{
+			pSlot->itemID = pItem->GetID();
+			pSlot->maxCount = pItem->IsStackable() ? pItem->GetMaxItemCount() : 0;
+		}
+		pSlot->count += pItem->IsStackable() ? pItem->GetItemCount() : 0;
+	}
+
+	return moves;
+}
+
+// Moves that are sent together. The server makes them all in one go, so this is how far ahead of
+// the server we run.
+static constexpr size_t ITEM_MOVES_PER_BATCH = 20;
+// How long to wait for the server to make the moves that were sent before giving up on them.
+static constexpr uint64_t ITEM_MOVE_TIMEOUT = 5000;
+
+struct SentItemMove
+{
+	MQItemMove move;
+	int itemID;
+	int count;
+};
+
+static std::deque<MQItemMove> s_pendingItemMoves;
+static std::vector<SentItemMove> s_sentItemMoves;
+static uint64_t s_sentItemMovesDeadline = 0;
+static MQItemMovesCallback s_itemMovesCallback;
+static bool s_movingItems = false;
+static int s_itemsMoved = 0;
+static int s_itemsFailed = 0;
+
+bool MoveItems(std::vector<MQItemMove> moves, MQItemMovesCallback callback)
+{
+	if (s_movingItems || moves.empty())
+		return false;
+
+	s_pendingItemMoves.assign(std::begin(moves), std::end(moves));
+	s_itemMovesCallback = std::move(callback);
+	s_itemsMoved = 0;
+	s_itemsFailed = 0;
+	s_movingItems = true;
+
+	return true;
+}
+
+bool IsMovingItems()
+{
+	return s_movingItems;
+}
+
+void CancelItemMoves(bool callCallback)
+{
+	if (!callCallback)
+		s_itemMovesCallback = nullptr;
+
+	s_itemsFailed += static_cast<int>(s_pendingItemMoves.size());
+	s_pendingItemMoves.clear();
+}
+
+static bool SendItemMoves(const std::vector<SentItemMove>& moves)
+{
+#if HAS_MULTIPLE_ITEM_MOVE_MANAGER
+	MultipleItemMoveManager::MoveItemArray moveArray;
+
+	for (const SentItemMove& sent : moves)
+	{
+		MultipleItemMoveManager::MoveItem moveItem;
+		moveItem.from = sent.move.From;
+		moveItem.to = sent.move.To;
+		moveItem.flags = MultipleItemMoveManager::MoveItemFlagSwapEnabled;
+		moveItem.count = sent.move.Count;
+		moveArray.Add(moveItem);
+	}
+
+	return MultipleItemMoveManager::ProcessMove(pLocalPC, moveArray) == MultipleItemMoveManager::ErrorOk;
+#else
+	// Without the move manager every move has to go through the cursor, one at a time.
+	const MQItemMove& move = moves.front().move;
+
+	return PickupItem(move.From) && ItemOnCursor() && DropItem(move.To);
+#endif
+}
+
+static bool IsSameSlot(const ItemGlobalIndex& a, const ItemGlobalIndex& b)
+{
+	return a.GetLocation() == b.GetLocation()
+		&& a.GetTopSlot() == b.GetTopSlot()
+		&& a.GetIndex().GetSlot(1) == b.GetIndex().GetSlot(1);
+}
+
+// The move is made once the item has left the slot it came from.
+static bool IsItemMoveDone(const SentItemMove& sent)
+{
+	ItemPtr pItem = pLocalPC->GetItemByGlobalIndex(sent.move.From);
+
+	return !pItem || pItem->GetID() != sent.itemID || pItem->GetItemCount() < sent.count;
+}
+
+static void FinishItemMoves()
+{
+	s_movingItems = false;
+	s_pendingItemMoves.clear();
+	s_sentItemMoves.clear();
+
+	if (MQItemMovesCallback callback = std::move(s_itemMovesCallback))
+		callback(s_itemsMoved, s_itemsFailed);
+
+	s_itemMovesCallback = nullptr;
+}
+
+static void PulseItemMoves()
+{
+	if (!s_movingItems)
+		return;
+
+	if (!pLocalPC || gGameState != GAMESTATE_INGAME)
+	{
+		s_itemsFailed += static_cast<int>(s_sentItemMoves.size());
+		CancelItemMoves();
+		FinishItemMoves();
+		return;
+	}
+
+	if (!s_sentItemMoves.empty())
+	{
+		s_sentItemMoves.erase(std::remove_if(std::begin(s_sentItemMoves), std::end(s_sentItemMoves),
+			[](const SentItemMove& sent)
+			{
+				if (!IsItemMoveDone(sent))
+					return false;
+
+				++s_itemsMoved;
+				return true;
+			}), std::end(s_sentItemMoves));
+
+		if (!s_sentItemMoves.empty())
+		{
+			if (MQGetTickCount64() < s_sentItemMovesDeadline)
+				return;
+
+			s_itemsFailed += static_cast<int>(s_sentItemMoves.size());
+			s_sentItemMoves.clear();
+		}
+	}
+
+	if (s_pendingItemMoves.empty())
+	{
+		FinishItemMoves();
+		return;
+	}
+
+	// Wait for anything on the cursor to be put away, and for casting to finish.
+	if (ItemOnCursor() || (pLocalPlayer && pLocalPlayer->GetClass() != Bard && pLocalPlayer->CastingData.SpellETA != 0))
+		return;
+
+#if HAS_MULTIPLE_ITEM_MOVE_MANAGER
+	const size_t maxMoves = ITEM_MOVES_PER_BATCH;
+#else
+	const size_t maxMoves = 1;
+#endif
+
+	// A slot is only sent to once per group, so each move sees the slot as the plan expected it.
+	while (!s_pendingItemMoves.empty() && s_sentItemMoves.size() < maxMoves)
+	{
+		const MQItemMove& move = s_pendingItemMoves.front();
+
+		auto sameSlot = [&move](const SentItemMove& sent)
+		{
+			return IsSameSlot(sent.move.To, move.To) || IsSameSlot(sent.move.From, move.From);
+		};
+		if (std::any_of(std::begin(s_sentItemMoves), std::end(s_sentItemMoves), sameSlot))
+			break;
+
+		ItemPtr pItem = pLocalPC->GetItemByGlobalIndex(move.From);
+		if (!pItem)
+		{
+			++s_itemsFailed;
+		}
+		else
+		{
+			s_sentItemMoves.push_back({ move, pItem->GetID(), pItem->GetItemCount() });
+		}
+
+		s_pendingItemMoves.pop_front();
+	}
+
+	if (s_sentItemMoves.empty())
+		return;
+
+	if (!SendItemMoves(s_sentItemMoves))
+	{
+		s_itemsFailed += static_cast<int>(s_sentItemMoves.size());
+		s_sentItemMoves.clear();
+		return;
+	}
+
+	InvalidateInventoryIndex();
+	s_sentItemMovesDeadline = MQGetTickCount64() + ITEM_MOVE_TIMEOUT;
+}
+
+#pragma endregion
+
+//----------------------------------------------------------------------------
+
 static void Items_Initialize()
 {
 	s_invSlotInspector = new InvSlotInspector();
@@ -558,6 +891,8 @@ static void Items_Shutdown()
 
 static void Items_Pulse()
 {
+	PulseItemMoves();
+
 #if HAS_KEYRING_WINDOW
 	// This may not be necessary if the data cannot be manipulated without the UI.
 	// This resets the check for gbDidUpdateKeyRing 5 seconds after it is set.
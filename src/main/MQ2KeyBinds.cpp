@@ -29,6 +29,65 @@ using KeybindMap = std::map<std::string, int, ci_less>;
 KeybindMap gKeybindMap;
 std::vector<std::unique_ptr<MQKeyBind>> gKeyBinds;
 
+// Binds indexed by the key of their combos (KeyCombo::Data[3]), so a key event only looks at the
+// binds on that key. Key up only compares the key, so everything in a bucket is a candidate for it.
+// Our binds are indexed again whenever they change. EQ's binds can be changed by the game at any
+// time, so that index keeps a copy of the key tables it was built from and is rebuilt when they differ.
+static constexpr size_t NUM_BIND_KEYS = 256;
+static std::vector<int> s_keyBindsByKey[NUM_BIND_KEYS];
+static std::vector<int> s_eqBindsByKey[NUM_BIND_KEYS];
+static std::vector<KeyCombo> s_eqNormalKeys;
+static std::vector<KeyCombo> s_eqAltKeys;
+
+// EQ mappable command name -> index, filled on first use.
+static ci_unordered::map<std::string, int> s_mappableCommands;
+
+static size_t GetBindKey(const KeyCombo& combo)
+{
+	return static_cast<uint8_t>(combo.Data[3]);
+}
+
+static void AddToBindIndex(std::vector<int> (&index)[NUM_BIND_KEYS], const KeyCombo& normal, const KeyCombo& alt, int id)
+{
+	index[GetBindKey(normal)].push_back(id);
+
+	if (GetBindKey(alt) != GetBindKey(normal))
+		index[GetBindKey(alt)].push_back(id);
+}
+
+static void IndexKeyBinds()
+{
+	for (auto& bucket : s_keyBindsByKey)
+		bucket.clear();
+
+	for (const auto& pKeybind : gKeyBinds)
+	{
+		if (pKeybind)
+			AddToBindIndex(s_keyBindsByKey, pKeybind->Normal, pKeybind->Alt, pKeybind->Id);
+	}
+}
+
+static void UpdateEQBindIndex()
+{
+	constexpr size_t tableSize = nEQMappableCommands * sizeof(KeyCombo);
+
+	if (s_eqNormalKeys.size() == nEQMappableCommands
+		&& memcmp(s_eqNormalKeys.data(), &pKeypressHandler->NormalKey[0], tableSize) == 0
+		&& memcmp(s_eqAltKeys.data(), &pKeypressHandler->AltKey[0], tableSize) == 0)
+	{
+		return;
+	}
+
+	s_eqNormalKeys.assign(&pKeypressHandler->NormalKey[0], &pKeypressHandler->NormalKey[0] + nEQMappableCommands);
+	s_eqAltKeys.assign(&pKeypressHandler->AltKey[0], &pKeypressHandler->AltKey[0] + nEQMappableCommands);
+
+	for (auto& bucket : s_eqBindsByKey)
+		bucket.clear();
+
+	for (int index = 0; index < nEQMappableCommands; index++)
+		AddToBindIndex(s_eqBindsByKey, s_eqNormalKeys[index], s_eqAltKeys[index], index);
+}
+
 void EnumerateKeyBinds(const std::function<void(const MQKeyBind& keyBind)>& func)
 {
 	for (const auto& [name, id] : gKeybindMap)
@@ -86,8 +145,14 @@ bool MQ2HandleKeyDown(const KeyCombo& combo)
 {
 	bool Ret = false;
 
-	for (int index = 0; index < nEQMappableCommands; index++)
+	UpdateEQBindIndex();
+
+	// Handlers can add or remove binds, so these are walked by position and checked as we go.
+	const std::vector<int>& eqBinds = s_eqBindsByKey[GetBindKey(combo)];
+	for (size_t i = 0; i < eqBinds.size(); ++i)
 	{
+		const int index = eqBinds[i];
+
 		if (pKeypressHandler->CommandState[index] == 0
 			&& (pKeypressHandler->NormalKey[index] == combo || pKeypressHandler->AltKey[index] == combo))
 		{
@@ -98,8 +163,11 @@ bool MQ2HandleKeyDown(const KeyCombo& combo)
 		}
 	}
 
-	for (auto& pKeybind : gKeyBinds)
+	const std::vector<int>& keyBinds = s_keyBindsByKey[GetBindKey(combo)];
+	for (size_t i = 0; i < keyBinds.size(); ++i)
 	{
+		MQKeyBind* pKeybind = gKeyBinds[keyBinds[i]].get();
+
 		if (pKeybind
 			&& pKeybind->State == 0
 			&& (pKeybind->Normal == combo || pKeybind->Alt == combo))
@@ -118,8 +186,13 @@ bool MQ2HandleKeyUp(const KeyCombo& combo)
 {
 	bool Ret = false;
 
-	for (int index = 0; index < nEQMappableCommands; index++)
+	UpdateEQBindIndex();
+
+	const std::vector<int>& eqBinds = s_eqBindsByKey[GetBindKey(combo)];
+	for (size_t i = 0; i < eqBinds.size(); ++i)
 	{
+		const int index = eqBinds[i];
+
 		if (pKeypressHandler->CommandState[index]
 			&& (pKeypressHandler->NormalKey[index].Data[3] == combo.Data[3] || pKeypressHandler->AltKey[index].Data[3] == combo.Data[3]))
 		{
@@ -130,8 +203,11 @@ bool MQ2HandleKeyUp(const KeyCombo& combo)
 		}
 	}
 
-	for (auto& pKeybind : gKeyBinds)
+	const std::vector<int>& keyBinds = s_keyBindsByKey[GetBindKey(combo)];
+	for (size_t i = 0; i < keyBinds.size(); ++i)
 	{
+		MQKeyBind* pKeybind = gKeyBinds[keyBinds[i]].get();
+
 		if (pKeybind
 			&& pKeybind->State == 1
 			&& (pKeybind->Normal.Data[3] == combo.Data[3] || pKeybind->Alt.Data[3] == combo.Data[3]))
@@ -210,6 +286,10 @@ void ShutdownMQ2KeyBinds()
 {
 	gKeyBinds.clear();
 	gKeybindMap.clear();
+	IndexKeyBinds();
+	s_eqNormalKeys.clear();
+	s_eqAltKeys.clear();
+	s_mappableCommands.clear();
 
 	RemoveDetour(KeypressHandler__ClearCommandStateArray);
 	RemoveDetour(KeypressHandler__HandleKeyDown);
@@ -257,6 +337,7 @@ bool AddMQ2KeyBind(const char* name, fMQExecuteCmd function)
 	pKeybind->Id = index;
 	gKeyBinds[index] = std::move(pKeybind);
 	gKeybindMap.insert_or_assign(name, index);
+	IndexKeyBinds();
 
 	return true;
 }
@@ -281,6 +362,7 @@ bool RemoveMQ2KeyBind(const char* name)
 
 	gKeyBinds[iter->second].reset();
 	gKeybindMap.erase(iter);
+	IndexKeyBinds();
 
 	return true;
 }
@@ -320,6 +402,8 @@ bool SetMQ2KeyBind(const char* name, bool alternate, KeyCombo& combo)
 			pKeybind->Alt = combo;
 		}
 
+		IndexKeyBinds();
+
 		char szBuffer[MAX_STRING] = { 0 };
 
 		WritePrivateProfileString("Key Binds", settingName,
@@ -332,16 +416,23 @@ bool SetMQ2KeyBind(const char* name, bool alternate, KeyCombo& combo)
 
 int FindMappableCommand(const char* name)
 {
-	for (int i = 0; i < nEQMappableCommands; i++)
+	if (s_mappableCommands.empty())
 	{
-		if (szEQMappableCommands[i] == nullptr || szEQMappableCommands[i] > reinterpret_cast<const char*>(g_eqgameimagesize))
-			continue;
+		for (int i = 0; i < nEQMappableCommands; i++)
+		{
+			if (szEQMappableCommands[i] == nullptr || szEQMappableCommands[i] > reinterpret_cast<const char*>(g_eqgameimagesize))
+				continue;
 
-		if (!_stricmp(name, szEQMappableCommands[i]))
-			return i;
+			// the first command with a name wins
+			s_mappableCommands.emplace(szEQMappableCommands[i], i);
+		}
 	}
 
-	return -1;
+	auto iter = s_mappableCommands.find(std::string(name));
+	if (iter == s_mappableCommands.end())
+		return -1;
+
+	return iter->second;
 }
 
 void MQ2KeyBindCommand(SPAWNINFO* pChar, char* szLine)
@@ -0,0 +1,264 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace mq {
+
+static void LogWriter_Initialize();
+static void LogWriter_Shutdown();
+
+static MQModule s_logWriterModule = {
+	"LogWriter",                   // Name
+	false,                         // CanUnload
+	LogWriter_Initialize,
+	LogWriter_Shutdown,
+};
+DECLARE_MODULE_INITIALIZER(s_logWriterModule);
+
+static constexpr std::chrono::milliseconds LOG_FLUSH_INTERVAL{ 1000 };
+static constexpr size_t LOG_BATCH_SIZE = 256;           // lines that wake the writer before the interval is up
+
+static uint32_t gMaxLogFileSize = 0;                    // KB. Larger files are rotated, 0 to never rotate
+
+struct MQLogRequest
+{
+	std::filesystem::path File;
+	std::string Text;
+	bool Clear = false;
+	bool DebugOutput = false;                           // Text goes to OutputDebugString instead of File
+};
+
+// Files are rotated to name.1.ext, replacing whatever was rotated there before.
+static void RotateLogFile(const std::filesystem::path& path)
+{
+	if (gMaxLogFileSize == 0)
+		return;
+
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+	if (ec || size < static_cast<uintmax_t>(gMaxLogFileSize) * 1024)
+		return;
+
+	std::filesystem::path rotated = path.parent_path() / (path.stem().string() + ".1" + path.extension().string());
+	std::filesystem::rename(path, rotated, ec);
+}
+
+// Writes the requests in order, opening each file once for each run of lines that go to it.
+// Files are not kept open between batches, other clients may be writing to the same logs.
+static void WriteLogRequests(const std::vector<MQLogRequest>& requests)
+{
+	FILE* fOut = nullptr;
+	const std::filesystem::path* currentFile = nullptr;
+
+	for (const MQLogRequest& request : requests)
+	{
+		if (request.DebugOutput)
+		{
+			OutputDebugStringA(request.Text.c_str());
+			continue;
+		}
+
+		if (request.Clear || !currentFile || *currentFile != request.File)
+		{
+			if (fOut)
+			{
+				fclose(fOut);
+				fOut = nullptr;
+			}
+
+			currentFile = &request.File;
+
+			std::error_code ec;
+			create_directories(request.File.parent_path(), ec);
+
+			if (request.Clear)
+			{
+				if (FILE* fClear = _fsopen(request.File.string().c_str(), "wt", _SH_DENYWR))
+					fclose(fClear);
+
+				currentFile = nullptr;
+				continue;
+			}
+
+			RotateLogFile(request.File);
+			fOut = _fsopen(request.File.string().c_str(), "at", _SH_DENYWR);
+		}
+
+		if (fOut)
+		{
+			fwrite(request.Text.data(), 1, request.Text.size(), fOut);
+		}
+	}
+
+	if (fOut)
+	{
+		fclose(fOut);
+	}
+}
+
+// Log files are written by a background thread, so that a slow disk or network share never holds
+// up a frame. Debug spew goes through it too: OutputDebugString blocks on whatever is listening. The game thread only holds the lock long enough to queue a line. Lines are written in
+// batches, every LOG_FLUSH_INTERVAL or once LOG_BATCH_SIZE are waiting, and whatever is left is
+// written when the writer stops.
+class LogWriter
+{
+public:
+	~LogWriter()
+	{
+		// LogWriter_Shutdown stops the thread. Joining it here could wait on the loader lock.
+		if (m_thread.joinable())
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_cv.notify_one();
+			m_thread.detach();
+		}
+	}
+
+	void Start()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (!m_thread.joinable())
+		{
+			m_stop = false;
+			m_thread = std::thread([this]() { WriterThread(); });
+		}
+	}
+
+	void Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_cv.notify_one();
+
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	// Returns false, leaving the request alone, if the writer isn't running. The request should be
+	// written directly instead.
+	bool Add(MQLogRequest&& request)
+	{
+		bool wake = false;
+
+		{
+			std::scoped_lock lock(m_mutex);
+			if (m_stop || !m_thread.joinable())
+				return false;
+
+			m_requests.push_back(std::move(request));
+			wake = m_requests.size() >= LOG_BATCH_SIZE;
+		}
+
+		if (wake)
+			m_cv.notify_one();
+
+		return true;
+	}
+
+private:
+	void WriterThread()
+	{
+		std::vector<MQLogRequest> pending;
+
+		while (true)
+		{
+			bool stopping = false;
+
+			{
+				std::unique_lock lock(m_mutex);
+				m_cv.wait_for(lock, LOG_FLUSH_INTERVAL, [this]() { return m_stop || m_requests.size() >= LOG_BATCH_SIZE; });
+
+				pending.swap(m_requests);
+				stopping = m_stop;
+			}
+
+			WriteLogRequests(pending);
+			pending.clear();
+
+			if (stopping)
+				return;
+		}
+	}
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<MQLogRequest> m_requests;
+	bool m_stop = false;
+};
+
+static LogWriter s_logWriter;
+
+void AppendToLogFile(const std::filesystem::path& file, std::string text)
+{
+	MQLogRequest request{ file, std::move(text) };
+
+	if (!s_logWriter.Add(std::move(request)))
+	{
+		WriteLogRequests({ std::move(request) });
+	}
+}
+
+void ClearLogFile(const std::filesystem::path& file)
+{
+	MQLogRequest request{ file, {}, true };
+
+	if (!s_logWriter.Add(std::move(request)))
+	{
+		WriteLogRequests({ std::move(request) });
+	}
+}
+
+void OutputDebugSpew(std::string text)
+{
+	MQLogRequest request{ {}, std::move(text), false, true };
+
+	if (!s_logWriter.Add(std::move(request)))
+	{
+		OutputDebugStringA(request.Text.c_str());
+	}
+}
+
+static void LogWriter_Initialize()
+{
+	gMaxLogFileSize = GetPrivateProfileInt("MacroQuest", "MaxLogFileSize", gMaxLogFileSize, mq::internal_paths::MQini);
+	if (gbWriteAllConfig)
+	{
+		WritePrivateProfileInt("MacroQuest", "MaxLogFileSize", gMaxLogFileSize, mq::internal_paths::MQini);
+	}
+
+	s_logWriter.Start();
+}
+
+static void LogWriter_Shutdown()
+{
+	s_logWriter.Stop();
+}
+
+} // namespace mq
@@ -19,12 +19,15 @@
 
 #include <fstream>
 #include <regex>
+#include <unordered_set>
 
 namespace mq {
 
 // Defined in MQ2DataVars.cpp
 void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValues);
 
+static constexpr int MAX_TURBO_BUDGET = 20000;    // most microseconds per frame a macro may ask for
+
 static std::map<std::string, MQMacroBlockPtr> MacroBlockMap;
 uint64_t s_commandCount = 0;
 
@@ -129,11 +132,40 @@ public:
 			child->format_csv(buffer, depth + 1, beginTime);
 	}
 
+	void AddLineSample(int lineIndex, const MQMacroLine& line, std::chrono::nanoseconds elapsed)
+	{
+		LineSample& sample = m_lineSamples[lineIndex];
+		if (sample.Location.empty())
+			sample.Location = fmt::format("{}@{}", line.SourceFile.str(), line.LineNumber);
+
+		sample.Time += elapsed;
+	}
+
+	// Adds the time spent on each line of this frame and its children, keyed by the
+	// semicolon separated call stack leading to the line.
+	void format_folded(std::map<std::string, std::chrono::nanoseconds>& stacks, const std::string& parentPath) const
+	{
+		const std::string path = parentPath.empty() ? m_subroutine : fmt::format("{};{}", parentPath, m_subroutine);
+
+		for (const auto& [lineIndex, sample] : m_lineSamples)
+			stacks[fmt::format("{};{}", path, sample.Location)] += sample.Time;
+
+		for (const std::unique_ptr<StackFrame>& child : m_children)
+			child->format_folded(stacks, path);
+	}
+
 private:
+	struct LineSample
+	{
+		std::string Location;
+		std::chrono::nanoseconds Time{ 0 };
+	};
+
 	std::string m_subroutine;
 	std::vector<std::string> m_args;
 	std::string m_returnValue;
 	bool m_returned = false;
+	std::map<int, LineSample> m_lineSamples;
 
 	uint64_t m_startCommandCount;
 	uint64_t m_endCommandCount;
@@ -147,10 +179,18 @@ class ProfileSession
 public:
 	ProfileSession(std::string&& name)
 		: m_name(std::move(name))
+		, m_id(++s_lastId)
 		, m_startTime(std::chrono::high_resolution_clock::now())
 	{
 	}
 
+	uint32_t GetId() const { return m_id; }
+
+	StackFrame* GetCurrentFrame() const
+	{
+		return m_callStack.empty() ? nullptr : m_callStack.back().get();
+	}
+
 	void Call(std::string&& subroutine, std::vector<std::string>&& args)
 	{
 		m_callStack.emplace_back(new StackFrame(std::move(subroutine), std::move(args)));
@@ -197,8 +237,34 @@ public:
 		return fmt::to_string(mem);
 	}
 
+	// Collapsed stack output, one "Sub;Sub;File@Line microseconds" entry per line. This is the
+	// input format of flamegraph.pl and compatible tools.
+	std::string to_folded() const
+	{
+		fmt::memory_buffer mem;
+		fmt::appender buf(mem);
+
+		if (m_callStack.size() == 1)
+		{
+			std::map<std::string, std::chrono::nanoseconds> stacks;
+			m_callStack.back()->format_folded(stacks, {});
+
+			for (const auto& [stack, time] : stacks)
+			{
+				const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+				if (microseconds > 0)
+					fmt::format_to(buf, "{} {}\n", stack, microseconds);
+			}
+		}
+
+		return fmt::to_string(mem);
+	}
+
 private:
+	static inline uint32_t s_lastId = 0;
+
 	std::string m_name;
+	uint32_t m_id;
 	std::deque<std::unique_ptr<StackFrame>> m_callStack;
 
 	uint64_t m_startCommandCount;
@@ -207,26 +273,66 @@ private:
 
 ProfileSession* g_pProfile = nullptr;
 
-static std::vector<std::string> ArgsToVector(const char* szLine)
+MQMacroLineProfile BeginMacroLineProfile()
 {
-	std::vector<std::string> args;
+	MQMacroLineProfile profile;
 
-	int i = 1;
-	while (true)
+	if (g_pProfile)
 	{
-		char szArg[MAX_STRING] = { 0 };
-		GetArg(szArg, szLine, i);
+		profile.pFrame = g_pProfile->GetCurrentFrame();
+		profile.SessionId = g_pProfile->GetId();
+		profile.StartTime = std::chrono::steady_clock::now();
+	}
 
-		if (!szArg[0])
-			break;
+	return profile;
+}
+
+void EndMacroLineProfile(const MQMacroLineProfile& profile, MQMacroLine& line, int lineIndex)
+{
+	// The line may have ended the macro, and with it the session.
+	if (!profile.pFrame || !g_pProfile || g_pProfile->GetId() != profile.SessionId)
+		return;
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - profile.StartTime);
+
+	profile.pFrame->AddLineSample(lineIndex, line, elapsed);
+
+	++line.ExecutionCount;
+	line.ExecutionTime += elapsed.count();
+}
 
-		if (i > 0)
-			args.emplace_back(szArg);
+static void WriteLineProfile(const std::string& fileName, const MQMacroBlock& block)
+{
+	std::ofstream lineFile(fileName);
+	lineFile << "Source File,Line,Execute Count,Total uSec,Avg uSec,Macro Source Code\n";
+
+	for (const auto& [index, line] : block.Line)
+	{
+		if (line.ExecutionCount == 0)
+			continue;
 
-		++i;
+		const double totalMicroseconds = line.ExecutionTime / 1000.0;
+
+		lineFile << fmt::format("\"{}\",{},{},{:.1f},{:.3f},\"{}\"\n",
+			line.SourceFile.str(),
+			line.LineNumber,
+			line.ExecutionCount,
+			totalMicroseconds,
+			totalMicroseconds / line.ExecutionCount,
+			mq::replace(line.Command, "\"", "\"\""));
 	}
+}
 
-	return args;
+static std::vector<std::string> ArgsToVector(const CommandArgs& args)
+{
+	std::vector<std::string> result;
+	result.reserve(args.size());
+
+	for (size_t i = 0; i < args.size() && !args[i].empty(); ++i)
+		result.emplace_back(args[i]);
+
+	return result;
 }
 
 void ProfileCommand(PlayerClient* pPlayer, char* szLine)
@@ -242,7 +348,7 @@ void ProfileCommand(PlayerClient* pPlayer, char* szLine)
 	if (!gMacroBlock)
 		return;
 
-	std::vector<std::string> args = ArgsToVector(szLine);
+	std::vector<std::string> args = ArgsToVector(CommandArgs(szLine));
 
 	auto time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
 	std::tm now = {};
@@ -505,26 +611,271 @@ void CleanMacroLine(char* szLine)
 		szLine[NewLength] = '\0';
 }
 
-// ***************************************************************************
-// Function:    Include
-// Description: Includes another macro file
-// Usage:       #include <filename>
-// ***************************************************************************
-// TODO:  Switch this to take input of filesystem::path instead of const char*  Breaking change?
-bool Include(const char* szFile, int* LineNumber)
+// The lines of an include file after cleanup and block comment removal, as they are handed to
+// AddMacroLine. Include files are read once and reused for as long as they don't change on disk.
+// The line text is kept in a named, read-only shared memory section so that every client on the
+// machine that includes the same file version shares a single copy of it.
+struct MQIncludeFile
 {
-	FILE* fMacro = _fsopen(szFile, "rt", _SH_DENYNO);
-	if (fMacro == nullptr)
+	struct Line
+	{
+		int LocalLine;
+		std::string_view Text;
+	};
+
+	std::filesystem::file_time_type WriteTime;
+	uintmax_t FileSize = 0;
+	int LineCount = 0;
+	std::vector<Line> Lines;
+
+	std::string Storage;                        // line text when the shared section isn't available
+	HANDLE hSection = nullptr;
+	const char* pView = nullptr;
+
+	MQIncludeFile() = default;
+	MQIncludeFile(const MQIncludeFile&) = delete;
+	MQIncludeFile& operator=(const MQIncludeFile&) = delete;
+
+	~MQIncludeFile()
+	{
+		if (pView)
+			UnmapViewOfFile(pView);
+		if (hSection)
+			CloseHandle(hSection);
+	}
+};
+
+static std::unordered_map<std::string, std::shared_ptr<const MQIncludeFile>> s_includeFileCache;
+
+// Layout of a shared include section: the header, the include path, then for every line its
+// local line number, its length and its text.
+struct MQSharedIncludeHeader
+{
+	static constexpr uint32_t MagicValue = 0x4649514d; // MQIF
+
+	uint32_t Magic;
+	volatile LONG Ready;                        // set once the writer has filled in the section
+	int64_t WriteTime;
+	uint64_t FileSize;
+	int32_t LineCount;
+	uint32_t NumLines;
+	uint32_t PathLength;
+};
+
+struct MQSharedIncludeLine
+{
+	int32_t LocalLine;
+	uint32_t Length;
+};
+
+static std::string GetSharedIncludeName(const std::string& path, int64_t writeTime, uint64_t fileSize)
+{
+	std::string key = fmt::format("{}|{}|{}", path, writeTime, fileSize);
+	MakeLower(key);
+
+	return fmt::format("Local\\MQ2IncludeFile_{:016x}", std::hash<std::string>()(key));
+}
+
+// Fills in the lines of includeFile from a shared section, validating it against the file it is
+// supposed to contain.
+static bool ReadSharedInclude(MQIncludeFile& includeFile, const char* pView, size_t viewSize, const std::string& path,
+	int64_t writeTime)
+{
+	if (viewSize < sizeof(MQSharedIncludeHeader))
+		return false;
+
+	const auto* pHeader = reinterpret_cast<const MQSharedIncludeHeader*>(pView);
+	if (pHeader->Magic != MQSharedIncludeHeader::MagicValue
+		|| pHeader->Ready != 1
+		|| pHeader->WriteTime != writeTime
+		|| pHeader->FileSize != includeFile.FileSize)
 	{
-		FatalError("Couldn't open include file: %s", szFile);
 		return false;
 	}
 
-	DebugSpewNoFile("Include - Including: %s", szFile);
+	size_t offset = sizeof(MQSharedIncludeHeader);
+	if (viewSize - offset < pHeader->PathLength
+		|| !ci_equals(std::string_view(pView + offset, pHeader->PathLength), path))
+	{
+		return false;
+	}
 
-	int LocalLine = 0;
+	offset += pHeader->PathLength;
+
+	includeFile.LineCount = pHeader->LineCount;
+	includeFile.Lines.reserve(pHeader->NumLines);
+
+	for (uint32_t i = 0; i < pHeader->NumLines; ++i)
+	{
+		if (viewSize - offset < sizeof(MQSharedIncludeLine))
+			return false;
+
+		// Line records are packed, so they aren't necessarily aligned.
+		MQSharedIncludeLine line;
+		memcpy(&line, pView + offset, sizeof(line));
+		offset += sizeof(MQSharedIncludeLine);
+
+		if (viewSize - offset < line.Length)
+			return false;
+
+		includeFile.Lines.push_back({ line.LocalLine, std::string_view(pView + offset, line.Length) });
+		offset += line.Length;
+	}
+
+	return true;
+}
+
+static bool OpenSharedInclude(MQIncludeFile& includeFile, const std::string& name, const std::string& path,
+	int64_t writeTime)
+{
+	HANDLE hSection = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (!hSection)
+		return false;
+
+	const char* pView = static_cast<const char*>(MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, 0));
+	MEMORY_BASIC_INFORMATION mbi = { 0 };
+	if (!pView || !VirtualQuery(pView, &mbi, sizeof(mbi)))
+	{
+		if (pView)
+			UnmapViewOfFile(pView);
+		CloseHandle(hSection);
+		return false;
+	}
+
+	includeFile.hSection = hSection;
+	includeFile.pView = pView;
+
+	if (!ReadSharedInclude(includeFile, pView, mbi.RegionSize, path, writeTime))
+	{
+		includeFile.Lines.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Publishes the lines of includeFile, which point into its Storage, to a new shared section and
+// switches the lines over to the shared copy.
+static void CreateSharedInclude(MQIncludeFile& includeFile, const std::string& name, const std::string& path,
+	int64_t writeTime)
+{
+	size_t size = sizeof(MQSharedIncludeHeader) + path.size();
+	for (const MQIncludeFile::Line& line : includeFile.Lines)
+		size += sizeof(MQSharedIncludeLine) + line.Text.size();
+
+	HANDLE hSection = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+	if (!hSection)
+		return;
+
+	// Someone else is publishing this file, keep our own copy.
+	if (GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		CloseHandle(hSection);
+		return;
+	}
+
+	char* pWrite = static_cast<char*>(MapViewOfFile(hSection, FILE_MAP_WRITE, 0, 0, size));
+	if (!pWrite)
+	{
+		CloseHandle(hSection);
+		return;
+	}
+
+	auto* pHeader = reinterpret_cast<MQSharedIncludeHeader*>(pWrite);
+	pHeader->Magic = MQSharedIncludeHeader::MagicValue;
+	pHeader->WriteTime = writeTime;
+	pHeader->FileSize = includeFile.FileSize;
+	pHeader->LineCount = includeFile.LineCount;
+	pHeader->NumLines = static_cast<uint32_t>(includeFile.Lines.size());
+	pHeader->PathLength = static_cast<uint32_t>(path.size());
+
+	size_t offset = sizeof(MQSharedIncludeHeader);
+	memcpy(pWrite + offset, path.data(), path.size());
+	offset += path.size();
+
+	for (const MQIncludeFile::Line& line : includeFile.Lines)
+	{
+		const MQSharedIncludeLine record = { line.LocalLine, static_cast<uint32_t>(line.Text.size()) };
+		memcpy(pWrite + offset, &record, sizeof(record));
+		offset += sizeof(MQSharedIncludeLine);
+
+		memcpy(pWrite + offset, line.Text.data(), line.Text.size());
+		offset += line.Text.size();
+	}
+
+	InterlockedExchange(&pHeader->Ready, 1);
+	UnmapViewOfFile(pWrite);
+
+	const char* pView = static_cast<const char*>(MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, size));
+	if (!pView)
+	{
+		CloseHandle(hSection);
+		return;
+	}
+
+	MQIncludeFile sharedFile;
+	sharedFile.FileSize = includeFile.FileSize;
+	sharedFile.hSection = hSection;
+	sharedFile.pView = pView;
+
+	if (ReadSharedInclude(sharedFile, pView, size, path, writeTime))
+	{
+		includeFile.Lines = std::move(sharedFile.Lines);
+		includeFile.Storage = std::string();
+		std::swap(includeFile.hSection, sharedFile.hSection);
+		std::swap(includeFile.pView, sharedFile.pView);
+	}
+}
+
+static std::shared_ptr<const MQIncludeFile> ReadIncludeFile(const char* szFile)
+{
+	std::error_code ec;
+	const auto writeTime = std::filesystem::last_write_time(szFile, ec);
+	const uintmax_t fileSize = ec ? 0 : std::filesystem::file_size(szFile, ec);
+	const bool canCache = !ec;
+
+	const std::string path = szFile;
+	const int64_t writeTicks = writeTime.time_since_epoch().count();
+	std::string sharedName;
+
+	if (canCache)
+	{
+		auto iter = s_includeFileCache.find(path);
+		if (iter != s_includeFileCache.end()
+			&& iter->second->WriteTime == writeTime
+			&& iter->second->FileSize == fileSize)
+		{
+			return iter->second;
+		}
+
+		// Another client may already have read this version of the file.
+		sharedName = GetSharedIncludeName(path, writeTicks, fileSize);
+
+		auto sharedFile = std::make_shared<MQIncludeFile>();
+		sharedFile->WriteTime = writeTime;
+		sharedFile->FileSize = fileSize;
+
+		if (OpenSharedInclude(*sharedFile, sharedName, path, writeTicks))
+		{
+			DebugSpewNoFile("Include - Using shared copy of: %s", szFile);
+
+			s_includeFileCache.insert_or_assign(path, sharedFile);
+			return sharedFile;
+		}
+	}
+
+	FILE* fMacro = _fsopen(szFile, "rt", _SH_DENYNO);
+	if (fMacro == nullptr)
+		return nullptr;
+
+	auto includeFile = std::make_shared<MQIncludeFile>();
+	includeFile->WriteTime = writeTime;
+	includeFile->FileSize = fileSize;
+
+	// Line text is appended to Storage, and the views are set up once it stops growing.
+	std::vector<std::pair<int, size_t>> lineLengths;
 	bool InBlockComment = false;
-	const char* Macroname = GetFilenameFromFullPath(szFile);
 	char szTemp[MAX_STRING] = { 0 };
 
 	while (!feof(fMacro))
@@ -535,8 +886,7 @@ bool Include(const char* szFile, int* LineNumber)
 			break;
 
 		CleanMacroLine(szTemp);
-		LocalLine++;
-		(*LineNumber)++;
+		includeFile->LineCount++;
 
 		if (!strncmp(szTemp, "|**", 3))
 		{
@@ -545,16 +895,9 @@ bool Include(const char* szFile, int* LineNumber)
 
 		if (!InBlockComment)
 		{
-			if (!AddMacroLine(Macroname, szTemp, MAX_STRING, LineNumber, LocalLine))
-			{
-				MacroError("Unable to add macro line.");
-
-				fclose(fMacro);
-				gszMacroName[0] = 0;
-				gRunning = 0;
-
-				return false;
-			}
+			const size_t length = strlen(szTemp);
+			includeFile->Storage.append(szTemp, length);
+			lineLengths.emplace_back(includeFile->LineCount, length);
 		}
 		else
 		{
@@ -568,6 +911,70 @@ bool Include(const char* szFile, int* LineNumber)
 	}
 
 	fclose(fMacro);
+
+	includeFile->Lines.reserve(lineLengths.size());
+
+	size_t offset = 0;
+	for (const auto& [localLine, length] : lineLengths)
+	{
+		includeFile->Lines.push_back({ localLine, std::string_view(includeFile->Storage).substr(offset, length) });
+		offset += length;
+	}
+
+	if (canCache)
+	{
+		CreateSharedInclude(*includeFile, sharedName, path, writeTicks);
+
+		s_includeFileCache.insert_or_assign(path, includeFile);
+	}
+
+	return includeFile;
+}
+
+// ***************************************************************************
+// Function:    Include
+// Description: Includes another macro file
+// Usage:       #include <filename>
+// ***************************************************************************
+// TODO:  Switch this to take input of filesystem::path instead of const char*  Breaking change?
+bool Include(const char* szFile, int* LineNumber)
+{
+	std::shared_ptr<const MQIncludeFile> includeFile = ReadIncludeFile(szFile);
+	if (!includeFile)
+	{
+		FatalError("Couldn't open include file: %s", szFile);
+		return false;
+	}
+
+	DebugSpewNoFile("Include - Including: %s", szFile);
+
+	const char* Macroname = GetFilenameFromFullPath(szFile);
+	char szTemp[MAX_STRING] = { 0 };
+	int LocalLine = 0;
+
+	// Defines, events and nested includes depend on the state of the macro being loaded, so each
+	// line still goes through AddMacroLine. Line numbers advance for skipped lines as well.
+	for (const MQIncludeFile::Line& line : includeFile->Lines)
+	{
+		(*LineNumber) += line.LocalLine - LocalLine;
+		LocalLine = line.LocalLine;
+
+		const size_t length = std::min(line.Text.size(), static_cast<size_t>(MAX_STRING - 1));
+		memcpy(szTemp, line.Text.data(), length);
+		szTemp[length] = '\0';
+
+		if (!AddMacroLine(Macroname, szTemp, MAX_STRING, LineNumber, LocalLine))
+		{
+			MacroError("Unable to add macro line.");
+
+			gszMacroName[0] = 0;
+			gRunning = 0;
+
+			return false;
+		}
+	}
+
+	(*LineNumber) += includeFile->LineCount - LocalLine;
 	return true;
 }
 
@@ -575,6 +982,15 @@ bool Include(const char* szFile, int* LineNumber)
 // Function:    AddMacroLine
 // Description: Add a line to the MacroBlock
 // ***************************************************************************
+MQSourceFileName::MQSourceFileName(std::string_view name)
+{
+	static std::mutex s_mutex;
+	static std::unordered_set<std::string> s_names;
+
+	std::scoped_lock lock(s_mutex);
+	m_name = &*s_names.emplace(name).first;
+}
+
 bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineNumber, int localLine)
 {
 	// replace all tabs with spaces
@@ -587,12 +1003,12 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 	{
 		while (pDef)
 		{
-			while (strstr(szLine, pDef->szName))
+			while (strstr(szLine, pDef->Name.c_str()))
 			{
 				char szNew[MAX_STRING] = { 0 };
-				strncpy_s(szNew, szLine, strstr(szLine, pDef->szName) - szLine);
-				strcat_s(szNew, pDef->szReplace);
-				strcat_s(szNew, strstr(szLine, pDef->szName) + strlen(pDef->szName));
+				strncpy_s(szNew, szLine, strstr(szLine, pDef->Name.c_str()) - szLine);
+				strcat_s(szNew, pDef->Replace.c_str());
+				strcat_s(szNew, strstr(szLine, pDef->Name.c_str()) + pDef->Name.length());
 				strcpy_s(szLine, Linelen, szNew);
 			}
 			pDef = pDef->pNext;
@@ -652,6 +1068,11 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 		{
 			gWarning = true;
 		}
+		else if (!_strnicmp(szLine, "#lazyconditions", 15))
+		{
+			// Only takes effect with Parser Version 2, where conditions are compiled.
+			gLazyConditions = true;
+		}
 		else if (!_strnicmp(szLine, "#turbo", 6))
 		{
 			gTurbo = true;
@@ -667,6 +1088,18 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 				MacroError("#turbo %d is too high, setting at %d (maximum)", gMaxTurbo, gTurboLimit);
 				gMaxTurbo = gTurboLimit;
 			}
+
+			// #turbo <lines> <microseconds>: run for up to this long each frame instead of a line count
+			GetArg(szArg, szLine, 3);
+			if (szArg[0] != 0)
+			{
+				gTurboBudget = std::max(GetIntFromString(szArg, 0), 0);
+				if (gTurboBudget > MAX_TURBO_BUDGET)
+				{
+					MacroError("#turbo budget of %dus is too high, setting at %dus (maximum)", gTurboBudget, MAX_TURBO_BUDGET);
+					gTurboBudget = MAX_TURBO_BUDGET;
+				}
+			}
 		}
 		else if (!_strnicmp(szLine, "#define ", 8))
 		{
@@ -679,8 +1112,8 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 			{
 				MQDefine* define = new MQDefine();
 
-				strcpy_s(define->szName, szArg1);
-				strcpy_s(define->szReplace, szArg2);
+				define->Name = szArg1;
+				define->Replace = szArg2;
 				define->pNext = pDefines;
 				pDefines = define;
 			}
@@ -700,7 +1133,7 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 			{
 				MQEventList* pEvent = new MQEventList();
 
-				sprintf_s(pEvent->szName, "Sub Event_%s", szArg1);
+				pEvent->Name = fmt::format("Sub Event_{}", szArg1);
 
 				if (char* pDest = strstr(szArg2, "${"))
 				{
@@ -723,8 +1156,8 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 					}
 				}
 
-				strcpy_s(pEvent->szMatch, szArg2);
-				pEvent->BlechID = pEventBlech->AddEvent(pEvent->szMatch, EventBlechCallback, pEvent);
+				pEvent->Match = szArg2;
+				pEvent->BlechID = pEventBlech->AddEvent(pEvent->Match.c_str(), EventBlechCallback, pEvent);
 				pEvent->pEventFunc = 0;
 				pEvent->pNext = pEventList;
 				pEventList = pEvent;
@@ -814,14 +1247,14 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 		MQEventList* pEvent = pEventList;
 		while (pEvent)
 		{
-			if (!_stricmp(szLine, pEvent->szName))
+			if (!_stricmp(szLine, pEvent->Name.c_str()))
 			{
 				pEvent->pEventFunc = *LineNumber;
 			}
 			else
 			{
 				char szNameP[MAX_STRING] = { 0 };
-				sprintf_s(szNameP, "%s(", pEvent->szName);
+				sprintf_s(szNameP, "%s(", pEvent->Name.c_str());
 
 				if (!_strnicmp(szLine, szNameP, strlen(szNameP)))
 				{
@@ -832,19 +1265,15 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 		}
 	}
 
-	auto [iter, success] = gMacroBlock->Line.emplace(
-		std::piecewise_construct,
-		std::forward_as_tuple(*LineNumber),
-		std::forward_as_tuple(szLine, FileName, localLine));
+	auto [iter, success] = gMacroBlock->Line.emplace(*LineNumber, szLine, MQSourceFileName(FileName), localLine);
 	if (!success)
 	{
 		MacroError("Duplicate line number detected! %s@%d", FileName, localLine);
 	}
-
-#ifdef MQ2_PROFILING
-	iter->second.ExecutionCount = 0;
-	iter->second.ExecutionTime = 0;
-#endif
+	else
+	{
+		CompileMacroLine(iter->second);
+	}
 
 	static const std::regex subrx("^sub (\\w+)", std::regex_constants::icase);
 	std::cmatch submatch;
@@ -976,6 +1405,7 @@ int GetMacroBlockCount()
 void Macro(PSPAWNINFO pChar, char* szLine)
 {
 	gWarning = false;
+	gLazyConditions = false;
 	bRunNextCommand = true;
 
 	char* szNext = nullptr;
@@ -1010,6 +1440,7 @@ void Macro(PSPAWNINFO pChar, char* szLine)
 	gMacroBlock = AddMacroBlock(szLine);
 
 	gMaxTurbo = 80;
+	gTurboBudget = std::clamp(gDefaultTurboBudget, 0, MAX_TURBO_BUDGET);
 	gTurbo = true;
 
 	char szTemp[MAX_STRING] = { 0 };
@@ -1211,7 +1642,7 @@ void Goto(PSPAWNINFO pChar, char* szLine)
 		return;
 	}
 
-	std::map<int, MQMacroLine>::reverse_iterator ri(goto_line);
+	MQMacroLines::reverse_iterator ri(goto_line);
 
 	// search up first we only search until we find a "Sub "
 	for (; ri != gMacroBlock->Line.rend(); ri++)
@@ -1254,7 +1685,7 @@ void Goto(PSPAWNINFO pChar, char* szLine)
 
 char* GetSubFromLine(int Line, char* szSub, size_t Sublen)
 {
-	std::map<int, MQMacroLine>::reverse_iterator ri(gMacroBlock->Line.find(Line));
+	MQMacroLines::reverse_iterator ri(gMacroBlock->Line.find(Line));
 
 	for (; ri != gMacroBlock->Line.rend(); ri++)
 	{
@@ -1328,8 +1759,8 @@ void EndMacro(PSPAWNINFO pChar, char* szLine)
 	}
 
 	gWarning = false;
+	gLazyConditions = false;
 	MQMacroStack* pStack = nullptr;
-	MQEventQueue* pEvent = nullptr;
 	MQEventList* pEventL = nullptr;
 	MQBindList* pBindL = nullptr;
 
@@ -1393,54 +1824,6 @@ void EndMacro(PSPAWNINFO pChar, char* szLine)
 	// reset for next time
 	gReturn = true;
 
-#ifdef MQ2_PROFILING
-	// How many performance counters in 1 second?
-	LARGE_INTEGER PerformanceFrequency;
-	QueryPerformanceCounter(&PerformanceFrequency);
-
-	char Filename[MAX_STRING] = { 0 };
-	FILE* fMacro = NULL;
-	for (auto i = pBlock->Line.begin(); i != pBlock->Line.end(); i++) {
-		// Is this a different macro file?
-		if (strcmp(Filename, i->second.SourceFile.c_str())) {
-			// Close existing file
-			if (fMacro) {
-				fclose(fMacro);
-			}
-			// Open new profiling log file
-			strcpy_s(Filename, i->second.SourceFile.c_str());
-			sprintf_s(Buffer, "%s\\%s.mqp", gszMacroPath, Filename);
-			fMacro = _fsopen(Buffer, "w", _SH_DENYWR);
-			if (fMacro) {
-				fprintf(fMacro, " Execute |  Total   | Avg uSec | Line | Macro Source Code\n");
-				fprintf(fMacro, " Count   |   uSec   | Per 1000 |\n");
-				fprintf(fMacro, "------------------------------------------------------------------------------------------------------------- \n");
-			}
-		}
-
-		// Log execution/profiling information.  Output format is:
-		// Execution Count | Microseconds | Line # | Macro Source
-		if (fMacro) {
-			DWORD count = i->second.ExecutionCount;
-			DWORD total = (DWORD)(i->second.ExecutionTime * 1000000 / PerformanceFrequency.QuadPart);
-			DWORD avg = 0;
-			if (count > 0) {
-				avg = total * 1000 / count;
-			}
-			fprintf(fMacro, "%8lu | %8lu | %8lu | %4lu | %s\n",
-				count,
-				total,
-				avg,
-				i->second.LineNumber,
-				i->second.Command.c_str());
-		}
-	}
-	// Close existing file
-	if (fMacro) {
-		fclose(fMacro);
-	}
-#endif
-
 	RemoveMacroBlock(pBlock->Name);
 
 	gMacroBlock = nullptr;
@@ -1460,14 +1843,9 @@ void EndMacro(PSPAWNINFO pChar, char* szLine)
 
 	gMacroSubLookupMap.clear();
 	gUndeclaredVars.clear();
+	ClearCompiledMacroStrings();
 
-	while (gEventQueue)
-	{
-		pEvent = gEventQueue->pNext;
-		delete gEventQueue;
-
-		gEventQueue = pEvent;
-	}
+	FlushMacroEvents();
 
 	while (pEventList)
 	{
@@ -1534,6 +1912,11 @@ void EndMacro(PSPAWNINFO pChar, char* szLine)
 		std::ofstream logFile(profileDirectoryPath + g_pProfile->GetName() + ".csv");
 		logFile << g_pProfile->to_string();
 
+		std::ofstream foldedFile(profileDirectoryPath + g_pProfile->GetName() + ".folded");
+		foldedFile << g_pProfile->to_folded();
+
+		WriteLineProfile(profileDirectoryPath + g_pProfile->GetName() + "_lines.csv", *pBlock);
+
 		WriteChatf("\ag[Profiler]\ax Saved profile to: %s", g_pProfile->GetName().c_str());
 
 		delete g_pProfile;
@@ -1572,15 +1955,14 @@ void Call(PSPAWNINFO pChar, char* szLine)
 
 	bRunNextCommand = true;
 
-	char SubName[MAX_STRING];
-	GetArg(SubName, szLine, 1);
-	const char* SubParam = GetNextArg(szLine);
+	CommandArgs args(szLine);
+	std::string SubName(args[0]);
 
 	// Sub in Map?
 	auto iter = gMacroSubLookupMap.find(SubName);
 	if (iter == gMacroSubLookupMap.end())
 	{
-		FatalError("Subroutine %s wasn't found", SubName);
+		FatalError("Subroutine %s wasn't found", SubName.c_str());
 		return;
 	}
 
@@ -1619,17 +2001,20 @@ void Call(PSPAWNINFO pChar, char* szLine)
 	MQMacroLine& ml = gMacroBlock->Line.at(MacroLine);
 	int numsubargs = GetNumArgsFromSub(ml.Command);
 
-	if (SubParam[0] != 0 || numsubargs)
+	// the parameters are every argument after the sub name
+	const int numParams = static_cast<int>(args.size()) - 1;
+
+	if (numParams > 0 || numsubargs)
 	{
 		// FIXME: These don't need to all be 2k bytes long...
 		char szParamName[MAX_STRING] = { 0 };
 		char szParamType[MAX_STRING] = { 0 };
-		char szNewValue[MAX_STRING] = { 0 };
+		std::string newValue;
 		auto name = &ml.Command[0];
 
-		for (int StackNum = 0; StackNum < numsubargs || SubParam[0] != '\0'; StackNum++)
+		for (int StackNum = 0; StackNum < numsubargs || StackNum < numParams; StackNum++)
 		{
-			GetArg(szNewValue, SubParam, 1);
+			newValue = args[StackNum + 1];
 
 			GetFuncParam(name, StackNum, szParamName, MAX_STRING, szParamType, MAX_STRING);
 
@@ -1637,17 +2022,13 @@ void Call(PSPAWNINFO pChar, char* szLine)
 			if (!pType)
 				pType = datatypes::pStringType;
 
-			AddMQ2DataVariable(szParamName, "", pType, &gMacroStack->Parameters, szNewValue);
-			SubParam = GetNextArg(SubParam);
+			AddMQ2DataVariable(szParamName, "", pType, &gMacroStack->Parameters, newValue.c_str());
 		}
 	}
 
 	if (g_pProfile)
 	{
-		std::string subroutine;
-		std::vector<std::string> args = ArgsToVector(szLine);
-
-		g_pProfile->Call(SubName, std::move(args));
+		g_pProfile->Call(std::move(SubName), ArgsToVector(args));
 	}
 }
 
@@ -1902,51 +2283,7 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 		char Arg2[MAX_STRING] = { 0 };
 		GetArg(Arg2, szLine, 2);
 
-		if (Arg2[0])
-		{
-			char szSub[64] = { 0 };
-			sprintf_s(szSub, "Sub Event_%s", Arg2);
-			MQEventQueue* pEvent = gEventQueue;
-
-			while (pEvent)
-			{
-				if ((pEvent->Type == EVENT_CHAT && !_stricmp("Sub Event_Chat", szSub))
-					|| (pEvent->Type == EVENT_TIMER && !_stricmp("Sub Event_Timer", szSub))
-					|| (pEvent->Type == EVENT_CUSTOM && !_stricmp(pEvent->pEventList->szName, szSub)))
-				{
-					MQEventQueue* pEventNext;
-					if (pEventNext = pEvent->pNext)
-						pEventNext->pPrev = pEvent->pPrev;
-					if (pEvent->pPrev)
-						pEvent->pPrev->pNext = pEvent->pNext;
-					else
-						gEventQueue = pEvent->pNext;
-
-					ClearMQ2DataVariables(&pEvent->Parameters);
-					DebugSpewNoFile("Doevents: Deleting pEvent %d %s", pEvent->Type, pEvent->Name.c_str());
-
-					delete pEvent;
-					pEvent = pEventNext;
-
-					continue;
-				}
-
-				pEvent = pEvent->pNext;
-			}
-		}
-		else
-		{
-			while (gEventQueue)
-			{
-				MQEventQueue* pEventNext = gEventQueue->pNext;
-
-				ClearMQ2DataVariables(&gEventQueue->Parameters);
-				DebugSpewNoFile("Doevents: Deleting gEventQueue %d %s", gEventQueue->Type, gEventQueue->Name.c_str());
-
-				delete gEventQueue;
-				gEventQueue = pEventNext;
-			}
-		}
+		FlushMacroEvents(Arg2);
 		return;
 	}
 
@@ -1957,36 +2294,13 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 		return;
 	}
 
-	MQEventQueue* pEvent = gEventQueue;
-	if (Arg1[0])
-	{
-		char szSub[64] = { 0 };
-		sprintf_s(szSub, "Sub Event_%s", Arg1);
+	MQEventQueue* pEvent = FindMacroEvent(Arg1);
+	if (!pEvent)
+		return; // no event found
 
-		while (pEvent)
-		{
-			if ((pEvent->Type == EVENT_CHAT && !_stricmp("Sub Event_Chat", szSub))
-				|| (pEvent->Type == EVENT_TIMER && !_stricmp("Sub Event_Timer", szSub))
-				|| (pEvent->Type == EVENT_CUSTOM && !_stricmp(pEvent->pEventList->szName, szSub)))
-			{
-				break;
-			}
+	UnlinkMacroEvent(pEvent);
 
-			pEvent = pEvent->pNext;
-		}
-
-		if (!pEvent)
-			return;// no event found
-	}
-
-	if (pEvent->pPrev)
-		pEvent->pPrev->pNext = pEvent->pNext;
-	else
-		gEventQueue = pEvent->pNext;
-	if (pEvent->pNext)
-		pEvent->pNext->pPrev = pEvent->pPrev;
-
-	DebugSpewNoFile("DoEvents: Running event type %d (%s) = 0x%p", pEvent->Type, (pEvent->pEventList) ? pEvent->pEventList->szName : "NONE", pEvent);
+	DebugSpewNoFile("DoEvents: Running event type %d (%s) = 0x%p", pEvent->Type, (pEvent->pEventList) ? pEvent->pEventList->Name.c_str() : "NONE", pEvent);
 
 	// back the current location to previous one so we fall into
 	// /doevents again.
@@ -2001,6 +2315,7 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 
 	MQMacroStack* pStack = new MQMacroStack(locationIndex);
 	pStack->Parameters = pEvent->Parameters;
+	pEvent->Parameters = nullptr;
 
 	MQDataVar* pParam = pStack->Parameters;
 	while (pParam) // FIX THE HEAD ON EVERY VAR WE MOVED
@@ -2020,9 +2335,6 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 		gMacroBlock->CurrIndex = gEventFunc[pEvent->Type];
 	}
 
-	DebugSpewNoFile("DoEvents - Deleted event: %d %s", pEvent->Type, pEvent->Name.c_str());
-
-	delete pEvent;
 	bRunNextCommand = true;
 
 	if (g_pProfile)
@@ -2040,7 +2352,7 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 		case EVENT_CUSTOM:
 			if (pEvent->pEventList)
 			{
-				std::string_view sv = pEvent->pEventList->szName;
+				std::string_view sv = pEvent->pEventList->Name;
 				if (ci_starts_with(sv, "Sub "))
 				{
 					eventName = sv.substr(4);
@@ -2059,7 +2371,7 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 
 		while (parameters)
 		{
-			if (parameters->Var.Type->ToString(pParam->Var.VarPtr, szArg))
+			if (parameters->Var.Type->ToString(parameters->Var.VarPtr, szArg))
 				args.emplace_back(szArg);
 			else
 				args.emplace_back("NULL");
@@ -2069,6 +2381,9 @@ void DoEvents(PSPAWNINFO pChar, char* szLine)
 
 		g_pProfile->Call(std::move(eventName), std::move(args));
 	}
+
+	DebugSpewNoFile("DoEvents - Deleted event: %d %s", pEvent->Type, pEvent->Name.c_str());
+	FreeMacroEvent(pEvent);
 }
 
 // ***************************************************************************
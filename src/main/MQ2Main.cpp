@@ -383,12 +383,20 @@ bool ParseINIFile(const std::string& iniFile)
 	gbIgnoreAlertRecursion   = GetPrivateProfileBool("MacroQuest", "IgnoreAlertRecursion", gbIgnoreAlertRecursion, iniFile);
 	gbShowCurrentCamera      = GetPrivateProfileBool("MacroQuest", "ShowCurrentCamera", gbShowCurrentCamera, iniFile);
 	gTurboLimit              = GetPrivateProfileInt("MacroQuest", "TurboLimit", gTurboLimit, iniFile);
+	gDefaultTurboBudget      = GetPrivateProfileInt("MacroQuest", "TurboBudget", gDefaultTurboBudget, iniFile);
+	gSlowPluginCallbackTime  = GetPrivateProfileInt("MacroQuest", "SlowPluginCallbackTime", gSlowPluginCallbackTime, iniFile);
+	gbTrackAllocations       = GetPrivateProfileBool("MacroQuest", "TrackAllocations", gbTrackAllocations, iniFile);
+	gbPeerRouting            = GetPrivateProfileBool("MacroQuest", "PeerRouting", gbPeerRouting, iniFile);
+	gbSharedSpawns           = GetPrivateProfileBool("MacroQuest", "SharedSpawns", gbSharedSpawns, iniFile);
+	gSharedSpawnRate         = GetPrivateProfileInt("MacroQuest", "SharedSpawnRate", gSharedSpawnRate, iniFile);
 	gCreateMQ2NewsWindow     = GetPrivateProfileBool("MacroQuest", "CreateMQ2NewsWindow", gCreateMQ2NewsWindow, iniFile);
 	gNetStatusXPos           = GetPrivateProfileInt("MacroQuest", "NetStatusXPos", gNetStatusXPos, iniFile);
 	gNetStatusYPos           = GetPrivateProfileInt("MacroQuest", "NetStatusYPos", gNetStatusYPos, iniFile);
 	gStackingDebug           = (eStackingDebug)GetPrivateProfileInt("MacroQuest", "BuffStackDebugMode", gStackingDebug, iniFile);
 	gUseNewNamedTest         = GetPrivateProfileBool("MacroQuest", "UseNewNamedTest", gUseNewNamedTest, iniFile);
 	gParserVersion           = GetPrivateProfileInt("MacroQuest", "ParserEngine", gParserVersion, iniFile); // 2 = new parser, everything else = old parser
+	gbLockFreeVariableReads  = GetPrivateProfileBool("MacroQuest", "LockFreeVariableReads", gbLockFreeVariableReads, iniFile);
+	gbLazySpawnSort          = GetPrivateProfileBool("MacroQuest", "LazySpawnSort", gbLazySpawnSort, iniFile);
 	gIfDelimiter             = GetPrivateProfileString("MacroQuest", "IfDelimiter", std::string(1, gIfDelimiter), iniFile)[0];
 	gIfAltDelimiter          = GetPrivateProfileString("MacroQuest", "IfAltDelimiter", std::string(1, gIfAltDelimiter), iniFile)[0];
 #if HAS_CHAT_TIMESTAMPS
@@ -418,12 +426,20 @@ bool ParseINIFile(const std::string& iniFile)
 		WritePrivateProfileBool("MacroQuest", "IgnoreAlertRecursion", gbIgnoreAlertRecursion, iniFile);
 		WritePrivateProfileBool("MacroQuest", "ShowCurrentCamera", gbShowCurrentCamera, iniFile);
 		WritePrivateProfileInt("MacroQuest", "TurboLimit", gTurboLimit, iniFile);
+		WritePrivateProfileInt("MacroQuest", "TurboBudget", gDefaultTurboBudget, iniFile);
+		WritePrivateProfileInt("MacroQuest", "SlowPluginCallbackTime", gSlowPluginCallbackTime, iniFile);
+		WritePrivateProfileBool("MacroQuest", "TrackAllocations", gbTrackAllocations, iniFile);
+		WritePrivateProfileBool("MacroQuest", "PeerRouting", gbPeerRouting, iniFile);
+		WritePrivateProfileBool("MacroQuest", "SharedSpawns", gbSharedSpawns, iniFile);
+		WritePrivateProfileInt("MacroQuest", "SharedSpawnRate", gSharedSpawnRate, iniFile);
 		WritePrivateProfileBool("MacroQuest", "CreateMQ2NewsWindow", gCreateMQ2NewsWindow, iniFile);
 		WritePrivateProfileInt("MacroQuest", "NetStatusXPos", gNetStatusXPos, iniFile);
 		WritePrivateProfileInt("MacroQuest", "NetStatusYPos", gNetStatusYPos, iniFile);
 		WritePrivateProfileInt("MacroQuest", "BuffStackDebugMode", gStackingDebug, iniFile);
 		WritePrivateProfileBool("MacroQuest", "UseNewNamedTest", gUseNewNamedTest, iniFile);
 		WritePrivateProfileInt("MacroQuest", "ParserEngine", gParserVersion, iniFile);
+		WritePrivateProfileBool("MacroQuest", "LockFreeVariableReads", gbLockFreeVariableReads, iniFile);
+		WritePrivateProfileBool("MacroQuest", "LazySpawnSort", gbLazySpawnSort, iniFile);
 		WritePrivateProfileString("MacroQuest", "IfDelimiter", std::string(1, gIfDelimiter), iniFile);
 		WritePrivateProfileString("MacroQuest", "IfAltDelimiter", std::string(1, gIfAltDelimiter), iniFile);
 #if HAS_CHAT_TIMESTAMPS
@@ -434,6 +450,8 @@ bool ParseINIFile(const std::string& iniFile)
 
 	GetPrivateProfileString("MacroQuest", "HUDMode", "UnderUI", szBuffer, MAX_STRING, iniFile);
 
+	gbHUDOverlay = false;
+
 	if (ci_equals(szBuffer, "normal"))
 	{
 		gbAlwaysDrawMQHUD = false;
@@ -446,6 +464,12 @@ bool ParseINIFile(const std::string& iniFile)
 			gbAlwaysDrawMQHUD = true;
 			gbHUDUnderUI = true;
 		}
+		else if (ci_equals(szBuffer, "overlay"))
+		{
+			gbAlwaysDrawMQHUD = true;
+			gbHUDUnderUI = true;
+			gbHUDOverlay = true;
+		}
 		else
 		{
 			strcpy_s(szBuffer, "UnderUI");
@@ -587,6 +611,9 @@ void DoMainThreadInitialization()
 {
 	gpMainAPI = new MainImpl();
 
+	// get the plugin dlls reading from disk while the rest of initialization runs.
+	PrefetchMQ2Plugins();
+
 	InitializeMQ2Commands();
 	InitializeDisplayHook();
 	GraphicsResources_Initialize();
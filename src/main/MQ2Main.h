@@ -21,8 +21,6 @@
 #include "eqlib/EQLib.h"
 using namespace eqlib;
 
-//#define MQ2_PROFILING
-
 // uncomment this line to turn off the single-line benchmark macro
 // #define DISABLE_BENCHMARKS
 
@@ -69,7 +67,9 @@ using namespace eqlib;
 // TODO: Move these to mq/Plugin.h so that they are not globally included -- include them
 // only where they are needed.
 
+#include "mq/base/CommandArgs.h"
 #include "mq/base/Detours.h"
+#include "mq/base/Signal.h"
 #include "mq/utils/Benchmarks.h"
 #include "mq/utils/Keybinds.h"
 
@@ -82,6 +82,7 @@ namespace mq {
 // Initialize/shutdown subsystems
 void ShutdownMQ2Benchmarks();
 void InitializeMQ2Benchmarks();
+void BeginBenchmarkFrame();
 
 void InitializeDisplayHook();
 void ShutdownDisplayHook();
@@ -91,6 +92,41 @@ void ShutdownMQ2Commands();
 
 void InitializeMQ2Pulse();
 void ShutdownMQ2Pulse();
+void AdvanceMacroTimers(uint64_t& elapsed);
+bool RunMacroFrame();
+void UpdateMQ2SpawnSort();
+
+// MQ2SessionRecorder.cpp
+void RecordSessionChat(const char* szMsg);
+
+// MQ2LogWriter.cpp. Log files are written in the background, in the order these are called.
+void AppendToLogFile(const std::filesystem::path& file, std::string text);
+void ClearLogFile(const std::filesystem::path& file);
+void OutputDebugSpew(std::string text); // OutputDebugString, from the same thread
+
+// MQ2IniCache.cpp. Ini reads served from memory, writes are flushed to disk in the background.
+MQLIB_OBJECT int GetCachedPrivateProfileString(const std::string& section, const std::string& key, const std::string& defaultValue,
+	char* buffer, size_t size, const std::string& iniFile);
+MQLIB_OBJECT std::string GetCachedPrivateProfileString(const std::string& section, const std::string& key, const std::string& defaultValue,
+	const std::string& iniFile);
+MQLIB_OBJECT int GetCachedPrivateProfileInt(const std::string& section, const std::string& key, int defaultValue, const std::string& iniFile);
+MQLIB_OBJECT bool GetCachedPrivateProfileBool(const std::string& section, const std::string& key, bool defaultValue, const std::string& iniFile);
+MQLIB_OBJECT std::vector<std::string> GetCachedPrivateProfileSections(const std::string& iniFile);
+MQLIB_OBJECT std::vector<std::pair<std::string, std::string>> GetCachedPrivateProfileKeyValues(const std::string& section, const std::string& iniFile);
+MQLIB_OBJECT bool CachedIniFileExists(const std::string& iniFile);
+MQLIB_OBJECT bool CachedIniKeyExists(const std::string& section, const std::string& key, const std::string& iniFile);
+MQLIB_OBJECT void WriteCachedPrivateProfileString(const std::string& section, const char* key, const char* value, const std::string& iniFile);
+MQLIB_OBJECT void FlushIniCache();
+
+// MQ2FrameLimiter.cpp
+float GetFrameLimiterSimulationFPS();
+void SetFrameLimiterHostBudget(float simulationFPS, std::chrono::milliseconds duration);
+void NotifyFrameLimiterActivity();
+bool IsFrameLimiterRendering();
+bool IsFrameLimiterPresenting();
+
+// MQ2Windows.cpp
+void ClearWindowChildIndex();
 
 void InitializeChatHook();
 void ShutdownChatHook();
@@ -126,6 +162,7 @@ MQLIB_API bool SendWndNotification(const char* WindowName, const char* ScreenID,
 MQLIB_API bool SendTabSelect(const char* WindowName, const char* ScreenID, int Value);
 MQLIB_API CXWnd* FindMQ2Window(const char* Name);
 MQLIB_API CXWnd* FindMQ2WindowPath(const char* Name);
+MQLIB_API CXWnd* FindMQ2WindowChild(CXWnd* pParent, const char* Name);
 MQLIB_API CXWnd* GetParentWnd(CXWnd* pWnd);
 MQLIB_API bool IsScreenPieceLoaded(const char*);
 
@@ -141,6 +178,7 @@ MQLIB_API void DeleteMQ2NewsWindow();
 MQLIB_API void dsp_chat_no_events(const char* Text, int Color, bool EqLog = true, bool dopercentsubst = true);
 
 MQLIB_API void WriteChatColor(const char* Line, int Color = USERCOLOR_DEFAULT, int Filter = 0);
+MQLIB_API void WriteChatColorLines(const std::vector<std::string>& Lines, int Color = USERCOLOR_DEFAULT, int Filter = 0);
 MQLIB_API void WriteChatf(const char* Format, ...);
 MQLIB_API void WriteChatColorf(const char* szFormat, int color, ...);
 
@@ -149,8 +187,10 @@ void WriteChatfSafe(const char* szFormat, ...);
 
 /* PLUGIN HANDLING */
 MQLIB_API void InitializeMQ2Plugins();
+void PrefetchMQ2Plugins();
 MQLIB_API int LoadMQ2Plugin(const char* pszFilename, bool bCustom = false);
 MQLIB_API bool UnloadMQ2Plugin(const char* pszFilename);
+MQLIB_API bool ReloadMQ2Plugin(const char* pszFilename);
 MQLIB_API void UnloadMQ2Plugins();
 MQLIB_API void ShutdownMQ2Plugins();
 MQLIB_API void ShutdownFailedPlugins();
@@ -167,6 +207,8 @@ void PluginsSetGameState(DWORD GameState);
 void PluginsDrawHUD();
 void PluginsAddSpawn(SPAWNINFO* pNewSpawn);
 void PluginsRemoveSpawn(SPAWNINFO* pSpawn);
+void PluginsRemoveSpawns(SPAWNINFO* const* spawns, size_t count);
+void JoinAsyncPluginPulse();
 void PluginsAddGroundItem(GROUNDITEM* pNewGroundItem);
 void PluginsRemoveGroundItem(GROUNDITEM* pGroundItem);
 void PluginsBeginZone();
@@ -179,6 +221,10 @@ void PluginsMacroStop(const char* Name);
 /* CLEAN UI */
 MQLIB_API void DrawHUD();
 
+// MQ2HUDText.cpp
+void AddHUDTextToBatch(const char* Text, int X, int Y, unsigned int Argb, int Font);
+void ClearHUDTextBatch();
+
 /* COMMAND HANDLING */
 MQLIB_API void AddCommand(const char* Command, fEQCommand Function, bool EQ = false, bool Parse = true, bool InGame = false);
 MQLIB_API void AddAlias(const char* ShortCommand, const char* LongCommand);
@@ -247,6 +293,32 @@ inline void DoCommand(PSPAWNINFO pSpawnInfo, const char* szCommand)
 }
 inline void EzCommand(const char* szCommand) { DoCommand(pLocalPlayer, szCommand); }
 
+// Macro lines are compiled when they are loaded and dispatched through their compiled command.
+void CompileMacroLine(MQMacroLine& line);
+void DoMacroLine(SPAWNINFO* pChar, MQMacroLine& line);
+
+// The macro event queue. Events are kept in arrival order in gEventQueue and are also indexed by
+// the sub that handles them, so that /doevents <name> only visits the events for that sub.
+MQEventQueue* AllocateMacroEvent();
+void FreeMacroEvent(MQEventQueue* pEvent);
+void QueueMacroEvent(MQEventQueue* pEvent);
+void UnlinkMacroEvent(MQEventQueue* pEvent);
+MQEventQueue* FindMacroEvent(const char* szName);
+void FlushMacroEvents(const char* szName = nullptr);
+
+// Per line timing for /profile sessions. When no session is active, BeginMacroLineProfile returns
+// an empty profile and EndMacroLineProfile does nothing.
+class StackFrame;
+struct MQMacroLineProfile
+{
+	StackFrame* pFrame = nullptr;
+	uint32_t SessionId = 0;
+	std::chrono::steady_clock::time_point StartTime;
+};
+
+MQMacroLineProfile BeginMacroLineProfile();
+void EndMacroLineProfile(const MQMacroLineProfile& profile, MQMacroLine& line, int lineIndex);
+
 MQLIB_API DWORD MQToSTML(const char* in, char* out, size_t maxlen = MAX_STRING, uint32_t ColorOverride = 0xFFFFFF);
 MQLIB_API void StripMQChat(const char* in, char* out);
 MQLIB_OBJECT void StripMQChat(std::string_view in, char* out);
@@ -256,6 +328,8 @@ MQLIB_API const char* GetFilenameFromFullPath(const char* Filename);
 MQLIB_API bool CompareTimes(char* RealTime, char* ExpectedTime);
 MQLIB_API void AddFilter(const char* szFilter, int Length, bool& pEnabled);
 MQLIB_API void DefaultFilters();
+MQLIB_API bool IsChatFiltered(const char* szLine);
+MQLIB_API void InvalidateChatFilters(); // after changing gpFilters other than through AddFilter
 MQLIB_API char* ConvertHotkeyNameToKeyName(char* szName);
 MQLIB_API void CheckChatForEvent(const char* szMsg);
 MQLIB_API int FindInvSlotForContents(ItemClient* pContents);
@@ -290,6 +364,12 @@ MQLIB_API bool IsActiveAA(const char* pSpellName);
 MQLIB_API CXWnd* GetAdvLootPersonalListItem(DWORD ListIndex, DWORD type);
 MQLIB_API CXWnd* GetAdvLootSharedListItem(DWORD ListIndex, DWORD type);
 MQLIB_API bool LootInProgress(CAdvancedLootWnd* pAdvLoot, CListWnd* pPersonalList, CListWnd* pSharedList);
+// Rows of the personal or shared advanced loot list, found by name or item id, or -1.
+MQLIB_OBJECT int FindAdvLootRowByName(bool shared, std::string_view itemName);
+MQLIB_OBJECT int FindAdvLootRowByID(bool shared, int64_t itemID);
+// Applies /advloot actions to many items at once. Items are names or row numbers, like /advloot
+// takes them. Returns how many were applied.
+MQLIB_OBJECT int DoAdvLootActions(bool shared, const std::vector<std::pair<std::string, std::string>>& actions);
 MQLIB_API void WeDidStuff();
 MQLIB_API int GetFreeInventory(int nSize);
 MQLIB_API int GetFreeStack(ItemClient* pContents);
@@ -385,6 +465,8 @@ MQLIB_API const char* GetLDoNTheme(int LDTheme);
 MQLIB_API bool TriggeringEffectSpell(SPELL* aSpell, int i);
 MQLIB_API bool BuffStackTest(SPELL* aSpell, SPELL* bSpell, bool bIgnoreTriggeringEffects = false, bool bTriggeredEffectCheck = false);
 MQLIB_API bool WillStackWith(const EQ_Spell* testSpell, const EQ_Spell* existingSpell);
+// Drops the stacking results BuffStackTest and WillStackWith keep, called when the spells are reloaded.
+void InvalidateSpellStackingCache();
 MQLIB_API bool IsSpellTooPowerful(PlayerClient* caster, PlayerClient* target, EQ_Spell* spell);
 MQLIB_API uint32_t GetItemTimer(ItemClient* pItem);
 MQLIB_API ItemClient* GetItemContentsByName(const char* ItemName);
@@ -497,10 +579,13 @@ MQLIB_OBJECT CXStr GetFriendlyNameForGroundItem(const EQGroundItem* pItem);
 MQLIB_OBJECT CXStr GetFriendlyNameForPlacedItem(const EQPlacedItem* pItem);
 MQLIB_API char* GetFriendlyNameForGroundItem(PGROUNDITEM pItem, char* szName, size_t BufferSize);
 
+// Ground spawn index in MQ2GroundSpawns.cpp, kept up to date by the ground item hooks in MQ2Spawns.cpp.
+void AddGroundSpawnToIndex(EQGroundItem* pItem);
+void RemoveGroundSpawnFromIndex(EQGroundItem* pItem);
+
 inline auto EQObjectID(PlayerClient* pSpawn) { return pSpawn->SpawnID; }
 using ObservedSpawnPtr = MQEQObjectPtr<PlayerClient>;
 
-MQLIB_API void AddObservedEQObject(const std::shared_ptr<MQTransient>& Object);
 MQLIB_API void InvalidateObservedEQObject(void* Object);
 
 // A.k.a. "Door target"
@@ -515,6 +600,25 @@ MQLIB_API SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWN
 MQLIB_API int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin = false);
 MQLIB_API SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar);
 MQLIB_API bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn);
+
+// A spawn search reduced to the conditions it actually uses, ordered cheapest first, for testing
+// many spawns against one search. It reads the search as it is when constructed, so build it after
+// the search has been filled in.
+enum class MQSpawnSearchCheck : uint8_t;
+class MQLIB_OBJECT MQCompiledSpawnSearch
+{
+public:
+	static constexpr size_t MaxChecks = 40;
+
+	explicit MQCompiledSpawnSearch(MQSpawnSearch* pSearchSpawn);
+
+	bool Matches(SPAWNINFO* pChar, SPAWNINFO* pSpawn) const;
+
+private:
+	MQSpawnSearch* m_pSearchSpawn = nullptr;
+	MQSpawnSearchCheck m_checks[MaxChecks];
+	size_t m_numChecks = 0;
+};
 MQLIB_API bool SearchSpawnMatchesSearchSpawn(MQSpawnSearch* pSearchSpawn1, MQSpawnSearch* pSearchSpawn2);
 MQLIB_API const char* ParseSearchSpawnArgs(char* szArg, const char* szRest, MQSpawnSearch* pSearchSpawn);
 MQLIB_API void ParseSearchSpawn(const char* Buffer, MQSpawnSearch* pSearchSpawn);
@@ -523,6 +627,27 @@ MQLIB_API bool IsPCNear(SPAWNINFO* pSpawn, float Radius);
 MQLIB_API bool IsInGroup(SPAWNINFO* pSpawn, bool bCorpse = false);
 MQLIB_API bool IsInFellowship(SPAWNINFO* pSpawn, bool bCorpse = false);
 MQLIB_API bool IsInRaid(SPAWNINFO* pSpawn, bool bCorpse = false);
+MQLIB_OBJECT int GetGroupMemberIndexByName(std::string_view name); // ${Group.Member} index, or -1
+MQLIB_OBJECT int GetRaidMemberSlotByName(std::string_view name);   // raid slot, or -1
+
+// Spawn grid in MQ2Spawns.cpp. These append the spawns near a point and return false if the grid
+// hasn't been built, in that case every spawn has to be checked. The grid only moves with the spawns
+// once per pulse, so results include spawns up to one cell past what was asked for.
+constexpr float SPAWN_GRID_CELL_SIZE = 64.0f;
+// Sorts gSpawnsArray if it hasn't been sorted yet this pulse, call before reading it.
+void EnsureMQ2SpawnSort();
+// Drops the results NthNearestSpawn and CountMatchingSpawns keep for repeated searches. Called every
+// pulse and whenever spawns or alerts change.
+void InvalidateSpawnSearchCache();
+bool IsSpawnGridBuilt();
+bool GetSpawnsInRadius(float X, float Y, float Radius, std::vector<SPAWNINFO*>& spawns);
+// Ring 0 is the block of cells around X,Y and each ring after it the cells one further out. Returns
+// false once the ring covers the whole grid.
+bool GetSpawnsInRing(float X, float Y, int Ring, std::vector<SPAWNINFO*>& spawns);
+// Appends every player closer than Radius to X,Y,Z, using the spawn positions from the last sort.
+// Returns false if they haven't been taken yet.
+bool GetPlayersInRadius(float X, float Y, float Z, float Radius, std::vector<SPAWNINFO*>& spawns);
+
 MQLIB_API bool IsAlert(SPAWNINFO* pChar, SPAWNINFO* pSpawn, uint32_t id);
 MQLIB_API bool GetClosestAlert(SPAWNINFO* pSpawn, uint32_t id);
 MQLIB_API bool IsAlert(SPAWNINFO* pChar, SPAWNINFO* pSpawn, uint32_t List);
@@ -546,6 +671,15 @@ MQLIB_API bool        PlayerHasAAAbility(int AAIndex);
 MQLIB_API const char* GetAANameByIndex(int AAIndex);
 MQLIB_API int         GetAAIndexByName(const char* AAName);
 MQLIB_API int         GetAAIndexByID(int ID);
+// Alt ability lookup tables in MQ2Utilities.cpp. Names are matched case insensitively at the
+// character's level, ids at any level. The owned ability table is checked against the character's
+// abilities after InvalidateAltAbilityTables, which is called every pulse.
+void InvalidateAltAbilityTables();
+const std::vector<CAltAbilityData*>* FindAltAbilitiesByName(std::string_view name);
+CAltAbilityData* FindAltAbilityByName(std::string_view name);
+CAltAbilityData* FindAltAbilityByGroupID(int groupID);
+CAltAbilityData* FindOwnedAltAbilityByName(std::string_view name);
+CAltAbilityData* FindOwnedAltAbilityByID(int abilityID);
 MQLIB_API int         GetSkillIDFromName(const char* name);
 MQLIB_API bool        InHoverState();
 MQLIB_API int         GetGameState();
@@ -562,6 +696,13 @@ MQLIB_API ItemClient*   FindItemByGlobalIndex(const ItemGlobalIndex& idx);
    inline ItemClient* FindItemBySlot(const ItemGlobalIndex& idx) { return FindItemByGlobalIndex(idx); }
    DEPRECATE("Use FindItemByGlobalIndex instead of FindItemBySlot2")
    inline ItemClient*   FindItemBySlot2(const ItemGlobalIndex& idx) { return FindItemByGlobalIndex(idx); }
+// Drops the index FindItem*, FindItemCount* and FindBankItem* look items up in. Called every pulse
+// and whenever MQ moves an item.
+void InvalidateInventoryIndex();
+// Changes every time the inventory index is invalidated.
+uint32_t GetInventoryIndexGeneration();
+// Drops the merchant item name index in MQ2MerchantType.cpp, called whenever the merchant list is refreshed.
+void InvalidateMerchantItemIndex();
 MQLIB_API ItemClient*   FindItemByName(const char* pName, bool bExact = false);
 MQLIB_API ItemClient*   FindItemByID(int ItemID);
 MQLIB_API int         FindItemCountByName(const char* pName);
@@ -635,9 +776,38 @@ MQLIB_OBJECT std::optional<CachedBuff> GetCachedBuffAtSlot(SPAWNINFO* pSpawn, in
 MQLIB_OBJECT std::vector<CachedBuff> FilterCachedBuffs(SPAWNINFO* pSpawn, const std::function<bool(const CachedBuff&)>& predicate);
 MQLIB_API    DWORD GetCachedBuffCount(SPAWNINFO* pSpawn);
 MQLIB_OBJECT DWORD GetCachedBuffCount(SPAWNINFO* pSpawn, const std::function<bool(const CachedBuff&)>& predicate);
+MQLIB_API    int GetCachedBuffSlotBySpellID(SPAWNINFO* pSpawn, int spellID);
+// Appends the IDs of the spawns with a cached buff of spellID, returns how many were added.
+MQLIB_OBJECT size_t GetSpawnsWithCachedBuff(int spellID, std::vector<uint32_t>& spawnIDs);
+// Signalled with the spawn ID and buff shortly before a cached buff runs out, and once it has and was removed.
+MQLIB_OBJECT Signal<uint32_t, const CachedBuff&>& GetCachedBuffFadingSignal();
+MQLIB_OBJECT Signal<uint32_t, const CachedBuff&>& GetCachedBuffFadedSignal();
 MQLIB_API    void ClearCachedBuffsSpawn(SPAWNINFO* pSpawn);
 MQLIB_API    void ClearCachedBuffs();
 
+// Tasks
+struct TaskObjectiveIndex
+{
+	int taskIndex;                 // into SharedTaskEntries or QuestEntries, depending on systemType
+	int objectiveIndex;            // into the task's Elements
+	TaskSystemType systemType;
+};
+
+struct MQTaskObjectiveChange
+{
+	CTaskEntry* Task;
+	int Objective;                 // into Task->Elements
+	int PreviousCount;
+	int CurrentCount;
+};
+
+MQLIB_OBJECT int FindTaskIndex(CTaskEntry* task);
+MQLIB_OBJECT TaskObjectiveIndex FindObjectiveIndex(CTaskElement* objective);
+// The objective's description, kept from one call to the next until its count changes. Good until the next call.
+MQLIB_OBJECT const std::string& GetTaskObjectiveDescription(CTaskElement* objective);
+// Signalled when the current count of one of the character's task objectives changes. Checked every pulse.
+MQLIB_OBJECT Signal<const MQTaskObjectiveChange&>& GetTaskObjectiveChangedSignal();
+
 MQLIB_API DEPRECATE("Use GetCachedBuff with predicates instead") int GetTargetBuffByCategory(DWORD category, DWORD classmask = 0, int startslot = 0);
 MQLIB_API DEPRECATE("Use GetCachedBuff with predicates instead") int GetTargetBuffBySubCat(const char* subcat, DWORD classmask = 0, int startslot = 0);
 MQLIB_API DEPRECATE("Use GetCachedBuff with predicates instead") int GetTargetBuffBySPA(int spa, bool bIncrease, int startslot = 0);
@@ -675,6 +845,11 @@ MQLIB_API    int64_t     GetTotalSpellCounters(const EQ_Affect& buff);        //
 MQLIB_API    int64_t     GetMyTotalSpellCounters();                           // Get total count of spell counters for my character.
 MQLIB_API    int         GetMeleeSpeedPctFromSpell(EQ_Spell* pSpell, bool increase);
 MQLIB_API    EQ_Spell*   GetHighestLearnedSpellByGroupID(int dwSpellGroupID);
+MQLIB_API    int         GetSpellBookSlot(int spellID);                          // Book slot holding the spell, or -1.
+MQLIB_API    int         GetSpellBookSlotByName(std::string_view name);          // Book slot holding the spell, or -1.
+// Scribed spells in the group, in book order.
+MQLIB_OBJECT const std::vector<EQ_Spell*>& GetSpellBookSpellsByGroupID(int spellGroupID);
+MQLIB_API    int         GetMemorizedSpellGem(std::string_view name);            // Gem index holding the spell, or -1.
 MQLIB_API    DWORD       GetSpellID(EQ_Spell* spell);
 MQLIB_OBJECT DWORD       GetSpellID(const EQ_Affect& buff);
 MQLIB_OBJECT DWORD       GetSpellID(const CachedBuff& buff);
@@ -713,6 +888,15 @@ MQLIB_API void EndAllMacros();
 
 MQLIB_API bool Calculate(const char* szFormula, double& Dest);
 
+// Marks the position of a bound value in a formula passed to CalculateBound.
+constexpr char CALC_BOUND_VALUE = '@';
+
+// Calculate a formula in which each CALC_BOUND_VALUE marker stands for the next of the given values,
+// without writing the values into the text. Returns -1 if the values can't be placed, for example
+// because a marker is right next to a number, in which case the formula should be calculated as text.
+// Otherwise returns 1 on success and 0 on failure, like Calculate.
+int CalculateBound(const char* szFormula, const double* values, size_t count, double& Result);
+
 // Given a string that contains a number, make the number "pretty" by adding things like
 // comma separators, or decimals.
 MQLIB_API void PrettifyNumber(char* string, size_t bufferSize, int decimals = 0);
@@ -786,6 +970,8 @@ inline DEPRECATE("Use GetMembershipLevel instead of GetSubscriptionLevel") int G
 } // namespace mq
 
 #include "mq/api/Achievements.h"
+#include "mq/api/GameSnapshot.h"
+#include "mq/api/SharedSpawns.h"
 #include "mq/api/Spells.h"
 
 #include "GraphicsEngine.h"  // TODO: Move exports to mq/api header
@@ -15,11 +15,16 @@
 #include "pch.h"
 #include "MQ2Main.h"
 
+#include "routing/PostOffice.h"
+
 #include <spdlog/spdlog.h>
 #include <wil/resource.h>
 
 #include <mq/utils/OS.h>
 
+#include <fstream>
+#include <future>
+
 //#define DEBUG_PLUGINS
 
 namespace mq {
@@ -36,6 +41,27 @@ MQPlugin* pPlugins = nullptr;
 static std::atomic_bool s_pluginsInitialized = false;
 static std::recursive_mutex s_pluginsMutex;
 
+// The plugins and modules that implement each callback, in dispatch order. These are rebuilt
+// whenever a plugin or module is added or removed so that dispatch only visits subscribers.
+static std::vector<MQPlugin*> s_pluginSubscribers[static_cast<size_t>(PluginCallback::Count)];
+static std::vector<MQModule*> s_moduleSubscribers[static_cast<size_t>(PluginCallback::Count)];
+
+static void RebuildPluginSubscribers();
+static void RebuildModuleSubscribers();
+
+// Spawns added since the last pulse that have not yet been delivered to OnAddSpawns.
+static std::vector<SPAWNINFO*> s_pendingAddedSpawns;
+
+static void FlushPendingAddedSpawns();
+
+// OnAsyncPulse calls that are running on worker threads. Only touched from the main thread.
+struct AsyncPulseTask
+{
+	MQPlugin* plugin;
+	std::future<std::chrono::nanoseconds> result;
+};
+static std::vector<AsyncPulseTask> s_asyncPulseTasks;
+
 // a map of plugin names to plugins. The string_view is a reference to the name in the
 // MQPlugin instance.
 using PluginMap = ci_unordered::map<std::string_view, MQPlugin*>;
@@ -49,8 +75,19 @@ static const char EverQuestVersion[] = __ExpectedVersionDate " " __ExpectedVersi
 // load failure string for reporting error message out of the plugin load command.
 static std::string s_pluginLoadFailure;
 
+// Resolved plugin files by lowercase plugin name, consulted by LoadPluginModule while the
+// configured plugins are being loaded.
+static std::unordered_map<std::string, std::string> s_preparedPluginFiles;
+
 static bool s_hotReloadEnabled = true;
 
+// State that plugins saved before a reload, by plugin name. Handed back once they load again.
+static ci_unordered::map<std::string, std::string> s_pluginReloadStates;
+
+// Mailbox that "/plugin <name> reload all" broadcasts to, and the reloads it has asked for.
+static postoffice::Dropbox s_pluginReloadDropbox;
+static std::vector<std::string> s_pendingPluginReloads;
+
 //----------------------------------------------------------------------------
 
 uint32_t bmWriteChatColor = 0;
@@ -65,6 +102,35 @@ uint32_t bmCalculate = 0;
 uint32_t bmBeginZone = 0;
 uint32_t bmEndZone = 0;
 
+// Each module and plugin with a pulse gets its own benchmark, so that the benchmark tree shows
+// which of them PluginsPulse was spending its time in.
+static std::unordered_map<const void*, uint32_t> s_pulseBenchmarks;
+
+// Plugin callbacks that took longer than gSlowPluginCallbackTime, waiting to be reported.
+static std::vector<std::string> s_slowCallbackWarnings;
+static constexpr uint64_t SLOW_CALLBACK_WARNING_INTERVAL = 10000;   // ms between warnings for one callback
+
+static void AddPulseBenchmark(const void* owner, std::string_view name)
+{
+	s_pulseBenchmarks[owner] = AddMQ2Benchmark(fmt::format("Pulse: {}", name).c_str());
+}
+
+static void RemovePulseBenchmark(const void* owner)
+{
+	auto iter = s_pulseBenchmarks.find(owner);
+	if (iter != s_pulseBenchmarks.end())
+	{
+		RemoveMQ2Benchmark(iter->second);
+		s_pulseBenchmarks.erase(iter);
+	}
+}
+
+static uint32_t GetPulseBenchmark(const void* owner)
+{
+	auto iter = s_pulseBenchmarks.find(owner);
+	return iter != s_pulseBenchmarks.end() ? iter->second : static_cast<uint32_t>(-1);
+}
+
 //----------------------------------------------------------------------------
 // If true, imgui should not run on plugins.
 extern bool gbManualResetRequired;
@@ -77,17 +143,37 @@ DWORD CALLBACK InitializeMQ2SpellDb(void* pData);
 std::vector<MQModule*> gInternalModules;
 static ModuleInitializer* s_moduleInitializerList = nullptr;
 
+// Modules that are waiting to be initialized after startup, in initialization order.
+static std::vector<MQModule*> s_deferredModules;
+
 void InitializeInternalModules()
 {
 	ModuleInitializer* initializer = s_moduleInitializerList;
 
 	while (initializer)
 	{
-		AddInternalModule(initializer->module);
+		if (initializer->deferred)
+			s_deferredModules.push_back(initializer->module);
+		else
+			AddInternalModule(initializer->module);
+
 		initializer = initializer->next;
 	}
 }
 
+// Bring up one deferred module per call so that their combined cost is spread across
+// frames instead of delaying the first usable frame after injection.
+void InitializeDeferredModules()
+{
+	if (s_deferredModules.empty())
+		return;
+
+	MQModule* module = s_deferredModules.front();
+	s_deferredModules.erase(s_deferredModules.begin());
+
+	AddInternalModule(module);
+}
+
 void AddStaticInitializationModule(ModuleInitializer* module)
 {
 	module->next = s_moduleInitializerList;
@@ -99,6 +185,9 @@ void AddInternalModule(MQModule* module, bool manualUnload /*=false*/)
 	SPDLOG_DEBUG("Initializing module: {0}", module->name);
 
 	gInternalModules.push_back(module);
+	RebuildModuleSubscribers();
+
+	AddPulseBenchmark(module, module->name);
 
 	if (module->Initialize)
 		module->Initialize();
@@ -117,6 +206,8 @@ void RemoveInternalModule(MQModule* module)
 		return;
 
 	gInternalModules.erase(iter);
+	RebuildModuleSubscribers();
+	RemovePulseBenchmark(module);
 
 	if (module->loaded && module->Shutdown)
 	{
@@ -127,6 +218,8 @@ void RemoveInternalModule(MQModule* module)
 
 void ShutdownInternalModules()
 {
+	s_deferredModules.clear();
+
 	auto modulesCopy = gInternalModules;
 
 	for (auto iter = modulesCopy.rbegin(); iter != modulesCopy.rend(); ++iter)
@@ -300,7 +393,14 @@ std::pair<wil::unique_hmodule, std::string> LoadPluginModule(std::string_view na
 
 	DebugSpew("LoadMQ2Plugin(%.*s)", name.length(), name.data());
 
-	std::string fileName = FindPluginFile(name);
+	std::string fileName;
+
+	auto prepared = s_preparedPluginFiles.find(to_lower_copy(std::string(name)));
+	if (prepared != s_preparedPluginFiles.end())
+		fileName = prepared->second;
+	else
+		fileName = FindPluginFile(name);
+
 	if (fileName.empty())
 	{
 		s_pluginLoadFailure = "Plugin not found";
@@ -366,6 +466,11 @@ void AddPluginToList(MQPlugin* pPlugin)
 	if (pPlugins)
 		pPlugins->pLast = pPlugin;
 	pPlugins = pPlugin;
+
+	RebuildPluginSubscribers();
+
+	if (pPlugin->Pulse)
+		AddPulseBenchmark(pPlugin, pPlugin->name);
 }
 
 void RemovePluginFromList(MQPlugin* pPlugin)
@@ -379,6 +484,9 @@ void RemovePluginFromList(MQPlugin* pPlugin)
 		pPlugins = pPlugin->pNext;
 	if (pPlugin->pNext)
 		pPlugin->pNext->pLast = pPlugin->pLast;
+
+	RebuildPluginSubscribers();
+	RemovePulseBenchmark(pPlugin);
 }
 
 // 0 - failed
@@ -426,6 +534,7 @@ int LoadMQ2Plugin(const char* pszFilename, bool)
 	pPlugin->Shutdown          = (fMQShutdownPlugin)GetProcAddress(pPlugin->hModule, "ShutdownPlugin");
 	pPlugin->IncomingChat      = (fMQIncomingChat)GetProcAddress(pPlugin->hModule, "OnIncomingChat");
 	pPlugin->Pulse             = (fMQPulse)GetProcAddress(pPlugin->hModule, "OnPulse");
+	pPlugin->AsyncPulse        = (fMQPulse)GetProcAddress(pPlugin->hModule, "OnAsyncPulse");
 	pPlugin->WriteChatColor    = (fMQWriteChatColor)GetProcAddress(pPlugin->hModule, "OnWriteChatColor");
 	pPlugin->Zoned             = (fMQZoned)GetProcAddress(pPlugin->hModule, "OnZoned");
 	pPlugin->CleanUI           = (fMQCleanUI)GetProcAddress(pPlugin->hModule, "OnCleanUI");
@@ -434,6 +543,8 @@ int LoadMQ2Plugin(const char* pszFilename, bool)
 	pPlugin->SetGameState      = (fMQSetGameState)GetProcAddress(pPlugin->hModule, "SetGameState");
 	pPlugin->AddSpawn          = (fMQSpawn)GetProcAddress(pPlugin->hModule, "OnAddSpawn");
 	pPlugin->RemoveSpawn       = (fMQSpawn)GetProcAddress(pPlugin->hModule, "OnRemoveSpawn");
+	pPlugin->AddSpawns         = (fMQSpawns)GetProcAddress(pPlugin->hModule, "OnAddSpawns");
+	pPlugin->RemoveSpawns      = (fMQSpawns)GetProcAddress(pPlugin->hModule, "OnRemoveSpawns");
 	pPlugin->AddGroundItem     = (fMQGroundItem)GetProcAddress(pPlugin->hModule, "OnAddGroundItem");
 	pPlugin->RemoveGroundItem  = (fMQGroundItem)GetProcAddress(pPlugin->hModule, "OnRemoveGroundItem");
 	pPlugin->BeginZone         = (fMQBeginZone)GetProcAddress(pPlugin->hModule, "OnBeginZone");
@@ -444,6 +555,9 @@ int LoadMQ2Plugin(const char* pszFilename, bool)
 	pPlugin->LoadPlugin        = (fMQLoadPlugin)GetProcAddress(pPlugin->hModule, "OnLoadPlugin");
 	pPlugin->UnloadPlugin      = (fMQUnloadPlugin)GetProcAddress(pPlugin->hModule, "OnUnloadPlugin");
 	pPlugin->GetPluginInterface = (fMQGetPluginInterface)GetProcAddress(pPlugin->hModule, "GetPluginInterface");
+	pPlugin->SaveReloadState   = (fMQSaveReloadState)GetProcAddress(pPlugin->hModule, "OnSaveReloadState");
+	pPlugin->RestoreReloadState = (fMQRestoreReloadState)GetProcAddress(pPlugin->hModule, "OnRestoreReloadState");
+	pPlugin->Allocations       = (const MQAllocationCounters*)GetProcAddress(pPlugin->hModule, "PluginAllocations");
 
 	float* ftmp = (float*)GetProcAddress(pPlugin->hModule, "?MQ2Version@@3MA");
 	if (ftmp)
@@ -454,9 +568,22 @@ int LoadMQ2Plugin(const char* pszFilename, bool)
 	if (pPlugin->Self)
 		*pPlugin->Self = pPlugin;
 
-	// initialize plugin
+	// initialize plugin, with whatever detours it adds patched in together
 	if (pPlugin->Initialize)
+	{
+		DetourBatch batch;
 		pPlugin->Initialize();
+	}
+
+	// hand back whatever the plugin saved if this load is part of a reload
+	auto reloadState = s_pluginReloadStates.find(pPlugin->name);
+	if (reloadState != s_pluginReloadStates.end())
+	{
+		if (pPlugin->RestoreReloadState)
+			pPlugin->RestoreReloadState(reloadState->second);
+
+		s_pluginReloadStates.erase(reloadState);
+	}
 
 	// init gamestate
 	if (pPlugin->SetGameState)
@@ -464,8 +591,21 @@ int LoadMQ2Plugin(const char* pszFilename, bool)
 
 	if (GetGameState() == GAMESTATE_INGAME)
 	{
+		// Deliver anything still queued to the other plugins first, otherwise this plugin would
+		// receive the queued spawns twice.
+		FlushPendingAddedSpawns();
+
 		// init spawns
-		if (pPlugin->AddSpawn)
+		if (pPlugin->AddSpawns)
+		{
+			std::vector<SPAWNINFO*> spawns;
+			for (SPAWNINFO* pSpawn = pSpawnList; pSpawn; pSpawn = pSpawn->pNext)
+				spawns.push_back(pSpawn);
+
+			if (!spawns.empty())
+				pPlugin->AddSpawns(spawns.data(), spawns.size());
+		}
+		else if (pPlugin->AddSpawn)
 		{
 			SPAWNINFO* pSpawn = pSpawnList;
 			while (pSpawn)
@@ -503,6 +643,9 @@ bool UnloadMQ2Plugin(const char* pszFilename)
 {
 	DebugSpew("UnloadMQ2Plugin(%s)", pszFilename);
 
+	// The plugin can't go away while its OnAsyncPulse may still be running.
+	JoinAsyncPluginPulse();
+
 	// Clear the load error message;
 	s_pluginLoadFailure.clear();
 
@@ -540,9 +683,16 @@ bool UnloadMQ2Plugin(const char* pszFilename)
 	if (pPlugin->CleanUI)
 		pPlugin->CleanUI();
 
-	// call Plugin:Shutdown
+	// call Plugin:Shutdown. Its detours have to be gone before the library is freed, so the batch
+	// is committed right after.
 	if (pPlugin->Shutdown)
+	{
+		DetourBatch batch;
 		pPlugin->Shutdown();
+	}
+
+	// settings saved on the way out need to be on disk before the plugin can be loaded again
+	FlushIniCache();
 
 	// Cleanup
 	if (FreeLibrary(pPlugin->hModule))
@@ -580,6 +730,65 @@ bool UnloadMQ2Plugin(const char* pszFilename)
 	return true;
 }
 
+// Unloads and loads a plugin again. A plugin that exports OnSaveReloadState can serialize its
+// state before it is unloaded, and gets it back through OnRestoreReloadState once it is loaded.
+bool ReloadMQ2Plugin(const char* pszFilename)
+{
+	MQPlugin* pPlugin = GetPlugin(pszFilename);
+	if (!pPlugin)
+	{
+		s_pluginLoadFailure = "Plugin is not loaded";
+		return false;
+	}
+
+	const std::string pluginName = pPlugin->name;
+	const std::string fileName = pPlugin->szFilename;
+
+	if (pPlugin->SaveReloadState)
+	{
+		std::string state;
+		pPlugin->SaveReloadState(state);
+		s_pluginReloadStates[pluginName] = std::move(state);
+	}
+
+	bool result = UnloadMQ2Plugin(fileName.c_str()) && LoadMQ2Plugin(fileName.c_str()) == 1;
+
+	// don't hold on to the state if the plugin never made it back
+	s_pluginReloadStates.erase(pluginName);
+	return result;
+}
+
+static void ReloadPluginWithMessage(const char* szName)
+{
+	if (ReloadMQ2Plugin(szName))
+	{
+		WriteChatf("Plugin '%s' reloaded.", szName);
+	}
+	else
+	{
+		MacroError("Plugin '%s' could not be reloaded: %s", szName,
+			s_pluginLoadFailure.empty() ? "Unknown Error" : s_pluginLoadFailure.c_str());
+		s_pluginLoadFailure.clear();
+	}
+}
+
+// Reloads that were broadcast from other clients. These arrive while mail is being delivered,
+// which is no place to unload a plugin that may own a mailbox, so they wait for the next pulse.
+static void ProcessPendingPluginReloads()
+{
+	if (s_pendingPluginReloads.empty())
+		return;
+
+	std::vector<std::string> reloads;
+	reloads.swap(s_pendingPluginReloads);
+
+	for (const std::string& name : reloads)
+	{
+		if (GetPlugin(name))
+			ReloadPluginWithMessage(name.c_str());
+	}
+}
+
 void UnloadMQ2Plugins()
 {
 	while (pPlugins)
@@ -622,27 +831,203 @@ void ShutdownFailedPlugins()
 	}
 }
 
+static const char* s_pluginCallbackNames[] = {
+	"WriteChatColor",
+	"IncomingChat",
+	"Pulse",
+	"AsyncPulse",
+	"Zoned",
+	"CleanUI",
+	"ReloadUI",
+	"DrawHUD",
+	"SetGameState",
+	"AddSpawn",
+	"RemoveSpawn",
+	"AddSpawns",
+	"RemoveSpawns",
+	"AddGroundItem",
+	"RemoveGroundItem",
+	"BeginZone",
+	"EndZone",
+	"UpdateImGui",
+	"MacroStart",
+	"MacroStop",
+	"LoadPlugin",
+	"UnloadPlugin",
+};
+static_assert(lengthof(s_pluginCallbackNames) == static_cast<size_t>(PluginCallback::Count));
+
+const char* GetPluginCallbackName(PluginCallback callback)
+{
+	if (callback >= PluginCallback::Count)
+		return "Unknown";
+
+	return s_pluginCallbackNames[static_cast<size_t>(callback)];
+}
+
+bool FindPluginCallback(std::string_view name, PluginCallback& callback)
+{
+	for (size_t i = 0; i < lengthof(s_pluginCallbackNames); ++i)
+	{
+		if (ci_equals(name, s_pluginCallbackNames[i]))
+		{
+			callback = static_cast<PluginCallback>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool HasPluginCallback(const MQPlugin* plugin, PluginCallback callback)
+{
+	switch (callback)
+	{
+	case PluginCallback::WriteChatColor: return plugin->WriteChatColor != nullptr;
+	case PluginCallback::IncomingChat: return plugin->IncomingChat != nullptr;
+	case PluginCallback::Pulse: return plugin->Pulse != nullptr;
+	case PluginCallback::AsyncPulse: return plugin->AsyncPulse != nullptr;
+	case PluginCallback::Zoned: return plugin->Zoned != nullptr;
+	case PluginCallback::CleanUI: return plugin->CleanUI != nullptr;
+	case PluginCallback::ReloadUI: return plugin->ReloadUI != nullptr;
+	case PluginCallback::DrawHUD: return plugin->DrawHUD != nullptr;
+	case PluginCallback::SetGameState: return plugin->SetGameState != nullptr;
+	// Plugins that export the batched callbacks only receive those.
+	case PluginCallback::AddSpawn: return plugin->AddSpawn != nullptr && plugin->AddSpawns == nullptr;
+	case PluginCallback::RemoveSpawn: return plugin->RemoveSpawn != nullptr && plugin->RemoveSpawns == nullptr;
+	case PluginCallback::AddSpawns: return plugin->AddSpawns != nullptr;
+	case PluginCallback::RemoveSpawns: return plugin->RemoveSpawns != nullptr;
+	case PluginCallback::AddGroundItem: return plugin->AddGroundItem != nullptr;
+	case PluginCallback::RemoveGroundItem: return plugin->RemoveGroundItem != nullptr;
+	case PluginCallback::BeginZone: return plugin->BeginZone != nullptr;
+	case PluginCallback::EndZone: return plugin->EndZone != nullptr;
+	case PluginCallback::UpdateImGui: return plugin->UpdateImGui != nullptr;
+	case PluginCallback::MacroStart: return plugin->MacroStart != nullptr;
+	case PluginCallback::MacroStop: return plugin->MacroStop != nullptr;
+	case PluginCallback::LoadPlugin: return plugin->LoadPlugin != nullptr;
+	case PluginCallback::UnloadPlugin: return plugin->UnloadPlugin != nullptr;
+	default: return false;
+	}
+}
+
+static bool HasModuleCallback(const MQModule* module, PluginCallback callback)
+{
+	switch (callback)
+	{
+	case PluginCallback::WriteChatColor: return module->WriteChatColor != nullptr;
+	case PluginCallback::Pulse: return module->Pulse != nullptr;
+	case PluginCallback::Zoned: return module->Zoned != nullptr;
+	case PluginCallback::SetGameState: return module->SetGameState != nullptr;
+	case PluginCallback::AddSpawn: return module->SpawnAdded != nullptr;
+	case PluginCallback::RemoveSpawn: return module->SpawnRemoved != nullptr;
+	case PluginCallback::BeginZone: return module->BeginZone != nullptr;
+	case PluginCallback::EndZone: return module->EndZone != nullptr;
+	case PluginCallback::UpdateImGui: return module->UpdateImGui != nullptr;
+	case PluginCallback::LoadPlugin: return module->LoadPlugin != nullptr;
+	case PluginCallback::UnloadPlugin: return module->UnloadPlugin != nullptr;
+	default: return false;
+	}
+}
+
+static void RebuildPluginSubscribers()
+{
+	std::scoped_lock lock(s_pluginsMutex);
+
+	for (size_t i = 0; i < lengthof(s_pluginSubscribers); ++i)
+	{
+		std::vector<MQPlugin*>& subscribers = s_pluginSubscribers[i];
+		subscribers.clear();
+
+		for (MQPlugin* pPlugin = pPlugins; pPlugin; pPlugin = pPlugin->pNext)
+		{
+			if (HasPluginCallback(pPlugin, static_cast<PluginCallback>(i)))
+				subscribers.push_back(pPlugin);
+		}
+	}
+}
+
+static void RebuildModuleSubscribers()
+{
+	for (size_t i = 0; i < lengthof(s_moduleSubscribers); ++i)
+	{
+		std::vector<MQModule*>& subscribers = s_moduleSubscribers[i];
+		subscribers.clear();
+
+		for (MQModule* module : gInternalModules)
+		{
+			if (HasModuleCallback(module, static_cast<PluginCallback>(i)))
+				subscribers.push_back(module);
+		}
+	}
+}
+
+// Calls the callback for every module that implements moduleCallback. Subscribers are visited by
+// index because a callback may add or remove modules while we are iterating.
 template <typename Callback>
-void ForEachModule(Callback& callback)
+void ForEachModule(PluginCallback moduleCallback, Callback&& callback)
+{
+	const std::vector<MQModule*>& subscribers = s_moduleSubscribers[static_cast<size_t>(moduleCallback)];
+
+	for (size_t i = 0; i < subscribers.size(); ++i)
+	{
+		callback(subscribers[i]);
+	}
+}
+
+static void RecordPluginCallback(MQPlugin* plugin, PluginCallback callback, std::chrono::nanoseconds time)
 {
-	for (const MQModule* module : gInternalModules)
+	MQPluginCallbackTiming& timing = plugin->CallbackTimings[static_cast<size_t>(callback)];
+
+	++timing.Count;
+	timing.LastTime = time;
+	timing.TotalTime += time;
+	timing.MaxTime = std::max(timing.MaxTime, time);
+
+	if (gSlowPluginCallbackTime > 0 && time >= std::chrono::milliseconds(gSlowPluginCallbackTime))
 	{
-		callback(module);
+		++timing.SlowCount;
+
+		// Writing to chat from here would dispatch to the plugins again, so the warnings are
+		// written out from PulsePlugins instead.
+		const uint64_t now = MQGetTickCount64();
+		if (timing.LastWarning == 0 || now - timing.LastWarning >= SLOW_CALLBACK_WARNING_INTERVAL)
+		{
+			timing.LastWarning = now;
+			s_slowCallbackWarnings.push_back(fmt::format("\ay{}\ax {} took \ar{:.1f}\axms",
+				plugin->name, GetPluginCallbackName(callback), std::chrono::duration<float, std::milli>(time).count()));
+		}
 	}
 }
 
+// Calls the callback for every plugin that implements pluginCallback, timing each call. Like
+// ForEachModule, this visits by index since a callback may load or unload plugins.
 template <typename Callback>
-void ForEachPlugin(Callback&& callback)
+void ForEachPlugin(PluginCallback pluginCallback, Callback&& callback)
 {
 	std::scoped_lock lock(s_pluginsMutex);
 
-	MQPlugin* pPlugin = pPlugins;
-	while (pPlugin)
+	const std::vector<MQPlugin*>& subscribers = s_pluginSubscribers[static_cast<size_t>(pluginCallback)];
+
+	for (size_t i = 0; i < subscribers.size(); ++i)
 	{
+		MQPlugin* pPlugin = subscribers[i];
+
+		const auto start = std::chrono::steady_clock::now();
 		callback(pPlugin);
+		RecordPluginCallback(pPlugin, pluginCallback, std::chrono::steady_clock::now() - start);
+	}
+}
 
-		pPlugin = pPlugin->pNext;
+static void WriteSlowCallbackWarnings()
+{
+	std::vector<std::string> warnings;
+	{
+		std::scoped_lock lock(s_pluginsMutex);
+		warnings.swap(s_slowCallbackWarnings);
 	}
+
+	for (const std::string& warning : warnings)
+		WriteChatf("Slow plugin callback: %s", warning.c_str());
 }
 
 void PluginsWriteChatColor(const char* Line, int Color, int Filter)
@@ -658,24 +1043,55 @@ void PluginsWriteChatColor(const char* Line, int Color, int Filter)
 
 	if (size_t len = strlen(Line))
 	{
-		std::unique_ptr<char[]> plainText = std::make_unique<char[]>(len + 1);
+		// Stripping never makes the line longer, so most lines fit on the stack.
+		char plainBuffer[MAX_STRING];
+		std::unique_ptr<char[]> plainAlloc;
+		char* plainText = plainBuffer;
 
-		StripMQChat(Line, plainText.get());
-		CheckChatForEvent(plainText.get());
+		if (len >= MAX_STRING)
+		{
+			plainAlloc = std::make_unique<char[]>(len + 1);
+			plainText = plainAlloc.get();
+		}
+
+		StripMQChat(Line, plainText);
+		CheckChatForEvent(plainText);
 
 		DebugSpew("WriteChatColor(%s)", Line);
 	}
 
-	ForEachModule([&](const MQModule* module)
+	ForEachModule(PluginCallback::WriteChatColor, [&](const MQModule* module)
+		{
+			module->WriteChatColor(Line, Color, Filter);
+		});
+
+	ForEachPlugin(PluginCallback::WriteChatColor, [&](const MQPlugin* plugin)
+		{
+			plugin->WriteChatColor(Line, Color, Filter);
+		});
+}
+
+// Like PluginsWriteChatColor for a block of lines, except that events aren't checked. Each module
+// and plugin gets all of the lines in one turn.
+void PluginsWriteChatColorLines(const std::vector<std::string>& Lines, int Color, int Filter)
+{
+	if (!s_pluginsInitialized)
+		return;
+	if (gFilterMQ)
+		return;
+
+	MQScopedBenchmark bm(bmWriteChatColor);
+
+	ForEachModule(PluginCallback::WriteChatColor, [&](const MQModule* module)
 		{
-			if (module->WriteChatColor)
-				module->WriteChatColor(Line, Color, Filter);
+			for (const std::string& line : Lines)
+				module->WriteChatColor(line.c_str(), Color, Filter);
 		});
 
-	ForEachPlugin([&](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::WriteChatColor, [&](const MQPlugin* plugin)
 		{
-			if (plugin->WriteChatColor)
-				plugin->WriteChatColor(Line, Color, Filter);
+			for (const std::string& line : Lines)
+				plugin->WriteChatColor(line.c_str(), Color, Filter);
 		});
 }
 
@@ -690,15 +1106,50 @@ bool PluginsIncomingChat(const char* Line, DWORD Color)
 
 	bool Ret = false;
 
-	ForEachPlugin([&](const MQPlugin* plugin) mutable
+	ForEachPlugin(PluginCallback::IncomingChat, [&](const MQPlugin* plugin) mutable
 		{
-			if (plugin->IncomingChat)
-				Ret = Ret || plugin->IncomingChat(Line, Color);
+			Ret = Ret || plugin->IncomingChat(Line, Color);
 		});
 
 	return Ret;
 }
 
+// Starts OnAsyncPulse for every plugin that exports it. These plugins have declared that the
+// callback is thread safe, so they run on worker threads while the main thread pulses.
+static void StartAsyncPluginPulse()
+{
+	JoinAsyncPluginPulse();
+
+	std::scoped_lock lock(s_pluginsMutex);
+
+	for (MQPlugin* plugin : s_pluginSubscribers[static_cast<size_t>(PluginCallback::AsyncPulse)])
+	{
+		fMQPulse asyncPulse = plugin->AsyncPulse;
+
+		s_asyncPulseTasks.push_back({ plugin, std::async(std::launch::async, [asyncPulse]()
+			{
+				const auto start = std::chrono::steady_clock::now();
+				asyncPulse();
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			}) });
+	}
+}
+
+void JoinAsyncPluginPulse()
+{
+	if (s_asyncPulseTasks.empty())
+		return;
+
+	std::vector<AsyncPulseTask> tasks;
+	tasks.swap(s_asyncPulseTasks);
+
+	// Timings are recorded here rather than on the workers so they never need the plugin lock.
+	for (AsyncPulseTask& task : tasks)
+	{
+		RecordPluginCallback(task.plugin, PluginCallback::AsyncPulse, task.result.get());
+	}
+}
+
 void PulsePlugins()
 {
 	if (!s_pluginsInitialized)
@@ -706,17 +1157,24 @@ void PulsePlugins()
 
 	PluginDebug("PulsePlugins()");
 
-	ForEachModule([](const MQModule* module)
+	InitializeDeferredModules();
+	ProcessPendingPluginReloads();
+	FlushPendingAddedSpawns();
+	StartAsyncPluginPulse();
+
+	ForEachModule(PluginCallback::Pulse, [](const MQModule* module)
 		{
-			if (module->Pulse)
-				module->Pulse();
+			MQScopedBenchmark bm(GetPulseBenchmark(module));
+			module->Pulse();
 		});
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::Pulse, [](const MQPlugin* plugin)
 		{
-			if (plugin->Pulse)
-				plugin->Pulse();
+			MQScopedBenchmark bm(GetPulseBenchmark(plugin));
+			plugin->Pulse();
 		});
+
+	WriteSlowCallbackWarnings();
 }
 
 void PluginsZoned()
@@ -726,19 +1184,15 @@ void PluginsZoned()
 
 	PluginDebug("PluginsZoned()");
 
-	ForEachModule([](const MQModule* module)
+	ForEachModule(PluginCallback::Zoned, [](const MQModule* module)
 		{
-			if (module->Zoned)
-				module->Zoned();
+			module->Zoned();
 		});
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::Zoned, [](const MQPlugin* plugin)
 		{
-			if (plugin->Zoned)
-			{
-				DebugSpew("%s->Zoned()", plugin->szFilename);
-				plugin->Zoned();
-			}
+			DebugSpew("%s->Zoned()", plugin->szFilename);
+			plugin->Zoned();
 		});
 
 
@@ -758,13 +1212,10 @@ void PluginsCleanUI()
 	DeleteMQ2NewsWindow();
 	RemoveFindItemMenu();
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::CleanUI, [](const MQPlugin* plugin)
 		{
-			if (plugin->CleanUI)
-			{
-				DebugSpew("%s->CleanUI()", plugin->szFilename);
-				plugin->CleanUI();
-			}
+			DebugSpew("%s->CleanUI()", plugin->szFilename);
+			plugin->CleanUI();
 		});
 }
 
@@ -775,13 +1226,10 @@ void PluginsReloadUI()
 
 	PluginDebug("PluginsReloadUI()");
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::ReloadUI, [](const MQPlugin* plugin)
 		{
-			if (plugin->ReloadUI)
-			{
-				DebugSpew("%s->ReloadUI()", plugin->szFilename);
-				plugin->ReloadUI();
-			}
+			DebugSpew("%s->ReloadUI()", plugin->szFilename);
+			plugin->ReloadUI();
 		});
 }
 
@@ -857,19 +1305,15 @@ void PluginsSetGameState(DWORD GameState)
 		LoadCfgFile("CharSelect", false);
 	}
 
-	ForEachModule([GameState](const MQModule* module)
+	ForEachModule(PluginCallback::SetGameState, [GameState](const MQModule* module)
 		{
-			if (module->SetGameState)
-				module->SetGameState(GameState);
+			module->SetGameState(GameState);
 		});
 
-	ForEachPlugin([GameState](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::SetGameState, [GameState](const MQPlugin* plugin)
 		{
-			if (plugin->SetGameState)
-			{
-				DebugSpew("%s->SetGameState(%d)", plugin->szFilename, GameState);
-				plugin->SetGameState(GameState);
-			}
+			DebugSpew("%s->SetGameState(%d)", plugin->szFilename, GameState);
+			plugin->SetGameState(GameState);
 		});
 }
 
@@ -880,10 +1324,9 @@ void PluginsDrawHUD()
 
 	PluginDebug("PluginsDrawHUD()");
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::DrawHUD, [](const MQPlugin* plugin)
 		{
-			if (plugin->DrawHUD)
-				plugin->DrawHUD();
+			plugin->DrawHUD();
 		});
 }
 
@@ -901,43 +1344,94 @@ void PluginsAddSpawn(SPAWNINFO* pNewSpawn)
 	if (GetBodyTypeDesc(BodyType)[0] == '*')
 		WriteChatf("Spawn '%s' has unknown bodytype %d", pNewSpawn->Name, BodyType);
 
-	ForEachModule([pNewSpawn](const MQModule* module)
+	ForEachModule(PluginCallback::AddSpawn, [pNewSpawn](const MQModule* module)
 		{
-			if (module->SpawnAdded)
-				module->SpawnAdded(pNewSpawn);
+			module->SpawnAdded(pNewSpawn);
 		});
 
-	ForEachPlugin([pNewSpawn](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::AddSpawn, [pNewSpawn](const MQPlugin* plugin)
 		{
-			if (plugin->AddSpawn)
-				plugin->AddSpawn(pNewSpawn);
+			plugin->AddSpawn(pNewSpawn);
 		});
+
+	// Plugins with OnAddSpawns get everything that spawned during the frame at once on the next pulse.
+	std::scoped_lock lock(s_pluginsMutex);
+	if (!s_pluginSubscribers[static_cast<size_t>(PluginCallback::AddSpawns)].empty())
+		s_pendingAddedSpawns.push_back(pNewSpawn);
 }
 
-void PluginsRemoveSpawn(SPAWNINFO* pSpawn)
+static void FlushPendingAddedSpawns()
 {
-	InvalidateObservedEQObject(pSpawn);
+	std::vector<SPAWNINFO*> spawns;
+	{
+		std::scoped_lock lock(s_pluginsMutex);
+		spawns.swap(s_pendingAddedSpawns);
+	}
+
+	if (spawns.empty())
+		return;
+
+	PluginDebug("FlushPendingAddedSpawns(%d)", static_cast<int>(spawns.size()));
+
+	ForEachPlugin(PluginCallback::AddSpawns, [&spawns](const MQPlugin* plugin)
+		{
+			plugin->AddSpawns(spawns.data(), spawns.size());
+		});
+}
+
+void PluginsRemoveSpawns(SPAWNINFO* const* spawns, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		InvalidateObservedEQObject(spawns[i]);
 
 	if (!s_pluginsInitialized)
 		return;
 
-	PluginDebug("PluginsRemoveSpawn(%s)", pSpawn->Name);
+	// Batched plugins never heard about spawns that are still queued, so those are dropped from
+	// the queue instead of being reported as removed.
+	std::vector<SPAWNINFO*> removed;
+	removed.reserve(count);
 
-	ClearCachedBuffsSpawn(pSpawn);
+	for (size_t i = 0; i < count; ++i)
+	{
+		SPAWNINFO* pSpawn = spawns[i];
 
-	ForEachModule([pSpawn](const MQModule* module)
-		{
-			if (module->SpawnRemoved)
+		PluginDebug("PluginsRemoveSpawn(%s)", pSpawn->Name);
+
+		ClearCachedBuffsSpawn(pSpawn);
+
+		ForEachModule(PluginCallback::RemoveSpawn, [pSpawn](const MQModule* module)
+			{
 				module->SpawnRemoved(pSpawn);
-		});
+			});
 
-	ForEachPlugin([pSpawn](const MQPlugin* plugin)
-		{
-			if (plugin->RemoveSpawn)
+		ForEachPlugin(PluginCallback::RemoveSpawn, [pSpawn](const MQPlugin* plugin)
+			{
 				plugin->RemoveSpawn(pSpawn);
+			});
+
+		std::scoped_lock lock(s_pluginsMutex);
+		auto iter = std::find(s_pendingAddedSpawns.begin(), s_pendingAddedSpawns.end(), pSpawn);
+		if (iter != s_pendingAddedSpawns.end())
+			s_pendingAddedSpawns.erase(iter);
+		else
+			removed.push_back(pSpawn);
+	}
+
+	if (removed.empty())
+		return;
+
+	ForEachPlugin(PluginCallback::RemoveSpawns, [&removed](const MQPlugin* plugin)
+		{
+			plugin->RemoveSpawns(removed.data(), removed.size());
 		});
 }
 
+void PluginsRemoveSpawn(SPAWNINFO* pSpawn)
+{
+	PluginsRemoveSpawns(&pSpawn, 1);
+}
+
 void PluginsAddGroundItem(GROUNDITEM* pNewGroundItem)
 {
 	if (!s_pluginsInitialized)
@@ -947,10 +1441,9 @@ void PluginsAddGroundItem(GROUNDITEM* pNewGroundItem)
 
 	DebugSpew("PluginsAddGroundItem(%s) %.1f,%.1f,%.1f", pNewGroundItem->Name, pNewGroundItem->X, pNewGroundItem->Y, pNewGroundItem->Z);
 
-	ForEachPlugin([pNewGroundItem](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::AddGroundItem, [pNewGroundItem](const MQPlugin* plugin)
 		{
-			if (plugin->AddGroundItem)
-				plugin->AddGroundItem(pNewGroundItem);
+			plugin->AddGroundItem(pNewGroundItem);
 		});
 }
 
@@ -961,10 +1454,9 @@ void PluginsRemoveGroundItem(GROUNDITEM* pGroundItem)
 
 	PluginDebug("PluginsRemoveGroundItem()");
 
-	ForEachPlugin([pGroundItem](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::RemoveGroundItem, [pGroundItem](const MQPlugin* plugin)
 		{
-			if (plugin->RemoveGroundItem)
-				plugin->RemoveGroundItem(pGroundItem);
+			plugin->RemoveGroundItem(pGroundItem);
 		});
 }
 
@@ -978,19 +1470,15 @@ void PluginsBeginZone()
 	gbInZone = false;
 	gZoning = true;
 
-	ForEachModule([](const MQModule* module)
+	ForEachModule(PluginCallback::BeginZone, [](const MQModule* module)
 		{
-			if (module->BeginZone)
-				module->BeginZone();
+			module->BeginZone();
 		});
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::BeginZone, [](const MQPlugin* plugin)
 		{
-			if (plugin->BeginZone)
-			{
-				DebugSpew("%s->BeginZone()", plugin->szFilename);
-				plugin->BeginZone();
-			}
+			DebugSpew("%s->BeginZone()", plugin->szFilename);
+			plugin->BeginZone();
 		});
 }
 
@@ -1005,19 +1493,15 @@ void PluginsEndZone()
 	WereWeZoning = true;
 	LastEnteredZone = MQGetTickCount64();
 
-	ForEachModule([](const MQModule* module)
+	ForEachModule(PluginCallback::EndZone, [](const MQModule* module)
 		{
-			if (module->EndZone)
-				module->EndZone();
+			module->EndZone();
 		});
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::EndZone, [](const MQPlugin* plugin)
 		{
-			if (plugin->EndZone)
-			{
-				DebugSpew("%s->EndZone()", plugin->szFilename);
-				plugin->EndZone();
-			}
+			DebugSpew("%s->EndZone()", plugin->szFilename);
+			plugin->EndZone();
 		});
 
 	if (GetGameState() == GAMESTATE_INGAME)
@@ -1029,10 +1513,9 @@ void PluginsEndZone()
 
 void ModulesUpdateImGui()
 {
-	ForEachModule([](const MQModule* module)
+	ForEachModule(PluginCallback::UpdateImGui, [](const MQModule* module)
 		{
-			if (module->UpdateImGui)
-				module->UpdateImGui();
+			module->UpdateImGui();
 		});
 }
 
@@ -1041,10 +1524,9 @@ void PluginsUpdateImGui()
 	if (!s_pluginsInitialized)
 		return;
 
-	ForEachPlugin([](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::UpdateImGui, [](const MQPlugin* plugin)
 		{
-			if (plugin->UpdateImGui)
-				plugin->UpdateImGui();
+			plugin->UpdateImGui();
 		});
 }
 
@@ -1055,13 +1537,10 @@ void PluginsMacroStart(const char* Name)
 
 	PluginDebug("PluginsMacroStart(%s)", Name);
 
-	ForEachPlugin([Name](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::MacroStart, [Name](const MQPlugin* plugin)
 		{
-			if (plugin->MacroStart)
-			{
-				DebugSpew("%s->MacroStart(%s)", plugin->szFilename, Name);
-				plugin->MacroStart(Name);
-			}
+			DebugSpew("%s->MacroStart(%s)", plugin->szFilename, Name);
+			plugin->MacroStart(Name);
 		});
 }
 
@@ -1072,13 +1551,10 @@ void PluginsMacroStop(const char* Name)
 
 	PluginDebug("PluginsMacroStop(%s)", Name);
 
-	ForEachPlugin([Name](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::MacroStop, [Name](const MQPlugin* plugin)
 		{
-			if (plugin->MacroStop)
-			{
-				DebugSpew("%s->MacroStop(%s)", plugin->szFilename, Name);
-				plugin->MacroStop(Name);
-			}
+			DebugSpew("%s->MacroStop(%s)", plugin->szFilename, Name);
+			plugin->MacroStop(Name);
 		});
 }
 
@@ -1089,21 +1565,15 @@ static void PluginsLoadPlugin(const char* Name)
 
 	PluginDebug("PluginsLoadPlugin(%s)", Name);
 
-	ForEachPlugin([Name](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::LoadPlugin, [Name](const MQPlugin* plugin)
 		{
-			if (plugin->LoadPlugin)
-			{
-				DebugSpew("%s->LoadPlugin(%s)", plugin->szFilename, Name);
-				plugin->LoadPlugin(Name);
-			}
+			DebugSpew("%s->LoadPlugin(%s)", plugin->szFilename, Name);
+			plugin->LoadPlugin(Name);
 		});
 
-	ForEachModule([Name](const MQModule* mod)
+	ForEachModule(PluginCallback::LoadPlugin, [Name](const MQModule* mod)
 		{
-			if (mod->LoadPlugin)
-			{
-				mod->LoadPlugin(Name);
-			}
+			mod->LoadPlugin(Name);
 		});
 }
 
@@ -1111,21 +1581,15 @@ static void PluginsUnloadPlugin(const char* Name)
 {
 	PluginDebug("PluginsUnloadPlugin(%s)", Name);
 
-	ForEachPlugin([Name](const MQPlugin* plugin)
+	ForEachPlugin(PluginCallback::UnloadPlugin, [Name](const MQPlugin* plugin)
 		{
-			if (plugin->UnloadPlugin)
-			{
-				DebugSpew("%s->UnloadPlugin(%s)", plugin->szFilename, Name);
-				plugin->UnloadPlugin(Name);
-			}
+			DebugSpew("%s->UnloadPlugin(%s)", plugin->szFilename, Name);
+			plugin->UnloadPlugin(Name);
 		});
 
-	ForEachModule([Name](const MQModule* mod)
+	ForEachModule(PluginCallback::UnloadPlugin, [Name](const MQModule* mod)
 		{
-			if (mod->UnloadPlugin)
-			{
-				mod->UnloadPlugin(Name);
-			}
+			mod->UnloadPlugin(Name);
 		});
 }
 
@@ -1226,6 +1690,30 @@ void PluginCommand(SPAWNINFO* pChar, char* szLine)
 			bool dounload = false;
 			bool noauto = false;
 
+			// /plugin MQStuff reload [all]
+			if (ci_equals(szCommand, "reload"))
+			{
+				const char* szScope = GetNextArg(szLine, 2);
+				if (szScope[0] == '\0' || ci_equals(szScope, "all"))
+				{
+					if (szScope[0] != '\0')
+					{
+						// every other client reloads when the broadcast arrives
+						proto::routing::Address address;
+						address.set_mailbox("plugin_reload");
+						s_pluginReloadDropbox.Post(address, std::string(szName));
+					}
+
+					ReloadPluginWithMessage(szName);
+				}
+				else
+				{
+					SyntaxError("Usage: /plugin <pluginName> reload [all]");
+				}
+
+				return;
+			}
+
 			// helps us check if this plugin is already loaded
 			MQPlugin* plugin = GetPlugin(szName);
 
@@ -1275,9 +1763,9 @@ void PluginCommand(SPAWNINFO* pChar, char* szLine)
 					{
 						// Regardless of whether unload succeeds, turn it off in the ini if it exists.  This prevents a scenario where
 						// a plugin failing to unload keeps it enabled in the ini despite the user trying to turn it off.
-						if (!noauto && PrivateProfileKeyExists("Plugins", origPluginName, mq::internal_paths::MQini))
+						if (!noauto && CachedIniKeyExists("Plugins", origPluginName, mq::internal_paths::MQini))
 						{
-							WritePrivateProfileBool("Plugins", origPluginName, false, mq::internal_paths::MQini);
+							WriteCachedPrivateProfileString("Plugins", origPluginName.c_str(), "0", mq::internal_paths::MQini);
 						}
 
 						if (UnloadMQ2Plugin(szName))
@@ -1309,7 +1797,7 @@ void PluginCommand(SPAWNINFO* pChar, char* szLine)
 
 							if (!noauto)
 							{
-								WritePrivateProfileBool("Plugins", plugin->szFilename, true, mq::internal_paths::MQini);
+								WriteCachedPrivateProfileString("Plugins", plugin->szFilename, "1", mq::internal_paths::MQini);
 							}
 						}
 						else if (s_pluginLoadFailure.empty())
@@ -1331,7 +1819,7 @@ void PluginCommand(SPAWNINFO* pChar, char* szLine)
 
 	if (show_usage)
 	{
-		SyntaxError("Usage: /plugin <pluginName> [load/unload/toggle] [noauto], or /plugin list [active|failed|dlls]");
+		SyntaxError("Usage: /plugin <pluginName> [load/unload/toggle] [noauto], /plugin <pluginName> reload [all], or /plugin list [active|failed|dlls]");
 	}
 }
 
@@ -1341,15 +1829,161 @@ void SaveMQ2PluginLoadStatus(const char* Name, bool bLoad)
 {
 	std::scoped_lock lock(s_pluginsMutex);
 
-	WritePrivateProfileBool("Plugins", Name, bLoad, mq::internal_paths::MQini);
+	WriteCachedPrivateProfileString("Plugins", Name, bLoad ? "1" : "0", mq::internal_paths::MQini);
 }
 
 //----------------------------------------------------------------------------
 
+// A configured plugin that was resolved and mapped ahead of InitializeMQ2Plugins.
+struct PreparedPlugin
+{
+	std::string name;
+	std::string fileName;                      // empty if the plugin could not be found
+	std::vector<std::string> imports;          // dlls imported by the plugin, lowercase with extension
+	wil::unique_hmodule imageMapping;          // keeps the image section alive until the real load
+};
+
+// Filled in by the workers started in PrefetchMQ2Plugins. Each worker writes only the entries it
+// claims, and the main thread only reads them after s_pluginPrefetches has been joined.
+static std::vector<PreparedPlugin> s_preparedPlugins;
+static std::vector<std::future<void>> s_pluginPrefetches;
+
+static constexpr size_t MAX_PLUGIN_PREFETCH_THREADS = 4;
+
+static std::vector<std::string> GetImageImports(HMODULE hImage)
+{
+	std::vector<std::string> imports;
+
+	// Modules loaded as image resources have their low bits tagged.
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(reinterpret_cast<uintptr_t>(hImage) & ~uintptr_t{ 3 });
+	if (!base)
+		return imports;
+
+	auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+	if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+		return imports;
+
+	auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+	if (ntHeaders->Signature != IMAGE_NT_SIGNATURE)
+		return imports;
+
+	const IMAGE_DATA_DIRECTORY& importDir = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+	if (importDir.VirtualAddress == 0)
+		return imports;
+
+	auto descriptor = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(base + importDir.VirtualAddress);
+	for (; descriptor->Name != 0; ++descriptor)
+	{
+		imports.push_back(to_lower_copy(reinterpret_cast<const char*>(base + descriptor->Name)));
+	}
+
+	return imports;
+}
+
+// Resolve, read and map the enabled plugin dlls on worker threads while the rest of startup runs.
+// Each plugin is mapped as an image resource, which creates the image section and faults in its
+// headers without running any plugin code. The real LoadLibrary in LoadMQ2Plugin then reuses that
+// section. LoadLibrary itself stays serial on the main thread: DllMain and static constructors of
+// plugins call back into MacroQuest, and InitializePlugin must run on the main thread.
+void PrefetchMQ2Plugins()
+{
+	s_preparedPlugins.clear();
+
+	for (const std::string& pluginName : GetPrivateProfileKeys<MAX_STRING * 2>("Plugins", mq::internal_paths::MQini))
+	{
+		if (GetPrivateProfileBool("Plugins", pluginName, false, mq::internal_paths::MQini))
+			s_preparedPlugins.push_back(PreparedPlugin{ pluginName });
+	}
+
+	if (s_preparedPlugins.empty())
+		return;
+
+	auto nextPlugin = std::make_shared<std::atomic<size_t>>(0);
+
+	size_t threadCount = std::min(MAX_PLUGIN_PREFETCH_THREADS, s_preparedPlugins.size());
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		s_pluginPrefetches.push_back(std::async(std::launch::async, [nextPlugin]()
+			{
+				std::vector<char> buffer(64 * 1024);
+
+				for (size_t index = (*nextPlugin)++; index < s_preparedPlugins.size(); index = (*nextPlugin)++)
+				{
+					PreparedPlugin& prepared = s_preparedPlugins[index];
+
+					prepared.fileName = FindPluginFile(prepared.name);
+					if (prepared.fileName.empty())
+						continue;
+
+					std::filesystem::path path = std::filesystem::path(mq::internal_paths::Plugins) / (prepared.fileName + ".dll");
+
+					std::ifstream file(path, std::ios::binary);
+					while (file.read(buffer.data(), buffer.size()))
+					{
+					}
+
+					prepared.imageMapping.reset(::LoadLibraryExW(path.c_str(), nullptr, LOAD_LIBRARY_AS_IMAGE_RESOURCE));
+					if (prepared.imageMapping)
+						prepared.imports = GetImageImports(prepared.imageMapping.get());
+				}
+			}));
+	}
+}
+
+// Order the prepared plugins so that a plugin that imports another configured plugin is initialized
+// after it. Otherwise the configured order is kept.
+static std::vector<const PreparedPlugin*> GetPluginLoadOrder()
+{
+	std::unordered_map<std::string, size_t> indexByDll;
+	for (size_t i = 0; i < s_preparedPlugins.size(); ++i)
+	{
+		if (!s_preparedPlugins[i].fileName.empty())
+			indexByDll.emplace(to_lower_copy(s_preparedPlugins[i].fileName + ".dll"), i);
+	}
+
+	std::vector<const PreparedPlugin*> order;
+	std::vector<uint8_t> state(s_preparedPlugins.size(), 0); // 0 - unvisited, 1 - visiting, 2 - done
+
+	std::function<void(size_t)> visit = [&](size_t index)
+	{
+		if (state[index] != 0)
+			return; // done, or an import cycle that we leave in configured order
+
+		state[index] = 1;
+		for (const std::string& import : s_preparedPlugins[index].imports)
+		{
+			auto iter = indexByDll.find(import);
+			if (iter != indexByDll.end())
+				visit(iter->second);
+		}
+
+		state[index] = 2;
+		order.push_back(&s_preparedPlugins[index]);
+	};
+
+	for (size_t i = 0; i < s_preparedPlugins.size(); ++i)
+		visit(i);
+
+	return order;
+}
+
 void InitializeMQ2Plugins()
 {
 	AddCommand("/plugin", PluginCommand, false, true, false);
 
+	s_pluginReloadDropbox = GetPostOffice().RegisterAddress("plugin_reload",
+		[](ProtoMessagePtr&& message)
+		{
+			// the client that sent the broadcast has already reloaded
+			const auto& sender = message->GetSender();
+			if (sender && sender->has_pid() && sender->pid() == GetCurrentProcessId())
+				return;
+
+			std::string name(message->get<char>(), message->size());
+			if (!name.empty())
+				s_pendingPluginReloads.push_back(std::move(name));
+		});
+
 	bmWriteChatColor = AddMQ2Benchmark("WriteChatColor");
 	bmPluginsIncomingChat = AddMQ2Benchmark("PluginsIncomingChat");
 	bmPluginsPulse = AddMQ2Benchmark("PluginsPulse");
@@ -1368,14 +2002,36 @@ void InitializeMQ2Plugins()
 
 	DebugSpew("Initializing plugins");
 
-	const std::vector<std::string> plugins = GetPrivateProfileKeys<MAX_STRING * 2>("Plugins", mq::internal_paths::MQini);
-	for (const std::string& pluginName : plugins)
+	if (s_preparedPlugins.empty())
 	{
-		if (GetPrivateProfileBool("Plugins", pluginName, false, mq::internal_paths::MQini))
+		const std::vector<std::string> plugins = GetPrivateProfileKeys<MAX_STRING * 2>("Plugins", mq::internal_paths::MQini);
+		for (const std::string& pluginName : plugins)
 		{
-			LoadMQ2Plugin(pluginName.c_str());
+			if (GetPrivateProfileBool("Plugins", pluginName, false, mq::internal_paths::MQini))
+			{
+				LoadMQ2Plugin(pluginName.c_str());
+			}
 		}
 	}
+	else
+	{
+		// wait for the workers to finish resolving and mapping
+		s_pluginPrefetches.clear();
+
+		for (const PreparedPlugin& prepared : s_preparedPlugins)
+		{
+			if (!prepared.fileName.empty())
+				s_preparedPluginFiles.emplace(to_lower_copy(prepared.name), prepared.fileName);
+		}
+
+		for (const PreparedPlugin* prepared : GetPluginLoadOrder())
+		{
+			LoadMQ2Plugin(prepared->name.c_str());
+		}
+
+		s_preparedPluginFiles.clear();
+		s_preparedPlugins.clear();
+	}
 }
 
 void ShutdownMQ2Plugins()
@@ -1384,6 +2040,9 @@ void ShutdownMQ2Plugins()
 
 	UnloadMQ2Plugins();
 	RemoveCommand("/plugin");
+
+	s_pluginReloadDropbox.Remove();
+	s_pendingPluginReloads.clear();
 }
 
 
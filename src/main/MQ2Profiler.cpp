@@ -0,0 +1,352 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+#include "CrashHandler.h"
+
+#include <wil/resource.h>
+
+#include <dbghelp.h>
+#include <fstream>
+#include <thread>
+
+#pragma comment(lib, "winmm.lib")
+
+namespace mq {
+
+static void Profiler_Initialize();
+static void Profiler_Shutdown();
+
+static MQModule s_profilerModule = {
+	"Profiler",                    // Name
+	true,                          // CanUnload
+	Profiler_Initialize,
+	Profiler_Shutdown,
+};
+DECLARE_DEFERRED_MODULE_INITIALIZER(s_profilerModule);
+
+static constexpr int DEFAULT_SAMPLE_INTERVAL = 1;       // milliseconds
+static constexpr int MAX_SAMPLE_INTERVAL = 100;         // milliseconds
+static constexpr int REPORT_FUNCTION_COUNT = 20;        // functions listed in chat, the file has all of them
+
+//============================================================================
+
+// Samples the main thread from a background thread. Every interval the main thread is suspended
+// just long enough to read its instruction pointer, so the result is a flat profile of where the
+// main thread spends its time, whoever's code that is. Nothing is allocated while the main thread
+// is suspended, because it may be holding the heap lock.
+class MainThreadSampler
+{
+public:
+	~MainThreadSampler()
+	{
+		Stop();
+	}
+
+	bool IsRunning() const { return m_running; }
+
+	bool Start(std::chrono::milliseconds interval)
+	{
+		if (m_running)
+			return false;
+
+		m_mainThread.reset(::OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+			FALSE, GetMainThreadId()));
+		if (!m_mainThread)
+			return false;
+
+		{
+			std::scoped_lock lock(m_mutex);
+			m_samples.clear();
+			m_sampleCount = 0;
+			m_missedCount = 0;
+		}
+
+		m_startTime = std::chrono::steady_clock::now();
+		m_running = true;
+		m_thread = std::thread([this, interval]() { SamplerThread(interval); });
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!m_running)
+			return;
+
+		m_running = false;
+		m_thread.join();
+		m_mainThread.reset();
+		m_stopTime = std::chrono::steady_clock::now();
+	}
+
+	// Copies out the samples taken so far, as a count of samples per instruction address.
+	std::unordered_map<uintptr_t, uint32_t> GetSamples(uint64_t& sampleCount, uint64_t& missedCount) const
+	{
+		std::scoped_lock lock(m_mutex);
+
+		sampleCount = m_sampleCount;
+		missedCount = m_missedCount;
+		return m_samples;
+	}
+
+	// How long the samples returned by GetSamples were collected over.
+	std::chrono::steady_clock::duration GetElapsed() const
+	{
+		return (m_running ? std::chrono::steady_clock::now() : m_stopTime) - m_startTime;
+	}
+
+private:
+	void SamplerThread(std::chrono::milliseconds interval)
+	{
+		::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+		// without this, sleeps are rounded up to the 15.6ms system tick
+		::timeBeginPeriod(1);
+
+		while (m_running)
+		{
+			std::this_thread::sleep_for(interval);
+
+			if (::SuspendThread(m_mainThread.get()) == static_cast<DWORD>(-1))
+			{
+				++m_missedCount;
+				continue;
+			}
+
+			CONTEXT context = {};
+			context.ContextFlags = CONTEXT_CONTROL;
+			const bool captured = ::GetThreadContext(m_mainThread.get(), &context) != FALSE;
+
+			::ResumeThread(m_mainThread.get());
+
+			if (!captured)
+			{
+				++m_missedCount;
+				continue;
+			}
+
+#if defined(_M_AMD64)
+			const uintptr_t address = static_cast<uintptr_t>(context.Rip);
+#else
+			const uintptr_t address = static_cast<uintptr_t>(context.Eip);
+#endif
+
+			std::scoped_lock lock(m_mutex);
+			++m_samples[address];
+			++m_sampleCount;
+		}
+
+		::timeEndPeriod(1);
+	}
+
+	std::thread m_thread;
+	std::atomic<bool> m_running = false;
+	wil::unique_handle m_mainThread;
+	std::chrono::steady_clock::time_point m_startTime;
+	std::chrono::steady_clock::time_point m_stopTime;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<uintptr_t, uint32_t> m_samples;
+	uint64_t m_sampleCount = 0;
+	std::atomic<uint64_t> m_missedCount = 0;
+};
+
+static MainThreadSampler* s_sampler = nullptr;
+
+//============================================================================
+
+struct MQProfileEntry
+{
+	std::string Name;
+	uint64_t Samples = 0;
+};
+
+// Addresses outside of any module are almost always code generated by LuaJIT.
+static const char* s_noModuleName = "(no module, jit code)";
+
+static std::string GetModuleName(uintptr_t address, HMODULE& hModule)
+{
+	hModule = nullptr;
+	if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+		reinterpret_cast<LPCSTR>(address), &hModule))
+	{
+		return s_noModuleName;
+	}
+
+	char szModulePath[MAX_PATH] = { 0 };
+	GetModuleFileName(hModule, szModulePath, MAX_PATH);
+
+	return std::filesystem::path(szModulePath).filename().string();
+}
+
+static std::vector<MQProfileEntry> SortProfileEntries(const std::unordered_map<std::string, uint64_t>& counts)
+{
+	std::vector<MQProfileEntry> entries;
+	entries.reserve(counts.size());
+
+	for (const auto& [name, samples] : counts)
+		entries.push_back(MQProfileEntry{ name, samples });
+
+	std::sort(entries.begin(), entries.end(),
+		[](const MQProfileEntry& a, const MQProfileEntry& b) { return a.Samples > b.Samples; });
+
+	return entries;
+}
+
+// Resolves every sampled address to its function and module, and reports the hottest ones.
+static void WriteProfileReport(bool writeFile)
+{
+	uint64_t sampleCount = 0;
+	uint64_t missedCount = 0;
+	const std::unordered_map<uintptr_t, uint32_t> samples = s_sampler->GetSamples(sampleCount, missedCount);
+	const float seconds = std::chrono::duration<float>(s_sampler->GetElapsed()).count();
+
+	if (sampleCount == 0)
+	{
+		WriteChatf("\ay[Profiler]\ax No samples have been taken yet.");
+		return;
+	}
+
+	std::unordered_map<std::string, uint64_t> functionCounts;
+	std::unordered_map<std::string, uint64_t> moduleCounts;
+
+	InitializeSymbolHandler();
+	HANDLE hProcess = GetCurrentProcess();
+
+	char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
+	PSYMBOL_INFO pSymbol = reinterpret_cast<PSYMBOL_INFO>(buffer);
+
+	for (const auto& [address, count] : samples)
+	{
+		HMODULE hModule = nullptr;
+		std::string moduleName = GetModuleName(address, hModule);
+
+		pSymbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		pSymbol->MaxNameLen = MAX_SYM_NAME;
+
+		std::string functionName;
+		DWORD64 displacement = 0;
+		if (hModule && SymFromAddr(hProcess, address, &displacement, pSymbol))
+			functionName = fmt::format("{}!{}", moduleName, pSymbol->Name);
+		else if (hModule)
+			functionName = fmt::format("{}+0x{:x}", moduleName, address - reinterpret_cast<uintptr_t>(hModule));
+		else
+			functionName = moduleName;
+
+		functionCounts[functionName] += count;
+		moduleCounts[moduleName] += count;
+	}
+
+	ShutdownSymbolHandler();
+
+	const std::vector<MQProfileEntry> functions = SortProfileEntries(functionCounts);
+	const std::vector<MQProfileEntry> modules = SortProfileEntries(moduleCounts);
+
+	auto percent = [sampleCount](uint64_t samples) { return 100.0 * static_cast<double>(samples) / static_cast<double>(sampleCount); };
+
+	WriteChatf("\ay[Profiler]\ax \at%I64u\ax samples over \at%.1f\axs (\at%I64u\ax missed)", sampleCount, seconds, missedCount);
+
+	for (const MQProfileEntry& entry : modules)
+		WriteChatf("  \at%5.1f%%\ax %s", percent(entry.Samples), entry.Name.c_str());
+
+	WriteChatf("\ay[Profiler]\ax Hottest functions:");
+	for (size_t i = 0; i < functions.size() && i < REPORT_FUNCTION_COUNT; ++i)
+		WriteChatf("  \at%5.1f%%\ax %s", percent(functions[i].Samples), functions[i].Name.c_str());
+
+	if (!writeFile)
+		return;
+
+	SYSTEMTIME t;
+	::GetLocalTime(&t);
+
+	std::error_code ec;
+	const std::filesystem::path profilePath = std::filesystem::path(gPathLogs) / "profiles";
+	std::filesystem::create_directories(profilePath, ec);
+
+	const std::string fileName = (profilePath / fmt::format("mqprofile_{:04}{:02}{:02}_{:02}{:02}{:02}.csv",
+		t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond)).string();
+
+	std::ofstream profileFile(fileName);
+	profileFile << "Function,Samples,Percent\n";
+
+	for (const MQProfileEntry& entry : functions)
+		profileFile << fmt::format("\"{}\",{},{:.2f}\n", entry.Name, entry.Samples, percent(entry.Samples));
+
+	if (profileFile)
+		WriteChatf("\ay[Profiler]\ax Saved profile to: %s", fileName.c_str());
+	else
+		WriteChatf("\ar[Profiler]\ax Failed to write the profile to: %s", fileName.c_str());
+}
+
+//============================================================================
+
+static void Cmd_MQProfile(SPAWNINFO* pChar, char* szLine)
+{
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szLine, 1);
+
+	if (ci_equals(szArg, "start"))
+	{
+		if (s_sampler->IsRunning())
+		{
+			WriteChatf("\ay[Profiler]\ax The profiler is already running.");
+			return;
+		}
+
+		GetArg(szArg, szLine, 2);
+		const int interval = std::clamp(GetIntFromString(szArg, DEFAULT_SAMPLE_INTERVAL), 1, MAX_SAMPLE_INTERVAL);
+
+		if (s_sampler->Start(std::chrono::milliseconds(interval)))
+			WriteChatf("\ay[Profiler]\ax Sampling the main thread every \at%d\axms. Use \ay/mqprofile stop\ax to see the results.", interval);
+		else
+			WriteChatf("\ar[Profiler]\ax Could not open the main thread to sample it.");
+	}
+	else if (ci_equals(szArg, "stop"))
+	{
+		if (!s_sampler->IsRunning())
+		{
+			WriteChatf("\ay[Profiler]\ax The profiler is not running.");
+			return;
+		}
+
+		s_sampler->Stop();
+		WriteProfileReport(true);
+	}
+	else if (ci_equals(szArg, "report"))
+	{
+		WriteProfileReport(false);
+	}
+	else
+	{
+		WriteChatf("Usage: /mqprofile start [interval in ms]|stop|report");
+	}
+}
+
+static void Profiler_Initialize()
+{
+	s_sampler = new MainThreadSampler();
+
+	AddCommand("/mqprofile", Cmd_MQProfile, false, false);
+}
+
+static void Profiler_Shutdown()
+{
+	RemoveCommand("/mqprofile");
+
+	delete s_sampler;
+	s_sampler = nullptr;
+}
+
+} // namespace mq
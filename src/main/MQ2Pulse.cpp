@@ -17,6 +17,8 @@
 #include "MQPostOffice.h"
 #include "CrashHandler.h"
 #include "ImGuiManager.h"
+#include "GraphicsResources.h"
+#include "mq/base/MPSCQueue.h"
 
 #include <wil/resource.h>
 
@@ -27,35 +29,29 @@ namespace mq {
 bool TurnNotDone = false;
 static std::recursive_mutex s_pulseMutex;
 
-void UpdateMQ2SpawnSort();
+// Benchmarks for the phases of the heartbeat
+static uint32_t bmHeartbeatDrawHUD = 0;
+static uint32_t bmHeartbeatPulse = 0;
+static uint32_t bmHeartbeatImGui = 0;
+static uint32_t bmHeartbeatMacro = 0;
+static uint32_t bmProcessGameEvents = 0;
 
 //----------------------------------------------------------------------------
 
-std::vector<std::function<void()>> s_queuedEvents;
-std::recursive_mutex s_queuedEventMutex;
+// Work posted from other threads. Anything left over when a pulse runs out of budget
+// is run first on the next pulse.
+static MPSCQueue<std::function<void()>> s_queuedEvents;
+static constexpr std::chrono::milliseconds QueuedEventBudget{ 4 };
 extern wil::unique_event g_hLoadComplete;
 
 void PostToMainThread(std::function<void()>&& callback)
 {
-	std::scoped_lock lock(s_queuedEventMutex);
-
-	s_queuedEvents.push_back(std::move(callback));
+	s_queuedEvents.Push(std::move(callback));
 }
 
 static void ProcessQueuedEvents()
 {
-	std::unique_lock lock(s_queuedEventMutex);
-
-	if (s_queuedEvents.empty())
-		return;
-
-	std::vector<std::function<void()>> events;
-	events.swap(s_queuedEvents);
-
-	lock.unlock();
-
-	for (auto& ev : events)
-		std::invoke(ev);
+	s_queuedEvents.ConsumeFor([](std::function<void()>& ev) { std::invoke(ev); }, QueuedEventBudget);
 }
 
 //----------------------------------------------------------------------------
@@ -105,7 +101,7 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 
 	if (!gDelay && pBlock && !pBlock->Paused && (!gMQPauseOnChat || pEverQuestInfo->KeyboardMode) && gMacroStack)
 	{
-		const MQMacroLine& ml = pBlock->Line.at(pBlock->CurrIndex);
+		MQMacroLine& ml = pBlock->Line.at(pBlock->CurrIndex);
 
 		if (pBlock->BindStackIndex == pBlock->CurrIndex)
 		{
@@ -114,15 +110,14 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 		}
 
 		gMacroStack->LocationIndex = pBlock->CurrIndex;
-#ifdef MQ2_PROFILING
-		LARGE_INTEGER BeforeCommand;
-		QueryPerformanceCounter(&BeforeCommand);
-		int ThisMacroBlock = pBlock->CurrIndex;
-#endif
+		const int ThisMacroBlock = pBlock->CurrIndex;
 
 		if (gbInZone && !gZoning)
 		{
-			DoCommand(pChar, (char*)ml.Command.c_str());
+			const MQMacroLineProfile lineProfile = BeginMacroLineProfile();
+			DoMacroLine(pChar, ml);
+			EndMacroLineProfile(lineProfile, ml, ThisMacroBlock);
+
 			MQMacroBlockPtr pCurrentBlock = GetCurrentMacroBlock();
 
 			if (!pCurrentBlock)
@@ -154,13 +149,6 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 				}
 			}
 
-#ifdef MQ2_PROFILING
-			LARGE_INTEGER AfterCommand;
-			QueryPerformanceCounter(&AfterCommand);
-			pCurrentBlock->Line[ThisMacroBlock].ExecutionCount++;
-			pCurrentBlock->Line[ThisMacroBlock].ExecutionTime += AfterCommand.QuadPart - BeforeCommand.QuadPart;
-#endif
-
 			const int lastindex = pCurrentBlock->Line.rbegin()->first;
 			if (pCurrentBlock->CurrIndex > lastindex)
 			{
@@ -370,6 +358,8 @@ static void Pulse()
 		pipeclient::NotifyIsForegroundWindow(gbInForeground);
 	}
 
+	++gPulseCount;
+
 	// handle queued events.
 	ProcessQueuedEvents();
 
@@ -451,7 +441,7 @@ static void Pulse()
 		char* pAutoRun = szAutoRun;
 
 		// autorun command for everyone
-		GetPrivateProfileString("AutoRun", "ALL", "", szAutoRun, MAX_STRING, mq::internal_paths::MQini);
+		GetCachedPrivateProfileString("AutoRun", "ALL", "", szAutoRun, MAX_STRING, mq::internal_paths::MQini);
 		while (pAutoRun[0] == ' ' || pAutoRun[0] == '\t') pAutoRun++;
 		if (szAutoRun[0] != 0)
 			DoCommand(pChar, pAutoRun);
@@ -461,7 +451,7 @@ static void Pulse()
 		pAutoRun = szAutoRun;
 		char szServerAndName[128] = { 0 };
 		sprintf_s(szServerAndName, "%s.%s", GetServerShortName(), pLocalPC->Name);
-		GetPrivateProfileString("AutoRun", szServerAndName, "", szAutoRun, MAX_STRING, mq::internal_paths::MQini);
+		GetCachedPrivateProfileString("AutoRun", szServerAndName, "", szAutoRun, MAX_STRING, mq::internal_paths::MQini);
 		while (pAutoRun[0] == ' ' || pAutoRun[0] == '\t') pAutoRun++;
 		if (szAutoRun[0] != 0)
 			DoCommand(pChar, pAutoRun);
@@ -582,6 +572,7 @@ static HeartbeatState Heartbeat()
 	uint64_t Tick = MQGetTickCount64();
 
 	BeatCount++;
+	BeginBenchmarkFrame();
 
 	if (bFirstHeartBeat)
 	{
@@ -593,12 +584,7 @@ static HeartbeatState Heartbeat()
 	TickDiff += (Tick - LastGetTick);
 	LastGetTick = Tick;
 
-	while (TickDiff >= 100)
-	{
-		TickDiff -= 100;
-		if (gDelay > 0) gDelay--;
-		DropTimers();
-	}
+	AdvanceMacroTimers(TickDiff);
 
 	if (!gStringTableFixed && pStringTable)
 	{
@@ -626,12 +612,14 @@ static HeartbeatState Heartbeat()
 	}
 
 	UpdateMQ2SpawnSort();
+	InvalidateInventoryIndex();
+	InvalidateAltAbilityTables();
 
-	DebugTry(DrawHUD());
+	DebugTry(Benchmark(bmHeartbeatDrawHUD, DrawHUD()));
 	DebugTry(PulseMQ2AutoInventory());
 
 	bRunNextCommand = true;
-	DebugTry(Pulse());
+	DebugTry(Benchmark(bmHeartbeatPulse, Pulse()));
 	DebugTry(Benchmark(bmPluginsPulse, DebugTry(PulsePlugins())));
 
 	static bool ShownNews = false;
@@ -642,7 +630,11 @@ static HeartbeatState Heartbeat()
 			CreateMQ2NewsWindow();
 	}
 
-	ImGuiManager_Pulse();
+	Benchmark(bmHeartbeatImGui, ImGuiManager_Pulse());
+	GraphicsResources_OnPulse();
+
+	// Wait for the plugins' OnAsyncPulse before any commands or macro lines run.
+	JoinAsyncPluginPulse();
 
 	if (gGameState == -1)
 	{
@@ -651,29 +643,65 @@ static HeartbeatState Heartbeat()
 		return HeartbeatNormal;
 	}
 
+	if (!RunMacroFrame())
+		return HeartbeatUnload;
+
+	PulseCommands();
+
+	return HeartbeatNormal;
+}
+
+// Counts down /delay and the macro timers once for every 100ms in elapsed, leaving the remainder.
+void AdvanceMacroTimers(uint64_t& elapsed)
+{
+	while (elapsed >= 100)
+	{
+		elapsed -= 100;
+		if (gDelay > 0) gDelay--;
+		DropTimers();
+	}
+}
+
+// Runs the current macro for one frame's worth of lines. Returns false if a line asked to unload.
+bool RunMacroFrame()
+{
 	int CurTurbo = 0;
 
+	// With a turbo budget the macro runs until the budget for this frame is spent instead of for a
+	// fixed number of lines, so cheap lines run many times a frame and expensive ones only a few.
+	const auto turboDeadline = gTurboBudget > 0
+		? std::chrono::steady_clock::now() + std::chrono::microseconds(gTurboBudget)
+		: std::chrono::steady_clock::time_point::max();
+
 	MQMacroBlockPtr pBlock = GetNextMacroBlock();
-	while (bRunNextCommand)
+	if (pBlock)
 	{
-		if (!pBlock)
-			break;
-		if (!DoNextCommand(pBlock))
-			break;
-		if (gbUnload)
-			return HeartbeatUnload;
-		if (!gTurbo)
-			break;
-		if (++CurTurbo > gMaxTurbo)
-			break;
+		MQScopedBenchmark bm(bmHeartbeatMacro);
 
-		// re-fetch current macro block in case one of the previous instructions changed it
-		pBlock = GetCurrentMacroBlock();
-	}
+		while (bRunNextCommand)
+		{
+			if (!pBlock)
+				break;
+			if (!DoNextCommand(pBlock))
+				break;
+			if (gbUnload)
+				return false;
+			if (!gTurbo)
+				break;
+			if (gTurboBudget > 0)
+			{
+				if (std::chrono::steady_clock::now() >= turboDeadline)
+					break;
+			}
+			else if (++CurTurbo > gMaxTurbo)
+				break;
 
-	PulseCommands();
+			// re-fetch current macro block in case one of the previous instructions changed it
+			pBlock = GetCurrentMacroBlock();
+		}
+	}
 
-	return HeartbeatNormal;
+	return true;
 }
 
 // ***************************************************************************
@@ -696,7 +724,7 @@ bool DoGameEventsPulse(int (*pEventFunc)())
 
 	int processGameEventsResult = 0;
 	if (pEventFunc)
-		processGameEventsResult = pEventFunc();
+		Benchmark(bmProcessGameEvents, processGameEventsResult = pEventFunc());
 
 	if (hbState == HeartbeatLoad && !IsPluginsInitialized())
 	{
@@ -756,6 +784,7 @@ public:
 	void CMerchantWnd__PurchasePageHandler__UpdateList_Detour()
 	{
 		gItemsReceived = false;
+		InvalidateMerchantItemIndex();
 
 		CMerchantWnd__PurchasePageHandler__UpdateList_Trampoline();
 
@@ -769,6 +798,12 @@ void InitializeMQ2Pulse()
 
 	std::scoped_lock lock(s_pulseMutex);
 
+	bmHeartbeatDrawHUD = AddMQ2Benchmark("Heartbeat_DrawHUD");
+	bmHeartbeatPulse = AddMQ2Benchmark("Heartbeat_Pulse");
+	bmHeartbeatImGui = AddMQ2Benchmark("Heartbeat_ImGui");
+	bmHeartbeatMacro = AddMQ2Benchmark("Heartbeat_Macro");
+	bmProcessGameEvents = AddMQ2Benchmark("ProcessGameEvents");
+
 	AddDetour(reinterpret_cast<uintptr_t>(ProcessGameEvents), Detour_ProcessGameEvents, Trampoline_ProcessGameEvents, "ProcessGameEvents");
 	EzDetour(CEverQuest__SetGameState, &CEverQuestHook::SetGameState_Detour, &CEverQuestHook::SetGameState_Trampoline);
 	EzDetour(CMerchantWnd__PurchasePageHandler__UpdateList, &CEverQuestHook::CMerchantWnd__PurchasePageHandler__UpdateList_Detour, &CEverQuestHook::CMerchantWnd__PurchasePageHandler__UpdateList_Trampoline);
@@ -786,6 +821,12 @@ void ShutdownMQ2Pulse()
 	RemoveDetour(reinterpret_cast<uintptr_t>(ProcessGameEvents));
 	RemoveDetour(CEverQuest__SetGameState);
 	RemoveDetour(CMerchantWnd__PurchasePageHandler__UpdateList);
+
+	RemoveMQ2Benchmark(bmHeartbeatDrawHUD);
+	RemoveMQ2Benchmark(bmHeartbeatPulse);
+	RemoveMQ2Benchmark(bmHeartbeatImGui);
+	RemoveMQ2Benchmark(bmHeartbeatMacro);
+	RemoveMQ2Benchmark(bmProcessGameEvents);
 }
 
 } // namespace mq
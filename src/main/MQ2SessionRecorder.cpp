@@ -0,0 +1,613 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include <fstream>
+#include <unordered_set>
+
+namespace mq {
+
+static void SessionRecorder_Initialize();
+static void SessionRecorder_Shutdown();
+static void SessionRecorder_Pulse();
+static void SessionRecorder_SetGameState(DWORD GameState);
+static void SessionRecorder_SpawnAdded(SPAWNINFO* pSpawn);
+static void SessionRecorder_SpawnRemoved(SPAWNINFO* pSpawn);
+
+static MQModule s_sessionRecorderModule = {
+	"SessionRecorder",             // Name
+	true,                          // CanUnload
+	SessionRecorder_Initialize,
+	SessionRecorder_Shutdown,
+	SessionRecorder_Pulse,
+	SessionRecorder_SetGameState,
+	nullptr,                       // UpdateImGui
+	nullptr,                       // Zoned
+	nullptr,                       // WriteChatColor
+	SessionRecorder_SpawnAdded,
+	SessionRecorder_SpawnRemoved,
+};
+DECLARE_DEFERRED_MODULE_INITIALIZER(s_sessionRecorderModule);
+
+static constexpr char SESSION_FILE_MAGIC[8] = { 'M', 'Q', 'S', 'E', 'S', 'S', 'N', 0 };
+static constexpr uint32_t SESSION_FILE_VERSION = 1;
+static constexpr uint64_t POSITION_SNAPSHOT_INTERVAL = 250;   // ms between writing the spawns that moved
+
+// A session file is the magic, the version and the spawn id of the recording character, followed
+// by records of one type byte each and the data for that type. Records are in the order the
+// client saw them, a Frame record ends every pulse.
+enum class SessionRecordType : uint8_t
+{
+	Frame = 1,             // uint32 ms since the recording started
+	Chat,                  // uint32 length, the text and a terminating zero
+	SpawnAdded,            // uint32 spawn id
+	SpawnRemoved,          // uint32 spawn id
+	Position,              // uint32 spawn id, float x, y, z, heading
+	GameState,             // int32 game state
+};
+
+struct SessionPosition
+{
+	float X = 0;
+	float Y = 0;
+	float Z = 0;
+	float Heading = 0;
+
+	bool operator==(const SessionPosition& other) const
+	{
+		return X == other.X && Y == other.Y && Z == other.Z && Heading == other.Heading;
+	}
+};
+
+static SessionPosition GetSessionPosition(const SPAWNINFO* pSpawn)
+{
+	return SessionPosition{ pSpawn->X, pSpawn->Y, pSpawn->Z, pSpawn->Heading };
+}
+
+static std::filesystem::path GetSessionFilePath(std::string_view name)
+{
+	std::filesystem::path path = std::string(name);
+	if (!path.has_extension())
+		path.replace_extension(".mqsession");
+
+	if (path.is_relative())
+		path = std::filesystem::path(gPathLogs) / "sessions" / path;
+
+	return path;
+}
+
+//============================================================================
+
+// Writes what the client reacts to as it happens: chat going to the event system, spawns coming
+// and going, where they are, and the game state.
+class SessionRecorder
+{
+public:
+	bool IsRecording() const { return m_file.is_open(); }
+	const std::filesystem::path& GetPath() const { return m_path; }
+	uint32_t GetFrames() const { return m_frames; }
+
+	bool Start(const std::filesystem::path& path)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		m_file.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open())
+			return false;
+
+		m_path = path;
+		m_startTime = MQGetTickCount64();
+		m_lastSnapshotTime = 0;
+		m_frames = 0;
+		m_positions.clear();
+
+		m_file.write(SESSION_FILE_MAGIC, sizeof(SESSION_FILE_MAGIC));
+		Write(SESSION_FILE_VERSION);
+		Write(static_cast<uint32_t>(pLocalPlayer ? pLocalPlayer->SpawnID : 0));
+
+		// the replay starts in the state the recording did, and with the spawns where they were
+		RecordGameState(gGameState);
+		RecordPositions();
+		return true;
+	}
+
+	bool Stop()
+	{
+		if (!IsRecording())
+			return false;
+
+		m_file.close();
+		return !m_file.fail();
+	}
+
+	void RecordChat(const char* szMsg)
+	{
+		const uint32_t length = static_cast<uint32_t>(strlen(szMsg));
+
+		Write(SessionRecordType::Chat);
+		Write(length);
+		m_file.write(szMsg, length + 1);
+	}
+
+	void RecordSpawn(SessionRecordType type, const SPAWNINFO* pSpawn)
+	{
+		Write(type);
+		Write(static_cast<uint32_t>(pSpawn->SpawnID));
+
+		if (type == SessionRecordType::SpawnRemoved)
+			m_positions.erase(pSpawn->SpawnID);
+	}
+
+	void RecordGameState(DWORD gameState)
+	{
+		Write(SessionRecordType::GameState);
+		Write(static_cast<int32_t>(gameState));
+	}
+
+	void RecordFrame()
+	{
+		const uint64_t now = MQGetTickCount64();
+
+		if (now - m_lastSnapshotTime >= POSITION_SNAPSHOT_INTERVAL)
+		{
+			m_lastSnapshotTime = now;
+			RecordPositions();
+		}
+
+		Write(SessionRecordType::Frame);
+		Write(static_cast<uint32_t>(now - m_startTime));
+		++m_frames;
+	}
+
+private:
+	template <typename T>
+	void Write(const T& value)
+	{
+		m_file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// Only the spawns that moved since the last snapshot are written.
+	void RecordPositions()
+	{
+		if (!pSpawnManager)
+			return;
+
+		for (SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+		{
+			const SessionPosition position = GetSessionPosition(pSpawn);
+
+			auto [iter, added] = m_positions.emplace(pSpawn->SpawnID, position);
+			if (!added)
+			{
+				if (iter->second == position)
+					continue;
+				iter->second = position;
+			}
+
+			Write(SessionRecordType::Position);
+			Write(static_cast<uint32_t>(pSpawn->SpawnID));
+			Write(position);
+		}
+	}
+
+	std::ofstream m_file;
+	std::filesystem::path m_path;
+	uint64_t m_startTime = 0;
+	uint64_t m_lastSnapshotTime = 0;
+	uint32_t m_frames = 0;
+	std::unordered_map<uint32_t, SessionPosition> m_positions;
+};
+
+static SessionRecorder* s_recorder = nullptr;
+static bool s_replaying = false;
+
+void RecordSessionChat(const char* szMsg)
+{
+	if (s_recorder && s_recorder->IsRecording() && !s_replaying)
+		s_recorder->RecordChat(szMsg);
+}
+
+//============================================================================
+
+struct SessionEvent
+{
+	SessionRecordType Type;
+	uint32_t Value = 0;                // ms for frames, spawn id or game state otherwise
+	SessionPosition Position;
+	const char* Text = nullptr;        // points into the loaded file
+};
+
+struct SessionReplayStats
+{
+	uint32_t Frames = 0;
+	uint32_t ChatLines = 0;
+	uint32_t SpawnEvents = 0;
+	uint32_t PositionUpdates = 0;
+	uint32_t GameStates = 0;
+	uint32_t SkippedEvents = 0;
+	uint32_t RecordedTime = 0;         // ms
+	bool Interrupted = false;
+};
+
+// Reads a whole session into memory up front, so that reading the file isn't part of the replay's
+// time. A file that ends in the middle of a record, because the client closed while recording,
+// is read up to that record.
+static bool LoadSession(const std::filesystem::path& path, std::vector<char>& data,
+	std::vector<SessionEvent>& events, uint32_t& recordedSelfID)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	size_t pos = 0;
+	auto read = [&](auto& value)
+	{
+		if (pos + sizeof(value) > data.size())
+			return false;
+		memcpy(&value, data.data() + pos, sizeof(value));
+		pos += sizeof(value);
+		return true;
+	};
+
+	char magic[sizeof(SESSION_FILE_MAGIC)];
+	uint32_t version = 0;
+	if (!read(magic) || memcmp(magic, SESSION_FILE_MAGIC, sizeof(magic)) != 0
+		|| !read(version) || version != SESSION_FILE_VERSION || !read(recordedSelfID))
+	{
+		return false;
+	}
+
+	SessionRecordType type;
+	while (read(type))
+	{
+		SessionEvent ev{ type };
+		bool complete = true;
+
+		switch (type)
+		{
+		case SessionRecordType::Frame:
+		case SessionRecordType::SpawnAdded:
+		case SessionRecordType::SpawnRemoved:
+		case SessionRecordType::GameState:
+			complete = read(ev.Value);
+			break;
+
+		case SessionRecordType::Position:
+			complete = read(ev.Value) && read(ev.Position);
+			break;
+
+		case SessionRecordType::Chat: {
+			uint32_t length = 0;
+			complete = read(length) && pos + length + 1 <= data.size();
+			if (complete)
+			{
+				ev.Text = data.data() + pos;
+				pos += length + 1;
+			}
+			break;
+		}
+
+		default:
+			complete = false;
+			break;
+		}
+
+		if (!complete)
+			break;
+
+		events.push_back(ev);
+	}
+
+	return true;
+}
+
+// Feeds a recorded session into the event system, the plugins, the spawn sort and the macro engine
+// as fast as they can take it. Frames run back to back but the macro timers count down by the
+// recorded time between them, so /delay and timers in the macro take the same number of frames.
+//
+// The recorded spawns don't exist in this zone, so each of them is played by a live spawn: the one
+// with the same id if there is one, otherwise the next live spawn in turn. The recording character
+// is played by ours. Spawns are put back where they were, and ones that were removed during the
+// replay are added back, when the replay is done.
+static SessionReplayStats ReplaySession(const std::vector<SessionEvent>& events, uint32_t recordedSelfID)
+{
+	SessionReplayStats stats;
+
+	std::vector<SPAWNINFO*> standIns;
+	if (pSpawnManager)
+	{
+		for (SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+		{
+			if (pSpawn != pLocalPlayer)
+				standIns.push_back(pSpawn);
+		}
+	}
+
+	std::unordered_map<uint32_t, SPAWNINFO*> spawnMap;
+	if (recordedSelfID != 0 && pLocalPlayer)
+		spawnMap[recordedSelfID] = pLocalPlayer;
+	size_t nextStandIn = 0;
+
+	auto resolveSpawn = [&](uint32_t spawnID) -> SPAWNINFO*
+	{
+		auto iter = spawnMap.find(spawnID);
+		if (iter != spawnMap.end())
+			return iter->second;
+
+		SPAWNINFO* pSpawn = GetSpawnByID(spawnID);
+		if (!pSpawn && !standIns.empty())
+			pSpawn = standIns[nextStandIn++ % standIns.size()];
+
+		spawnMap[spawnID] = pSpawn;
+		return pSpawn;
+	};
+
+	std::unordered_map<SPAWNINFO*, SessionPosition> originalPositions;
+	std::unordered_set<SPAWNINFO*> removedSpawns;
+	const DWORD originalGameState = gGameState;
+
+	uint32_t lastFrameTime = 0;
+	uint64_t macroTime = 0;
+
+	s_replaying = true;
+
+	for (const SessionEvent& ev : events)
+	{
+		switch (ev.Type)
+		{
+		case SessionRecordType::Frame:
+			macroTime += ev.Value - lastFrameTime;
+			lastFrameTime = ev.Value;
+			AdvanceMacroTimers(macroTime);
+
+			UpdateMQ2SpawnSort();
+			EnsureMQ2SpawnSort();
+
+			bRunNextCommand = true;
+			if (!RunMacroFrame())
+				stats.Interrupted = true;
+
+			++stats.Frames;
+			break;
+
+		case SessionRecordType::Chat:
+			CheckChatForEvent(ev.Text);
+			++stats.ChatLines;
+			break;
+
+		case SessionRecordType::SpawnAdded:
+		case SessionRecordType::SpawnRemoved: {
+			SPAWNINFO* pSpawn = resolveSpawn(ev.Value);
+			if (!pSpawn || pSpawn == pLocalPlayer)
+			{
+				++stats.SkippedEvents;
+				break;
+			}
+
+			if (ev.Type == SessionRecordType::SpawnAdded)
+			{
+				PluginsAddSpawn(pSpawn);
+				removedSpawns.erase(pSpawn);
+			}
+			else
+			{
+				PluginsRemoveSpawn(pSpawn);
+				removedSpawns.insert(pSpawn);
+			}
+
+			++stats.SpawnEvents;
+			break;
+		}
+
+		case SessionRecordType::Position: {
+			SPAWNINFO* pSpawn = resolveSpawn(ev.Value);
+			if (!pSpawn)
+			{
+				++stats.SkippedEvents;
+				break;
+			}
+
+			originalPositions.emplace(pSpawn, GetSessionPosition(pSpawn));
+
+			pSpawn->X = ev.Position.X;
+			pSpawn->Y = ev.Position.Y;
+			pSpawn->Z = ev.Position.Z;
+			pSpawn->Heading = ev.Position.Heading;
+			++stats.PositionUpdates;
+			break;
+		}
+
+		case SessionRecordType::GameState:
+			if (ev.Value != gGameState)
+				PluginsSetGameState(ev.Value);
+			++stats.GameStates;
+			break;
+		}
+
+		if (gbUnload)
+			stats.Interrupted = true;
+
+		if (stats.Interrupted)
+			break;
+	}
+
+	s_replaying = false;
+
+	for (const auto& [pSpawn, position] : originalPositions)
+	{
+		pSpawn->X = position.X;
+		pSpawn->Y = position.Y;
+		pSpawn->Z = position.Z;
+		pSpawn->Heading = position.Heading;
+	}
+
+	for (SPAWNINFO* pSpawn : removedSpawns)
+		PluginsAddSpawn(pSpawn);
+
+	if (gGameState != originalGameState)
+		PluginsSetGameState(originalGameState);
+
+	UpdateMQ2SpawnSort();
+
+	stats.RecordedTime = lastFrameTime;
+	return stats;
+}
+
+//============================================================================
+
+static void Cmd_MQRecord(SPAWNINFO* pChar, char* szLine)
+{
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szLine, 1);
+
+	if (ci_equals(szArg, "start"))
+	{
+		if (s_recorder->IsRecording())
+		{
+			WriteChatf("\ay[Session]\ax Already recording to: %s", s_recorder->GetPath().string().c_str());
+			return;
+		}
+
+		GetArg(szArg, szLine, 2);
+
+		std::string name = szArg;
+		if (name.empty())
+		{
+			SYSTEMTIME t;
+			::GetLocalTime(&t);
+
+			name = fmt::format("session_{:04}{:02}{:02}_{:02}{:02}{:02}",
+				t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
+		}
+
+		const std::filesystem::path path = GetSessionFilePath(name);
+		if (s_recorder->Start(path))
+			WriteChatf("\ay[Session]\ax Recording to: %s. Use \ay/mqrecord stop\ax to finish.", path.string().c_str());
+		else
+			WriteChatf("\ar[Session]\ax Could not open %s for writing.", path.string().c_str());
+	}
+	else if (ci_equals(szArg, "stop"))
+	{
+		if (!s_recorder->IsRecording())
+		{
+			WriteChatf("\ay[Session]\ax Not recording.");
+			return;
+		}
+
+		const uint32_t frames = s_recorder->GetFrames();
+		const std::string path = s_recorder->GetPath().string();
+
+		if (s_recorder->Stop())
+			WriteChatf("\ay[Session]\ax Recorded \at%u\ax frames to: %s", frames, path.c_str());
+		else
+			WriteChatf("\ar[Session]\ax Failed to write the recording to: %s", path.c_str());
+	}
+	else
+	{
+		WriteChatf("Usage: /mqrecord start [name]|stop");
+	}
+}
+
+static void Cmd_MQReplay(SPAWNINFO* pChar, char* szLine)
+{
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szLine, 1);
+
+	if (szArg[0] == 0)
+	{
+		WriteChatf("Usage: /mqreplay <session name or file>");
+		return;
+	}
+
+	if (s_recorder->IsRecording() || s_replaying)
+	{
+		WriteChatf("\ay[Session]\ax Stop recording before replaying a session.");
+		return;
+	}
+
+	const std::filesystem::path path = GetSessionFilePath(szArg);
+
+	std::vector<char> data;
+	std::vector<SessionEvent> events;
+	uint32_t recordedSelfID = 0;
+	if (!LoadSession(path, data, events, recordedSelfID))
+	{
+		WriteChatf("\ar[Session]\ax %s is missing or isn't a session recording.", path.string().c_str());
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	const SessionReplayStats stats = ReplaySession(events, recordedSelfID);
+	const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	const float recordedSeconds = stats.RecordedTime / 1000.0f;
+
+	WriteChatf("\ay[Session]\ax Replayed \at%.1f\axs of play in \at%.2f\axs (\at%.1fx\ax real time)%s",
+		recordedSeconds, seconds, seconds > 0 ? recordedSeconds / seconds : 0.0f,
+		stats.Interrupted ? ", \arinterrupted\ax" : "");
+	WriteChatf("  \at%u\ax frames (\at%.0f\ax/s), \at%u\ax chat lines (\at%.0f\ax/s)",
+		stats.Frames, seconds > 0 ? stats.Frames / seconds : 0.0f,
+		stats.ChatLines, seconds > 0 ? stats.ChatLines / seconds : 0.0f);
+	WriteChatf("  \at%u\ax spawn events, \at%u\ax position updates, \at%u\ax game states, \at%u\ax skipped",
+		stats.SpawnEvents, stats.PositionUpdates, stats.GameStates, stats.SkippedEvents);
+}
+
+//============================================================================
+
+static void SessionRecorder_Pulse()
+{
+	if (s_recorder->IsRecording() && !s_replaying)
+		s_recorder->RecordFrame();
+}
+
+static void SessionRecorder_SetGameState(DWORD GameState)
+{
+	if (s_recorder->IsRecording() && !s_replaying)
+		s_recorder->RecordGameState(GameState);
+}
+
+static void SessionRecorder_SpawnAdded(SPAWNINFO* pSpawn)
+{
+	if (s_recorder->IsRecording() && !s_replaying)
+		s_recorder->RecordSpawn(SessionRecordType::SpawnAdded, pSpawn);
+}
+
+static void SessionRecorder_SpawnRemoved(SPAWNINFO* pSpawn)
+{
+	if (s_recorder->IsRecording() && !s_replaying)
+		s_recorder->RecordSpawn(SessionRecordType::SpawnRemoved, pSpawn);
+}
+
+static void SessionRecorder_Initialize()
+{
+	s_recorder = new SessionRecorder();
+
+	AddCommand("/mqrecord", Cmd_MQRecord, false, false);
+	AddCommand("/mqreplay", Cmd_MQReplay, false, false);
+}
+
+static void SessionRecorder_Shutdown()
+{
+	RemoveCommand("/mqrecord");
+	RemoveCommand("/mqreplay");
+
+	delete s_recorder;
+	s_recorder = nullptr;
+}
+
+} // namespace mq
@@ -0,0 +1,495 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Clients in the same zone elect one of themselves, the one with the lowest process id, to send
+// the spawns it sees to the rest. Every client that has this turned on says which zone it is in
+// once a second. The publisher sends a full list of spawns every few seconds, or when a client
+// asks for one, and in between only the spawns that changed. A client that misses an update asks
+// for the full list again instead of guessing.
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+#include "mq/api/SharedSpawns.h"
+
+#include "routing/Routing.h"
+#include "routing/PostOffice.h"
+
+#include <chrono>
+#include <unordered_set>
+
+namespace mq {
+using namespace postoffice;
+
+static void SharedSpawns_Initialize();
+static void SharedSpawns_Shutdown();
+static void SharedSpawns_Pulse();
+
+static MQModule s_sharedSpawnsModule = {
+	"SharedSpawns",                // Name
+	false,                         // CanUnload
+	SharedSpawns_Initialize,
+	SharedSpawns_Shutdown,
+	SharedSpawns_Pulse,
+};
+DECLARE_MODULE_INITIALIZER(s_sharedSpawnsModule);
+
+static constexpr const char* SHARED_SPAWNS_MAILBOX = "shared_spawns";
+static constexpr uint8_t SHARED_SPAWNS_VERSION = 1;
+
+// How often each client says which zone it is in, and how long until one that stopped is forgotten
+static constexpr std::chrono::seconds PRESENCE_INTERVAL = std::chrono::seconds(1);
+static constexpr std::chrono::seconds PRESENCE_TIMEOUT = std::chrono::seconds(3);
+
+// How often the publisher sends every spawn, not just the ones that changed
+static constexpr std::chrono::seconds KEYFRAME_INTERVAL = std::chrono::seconds(10);
+
+// How far a spawn has to move before its position is sent again
+static constexpr float POSITION_THRESHOLD = 0.5f;
+
+enum class SharedSpawnsMessage : uint8_t
+{
+	Presence,
+	Keyframe,
+	Delta,
+};
+
+enum SharedSpawnsFlags : uint8_t
+{
+	SharedSpawnsFlag_WantKeyframe = 0x01,          // on presence, the sender needs a full list
+};
+
+enum SharedSpawnFlags : uint8_t
+{
+	SharedSpawnFlag_Dead = 0x01,
+	SharedSpawnFlag_Removed = 0x02,
+	SharedSpawnFlag_HasName = 0x04,
+};
+
+#pragma pack(push, 1)
+struct SharedSpawnsHeader
+{
+	uint8_t version;
+	SharedSpawnsMessage kind;
+	uint8_t flags;
+	uint32_t pid;
+	uint32_t zoneID;
+	uint32_t sequence;
+	uint32_t count;
+};
+
+// followed by nameLength bytes of name if SharedSpawnFlag_HasName is set
+struct SharedSpawnRecord
+{
+	uint32_t spawnID;
+	float x;
+	float y;
+	float z;
+	uint8_t pctHPs;
+	uint8_t level;
+	uint8_t type;
+	uint8_t flags;
+	uint8_t nameLength;
+};
+#pragma pack(pop)
+
+struct SharedSpawnsMember
+{
+	uint32_t zoneID;
+	std::chrono::steady_clock::time_point lastSeen;
+};
+
+static Dropbox s_dropbox;
+
+static std::unordered_map<uint32_t, SharedSpawnsMember> s_members;
+static uint32_t s_zoneID = 0;
+static uint32_t s_publisher = 0;
+static std::chrono::steady_clock::time_point s_lastPresence;
+
+// what this client has been sent, or has sent, sorted by spawn id
+static std::vector<MQSharedSpawn> s_spawns;
+static uint32_t s_sequence = 0;
+static bool s_haveKeyframe = false;
+
+// publisher only: the last record sent for each spawn
+static std::unordered_map<uint32_t, SharedSpawnRecord> s_published;
+static std::chrono::steady_clock::time_point s_lastPublish;
+static std::chrono::steady_clock::time_point s_lastKeyframe;
+static bool s_keyframeRequested = false;
+
+static proto::routing::Address GetSharedSpawnsAddress()
+{
+	// the launcher only passes mail for everyone on to the clients that have the mailbox
+	proto::routing::Address address;
+	address.set_mailbox(SHARED_SPAWNS_MAILBOX);
+	address.set_server(GetServerShortName());
+	return address;
+}
+
+static SharedSpawnsHeader MakeHeader(SharedSpawnsMessage kind)
+{
+	SharedSpawnsHeader header = {};
+	header.version = SHARED_SPAWNS_VERSION;
+	header.kind = kind;
+	header.pid = GetCurrentProcessId();
+	header.zoneID = s_zoneID;
+	return header;
+}
+
+static void Reset()
+{
+	s_spawns.clear();
+	s_published.clear();
+	s_sequence = 0;
+	s_haveKeyframe = false;
+	s_publisher = 0;
+}
+
+static void SendPresence()
+{
+	SharedSpawnsHeader header = MakeHeader(SharedSpawnsMessage::Presence);
+	if (!s_haveKeyframe && s_publisher != GetCurrentProcessId())
+		header.flags |= SharedSpawnsFlag_WantKeyframe;
+
+	s_dropbox.PostLatest(GetSharedSpawnsAddress(), "presence",
+		std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+
+	s_lastPresence = std::chrono::steady_clock::now();
+}
+
+//----------------------------------------------------------------------------
+// Receiving
+
+static void ApplyRecord(const SharedSpawnRecord& record, std::string_view name)
+{
+	auto iter = std::lower_bound(s_spawns.begin(), s_spawns.end(), record.spawnID,
+		[](const MQSharedSpawn& spawn, uint32_t spawnID) { return spawn.SpawnID < spawnID; });
+	const bool found = iter != s_spawns.end() && iter->SpawnID == record.spawnID;
+
+	if (record.flags & SharedSpawnFlag_Removed)
+	{
+		if (found)
+			s_spawns.erase(iter);
+		return;
+	}
+
+	if (!found)
+	{
+		iter = s_spawns.insert(iter, MQSharedSpawn{});
+		iter->SpawnID = record.spawnID;
+	}
+
+	MQSharedSpawn& spawn = *iter;
+	if (record.flags & SharedSpawnFlag_HasName)
+		strncpy_s(spawn.Name, name.data(), name.size());
+
+	spawn.Level = record.level;
+	spawn.Type = record.type;
+	spawn.X = record.x;
+	spawn.Y = record.y;
+	spawn.Z = record.z;
+	spawn.PctHPs = record.pctHPs;
+	spawn.Dead = (record.flags & SharedSpawnFlag_Dead) != 0;
+}
+
+static void ApplySpawns(const SharedSpawnsHeader& header, std::string_view data)
+{
+	if (header.kind == SharedSpawnsMessage::Keyframe)
+	{
+		s_spawns.clear();
+		s_haveKeyframe = true;
+	}
+	else if (!s_haveKeyframe || header.sequence != s_sequence + 1)
+	{
+		// missed something, wait for a full list
+		if (s_haveKeyframe)
+		{
+			s_haveKeyframe = false;
+			SendPresence();
+		}
+		return;
+	}
+
+	s_sequence = header.sequence;
+
+	for (uint32_t i = 0; i < header.count && data.size() >= sizeof(SharedSpawnRecord); ++i)
+	{
+		SharedSpawnRecord record;
+		memcpy(&record, data.data(), sizeof(record));
+		data.remove_prefix(sizeof(record));
+
+		std::string_view name;
+		if (record.flags & SharedSpawnFlag_HasName)
+		{
+			if (data.size() < record.nameLength)
+				break;
+
+			name = data.substr(0, record.nameLength);
+			data.remove_prefix(record.nameLength);
+		}
+
+		ApplyRecord(record, name);
+	}
+}
+
+static void ReceiveMessage(ProtoMessagePtr&& message)
+{
+	if (!gbSharedSpawns || message->size() < sizeof(SharedSpawnsHeader))
+		return;
+
+	SharedSpawnsHeader header;
+	memcpy(&header, message->get<char>(), sizeof(header));
+
+	if (header.version != SHARED_SPAWNS_VERSION || header.pid == GetCurrentProcessId())
+		return;
+
+	// clients say which zone they are in even if they've left this one, so the election sees it
+	s_members.insert_or_assign(header.pid, SharedSpawnsMember{ header.zoneID, std::chrono::steady_clock::now() });
+
+	if (header.zoneID != s_zoneID || s_zoneID == 0)
+		return;
+
+	switch (header.kind)
+	{
+	case SharedSpawnsMessage::Presence:
+		if (header.flags & SharedSpawnsFlag_WantKeyframe)
+			s_keyframeRequested = true;
+		break;
+
+	case SharedSpawnsMessage::Keyframe:
+	case SharedSpawnsMessage::Delta:
+		if (header.pid == s_publisher)
+		{
+			ApplySpawns(header, std::string_view(message->get<char>() + sizeof(header),
+				message->size() - sizeof(header)));
+		}
+		break;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Publishing
+
+static SharedSpawnRecord MakeRecord(SPAWNINFO* pSpawn)
+{
+	SharedSpawnRecord record = {};
+	record.spawnID = pSpawn->SpawnID;
+	record.x = pSpawn->X;
+	record.y = pSpawn->Y;
+	record.z = pSpawn->Z;
+	record.pctHPs = static_cast<uint8_t>(pSpawn->HPMax > 0 ? std::clamp<int64_t>(pSpawn->HPCurrent * 100 / pSpawn->HPMax, 0, 100) : 0);
+	record.level = static_cast<uint8_t>(pSpawn->Level);
+	record.type = static_cast<uint8_t>(GetSpawnType(pSpawn));
+	record.flags = pSpawn->StandState == STANDSTATE_DEAD ? SharedSpawnFlag_Dead : 0;
+	return record;
+}
+
+static bool HasChanged(const SharedSpawnRecord& sent, const SharedSpawnRecord& current)
+{
+	return std::abs(sent.x - current.x) > POSITION_THRESHOLD
+		|| std::abs(sent.y - current.y) > POSITION_THRESHOLD
+		|| std::abs(sent.z - current.z) > POSITION_THRESHOLD
+		|| sent.pctHPs != current.pctHPs
+		|| sent.level != current.level
+		|| sent.type != current.type
+		|| sent.flags != current.flags;
+}
+
+static void AppendRecord(std::string& data, SharedSpawnRecord record, std::string_view name)
+{
+	if (!name.empty())
+	{
+		record.flags |= SharedSpawnFlag_HasName;
+		record.nameLength = static_cast<uint8_t>(std::min<size_t>(name.size(), EQ_MAX_NAME - 1));
+	}
+
+	data.append(reinterpret_cast<const char*>(&record), sizeof(record));
+
+	if (record.flags & SharedSpawnFlag_HasName)
+		data.append(name.data(), record.nameLength);
+}
+
+static void Publish(bool keyframe)
+{
+	SharedSpawnsHeader header = MakeHeader(keyframe ? SharedSpawnsMessage::Keyframe : SharedSpawnsMessage::Delta);
+	header.sequence = s_sequence + 1;
+
+	std::string data(sizeof(header), '\0');
+	std::unordered_set<uint32_t> seen;
+	seen.reserve(s_published.size());
+
+	for (SPAWNINFO* pSpawn = pSpawnManager ? pSpawnManager->FirstSpawn : nullptr; pSpawn; pSpawn = pSpawn->pNext)
+	{
+		SharedSpawnRecord record = MakeRecord(pSpawn);
+		seen.insert(record.spawnID);
+
+		auto iter = s_published.find(record.spawnID);
+		const bool added = iter == s_published.end();
+
+		if (!keyframe && !added && !HasChanged(iter->second, record))
+			continue;
+
+		// names only go out when a spawn is new to the receivers
+		AppendRecord(data, record, keyframe || added ? std::string_view(pSpawn->Name) : std::string_view());
+		s_published.insert_or_assign(record.spawnID, record);
+		++header.count;
+	}
+
+	for (auto iter = s_published.begin(); iter != s_published.end();)
+	{
+		if (seen.count(iter->first))
+		{
+			++iter;
+			continue;
+		}
+
+		if (!keyframe)
+		{
+			SharedSpawnRecord removed = {};
+			removed.spawnID = iter->first;
+			removed.flags = SharedSpawnFlag_Removed;
+			AppendRecord(data, removed, {});
+			++header.count;
+		}
+
+		iter = s_published.erase(iter);
+	}
+
+	if (!keyframe && header.count == 0)
+		return;
+
+	memcpy(data.data(), &header, sizeof(header));
+	s_dropbox.Post(GetSharedSpawnsAddress(), data);
+
+	// the publisher reads the same spawns as everyone else
+	ApplySpawns(header, std::string_view(data).substr(sizeof(header)));
+}
+
+static void UpdatePublisher()
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	uint32_t publisher = GetCurrentProcessId();
+	for (auto iter = s_members.begin(); iter != s_members.end();)
+	{
+		if (now - iter->second.lastSeen > PRESENCE_TIMEOUT)
+		{
+			iter = s_members.erase(iter);
+			continue;
+		}
+
+		if (iter->second.zoneID == s_zoneID)
+			publisher = std::min(publisher, iter->first);
+
+		++iter;
+	}
+
+	if (publisher != s_publisher)
+	{
+		Reset();
+		s_publisher = publisher;
+		s_keyframeRequested = true;
+
+		// say so right away, so the new publisher knows to send a full list
+		SendPresence();
+	}
+}
+
+//----------------------------------------------------------------------------
+
+static void SharedSpawns_Initialize()
+{
+	s_dropbox = GetPostOffice().RegisterAddress(SHARED_SPAWNS_MAILBOX, ReceiveMessage);
+}
+
+static void SharedSpawns_Shutdown()
+{
+	s_dropbox.Remove();
+
+	Reset();
+	s_members.clear();
+	s_zoneID = 0;
+}
+
+static void SharedSpawns_Pulse()
+{
+	const uint32_t zoneID = gbSharedSpawns && gGameState == GAMESTATE_INGAME && pLocalPC && !gZoning ? pLocalPC->zoneId : 0;
+	if (zoneID != s_zoneID)
+	{
+		Reset();
+		s_zoneID = zoneID;
+
+		if (s_zoneID == 0)
+			SendPresence(); // tell the others that this client is gone
+	}
+
+	if (s_zoneID == 0)
+		return;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now - s_lastPresence >= PRESENCE_INTERVAL)
+		SendPresence();
+
+	UpdatePublisher();
+
+	if (s_publisher != GetCurrentProcessId())
+		return;
+
+	const auto interval = std::chrono::milliseconds(1000 / std::clamp(gSharedSpawnRate, 1, 30));
+	if (now - s_lastPublish < interval)
+		return;
+
+	s_lastPublish = now;
+
+	const bool keyframe = s_keyframeRequested || now - s_lastKeyframe >= KEYFRAME_INTERVAL;
+	if (keyframe)
+	{
+		s_keyframeRequested = false;
+		s_lastKeyframe = now;
+	}
+
+	Publish(keyframe);
+}
+
+uint32_t GetSharedSpawnsPublisher()
+{
+	return s_zoneID != 0 ? s_publisher : 0;
+}
+
+const MQSharedSpawn* GetSharedSpawns(size_t& count)
+{
+	count = s_spawns.size();
+	return s_spawns.empty() ? nullptr : s_spawns.data();
+}
+
+const MQSharedSpawn* FindSharedSpawn(uint32_t spawnID)
+{
+	auto iter = std::lower_bound(s_spawns.begin(), s_spawns.end(), spawnID,
+		[](const MQSharedSpawn& spawn, uint32_t id) { return spawn.SpawnID < id; });
+
+	return iter != s_spawns.end() && iter->SpawnID == spawnID ? &*iter : nullptr;
+}
+
+const MQSharedSpawn* FindSharedSpawnByName(std::string_view name)
+{
+	for (const MQSharedSpawn& spawn : s_spawns)
+	{
+		if (ci_equals(spawn.Name, name))
+			return &spawn;
+	}
+
+	return nullptr;
+}
+
+} // namespace mq
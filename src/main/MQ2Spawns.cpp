@@ -15,12 +15,18 @@
 #include "pch.h"
 #include "MQ2Main.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MQ_SPAWNS_SSE2 1
+#endif
+
 namespace mq {
 
 static void Spawns_Initialize();
 static void Spawns_Shutdown();
 static void Spawns_Pulse();
 static void Spawns_BeginZone();
+static void Spawns_SpawnAdded(SPAWNINFO* pSpawn);
 static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn);
 
 static MQModule gSpawnsModule = {
@@ -33,7 +39,7 @@ static MQModule gSpawnsModule = {
 	nullptr,                      // UpdateImGui
 	nullptr,                      // Zoned
 	nullptr,                      // WriteChatColor
-	nullptr,                      // SpawnAdded
+	Spawns_SpawnAdded,            // SpawnAdded
 	Spawns_SpawnRemoved,          // SpawnRemoved
 	Spawns_BeginZone,             // BeginZone
 };
@@ -42,6 +48,432 @@ MQModule* GetSpawnsModule() { return &gSpawnsModule; }
 // Global spawn array, sorted by distance.
 std::vector<MQSpawnArrayItem> gSpawnsArray;
 
+#pragma region Spawn Grid
+//----------------------------------------------------------------------------
+// Uniform grid over the spawn positions, rebuilt whenever gSpawnsArray is sorted so spawn
+// searches with a radius, or looking for the nearest matches, only look at the cells around them.
+//----------------------------------------------------------------------------
+
+class MQSpawnGrid
+{
+	struct Entry
+	{
+		int64_t Cell;
+		SPAWNINFO* pSpawn;
+
+		bool operator<(const Entry& other) const { return Cell < other.Cell; }
+	};
+
+	// Sorted by row then column, so each row of a query is one contiguous range
+	std::vector<Entry> m_entries;
+
+	// Spawns added since the last rebuild, these are returned by every query
+	std::vector<SPAWNINFO*> m_unindexed;
+
+	int m_minX = 0, m_maxX = -1;
+	int m_minY = 0, m_maxY = -1;
+	bool m_built = false;
+
+	static int GetCellCoord(float value)
+	{
+		return static_cast<int>(std::floor(value / SPAWN_GRID_CELL_SIZE));
+	}
+
+	static int64_t GetCell(int cellX, int cellY)
+	{
+		// columns are offset so they sort in order within their row
+		return static_cast<int64_t>(cellY) * 0x100000000LL + (static_cast<int64_t>(cellX) + 0x80000000LL);
+	}
+
+	void GatherRow(int cellY, int minX, int maxX, std::vector<SPAWNINFO*>& spawns) const
+	{
+		if (cellY < m_minY || cellY > m_maxY)
+			return;
+
+		minX = std::max(minX, m_minX);
+		maxX = std::min(maxX, m_maxX);
+		if (minX > maxX)
+			return;
+
+		auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), Entry{ GetCell(minX, cellY), nullptr });
+		const int64_t last = GetCell(maxX, cellY);
+
+		for (; iter != m_entries.end() && iter->Cell <= last; ++iter)
+			spawns.push_back(iter->pSpawn);
+	}
+
+public:
+	void Clear()
+	{
+		m_entries.clear();
+		m_unindexed.clear();
+		m_minX = m_minY = 0;
+		m_maxX = m_maxY = -1;
+		m_built = false;
+	}
+
+	void Build(const std::vector<MQSpawnArrayItem>& spawns)
+	{
+		Clear();
+
+		m_minX = m_minY = INT_MAX;
+		m_maxX = m_maxY = INT_MIN;
+
+		for (const MQSpawnArrayItem& item : spawns)
+		{
+			SPAWNINFO* pSpawn = item.GetSpawn();
+			const int cellX = GetCellCoord(pSpawn->X);
+			const int cellY = GetCellCoord(pSpawn->Y);
+
+			m_minX = std::min(m_minX, cellX);
+			m_maxX = std::max(m_maxX, cellX);
+			m_minY = std::min(m_minY, cellY);
+			m_maxY = std::max(m_maxY, cellY);
+
+			m_entries.push_back({ GetCell(cellX, cellY), pSpawn });
+		}
+
+		std::sort(m_entries.begin(), m_entries.end());
+		m_built = true;
+	}
+
+	void Reserve(size_t count)
+	{
+		m_entries.reserve(count);
+	}
+
+	bool IsBuilt() const { return m_built; }
+
+	void Add(SPAWNINFO* pSpawn)
+	{
+		if (m_built)
+			m_unindexed.push_back(pSpawn);
+	}
+
+	void Remove(SPAWNINFO* pSpawn)
+	{
+		m_entries.erase(
+			std::remove_if(m_entries.begin(), m_entries.end(),
+				[pSpawn](const Entry& entry) { return entry.pSpawn == pSpawn; }),
+			m_entries.end());
+
+		m_unindexed.erase(std::remove(m_unindexed.begin(), m_unindexed.end(), pSpawn), m_unindexed.end());
+	}
+
+	// Spawns can move after the grid was built, so every query reaches one cell further than asked.
+	void GatherRadius(float X, float Y, float Radius, std::vector<SPAWNINFO*>& spawns) const
+	{
+		const int minX = GetCellCoord(X - Radius) - 1;
+		const int maxX = GetCellCoord(X + Radius) + 1;
+		const int minY = GetCellCoord(Y - Radius) - 1;
+		const int maxY = GetCellCoord(Y + Radius) + 1;
+
+		for (int cellY = minY; cellY <= maxY; ++cellY)
+			GatherRow(cellY, minX, maxX, spawns);
+
+		spawns.insert(spawns.end(), m_unindexed.begin(), m_unindexed.end());
+	}
+
+	bool GatherRing(float X, float Y, int Ring, std::vector<SPAWNINFO*>& spawns) const
+	{
+		// reaches one cell further than asked like GatherRadius, so ring 0 is the 3x3 block around X,Y
+		const int centerX = GetCellCoord(X);
+		const int centerY = GetCellCoord(Y);
+		const int reach = Ring + 1;
+
+		if (Ring == 0)
+		{
+			for (int cellY = centerY - 1; cellY <= centerY + 1; ++cellY)
+				GatherRow(cellY, centerX - 1, centerX + 1, spawns);
+
+			spawns.insert(spawns.end(), m_unindexed.begin(), m_unindexed.end());
+		}
+		else
+		{
+			GatherRow(centerY - reach, centerX - reach, centerX + reach, spawns);
+			GatherRow(centerY + reach, centerX - reach, centerX + reach, spawns);
+
+			for (int cellY = centerY - reach + 1; cellY < centerY + reach; ++cellY)
+			{
+				GatherRow(cellY, centerX - reach, centerX - reach, spawns);
+				GatherRow(cellY, centerX + reach, centerX + reach, spawns);
+			}
+		}
+
+		// once the ring covers the whole grid, there is nothing left to find after it
+		return !(centerX - reach <= m_minX && centerX + reach >= m_maxX
+			&& centerY - reach <= m_minY && centerY + reach >= m_maxY);
+	}
+};
+
+static MQSpawnGrid s_spawnGrid;
+
+bool GetSpawnsInRadius(float X, float Y, float Radius, std::vector<SPAWNINFO*>& spawns)
+{
+	EnsureMQ2SpawnSort();
+
+	if (!s_spawnGrid.IsBuilt())
+		return false;
+
+	s_spawnGrid.GatherRadius(X, Y, Radius, spawns);
+	return true;
+}
+
+bool GetSpawnsInRing(float X, float Y, int Ring, std::vector<SPAWNINFO*>& spawns)
+{
+	EnsureMQ2SpawnSort();
+
+	return s_spawnGrid.IsBuilt() && s_spawnGrid.GatherRing(X, Y, Ring, spawns);
+}
+
+bool IsSpawnGridBuilt()
+{
+	EnsureMQ2SpawnSort();
+
+	return s_spawnGrid.IsBuilt();
+}
+
+#pragma endregion
+
+#pragma region Spawn Positions
+//----------------------------------------------------------------------------
+// Positions of every spawn kept as separate arrays, taken whenever gSpawnsArray is sorted. Checks
+// against the distance to every spawn go through these instead of each spawn's PlayerClient.
+//----------------------------------------------------------------------------
+
+class MQSpawnPositions
+{
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<SPAWNINFO*> m_spawns;       // nullptr once removed
+	std::vector<uint8_t> m_types;
+	bool m_built = false;
+
+public:
+	void Clear()
+	{
+		m_x.clear();
+		m_y.clear();
+		m_z.clear();
+		m_spawns.clear();
+		m_types.clear();
+		m_built = false;
+	}
+
+	void Reserve(size_t count)
+	{
+		m_x.reserve(count);
+		m_y.reserve(count);
+		m_z.reserve(count);
+		m_spawns.reserve(count);
+		m_types.reserve(count);
+	}
+
+	void Add(SPAWNINFO* pSpawn)
+	{
+		m_x.push_back(pSpawn->X);
+		m_y.push_back(pSpawn->Y);
+		m_z.push_back(pSpawn->Z);
+		m_spawns.push_back(pSpawn);
+		m_types.push_back(static_cast<uint8_t>(pSpawn->Type));
+	}
+
+	void Remove(SPAWNINFO* pSpawn)
+	{
+		// left in place so the arrays stay lined up, it is dropped at the next snapshot
+		auto iter = std::find(m_spawns.begin(), m_spawns.end(), pSpawn);
+		if (iter != m_spawns.end())
+			*iter = nullptr;
+	}
+
+	void SetBuilt() { m_built = true; }
+	bool IsBuilt() const { return m_built; }
+
+	size_t size() const { return m_spawns.size(); }
+	SPAWNINFO* GetSpawn(size_t index) const { return m_spawns[index]; }
+
+	// Squared 2D distance from X,Y to every spawn, in the order they were added.
+	void GetDistancesSquared(float X, float Y, std::vector<float>& distances) const
+	{
+		const size_t count = m_x.size();
+		distances.resize(count);
+
+		size_t i = 0;
+#if defined(MQ_SPAWNS_SSE2)
+		const __m128 originX = _mm_set1_ps(X);
+		const __m128 originY = _mm_set1_ps(Y);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 dX = _mm_sub_ps(originX, _mm_loadu_ps(&m_x[i]));
+			const __m128 dY = _mm_sub_ps(originY, _mm_loadu_ps(&m_y[i]));
+
+			_mm_storeu_ps(&distances[i], _mm_add_ps(_mm_mul_ps(dX, dX), _mm_mul_ps(dY, dY)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			distances[i] = GetDistanceSquared(X, Y, m_x[i], m_y[i]);
+		}
+	}
+
+	// Adds every player closer than Radius to X,Y,Z.
+	void GatherPlayersInRadius(float X, float Y, float Z, float Radius, std::vector<SPAWNINFO*>& spawns) const
+	{
+		const size_t count = m_x.size();
+		const float radiusSq = Radius * Radius;
+
+		auto checkSpawn = [&](size_t index)
+		{
+			if (m_types[index] == SPAWN_PLAYER && m_spawns[index] != nullptr)
+				spawns.push_back(m_spawns[index]);
+		};
+
+		size_t i = 0;
+#if defined(MQ_SPAWNS_SSE2)
+		const __m128 originX = _mm_set1_ps(X);
+		const __m128 originY = _mm_set1_ps(Y);
+		const __m128 originZ = _mm_set1_ps(Z);
+		const __m128 maxDistSq = _mm_set1_ps(radiusSq);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 dX = _mm_sub_ps(originX, _mm_loadu_ps(&m_x[i]));
+			const __m128 dY = _mm_sub_ps(originY, _mm_loadu_ps(&m_y[i]));
+			const __m128 dZ = _mm_sub_ps(originZ, _mm_loadu_ps(&m_z[i]));
+			const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX, dX), _mm_mul_ps(dY, dY)), _mm_mul_ps(dZ, dZ));
+
+			int mask = _mm_movemask_ps(_mm_cmplt_ps(distSq, maxDistSq));
+			for (size_t lane = 0; mask != 0; ++lane, mask >>= 1)
+			{
+				if (mask & 1)
+					checkSpawn(i + lane);
+			}
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			if (Get3DDistanceSquared(X, Y, Z, m_x[i], m_y[i], m_z[i]) < radiusSq)
+				checkSpawn(i);
+		}
+	}
+};
+
+static MQSpawnPositions s_spawnPositions;
+
+bool GetPlayersInRadius(float X, float Y, float Z, float Radius, std::vector<SPAWNINFO*>& spawns)
+{
+	EnsureMQ2SpawnSort();
+
+	if (!s_spawnPositions.IsBuilt())
+		return false;
+
+	s_spawnPositions.GatherPlayersInRadius(X, Y, Z, Radius, spawns);
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Line of Sight Cache
+//----------------------------------------------------------------------------
+// line of sight checks go through the collision code, so results are kept for
+// a short time, keyed by both spawns and which bucket each of them is standing in
+//----------------------------------------------------------------------------
+
+static constexpr float LOS_BUCKET_SIZE = 2.0f;
+
+struct MQLineOfSightKey
+{
+	uint32_t OriginID;
+	uint32_t SpawnID;
+	int OriginBucket[3];
+	int SpawnBucket[3];
+
+	bool operator==(const MQLineOfSightKey& other) const
+	{
+		return memcmp(this, &other, sizeof(MQLineOfSightKey)) == 0;
+	}
+};
+
+struct MQLineOfSightKeyHash
+{
+	size_t operator()(const MQLineOfSightKey& key) const noexcept
+	{
+		size_t hash = key.OriginID;
+		hash = hash * 31 + key.SpawnID;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			hash = hash * 31 + static_cast<size_t>(key.OriginBucket[i]);
+			hash = hash * 31 + static_cast<size_t>(key.SpawnBucket[i]);
+		}
+
+		return hash;
+	}
+};
+
+struct MQLineOfSightResult
+{
+	bool CanSee;
+	uint64_t Time;
+	uint32_t Frame;
+};
+
+static std::unordered_map<MQLineOfSightKey, MQLineOfSightResult, MQLineOfSightKeyHash> s_lineOfSightCache;
+static uint32_t s_lineOfSightFrame = 0;
+static uint32_t gLineOfSightCacheTime = 100; // ms
+
+static void SetLineOfSightBucket(int (&bucket)[3], const PlayerClient* pSpawn)
+{
+	bucket[0] = static_cast<int>(std::floor(pSpawn->X / LOS_BUCKET_SIZE));
+	bucket[1] = static_cast<int>(std::floor(pSpawn->Y / LOS_BUCKET_SIZE));
+	bucket[2] = static_cast<int>(std::floor(pSpawn->Z / LOS_BUCKET_SIZE));
+}
+
+bool CanSeeSpawn(PlayerClient* pOrigin, PlayerClient* pSpawn)
+{
+	if (!pOrigin || !pSpawn)
+		return false;
+
+	MQLineOfSightKey key = { pOrigin->SpawnID, pSpawn->SpawnID };
+	SetLineOfSightBucket(key.OriginBucket, pOrigin);
+	SetLineOfSightBucket(key.SpawnBucket, pSpawn);
+
+	const uint64_t now = MQGetTickCount64();
+
+	auto iter = s_lineOfSightCache.find(key);
+	if (iter != s_lineOfSightCache.end()
+		&& (iter->second.Frame == s_lineOfSightFrame || now - iter->second.Time <= gLineOfSightCacheTime))
+	{
+		return iter->second.CanSee;
+	}
+
+	const bool canSee = pOrigin->CanSee(*pSpawn);
+	s_lineOfSightCache.insert_or_assign(key, MQLineOfSightResult{ canSee, now, s_lineOfSightFrame });
+	return canSee;
+}
+
+static void PruneLineOfSightCache()
+{
+	++s_lineOfSightFrame;
+
+	if (s_lineOfSightCache.empty())
+		return;
+
+	const uint64_t now = MQGetTickCount64();
+
+	for (auto iter = s_lineOfSightCache.begin(); iter != s_lineOfSightCache.end();)
+	{
+		if (now - iter->second.Time > gLineOfSightCacheTime)
+			iter = s_lineOfSightCache.erase(iter);
+		else
+			++iter;
+	}
+}
+
+#pragma endregion
+
 
 #pragma region Caption Colors
 //----------------------------------------------------------------------------
@@ -55,6 +487,19 @@ static bool gMQCaptions = true;
 
 static constexpr int CAPTION_UPDATE_FRAMES = 20; // number of frames between caption updates
 
+// Evaluating a caption template is by far the most expensive part of a caption pass. The state
+// that the stock templates read is kept with each spawn's caption, and the template is only
+// evaluated again when that state changes. Custom templates can read anything at all, so every
+// caption is also evaluated again every few seconds regardless.
+static constexpr uint64_t CAPTION_REFRESH_MS = 5000;
+
+struct MQCaptionCacheEntry
+{
+	std::string state;
+	uint64_t refreshTime = 0;
+};
+static std::unordered_map<SPAWNINFO*, MQCaptionCacheEntry> s_captionCache;
+
 static char gszSpawnPlayerName[8][MAX_STRING] = {
 	/* 0 */ "",
 	/* 1 */ "${If[${NamingSpawn.Mark},${NamingSpawn.Mark} - ,]}${If[${NamingSpawn.Trader},Trader ,]}${If[${NamingSpawn.Invis},(${NamingSpawn.DisplayName}),${NamingSpawn.DisplayName}]}${If[${NamingSpawn.AFK}, AFK,]}${If[${NamingSpawn.Linkdead}, LD,]}${If[${NamingSpawn.LFG}, LFG,]}${If[${NamingSpawn.GroupLeader}, LDR,]}",
@@ -248,6 +693,7 @@ static void CaptionCmd(SPAWNINFO* pChar, char* szLine)
 		ConvertCR(gszSpawnCorpseName, MAX_STRING);
 		ConvertCR(gszSpawnPetName, MAX_STRING);
 		ConvertCR(gszSpawnMercName, MAX_STRING);
+		s_captionCache.clear();
 
 		WriteChatf("Updated Captions from INI.");
 		return;
@@ -266,6 +712,7 @@ static void CaptionCmd(SPAWNINFO* pChar, char* szLine)
 	strcpy_s(pCaption, MAX_STRING, GetNextArg(szLine));
 	WritePrivateProfileString("Captions", Arg1, pCaption, mq::internal_paths::MQini);
 	ConvertCR(pCaption, MAX_STRING);
+	s_captionCache.clear();
 	WriteChatf("\ay%s\ax caption set.", Arg1);
 }
 
@@ -391,12 +838,11 @@ public:
 	DETOUR_TRAMPOLINE_DEF(void, DestroyAllPlayers_Trampoline, ())
 		void DestroyAllPlayers_Detour()
 	{
-		SPAWNINFO* pSpawn = FirstSpawn;
-		while (pSpawn)
-		{
-			PluginsRemoveSpawn(pSpawn);
-			pSpawn = pSpawn->pNext;
-		}
+		std::vector<SPAWNINFO*> spawns;
+		for (SPAWNINFO* pSpawn = FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+			spawns.push_back(pSpawn);
+
+		PluginsRemoveSpawns(spawns.data(), spawns.size());
 
 		return DestroyAllPlayers_Trampoline();
 	}
@@ -553,10 +999,67 @@ static void SetNameSpriteTint(SPAWNINFO* pSpawn)
 		pSpawn->GetActor()->SetStringSpriteTint((RGB*)&NewColor);
 }
 
+template <typename T>
+static void AppendCaptionState(std::string& state, const T& value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	state.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendCaptionState(std::string& state, const char* value)
+{
+	state.append(value);
+	state.push_back('\0');
+}
+
+static void GetCaptionState(SPAWNINFO* pSpawn, const char* CaptionString, std::string& state)
+{
+	state.clear();
+
+	AppendCaptionState(state, static_cast<const void*>(CaptionString));
+	AppendCaptionState(state, IsAnonymized());
+	AppendCaptionState(state, pSpawn->GetActor());
+	AppendCaptionState(state, GetNPCMarkNumber(pSpawn));
+	AppendCaptionState(state, IsAssistNPC(pSpawn));
+	AppendCaptionState(state, pSpawn->HPMax == 0 ? 0 : pSpawn->HPCurrent * 100 / pSpawn->HPMax);
+	AppendCaptionState(state, pSpawn->MasterID);
+	AppendCaptionState(state, pSpawn->MasterID ? GetSpawnByID(pSpawn->MasterID) : nullptr);
+	AppendCaptionState(state, pSpawn->HideMode);
+	AppendCaptionState(state, pSpawn->Trader);
+	AppendCaptionState(state, pSpawn->AFK);
+	AppendCaptionState(state, pSpawn->LFG);
+	AppendCaptionState(state, pSpawn->Linkdead);
+	AppendCaptionState(state, pSpawn->AARank);
+	AppendCaptionState(state, pSpawn->GuildID);
+	AppendCaptionState(state, pSpawn->Type == SPAWN_PLAYER && pLocalPC && pLocalPC->Group && pLocalPC->Group->GetGroupLeader()
+		&& !_stricmp(pLocalPC->Group->GetGroupLeader()->GetName(), pSpawn->Name));
+	AppendCaptionState(state, pSpawn->DisplayedName);
+	AppendCaptionState(state, pSpawn->Lastname);
+	AppendCaptionState(state, pSpawn->Suffix);
+	AppendCaptionState(state, pSpawn->Title);
+}
+
+static void ForgetCaption(SPAWNINFO* pSpawn)
+{
+	s_captionCache.erase(pSpawn);
+}
+
 static bool SetCaption(SPAWNINFO* pSpawn, const char* CaptionString)
 {
 	if (CaptionString[0])
 	{
+		static std::string state;
+		GetCaptionState(pSpawn, CaptionString, state);
+
+		const uint64_t now = MQGetTickCount64();
+		MQCaptionCacheEntry& entry = s_captionCache[pSpawn];
+		if (entry.state == state && now < entry.refreshTime)
+			return true;
+
+		// spread the forced refreshes out so they don't all land on the same pass
+		entry.state = state;
+		entry.refreshTime = now + CAPTION_REFRESH_MS + (pSpawn->SpawnID % 16) * (CAPTION_REFRESH_MS / 16);
+
 		pNamingSpawn = pSpawn;
 
 		std::string str = ModifyMacroString(CaptionString);
@@ -582,6 +1085,7 @@ bool SetNameSpriteState(SPAWNINFO* pSpawn, bool Show)
 	//DebugSpew("SetNameSpriteState(%s) --race %d body %d)",pSpawn->Name,pSpawn->Race,GetBodyType(pSpawn));
 	if (!Show || !gMQCaptions)
 	{
+		ForgetCaption(pSpawn);
 		return reinterpret_cast<PlayerClientHook*>(pSpawn)->SetNameSpriteState_Trampoline(Show) != 0;
 	}
 
@@ -599,7 +1103,10 @@ bool SetNameSpriteState(SPAWNINFO* pSpawn, bool Show)
 
 	case PC:
 		if (!pEverQuestInfo->gOpt.pcNames && pSpawn != pTarget)
+		{
+			ForgetCaption(pSpawn);
 			return false;
+		}
 		if (SetCaption(pSpawn, gszSpawnPlayerName[IsAnonymized() ? 1 : pEverQuestInfo->iShowNamesLevel]))
 			return true;
 		break;
@@ -630,6 +1137,7 @@ bool SetNameSpriteState(SPAWNINFO* pSpawn, bool Show)
 		break;
 	}
 
+	ForgetCaption(pSpawn);
 	return reinterpret_cast<PlayerClientHook*>(pSpawn)->SetNameSpriteState_Trampoline(Show) != 0;
 }
 
@@ -638,6 +1146,8 @@ static void UpdateSpawnCaptions()
 	if (!gMQCaptions)
 		return;
 
+	EnsureMQ2SpawnSort();
+
 	int count = 0;
 	for (const MQSpawnArrayItem& item : gSpawnsArray)
 	{
@@ -702,6 +1212,7 @@ static void LoadCaptionSettings()
 	ConvertCR(gszSpawnCorpseName, MAX_STRING);
 	ConvertCR(gszSpawnPetName, MAX_STRING);
 	ConvertCR(gszSpawnMercName, MAX_STRING);
+	s_captionCache.clear();
 }
 
 #pragma endregion
@@ -721,6 +1232,8 @@ static void AddGroundItem()
 	{
 		std::scoped_lock lock(s_groundsMutex);
 
+		AddGroundSpawnToIndex(pGroundItem);
+
 		MQGroundPending* pPending = new MQGroundPending;
 		pPending->pGroundItem = pGroundItem;
 		pPending->pNext = pPendingGrounds;
@@ -734,6 +1247,7 @@ static void AddGroundItem()
 static void RemoveGroundItem(EQGroundItem* pGroundItem)
 {
 	InvalidateObservedEQObject(pGroundItem);
+	RemoveGroundSpawnFromIndex(pGroundItem);
 
 	if (pPendingGrounds)
 	{
@@ -825,13 +1339,120 @@ static void ProcessPendingGroundItems()
 
 #pragma endregion
 
+// Spawns barely move between pulses, so gSpawnsArray is kept and re-sorted in place. It is only
+// rebuilt from the spawn manager when it hasn't been yet (startup, zoning) and every so often as a
+// failsafe. Spawns that come and go in between are tracked through SpawnAdded/SpawnRemoved.
+static constexpr int SPAWN_SORT_REBUILD_PULSES = 300;   // number of pulses between full rebuilds
+static constexpr size_t SPAWN_SORT_MAX_SHIFTS = 8;      // per spawn, before falling back to a full sort
+
+static bool s_spawnSortValid = false;
+static bool s_spawnSortDirty = true;
+static int s_spawnSortPulses = 0;
+static std::vector<SPAWNINFO*> s_pendingSortSpawns;
+
+// Fills gSpawnsArray from s_spawnPositions, keeping the order they were added in.
+static void RankSpawnPositions(float myX, float myY)
+{
+	static std::vector<float> distances;
+	s_spawnPositions.GetDistancesSquared(myX, myY, distances);
+
+	gSpawnsArray.clear();
+	for (size_t i = 0; i < s_spawnPositions.size(); ++i)
+	{
+		gSpawnsArray.emplace_back(s_spawnPositions.GetSpawn(i), distances[i]);
+	}
+
+	s_spawnPositions.SetBuilt();
+}
+
+static void RebuildMQ2SpawnSort(float myX, float myY)
+{
+	s_spawnPositions.Clear();
+	s_pendingSortSpawns.clear();
+
+	SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn;
+	while (pSpawn)
+	{
+		s_spawnPositions.Add(pSpawn);
+		pSpawn = pSpawn->pNext;
+	}
+
+	RankSpawnPositions(myX, myY);
+
+	std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+
+	s_spawnSortValid = true;
+	s_spawnSortPulses = 0;
+}
+
+static void ResortMQ2SpawnSort(float myX, float myY)
+{
+	// taken in the last sorted order so the insertion sort below has little to do
+	s_spawnPositions.Clear();
+	s_spawnPositions.Reserve(gSpawnsArray.size() + s_pendingSortSpawns.size());
+
+	for (const MQSpawnArrayItem& item : gSpawnsArray)
+	{
+		s_spawnPositions.Add(item.GetSpawn());
+	}
+
+	for (SPAWNINFO* pSpawn : s_pendingSortSpawns)
+	{
+		s_spawnPositions.Add(pSpawn);
+	}
+	s_pendingSortSpawns.clear();
+
+	RankSpawnPositions(myX, myY);
+
+	// Insertion sort is close to free when the order barely changed. If the player moved far
+	// enough to shuffle a lot of it, give up and sort the whole thing.
+	size_t shifts = 0;
+	const size_t maxShifts = gSpawnsArray.size() * SPAWN_SORT_MAX_SHIFTS;
+
+	for (size_t i = 1; i < gSpawnsArray.size(); ++i)
+	{
+		if (!MQRankFloatCompare(gSpawnsArray[i], gSpawnsArray[i - 1]))
+			continue;
+
+		MQSpawnArrayItem item = gSpawnsArray[i];
+		size_t j = i;
+		for (; j > 0 && MQRankFloatCompare(item, gSpawnsArray[j - 1]); --j)
+		{
+			gSpawnsArray[j] = gSpawnsArray[j - 1];
+		}
+		gSpawnsArray[j] = item;
+
+		shifts += i - j;
+		if (shifts > maxShifts)
+		{
+			std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+			break;
+		}
+	}
+}
+
+// Called every pulse. Sorting is left to the first thing that reads the sorted spawns in the
+// pulse, unless LazySpawnSort is turned off for plugins that read EQP_DistArray directly.
 void UpdateMQ2SpawnSort()
 {
+	s_spawnSortDirty = true;
+	InvalidateSpawnSearchCache();
+
+	if (!gbLazySpawnSort)
+		EnsureMQ2SpawnSort();
+}
+
+void EnsureMQ2SpawnSort()
+{
+	if (!s_spawnSortDirty)
+		return;
+
+	s_spawnSortDirty = false;
+
 	EnterMQ2Benchmark(bmUpdateSpawnSort);
 
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
-	gSpawnsArray.clear();
 
 	float myX = 0, myY = 0;
 	if (pControlledPlayer)
@@ -843,17 +1464,21 @@ void UpdateMQ2SpawnSort()
 	// we need to make sure the spawn manager is valid here because this can get called from login pulse before the spawn manager is valid
 	if (pSpawnManager)
 	{
-		SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn;
-		while (pSpawn)
-		{
-			float distSq = GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y);
+		if (!s_spawnSortValid || ++s_spawnSortPulses >= SPAWN_SORT_REBUILD_PULSES)
+			RebuildMQ2SpawnSort(myX, myY);
+		else
+			ResortMQ2SpawnSort(myX, myY);
 
-			gSpawnsArray.emplace_back(pSpawn, distSq);
-			pSpawn = pSpawn->pNext;
-		}
+		s_spawnGrid.Build(gSpawnsArray);
+	}
+	else
+	{
+		gSpawnsArray.clear();
+		s_pendingSortSpawns.clear();
+		s_spawnSortValid = false;
+		s_spawnGrid.Clear();
+		s_spawnPositions.Clear();
 	}
-
-	std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
 
 	gSpawnCount = static_cast<int>(gSpawnsArray.size());
 	EQP_DistArray = gSpawnCount > 0 ? &gSpawnsArray[0] : nullptr;
@@ -892,11 +1517,19 @@ static void Spawns_Initialize()
 	// Load Settings
 	LoadCaptionSettings();
 
+	gLineOfSightCacheTime = GetPrivateProfileInt("MacroQuest", "LineOfSightCacheTime", gLineOfSightCacheTime, mq::internal_paths::MQini);
+	if (gbWriteAllConfig)
+	{
+		WritePrivateProfileInt("MacroQuest", "LineOfSightCacheTime", gLineOfSightCacheTime, mq::internal_paths::MQini);
+	}
+
 	ProcessPending = true;
 
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
 	gSpawnsArray.reserve(4096);
+	s_spawnGrid.Reserve(4096);
+	s_spawnPositions.Reserve(4096);
 
 	char Temp[MAX_STRING] = { 0 };
 	char Name[MAX_STRING] = { 0 };
@@ -979,6 +1612,11 @@ static void Spawns_Shutdown()
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
 	gSpawnsArray.clear();
+	s_pendingSortSpawns.clear();
+	s_spawnSortValid = false;
+	s_spawnGrid.Clear();
+	s_spawnPositions.Clear();
+	s_lineOfSightCache.clear();
 
 	RemoveMQ2Benchmark(bmUpdateSpawnSort);
 	RemoveMQ2Benchmark(bmUpdateSpawnCaptions);
@@ -989,6 +1627,8 @@ static void Spawns_Pulse()
 	if (gGameState != GAMESTATE_INGAME)
 		return;
 
+	PruneLineOfSightCache();
+
 	// update captions
 	static unsigned long nCaptions = 100;
 	static unsigned long LastTarget = 0;
@@ -1028,10 +1668,40 @@ static void Spawns_Pulse()
 static void Spawns_BeginZone()
 {
 	gSpawnsArray.clear();
+	s_pendingSortSpawns.clear();
+	s_spawnSortValid = false;
+	s_spawnSortDirty = true;
+	s_spawnGrid.Clear();
+	s_spawnPositions.Clear();
+	s_lineOfSightCache.clear();
+	s_captionCache.clear();
+	InvalidateSpawnSearchCache();
+
+	EQP_DistArray = nullptr;
+	gSpawnCount = 0;
+}
+
+static void Spawns_SpawnAdded(SPAWNINFO* pSpawn)
+{
+	s_spawnGrid.Add(pSpawn);
+	InvalidateSpawnSearchCache();
+
+	if (s_spawnPositions.IsBuilt())
+		s_spawnPositions.Add(pSpawn);
+
+	if (s_spawnSortValid)
+		s_pendingSortSpawns.push_back(pSpawn);
 }
 
 static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn)
 {
+	s_spawnGrid.Remove(pSpawn);
+	s_spawnPositions.Remove(pSpawn);
+	s_captionCache.erase(pSpawn);
+	InvalidateSpawnSearchCache();
+	s_pendingSortSpawns.erase(std::remove(std::begin(s_pendingSortSpawns), std::end(s_pendingSortSpawns), pSpawn),
+		std::end(s_pendingSortSpawns));
+
 	if (gSpawnsArray.empty())
 		return;
 
@@ -1039,6 +1709,10 @@ static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn)
 		std::remove_if(std::begin(gSpawnsArray), std::end(gSpawnsArray),
 			[pSpawn](const MQSpawnArrayItem& item) { return item.GetSpawn() == pSpawn; }),
 		std::end(gSpawnsArray));
+
+	// the sort may not run again for a while, keep the exported view in step
+	gSpawnCount = static_cast<int>(gSpawnsArray.size());
+	EQP_DistArray = gSpawnCount > 0 ? &gSpawnsArray[0] : nullptr;
 }
 
 } // namespace mq
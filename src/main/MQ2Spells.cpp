@@ -17,12 +17,22 @@
 #include "MQ2SpellSearch.h"
 #include "mq/base/SimpleLexer.h"
 
+#include <future>
+#include <thread>
+
 namespace mq {
 
-ci_unordered::multimap<std::string_view, EQ_Spell*> s_spellNameMap;
-std::map<int, int> s_triggeredSpells;
 std::recursive_mutex s_initializeSpellsMutex;
 
+// The spell GetSpellFromMap picked for each name it has been asked for. Which spell is picked
+// depends on the class and level of the character, so these are dropped when either changes.
+static ci_unordered::map<std::string_view, EQ_Spell*> s_spellNameCache;
+static int s_spellNameCacheClass = -1;
+static int s_spellNameCacheLevel = -1;
+
+// Bumped whenever the spell maps are rebuilt, so caches holding spell pointers know to refresh.
+static std::atomic<int> s_spellMapGeneration = 0;
+
 static const ci_unordered::map<std::string_view, eEQSPELLCAT> s_spellCatLookup = {
 { "Aegolism"            , SPELLCAT_AEGOLISM },
 { "Agility"             , SPELLCAT_AGILITY },
@@ -746,25 +756,161 @@ static MQModule gSpellsModule = {
 MQModule* GetSpellsModule() { return &gSpellsModule; }
 
 
-EQ_Spell* GetHighestLearnedSpellByGroupID(int dwSpellGroupID)
+//----------------------------------------------------------------------------
+// Spell book and gem index
+//
+// Casting loops ask about the book and the gem bar by name many times a second. The book
+// has over a thousand slots, so rather than walking it for every question we index it,
+// along with the gems, and only rebuild when either changes (scribing, memorizing,
+// leveling up). That is checked at most once per pulse.
+
+struct SpellBookIndex
 {
-	PcProfile* pProfile = GetPcProfile();
-	if (!pProfile) return nullptr;
+	PcProfile* profile = nullptr;
+	int generation = -1;
+	uint32_t pulse = 0;
+
+	int book[NUM_BOOK_SLOTS] = { 0 };
+	int gems[NUM_SPELL_GEMS] = { 0 };
+
+	std::unordered_map<int, int> bookSlotBySpellID;
+	ci_unordered::map<std::string_view, int> bookSlotByName;
+	std::unordered_map<int, std::vector<EQ_Spell*>> bookSpellsByGroup; // in book order
+	std::unordered_map<int, EQ_Spell*> highestRankByGroup;
+	ci_unordered::map<std::string_view, int> gemByName;
+};
+static SpellBookIndex s_spellBookIndex;
 
-	EQ_Spell* result = nullptr;
+static void RebuildSpellBookIndex(SpellBookIndex& index)
+{
+	index.bookSlotBySpellID.clear();
+	index.bookSlotByName.clear();
+	index.bookSpellsByGroup.clear();
+	index.highestRankByGroup.clear();
+	index.gemByName.clear();
 
-	for (int nSpell : pProfile->SpellBook)
+	for (int nSlot = 0; nSlot < NUM_BOOK_SLOTS; ++nSlot)
 	{
-		auto pFoundSpell = GetSpellByID(nSpell);
-		if (!pFoundSpell || pFoundSpell->SpellGroup != dwSpellGroupID)
+		EQ_Spell* pSpell = index.book[nSlot] != -1 ? GetSpellByID(index.book[nSlot]) : nullptr;
+		if (!pSpell)
 			continue;
 
-		// Find the highest rank of the spell that matches this spell group
-		if (!result || result->SpellRank < pFoundSpell->SpellRank)
-			result = pFoundSpell;
+		// first slot wins, as it did when searching the book in order
+		index.bookSlotBySpellID.emplace(index.book[nSlot], nSlot);
+		index.bookSlotByName.emplace(pSpell->Name, nSlot);
+		index.bookSpellsByGroup[pSpell->SpellGroup].push_back(pSpell);
+
+		EQ_Spell*& pHighest = index.highestRankByGroup[pSpell->SpellGroup];
+		if (!pHighest || pHighest->SpellRank < pSpell->SpellRank)
+			pHighest = pSpell;
 	}
 
-	return result;
+	for (int nGem = 0; nGem < NUM_SPELL_GEMS; ++nGem)
+	{
+		if (EQ_Spell* pSpell = GetSpellByID(index.gems[nGem]))
+			index.gemByName.emplace(pSpell->Name, nGem);
+	}
+}
+
+static SpellBookIndex* GetSpellBookIndex()
+{
+	PcProfile* pProfile = GetPcProfile();
+	if (!pProfile)
+		return nullptr;
+
+	SpellBookIndex& index = s_spellBookIndex;
+	int generation = s_spellMapGeneration;
+
+	if (index.profile == pProfile && index.generation == generation && index.pulse == gPulseCount)
+		return &index;
+
+	bool changed = index.profile != pProfile || index.generation != generation;
+	index.profile = pProfile;
+	index.generation = generation;
+	index.pulse = gPulseCount;
+
+	if (!std::equal(std::begin(index.book), std::end(index.book), std::begin(pProfile->SpellBook)))
+	{
+		std::copy(std::begin(pProfile->SpellBook), std::end(pProfile->SpellBook), std::begin(index.book));
+		changed = true;
+	}
+
+	for (int nGem = 0; nGem < NUM_SPELL_GEMS; ++nGem)
+	{
+		int spellID = GetMemorizedSpell(nGem);
+		if (index.gems[nGem] != spellID)
+		{
+			index.gems[nGem] = spellID;
+			changed = true;
+		}
+	}
+
+	if (changed)
+		RebuildSpellBookIndex(index);
+
+	return &index;
+}
+
+int GetSpellBookSlot(int spellID)
+{
+	if (SpellBookIndex* index = GetSpellBookIndex())
+	{
+		auto iter = index->bookSlotBySpellID.find(spellID);
+		if (iter != index->bookSlotBySpellID.end())
+			return iter->second;
+	}
+
+	return -1;
+}
+
+int GetSpellBookSlotByName(std::string_view name)
+{
+	if (SpellBookIndex* index = GetSpellBookIndex())
+	{
+		auto iter = index->bookSlotByName.find(name);
+		if (iter != index->bookSlotByName.end())
+			return iter->second;
+	}
+
+	return -1;
+}
+
+const std::vector<EQ_Spell*>& GetSpellBookSpellsByGroupID(int spellGroupID)
+{
+	static const std::vector<EQ_Spell*> empty;
+
+	if (SpellBookIndex* index = GetSpellBookIndex())
+	{
+		auto iter = index->bookSpellsByGroup.find(spellGroupID);
+		if (iter != index->bookSpellsByGroup.end())
+			return iter->second;
+	}
+
+	return empty;
+}
+
+int GetMemorizedSpellGem(std::string_view name)
+{
+	if (SpellBookIndex* index = GetSpellBookIndex())
+	{
+		auto iter = index->gemByName.find(name);
+		if (iter != index->gemByName.end())
+			return iter->second;
+	}
+
+	return -1;
+}
+
+EQ_Spell* GetHighestLearnedSpellByGroupID(int dwSpellGroupID)
+{
+	if (SpellBookIndex* index = GetSpellBookIndex())
+	{
+		auto iter = index->highestRankByGroup.find(dwSpellGroupID);
+		if (iter != index->highestRankByGroup.end())
+			return iter->second;
+	}
+
+	return nullptr;
 }
 
 static const char* GetSpellNameBySpellGroupID(int dwSpellGroupID)
@@ -822,7 +968,265 @@ static bool IsRecursiveEffect(int spa)
 	return false;
 }
 
-static void PopulateTriggeredMap(EQ_Spell* pSpell)
+//----------------------------------------------------------------------------
+// Spell index
+//
+// Spells are found by name, and by the spell that triggers them, through an index that only
+// holds name hashes and spell ids. That makes it the same in every client that loaded the same
+// spell file, so the first client to build one shares it through a named file mapping, and the
+// clients after it map that instead of building their own.
+
+static constexpr uint32_t SPELL_INDEX_MAGIC = 0x4953514d; // "MQSI"
+static constexpr uint32_t SPELL_INDEX_VERSION = 1;
+static constexpr const char* SPELL_INDEX_MAPPING_FORMAT = "Local\\MQ2SpellIndex_{:016x}";
+
+struct SpellIndexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t numNames;
+	uint32_t numTriggers;
+	volatile LONG complete;  // set last by the client that fills in a shared index
+};
+
+// Sorted by hash, spells with the same hash in spell order
+struct SpellIndexName
+{
+	uint32_t hash;
+	int32_t spellID;
+};
+
+// Sorted by triggered spell, only the last spell that triggers it is kept
+struct SpellIndexTrigger
+{
+	int32_t triggeredID;
+	int32_t parentID;
+};
+
+static uint32_t HashSpellName(std::string_view name)
+{
+	uint32_t hash = 2166136261U;
+	for (char c : name)
+	{
+		hash ^= static_cast<uint32_t>(::tolower(static_cast<unsigned char>(c)));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+// Identifies the spell data that an index is built from. Zero if it can't be told apart, in which
+// case the index isn't shared.
+static uint64_t GetSpellIndexKey(size_t spellCount)
+{
+	std::error_code ec;
+	const std::filesystem::path spellFile = std::filesystem::path(internal_paths::EverQuest) / "spells_us.txt";
+
+	const uintmax_t size = std::filesystem::file_size(spellFile, ec);
+	if (ec)
+		return 0;
+
+	const auto modified = std::filesystem::last_write_time(spellFile, ec);
+	if (ec)
+		return 0;
+
+	uint64_t key = 14695981039346656037ULL;
+	auto mix = [&key](uint64_t value)
+		{
+			for (int i = 0; i < 8; ++i)
+			{
+				key ^= (value >> (i * 8)) & 0xff;
+				key *= 1099511628211ULL;
+			}
+		};
+
+	mix(SPELL_INDEX_VERSION);
+	mix(size);
+	mix(static_cast<uint64_t>(modified.time_since_epoch().count()));
+	mix(spellCount);
+	return key;
+}
+
+class SpellIndex
+{
+public:
+	// An index that only this client uses
+	explicit SpellIndex(std::vector<uint8_t>&& data)
+		: m_data(std::move(data))
+	{
+		Attach(m_data.data());
+	}
+
+	// An index in a mapped view, which this takes ownership of
+	SpellIndex(HANDLE mapping, const void* view)
+		: m_mapping(mapping)
+		, m_view(view)
+	{
+		Attach(static_cast<const uint8_t*>(view));
+	}
+
+	~SpellIndex()
+	{
+		if (m_view)
+			::UnmapViewOfFile(m_view);
+
+		if (m_mapping)
+			::CloseHandle(m_mapping);
+	}
+
+	SpellIndex(const SpellIndex&) = delete;
+	SpellIndex& operator=(const SpellIndex&) = delete;
+
+	static std::vector<uint8_t> Build(uint64_t key, const std::vector<SpellIndexName>& names,
+		const std::vector<SpellIndexTrigger>& triggers)
+	{
+		std::vector<uint8_t> data(sizeof(SpellIndexHeader)
+			+ names.size() * sizeof(SpellIndexName)
+			+ triggers.size() * sizeof(SpellIndexTrigger));
+
+		SpellIndexHeader* header = reinterpret_cast<SpellIndexHeader*>(data.data());
+		header->magic = SPELL_INDEX_MAGIC;
+		header->version = SPELL_INDEX_VERSION;
+		header->key = key;
+		header->numNames = static_cast<uint32_t>(names.size());
+		header->numTriggers = static_cast<uint32_t>(triggers.size());
+		header->complete = 0;
+
+		uint8_t* next = data.data() + sizeof(SpellIndexHeader);
+		if (!names.empty())
+			memcpy(next, names.data(), names.size() * sizeof(SpellIndexName));
+
+		next += names.size() * sizeof(SpellIndexName);
+		if (!triggers.empty())
+			memcpy(next, triggers.data(), triggers.size() * sizeof(SpellIndexTrigger));
+
+		return data;
+	}
+
+	// Maps the index that another client shared for the same spell data, if there is a finished one.
+	static std::shared_ptr<const SpellIndex> OpenShared(uint64_t key)
+	{
+		if (key == 0)
+			return nullptr;
+
+		HANDLE mapping = ::OpenFileMappingA(FILE_MAP_READ, FALSE, fmt::format(SPELL_INDEX_MAPPING_FORMAT, key).c_str());
+		if (!mapping)
+			return nullptr;
+
+		const void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			::CloseHandle(mapping);
+			return nullptr;
+		}
+
+		MEMORY_BASIC_INFORMATION mbi;
+		const size_t viewSize = ::VirtualQuery(view, &mbi, sizeof(mbi)) ? mbi.RegionSize : 0;
+
+		// the client that created it may still be filling it in, build our own rather than wait
+		auto index = std::make_shared<const SpellIndex>(mapping, view);
+		const SpellIndexHeader* header = index->m_header;
+		if (viewSize < sizeof(SpellIndexHeader)
+			|| header->complete == 0
+			|| header->magic != SPELL_INDEX_MAGIC
+			|| header->version != SPELL_INDEX_VERSION
+			|| header->key != key
+			|| viewSize < index->GetSize())
+		{
+			return nullptr;
+		}
+
+		return index;
+	}
+
+	// Shares a newly built index with the clients that come after this one, unless another client
+	// got there first. The index is used either way.
+	static std::shared_ptr<const SpellIndex> Share(uint64_t key, std::vector<uint8_t>&& data)
+	{
+		if (key != 0)
+		{
+			HANDLE mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+				static_cast<DWORD>(data.size()), fmt::format(SPELL_INDEX_MAPPING_FORMAT, key).c_str());
+
+			if (mapping && ::GetLastError() != ERROR_ALREADY_EXISTS)
+			{
+				if (void* view = ::MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0))
+				{
+					memcpy(view, data.data(), data.size());
+					::InterlockedExchange(&static_cast<SpellIndexHeader*>(view)->complete, 1);
+
+					return std::make_shared<const SpellIndex>(mapping, view);
+				}
+			}
+
+			if (mapping)
+				::CloseHandle(mapping);
+		}
+
+		return std::make_shared<const SpellIndex>(std::move(data));
+	}
+
+	// Calls func with the id of every spell whose name has the same hash as name, in spell order.
+	// The names still have to be compared, since different names can hash the same.
+	template <typename Func>
+	void ForEachSpellNamed(std::string_view name, Func&& func) const
+	{
+		const uint32_t hash = HashSpellName(name);
+		const SpellIndexName* last = m_names + m_header->numNames;
+
+		auto iter = std::lower_bound(m_names, last, hash,
+			[](const SpellIndexName& entry, uint32_t value) { return entry.hash < value; });
+
+		for (; iter != last && iter->hash == hash; ++iter)
+			func(iter->spellID);
+	}
+
+	// The spell that triggers the given spell, or -1 if none does.
+	int GetParent(int triggeredID) const
+	{
+		const SpellIndexTrigger* last = m_triggers + m_header->numTriggers;
+
+		auto iter = std::lower_bound(m_triggers, last, triggeredID,
+			[](const SpellIndexTrigger& entry, int value) { return entry.triggeredID < value; });
+
+		return iter != last && iter->triggeredID == triggeredID ? iter->parentID : -1;
+	}
+
+private:
+	void Attach(const uint8_t* data)
+	{
+		m_header = reinterpret_cast<const SpellIndexHeader*>(data);
+		m_names = reinterpret_cast<const SpellIndexName*>(data + sizeof(SpellIndexHeader));
+		m_triggers = reinterpret_cast<const SpellIndexTrigger*>(m_names + m_header->numNames);
+	}
+
+	size_t GetSize() const
+	{
+		return sizeof(SpellIndexHeader)
+			+ m_header->numNames * sizeof(SpellIndexName)
+			+ m_header->numTriggers * sizeof(SpellIndexTrigger);
+	}
+
+	std::vector<uint8_t> m_data;
+	HANDLE m_mapping = nullptr;
+	const void* m_view = nullptr;
+
+	const SpellIndexHeader* m_header = nullptr;
+	const SpellIndexName* m_names = nullptr;
+	const SpellIndexTrigger* m_triggers = nullptr;
+};
+
+static std::shared_ptr<const SpellIndex> s_spellIndex;
+
+// The part of the spell index built from one range of spells, merged once every range is done.
+struct SpellIndexPartition
+{
+	std::vector<SpellIndexName> names;
+	std::vector<SpellIndexTrigger> triggered;
+};
+
+static void PopulateTriggeredMap(EQ_Spell* pSpell, SpellIndexPartition& partition)
 {
 	if (!pSpell || pSpell->CannotBeScribed)
 		return;
@@ -834,38 +1238,106 @@ static void PopulateTriggeredMap(EQ_Spell* pSpell)
 
 		int triggeredSpellID = (int)GetSpellBase2(pSpell, i);
 		if (i > 0)
-			s_triggeredSpells[triggeredSpellID] = pSpell->ID;
+			partition.triggered.push_back({ triggeredSpellID, pSpell->ID });
 	}
 }
 
+static SpellIndexPartition IndexSpells(EQ_Spell* const* first, EQ_Spell* const* last)
+{
+	SpellIndexPartition partition;
+	partition.names.reserve(last - first);
+
+	for (auto iter = first; iter != last; ++iter)
+	{
+		EQ_Spell* pSpell = *iter;
+		if (!pSpell || !pSpell->Name[0])
+			continue;
+
+		PopulateTriggeredMap(pSpell, partition);
+
+		partition.names.push_back({ HashSpellName(pSpell->Name), pSpell->ID });
+	}
+
+	return partition;
+}
+
 EQ_Spell* GetSpellParent(int id)
 {
-	auto iter = s_triggeredSpells.find(id);
-	if (iter != s_triggeredSpells.end())
-		return GetSpellByID(iter->second);
+	std::scoped_lock lock(s_initializeSpellsMutex);
+
+	int parentID = s_spellIndex ? s_spellIndex->GetParent(id) : -1;
+	if (parentID >= 0)
+		return GetSpellByID(parentID);
 
 	return nullptr;
 }
 
-void PopulateSpellMap()
+// Indexes the spells in ranges on a few threads, without the lock, so lookups carry on against
+// the old index until the new one is swapped in.
+static std::vector<uint8_t> BuildSpellIndex(uint64_t key, EQ_Spell* const* first, size_t count)
 {
-	std::scoped_lock lock(s_initializeSpellsMutex);
+	const size_t numThreads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 4);
+	const size_t rangeSize = (count + numThreads - 1) / numThreads;
 
-	gbSpelldbLoaded = false;
+	std::vector<std::future<SpellIndexPartition>> pending;
+	for (size_t start = 0; start < count; start += rangeSize)
+	{
+		pending.push_back(std::async(std::launch::async, IndexSpells,
+			first + start, first + std::min(start + rangeSize, count)));
+	}
 
-	s_triggeredSpells.clear();
-	s_spellNameMap.clear();
+	// merged in spell order so duplicate names and triggers come out the same as a single pass
+	std::vector<SpellIndexName> names;
+	std::vector<SpellIndexTrigger> triggered;
+	names.reserve(count);
 
-	for (auto pSpell : pSpellMgr->Spells)
+	for (auto& future : pending)
 	{
-		if (!pSpell || !pSpell->Name[0])
-			continue;
+		SpellIndexPartition partition = future.get();
+		names.insert(names.end(), partition.names.begin(), partition.names.end());
+		triggered.insert(triggered.end(), partition.triggered.begin(), partition.triggered.end());
+	}
 
-		PopulateTriggeredMap(pSpell);
+	std::stable_sort(names.begin(), names.end(),
+		[](const SpellIndexName& a, const SpellIndexName& b) { return a.hash < b.hash; });
 
-		s_spellNameMap.emplace(pSpell->Name, pSpell);
+	std::stable_sort(triggered.begin(), triggered.end(),
+		[](const SpellIndexTrigger& a, const SpellIndexTrigger& b) { return a.triggeredID < b.triggeredID; });
+
+	// the last spell to trigger a spell is the one that counts
+	std::vector<SpellIndexTrigger> triggers;
+	for (const SpellIndexTrigger& trigger : triggered)
+	{
+		if (!triggers.empty() && triggers.back().triggeredID == trigger.triggeredID)
+			triggers.back() = trigger;
+		else
+			triggers.push_back(trigger);
 	}
 
+	return SpellIndex::Build(key, names, triggers);
+}
+
+void PopulateSpellMap()
+{
+	if (!pSpellMgr)
+		return;
+
+	EQ_Spell* const* first = &*std::begin(pSpellMgr->Spells);
+	const size_t count = std::size(pSpellMgr->Spells);
+
+	// another client may have already indexed the same spells
+	const uint64_t key = GetSpellIndexKey(count);
+	std::shared_ptr<const SpellIndex> index = SpellIndex::OpenShared(key);
+	if (!index)
+		index = SpellIndex::Share(key, BuildSpellIndex(key, first, count));
+
+	std::scoped_lock lock(s_initializeSpellsMutex);
+
+	s_spellIndex = std::move(index);
+	s_spellNameCache.clear();
+	++s_spellMapGeneration;
+	InvalidateSpellStackingCache();
+
 	gbSpelldbLoaded = true;
 }
 
@@ -906,28 +1378,19 @@ bool IsSpellClassUsable(EQ_Spell* pSpell)
 	return false;
 }
 
-static EQ_Spell* GetSpellFromMap(std::string_view name)
+template <typename Iterator>
+static EQ_Spell* PickSpellFromRange(PcProfile* profile, Iterator first, Iterator last)
 {
-	auto profile = GetPcProfile();
-	if (!profile)
-		return nullptr;
-
-	auto range = s_spellNameMap.equal_range(name);
-
-	// no hits
-	if (range.first == range.second)
-		return nullptr;
-
 	// If there is only a single hit by name, just return that spell.
-	if (std::distance(range.first, range.second) == 1)
-		return range.first->second;
+	if (std::next(first) == last)
+		return first->second;
 
 	// Find the preferred spell for this class.
 	if (IsPlayerClass(profile->Class))
 	{
 		EQ_Spell* classUsableSpell = nullptr;
 
-		for (auto iter = range.first; iter != range.second; ++iter)
+		for (auto iter = first; iter != last; ++iter)
 		{
 			EQ_Spell* testSpell = iter->second;
 			if (profile->Level >= testSpell->ClassLevel[profile->Class])
@@ -956,7 +1419,7 @@ static EQ_Spell* GetSpellFromMap(std::string_view name)
 	// we will have to roll through it again and see if its usable by any other class
 
 	EQ_Spell* usableSpell = nullptr;
-	for (auto iter = range.first; iter != range.second; ++iter)
+	for (auto iter = first; iter != last; ++iter)
 	{
 		EQ_Spell* testSpell = iter->second;
 		if (IsSpellClassUsable(testSpell))
@@ -975,7 +1438,63 @@ static EQ_Spell* GetSpellFromMap(std::string_view name)
 		return usableSpell;
 
 	// couldn't find a good match, return the first spell that came back.
-	return range.first->second;
+	return first->second;
+}
+
+static EQ_Spell* GetSpellFromMap(std::string_view name)
+{
+	auto profile = GetPcProfile();
+	if (!profile)
+		return nullptr;
+
+	if (s_spellNameCacheClass != profile->Class || s_spellNameCacheLevel != profile->Level)
+	{
+		s_spellNameCache.clear();
+		s_spellNameCacheClass = profile->Class;
+		s_spellNameCacheLevel = profile->Level;
+	}
+
+	auto cached = s_spellNameCache.find(name);
+	if (cached != s_spellNameCache.end())
+		return cached->second;
+
+	std::vector<std::pair<std::string_view, EQ_Spell*>> matches;
+	s_spellIndex->ForEachSpellNamed(name, [&](int spellID)
+		{
+			EQ_Spell* pSpell = GetSpellByID(spellID);
+			if (pSpell && ci_equals(pSpell->Name, name))
+				matches.emplace_back(pSpell->Name, pSpell);
+		});
+
+	// no hits
+	if (matches.empty())
+		return nullptr;
+
+	// keyed by the name of the spell, which lives as long as the spells do
+	EQ_Spell* pSpell = PickSpellFromRange(profile, matches.begin(), matches.end());
+	s_spellNameCache.emplace(matches.front().first, pSpell);
+
+	return pSpell;
+}
+
+// Used until the spell index has been built, instead of waiting for it.
+static EQ_Spell* FindSpellInManager(std::string_view name)
+{
+	auto profile = GetPcProfile();
+	if (!profile || !pSpellMgr)
+		return nullptr;
+
+	std::vector<std::pair<std::string_view, EQ_Spell*>> matches;
+	for (auto pSpell : pSpellMgr->Spells)
+	{
+		if (pSpell && pSpell->Name[0] && ci_equals(pSpell->Name, name))
+			matches.emplace_back(pSpell->Name, pSpell);
+	}
+
+	if (matches.empty())
+		return nullptr;
+
+	return PickSpellFromRange(profile, matches.begin(), matches.end());
 }
 
 EQ_Spell* GetSpellByName(std::string_view name)
@@ -992,18 +1511,14 @@ EQ_Spell* GetSpellByName(std::string_view name)
 	if (spellID >= 0)
 		return GetSpellByID(spellID);
 
+	// The index is built in the background once in game, don't hold up the caller for it.
 	if (gbSpelldbLoaded == false)
 	{
-		InitializeMQ2SpellDb(nullptr);
-
-		if (gbSpelldbLoaded == false)
-		{
-			return nullptr;
-		}
+		return FindSpellInManager(name);
 	}
 
 	std::scoped_lock lock(s_initializeSpellsMutex);
-	if (s_spellNameMap.empty())
+	if (!s_spellIndex)
 		return nullptr;
 
 	EnterMQ2Benchmark(bmSpellAccess);
@@ -4056,12 +4571,121 @@ void TruncateSpellRankName(char* SpellName)
 	}
 }
 
+// Buff maintenance macros check the same few buffs by name every pass. Rather than fetching
+// the spell in every slot and comparing names each time, the spell ids in the slots are
+// compared against the last lookup and only when they change are the names re-indexed.
+// Answers are remembered per query until then.
+struct BuffNameIndex
+{
+	struct Result
+	{
+		int minSlot;
+		int maxSlot;
+		int slot;
+	};
+
+	PcProfile* profile = nullptr;
+	int generation = -1;
+	int spellIds[MAX_TOTAL_BUFFS] = { 0 };
+	const char* names[MAX_TOTAL_BUFFS] = { nullptr };
+	ci_unordered::map<std::string_view, std::vector<int>> slotsByName;
+	ci_unordered::map<std::string, std::vector<Result>> results;
+};
+static BuffNameIndex s_buffNameIndex;
+
+static void UpdateBuffNameIndex(PcProfile* pProfile)
+{
+	BuffNameIndex& index = s_buffNameIndex;
+	int generation = s_spellMapGeneration;
+	bool changed = index.profile != pProfile || index.generation != generation;
+
+	for (int i = 0; i < MAX_TOTAL_BUFFS; ++i)
+	{
+		int spellId = pProfile->GetEffect(i).SpellID;
+		if (index.spellIds[i] != spellId)
+		{
+			index.spellIds[i] = spellId;
+			changed = true;
+		}
+	}
+
+	if (!changed)
+		return;
+
+	index.profile = pProfile;
+	index.generation = generation;
+	index.slotsByName.clear();
+	index.results.clear();
+
+	for (int i = 0; i < MAX_TOTAL_BUFFS; ++i)
+	{
+		EQ_Spell* pSpell = index.spellIds[i] > 0 ? GetSpellByID(index.spellIds[i]) : nullptr;
+		index.names[i] = pSpell ? pSpell->Name : nullptr;
+
+		if (pSpell)
+			index.slotsByName[pSpell->Name].push_back(i);
+	}
+}
+
 int FindBuffIndex(std::string_view Name, int minSlot, int maxSlot)
 {
 	if (Name.empty())
 		return -1;
 
-	return GetSelfBuff([&Name](EQ_Spell* spell) { return MaybeExactCompare(spell->Name, Name); }, minSlot, maxSlot);
+	PcProfile* pProfile = GetPcProfile();
+	if (!pProfile)
+		return -1;
+
+	if (minSlot < 0)
+		minSlot = 0;
+	if (maxSlot < 0 || maxSlot > MAX_TOTAL_BUFFS)
+		maxSlot = MAX_TOTAL_BUFFS;
+
+	UpdateBuffNameIndex(pProfile);
+	BuffNameIndex& index = s_buffNameIndex;
+
+	// queries are usually the same few names, but don't let odd ones pile up
+	if (index.results.size() >= 256)
+		index.results.clear();
+
+	std::vector<BuffNameIndex::Result>& results = index.results[std::string(Name)];
+	for (const BuffNameIndex::Result& result : results)
+	{
+		if (result.minSlot == minSlot && result.maxSlot == maxSlot)
+			return result.slot;
+	}
+
+	int slot = -1;
+
+	if (Name[0] == '=')
+	{
+		auto iter = index.slotsByName.find(Name.substr(1));
+		if (iter != index.slotsByName.end())
+		{
+			for (int i : iter->second)
+			{
+				if (i >= minSlot && i < maxSlot)
+				{
+					slot = i;
+					break;
+				}
+			}
+		}
+	}
+	else
+	{
+		for (int i = minSlot; i < maxSlot; ++i)
+		{
+			if (index.names[i] && ci_find_substr(index.names[i], Name) != -1)
+			{
+				slot = i;
+				break;
+			}
+		}
+	}
+
+	results.push_back({ minSlot, maxSlot, slot });
+	return slot;
 }
 
 bool RemoveBuffByName(std::string_view buffName)
@@ -0,0 +1,232 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+
+namespace mq {
+
+static void Tasks_Shutdown();
+static void Tasks_Pulse();
+
+static MQModule s_tasksModule = {
+	"Tasks",                       // Name
+	false,                         // CanUnload
+	nullptr,
+	Tasks_Shutdown,
+	Tasks_Pulse,
+};
+DECLARE_MODULE_INITIALIZER(s_tasksModule);
+
+// A task slot as of the last pulse.
+struct TaskSlotState
+{
+	int taskID = 0;
+	int counts[MAX_TASK_ELEMENTS] = { 0 };
+
+	// the client builds an objective's description every time it is asked for one, so they are
+	// kept until the task in the slot or the objective's count changes.
+	std::string descriptions[MAX_TASK_ELEMENTS];
+	bool described[MAX_TASK_ELEMENTS] = { false };
+};
+
+struct TaskStates
+{
+	PcClient* character = nullptr;
+	TaskSlotState shared[MAX_SHARED_TASK_ENTRIES];
+	TaskSlotState quests[MAX_QUEST_ENTRIES];
+};
+static TaskStates s_taskStates;
+
+static Signal<const MQTaskObjectiveChange&> s_taskObjectiveChangedSignal;
+
+Signal<const MQTaskObjectiveChange&>& GetTaskObjectiveChangedSignal()
+{
+	return s_taskObjectiveChangedSignal;
+}
+
+// Index of the item that ptr points at in a fixed size array, or -1 if it doesn't point at one.
+template <typename T>
+static int FindArrayIndex(const T& items, const void* ptr)
+{
+	constexpr size_t itemSize = sizeof(items[0]);
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+	uintptr_t first = reinterpret_cast<uintptr_t>(&items[0]);
+
+	if (address < first || address >= first + itemSize * std::size(items) || (address - first) % itemSize != 0)
+		return -1;
+
+	return static_cast<int>((address - first) / itemSize);
+}
+
+int FindTaskIndex(CTaskEntry* task)
+{
+	if (!task || !pTaskManager)
+		return -1;
+
+	switch (task->TaskSystem)
+	{
+	case TaskSystemType::cTaskSystemTypeSharedQuest:
+		return FindArrayIndex(pTaskManager->SharedTaskEntries, task);
+
+	case TaskSystemType::cTaskSystemTypeSoloQuest:
+		return FindArrayIndex(pTaskManager->QuestEntries, task);
+
+	default:
+		return -1;
+	}
+}
+
+// Finds the entry of entries that objective is one of the objectives of.
+template <typename T>
+static bool FindEntryObjective(const T& entries, const CTaskElement* objective, int& taskIndex, int& objectiveIndex)
+{
+	constexpr size_t entrySize = sizeof(entries[0]);
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(objective);
+	uintptr_t first = reinterpret_cast<uintptr_t>(&entries[0]);
+
+	if (address < first || address >= first + entrySize * std::size(entries))
+		return false;
+
+	taskIndex = static_cast<int>((address - first) / entrySize);
+	objectiveIndex = FindArrayIndex(entries[taskIndex].Elements, objective);
+
+	return objectiveIndex >= 0 && entries[taskIndex].TaskID;
+}
+
+TaskObjectiveIndex FindObjectiveIndex(CTaskElement* objective)
+{
+	if (!pTaskManager || !objective)
+		return { -1, -1, TaskSystemType::cTaskSystemTypeTask };
+
+	int taskIndex = -1;
+	int objectiveIndex = -1;
+
+	if (FindEntryObjective(pTaskManager->SharedTaskEntries, objective, taskIndex, objectiveIndex))
+		return { taskIndex, objectiveIndex, TaskSystemType::cTaskSystemTypeSharedQuest };
+
+	if (FindEntryObjective(pTaskManager->QuestEntries, objective, taskIndex, objectiveIndex))
+		return { taskIndex, objectiveIndex, TaskSystemType::cTaskSystemTypeSoloQuest };
+
+	return { -1, -1, TaskSystemType::cTaskSystemTypeTask };
+}
+
+const std::string& GetTaskObjectiveDescription(CTaskElement* objective)
+{
+	static std::string s_uncached;
+
+	if (!pTaskManager || !objective)
+	{
+		s_uncached.clear();
+		return s_uncached;
+	}
+
+	TaskObjectiveIndex idx = FindObjectiveIndex(objective);
+	if (idx.taskIndex >= 0 && s_taskStates.character == pLocalPC)
+	{
+		CTaskEntry& entry = idx.systemType == TaskSystemType::cTaskSystemTypeSharedQuest
+			? pTaskManager->SharedTaskEntries[idx.taskIndex] : pTaskManager->QuestEntries[idx.taskIndex];
+		TaskSlotState& state = idx.systemType == TaskSystemType::cTaskSystemTypeSharedQuest
+			? s_taskStates.shared[idx.taskIndex] : s_taskStates.quests[idx.taskIndex];
+
+		// a task that arrived since the last pulse isn't in the slot yet
+		if (state.taskID == entry.TaskID)
+		{
+			if (!state.described[idx.objectiveIndex])
+			{
+				char szOut[MAX_STRING] = { 0 };
+				pTaskManager->GetElementDescription(objective, szOut);
+
+				state.descriptions[idx.objectiveIndex] = szOut;
+				state.described[idx.objectiveIndex] = true;
+			}
+
+			return state.descriptions[idx.objectiveIndex];
+		}
+	}
+
+	char szOut[MAX_STRING] = { 0 };
+	pTaskManager->GetElementDescription(objective, szOut);
+
+	s_uncached = szOut;
+	return s_uncached;
+}
+
+static void UpdateTaskSlot(TaskSlotState& state, CTaskEntry& entry, int index)
+{
+	if (!entry.TaskID)
+	{
+		if (state.taskID)
+			state = TaskSlotState();
+		return;
+	}
+
+	auto taskStatus = pTaskManager->GetTaskStatus(pLocalPC, index, entry.TaskSystem);
+	if (!taskStatus)
+		return;
+
+	// a task that was just added, replaced another in this slot, or belongs to a character that was
+	// just switched to, starts out with nothing changed
+	if (state.taskID != entry.TaskID)
+	{
+		state = TaskSlotState();
+		state.taskID = entry.TaskID;
+		std::copy_n(std::begin(taskStatus->CurrentCounts), MAX_TASK_ELEMENTS, std::begin(state.counts));
+		return;
+	}
+
+	for (int i = 0; i < MAX_TASK_ELEMENTS; ++i)
+	{
+		if (taskStatus->CurrentCounts[i] == state.counts[i])
+			continue;
+
+		MQTaskObjectiveChange change;
+		change.Task = &entry;
+		change.Objective = i;
+		change.PreviousCount = state.counts[i];
+		change.CurrentCount = taskStatus->CurrentCounts[i];
+
+		state.counts[i] = change.CurrentCount;
+		state.described[i] = false;
+
+		s_taskObjectiveChangedSignal(change);
+	}
+}
+
+static void Tasks_Pulse()
+{
+	if (gGameState != GAMESTATE_INGAME || !pLocalPC || !pTaskManager)
+		return;
+
+	if (s_taskStates.character != pLocalPC)
+	{
+		s_taskStates = TaskStates();
+		s_taskStates.character = pLocalPC;
+	}
+
+	for (int i = 0; i < MAX_SHARED_TASK_ENTRIES; ++i)
+		UpdateTaskSlot(s_taskStates.shared[i], pTaskManager->SharedTaskEntries[i], i);
+
+	for (int i = 0; i < MAX_QUEST_ENTRIES; ++i)
+		UpdateTaskSlot(s_taskStates.quests[i], pTaskManager->QuestEntries[i], i);
+}
+
+static void Tasks_Shutdown()
+{
+	s_taskStates = TaskStates();
+}
+
+} // namespace mq
@@ -39,27 +39,19 @@ namespace mq {
 // Description: Outputs text to debugger, usage is same as printf ;)
 //***************************************************************************
 
-static void LogToFile(const char* szOutput)
+static void LogToFile(std::string_view szOutput)
 {
-	FILE* fOut = nullptr;
-
 	const std::filesystem::path pathDebugSpew = std::filesystem::path(mq::internal_paths::Logs) / "DebugSpew.log";
-	fOut = _fsopen(pathDebugSpew.string().c_str(), "at", _SH_DENYWR);
-
-	if (!fOut)
-		return;
+	std::string line;
 
 #ifdef DBG_CHARNAME
-	char Name[256] = "Unknown";
-	if (pLocalPC)
-	{
-		strcpy_s(Name, pLocalPC->Name);
-	}
-	fprintf(fOut, "%s - ", Name);
+	line.append(pLocalPC ? pLocalPC->Name : "Unknown");
+	line.append(" - ");
 #endif
 
-	fprintf(fOut, "%s\r\n", szOutput);
-	fclose(fOut);
+	line.append(szOutput);
+	line.append("\r\n");
+	AppendToLogFile(pathDebugSpew, std::move(line));
 }
 
 static void DebugSpewImpl(bool always, bool logToFile, const char* szFormat, va_list vaList)
@@ -67,22 +59,38 @@ static void DebugSpewImpl(bool always, bool logToFile, const char* szFormat, va_
 	if (!always && gFilterDebug)
 		return;
 
-	// _vscprintf doesn't count // terminating '\0'
-	int len = _vscprintf(szFormat, vaList) + 1;
-	size_t theLen = len + 32;
+	// Most lines fit on the stack. Longer ones are formatted again once we know their length.
+	char szBuffer[MAX_STRING];
 
-	auto out = std::make_unique<char[]>(theLen);
-	char* szOutput = out.get();
+	va_list vaCopy;
+	va_copy(vaCopy, vaList);
+	const int len = vsnprintf(szBuffer, sizeof(szBuffer), szFormat, vaCopy);
+	va_end(vaCopy);
+
+	if (len < 0)
+		return;
 
-	vsprintf_s(szOutput, theLen, szFormat, vaList);
+	std::string output;
+	if (len < static_cast<int>(sizeof(szBuffer)))
+	{
+		output.reserve(len + 1);
+		output.assign(szBuffer, len);
+	}
+	else
+	{
+		output.resize(len);
+		vsnprintf(output.data(), len + 1, szFormat, vaList);
+	}
 
-	strcat_s(szOutput, theLen, "\n");
-	OutputDebugString(szOutput);
+	output.push_back('\n');
 
 	if (logToFile)
 	{
-		LogToFile(szOutput);
+		LogToFile(output);
 	}
+
+	// Written by the log writer thread, so a debugger or DebugView doesn't stall the caller.
+	OutputDebugSpew(std::move(output));
 }
 
 // Outputs to debug console when gFilterDebug is false.  Does not output to file. (/filter debug or FilterDebug=0 in ini)
@@ -125,6 +133,7 @@ MQLIB_API void DebugSpewNoFile(const char* szFormat, ...)
 
 // Implemented in MQ2PluginHandler.cpp
 void PluginsWriteChatColor(const char* Line, int Color, int Filter);
+void PluginsWriteChatColorLines(const std::vector<std::string>& Lines, int Color, int Filter);
 
 static void WriteChatColorMaybeDeferred(std::unique_ptr<char[]> Ptr, int Color, int Filter)
 {
@@ -166,6 +175,21 @@ void WriteChatColor(const char* Line, int Color /* = USERCOLOR_DEFAULT */, int F
 	});
 }
 
+void WriteChatColorLines(const std::vector<std::string>& Lines, int Color /* = USERCOLOR_DEFAULT */, int Filter /* = 0 */)
+{
+	if (IsMainThread())
+	{
+		PluginsWriteChatColorLines(Lines, Color, Filter);
+		return;
+	}
+
+	PostToMainThread(
+		[Lines, Color, Filter]()
+	{
+		PluginsWriteChatColorLines(Lines, Color, Filter);
+	});
+}
+
 void WriteChatf(const char* szFormat, ...)
 {
 	va_list vaList;
@@ -509,12 +533,87 @@ char* GetEQPath(char* szBuffer, size_t len)
 	return szBuffer;
 }
 
+// Length of the run at the start of text that the chat converters below can copy as it is. For
+// StripMQChat that is anything up to a color code, newline or '\0'. For MQToSTML it also stops at
+// characters that need escaping and at a space followed by another space (those become &NBSP;).
+// Most chat lines are mostly plain text, so this checks 16 bytes at a time.
+static size_t GetPlainChatRun(const char* text, size_t length, bool forSTML)
+{
+	auto isSpecial = [forSTML](char ch)
+	{
+		if (ch == '\a' || ch == '\n' || ch == '\0')
+			return true;
+
+		return forSTML && (ch == '&' || ch == '%' || ch == '<' || ch == '>' || ch == '"');
+	};
+
+	size_t pos = 0;
+
+#if defined(MQ_STRING_SSE2)
+	const __m128i bell = _mm_set1_epi8('\a');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i percent = _mm_set1_epi8('%');
+	const __m128i lt = _mm_set1_epi8('<');
+	const __m128i gt = _mm_set1_epi8('>');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i space = _mm_set1_epi8(' ');
+
+	// the double space check reads one byte past the block
+	for (; pos + 17 <= length; pos += 16)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+
+		__m128i special = _mm_or_si128(_mm_or_si128(
+			_mm_cmpeq_epi8(block, bell), _mm_cmpeq_epi8(block, newline)), _mm_cmpeq_epi8(block, zero));
+
+		if (forSTML)
+		{
+			const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos + 1));
+
+			special = _mm_or_si128(special, _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, amp), _mm_cmpeq_epi8(block, percent)),
+				_mm_or_si128(_mm_cmpeq_epi8(block, lt), _mm_cmpeq_epi8(block, gt))));
+			special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+				_mm_and_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(next, space))));
+		}
+
+		if (const unsigned int mask = _mm_movemask_epi8(special))
+		{
+			unsigned long bit = 0;
+			_BitScanForward(&bit, mask);
+			return pos + bit;
+		}
+	}
+#endif
+
+	for (; pos < length; ++pos)
+	{
+		if (isSpecial(text[pos])
+			|| (forSTML && text[pos] == ' ' && pos + 1 < length && text[pos + 1] == ' '))
+		{
+			return pos;
+		}
+	}
+
+	return length;
+}
+
 void StripMQChat(std::string_view in, char* out)
 {
 	size_t i = 0;
 	int o = 0;
 	while (i < in.size() && in[i])
 	{
+		if (const size_t run = GetPlainChatRun(in.data() + i, in.size() - i, false))
+		{
+			memcpy(out + o, in.data() + i, run);
+			o += static_cast<int>(run);
+			i += run;
+			continue;
+		}
+
 		if (in[i] == '\a')
 		{
 			i++;
@@ -580,8 +679,27 @@ DWORD MQToSTML(const char* in, char* out, size_t maxlen, uint32_t ColorOverride)
 
 	pchar_out_string_position += InsertColorSafe(&out[pchar_out_string_position], outlen - pchar_out_string_position, CurrentColor);
 
+	const size_t inlen = strlen(in);
+
 	while (in[pchar_in_string_position] != 0 && pchar_out_string_position < maxlen)
 	{
+		// Copy plain text a run at a time. A run never starts with a space, as that might
+		// need to become &NBSP;, and never has two spaces in a row.
+		if (in[pchar_in_string_position] != ' ' && pchar_in_string_position < inlen)
+		{
+			size_t run = GetPlainChatRun(in + pchar_in_string_position, inlen - pchar_in_string_position, true);
+			run = std::min(run, maxlen - pchar_out_string_position);
+
+			if (run > 0)
+			{
+				memcpy(&out[pchar_out_string_position], in + pchar_in_string_position, run);
+				pchar_out_string_position += run;
+				pchar_in_string_position += run;
+				bNBSpace = in[pchar_in_string_position - 1] == ' ';
+				continue;
+			}
+		}
+
 		if (in[pchar_in_string_position] == ' ')
 		{
 			if (bNBSpace)
@@ -832,7 +950,8 @@ DWORD MQToSTML(const char* in, char* out, size_t maxlen, uint32_t ColorOverride)
 #undef InsertStopColorSafe
 }
 
-static bool ItemFitsInSlot(ItemClient* pCont, std::string_view search)
+// The worn slots an item search's slot text picks, as a mask to test EquipSlots against.
+static uint32_t GetItemSlotSearchMask(std::string_view search)
 {
 	// map some commonly used synonyms
 	struct Mapping {
@@ -856,26 +975,25 @@ static bool ItemFitsInSlot(ItemClient* pCont, std::string_view search)
 		}
 	}
 
-	int cmp = GetItemFromContents(pCont)->EquipSlots;
+	uint32_t mask = 0;
 
 	for (int i = 0; i < NUM_WORN_ITEMS; ++i)
 	{
-		if (cmp & (1 << i))
+		if (ci_find_substr(szItemSlot[i], search))
 		{
-			if (ci_find_substr(szItemSlot[i], search))
-			{
-				return true;
-			}
+			mask |= 1 << i;
 		}
 	}
 
-	return false;
+	return mask;
 }
 
-int ItemHasStat(ItemClient* pCont, std::string_view search)
+using ItemStatAccessor = std::function<int(ItemDefinition*)>;
+
+static const ItemStatAccessor* FindItemStatAccessor(std::string_view search)
 {
 	// map stat names to accessors
-	static const std::map<std::string, std::function<int(ItemDefinition*)>, ci_less> mapping = {
+	static const std::map<std::string, ItemStatAccessor, ci_less> mapping = {
 		{
 			"armor class",
 			[](ItemDefinition* pi) { return pi->AC; }
@@ -1031,70 +1149,70 @@ int ItemHasStat(ItemClient* pCont, std::string_view search)
 	};
 
 	auto iter = mapping.find(search);
-	if (iter != mapping.end())
+	return iter != mapping.end() ? &iter->second : nullptr;
+}
+
+int ItemHasStat(ItemClient* pCont, std::string_view search)
+{
+	if (const ItemStatAccessor* accessor = FindItemStatAccessor(search))
 	{
 		ItemDefinition* pItem = GetItemFromContents(pCont);
 		if (pItem)
 		{
-			return iter->second(pItem);
+			return (*accessor)(pItem);
 		}
 	}
 
 	return 0;
 }
 
-static bool ItemHasRace(ItemClient* pCont, std::string_view search)
+// The race bits an item search's race text picks, as a mask to test Races against.
+static uint32_t GetItemRaceSearchMask(std::string_view search)
 {
 	// FIXME: This code is duplicated in a multiple of places.
-	int cmp = GetItemFromContents(pCont)->Races;
+	uint32_t mask = 0;
 	for (int num = 0; num < NUM_RACES; num++)
 	{
-		if (cmp & (1 << num))
+		int tmp = num + 1;
+		switch (num)
 		{
-			int tmp = num + 1;
-			switch (num)
-			{
-			case 12:
-				tmp = 128;   // IKS
-				break;
-			case 13:
-				tmp = 130;   // VAH
-				break;
-			case 14:
-				tmp = 330;   // FRG
-				break;
-			case 15:
-				tmp = 522;   // DRK
-				break;
-			}
+		case 12:
+			tmp = 128;   // IKS
+			break;
+		case 13:
+			tmp = 130;   // VAH
+			break;
+		case 14:
+			tmp = 330;   // FRG
+			break;
+		case 15:
+			tmp = 522;   // DRK
+			break;
+		}
 
-			if (ci_equals(pEverQuest->GetRaceDesc(tmp), search))
-			{
-				return true;
-			}
+		if (ci_equals(pEverQuest->GetRaceDesc(tmp), search))
+		{
+			mask |= 1 << num;
 		}
 	}
 
-	return false;
+	return mask;
 }
 
-static bool ItemHasClass(ItemClient* pCont, std::string_view search)
+// The class bits an item search's class text picks, as a mask to test Classes against.
+static uint32_t GetItemClassSearchMask(std::string_view search)
 {
 	// FIXME: This code is duplicated in a multiple of places.
-	int cmp = GetItemFromContents(pCont)->Classes;
+	uint32_t mask = 0;
 	for (int num = 0; num < TotalPlayerClasses; num++)
 	{
-		if (cmp & (1 << num))
+		if (ci_equals(pEverQuest->GetClassDesc(num), search))
 		{
-
-			if (ci_equals(pEverQuest->GetClassDesc(num), search))
-			{
-				return true;
-			}
+			mask |= 1 << num;
 		}
 	}
 
-	return false;
+	return mask;
 }
 
 const char* GetFilenameFromFullPath(const char* Filename)
@@ -1120,12 +1238,138 @@ bool CompareTimes(char* RealTime, char* ExpectedTime)
 	return false;
 }
 
+// The filters compiled into a trie of their lowercased prefixes, so that a line is walked once no
+// matter how many filters there are. Whether each filter is enabled is checked when it matches, so
+// toggling them doesn't need a rebuild. Filters that start with '*' match anywhere in the line and
+// are checked one at a time.
+class MQFilterMatcher
+{
+public:
+	void Invalidate() { m_valid = false; }
+
+	bool Matches(const char* szLine)
+	{
+		if (!m_valid)
+			Build();
+
+		int node = 0;
+		for (const char* p = szLine; ; ++p)
+		{
+			if (AnyEnabled(m_nodes[node].Filters))
+				return true;
+
+			node = FindChild(node, ToLower(*p));
+			if (node < 0)
+				break;
+
+			// a filter longer than its text also has to match the end of the line
+			if (*p == ' ')
+			{
+				if (AnyEnabled(m_nodes[node].Filters))
+					return true;
+				break;
+			}
+		}
+
+		for (MQFilter* pFilter : m_contains)
+		{
+			if (IsEnabled(pFilter) && strstr(szLine, pFilter->FilterText + 1))
+				return true;
+		}
+
+		return false;
+	}
+
+private:
+	struct Node
+	{
+		std::vector<std::pair<char, int>> Children;
+		std::vector<MQFilter*> Filters;
+	};
+
+	static char ToLower(char ch) { return static_cast<char>(tolower(static_cast<unsigned char>(ch))); }
+	static bool IsEnabled(const MQFilter* pFilter) { return !pFilter->pEnabled || *pFilter->pEnabled; }
+
+	static bool AnyEnabled(const std::vector<MQFilter*>& filters)
+	{
+		return std::any_of(filters.begin(), filters.end(), IsEnabled);
+	}
+
+	int FindChild(int node, char ch) const
+	{
+		for (const auto& [childChar, child] : m_nodes[node].Children)
+		{
+			if (childChar == ch)
+				return child;
+		}
+
+		return -1;
+	}
+
+	void Build()
+	{
+		m_nodes.clear();
+		m_nodes.emplace_back();
+		m_contains.clear();
+
+		for (MQFilter* pFilter = gpFilters; pFilter; pFilter = pFilter->pNext)
+		{
+			if (pFilter->FilterText[0] == '*')
+			{
+				m_contains.push_back(pFilter);
+				continue;
+			}
+
+			// the same characters _strnicmp would compare, including the terminator
+			const size_t length = std::min(pFilter->Length, strlen(pFilter->FilterText) + 1);
+
+			int node = 0;
+			for (size_t i = 0; i < length; ++i)
+			{
+				const char ch = ToLower(pFilter->FilterText[i]);
+				int child = FindChild(node, ch);
+
+				if (child < 0)
+				{
+					child = static_cast<int>(m_nodes.size());
+					m_nodes[node].Children.emplace_back(ch, child);
+					m_nodes.emplace_back();
+				}
+
+				node = child;
+			}
+
+			m_nodes[node].Filters.push_back(pFilter);
+		}
+
+		m_valid = true;
+	}
+
+	std::vector<Node> m_nodes;
+	std::vector<MQFilter*> m_contains;
+	bool m_valid = false;
+};
+
+static MQFilterMatcher s_filterMatcher;
+
 void AddFilter(const char* szFilter, int Length, bool& pEnabled)
 {
 	MQFilter* New = new MQFilter(szFilter, Length, pEnabled);
 
 	New->pNext = gpFilters;
 	gpFilters = New;
+
+	s_filterMatcher.Invalidate();
+}
+
+bool IsChatFiltered(const char* szLine)
+{
+	return szLine && s_filterMatcher.Matches(szLine);
+}
+
+void InvalidateChatFilters()
+{
+	s_filterMatcher.Invalidate();
 }
 
 void DefaultFilters()
@@ -1352,25 +1596,161 @@ CAltAbilityData* GetAAById(int nAbilityId, int playerLevel)
 	return pAltAdvManager->GetAAById(nAbilityId, playerLevel);
 }
 
-SPELL* GetSpellByAAName(const char* szName)
+//----------------------------------------------------------------------------
+// Alt ability lookup tables. Names are looked up at the character's level like the game does, so
+// the tables are rebuilt when the level changes. The table of abilities the character owns is
+// compared against their ability list once a pulse and rebuilt if anything was bought.
+//----------------------------------------------------------------------------
+
+struct AltAbilityTables
 {
-	int level = pLocalPlayer ? pLocalPlayer->Level : -1;
+	PcClient* pPC = nullptr;
+	int level = -2;
 
-	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
+	// every ability, by lower case name in ability order, and the first ability of each group
+	std::unordered_map<std::string, std::vector<CAltAbilityData*>> allByName;
+	std::unordered_map<int, CAltAbilityData*> allByGroup;
+
+	// owned abilities, at the character's level by name and at any level by id
+	std::vector<int> ownedIDs;
+	std::unordered_map<std::string, CAltAbilityData*> ownedByName;
+	std::unordered_map<int, CAltAbilityData*> ownedByID;
+
+	bool checkOwned = true;
+};
+static AltAbilityTables s_altAbilityTables;
+
+void InvalidateAltAbilityTables()
+{
+	s_altAbilityTables.checkOwned = true;
+}
+
+static bool UpdateAltAbilityTables()
+{
+	AltAbilityTables& tables = s_altAbilityTables;
+
+	if (!pAltAdvManager || !pLocalPC || gGameState != GAMESTATE_INGAME)
+	{
+		tables = AltAbilityTables();
+		return false;
+	}
+
+	const int level = pLocalPlayer ? pLocalPlayer->Level : -1;
+	const bool rebuildAll = tables.pPC != pLocalPC.get() || tables.level != level;
+
+	if (rebuildAll)
 	{
-		if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
+		tables.allByName.clear();
+		tables.allByGroup.clear();
+
+		for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
 		{
-			if (pAbility->SpellID != -1)
+			// the first ability of each group is looked up without a level, same as it always was
+			if (CAltAbilityData* pAbility = GetAAById(nAbility))
+				tables.allByGroup.emplace(pAbility->GroupID, pAbility);
+
+			if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
 			{
 				if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
+					tables.allByName[to_lower_copy(std::string(pName))].push_back(pAbility);
+			}
+		}
+
+		tables.level = level;
+		tables.pPC = pLocalPC.get();
+	}
+
+	if (rebuildAll || tables.checkOwned)
+	{
+		tables.checkOwned = false;
+
+		std::vector<int> ownedIDs(AA_CHAR_MAX_REAL);
+		for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
+			ownedIDs[nAbility] = pLocalPC->GetAlternateAbilityId(nAbility);
+
+		if (rebuildAll || ownedIDs != tables.ownedIDs)
+		{
+			tables.ownedByName.clear();
+			tables.ownedByID.clear();
+
+			for (int abilityID : ownedIDs)
+			{
+				if (CAltAbilityData* pAbility = GetAAById(abilityID))
+					tables.ownedByID.emplace(pAbility->ID, pAbility);
+
+				if (CAltAbilityData* pAbility = GetAAById(abilityID, level))
 				{
-					if (!_stricmp(szName, pName))
-					{
-						if (SPELL* psp = GetSpellByID(pAbility->SpellID))
-						{
-							return psp;
-						}
-					}
+					if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
+						tables.ownedByName.emplace(to_lower_copy(std::string(pName)), pAbility);
+				}
+			}
+
+			tables.ownedIDs = std::move(ownedIDs);
+		}
+	}
+
+	return true;
+}
+
+const std::vector<CAltAbilityData*>* FindAltAbilitiesByName(std::string_view name)
+{
+	if (!UpdateAltAbilityTables())
+		return nullptr;
+
+	std::string lowerName{ name };
+	to_lower(lowerName);
+
+	auto iter = s_altAbilityTables.allByName.find(lowerName);
+	return iter != s_altAbilityTables.allByName.end() ? &iter->second : nullptr;
+}
+
+CAltAbilityData* FindAltAbilityByName(std::string_view name)
+{
+	const std::vector<CAltAbilityData*>* abilities = FindAltAbilitiesByName(name);
+	return abilities ? abilities->front() : nullptr;
+}
+
+CAltAbilityData* FindAltAbilityByGroupID(int groupID)
+{
+	if (!UpdateAltAbilityTables())
+		return nullptr;
+
+	auto iter = s_altAbilityTables.allByGroup.find(groupID);
+	return iter != s_altAbilityTables.allByGroup.end() ? iter->second : nullptr;
+}
+
+CAltAbilityData* FindOwnedAltAbilityByName(std::string_view name)
+{
+	if (!UpdateAltAbilityTables())
+		return nullptr;
+
+	std::string lowerName{ name };
+	to_lower(lowerName);
+
+	auto iter = s_altAbilityTables.ownedByName.find(lowerName);
+	return iter != s_altAbilityTables.ownedByName.end() ? iter->second : nullptr;
+}
+
+CAltAbilityData* FindOwnedAltAbilityByID(int abilityID)
+{
+	if (!UpdateAltAbilityTables())
+		return nullptr;
+
+	auto iter = s_altAbilityTables.ownedByID.find(abilityID);
+	return iter != s_altAbilityTables.ownedByID.end() ? iter->second : nullptr;
+}
+
+SPELL* GetSpellByAAName(const char* szName)
+{
+	if (const std::vector<CAltAbilityData*>* abilities = FindAltAbilitiesByName(szName))
+	{
+		for (CAltAbilityData* pAbility : *abilities)
+		{
+			if (pAbility->SpellID != -1)
+			{
+				if (SPELL* psp = GetSpellByID(pAbility->SpellID))
+				{
+					return psp;
 				}
 			}
 		}
@@ -1622,41 +2002,124 @@ void ClearSearchItem(MQItemSearch& SearchItem)
 
 #define MaskSet(n) (SearchItem.FlagMask[(SearchItemFlag)n])
 #define Flag(n) (SearchItem.Flag[(SearchItemFlag)n])
-#define RequireFlag(flag,value) { if (MaskSet(flag) && Flag(flag) != (char)((value)!=0)) return false;}
 
-bool ItemMatchesSearch(MQItemSearch& SearchItem, ItemClient* pContents)
-{
-	ItemDefinition* pItem = GetItemFromContents(pContents);
+// An MQItemSearch with its text already looked up, so checking an item against it is only integer
+// comparisons. The name, slot, race and class text is resolved once per search instead of once per
+// item.
+struct CompiledItemSearch
+{
+	uint32_t id = 0;
+	uint32_t flagMask = 0;                   // bit n set if SearchItemFlag n is checked
+	uint32_t flagValues = 0;                 // bit n is the value SearchItemFlag n needs
+	const char* name = nullptr;
+	bool checkSlot = false;
+	uint32_t slotMask = 0;
+	const ItemStatAccessor* stat = nullptr;
+	bool checkStat = false;
+	bool checkRace = false;
+	uint32_t raceMask = 0;
+	bool checkClass = false;
+	uint32_t classMask = 0;
+};
 
-	if (SearchItem.ID && pItem->ItemNumber != SearchItem.ID)
-		return false;
+static constexpr SearchItemFlag s_itemSearchFlags[] = {
+	Lore, NoDrop, NoRent, Magic, Book, Pack, Combinable, Summoned, Weapon, Normal, Instrument
+};
 
-	RequireFlag(Lore, pItem->Lore);
-	RequireFlag(NoRent, pItem->NoRent);
-	RequireFlag(NoDrop, pItem->IsDroppable);
-	RequireFlag(Magic, pItem->IsMagic());
-	RequireFlag(Pack, pItem->Type == ITEMTYPE_PACK);
-	RequireFlag(Book, pItem->Type == ITEMTYPE_BOOK);
-	RequireFlag(Combinable, pItem->ItemType == 17);
-	RequireFlag(Summoned, pItem->Summoned);
-	RequireFlag(Instrument, pItem->InstrumentType);
-	RequireFlag(Weapon, pItem->Damage && pItem->Delay);
-	RequireFlag(Normal, pItem->Type == ITEMTYPE_NORMAL);
-
-	if (SearchItem.szName[0] && ci_find_substr(pItem->Name, SearchItem.szName))
-		return false;
-	if (SearchItem.szSlot[0] && !ItemFitsInSlot(pContents, SearchItem.szSlot))
-		return false;
-	if (SearchItem.szStat[0] && ItemHasStat(pContents, SearchItem.szStat) == 0)
-		return false;
-	if (SearchItem.szRace[0] && !ItemHasRace(pContents, SearchItem.szRace))
-		return false;
-	if (SearchItem.szClass[0] && !ItemHasClass(pContents, SearchItem.szClass))
-		return false;
+static CompiledItemSearch CompileItemSearch(const MQItemSearch& SearchItem)
+{
+	CompiledItemSearch compiled;
+	compiled.id = SearchItem.ID;
+
+	for (SearchItemFlag flag : s_itemSearchFlags)
+	{
+		if (MaskSet(flag))
+		{
+			compiled.flagMask |= 1 << flag;
+			if (Flag(flag))
+				compiled.flagValues |= 1 << flag;
+		}
+	}
+
+	if (SearchItem.szName[0])
+		compiled.name = SearchItem.szName;
+
+	if (SearchItem.szSlot[0])
+	{
+		compiled.checkSlot = true;
+		compiled.slotMask = GetItemSlotSearchMask(SearchItem.szSlot);
+	}
+
+	if (SearchItem.szStat[0])
+	{
+		compiled.checkStat = true;
+		compiled.stat = FindItemStatAccessor(SearchItem.szStat);
+	}
+
+	if (SearchItem.szRace[0])
+	{
+		compiled.checkRace = true;
+		compiled.raceMask = GetItemRaceSearchMask(SearchItem.szRace);
+	}
+
+	if (SearchItem.szClass[0])
+	{
+		compiled.checkClass = true;
+		compiled.classMask = GetItemClassSearchMask(SearchItem.szClass);
+	}
+
+	return compiled;
+}
+
+static uint32_t GetItemSearchFlags(ItemDefinition* pItem)
+{
+	uint32_t flags = 0;
+	auto setFlag = [&flags](SearchItemFlag flag, bool value) { if (value) flags |= 1 << flag; };
+
+	setFlag(Lore, pItem->Lore);
+	setFlag(NoRent, pItem->NoRent);
+	setFlag(NoDrop, pItem->IsDroppable);
+	setFlag(Magic, pItem->IsMagic());
+	setFlag(Pack, pItem->Type == ITEMTYPE_PACK);
+	setFlag(Book, pItem->Type == ITEMTYPE_BOOK);
+	setFlag(Combinable, pItem->ItemType == 17);
+	setFlag(Summoned, pItem->Summoned);
+	setFlag(Instrument, pItem->InstrumentType);
+	setFlag(Weapon, pItem->Damage && pItem->Delay);
+	setFlag(Normal, pItem->Type == ITEMTYPE_NORMAL);
+
+	return flags;
+}
+
+static bool ItemMatchesCompiledSearch(const CompiledItemSearch& search, ItemClient* pContents)
+{
+	ItemDefinition* pItem = GetItemFromContents(pContents);
+
+	if (search.id && pItem->ItemNumber != search.id)
+		return false;
+
+	if (search.flagMask && ((GetItemSearchFlags(pItem) ^ search.flagValues) & search.flagMask) != 0)
+		return false;
+
+	if (search.name && ci_find_substr(pItem->Name, search.name))
+		return false;
+	if (search.checkSlot && (static_cast<uint32_t>(pItem->EquipSlots) & search.slotMask) == 0)
+		return false;
+	if (search.checkStat && (!search.stat || (*search.stat)(pItem) == 0))
+		return false;
+	if (search.checkRace && (static_cast<uint32_t>(pItem->Races) & search.raceMask) == 0)
+		return false;
+	if (search.checkClass && (static_cast<uint32_t>(pItem->Classes) & search.classMask) == 0)
+		return false;
 
 	return true;
 }
 
+bool ItemMatchesSearch(MQItemSearch& SearchItem, ItemClient* pContents)
+{
+	return ItemMatchesCompiledSearch(CompileItemSearch(SearchItem), pContents);
+}
+
 bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* nResult)
 {
 	// TODO
@@ -1671,6 +2134,8 @@ bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* n
 	PcProfile* pProfile = GetPcProfile();
 	if (!pProfile) return false;
 
+	const CompiledItemSearch search = CompileItemSearch(SearchItem);
+
 	if (MaskSet(Worn) && Flag(Worn))
 	{
 		// iterate through worn items
@@ -1678,7 +2143,7 @@ bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* n
 		{
 			if (ItemClient* pContents = pProfile->GetInventorySlot(N))
 			{
-				if (ItemMatchesSearch(SearchItem, pContents))
+				if (ItemMatchesCompiledSearch(search, pContents))
 					DoResult(pContents, N);
 			}
 		}
@@ -1691,7 +2156,7 @@ bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* n
 		{
 			if (ItemClient* pContents = pProfile->GetInventorySlot(nPack))
 			{
-				if (ItemMatchesSearch(SearchItem, pContents))
+				if (ItemMatchesCompiledSearch(search, pContents))
 					DoResult(pContents, nPack + 21);
 			}
 		}
@@ -1706,7 +2171,7 @@ bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* n
 					{
 						if (ItemPtr pItem = pContents->GetHeldItems().GetItem(nItem))
 						{
-							if (ItemMatchesSearch(SearchItem, pItem.get()))
+							if (ItemMatchesCompiledSearch(search, pItem.get()))
 								DoResult(pItem.get(), nPack * 100 + nItem);
 						}
 					}
@@ -1719,7 +2184,6 @@ bool SearchThroughItems(MQItemSearch& SearchItem, ItemClient** pResult, DWORD* n
 	return false;
 }
 #undef DoResult
-#undef RequireFlag
 #undef Flag
 #undef MaskSet
 
@@ -2213,9 +2677,10 @@ bool EvaluateRPN(CalcOp* pList, int Size, double& Result)
 	return true;
 }
 
-bool FastCalculate(char* szFormula, double& Result)
+// Compile a normalized formula into a postfix program. Number literals are emitted as CO_NUMBER
+// ops in the order that they appear in the formula.
+static bool CompileCalculation(char* szFormula, std::vector<CalcOp>& program)
 {
-	//DebugSpew("FastCalculate(%s)",szFormula);
 	if (!szFormula || !szFormula[0])
 		return false;
 
@@ -2435,14 +2900,151 @@ bool FastCalculate(char* szFormula, double& Result)
 		StackPop();
 	}
 
-	return EvaluateRPN(pOpList, nOps, Result);
+	program.assign(pOpList, pOpList + nOps);
+	return true;
 }
 
-bool Calculate(const char* szFormula, double& Result)
+bool FastCalculate(char* szFormula, double& Result)
 {
-	char Buffer[MAX_STRING] = { 0 };
-	strcpy_s(Buffer, szFormula);
-	_strupr_s(Buffer);
+	//DebugSpew("FastCalculate(%s)",szFormula);
+	std::vector<CalcOp> program;
+	if (!CompileCalculation(szFormula, program))
+		return false;
+
+	return EvaluateRPN(program.data(), (int)program.size(), Result);
+}
+
+// A compiled formula, keyed by its shape: the formula with every number literal replaced by 0.
+// Conditions are evaluated after ${} substitution, so a condition whose values change from one
+// evaluation to the next still has the same shape and can reuse its program.
+struct CompiledCalculation
+{
+	std::vector<CalcOp> program;
+	std::vector<int> numberSlots;             // index of each CO_NUMBER op, in literal order
+};
+
+static constexpr size_t MAX_CACHED_CALCULATIONS = 1024;
+static std::unordered_map<std::string, CompiledCalculation> s_calculationCache;
+
+// Split a formula into its shape and the values of its number literals, the same way that
+// CompileCalculation tokenizes it: a literal is a run of digits and periods, and spaces inside of
+// a literal do not end it. If bound values are given, each CALC_BOUND_VALUE marker stands for the
+// next one. Returns false if a marker touches a literal or another marker, because as text the
+// two would have run together into a single number.
+static bool GetCalculationShape(const char* szFormula, const double* boundValues, size_t boundCount,
+	std::string& shape, std::vector<double>& values)
+{
+	char CurrentToken[MAX_STRING] = { 0 };
+	char* pToken = &CurrentToken[0];
+	bool inNumber = false;
+	bool afterBound = false;
+	size_t nextBound = 0;
+
+	for (const char* pCur = szFormula; *pCur; ++pCur)
+	{
+		const char ch = *pCur;
+
+		if (ch == CALC_BOUND_VALUE && boundValues)
+		{
+			if (inNumber || afterBound || nextBound >= boundCount)
+				return false;
+
+			shape.push_back('0');
+			values.push_back(boundValues[nextBound++]);
+			afterBound = true;
+		}
+		else if ((ch >= '0' && ch <= '9') || ch == '.')
+		{
+			if (afterBound)
+				return false;
+
+			if (!inNumber)
+			{
+				shape.push_back('0');
+				inNumber = true;
+			}
+
+			*pToken++ = ch;
+		}
+		else
+		{
+			if (ch != ' ')
+			{
+				afterBound = false;
+
+				if (inNumber)
+				{
+					*pToken = 0;
+					values.push_back(GetDoubleFromString(CurrentToken, 0));
+					pToken = &CurrentToken[0];
+					inNumber = false;
+				}
+			}
+
+			shape.push_back(ch);
+		}
+	}
+
+	if (inNumber)
+	{
+		*pToken = 0;
+		values.push_back(GetDoubleFromString(CurrentToken, 0));
+	}
+
+	return nextBound == boundCount;
+}
+
+// Returns -1 if the bound values could not be placed into the formula, otherwise 1 on success and
+// 0 if the formula failed to compile or evaluate.
+static int CachedCalculate(char* szFormula, double& Result, const double* boundValues = nullptr, size_t boundCount = 0)
+{
+	static std::string shape;
+	static std::vector<double> values;
+	shape.clear();
+	values.clear();
+
+	if (!GetCalculationShape(szFormula, boundValues, boundCount, shape, values))
+		return -1;
+
+	auto iter = s_calculationCache.find(shape);
+	if (iter == s_calculationCache.end())
+	{
+		CompiledCalculation compiled;
+
+		std::string source = shape;
+		if (!CompileCalculation(source.data(), compiled.program))
+			return 0;
+
+		for (int i = 0; i < (int)compiled.program.size(); ++i)
+		{
+			if (compiled.program[i].Op == CO_NUMBER)
+				compiled.numberSlots.push_back(i);
+		}
+
+		if (s_calculationCache.size() >= MAX_CACHED_CALCULATIONS)
+			s_calculationCache.clear();
+
+		iter = s_calculationCache.emplace(shape, std::move(compiled)).first;
+	}
+
+	CompiledCalculation& compiled = iter->second;
+	if (compiled.numberSlots.size() != values.size())
+	{
+		if (boundValues)
+			return -1;
+
+		return FastCalculate(szFormula, Result) ? 1 : 0;
+	}
+
+	for (size_t i = 0; i < values.size(); ++i)
+		compiled.program[compiled.numberSlots[i]].Value = values[i];
+
+	return EvaluateRPN(compiled.program.data(), (int)compiled.program.size(), Result) ? 1 : 0;
+}
+
+static void NormalizeFormula(char* Buffer)
+{
+	_strupr_s(Buffer, MAX_STRING);
 
 	while (char* pNull = strstr(Buffer, "NULL"))
 	{
@@ -2468,9 +3070,27 @@ bool Calculate(const char* szFormula, double& Result)
 		pFalse[3] = '0';
 		pFalse[4] = '0';
 	}
+}
+
+bool Calculate(const char* szFormula, double& Result)
+{
+	char Buffer[MAX_STRING] = { 0 };
+	strcpy_s(Buffer, szFormula);
+	NormalizeFormula(Buffer);
 
 	bool Ret;
-	Benchmark(bmCalculate, Ret = FastCalculate(Buffer, Result));
+	Benchmark(bmCalculate, Ret = CachedCalculate(Buffer, Result) == 1);
+	return Ret;
+}
+
+int CalculateBound(const char* szFormula, const double* values, size_t count, double& Result)
+{
+	char Buffer[MAX_STRING] = { 0 };
+	strcpy_s(Buffer, szFormula);
+	NormalizeFormula(Buffer);
+
+	int Ret;
+	Benchmark(bmCalculate, Ret = CachedCalculate(Buffer, Result, values, count));
 	return Ret;
 }
 
@@ -2486,37 +3106,13 @@ bool PlayerHasAAAbility(int AAIndex)
 
 int GetAAIndexByName(const char* AAName)
 {
-	int level = pLocalPlayer ? pLocalPlayer->Level : -1;
-
 	// check bought aa's first
-	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
-		{
-			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
-			{
-				if (!_stricmp(AAName, pName))
-				{
-					return pAbility->Index;
-				}
-			}
-		}
-	}
+	if (CAltAbilityData* pAbility = FindOwnedAltAbilityByName(AAName))
+		return pAbility->Index;
 
 	// not found? fine lets check them all then...
-	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
-		{
-			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
-			{
-				if (!_stricmp(AAName, pName))
-				{
-					return pAbility->Index;
-				}
-			}
-		}
-	}
+	if (CAltAbilityData* pAbility = FindAltAbilityByName(AAName))
+		return pAbility->Index;
 
 	return 0;
 }
@@ -2524,16 +3120,8 @@ int GetAAIndexByName(const char* AAName)
 int GetAAIndexByID(int ID)
 {
 	// check our bought aa's first
-	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
-		{
-			if (pAbility->ID == ID)
-			{
-				return pAbility->Index;
-			}
-		}
-	}
+	if (CAltAbilityData* pAbility = FindOwnedAltAbilityByID(ID))
+		return pAbility->Index;
 
 	// didnt find it? fine we go through them all then...
 	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
@@ -2552,6 +3140,18 @@ int GetAAIndexByID(int ID)
 
 bool IsPCNear(SPAWNINFO* pSpawn, float Radius)
 {
+	std::vector<SPAWNINFO*> players;
+	if (GetPlayersInRadius(pSpawn->X, pSpawn->Y, pSpawn->Z, Radius, players))
+	{
+		for (SPAWNINFO* pClose : players)
+		{
+			if (pClose != pSpawn && !IsInGroup(pClose))
+				return true;
+		}
+
+		return false;
+	}
+
 	SPAWNINFO* pClose = pSpawnList;
 	while (pClose)
 	{
@@ -2565,6 +3165,108 @@ bool IsPCNear(SPAWNINFO* pSpawn, float Radius)
 	return false;
 }
 
+//----------------------------------------------------------------------------
+// Group, raid and fellowship rosters
+//
+// Spawn searches with group, raid or fellowship filters ask about every spawn they look at,
+// and macros look up group and raid members by name constantly. Rather than walk a roster
+// and compare names for every question, the rosters are indexed by name. The index is
+// rebuilt the first time it is needed in a pulse, which picks up any roster change.
+
+struct RosterIndex
+{
+	bool valid = false;
+	uint32_t pulse = 0;
+
+	ci_unordered::map<std::string, int> groupSlots;      // member name -> group slot
+	ci_unordered::map<std::string, int> groupMembers;    // cleaned name -> ${Group.Member} index
+	ci_unordered::map<std::string, int> raidSlots;       // member name -> raid slot
+	ci_unordered::map<std::string, int> fellowshipSlots; // member name -> fellowship slot
+};
+static RosterIndex s_rosterIndex;
+
+static const RosterIndex& GetRosterIndex()
+{
+	RosterIndex& index = s_rosterIndex;
+	if (index.valid && index.pulse == gPulseCount)
+		return index;
+
+	index.valid = true;
+	index.pulse = gPulseCount;
+	index.groupSlots.clear();
+	index.groupMembers.clear();
+	index.raidSlots.clear();
+	index.fellowshipSlots.clear();
+
+	if (pLocalPC && pLocalPC->Group)
+	{
+		int memberIndex = 0;
+
+		for (int i = 1; i < MAX_GROUP_SIZE; i++)
+		{
+			if (CGroupMember* pMember = pLocalPC->Group->GetGroupMember(i))
+			{
+				++memberIndex;
+				index.groupSlots.emplace(pMember->GetName(), i);
+
+				char Name[MAX_STRING] = { 0 };
+				strcpy_s(Name, pMember->GetName());
+
+				CleanupName(Name, sizeof(Name), false, false); // we do this to fix the mercenaryname bug
+				index.groupMembers.emplace(Name, memberIndex);
+			}
+		}
+	}
+
+	if (pRaid)
+	{
+		for (int nMember = 0; nMember < MAX_RAID_SIZE; nMember++)
+		{
+			if (pRaid->locations[nMember])
+				index.raidSlots.emplace(pRaid->raidMembers[nMember].Name, nMember);
+		}
+	}
+
+	if (pLocalPlayer)
+	{
+		SFellowship& Fellowship = pLocalPlayer->Fellowship;
+
+		for (int i = 0; i < Fellowship.Members; i++)
+			index.fellowshipSlots.emplace(Fellowship.FellowshipMember[i].Name, i);
+	}
+
+	return index;
+}
+
+static int FindRosterSlot(const ci_unordered::map<std::string, int>& slots, std::string_view name)
+{
+	if (name.empty())
+		return -1;
+
+	auto iter = slots.find(std::string(name));
+	return iter != slots.end() ? iter->second : -1;
+}
+
+// "Name's corpse0" -> "Name"
+static std::string_view GetCorpseOwnerName(std::string_view corpseName)
+{
+	int pos = ci_find_substr(corpseName, "'s corpse");
+	if (pos <= 0)
+		return {};
+
+	return corpseName.substr(0, pos);
+}
+
+int GetGroupMemberIndexByName(std::string_view name)
+{
+	return FindRosterSlot(GetRosterIndex().groupMembers, name);
+}
+
+int GetRaidMemberSlotByName(std::string_view name)
+{
+	return FindRosterSlot(GetRosterIndex().raidSlots, name);
+}
+
 /*
  * Returns group member including self
  */
@@ -2578,32 +3280,8 @@ bool IsInGroup(SPAWNINFO* pSpawn, bool bCorpse /* = false */)
 	if (pSpawn == pLocalPC->pSpawn)
 		return true;
 
-	for (int i = 1; i < MAX_GROUP_SIZE; i++)
-	{
-		if (CGroupMember* pMember = pLocalPC->Group->GetGroupMember(i))
-		{
-			if (!bCorpse)
-			{
-				if (!_stricmp(pMember->GetName(), pSpawn->Name))
-				{
-					return true;
-				}
-			}
-			else
-			{
-				char szSearch[256] = { 0 };
-				strcpy_s(szSearch, pMember->GetName());
-				strcat_s(szSearch, "'s corpse");
-
-				if (!_strnicmp(pSpawn->Name, szSearch, strlen(szSearch)))
-				{
-					return true;
-				}
-			}
-		}
-	}
-
-	return false;
+	std::string_view name = bCorpse ? GetCorpseOwnerName(pSpawn->Name) : pSpawn->Name;
+	return FindRosterSlot(GetRosterIndex().groupSlots, name) != -1;
 }
 
 bool IsInRaid(SPAWNINFO* pSpawn, bool bCorpse)
@@ -2613,34 +3291,10 @@ bool IsInRaid(SPAWNINFO* pSpawn, bool bCorpse)
 	if (pSpawn == pLocalPlayer)
 		return true;
 
-	size_t l = strlen(pSpawn->Name);
-
-	for (auto& member : pRaid->RaidMember)
-	{
-		if (!bCorpse)
-		{
-			if (!_strnicmp(member.Name, pSpawn->Name, l + 1)
-				&& member.nClass == pSpawn->GetClass())
-			{
-				return true;
-			}
-		}
-		else
-		{
-			char szSearch[256] = { 0 };
-			strcpy_s(szSearch, member.Name);
-			strcat_s(szSearch, "'s corpse");
-
-			size_t l = strlen(szSearch);
-			if (!_strnicmp(szSearch, pSpawn->Name, l)
-				&& member.nClass == pSpawn->GetClass())
-			{
-				return true;
-			}
-		}
-	}
+	std::string_view name = bCorpse ? GetCorpseOwnerName(pSpawn->Name) : pSpawn->Name;
+	int nMember = FindRosterSlot(GetRosterIndex().raidSlots, name);
 
-	return false;
+	return nMember != -1 && pRaid->raidMembers[nMember].nClass == pSpawn->GetClass();
 }
 
 bool IsInFellowship(SPAWNINFO* pSpawn, bool bCorpse)
@@ -2651,32 +3305,12 @@ bool IsInFellowship(SPAWNINFO* pSpawn, bool bCorpse)
 	if (!pLocalPlayer)
 		return false;
 
-	SFellowship& Fellowship = pLocalPlayer->Fellowship;
-
-	for (int i = 0; i < Fellowship.Members; i++)
-	{
-		if (!bCorpse)
-		{
-			if (!_stricmp(Fellowship.FellowshipMember[i].Name, pSpawn->Name))
-			{
-				return true;
-			}
-		}
-		else
-		{
-			char szSearch[256] = { 0 };
-			strcpy_s(szSearch, Fellowship.FellowshipMember[i].Name);
-			strcat_s(szSearch, "'s corpse");
-
-			if (!_strnicmp(szSearch, pSpawn->Name, strlen(szSearch))
-				&& Fellowship.FellowshipMember[i].Class == pSpawn->GetClass())
-			{
-				return true;
-			}
-		}
-	}
+	std::string_view name = bCorpse ? GetCorpseOwnerName(pSpawn->Name) : pSpawn->Name;
+	int nMember = FindRosterSlot(GetRosterIndex().fellowshipSlots, name);
+	if (nMember == -1)
+		return false;
 
-	return false;
+	return !bCorpse || pLocalPlayer->Fellowship.FellowshipMember[nMember].Class == pSpawn->GetClass();
 }
 
 bool IsNamed(SPAWNINFO* pSpawn)
@@ -2951,22 +3585,37 @@ char* FormatSearchSpawn(char* Buffer, size_t BufferSize, MQSpawnSearch* pSearchS
 	return Buffer;
 }
 
-SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
+// Gets the area a search is limited to by its radius, this is a superset of the spawns that can
+// match since the radius is checked in 3D.
+static bool GetSearchArea(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, float& X, float& Y, float& Radius)
 {
-	if (!pSearchSpawn || Nth == 0 || !pOrigin)
-		return nullptr;
-
-	std::vector<MQSpawnArrayItem> spawnSet;
-	spawnSet.reserve(gSpawnsArray.size());
+	if (pSearchSpawn->FRadius >= 10000.0f)
+		return false;
 
-	for (const MQSpawnArrayItem& item : gSpawnsArray)
+	if (pSearchSpawn->bKnownLocation)
+	{
+		X = pSearchSpawn->xLoc;
+		Y = pSearchSpawn->yLoc;
+	}
+	else
 	{
-		SPAWNINFO* pSpawn = item.GetSpawn();
+		X = pOrigin->X;
+		Y = pOrigin->Y;
+	}
+
+	Radius = pSearchSpawn->FRadius;
+	return true;
+}
 
+static void AddMatchingSpawns(const MQCompiledSpawnSearch& search, SPAWNINFO* pOrigin, bool IncludeOrigin,
+	const std::vector<SPAWNINFO*>& candidates, std::vector<MQSpawnArrayItem>& spawnSet)
+{
+	for (SPAWNINFO* pSpawn : candidates)
+	{
 		if (!IncludeOrigin && pSpawn == pOrigin)
 			continue;
 
-		if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+		if (search.Matches(pOrigin, pSpawn))
 		{
 			float distSq = Get3DDistanceSquared(pOrigin->X, pOrigin->Y, pOrigin->Z,
 				pSpawn->X, pSpawn->Y, pSpawn->Z);
@@ -2975,6 +3624,67 @@ SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOri
 			spawnSet.emplace_back(pSpawn, distSq);
 		}
 	}
+}
+
+// Collects the spawns matching a search into spawnSet, unsorted. When Count is positive and the grid
+// is available this may stop early, but the Count nearest matches are always included.
+static void GatherNearestSpawns(MQSpawnSearch* pSearchSpawn, int Count, SPAWNINFO* pOrigin, bool IncludeOrigin,
+	std::vector<MQSpawnArrayItem>& spawnSet)
+{
+	EnsureMQ2SpawnSort();
+
+	const MQCompiledSpawnSearch search(pSearchSpawn);
+	std::vector<SPAWNINFO*> candidates;
+
+	float X, Y, Radius;
+	if (GetSearchArea(pSearchSpawn, pOrigin, X, Y, Radius)
+		&& GetSpawnsInRadius(X, Y, Radius, candidates))
+	{
+		AddMatchingSpawns(search, pOrigin, IncludeOrigin, candidates, spawnSet);
+	}
+	else if (Count > 0 && IsSpawnGridBuilt())
+	{
+		// Work outwards from the origin a ring of cells at a time. Anything not seen yet after a ring
+		// is at least that ring times the cell size away, allowing for a cell of movement since
+		// the grid was built, so we can stop as soon as we have enough matches closer than that.
+		for (int ring = 0; ; ++ring)
+		{
+			candidates.clear();
+			bool more = GetSpawnsInRing(pOrigin->X, pOrigin->Y, ring, candidates);
+
+			AddMatchingSpawns(search, pOrigin, IncludeOrigin, candidates, spawnSet);
+
+			if (!more)
+				break;
+
+			if (Count <= static_cast<int>(spawnSet.size()))
+			{
+				std::nth_element(spawnSet.begin(), spawnSet.begin() + (Count - 1), spawnSet.end(), MQRankFloatCompare);
+
+				const float seen = ring * SPAWN_GRID_CELL_SIZE;
+				if (spawnSet[Count - 1].GetDistanceSquared() <= seen * seen)
+					break;
+			}
+		}
+	}
+	else
+	{
+		spawnSet.reserve(gSpawnsArray.size());
+
+		for (const MQSpawnArrayItem& item : gSpawnsArray)
+			candidates.push_back(item.GetSpawn());
+
+		AddMatchingSpawns(search, pOrigin, IncludeOrigin, candidates, spawnSet);
+	}
+}
+
+static SPAWNINFO* FindNthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (!pSearchSpawn || Nth == 0 || !pOrigin)
+		return nullptr;
+
+	std::vector<MQSpawnArrayItem> spawnSet;
+	GatherNearestSpawns(pSearchSpawn, Nth, pOrigin, IncludeOrigin, spawnSet);
 
 	if (Nth > static_cast<int>(spawnSet.size()))
 	{
@@ -2988,19 +3698,37 @@ SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOri
 	return spawnSet[Nth - 1].GetSpawn();
 }
 
-int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin)
+static int CountAllMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin)
 {
 	if (!pSearchSpawn || !pOrigin)
 		return 0;
 
 	int TotalMatching = 0;
+	const MQCompiledSpawnSearch search(pSearchSpawn);
+
+	std::vector<SPAWNINFO*> candidates;
+	float X, Y, Radius;
+	if (GetSearchArea(pSearchSpawn, pOrigin, X, Y, Radius)
+		&& GetSpawnsInRadius(X, Y, Radius, candidates))
+	{
+		for (SPAWNINFO* pSpawn : candidates)
+		{
+			if ((IncludeOrigin || pSpawn != pOrigin) && search.Matches(pOrigin, pSpawn))
+			{
+				TotalMatching++;
+			}
+		}
+
+		return TotalMatching;
+	}
+
 	SPAWNINFO* pSpawn = pSpawnList;
 
 	if (IncludeOrigin)
 	{
 		while (pSpawn)
 		{
-			if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+			if (search.Matches(pOrigin, pSpawn))
 			{
 				TotalMatching++;
 			}
@@ -3011,7 +3739,7 @@ int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool In
 	{
 		while (pSpawn)
 		{
-			if (pSpawn != pOrigin && SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+			if (pSpawn != pOrigin && search.Matches(pOrigin, pSpawn))
 			{
 				// matches search, add to our set
 				TotalMatching++;
@@ -3022,6 +3750,173 @@ int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool In
 	return TotalMatching;
 }
 
+// Results of spawn searches, kept until the next pulse or until spawns or alerts change, so
+// repeating the same search in a frame only costs building its key. Only used on the main thread.
+static std::atomic<uint32_t> s_spawnSearchGeneration = 1;
+static uint32_t s_spawnSearchCacheGeneration = 0;
+static std::unordered_map<std::string, int> s_spawnCountCache;
+static std::unordered_map<std::string, SPAWNINFO*> s_nearestSpawnCache;
+static constexpr size_t MAX_SPAWN_SEARCH_CACHE = 1024;
+
+void InvalidateSpawnSearchCache()
+{
+	++s_spawnSearchGeneration;
+}
+
+static bool UseSpawnSearchCache()
+{
+	if (!IsMainThread())
+		return false;
+
+	const uint32_t generation = s_spawnSearchGeneration;
+	if (generation != s_spawnSearchCacheGeneration
+		|| s_spawnCountCache.size() + s_nearestSpawnCache.size() > MAX_SPAWN_SEARCH_CACHE)
+	{
+		s_spawnCountCache.clear();
+		s_nearestSpawnCache.clear();
+		s_spawnSearchCacheGeneration = generation;
+	}
+
+	return true;
+}
+
+template <typename T>
+static void AppendSpawnSearchKey(std::string& key, const T& value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendSpawnSearchKey(std::string& key, const char* value)
+{
+	key.append(value);
+	key.push_back('\0');
+}
+
+// Every field of the search goes into the key one at a time, the struct itself can't be compared
+// as bytes because of padding and whatever follows the terminator in its strings.
+static std::string GetSpawnSearchKey(const MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin, int Nth)
+{
+	std::string key;
+	key.reserve(256);
+
+	AppendSpawnSearchKey(key, pOrigin);
+	AppendSpawnSearchKey(key, IncludeOrigin);
+	AppendSpawnSearchKey(key, Nth);
+	AppendSpawnSearchKey(key, gZFilter);
+
+	AppendSpawnSearchKey(key, pSearchSpawn->MinLevel);
+	AppendSpawnSearchKey(key, pSearchSpawn->MaxLevel);
+	AppendSpawnSearchKey(key, pSearchSpawn->SpawnType);
+	AppendSpawnSearchKey(key, pSearchSpawn->SpawnID);
+	AppendSpawnSearchKey(key, pSearchSpawn->FromSpawnID);
+	AppendSpawnSearchKey(key, pSearchSpawn->Radius);
+	AppendSpawnSearchKey(key, pSearchSpawn->szName);
+	AppendSpawnSearchKey(key, pSearchSpawn->szBodyType);
+	AppendSpawnSearchKey(key, pSearchSpawn->szRace);
+	AppendSpawnSearchKey(key, pSearchSpawn->szClass);
+	AppendSpawnSearchKey(key, pSearchSpawn->szLight);
+	AppendSpawnSearchKey(key, pSearchSpawn->GuildID);
+
+	const bool flags[] = {
+		pSearchSpawn->bSpawnID, pSearchSpawn->bNotNearAlert, pSearchSpawn->bNearAlert, pSearchSpawn->bNoAlert,
+		pSearchSpawn->bAlert, pSearchSpawn->bLFG, pSearchSpawn->bTrader, pSearchSpawn->bLight,
+		pSearchSpawn->bTargNext, pSearchSpawn->bTargPrev, pSearchSpawn->bGroup, pSearchSpawn->bFellowship,
+		pSearchSpawn->bXTarHater, pSearchSpawn->bNoGroup, pSearchSpawn->bRaid, pSearchSpawn->bGM,
+		pSearchSpawn->bNamed, pSearchSpawn->bMerchant, pSearchSpawn->bBanker, pSearchSpawn->bTributeMaster,
+		pSearchSpawn->bKnight, pSearchSpawn->bTank, pSearchSpawn->bHealer, pSearchSpawn->bDps,
+		pSearchSpawn->bSlower, pSearchSpawn->bAura, pSearchSpawn->bBanner, pSearchSpawn->bCampfire,
+		pSearchSpawn->bKnownLocation, pSearchSpawn->bNoPet, pSearchSpawn->bNoGuild, pSearchSpawn->bLoS,
+		pSearchSpawn->bExactName, pSearchSpawn->bTargetable,
+	};
+	AppendSpawnSearchKey(key, flags);
+
+	AppendSpawnSearchKey(key, pSearchSpawn->NotID);
+	AppendSpawnSearchKey(key, pSearchSpawn->NotNearAlertList);
+	AppendSpawnSearchKey(key, pSearchSpawn->NearAlertList);
+	AppendSpawnSearchKey(key, pSearchSpawn->NoAlertList);
+	AppendSpawnSearchKey(key, pSearchSpawn->AlertList);
+	AppendSpawnSearchKey(key, pSearchSpawn->ZRadius);
+	AppendSpawnSearchKey(key, pSearchSpawn->FRadius);
+	AppendSpawnSearchKey(key, pSearchSpawn->xLoc);
+	AppendSpawnSearchKey(key, pSearchSpawn->yLoc);
+	AppendSpawnSearchKey(key, pSearchSpawn->zLoc);
+	AppendSpawnSearchKey(key, pSearchSpawn->SortBy);
+	AppendSpawnSearchKey(key, pSearchSpawn->PlayerState);
+
+	return key;
+}
+
+SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (!pSearchSpawn || Nth == 0 || !pOrigin)
+		return nullptr;
+
+	std::string cacheKey;
+	if (UseSpawnSearchCache())
+	{
+		cacheKey = GetSpawnSearchKey(pSearchSpawn, pOrigin, IncludeOrigin, Nth);
+
+		auto iter = s_nearestSpawnCache.find(cacheKey);
+		if (iter != s_nearestSpawnCache.end())
+			return iter->second;
+	}
+
+	SPAWNINFO* pSpawn = FindNthNearestSpawn(pSearchSpawn, Nth, pOrigin, IncludeOrigin);
+
+	if (!cacheKey.empty())
+		s_nearestSpawnCache.emplace(std::move(cacheKey), pSpawn);
+
+	return pSpawn;
+}
+
+std::vector<PlayerClient*> GetNearestSpawns(MQSpawnSearch* pSearchSpawn, int Count, PlayerClient* pOrigin, bool IncludeOrigin)
+{
+	std::vector<PlayerClient*> result;
+
+	if (!pOrigin)
+		pOrigin = pControlledPlayer;
+
+	if (!pSearchSpawn || Count <= 0 || !pOrigin)
+		return result;
+
+	std::vector<MQSpawnArrayItem> spawnSet;
+	GatherNearestSpawns(pSearchSpawn, Count, pOrigin, IncludeOrigin, spawnSet);
+
+	// Only the first Count need to be in order.
+	auto last = spawnSet.begin() + std::min<size_t>(Count, spawnSet.size());
+	std::partial_sort(spawnSet.begin(), last, spawnSet.end(), MQRankFloatCompare);
+
+	result.reserve(last - spawnSet.begin());
+	for (auto iter = spawnSet.begin(); iter != last; ++iter)
+		result.push_back(iter->GetSpawn());
+
+	return result;
+}
+
+int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (!pSearchSpawn || !pOrigin)
+		return 0;
+
+	std::string cacheKey;
+	if (UseSpawnSearchCache())
+	{
+		cacheKey = GetSpawnSearchKey(pSearchSpawn, pOrigin, IncludeOrigin, 0);
+
+		auto iter = s_spawnCountCache.find(cacheKey);
+		if (iter != s_spawnCountCache.end())
+			return iter->second;
+	}
+
+	int count = CountAllMatchingSpawns(pSearchSpawn, pOrigin, IncludeOrigin);
+
+	if (!cacheKey.empty())
+		s_spawnCountCache.emplace(std::move(cacheKey), count);
+
+	return count;
+}
+
 SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 {
 	SPAWNINFO* pFromSpawn = nullptr;
@@ -3030,6 +3925,10 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 	{
 		pFromSpawn = GetSpawnByID(pSearchSpawn->FromSpawnID);
 		if (!pFromSpawn) return nullptr;
+
+		EnsureMQ2SpawnSort();
+
+		const MQCompiledSpawnSearch search(pSearchSpawn);
 		for (int index = 0; index < (int)gSpawnsArray.size(); index++)
 		{
 			const MQSpawnArrayItem& item = gSpawnsArray[index];
@@ -3044,7 +3943,7 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 						SPAWNINFO* pPrevSpawn = gSpawnsArray[index].GetSpawn();
 
 						if (pPrevSpawn
-							&& SpawnMatchesSearch(pSearchSpawn, pFromSpawn, pPrevSpawn))
+							&& search.Matches(pFromSpawn, pPrevSpawn))
 						{
 							return pPrevSpawn;
 						}
@@ -3058,7 +3957,7 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 						SPAWNINFO* pNextSpawn = gSpawnsArray[index].GetSpawn();
 
 						if (pNextSpawn
-							&& SpawnMatchesSearch(pSearchSpawn, pFromSpawn, pNextSpawn))
+							&& search.Matches(pFromSpawn, pNextSpawn))
 						{
 							return pNextSpawn;
 						}
@@ -3188,11 +4087,131 @@ bool SearchSpawnMatchesSearchSpawn(MQSpawnSearch* pSearchSpawn1, MQSpawnSearch*
 	return true;
 }
 
-bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+// Each condition a spawn search can have, in the order a compiled search tests them: cheap and
+// selective checks first, string compares and line of sight last.
+enum class MQSpawnSearchCheck : uint8_t
+{
+	SpawnID,
+	NotID,
+	Type,
+	MinLevel,
+	MaxLevel,
+	GuildID,
+	NoGuild,
+	ClassRole,
+	LFG,
+	Trader,
+	PlayerState,
+	Radius,
+	ZFilter,
+	ZRadius,
+	GM,
+	Targetable,
+	Named,
+	NoGroup,
+	Group,
+	Fellowship,
+	Raid,
+	XTarHater,
+	NotNearPC,
+	Light,
+	Alert,
+	NoAlert,
+	NotNearAlert,
+	NearAlert,
+	Class,
+	BodyType,
+	Race,
+	Name,
+	LoS,
+
+	Count
+};
+
+static_assert(static_cast<size_t>(MQSpawnSearchCheck::Count) <= MQCompiledSpawnSearch::MaxChecks);
+
+MQCompiledSpawnSearch::MQCompiledSpawnSearch(MQSpawnSearch* pSearchSpawn)
+	: m_pSearchSpawn(pSearchSpawn)
+{
+	if (!pSearchSpawn)
+		return;
+
+	auto add = [this](MQSpawnSearchCheck check) { m_checks[m_numChecks++] = check; };
+	const bool npcSearch = pSearchSpawn->SpawnType == NPC;
+
+	if (pSearchSpawn->bSpawnID)
+		add(MQSpawnSearchCheck::SpawnID);
+	add(MQSpawnSearchCheck::NotID);
+	if (pSearchSpawn->SpawnType != NONE || pSearchSpawn->bNoPet)
+		add(MQSpawnSearchCheck::Type);
+	if (pSearchSpawn->MinLevel)
+		add(MQSpawnSearchCheck::MinLevel);
+	if (pSearchSpawn->MaxLevel)
+		add(MQSpawnSearchCheck::MaxLevel);
+	if (pSearchSpawn->GuildID != -1)
+		add(MQSpawnSearchCheck::GuildID);
+	if (pSearchSpawn->bNoGuild)
+		add(MQSpawnSearchCheck::NoGuild);
+	if (pSearchSpawn->bMerchant || pSearchSpawn->bBanker || pSearchSpawn->bTributeMaster
+		|| (!npcSearch && (pSearchSpawn->bKnight || pSearchSpawn->bTank || pSearchSpawn->bHealer
+			|| pSearchSpawn->bDps || pSearchSpawn->bSlower)))
+	{
+		add(MQSpawnSearchCheck::ClassRole);
+	}
+	if (pSearchSpawn->bLFG)
+		add(MQSpawnSearchCheck::LFG);
+	if (pSearchSpawn->bTrader)
+		add(MQSpawnSearchCheck::Trader);
+	if (pSearchSpawn->PlayerState)
+		add(MQSpawnSearchCheck::PlayerState);
+	if (pSearchSpawn->FRadius < 10000.0f)
+		add(MQSpawnSearchCheck::Radius);
+	if (gZFilter < 10000.0f)
+		add(MQSpawnSearchCheck::ZFilter);
+	if (pSearchSpawn->ZRadius < 10000.0f)
+		add(MQSpawnSearchCheck::ZRadius);
+	if (pSearchSpawn->bGM)
+		add(MQSpawnSearchCheck::GM);
+	if (pSearchSpawn->bTargetable)
+		add(MQSpawnSearchCheck::Targetable);
+	if (pSearchSpawn->bNamed)
+		add(MQSpawnSearchCheck::Named);
+	if (pSearchSpawn->bNoGroup)
+		add(MQSpawnSearchCheck::NoGroup);
+	if (pSearchSpawn->bGroup)
+		add(MQSpawnSearchCheck::Group);
+	if (pSearchSpawn->bFellowship)
+		add(MQSpawnSearchCheck::Fellowship);
+	if (pSearchSpawn->bRaid)
+		add(MQSpawnSearchCheck::Raid);
+	if (pSearchSpawn->bXTarHater)
+		add(MQSpawnSearchCheck::XTarHater);
+	if (pSearchSpawn->Radius > 0.0f)
+		add(MQSpawnSearchCheck::NotNearPC);
+	if (pSearchSpawn->bLight)
+		add(MQSpawnSearchCheck::Light);
+	if (pSearchSpawn->bAlert && CAlerts.AlertExist(pSearchSpawn->AlertList))
+		add(MQSpawnSearchCheck::Alert);
+	if (pSearchSpawn->bNoAlert && CAlerts.AlertExist(pSearchSpawn->NoAlertList))
+		add(MQSpawnSearchCheck::NoAlert);
+	if (pSearchSpawn->bNotNearAlert)
+		add(MQSpawnSearchCheck::NotNearAlert);
+	if (pSearchSpawn->bNearAlert)
+		add(MQSpawnSearchCheck::NearAlert);
+	if (pSearchSpawn->szClass[0])
+		add(MQSpawnSearchCheck::Class);
+	if (pSearchSpawn->szBodyType[0])
+		add(MQSpawnSearchCheck::BodyType);
+	if (pSearchSpawn->szRace[0])
+		add(MQSpawnSearchCheck::Race);
+	if (pSearchSpawn->szName[0])
+		add(MQSpawnSearchCheck::Name);
+	if (pSearchSpawn->bLoS)
+		add(MQSpawnSearchCheck::LoS);
+}
+
+static bool SpawnMatchesSearchType(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pSpawn)
 {
-	if (pSearchSpawn == nullptr || pChar == nullptr || pSpawn == nullptr || !pLocalPC)
-		return false;
-
 	eSpawnType SpawnType = GetSpawnType(pSpawn);
 
 	if (SpawnType == PET)
@@ -3253,100 +4272,173 @@ bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO
 		}
 	}
 
-	if (pSearchSpawn->MinLevel && pSpawn->Level < pSearchSpawn->MinLevel)
-		return false;
-	if (pSearchSpawn->MaxLevel && pSpawn->Level > pSearchSpawn->MaxLevel)
-		return false;
-	if (pSearchSpawn->NotID == pSpawn->SpawnID)
+	return true;
+}
+
+static bool SpawnMatchesSearchClassRole(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pSpawn)
+{
+	const int spawnClass = pSpawn->GetClass();
+
+	if (pSearchSpawn->bMerchant && spawnClass != 41)
 		return false;
-	if (pSearchSpawn->bSpawnID && pSearchSpawn->SpawnID != pSpawn->SpawnID)
+	if (pSearchSpawn->bBanker && spawnClass != 40)
 		return false;
-	if (pSearchSpawn->GuildID != -1 && pSearchSpawn->GuildID != pSpawn->GuildID)
+	if (pSearchSpawn->bTributeMaster && spawnClass != 63)
 		return false;
 
-	if (pSearchSpawn->bGM && pSearchSpawn->SpawnType != NPC)
+	if (pSearchSpawn->SpawnType == NPC)
+		return true;
+
+	if (pSearchSpawn->bKnight
+		&& spawnClass != Paladin
+		&& spawnClass != Shadowknight)
 	{
-		if (!pSpawn->GM)
-			return false;
+		return false;
 	}
 
-	if (pSearchSpawn->bGM && pSearchSpawn->SpawnType == NPC)
+	if (pSearchSpawn->bTank
+		&& spawnClass != Paladin
+		&& spawnClass != Shadowknight
+		&& spawnClass != Warrior)
 	{
-		if (pSpawn->GetClass() < 20 || pSpawn->GetClass() > 35)
-			return false;
+		return false;
 	}
 
-	if (pSearchSpawn->bNamed && !IsNamed(pSpawn))
-		return false;
-	if (pSearchSpawn->bMerchant && pSpawn->GetClass() != 41)
-		return false;
-	if (pSearchSpawn->bBanker && pSpawn->GetClass() != 40)
-		return false;
-	if (pSearchSpawn->bTributeMaster && pSpawn->GetClass() != 63)
-		return false;
-	if (pSearchSpawn->bNoGuild && (pSpawn->GuildID != -1 && pSpawn->GuildID != 0))
+	if (pSearchSpawn->bHealer
+		&& spawnClass != Cleric
+		&& spawnClass != Druid
+		&& spawnClass != Shaman)
+	{
 		return false;
+	}
 
-	if (pSearchSpawn->bKnight && pSearchSpawn->SpawnType != NPC)
+	if (pSearchSpawn->bDps
+		&& spawnClass != Ranger
+		&& spawnClass != Rogue
+		&& spawnClass != Wizard
+		&& spawnClass != Berserker)
 	{
-		if (pSpawn->GetClass() != Paladin
-			&& pSpawn->GetClass() != Shadowknight)
-		{
-			return false;
-		}
+		return false;
 	}
 
-	if (pSearchSpawn->bTank && pSearchSpawn->SpawnType != NPC)
+	if (pSearchSpawn->bSlower
+		&& spawnClass != Shaman
+		&& spawnClass != Enchanter
+		&& spawnClass != Beastlord
+		&& spawnClass != Bard)
 	{
-		if (pSpawn->GetClass() != Paladin
-			&& pSpawn->GetClass() != Shadowknight
-			&& pSpawn->GetClass() != Warrior)
-		{
-			return false;
-		}
+		return false;
 	}
 
-	if (pSearchSpawn->bHealer && pSearchSpawn->SpawnType != NPC)
+	return true;
+}
+
+static bool SpawnMatchesSearchName(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pSpawn)
+{
+	if (!pSpawn->Name[0])
+		return true;
+
+	if (ci_find_substr(pSpawn->Name, pSearchSpawn->szName) == -1)
 	{
-		if (pSpawn->GetClass() != Cleric
-			&& pSpawn->GetClass() != Druid
-			&& pSpawn->GetClass() != Shaman)
-		{
+		char szCleanName[EQ_MAX_NAME] = { 0 };
+		strcpy_s(szCleanName, pSpawn->Name);
+		CleanupName(szCleanName, sizeof(szCleanName), false);
+
+		if (ci_find_substr(szCleanName, pSearchSpawn->szName) == -1)
 			return false;
-		}
 	}
 
-	if (pSearchSpawn->bDps && pSearchSpawn->SpawnType != NPC)
+	if (pSearchSpawn->bExactName)
 	{
-		if (pSpawn->GetClass() != Ranger
-			&& pSpawn->GetClass() != Rogue
-			&& pSpawn->GetClass() != Wizard
-			&& pSpawn->GetClass() != Berserker)
-		{
+		char szCleanName[EQ_MAX_NAME] = { 0 };
+		strcpy_s(szCleanName, pSpawn->Name);
+		CleanupName(szCleanName, sizeof(szCleanName), false, !gbExactSearchCleanNames);
+
+		if (!ci_equals(szCleanName, pSearchSpawn->szName))
 			return false;
-		}
 	}
 
-	if (pSearchSpawn->bSlower && pSearchSpawn->SpawnType != NPC)
+	return true;
+}
+
+static bool SpawnMatchesSearchCheck(MQSpawnSearchCheck check, MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+{
+	switch (check)
 	{
-		if (pSpawn->GetClass() != Shaman
-			&& pSpawn->GetClass() != Enchanter
-			&& pSpawn->GetClass() != Beastlord
-			&& pSpawn->GetClass() != Bard)
+	case MQSpawnSearchCheck::SpawnID:
+		return pSearchSpawn->SpawnID == pSpawn->SpawnID;
+
+	case MQSpawnSearchCheck::NotID:
+		return pSearchSpawn->NotID != pSpawn->SpawnID;
+
+	case MQSpawnSearchCheck::Type:
+		return SpawnMatchesSearchType(pSearchSpawn, pSpawn);
+
+	case MQSpawnSearchCheck::MinLevel:
+		return pSpawn->Level >= pSearchSpawn->MinLevel;
+
+	case MQSpawnSearchCheck::MaxLevel:
+		return pSpawn->Level <= pSearchSpawn->MaxLevel;
+
+	case MQSpawnSearchCheck::GuildID:
+		return pSearchSpawn->GuildID == pSpawn->GuildID;
+
+	case MQSpawnSearchCheck::NoGuild:
+		return pSpawn->GuildID == -1 || pSpawn->GuildID == 0;
+
+	case MQSpawnSearchCheck::ClassRole:
+		return SpawnMatchesSearchClassRole(pSearchSpawn, pSpawn);
+
+	case MQSpawnSearchCheck::LFG:
+		return pSpawn->LFG;
+
+	case MQSpawnSearchCheck::Trader:
+		return pSpawn->Trader;
+
+	case MQSpawnSearchCheck::PlayerState:
+		// if player state isn't 0 and we have that bit set
+		return (pSpawn->PlayerState & pSearchSpawn->PlayerState) != 0;
+
+	case MQSpawnSearchCheck::Radius:
+		if (pSearchSpawn->bKnownLocation)
 		{
-			return false;
+			if (pSearchSpawn->xLoc == pSpawn->X && pSearchSpawn->yLoc == pSpawn->Y)
+				return true;
+
+			return Distance3DToPoint(pSpawn, pSearchSpawn->xLoc, pSearchSpawn->yLoc, pSearchSpawn->zLoc) <= pSearchSpawn->FRadius;
 		}
-	}
+		return Distance3DToSpawn(pChar, pSpawn) <= pSearchSpawn->FRadius;
 
-	if (pSearchSpawn->bLFG && !pSpawn->LFG)
-		return false;
-	if (pSearchSpawn->bTrader && !pSpawn->Trader)
-		return false;
+	case MQSpawnSearchCheck::ZFilter:
+		return pSpawn->Z <= pSearchSpawn->zLoc + gZFilter && pSpawn->Z >= pSearchSpawn->zLoc - gZFilter;
 
-	if (pSearchSpawn->bXTarHater)
-	{
-		bool foundhater = false;
+	case MQSpawnSearchCheck::ZRadius:
+		return pSpawn->Z <= pSearchSpawn->zLoc + pSearchSpawn->ZRadius && pSpawn->Z >= pSearchSpawn->zLoc - pSearchSpawn->ZRadius;
+
+	case MQSpawnSearchCheck::GM:
+		if (pSearchSpawn->SpawnType == NPC)
+			return pSpawn->GetClass() >= 20 && pSpawn->GetClass() <= 35;
+		return pSpawn->GM;
+
+	case MQSpawnSearchCheck::Targetable:
+		return IsTargetable(pSpawn);
+
+	case MQSpawnSearchCheck::Named:
+		return IsNamed(pSpawn);
+
+	case MQSpawnSearchCheck::NoGroup:
+		return !IsInGroup(pSpawn);
+
+	case MQSpawnSearchCheck::Group:
+		return IsInGroup(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
+
+	case MQSpawnSearchCheck::Fellowship:
+		return IsInFellowship(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
+
+	case MQSpawnSearchCheck::Raid:
+		return IsInRaid(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
 
+	case MQSpawnSearchCheck::XTarHater:
 		for (const ExtendedTargetSlot& xts : *pLocalPC->pExtendedTargetList)
 		{
 			if (xts.xTargetType == XTARGET_AUTO_HATER
@@ -3357,118 +4449,74 @@ bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO
 				if (pXTargetSpawn != nullptr
 					&& pXTargetSpawn->SpawnID == pSpawn->SpawnID)
 				{
-					foundhater = true;
+					return true;
 				}
 			}
 		}
+		return false;
 
-		if (!foundhater)
-		{
-			return false;
-		}
-	}
+	case MQSpawnSearchCheck::NotNearPC:
+		return !IsPCNear(pSpawn, pSearchSpawn->Radius);
 
-	if (pSearchSpawn->bNoGroup && IsInGroup(pSpawn))
+	case MQSpawnSearchCheck::Light:
 	{
-		return false;
+		const char* pLight = GetLightForSpawn(pSpawn);
+		if (!_stricmp(pLight, "NONE"))
+			return false;
+		return !pSearchSpawn->szLight[0] || !_stricmp(pLight, pSearchSpawn->szLight);
 	}
 
-	if (pSearchSpawn->bGroup && !IsInGroup(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case MQSpawnSearchCheck::Alert:
+		return IsAlert(pChar, pSpawn, pSearchSpawn->AlertList);
 
-	if (pSearchSpawn->bFellowship && !IsInFellowship(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case MQSpawnSearchCheck::NoAlert:
+		return !IsAlert(pChar, pSpawn, pSearchSpawn->NoAlertList);
 
-	if (pSearchSpawn->bRaid && !IsInRaid(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case MQSpawnSearchCheck::NotNearAlert:
+		return !GetClosestAlert(pSpawn, pSearchSpawn->NotNearAlertList);
 
-	if (pSearchSpawn->bKnownLocation)
-	{
-		if ((pSearchSpawn->xLoc != pSpawn->X || pSearchSpawn->yLoc != pSpawn->Y))
-		{
-			if (pSearchSpawn->FRadius < 10000.0f
-				&& Distance3DToPoint(pSpawn, pSearchSpawn->xLoc, pSearchSpawn->yLoc, pSearchSpawn->zLoc)>pSearchSpawn->FRadius)
-			{
-				return false;
-			}
-		}
-	}
-	else if (pSearchSpawn->FRadius < 10000.0f && Distance3DToSpawn(pChar, pSpawn)>pSearchSpawn->FRadius)
-	{
-		return false;
+	case MQSpawnSearchCheck::NearAlert:
+		return GetClosestAlert(pSpawn, pSearchSpawn->NearAlertList);
+
+	case MQSpawnSearchCheck::Class:
+		return !_stricmp(pSearchSpawn->szClass, GetClassDesc(pSpawn->GetClass()));
+
+	case MQSpawnSearchCheck::BodyType:
+		return !_stricmp(pSearchSpawn->szBodyType, GetBodyTypeDesc(GetBodyType(pSpawn)));
+
+	case MQSpawnSearchCheck::Race:
+		return !_stricmp(pSearchSpawn->szRace, pEverQuest->GetRaceDesc(pSpawn->GetRace()));
+
+	case MQSpawnSearchCheck::Name:
+		return SpawnMatchesSearchName(pSearchSpawn, pSpawn);
+
+	case MQSpawnSearchCheck::LoS:
+		return CanSeeSpawn(pControlledPlayer, pSpawn);
 	}
 
-	if (pSearchSpawn->Radius > 0.0f && IsPCNear(pSpawn, pSearchSpawn->Radius))
-		return false;
-	if (gZFilter < 10000.0f && ((pSpawn->Z > pSearchSpawn->zLoc + gZFilter) || (pSpawn->Z < pSearchSpawn->zLoc - gZFilter)))
-		return false;
-	if (pSearchSpawn->ZRadius < 10000.0f && (pSpawn->Z > pSearchSpawn->zLoc + pSearchSpawn->ZRadius || pSpawn->Z < pSearchSpawn->zLoc - pSearchSpawn->ZRadius))
+	return true;
+}
+
+bool MQCompiledSpawnSearch::Matches(SPAWNINFO* pChar, SPAWNINFO* pSpawn) const
+{
+	if (m_pSearchSpawn == nullptr || pChar == nullptr || pSpawn == nullptr || !pLocalPC)
 		return false;
-	if (pSearchSpawn->bLight)
-	{
-		const char* pLight = GetLightForSpawn(pSpawn);
-		if (!_stricmp(pLight, "NONE"))
-			return false;
-		if (pSearchSpawn->szLight[0] && _stricmp(pLight, pSearchSpawn->szLight))
-			return false;
-	}
-	if ((pSearchSpawn->bAlert) && CAlerts.AlertExist(pSearchSpawn->AlertList))
-	{
-		if (!IsAlert(pChar, pSpawn, pSearchSpawn->AlertList))
-			return false;
-	}
-	if ((pSearchSpawn->bNoAlert) && CAlerts.AlertExist(pSearchSpawn->NoAlertList))
+
+	for (size_t i = 0; i < m_numChecks; ++i)
 	{
-		if (IsAlert(pChar, pSpawn, pSearchSpawn->NoAlertList))
+		if (!SpawnMatchesSearchCheck(m_checks[i], m_pSearchSpawn, pChar, pSpawn))
 			return false;
 	}
-	if (pSearchSpawn->bNotNearAlert && GetClosestAlert(pSpawn, pSearchSpawn->NotNearAlertList))
-		return false;
-	if (pSearchSpawn->bNearAlert && !GetClosestAlert(pSpawn, pSearchSpawn->NearAlertList))
-		return false;
-	if (pSearchSpawn->szClass[0] && _stricmp(pSearchSpawn->szClass, GetClassDesc(pSpawn->GetClass())))
-		return false;
-	if (pSearchSpawn->szBodyType[0] && _stricmp(pSearchSpawn->szBodyType, GetBodyTypeDesc(GetBodyType(pSpawn))))
-		return false;
-	if (pSearchSpawn->szRace[0] && _stricmp(pSearchSpawn->szRace, pEverQuest->GetRaceDesc(pSpawn->GetRace())))
-		return false;
-	if (pSearchSpawn->bLoS && !pControlledPlayer->CanSee(*pSpawn))
-		return false;
-	if (pSearchSpawn->bTargetable && !IsTargetable(pSpawn))
-		return false;
-	if (pSearchSpawn->PlayerState && !(pSpawn->PlayerState & pSearchSpawn->PlayerState)) // if player state isn't 0 and we have that bit set
-		return false;
-
-	if (pSearchSpawn->szName[0] && pSpawn->Name[0])
-	{
-		if (ci_find_substr(pSpawn->Name, pSearchSpawn->szName) == -1)
-		{
-			char szCleanName[EQ_MAX_NAME] = { 0 };
-			strcpy_s(szCleanName, pSpawn->Name);
-			CleanupName(szCleanName, sizeof(szCleanName), false);
-
-			if (ci_find_substr(szCleanName, pSearchSpawn->szName) == -1)
-				return false;
-		}
 
-		if (pSearchSpawn->bExactName)
-		{
-			char szCleanName[EQ_MAX_NAME] = { 0 };
-			strcpy_s(szCleanName, pSpawn->Name);
-			CleanupName(szCleanName, sizeof(szCleanName), false, !gbExactSearchCleanNames);
+	return true;
+}
 
-			if (!ci_equals(szCleanName, pSearchSpawn->szName))
-				return false;
-		}
-	}
+bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+{
+	if (pSearchSpawn == nullptr || pChar == nullptr || pSpawn == nullptr || !pLocalPC)
+		return false;
 
-	return true;
+	return MQCompiledSpawnSearch(pSearchSpawn).Matches(pChar, pSpawn);
 }
 
 const char* ParseSearchSpawnArgs(char* szArg, const char* szRest, MQSpawnSearch* pSearchSpawn)
@@ -3869,6 +4917,151 @@ void ParseSearchSpawn(const char* Buffer, MQSpawnSearch* pSearchSpawn)
 	}
 }
 
+// Alert lists compiled for testing spawns against them. Spawn searches with alert or noalert
+// filters test every spawn against every search in the list, so each search is compiled once,
+// searches wanting an exact name are bucketed by that name so that a spawn is only tested
+// against the ones naming it, and answers are kept per spawn until the spawn search cache is
+// invalidated. Lists are rebuilt when any alert list changes. Only used on the main thread.
+struct CompiledAlertList
+{
+	uint32_t version = 0;
+	bool exists = false;
+
+	std::vector<MQSpawnSearch> searches;          // as added, for GetClosestAlert
+	std::vector<MQSpawnSearch> matchSearches;     // spawn id check moved out to spawnIDs
+	std::vector<uint32_t> spawnIDs;
+	std::vector<MQCompiledSpawnSearch> compiled;  // points into matchSearches
+	ci_unordered::map<std::string, std::vector<size_t>> exactNames;
+	std::vector<size_t> others;
+
+	uint32_t cacheGeneration = 0;
+	std::unordered_map<SPAWNINFO*, std::pair<SPAWNINFO*, bool>> results; // spawn -> (char, result)
+
+	void Build(uint32_t id, uint32_t listVersion)
+	{
+		version = listVersion;
+		searches.clear();
+		matchSearches.clear();
+		spawnIDs.clear();
+		compiled.clear();
+		exactNames.clear();
+		others.clear();
+		results.clear();
+
+		exists = CAlerts.GetAlert(id, searches);
+		matchSearches = searches;
+
+		for (size_t i = 0; i < matchSearches.size(); ++i)
+		{
+			MQSpawnSearch& search = matchSearches[i];
+			spawnIDs.push_back(search.SpawnID);
+			search.bSpawnID = false;
+
+			if (search.bExactName && search.szName[0])
+				exactNames[search.szName].push_back(i);
+			else
+				others.push_back(i);
+		}
+
+		compiled.reserve(matchSearches.size());
+		for (MQSpawnSearch& search : matchSearches)
+			compiled.emplace_back(&search);
+	}
+
+	bool Matches(size_t index, SPAWNINFO* pChar, SPAWNINFO* pSpawn) const
+	{
+		if (spawnIDs[index] > 0 && spawnIDs[index] != pSpawn->SpawnID)
+			return false;
+
+		return compiled[index].Matches(pChar, pSpawn);
+	}
+
+	bool MatchesAny(SPAWNINFO* pChar, SPAWNINFO* pSpawn) const
+	{
+		// if this spawn matches any search, it's true. This is an implied logical or
+		for (size_t index : others)
+		{
+			if (Matches(index, pChar, pSpawn))
+				return true;
+		}
+
+		if (exactNames.empty())
+			return false;
+
+		// Spawns without a name pass every name check.
+		if (!pSpawn->Name[0])
+		{
+			for (const auto& [_, indices] : exactNames)
+			{
+				for (size_t index : indices)
+				{
+					if (Matches(index, pChar, pSpawn))
+						return true;
+				}
+			}
+
+			return false;
+		}
+
+		char szCleanName[EQ_MAX_NAME] = { 0 };
+		strcpy_s(szCleanName, pSpawn->Name);
+		CleanupName(szCleanName, sizeof(szCleanName), false, !gbExactSearchCleanNames);
+
+		auto iter = exactNames.find(std::string(szCleanName));
+		if (iter == exactNames.end())
+			return false;
+
+		for (size_t index : iter->second)
+		{
+			if (Matches(index, pChar, pSpawn))
+				return true;
+		}
+
+		return false;
+	}
+
+	bool IsAlert(SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+	{
+		if (!exists)
+			return false;
+
+		const uint32_t generation = s_spawnSearchGeneration;
+		if (cacheGeneration != generation)
+		{
+			results.clear();
+			cacheGeneration = generation;
+		}
+
+		auto iter = results.find(pSpawn);
+		if (iter != results.end() && iter->second.first == pChar)
+			return iter->second.second;
+
+		// Nested alert filters can rebuild other lists while matching, but never this one.
+		const bool result = MatchesAny(pChar, pSpawn);
+		results[pSpawn] = { pChar, result };
+		return result;
+	}
+};
+static std::unordered_map<uint32_t, std::unique_ptr<CompiledAlertList>> s_compiledAlerts;
+
+static CompiledAlertList* GetCompiledAlertList(uint32_t id)
+{
+	const uint32_t version = CAlerts.GetVersion();
+
+	auto& pList = s_compiledAlerts[id];
+	if (!pList)
+	{
+		pList = std::make_unique<CompiledAlertList>();
+		pList->Build(id, version);
+	}
+	else if (pList->version != version)
+	{
+		pList->Build(id, version);
+	}
+
+	return pList.get();
+}
+
 bool GetClosestAlert(SPAWNINFO* pChar, uint32_t id)
 {
 	if (!pSpawnManager) return false;
@@ -3878,21 +5071,34 @@ bool GetClosestAlert(SPAWNINFO* pChar, uint32_t id)
 
 	float ClosestDistance = 50000.0f;
 
-	std::vector<MQSpawnSearch> search;
-	if (CAlerts.GetAlert(id, search))
+	auto checkSearch = [&](MQSpawnSearch& s)
 	{
-		for (auto& s : search)
+		if (SPAWNINFO* pSpawn = SearchThroughSpawns(&s, pChar))
 		{
-			if (SPAWNINFO* pSpawn = SearchThroughSpawns(&s, pChar))
+			const float SpawnDistance = Distance3DToSpawn(pChar, pSpawn);
+			if (SpawnDistance < ClosestDistance)
 			{
-				const float SpawnDistance = Distance3DToSpawn(pChar, pSpawn);
-				if (SpawnDistance < ClosestDistance)
-				{
-					ClosestDistance = SpawnDistance;
-					pClosest = pSpawn;
-				}
+				ClosestDistance = SpawnDistance;
+				pClosest = pSpawn;
 			}
 		}
+	};
+
+	if (IsMainThread())
+	{
+		// Copy the searches only when the list changes rather than on every call.
+		CompiledAlertList* pList = GetCompiledAlertList(id);
+		for (auto& s : pList->searches)
+			checkSearch(s);
+	}
+	else
+	{
+		std::vector<MQSpawnSearch> search;
+		if (CAlerts.GetAlert(id, search))
+		{
+			for (auto& s : search)
+				checkSearch(s);
+		}
 	}
 
 	return pClosest != nullptr;
@@ -3903,6 +5109,9 @@ bool IsAlert(SPAWNINFO* pChar, SPAWNINFO* pSpawn, uint32_t id)
 	if (pSpawn == nullptr)
 		return false;
 
+	if (IsMainThread())
+		return GetCompiledAlertList(id)->IsAlert(pChar, pSpawn);
+
 	MQSpawnSearch SearchSpawn;
 
 	std::vector<MQSpawnSearch> alerts;
@@ -4055,17 +5264,10 @@ char* CleanupName(char* szName, size_t BufferSize, bool Article, bool ForWhoList
 	return szName;
 }
 
-// ***************************************************************************
-// Function:    SuperWhoDisplay
-// Description: Displays our SuperWho / SuperWhoTarget
-// ***************************************************************************
-void SuperWhoDisplay(SPAWNINFO* pSpawn, DWORD Color)
+// Formats the line that /who shows for a spawn.
+static void FormatSuperWhoLine(SPAWNINFO* pSpawn, DWORD Color, char (&szMsg)[MAX_STRING])
 {
-	if (pSpawn == nullptr)
-		return;
-
 	char szName[MAX_STRING] = { 0 };
-	char szMsg[MAX_STRING] = { 0 };
 	char szMsgL[MAX_STRING] = { 0 };
 	char szTemp[MAX_STRING] = { 0 };
 
@@ -4293,67 +5495,92 @@ void SuperWhoDisplay(SPAWNINFO* pSpawn, DWORD Color)
 		strcat_s(szMsg, " \ar*UNTARGETABLE*\ax");
 		break;
 	}
+}
+
+// ***************************************************************************
+// Function:    SuperWhoDisplay
+// Description: Displays our SuperWho / SuperWhoTarget
+// ***************************************************************************
+void SuperWhoDisplay(SPAWNINFO* pSpawn, DWORD Color)
+{
+	if (pSpawn == nullptr)
+		return;
+
+	char szMsg[MAX_STRING] = { 0 };
+	FormatSuperWhoLine(pSpawn, Color, szMsg);
 
 	WriteChatColor(szMsg, USERCOLOR_WHO);
 }
 
-struct SuperWhoSortPredicate
+// A spawn that matched a /who, with what it is sorted by looked up once instead of on every
+// comparison.
+struct SuperWhoEntry
+{
+	SPAWNINFO* pSpawn;
+	double number;
+	std::string text;
+};
+
+static std::vector<SuperWhoEntry> SortSuperWho(const std::vector<SPAWNINFO*>& spawns, SearchSortBy sortBy, SPAWNINFO* pOrigin)
 {
-	SuperWhoSortPredicate(SearchSortBy sortBy, SPAWNINFO* pSeachOrigin)
-		: m_sortBy(sortBy)
-		, m_pOrigin(pSeachOrigin)
-	{
-	}
+	std::vector<SuperWhoEntry> entries;
+	entries.reserve(spawns.size());
 
-	bool operator()(SPAWNINFO* SpawnA, SPAWNINFO* SpawnB)
+	for (SPAWNINFO* pSpawn : spawns)
 	{
-		switch (m_sortBy)
+		SuperWhoEntry& entry = entries.emplace_back(SuperWhoEntry{ pSpawn, 0.0 });
+
+		switch (sortBy)
 		{
 		case SearchSortBy::Level:
-			return SpawnA->Level < SpawnB->Level;
+			entry.number = pSpawn->Level;
+			break;
 
 		case SearchSortBy::Name:
-			return _stricmp(SpawnA->DisplayedName, SpawnB->DisplayedName) < 0;
+			entry.text = pSpawn->DisplayedName;
+			break;
 
 		case SearchSortBy::Race:
-			return _stricmp(SpawnA->GetRaceString(), SpawnB->GetRaceString()) < 0;
+			entry.text = pSpawn->GetRaceString();
+			break;
 
 		case SearchSortBy::Class:
-			return _stricmp(SpawnA->GetClassString(), SpawnB->GetClassString()) < 0;
+			entry.text = pSpawn->GetClassString();
+			break;
 
 		case SearchSortBy::Distance:
-			return GetDistanceSquared(m_pOrigin, SpawnA) < GetDistanceSquared(m_pOrigin, SpawnB);
+			entry.number = GetDistanceSquared(pOrigin, pSpawn);
+			break;
 
 		case SearchSortBy::Guild:
-		{
-			char szGuild1[256] = { "" };
-			char szGuild2[256] = { "" };
-			const char* pDest1 = GetGuildByID(SpawnA->GuildID);
-			const char* pDest2 = GetGuildByID(SpawnB->GuildID);
-
-			if (pDest1)
-			{
-				strcpy_s(szGuild1, pDest1);
-			}
-
-			if (pDest2)
-			{
-				strcpy_s(szGuild2, pDest2);
-			}
-
-			return _stricmp(szGuild1, szGuild2) < 0;
-		}
+			if (const char* szGuild = GetGuildByID(pSpawn->GuildID))
+				entry.text = szGuild;
+			break;
 
 		case SearchSortBy::Id:
 		default:
-			return SpawnA->SpawnID < SpawnB->SpawnID;
+			entry.number = pSpawn->SpawnID;
+			break;
 		}
 	}
 
-private:
-	SearchSortBy m_sortBy;
-	SPAWNINFO* m_pOrigin;
-};
+	if (entries.size() > 1)
+	{
+		const bool byText = sortBy == SearchSortBy::Name || sortBy == SearchSortBy::Race
+			|| sortBy == SearchSortBy::Class || sortBy == SearchSortBy::Guild;
+
+		std::sort(std::begin(entries), std::end(entries),
+			[byText](const SuperWhoEntry& a, const SuperWhoEntry& b)
+			{
+				if (byText)
+					return _stricmp(a.text.c_str(), b.text.c_str()) < 0;
+
+				return a.number < b.number;
+			});
+	}
+
+	return entries;
+}
 
 void SuperWhoDisplay(SPAWNINFO* pChar, MQSpawnSearch* pSearchSpawn, DWORD Color)
 {
@@ -4370,9 +5597,10 @@ void SuperWhoDisplay(SPAWNINFO* pChar, MQSpawnSearch* pSearchSpawn, DWORD Color)
 	if (!pOrigin)
 		pOrigin = pChar;
 
+	const MQCompiledSpawnSearch search(pSearchSpawn);
 	while (pSpawn)
 	{
-		if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+		if (search.Matches(pOrigin, pSpawn))
 		{
 			// matches search, add to our set
 			SpawnSet.push_back(pSpawn);
@@ -4383,21 +5611,21 @@ void SuperWhoDisplay(SPAWNINFO* pChar, MQSpawnSearch* pSearchSpawn, DWORD Color)
 
 	if (!SpawnSet.empty())
 	{
-		if (SpawnSet.size() > 1)
-		{
-			// sort our list
-			std::sort(std::begin(SpawnSet), std::end(SpawnSet),
-				SuperWhoSortPredicate{ pSearchSpawn->SortBy, pOrigin });
-		}
-
-		WriteChatColor("List of matching spawns", USERCOLOR_WHO);
-		WriteChatColor("--------------------------------", USERCOLOR_WHO);
+		// The whole list goes out in one go. It is our own output, so events don't look at it.
+		std::vector<std::string> lines;
+		lines.reserve(SpawnSet.size() + 2);
+		lines.emplace_back("List of matching spawns");
+		lines.emplace_back("--------------------------------");
 
-		for (SPAWNINFO* spawn : SpawnSet)
+		char szMsg[MAX_STRING] = { 0 };
+		for (const SuperWhoEntry& entry : SortSuperWho(SpawnSet, pSearchSpawn->SortBy, pOrigin))
 		{
-			SuperWhoDisplay(spawn, Color);
+			FormatSuperWhoLine(entry.pSpawn, Color, szMsg);
+			lines.emplace_back(szMsg);
 		}
 
+		WriteChatColorLines(lines, USERCOLOR_WHO);
+
 		char* pszSpawnType = nullptr;
 		switch (pSearchSpawn->SpawnType)
 		{
@@ -4706,6 +5934,45 @@ inline void StackingDebugLog(const char* string, Args&& ...args)
 	}
 }
 
+// Results of BuffStackTest and WillStackWith for pairs of spell IDs. BuffStackTest only depends on
+// the spell data, WillStackWith also depends on the player's level. Both are dropped when the spells
+// are reloaded. Only used on the main thread.
+static std::atomic<uint32_t> s_spellStackingGeneration = 1;
+static uint32_t s_spellStackingCacheGeneration = 0;
+static std::unordered_map<uint64_t, bool> s_buffStackCache[4];   // indexed by the BuffStackTest flags
+static std::unordered_map<uint64_t, bool> s_willStackCache;
+static int s_willStackCacheLevel = -1;
+static constexpr size_t MAX_SPELL_STACKING_CACHE = 65536;
+
+void InvalidateSpellStackingCache()
+{
+	++s_spellStackingGeneration;
+}
+
+static bool UseSpellStackingCache()
+{
+	if (!IsMainThread())
+		return false;
+
+	const uint32_t generation = s_spellStackingGeneration;
+	if (generation != s_spellStackingCacheGeneration)
+	{
+		for (auto& cache : s_buffStackCache)
+			cache.clear();
+		s_willStackCache.clear();
+		s_spellStackingCacheGeneration = generation;
+	}
+
+	return true;
+}
+
+static uint64_t GetSpellPairKey(int firstID, int secondID)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(firstID)) << 32) | static_cast<uint32_t>(secondID);
+}
+
+static bool SpellsStack(SPELL* aSpell, SPELL* bSpell, bool bIgnoreTriggeringEffects, bool bTriggeredEffectCheck);
+
 // ***************************************************************************
 // Function:    BuffStackTest
 // Description: Return boolean true if the two spells will stack
@@ -4726,6 +5993,28 @@ bool BuffStackTest(SPELL* aSpell, SPELL* bSpell, bool bIgnoreTriggeringEffects,
 	if (aSpell->ID == bSpell->ID)
 		return true;
 
+	if (!UseSpellStackingCache())
+		return SpellsStack(aSpell, bSpell, bIgnoreTriggeringEffects, bTriggeredEffectCheck);
+
+	auto& cache = s_buffStackCache[(bIgnoreTriggeringEffects ? 1 : 0) | (bTriggeredEffectCheck ? 2 : 0)];
+	const uint64_t key = GetSpellPairKey(aSpell->ID, bSpell->ID);
+
+	auto iter = cache.find(key);
+	if (iter != cache.end())
+		return iter->second;
+
+	// the test recurses into triggered spells, which can add to the cache before we do
+	bool result = SpellsStack(aSpell, bSpell, bIgnoreTriggeringEffects, bTriggeredEffectCheck);
+
+	if (cache.size() >= MAX_SPELL_STACKING_CACHE)
+		cache.clear();
+	cache.emplace(key, result);
+
+	return result;
+}
+
+static bool SpellsStack(SPELL* aSpell, SPELL* bSpell, bool bIgnoreTriggeringEffects, bool bTriggeredEffectCheck)
+{
 	StackingDebugLog("aSpell->Name=%s(%d) bSpell->Name=%s(%d)",
 		aSpell->Name, aSpell->ID, bSpell->Name, bSpell->ID);
 
@@ -4859,6 +6148,23 @@ bool WillStackWith(const EQ_Spell* testSpell, const EQ_Spell* existingSpell)
 	if (!pLocalPlayer || !pLocalPC)
 		return false;
 
+	uint64_t key = 0;
+	const bool useCache = UseSpellStackingCache();
+	if (useCache)
+	{
+		if (s_willStackCacheLevel != pLocalPlayer->Level || s_willStackCache.size() >= MAX_SPELL_STACKING_CACHE)
+		{
+			s_willStackCache.clear();
+			s_willStackCacheLevel = pLocalPlayer->Level;
+		}
+
+		key = GetSpellPairKey(testSpell->ID, existingSpell->ID);
+
+		auto iter = s_willStackCache.find(key);
+		if (iter != s_willStackCache.end())
+			return iter->second;
+	}
+
 	EQ_Affect buff;
 	buff.Level = pLocalPlayer->Level;
 	buff.CasterGuid = pLocalPC->Guid;
@@ -4868,7 +6174,11 @@ bool WillStackWith(const EQ_Spell* testSpell, const EQ_Spell* existingSpell)
 	int SlotIndex = -1;
 	EQ_Affect* ret = pLocalPC->FindAffectSlot(testSpell->ID, pLocalPlayer, &SlotIndex, true, pLocalPlayer->Level, &buff, 1);
 
-	return ret && SlotIndex != -1;
+	const bool result = ret && SlotIndex != -1;
+	if (useCache)
+		s_willStackCache.emplace(key, result);
+
+	return result;
 }
 
 bool IsSpellTooPowerful(PlayerClient* caster, PlayerClient* target, EQ_Spell* spell)
@@ -5340,14 +6650,193 @@ static ItemClient* FindItem(T&& callback, bool checkKeyRings = true, int fromSlo
 	return foundItem.get();
 }
 
+// Where items are, by ID and by name, so lookups in a loop don't have to go through every bag on
+// every call. Built on the first lookup after it is invalidated, which happens every pulse, when
+// MQ moves an item, and on zoning. Only used on the main thread.
+struct InventoryIndexEntry
+{
+	ItemClient* pFirst = nullptr;       // the item a search in inventory order finds first
+	int count = 0;                      // sum of the stack counts
+};
+
+struct InventoryIndex
+{
+	// Items in the order the searches go through them. Holding the pointers keeps the items alive
+	// until the index is rebuilt.
+	std::vector<std::pair<std::string, ItemPtr>> items;
+	std::unordered_map<int, InventoryIndexEntry> byID;
+	std::unordered_map<std::string, InventoryIndexEntry> byName; // lower case names
+
+	void Clear()
+	{
+		items.clear();
+		byID.clear();
+		byName.clear();
+	}
+
+	void Add(const ItemPtr& pItem, std::string_view name, int itemID)
+	{
+		std::string lowerName{ name };
+		to_lower(lowerName);
+
+		InventoryIndexEntry& idEntry = byID[itemID];
+		if (!idEntry.pFirst)
+			idEntry.pFirst = pItem.get();
+		idEntry.count += pItem->GetItemCount();
+
+		InventoryIndexEntry& nameEntry = byName[lowerName];
+		if (!nameEntry.pFirst)
+			nameEntry.pFirst = pItem.get();
+		nameEntry.count += pItem->GetItemCount();
+
+		items.emplace_back(std::move(lowerName), pItem);
+	}
+
+	ItemClient* FindByName(const char* pName, bool bExact) const
+	{
+		std::string lowerName = to_lower_copy(pName);
+
+		if (bExact)
+		{
+			auto iter = byName.find(lowerName);
+			return iter == byName.end() ? nullptr : iter->second.pFirst;
+		}
+
+		for (const auto& [itemName, pItem] : items)
+		{
+			if (itemName.find(lowerName) != std::string::npos)
+				return pItem.get();
+		}
+
+		return nullptr;
+	}
+
+	ItemClient* FindByID(int itemID) const
+	{
+		auto iter = byID.find(itemID);
+		return iter == byID.end() ? nullptr : iter->second.pFirst;
+	}
+
+	int CountByName(const char* pName, bool bExact) const
+	{
+		std::string lowerName = to_lower_copy(pName);
+
+		if (bExact)
+		{
+			auto iter = byName.find(lowerName);
+			return iter == byName.end() ? 0 : iter->second.count;
+		}
+
+		int count = 0;
+		for (const auto& [itemName, entry] : byName)
+		{
+			if (itemName.find(lowerName) != std::string::npos)
+				count += entry.count;
+		}
+
+		return count;
+	}
+
+	int CountByID(int itemID) const
+	{
+		auto iter = byID.find(itemID);
+		return iter == byID.end() ? 0 : iter->second.count;
+	}
+};
+
+static std::atomic<uint32_t> s_inventoryIndexGeneration = 1;
+static uint32_t s_inventoryBuiltGeneration = 0;
+static uint32_t s_bankBuiltGeneration = 0;
+static InventoryIndex s_inventoryIndex; // inventory and keyrings
+static InventoryIndex s_bankIndex;      // bank and shared bank
+
+void InvalidateInventoryIndex()
+{
+	++s_inventoryIndexGeneration;
+}
+
+uint32_t GetInventoryIndexGeneration()
+{
+	return s_inventoryIndexGeneration;
+}
+
+static const InventoryIndex* GetInventoryIndex()
+{
+	if (!IsMainThread())
+		return nullptr;
+
+	PcProfile* pProfile = GetPcProfile();
+	if (!pProfile || !pLocalPC)
+		return nullptr;
+
+	const uint32_t generation = s_inventoryIndexGeneration;
+	if (generation != s_inventoryBuiltGeneration)
+	{
+		s_inventoryIndex.Clear();
+
+		auto indexVisitor = [](const ItemPtr& pItem, const ItemIndex&)
+		{
+			s_inventoryIndex.Add(pItem, pItem->GetName(), pItem->GetID());
+		};
+
+		// Same order as FindItem: the cursor first, then the rest of the inventory, then the keyrings.
+		pProfile->InventoryContainer.VisitItems(InvSlot_Cursor, InvSlot_Cursor, -1, indexVisitor);
+		pProfile->InventoryContainer.VisitItems(0, InvSlot_Cursor - 1, -1, indexVisitor);
+		pProfile->InventoryContainer.VisitItems(InvSlot_Cursor + 1, -1, -1, indexVisitor);
+
+#if HAS_KEYRING_WINDOW
+		for (auto keyRingType = eKeyRingTypeFirst;
+			keyRingType <= eKeyRingTypeLast;
+			keyRingType = static_cast<KeyRingType>(keyRingType + 1))
+		{
+			pLocalPC->GetKeyRingItems(keyRingType).VisitItems(-1, -1, -1, indexVisitor);
+		}
+#endif
+
+		s_inventoryBuiltGeneration = generation;
+	}
+
+	return &s_inventoryIndex;
+}
+
+static const InventoryIndex* GetBankIndex()
+{
+	if (!IsMainThread() || !pLocalPC)
+		return nullptr;
+
+	const uint32_t generation = s_inventoryIndexGeneration;
+	if (generation != s_bankBuiltGeneration)
+	{
+		s_bankIndex.Clear();
+
+		auto indexVisitor = [](const ItemPtr& pItem, const ItemIndex&)
+		{
+			s_bankIndex.Add(pItem, pItem->GetItemDefinition()->Name, pItem->GetItemDefinition()->ItemNumber);
+		};
+
+		pLocalPC->BankItems.VisitItems(-1, -1, -1, indexVisitor);
+		pLocalPC->SharedBankItems.VisitItems(-1, -1, -1, indexVisitor);
+
+		s_bankBuiltGeneration = generation;
+	}
+
+	return &s_bankIndex;
+}
+
 ItemClient* FindItemByName(const char* pName, bool bExact)
 {
+	if (const InventoryIndex* pIndex = GetInventoryIndex())
+		return pIndex->FindByName(pName, bExact);
+
 	return FindItem([pName, bExact](const ItemPtr& pItem, const ItemIndex&)
 		{ return ci_equals(pItem->GetName(), pName, bExact); });
 }
 
 ItemClient* FindItemByID(int ItemID)
 {
+	if (const InventoryIndex* pIndex = GetInventoryIndex())
+		return pIndex->FindByID(ItemID);
+
 	return FindItem([ItemID](const ItemPtr& pItem, const ItemIndex&)
 		{ return ItemID == pItem->GetID(); });
 }
@@ -5411,12 +6900,24 @@ int FindInventoryItemCountByID(int ItemID, int slotBegin, int slotEnd)
 
 int FindItemCountByName(const char* pName)
 {
+	if (const InventoryIndex* pIndex = GetInventoryIndex())
+	{
+		// same matching as MaybeExactCompare: '=' for an exact name, and an empty name only matches itself
+		if (pName[0] == '=')
+			return pIndex->CountByName(pName + 1, true);
+
+		return pIndex->CountByName(pName, pName[0] == '\0');
+	}
+
 	return CountItems([pName](const ItemPtr& pItem)
 		{ return MaybeExactCompare(pItem->GetName(), pName); });
 }
 
 int FindItemCountByID(int ItemID)
 {
+	if (const InventoryIndex* pIndex = GetInventoryIndex())
+		return pIndex->CountByID(ItemID);
+
 	return CountItems([ItemID](const ItemPtr& pItem)
 		{ return pItem->GetID() == ItemID; });
 }
@@ -5445,12 +6946,18 @@ static ItemClient* FindBankItem(T&& checkItem)
 
 ItemClient* FindBankItemByName(const char* pName, bool bExact)
 {
+	if (const InventoryIndex* pIndex = GetBankIndex())
+		return pIndex->FindByName(pName, bExact);
+
 	return FindBankItem([pName, bExact](const ItemPtr& pItem, const ItemIndex&)
 		{ return ci_equals(pItem->GetItemDefinition()->Name, pName, bExact); });
 }
 
 ItemClient* FindBankItemByID(int ItemID)
 {
+	if (const InventoryIndex* pIndex = GetBankIndex())
+		return pIndex->FindByID(ItemID);
+
 	return FindBankItem([ItemID](const ItemPtr& pItem, const ItemIndex&)
 		{ return pItem->GetItemDefinition()->ItemNumber == ItemID; });
 }
@@ -5471,12 +6978,18 @@ int CountBankItems(T&& checkItem)
 
 int FindBankItemCountByName(const char* pName, bool bExact)
 {
+	if (const InventoryIndex* pIndex = GetBankIndex())
+		return pIndex->CountByName(pName, bExact);
+
 	return CountBankItems([pName, bExact](const ItemPtr& pItem)
 		{ return ci_equals(pItem->GetItemDefinition()->Name, pName, bExact); });
 }
 
 int FindBankItemCountByID(int ItemID)
 {
+	if (const InventoryIndex* pIndex = GetBankIndex())
+		return pIndex->CountByID(ItemID);
+
 	return CountBankItems([ItemID](const ItemPtr& pItem)
 		{ return pItem->GetItemDefinition()->ItemNumber == ItemID; });
 }
@@ -5552,6 +7065,8 @@ bool ItemOnCursor()
 
 bool PickupItem(const ItemGlobalIndex& globalIndex)
 {
+	InvalidateInventoryIndex();
+
 	if (!pInvSlotMgr) return false;
 	PcProfile* pProfile = GetPcProfile();
 	if (!pProfile) return false;
@@ -5685,6 +7200,8 @@ bool PickupItem(const ItemGlobalIndex& globalIndex)
 
 bool DropItem(const ItemGlobalIndex& globalIndex)
 {
+	InvalidateInventoryIndex();
+
 	if (!pInvSlotMgr)
 		return false;
 	PcProfile* pProfile = GetPcProfile();
@@ -6164,6 +7681,187 @@ bool LootInProgress(CAdvancedLootWnd* pAdvLoot, CListWnd* pPersonalList, CListWn
 	return false;
 }
 
+#if HAS_ADVANCED_LOOT
+// Rows of an advanced loot list by item name and item id, so finding an item doesn't walk the list.
+// The lists only change while the game runs between pulses, so an index is rebuilt at most once a
+// pulse, and only when it is asked for.
+struct AdvLootRowIndex
+{
+	bool built = false;
+	uint32_t pulse = 0;
+	CListWnd* pList = nullptr;
+	int rowCount = 0;
+
+	ci_unordered::map<std::string, int> rowsByName;     // the first row with the name
+	std::unordered_map<int64_t, int> rowsByID;          // the first row with the id
+};
+
+static AdvLootRowIndex s_advLootRowIndex[2];            // personal, shared
+
+// Each row of an advanced loot list is a run of cells, one per column, each holding a button.
+static constexpr int AdvLootPersonalColumns = 7;
+static constexpr int AdvLootSharedColumns = 12;
+
+static const char* s_advLootPersonalActions[AdvLootPersonalColumns] = {
+	"name", "item", "loot", "leave", "never", "an", "ag"
+};
+
+static const char* s_advLootSharedActions[AdvLootSharedColumns] = {
+	"name", "item", "status", "action", "manage", "an", "ag", "autoroll", "nv", "nd", "gd", "no"
+};
+
+static CListWnd* GetAdvLootList(bool shared)
+{
+	if (!pAdvancedLootWnd)
+		return nullptr;
+
+	if (shared)
+		return pAdvancedLootWnd->pCLootList ? (CListWnd*)pAdvancedLootWnd->pCLootList->SharedLootList : nullptr;
+
+	return (CListWnd*)pAdvancedLootWnd->GetChildItem("ADLW_PLLList");
+}
+
+static AdvancedLootItemList* GetAdvLootItems(bool shared)
+{
+	if (!pAdvancedLootWnd)
+		return nullptr;
+
+	return shared ? pAdvancedLootWnd->pCLootList : pAdvancedLootWnd->pPLootList;
+}
+
+static const AdvLootRowIndex* GetAdvLootRowIndex(bool shared)
+{
+	CListWnd* pList = GetAdvLootList(shared);
+	AdvancedLootItemList* pItems = GetAdvLootItems(shared);
+	if (!pList || !pItems)
+		return nullptr;
+
+	AdvLootRowIndex& index = s_advLootRowIndex[shared ? 1 : 0];
+	if (index.built && index.pulse == gPulseCount && index.pList == pList && index.rowCount == pList->ItemsArray.Count)
+		return &index;
+
+	index.built = true;
+	index.pulse = gPulseCount;
+	index.pList = pList;
+	index.rowCount = pList->ItemsArray.Count;
+	index.rowsByName.clear();
+	index.rowsByID.clear();
+
+	for (int row = 0; row < index.rowCount; ++row)
+	{
+		int listindex = (int)pList->GetItemData(row);
+		if (listindex < 0 || listindex >= pItems->Items.GetSize())
+			continue;
+
+		const AdvancedLootItem& item = pItems->Items[listindex];
+		index.rowsByName.emplace(item.Name, row);
+		index.rowsByID.emplace(item.ItemID, row);
+	}
+
+	return &index;
+}
+
+// The button in every cell of the list, a row at a time, found in one walk over the list's children.
+static std::vector<CXWnd*> GetAdvLootListButtons(CListWnd* pList, int columns)
+{
+	std::vector<CXWnd*> buttons(static_cast<size_t>(pList->ItemsArray.Count) * columns, nullptr);
+
+	CXWnd* pCell = pList->GetFirstChildWnd();
+	for (size_t i = 0; pCell && i < buttons.size(); ++i)
+	{
+		buttons[i] = pCell->GetFirstChildWnd();
+		pCell = pCell->GetNextSiblingWnd();
+	}
+
+	return buttons;
+}
+#endif // HAS_ADVANCED_LOOT
+
+int FindAdvLootRowByName(bool shared, std::string_view itemName)
+{
+#if HAS_ADVANCED_LOOT
+	if (const AdvLootRowIndex* index = GetAdvLootRowIndex(shared))
+	{
+		auto iter = index->rowsByName.find(std::string(itemName));
+		if (iter != index->rowsByName.end())
+			return iter->second;
+	}
+#endif
+
+	return -1;
+}
+
+int FindAdvLootRowByID(bool shared, int64_t itemID)
+{
+#if HAS_ADVANCED_LOOT
+	if (const AdvLootRowIndex* index = GetAdvLootRowIndex(shared))
+	{
+		auto iter = index->rowsByID.find(itemID);
+		if (iter != index->rowsByID.end())
+			return iter->second;
+	}
+#endif
+
+	return -1;
+}
+
+int DoAdvLootActions(bool shared, const std::vector<std::pair<std::string, std::string>>& actions)
+{
+	int applied = 0;
+
+#if HAS_ADVANCED_LOOT
+	CListWnd* pList = GetAdvLootList(shared);
+	AdvancedLootItemList* pItems = GetAdvLootItems(shared);
+	if (!pList || !pItems)
+		return 0;
+
+	const int columns = shared ? AdvLootSharedColumns : AdvLootPersonalColumns;
+	const char** columnActions = shared ? s_advLootSharedActions : s_advLootPersonalActions;
+
+	// found once for the whole batch, rather than once for every click
+	std::vector<CXWnd*> buttons = GetAdvLootListButtons(pList, columns);
+
+	for (const auto& [itemName, action] : actions)
+	{
+		int row = IsNumber(itemName) ? GetIntFromString(itemName, 0) - 1 : FindAdvLootRowByName(shared, itemName);
+		if (row < 0 || row >= pList->ItemsArray.Count)
+			continue;
+
+		int listindex = (int)pList->GetItemData(row);
+		if (listindex < 0 || listindex >= pItems->Items.GetSize())
+			continue;
+
+		if (shared && ci_equals(action, "leave"))
+		{
+			AdvancedLootItem& item = pItems->Items[listindex];
+			if (item.LootDetails.GetSize() && pLocalPC)
+			{
+				pAdvancedLootWnd->DoSharedAdvLootAction(item, pLocalPC->Name, true, item.LootDetails[0].StackCount);
+				++applied;
+			}
+			continue;
+		}
+
+		// like GetAdvLootPersonalListItem and GetAdvLootSharedListItem, the row is the list index
+		for (int column = 0; column < columns; ++column)
+		{
+			if (!ci_equals(action, columnActions[column]))
+				continue;
+
+			size_t button = static_cast<size_t>(listindex) * columns + column;
+			if (button < buttons.size() && buttons[button])
+			{
+				SendWndClick2(buttons[button], "leftmouseup");
+				++applied;
+			}
+			break;
+		}
+	}
+#endif
+
+	return applied;
+}
+
 void WeDidStuff()
 {
 	gbCommandEvent = 1;
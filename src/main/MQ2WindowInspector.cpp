@@ -3137,6 +3137,18 @@ public:
 					ImGui::Text("%d Windows", m_lastWindowCount);
 				}
 
+				ImGui::SameLine();
+				ImGui::SetNextItemWidth(80.0f);
+				if (ImGui::DragInt("##TreeRefresh", &m_treeRefreshMS, 10.0f, 50, 5000, "%d ms", ImGuiSliderFlags_AlwaysClamp))
+				{
+					m_nextTreeRefresh = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_treeRefreshMS);
+				}
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("How often the window tree is rebuilt from the UI.\n"
+						"Opening or closing a node, picking and selecting always rebuild it right away.");
+				}
+
 				DisplayWindowTree();
 			}
 			ImGui::End();
@@ -3314,8 +3326,166 @@ public:
 		}
 	}
 
+	// The tree is kept as a flat list of the rows that would be shown with the nodes that are open
+	// right now, so that only the rows that are scrolled into view are drawn. The list is rebuilt
+	// when a node is opened or closed, when the selection or pick needs a node opened, when a
+	// window is destroyed, and otherwise every m_treeRefreshMS.
+	struct WindowTreeRow
+	{
+		ImGuiID id = 0;
+		CXWnd* pWnd = nullptr;                   // null for a list row
+		CListWnd* pList = nullptr;               // for list rows
+		int listRow = 0;                         // for list rows, 1-based
+		int column = 0;                          // for the windows in a list's cells, 1-based
+		int depth = 0;
+		bool hasChildren = false;
+		bool open = false;
+	};
+
 	std::vector<std::pair<std::string_view, CXWnd*>> m_windows;
 	std::unordered_set<CXWnd*> m_traversedWindows;
+	std::vector<WindowTreeRow> m_treeRows;
+	bool m_treeDirty = true;
+	int m_treeRefreshMS = 250;
+	std::chrono::steady_clock::time_point m_nextTreeRefresh;
+
+	// Whether a node needs to be opened to show the window that was just picked or selected.
+	bool IsPickOrSelectionUnder(CXWnd* pWnd) const
+	{
+		if (m_pPickingWnd)
+			return m_pickWindowChanged && m_pPickingWnd->IsDescendantOf(pWnd);
+
+		if (m_pSelectedWnd && m_selectionChanged)
+			return m_pSelectedWnd->IsDescendantOf(pWnd);
+
+		return false;
+	}
+
+	void AddWindowTreeRows(CXWnd* pWnd, int depth, bool isRoot = false, int column = 0)
+	{
+		if (!isRoot)
+		{
+			if (!m_traversedWindows.insert(pWnd).second)
+				return;
+		}
+
+		WindowTreeRow& row = m_treeRows.emplace_back();
+		row.id = ImGui::GetID(pWnd);
+		row.pWnd = pWnd;
+		row.column = column;
+		row.depth = depth;
+		row.hasChildren = pWnd->GetFirstChildWnd() != nullptr;
+
+		if (!row.hasChildren)
+			return;
+
+		if (IsPickOrSelectionUnder(pWnd))
+			ImGui::GetStateStorage()->SetInt(row.id, 1);
+
+		row.open = ImGui::GetStateStorage()->GetInt(row.id, 0) != 0;
+		if (!row.open)
+			return;
+
+		// If this is a list box, then also traverse its child list windows.
+		if (pWnd->GetType() == UI_Listbox || pWnd->GetType() == UI_TreeView)
+		{
+			CListWnd* listWnd = static_cast<CListWnd*>(pWnd);
+			int rowNum = 0;
+
+			for (const SListWndLine& line : listWnd->ItemsArray)
+			{
+				++rowNum;
+
+				bool hasWndCell = false;
+				bool forceOpen = false;
+
+				for (const SListWndCell& cell : line.Cells)
+				{
+					if (cell.pWnd)
+					{
+						hasWndCell = true;
+
+						forceOpen |= IsPickOrSelectionUnder(cell.pWnd)
+							|| (!m_pPickingWnd && m_selectionChanged && m_pSelectedWnd == cell.pWnd);
+					}
+				}
+
+				if (!hasWndCell)
+					continue;
+
+				WindowTreeRow& listRow = m_treeRows.emplace_back();
+				ImGui::PushID(listWnd);
+				listRow.id = ImGui::GetID(rowNum);
+				ImGui::PopID();
+				listRow.pList = listWnd;
+				listRow.listRow = rowNum;
+				listRow.depth = depth + 1;
+				listRow.hasChildren = true;
+
+				if (forceOpen)
+					ImGui::GetStateStorage()->SetInt(listRow.id, 1);
+
+				listRow.open = ImGui::GetStateStorage()->GetInt(listRow.id, 0) != 0;
+
+				int colNum = 1;
+				for (const SListWndCell& cell : line.Cells)
+				{
+					if (listRow.open)
+					{
+						// The children of the list are stored in wrapper windows. They show up
+						// as Unknown types. We just skip past them.
+						if (cell.pWnd && cell.pWnd->GetFirstChildWnd())
+							AddWindowTreeRows(cell.pWnd, depth + 2, false, colNum);
+					}
+					else if (cell.pWnd)
+					{
+						m_traversedWindows.insert(cell.pWnd);
+					}
+
+					colNum++;
+				}
+			}
+		}
+
+		CXWnd* pChild = pWnd->GetFirstChildWnd();
+		while (pChild)
+		{
+			AddWindowTreeRows(pChild, depth + 1);
+			pChild = pChild->GetNextSiblingWnd();
+		}
+	}
+
+	void RebuildWindowTree()
+	{
+		m_windows.clear();
+		m_treeRows.clear();
+		m_traversedWindows.clear();
+
+		for (CXWnd* pWnd : pWndMgr->ParentAndContextMenuWindows)
+		{
+			if (pWnd->ParentWindow == nullptr
+				&& (pWnd->GetXMLData() != nullptr
+					|| pWnd->GetFirstChildWnd() != nullptr
+					|| !pWnd->GetWindowText().empty()
+					|| !pWnd->GetXMLName().empty()))
+			{
+				m_windows.emplace_back(std::string_view{ pWnd->GetXMLName() }, pWnd);
+			}
+		}
+
+		std::sort(std::begin(m_windows), std::end(m_windows),
+			[](const auto& l, const auto& r) { return ci_less()(l.first, r.first); });
+
+		for (const auto& [_, pWnd] : m_windows)
+		{
+			AddWindowTreeRows(pWnd, 0, true);
+		}
+
+		m_lastWindowCount = static_cast<int>(m_windows.size());
+
+		m_treeDirty = false;
+		m_nextTreeRefresh = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_treeRefreshMS);
+	}
 
 	void DisplayWindowTree()
 	{
@@ -3325,8 +3495,6 @@ public:
 			| ImGuiTableFlags_Resizable
 			| ImGuiTableFlags_RowBg;
 
-		m_traversedWindows.clear();
-
 		if (ImGui::BeginTable("##WindowTable", 2, tableFlags))
 		{
 			ImGui::TableSetupScrollFreeze(0, 1);
@@ -3334,57 +3502,82 @@ public:
 			ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_WidthFixed);
 			ImGui::TableHeadersRow();
 
-			m_windows.reserve(m_lastWindowCount);
-			m_lastWindowCount = 0;
-
-			if (pWndMgr)
+			if (!pWndMgr)
 			{
-				m_windows.clear();
+				m_treeRows.clear();
+				m_lastWindowCount = 0;
+			}
+			else if (m_treeDirty || m_selectionChanged || (m_picking && m_pickWindowChanged)
+				|| std::chrono::steady_clock::now() >= m_nextTreeRefresh)
+			{
+				RebuildWindowTree();
+			}
 
-				for (CXWnd* pWnd : pWndMgr->ParentAndContextMenuWindows)
-				{
-					if (pWnd->ParentWindow == nullptr
-						&& (pWnd->GetXMLData() != nullptr
-							|| pWnd->GetFirstChildWnd() != nullptr
-							|| !pWnd->GetWindowText().empty()
-							|| !pWnd->GetXMLName().empty()))
-					{
-						m_windows.emplace_back(std::string_view{ pWnd->GetXMLName() }, pWnd);
-					}
-				}
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(m_treeRows.size()));
 
-				std::sort(std::begin(m_windows), std::end(m_windows),
-					[](const auto& l, const auto& r) { return ci_less()(l.first, r.first); });
+			// the picked window is drawn even when it is out of view, so that it can scroll to itself
+			if (m_picking && m_pickWindowChanged && m_pPickingWnd)
+			{
+				auto iter = std::find_if(m_treeRows.begin(), m_treeRows.end(),
+					[this](const WindowTreeRow& row) { return row.pWnd == m_pPickingWnd; });
+				if (iter != m_treeRows.end())
+					clipper.IncludeItemByIndex(static_cast<int>(iter - m_treeRows.begin()));
+			}
 
-				for (const auto& [_, pWnd] : m_windows)
+			while (clipper.Step())
+			{
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
 				{
-					DisplayWindowTreeNode(pWnd, true);
-				}
+					// a node was opened or closed, the rest of the rows are out of date
+					if (m_treeDirty)
+						break;
 
-				m_lastWindowCount = static_cast<int>(m_windows.size());
+					DisplayWindowTreeRow(m_treeRows[i]);
+				}
 			}
 
 			ImGui::EndTable();
 		}
 	}
 
-	void DisplayWindowTreeNode(CXWnd* pWnd, bool isRoot = false, const char* nameOverride = nullptr)
+	void DisplayWindowTreeRow(const WindowTreeRow& row)
 	{
-		if (!isRoot)
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+
+		const float indent = row.depth * ImGui::GetStyle().IndentSpacing;
+		if (indent > 0)
+			ImGui::Indent(indent);
+
+		if (row.pList)
 		{
-			if (m_traversedWindows.count(pWnd) != 0)
-				return;
-			m_traversedWindows.insert(pWnd);
+			char label[32];
+			sprintf_s(label, "Row %d", row.listRow);
+
+			if (ImGui::TreeNodeBehavior(row.id, ImGuiTreeNodeFlags_NoTreePushOnOpen, label) != row.open)
+				m_treeDirty = true;
+		}
+		else
+		{
+			DisplayWindowTreeNode(row);
 		}
 
-		ImGui::TableNextRow();
-		ImGui::TableNextColumn();
+		if (indent > 0)
+			ImGui::Unindent(indent);
+	}
 
-		const bool hasChildren = pWnd->GetFirstChildWnd() != nullptr;
+	void DisplayWindowTreeNode(const WindowTreeRow& row)
+	{
+		CXWnd* pWnd = row.pWnd;
 
 		std::string_view name;
-		if (nameOverride != nullptr)
-			name = nameOverride;
+		char columnName[64];
+		if (row.column != 0)
+		{
+			sprintf_s(columnName, "Col %d", row.column);
+			name = columnName;
+		}
 		else
 			name = pWnd->GetXMLNameSv();
 		std::string_view typeName = pWnd->GetTypeNameSv();
@@ -3416,8 +3609,8 @@ public:
 		}
 #endif
 
-		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_SpanAvailWidth;
-		bool open = false;
+		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_SpanAvailWidth
+			| ImGuiTreeNodeFlags_NoTreePushOnOpen;
 		bool selected = (m_pLastSelected == pWnd);
 		bool selectPicking = false;
 
@@ -3435,31 +3628,14 @@ public:
 			flags |= ImGuiTreeNodeFlags_Selected;
 		}
 
-		if (!hasChildren)
+		if (!row.hasChildren)
 		{
-			flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+			flags |= ImGuiTreeNodeFlags_Leaf;
 		}
 
-		if (hasChildren)
-		{
-			if (m_pPickingWnd)
-			{
-				if (m_pPickingWnd->IsDescendantOf(pWnd))
-					flags |= ImGuiTreeNodeFlags_DefaultOpen;
-			}
-			else if (m_pSelectedWnd && m_selectionChanged)
-			{
-				if (m_pSelectedWnd->IsDescendantOf(pWnd))
-				{
-					ImGui::SetNextItemOpen(true);
-				}
-			}
-
-			open = ImGui::TreeNodeEx(pWnd, flags, "%.*s", name.length(), name.data());
-		}
-		else
+		if (ImGui::TreeNodeBehavior(row.id, flags, name.data(), name.data() + name.length()) != row.open && row.hasChildren)
 		{
-			ImGui::TreeNodeEx(pWnd, flags, "%.*s", name.length(), name.data());
+			m_treeDirty = true;
 		}
 
 		bool openNew = false;
@@ -3505,91 +3681,6 @@ public:
 
 		ImGui::TableNextColumn();
 		ImGui::TextUnformatted(typeName.data(), typeName.data() + typeName.length());
-
-		if (open)
-		{
-			// If this is a list box, then also traverse its child list windows.
-			if (pWnd->GetType() == UI_Listbox || pWnd->GetType() == UI_TreeView)
-			{
-				CListWnd* listWnd = static_cast<CListWnd*>(pWnd);
-				int rowNum = 0;
-
-				for (const SListWndLine& line : listWnd->ItemsArray)
-				{
-					bool hasWndCell = false;
-					int rowFlags = 0;
-					++rowNum;
-
-					for (const SListWndCell& cell : line.Cells)
-					{
-						if (cell.pWnd)
-						{
-							CXWnd* pListChildWnd = cell.pWnd;
-
-							if (m_pPickingWnd)
-							{
-								if (m_pPickingWnd->IsDescendantOf(pListChildWnd))
-									rowFlags |= ImGuiTreeNodeFlags_DefaultOpen;
-							}
-							else if (m_pSelectedWnd && m_selectionChanged)
-							{
-								if (m_pSelectedWnd == pListChildWnd
-									|| m_pSelectedWnd->IsDescendantOf(pListChildWnd))
-								{
-									ImGui::SetNextItemOpen(true);
-								}
-							}
-
-							hasWndCell = true;
-						}
-					}
-
-					if (!hasWndCell)
-						continue;
-
-					ImGui::TableNextRow();
-					ImGui::TableNextColumn();
-
-					if (ImGui::TreeNodeEx(&line, rowFlags, "Row %d", rowNum))
-					{
-						int colNum = 1;
-						for (const SListWndCell& cell : line.Cells)
-						{
-							// The children of the list are stored in wrapper windows. They show up
-							// as Unknown types. We just skip past them.
-							if (cell.pWnd && cell.pWnd->GetFirstChildWnd())
-							{
-								CXWnd* pListChildWnd = cell.pWnd;
-
-								char columnName[64];
-								sprintf_s(columnName, "Col %d", colNum);
-
-								DisplayWindowTreeNode(pListChildWnd, false, columnName);
-							}
-							colNum++;
-						}
-						ImGui::TreePop();
-					}
-					else
-					{
-						for (const SListWndCell& cell : line.Cells)
-						{
-							if (cell.pWnd)
-								m_traversedWindows.insert(cell.pWnd);
-						}
-					}
-				}
-			}
-
-			CXWnd* pChild = pWnd->GetFirstChildWnd();
-			while (pChild)
-			{
-				DisplayWindowTreeNode(pChild);
-				pChild = pChild->GetNextSiblingWnd();
-			}
-
-			ImGui::TreePop();
-		}
 	}
 
 	void OnWindowRemoved(CXWnd* pWnd)
@@ -3610,6 +3701,9 @@ public:
 		if (m_pLastSelected == pWnd)
 			m_pLastSelected = nullptr;
 
+		// The tree rows hold on to the window, so don't draw them again until they are rebuilt.
+		m_treeDirty = true;
+
 		RemoveWindowInspector(pWnd);
 	}
 
@@ -58,6 +58,60 @@ std::vector<std::string> XmlFiles;
 
 int WinCount = 0;
 
+// Children found by FindMQ2WindowChild, by parent and then by name, so that a lookup that is done
+// every frame by a macro or a HUD doesn't walk the parent's whole subtree each time. The windows
+// that a child was found under are kept alongside, so that destroying a child can drop it quickly.
+static std::unordered_map<CXWnd*, ci_unordered::map<std::string, CXWnd*>> s_childIndex;
+static std::unordered_multimap<CXWnd*, CXWnd*> s_childIndexParents;
+
+static void DropWindowFromChildIndex(CXWnd* pWnd)
+{
+	// as a parent
+	auto parentIter = s_childIndex.find(pWnd);
+	if (parentIter != s_childIndex.end())
+	{
+		for (const auto& [name, pChild] : parentIter->second)
+		{
+			auto range = s_childIndexParents.equal_range(pChild);
+			for (auto it = range.first; it != range.second;)
+			{
+				if (it->second == pWnd)
+					it = s_childIndexParents.erase(it);
+				else
+					++it;
+			}
+		}
+
+		s_childIndex.erase(parentIter);
+	}
+
+	// as a child
+	auto range = s_childIndexParents.equal_range(pWnd);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		auto iter = s_childIndex.find(it->second);
+		if (iter == s_childIndex.end())
+			continue;
+
+		auto& children = iter->second;
+		for (auto childIter = children.begin(); childIter != children.end();)
+		{
+			if (childIter->second == pWnd)
+				childIter = children.erase(childIter);
+			else
+				++childIter;
+		}
+	}
+
+	s_childIndexParents.erase(pWnd);
+}
+
+void ClearWindowChildIndex()
+{
+	s_childIndex.clear();
+	s_childIndexParents.clear();
+}
+
 static bool GenerateMQUI(const CXStr& strPath, const CXStr& strPathDefault);
 static void DestroyMQUI(const CXStr& strPath);
 
@@ -160,6 +214,9 @@ public:
 				WindowList.erase(windowListIter);
 			}
 
+			if (!s_childIndexParents.empty())
+				DropWindowFromChildIndex(pWnd);
+
 			DeveloperTools_WindowInspector_RemoveWindow(pWnd);
 		}
 
@@ -193,6 +250,7 @@ void ReinitializeWindowList()
 {
 	WindowList.clear();
 	WindowMap.clear();
+	ClearWindowChildIndex();
 
 	InitializeWindowList();
 }
@@ -459,13 +517,53 @@ CXWnd* FindMQ2WindowPath(const char* WindowName)
 
 	while (head = strtok_s(nullptr, "/", &context))
 	{
-		pWindow = pWindow->GetChildItem(head);
+		pWindow = FindMQ2WindowChild(pWindow, head);
 		if (!pWindow) break;
 	}
 
 	return pWindow;
 }
 
+CXWnd* FindMQ2WindowChild(CXWnd* pParent, const char* Name)
+{
+	if (!pParent || !Name || !Name[0])
+		return nullptr;
+
+	// kept around so that a lookup doesn't allocate a key
+	static std::string s_lookupName;
+	s_lookupName = Name;
+
+	auto parentIter = s_childIndex.find(pParent);
+	if (parentIter != s_childIndex.end())
+	{
+		auto iter = parentIter->second.find(s_lookupName);
+		if (iter != parentIter->second.end())
+		{
+			CXWnd* pChild = iter->second;
+
+			// Children can be moved to another parent, so make sure it's still under this one.
+			CXWnd* pAncestor = pChild->GetParentWindow();
+			while (pAncestor && pAncestor != pParent)
+				pAncestor = pAncestor->GetParentWindow();
+
+			if (pAncestor == pParent)
+				return pChild;
+
+			DropWindowFromChildIndex(pChild);
+		}
+	}
+
+	// Only hits are kept. A miss could be a child that hasn't been created yet.
+	CXWnd* pChild = pParent->GetChildItem(Name);
+	if (pChild)
+	{
+		s_childIndex[pParent].emplace(s_lookupName, pChild);
+		s_childIndexParents.emplace(pChild, pParent);
+	}
+
+	return pChild;
+}
+
 CXWnd* FindMQ2Window(const char* Name)
 {
 	if (strchr(Name, '/'))
@@ -679,7 +777,7 @@ bool SendWndClick(const char* WindowName, const char* ScreenID, const char* Clic
 		}
 		else
 		{
-			pButton = pWnd->GetChildItem(ScreenID);
+			pButton = FindMQ2WindowChild(pWnd, ScreenID);
 		}
 
 		if (!pButton)
@@ -769,7 +867,7 @@ bool SendListSelect(const char* WindowName, const char* ScreenID, int Value)
 
 	if (ScreenID && ScreenID[0] && ScreenID[0] != '0')
 	{
-		pWnd = pWnd->GetChildItem(ScreenID);
+		pWnd = FindMQ2WindowChild(pWnd, ScreenID);
 		if (!pWnd)
 		{
 			MacroError("Window '%s' child '%s' not found.", WindowName, ScreenID);
@@ -907,7 +1005,7 @@ bool SendComboSelect(const char* WindowName, const char* ScreenID, int Value)
 
 	if (ScreenID && ScreenID[0] && ScreenID[0] != '0')
 	{
-		pWnd = pWnd->GetChildItem(ScreenID);
+		pWnd = FindMQ2WindowChild(pWnd, ScreenID);
 		if (!pWnd)
 		{
 			MacroError("Window '%s' child '%s' not found.", WindowName, ScreenID);
@@ -1374,6 +1472,8 @@ bool CheckLootArg(char* arg, char* search, int argcnt, int* slot)
 
 void ItemNotify(PSPAWNINFO pChar, char* szLine)
 {
+	InvalidateInventoryIndex();
+
 	char szArg1[MAX_STRING] = { 0 };
 	char szArg2[MAX_STRING] = { 0 };
 	char szArg3[MAX_STRING] = { 0 };
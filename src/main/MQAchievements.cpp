@@ -15,6 +15,7 @@
 #include "pch.h"
 
 #include <mq/api/Achievements.h>
+#include <mq/base/String.h>
 
 namespace mq {
 
@@ -28,6 +29,53 @@ static eqlib::AchievementComponentType validComponentTypes[] = {
 	eqlib::AchievementComponentDisplay,
 };
 
+// Achievements and components by name. The achievement data is loaded once, but not until after
+// we are, so the index is checked against the loaded data on each use and rebuilt if it differs.
+struct AchievementNameIndex
+{
+	int count = 0;
+	const eqlib::Achievement* first = nullptr;
+	ci_unordered::map<std::string, int> achievements;
+	std::unordered_map<const eqlib::Achievement*, ci_unordered::map<std::string, const eqlib::AchievementComponent*>> components;
+
+	void Update(eqlib::AchievementManager& mgr)
+	{
+		const int newCount = mgr.GetAchievementCount();
+		const eqlib::Achievement* newFirst = newCount > 0 ? mgr.GetAchievementByIndex(0) : nullptr;
+		if (newCount == count && newFirst == first)
+			return;
+
+		count = newCount;
+		first = newFirst;
+		achievements.clear();
+		components.clear();
+
+		for (int index = 0; index < count; ++index)
+		{
+			// the first achievement with a name wins
+			if (const eqlib::Achievement* achievement = mgr.GetAchievementByIndex(index))
+				achievements.emplace(achievement->name.c_str(), index);
+		}
+	}
+
+	const ci_unordered::map<std::string, const eqlib::AchievementComponent*>& GetComponents(const eqlib::Achievement* achievement)
+	{
+		auto [iter, created] = components.try_emplace(achievement);
+		if (created)
+		{
+			for (eqlib::AchievementComponentType componentType : validComponentTypes)
+			{
+				// the first component with a description wins, in the order of validComponentTypes
+				for (const eqlib::AchievementComponent& component : achievement->componentsByType[componentType])
+					iter->second.emplace(component.description.c_str(), &component);
+			}
+		}
+
+		return iter->second;
+	}
+};
+static AchievementNameIndex s_achievementIndex;
+
 static int GetAchievementIndexFromAchievement(const eqlib::Achievement* achievement)
 {
 	if (!achievement) return -1;
@@ -44,12 +92,24 @@ static int GetAchievementIndexFromAchievement(const eqlib::Achievement* achievem
 	return iter2->second;
 }
 
+int GetAchievementIndexByName(std::string_view name)
+{
+	eqlib::AchievementManager& mgr = eqlib::AchievementManager::Instance();
+	s_achievementIndex.Update(mgr);
+
+	auto iter = s_achievementIndex.achievements.find(std::string(name));
+	if (iter == s_achievementIndex.achievements.end())
+		return -1;
+
+	return iter->second;
+}
+
 const eqlib::Achievement* GetAchievementByName(std::string_view name)
 {
 	eqlib::AchievementManager& mgr = eqlib::AchievementManager::Instance();
 	const eqlib::Achievement* achievement = nullptr;
 
-	int index = mgr.GetAchievementIndexByName(name);
+	int index = GetAchievementIndexByName(name);
 	if (index >= 0)
 	{
 		achievement = mgr.GetAchievementByIndex(index);
@@ -98,16 +158,14 @@ const eqlib::AchievementComponent* GetAchievementComponentByDescription(const eq
 {
 	if (!achievement) return nullptr;
 
-	for (eqlib::AchievementComponentType componentType : validComponentTypes)
-	{
-		for (const eqlib::AchievementComponent& component : achievement->componentsByType[componentType])
-		{
-			if (ci_equals(component.description, description))
-				return &component;
-		}
-	}
+	s_achievementIndex.Update(eqlib::AchievementManager::Instance());
 
-	return nullptr;
+	const auto& components = s_achievementIndex.GetComponents(achievement);
+	auto iter = components.find(std::string(description));
+	if (iter == components.end())
+		return nullptr;
+
+	return iter->second;
 }
 
 // Get an achievement component by id
@@ -101,9 +101,16 @@ void MQActorAPI::SendToActor(
 				// no need to store this message in the message storage since we know it
 				// can't be replied to -- which means we also don't need the custom deleter
 				// assume that the sender is the address we sent to
-				if (message->GetMessageId() == MQMessageId::MSG_ROUTE)
+				if (message == nullptr)
 				{
-					auto envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
+					// the request failed before anything came back: timed out, or the connection closed
+					callback(status, nullptr);
+				}
+				else if (message->GetMessageId() == MQMessageId::MSG_ROUTE)
+				{
+					proto::routing::Envelope envelope;
+					std::string_view payload;
+					OpenEnvelope(*message, envelope, payload);
 
 					std::optional<postoffice::Address> sender;
 					if (envelope.has_return_address())
@@ -121,8 +128,8 @@ void MQActorAPI::SendToActor(
 					}
 
 					std::optional<std::string> data;
-					if (envelope.has_payload())
-						data = envelope.payload();
+					if (payload.data() != nullptr)
+						data = std::string(payload);
 
 					callback(status, std::shared_ptr<postoffice::Message>(
 						new postoffice::Message{ message.get(), sender, data }));
@@ -139,13 +146,17 @@ void MQActorAPI::SendToActor(
 	// ambiguity in the mailbox, the router to check for ambiguity in the client address, and
 	// the receiving post office to check local ambiguity in the mailbox _for RPC messages
 	// only_
-	if (dropbox != nullptr)
+	if (dropbox != nullptr && address.Key)
+	{
+		dropbox->PostLatest(addr, *address.Key, data, pipe_callback);
+	}
+	else if (dropbox != nullptr)
 	{
 		dropbox->Post(addr, data, pipe_callback);
 	}
 	else
 	{
-		GetPostOffice().RouteMessage(addr, data, pipe_callback);
+		GetPostOffice().RouteMessage(addr, std::string(), data, address.Key.value_or(""), pipe_callback);
 	}
 }
 
@@ -19,12 +19,67 @@
 
 namespace mq {
 
-std::vector<std::weak_ptr<MQTransient>> s_objectMap;
 std::mutex s_objectMapMutex;
 uint32_t bmParseMacroData;
 
+// Bumped any time a cached member lookup could have become stale.
+static std::atomic<uint32_t> s_dataTypeGeneration = 1;
+
+static void BumpDataTypeGeneration()
+{
+	s_dataTypeGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t GetDataTypeGeneration()
+{
+	return s_dataTypeGeneration.load(std::memory_order_relaxed);
+}
+
+// When a bound member is evaluated, the lookups are published here for the duration of the
+// GetMember call. FindMember and FindMethod check it first, which lets the existing GetMember
+// implementations skip their lookups without having to change.
+struct MQMemberLookupHint
+{
+	const MQ2Type* Type = nullptr;
+	const char* Name = nullptr;
+	MQTypeMember* Member = nullptr;
+	MQTypeMember* Method = nullptr;
+	uint32_t Generation = 0;
+};
+static thread_local MQMemberLookupHint s_memberLookupHint;
+
+class MQMemberLookupScope
+{
+public:
+	MQMemberLookupScope(const MQMemberLookupHint& hint)
+		: m_saved(std::exchange(s_memberLookupHint, hint))
+	{
+	}
+
+	~MQMemberLookupScope()
+	{
+		s_memberLookupHint = m_saved;
+	}
+
+private:
+	MQMemberLookupHint m_saved;
+};
+
+static const MQMemberLookupHint* GetMemberLookupHint(const MQ2Type* type, const char* name)
+{
+	// Names are compared by address, the hint is only for the exact string passed to GetMember.
+	if (s_memberLookupHint.Type == type
+		&& s_memberLookupHint.Name == name
+		&& s_memberLookupHint.Generation == GetDataTypeGeneration())
+	{
+		return &s_memberLookupHint;
+	}
+
+	return nullptr;
+}
+
 static void SetGameStateDataAPI(DWORD);
-static void UnloadPluginDataAPI(const char*);
+static void PulseDataAPI();
 
 
 static MQModule s_DataAPIModule = {
@@ -32,7 +87,7 @@ static MQModule s_DataAPIModule = {
 	false,                          // CanUnload
 	nullptr,
 	nullptr,
-	nullptr,
+	PulseDataAPI,
 	SetGameStateDataAPI,
 	nullptr,
 	nullptr,
@@ -42,75 +97,354 @@ static MQModule s_DataAPIModule = {
 	nullptr,
 	nullptr,
 	nullptr,
-	UnloadPluginDataAPI
+	nullptr
 };
 MQModule* GetDataAPIModule() { return &s_DataAPIModule; }
 
 //============================================================================
 // Observed objects (Why are these here under MQDataAPI?)
 
-// This guarantees the validity of all weak pointers inside the map, while keeping the size from growing without bound as we add pointers
-static void PruneObservedEQObjects()
+// Every observed object has a slot here from the time it is created until it is destroyed, so the
+// table never holds on to an object. Slots that watch the same address are chained together, which
+// makes invalidating an address a single lookup. A handle is the slot index plus the generation of
+// the slot, so a handle for a slot that has been reused is recognized as stale.
+class ObservedObjectTable
 {
-	std::scoped_lock lock(s_objectMapMutex);
+public:
+	uint64_t Add(MQTransient* object, void* address)
+	{
+		uint32_t index;
+		if (m_freeHead != InvalidIndex)
+		{
+			index = m_freeHead;
+			m_freeHead = m_slots[index].Next;
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+		}
+
+		Slot& slot = m_slots[index];
+		slot.Object = object;
+		slot.Address = nullptr;
+		slot.Prev = slot.Next = InvalidIndex;
+
+		if (address)
+			Link(index, address);
+
+		return MakeHandle(index, slot.Generation);
+	}
+
+	void Remove(uint64_t handle)
+	{
+		const uint32_t index = static_cast<uint32_t>(handle & 0xffffffff);
+		if (index >= m_slots.size() || m_slots[index].Generation != static_cast<uint32_t>(handle >> 32))
+			return;
 
-	s_objectMap.erase(std::remove_if(
-		std::begin(s_objectMap),
-		std::end(s_objectMap),
-		[](const std::weak_ptr<MQTransient>& weak)
+		Unlink(index);
+
+		Slot& slot = m_slots[index];
+		slot.Object = nullptr;
+		++slot.Generation;
+		slot.Next = m_freeHead;
+		m_freeHead = index;
+	}
+
+	void Invalidate(void* address)
+	{
+		auto iter = m_byAddress.find(address);
+		if (iter == m_byAddress.end())
+			return;
+
+		// an invalidated object can't be invalidated again, so the whole chain is unlinked
+		uint32_t index = iter->second;
+		m_byAddress.erase(iter);
+
+		while (index != InvalidIndex)
 		{
-			return weak.expired();
-		}),
-		std::end(s_objectMap));
-}
+			Slot& slot = m_slots[index];
+			const uint32_t next = slot.Next;
 
-static void SetGameStateDataAPI(DWORD)
+			slot.Object->Invalidate();
+			slot.Address = nullptr;
+			slot.Prev = slot.Next = InvalidIndex;
+
+			index = next;
+		}
+	}
+
+	void InvalidateAll()
+	{
+		for (auto& [address, head] : m_byAddress)
+		{
+			for (uint32_t index = head; index != InvalidIndex;)
+			{
+				Slot& slot = m_slots[index];
+				const uint32_t next = slot.Next;
+
+				slot.Object->Invalidate();
+				slot.Address = nullptr;
+				slot.Prev = slot.Next = InvalidIndex;
+
+				index = next;
+			}
+		}
+
+		m_byAddress.clear();
+	}
+
+private:
+	static constexpr uint32_t InvalidIndex = 0xffffffff;
+
+	struct Slot
+	{
+		MQTransient* Object = nullptr;
+		void* Address = nullptr;         // null once invalidated, or while the slot is free
+		uint32_t Generation = 1;         // so that no handle is ever 0
+		uint32_t Prev = InvalidIndex;    // chain of slots with the same address
+		uint32_t Next = InvalidIndex;    // same chain, or the free list while the slot is free
+	};
+
+	static uint64_t MakeHandle(uint32_t index, uint32_t generation)
+	{
+		return (static_cast<uint64_t>(generation) << 32) | index;
+	}
+
+	void Link(uint32_t index, void* address)
+	{
+		Slot& slot = m_slots[index];
+		slot.Address = address;
+
+		auto [iter, inserted] = m_byAddress.emplace(address, index);
+		if (!inserted)
+		{
+			slot.Next = iter->second;
+			m_slots[iter->second].Prev = index;
+			iter->second = index;
+		}
+	}
+
+	void Unlink(uint32_t index)
+	{
+		Slot& slot = m_slots[index];
+		if (!slot.Address)
+			return;
+
+		if (slot.Prev != InvalidIndex)
+			m_slots[slot.Prev].Next = slot.Next;
+		else if (slot.Next != InvalidIndex)
+			m_byAddress[slot.Address] = slot.Next;
+		else
+			m_byAddress.erase(slot.Address);
+
+		if (slot.Next != InvalidIndex)
+			m_slots[slot.Next].Prev = slot.Prev;
+
+		slot.Address = nullptr;
+		slot.Prev = slot.Next = InvalidIndex;
+	}
+
+	std::vector<Slot> m_slots;
+	std::unordered_map<void*, uint32_t> m_byAddress;
+	uint32_t m_freeHead = InvalidIndex;
+};
+static ObservedObjectTable s_observedObjects;
+
+// Observed objects come in a handful of sizes, each of which gets its own free list. Memory is
+// carved out of slabs and reused, it is not given back.
+class ObservedObjectPool
 {
-	PruneObservedEQObjects();
+public:
+	void* Allocate(size_t size)
+	{
+		SizeClass& sizeClass = m_sizeClasses[RoundSize(size)];
+		if (sizeClass.Free.empty())
+		{
+			const size_t slotSize = RoundSize(size);
+			auto slab = std::make_unique<std::byte[]>(slotSize * SlabCount);
 
-	std::scoped_lock lock(s_objectMapMutex);
+			for (size_t i = 0; i < SlabCount; ++i)
+				sizeClass.Free.push_back(slab.get() + (SlabCount - 1 - i) * slotSize);
+
+			sizeClass.Slabs.push_back(std::move(slab));
+		}
+
+		void* ptr = sizeClass.Free.back();
+		sizeClass.Free.pop_back();
+		return ptr;
+	}
 
-	for (const auto& weak : s_objectMap)
+	void Free(void* ptr, size_t size)
 	{
-		weak.lock()->Invalidate();
+		m_sizeClasses[RoundSize(size)].Free.push_back(ptr);
 	}
+
+private:
+	static constexpr size_t SlabCount = 64;
+
+	static size_t RoundSize(size_t size)
+	{
+		constexpr size_t alignment = alignof(std::max_align_t);
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	struct SizeClass
+	{
+		std::vector<void*> Free;
+		std::vector<std::unique_ptr<std::byte[]>> Slabs;
+	};
+	std::unordered_map<size_t, SizeClass> m_sizeClasses;
+};
+static ObservedObjectPool s_observedObjectPool;
+
+static void SetGameStateDataAPI(DWORD)
+{
+	std::scoped_lock lock(s_objectMapMutex);
+
+	s_observedObjects.InvalidateAll();
 }
 
-// don't need a dropper because it will remove itself once the shared_ptr destroys itself
-void AddObservedEQObject(const std::shared_ptr<MQTransient>& Object)
+uint64_t AddObservedEQObject(MQTransient* Object, void* Address)
 {
-	PruneObservedEQObjects();
+	std::scoped_lock lock(s_objectMapMutex);
+
+	return s_observedObjects.Add(Object, Address);
+}
 
+void RemoveObservedEQObject(uint64_t Handle)
+{
 	std::scoped_lock lock(s_objectMapMutex);
 
-	s_objectMap.emplace_back(Object);
+	s_observedObjects.Remove(Handle);
 }
 
-// but we do need an invalidation method, which takes a void pointer because all we need to care about is the address of the object being invalidated
-void InvalidateObservedEQObject(void* Object)
+void* AllocateObservedEQObject(size_t Size)
 {
-	PruneObservedEQObjects();
+	std::scoped_lock lock(s_objectMapMutex);
+
+	return s_observedObjectPool.Allocate(Size);
+}
 
+void FreeObservedEQObject(void* Ptr, size_t Size)
+{
 	std::scoped_lock lock(s_objectMapMutex);
 
-	for (const auto& weak : s_objectMap)
-	{
-		if (*weak.lock() == Object)
-			weak.lock()->Invalidate();
-	}
+	s_observedObjectPool.Free(Ptr, Size);
 }
 
-void UnloadPluginDataAPI(const char* Name)
+// takes a void pointer because all we need to care about is the address of the object being invalidated
+void InvalidateObservedEQObject(void* Object)
 {
-	// if we attempt to prune objects held by plugins after the plugin
-	// is unloaded, we get a crash. Force a pruning every time a plugin
-	// is unloaded to prevent that.
-	PruneObservedEQObjects();
+	std::scoped_lock lock(s_objectMapMutex);
+
+	s_observedObjects.Invalidate(Object);
 }
 
 //============================================================================
 //============================================================================
 
+// A perfect hash of names built from a fixed set: each name has a slot of its own, so a lookup
+// hashes the name once and compares against one entry. Values are also indexed by ID.
+class MQNameLookupTable
+{
+public:
+	struct Entry
+	{
+		const char* Name;
+		void* Value;
+		int ID;
+	};
+
+	explicit MQNameLookupTable(std::vector<Entry> entries, size_t idCount = 0)
+	{
+		size_t size = 16;
+		while (size < entries.size() * 2)
+			size *= 2;
+
+		// a seed without collisions is almost always found in the first few tries, growing the
+		// table just guarantees that we stop
+		while (!TryBuild(entries, size))
+			size *= 2;
+
+		m_byID.resize(idCount, nullptr);
+		for (const Entry& entry : entries)
+		{
+			if (entry.ID >= 0 && static_cast<size_t>(entry.ID) < idCount)
+				m_byID[entry.ID] = entry.Value;
+		}
+	}
+
+	const Entry* Find(const char* name) const
+	{
+		if (!name)
+			return nullptr;
+
+		const Entry& entry = m_slots[Hash(name, m_seed) & m_mask];
+		if (entry.Name != nullptr && strcmp(entry.Name, name) == 0)
+			return &entry;
+
+		return nullptr;
+	}
+
+	void* FindValue(const char* name) const
+	{
+		const Entry* entry = Find(name);
+		return entry ? entry->Value : nullptr;
+	}
+
+	void* GetByID(int id) const
+	{
+		if (id < 0 || static_cast<size_t>(id) >= m_byID.size())
+			return nullptr;
+
+		return m_byID[id];
+	}
+
+private:
+	static uint32_t Hash(const char* name, uint32_t seed)
+	{
+		uint32_t hash = 2166136261u ^ seed;
+		for (; *name; ++name)
+			hash = (hash ^ static_cast<uint8_t>(*name)) * 16777619u;
+
+		return hash ^ (hash >> 15);
+	}
+
+	bool TryBuild(const std::vector<Entry>& entries, size_t size)
+	{
+		for (uint32_t seed = 0; seed < 64; ++seed)
+		{
+			m_slots.assign(size, Entry{ nullptr, nullptr, -1 });
+			m_mask = static_cast<uint32_t>(size - 1);
+			m_seed = seed * 0x9e3779b9u;
+
+			bool collision = false;
+			for (const Entry& entry : entries)
+			{
+				Entry& slot = m_slots[Hash(entry.Name, m_seed) & m_mask];
+				if (slot.Name != nullptr)
+				{
+					collision = true;
+					break;
+				}
+
+				slot = entry;
+			}
+
+			if (!collision)
+				return true;
+		}
+
+		return false;
+	}
+
+	std::vector<Entry> m_slots;
+	std::vector<void*> m_byID;
+	uint32_t m_mask = 0;
+	uint32_t m_seed = 0;
+};
+
 namespace datatypes {
 	void RegisterDataTypes();
 	void UnregisterDataTypes();
@@ -150,6 +484,12 @@ bool MQDataAPI::AddDataType(MQ2Type& Type, MQPlugin* Owner)
 	// element, and a bool indicating if it was actually inserted.
 	// this will not replace existing elements.
 	auto result = m_dataTypeMap.emplace(Type.GetName(), &Type);
+	if (result.second)
+	{
+		m_dataTypeTable = nullptr;
+		BumpDataTypeGeneration();
+	}
+
 	return result.second;
 }
 
@@ -169,18 +509,34 @@ bool MQDataAPI::RemoveDataType(MQ2Type& Type, MQPlugin* Owner)
 
 	// The type existed. Erase it.
 	m_dataTypeMap.erase(iter);
+	m_dataTypeTable = nullptr;
+	BumpDataTypeGeneration();
 	return true;
 }
 
-MQ2Type* MQDataAPI::FindDataType(const char* Name) const
+const MQNameLookupTable* MQDataAPI::GetDataTypeTable() const
 {
+	if (const MQNameLookupTable* table = m_dataTypeTable.load(std::memory_order_acquire))
+		return table;
+
 	std::scoped_lock lock(m_mutex);
 
-	auto iter = m_dataTypeMap.find(Name);
-	if (iter == m_dataTypeMap.end())
-		return nullptr;
+	if (const MQNameLookupTable* table = m_dataTypeTable.load(std::memory_order_acquire))
+		return table;
+
+	std::vector<MQNameLookupTable::Entry> entries;
+	entries.reserve(m_dataTypeMap.size());
+	for (const auto& [name, type] : m_dataTypeMap)
+		entries.push_back({ name.c_str(), type, -1 });
+
+	m_lookupTables.push_back(std::make_unique<MQNameLookupTable>(std::move(entries)));
+	m_dataTypeTable.store(m_lookupTables.back().get(), std::memory_order_release);
+	return m_lookupTables.back().get();
+}
 
-	return iter->second;
+MQ2Type* MQDataAPI::FindDataType(const char* Name) const
+{
+	return static_cast<MQ2Type*>(GetDataTypeTable()->FindValue(Name));
 }
 
 bool MQDataAPI::AddTopLevelObject(const char* szName, MQTopLevelObjectFunction Function, MQPlugin* owner)
@@ -197,9 +553,15 @@ bool MQDataAPI::AddTopLevelObject(const char* szName, MQTopLevelObjectFunction F
 	newItem->Name = szName;
 	newItem->Function = std::move(Function);
 	newItem->Owner = owner;
+	newItem->ID = static_cast<int>(m_tloByID.size());
+	m_tloByID.push_back(newItem.get());
 
 	// put the new item into the map
 	m_tloMap.emplace(szName, std::move(newItem));
+	m_tloTable = nullptr;
+
+	// a bound chain that didn't find this name has to look again
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -211,19 +573,47 @@ bool MQDataAPI::RemoveTopLevelObject(const char* szName, MQPlugin* owner)
 	if (iter == m_tloMap.end())
 		return false;
 
+	m_tloByID[iter->second->ID] = nullptr;
 	m_tloMap.erase(iter);
+	m_tloTable = nullptr;
+	BumpDataTypeGeneration();
 	return true;
 }
 
-MQTopLevelObject* MQDataAPI::FindTopLevelObject(const char* szName) const
+const MQNameLookupTable* MQDataAPI::GetTopLevelObjectTable() const
 {
+	if (const MQNameLookupTable* table = m_tloTable.load(std::memory_order_acquire))
+		return table;
+
 	std::scoped_lock lock(m_mutex);
 
-	auto iter = m_tloMap.find(szName);
-	if (iter == m_tloMap.end())
-		return nullptr;
+	if (const MQNameLookupTable* table = m_tloTable.load(std::memory_order_acquire))
+		return table;
+
+	std::vector<MQNameLookupTable::Entry> entries;
+	entries.reserve(m_tloMap.size());
+	for (const auto& [name, tlo] : m_tloMap)
+		entries.push_back({ tlo->Name.c_str(), tlo.get(), tlo->ID });
+
+	m_lookupTables.push_back(std::make_unique<MQNameLookupTable>(std::move(entries), m_tloByID.size()));
+	m_tloTable.store(m_lookupTables.back().get(), std::memory_order_release);
+	return m_lookupTables.back().get();
+}
+
+MQTopLevelObject* MQDataAPI::FindTopLevelObject(const char* szName) const
+{
+	return static_cast<MQTopLevelObject*>(GetTopLevelObjectTable()->FindValue(szName));
+}
 
-	return iter->second.get();
+int MQDataAPI::FindTopLevelObjectID(const char* szName) const
+{
+	const MQNameLookupTable::Entry* entry = GetTopLevelObjectTable()->Find(szName);
+	return entry ? entry->ID : -1;
+}
+
+MQTopLevelObject* MQDataAPI::GetTopLevelObject(int id) const
+{
+	return static_cast<MQTopLevelObject*>(GetTopLevelObjectTable()->GetByID(id));
 }
 
 
@@ -238,6 +628,7 @@ bool MQDataAPI::AddTypeExtension(const char* szName, MQ2Type* extension, MQPlugi
 
 	// insert extension into the record
 	record.push_back(extension);
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -261,6 +652,7 @@ bool MQDataAPI::RemoveTypeExtension(const char* szName, MQ2Type* extension, MQPl
 	if (record.empty())
 		m_typeExtensions.erase(iter);
 
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -342,6 +734,40 @@ MQDataAPI::EvaluateResult MQDataAPI::EvaluateMacroDataMember(MQ2Type* type, MQVa
 	return EvaluateResult::Failure;
 }
 
+// Same as EvaluateMacroDataMember, but reuses the lookups made the last time this step was
+// evaluated against the same type.
+MQDataAPI::EvaluateResult MQDataAPI::EvaluateBoundMember(MQ2Type* type, MQVarPtr& VarPtr,
+	MQTypeVar& Result, const MQDataChainStep& step, char* pIndex) const
+{
+	MQDataChainStep::Binding& bound = step.Bound;
+	const uint32_t generation = GetDataTypeGeneration();
+
+	if (bound.Type != type || bound.Generation != generation)
+	{
+		bound.Type = type;
+		bound.Member = type->FindMember(step.Name);
+		bound.Method = type->FindMethod(step.Name);
+		bound.HasExtensions = m_typeExtensions.find(type->GetName()) != m_typeExtensions.end();
+		bound.Generation = generation;
+	}
+
+	// Extensions are resolved in order by name, let the general path handle them.
+	if (bound.HasExtensions)
+		return EvaluateMacroDataMember(type, VarPtr, Result, step.Name, pIndex, false);
+
+	{
+		MQMemberLookupScope scope({ type, step.Name.c_str(), bound.Member, bound.Method, generation });
+
+		if (type->GetMember(std::move(VarPtr), step.Name.c_str(), pIndex, Result))
+			return EvaluateResult::Success;
+	}
+
+	if (!bound.Member && !type->InheritedMember(step.Name))
+		return EvaluateResult::NotFound;
+
+	return EvaluateResult::Failure;
+}
+
 static void DumpWarning(const char* pStart, int index)
 {
 	if (MQMacroBlockPtr pBlock = GetCurrentMacroBlock())
@@ -817,58 +1243,316 @@ bool MQDataAPI::ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const
 	}
 }
 
-/**
- * @fn FindMacroClosingBrace
- *
- * @brief Finds the brace that matches from the start position. Returns the match position
- *
- * This is a replication of the original logic for finding the matching brace in MQ2.  It does
- * not allow for escape characters and there is some weird logic to it (for example, quoted
- * strings only last until a close bracket) but I've duplicated it here for backwards
- * compatibility.
- *
- * This will start at the position specified and try to find the matching closing brace.
- * If the match has been found, the function will return the location of that match.  If it
- * cannot be found, returns std::string::npos to match what find() would return.
- *
- * This makes the assumption that you'll be calling it on a position just before ${ since
- * we're trying to match a macro's closing braces and all macro variables start with ${.
- *
- * @param strOrigString The string that you would like to check
- * @param iCurrentPosition The position to start at in the string (allows for starting
- *        in the middle to get an interior match)
- *
- * @return size_t position of the matching brace (or npos if no match found)
- */
-size_t FindMacroClosingBrace(std::string_view strOrigString, size_t iCurrentPosition)
+bool MQDataAPI::EvaluateDataChain(const std::vector<MQDataChainStep>& chain, MQTypeVar& Result) const
 {
-	// Setup our needed trackers
-	int iBraceTracker = 0; // Track {
-	bool bQuoteTracker = false; // Track "
-	bool bParamTracker = false; // Track parameters ([ & ,)
-
-	// We already know what the first two characters are going to be so let's jump to the new position + 2.
-	iCurrentPosition += 2;
+	Result.Type = nullptr;
+	Result.Int64 = 0;
 
-	// Since we skipped the brace, let's increment that.
-	iBraceTracker = 1;
+	char Index[MAX_STRING] = { 0 };
 
-	// Walk through the braces until we find the matching end brace or we reach the end of the string
-	while ((iBraceTracker > 0) && (iCurrentPosition < strOrigString.size()))
+	for (const MQDataChainStep& step : chain)
 	{
-		// If our last character was a start parameter
-		if (bParamTracker)
+		if (step.StepKind == MQDataChainStep::Kind::Cast)
 		{
-			// This character isn't a start parameter
-			bParamTracker = false;
-			// If this is a double quote after the parameter, we're going to assume we're in a quoted string
-			if (strOrigString[iCurrentPosition] == '"')
+			if (!Result.Type)
+				return false;
+
+			MQ2Type* pNewType = FindDataType(step.Name.c_str());
+			if (!pNewType)
 			{
-				bQuoteTracker = true;
+				MQ2DataError("Unknown type '%s'", step.Name.c_str());
+				return false;
 			}
-		}
-		// If our last character wasn't a start parameter, are we in a quoted string?
-		else if (bQuoteTracker)
+
+			if (pNewType == datatypes::pTypeType)
+			{
+				Result.Ptr = Result.Type;
+				Result.Type = datatypes::pTypeType;
+			}
+			else
+			{
+				Result.Type = pNewType;
+			}
+		}
+		else
+		{
+			// Members are allowed to write to the index, so they get a fresh copy every time.
+			strcpy_s(Index, step.Index.c_str());
+
+			if (!Result.Type && &step == &chain.front())
+			{
+				// Reuse the TLO lookup until a TLO is added or removed. Anything else by this name
+				// (a macro variable or function) goes through the usual lookup.
+				MQDataChainStep::Binding& bound = step.Bound;
+				const uint32_t generation = GetDataTypeGeneration();
+				if (bound.Generation != generation)
+				{
+					bound = {};
+					bound.TopLevelObject = FindTopLevelObject(step.Name.c_str());
+					bound.Generation = generation;
+				}
+
+				MQDataVar* DataVar = nullptr;
+				if (!bound.TopLevelObject && !step.ArrayIndex.empty())
+				{
+					DataVar = FindMQ2DataVariable(step.Name.c_str());
+					if (DataVar && DataVar->Var.Type != datatypes::pArrayType)
+						DataVar = nullptr;
+				}
+
+				if (bound.TopLevelObject)
+				{
+					if (!bound.TopLevelObject->Function(Index, Result))
+						return false;
+				}
+				else if (DataVar)
+				{
+					// Constant indices were parsed when the line was compiled.
+					if (!DataVar->Var.Get<datatypes::CDataArray>()->GetElement(step.ArrayIndex, Result))
+						return false;
+				}
+				else if (!EvaluateDataExpression(Result, step.Name.c_str(), Index, step.AllowFunction))
+				{
+					return false;
+				}
+			}
+			else if (!Result.Type)
+			{
+				if (!EvaluateDataExpression(Result, step.Name.c_str(), Index, step.AllowFunction))
+					return false;
+			}
+			else
+			{
+				MQVarPtr VarPtr = Result;
+				MQ2Type* pType = Result.Type;
+
+				auto result = EvaluateBoundMember(pType, VarPtr, Result, step, Index);
+				if (result == EvaluateResult::NotFound)
+					MQ2DataError("No such '%s' member '%s'", pType->GetName(), step.Name.c_str());
+
+				if (result != EvaluateResult::Success)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @fn TokenizeDataChain
+ *
+ * @brief Splits a data expression into the steps that ParseMQ2DataPortion would evaluate
+ *
+ * This follows the same scanning rules as ParseMQ2DataPortion (including its handling of
+ * quoted indices and typecasts) but records each step instead of evaluating it. Anything that
+ * ParseMQ2DataPortion would report as an error, or that would stop evaluation early, is rejected
+ * so that it can be left to ParseMQ2DataPortion to report in the usual way.
+ *
+ * @param expression The expression to tokenize, without the surrounding ${ and }
+ * @param chain Receives the steps of the expression
+ *
+ * @return bool True if the expression was tokenized
+ */
+// Parses an index made up only of positive numbers, such as 5 or 5,3, into zero based coordinates.
+static bool ParseConstantArrayIndex(std::string_view index, std::vector<int>& coordinates)
+{
+	coordinates.clear();
+	if (index.empty() || index.back() == ',')
+		return false;
+
+	for (std::string_view token : split_view(index, ','))
+	{
+		token = trim(token);
+		if (token.empty() || token.size() > 9
+			|| !std::all_of(token.begin(), token.end(), [](char ch) { return ch >= '0' && ch <= '9'; }))
+		{
+			coordinates.clear();
+			return false;
+		}
+
+		coordinates.push_back(GetIntFromString(token, 0) - 1);
+	}
+
+	return !coordinates.empty();
+}
+
+static bool TokenizeDataChain(std::string_view expression, std::vector<MQDataChainStep>& chain)
+{
+	std::string index;
+	bool functionAllowed = false;
+	size_t start = 0;
+	size_t nameEnd = std::string_view::npos;
+	size_t pos = 0;
+
+	auto charAt = [&](size_t where) -> char { return where < expression.size() ? expression[where] : 0; };
+	auto addStep = [&](bool allowFunction)
+	{
+		std::string name{ expression.substr(start, (nameEnd != std::string_view::npos ? nameEnd : pos) - start) };
+		if (name.empty() || index.length() >= MAX_STRING)
+			return false;
+
+		chain.push_back({ MQDataChainStep::Kind::Evaluate, std::move(name), index, allowFunction });
+
+		// Only the first step can name a macro array.
+		if (chain.size() == 1 && !index.empty())
+			ParseConstantArrayIndex(index, chain.back().ArrayIndex);
+		return true;
+	};
+
+	chain.clear();
+
+	while (true)
+	{
+		const char ch = charAt(pos);
+
+		if (ch == 0)
+		{
+			if (start == pos)
+				return false;
+
+			return addStep(functionAllowed);
+		}
+
+		if (ch == '(')
+		{
+			if (start == pos || !addStep(false))
+				return false;
+
+			const size_t closeParen = expression.find(')', pos + 1);
+			if (closeParen == std::string_view::npos)
+				return false;
+
+			chain.push_back({ MQDataChainStep::Kind::Cast, std::string{ expression.substr(pos + 1, closeParen - pos - 1) } });
+			pos = closeParen;
+
+			if (charAt(pos + 1) == 0)
+				return true;
+
+			if (charAt(pos + 1) != '.')
+				return false;
+
+			// Note that the index is intentionally carried over the cast
+			++pos;
+			start = pos + 1;
+			nameEnd = std::string_view::npos;
+		}
+		else if (ch == '[')
+		{
+			nameEnd = pos;
+			++pos;
+			functionAllowed = true;
+			bool quote = false;
+			bool beginParam = true;
+			index.clear();
+
+			while (true)
+			{
+				const char indexCh = charAt(pos);
+				if (indexCh == 0)
+					return false;
+
+				if (beginParam)
+				{
+					beginParam = false;
+					if (indexCh == '\"')
+					{
+						quote = true;
+						++pos;
+						continue;
+					}
+				}
+
+				if (quote)
+				{
+					if (indexCh == '\"' && (charAt(pos + 1) == ']' || charAt(pos + 1) == ','))
+					{
+						quote = false;
+						++pos;
+						continue;
+					}
+				}
+				else if (indexCh == ']')
+				{
+					const char next = charAt(pos + 1);
+					if (next == '.' || next == '(' || next == 0)
+						break;
+				}
+				else if (indexCh == ',')
+				{
+					beginParam = true;
+				}
+
+				index.push_back(indexCh);
+				++pos;
+			}
+		}
+		else if (ch == '.')
+		{
+			if (start == pos || !addStep(false))
+				return false;
+
+			start = pos + 1;
+			nameEnd = std::string_view::npos;
+			index.clear();
+		}
+
+		++pos;
+	}
+}
+
+/**
+ * @fn FindMacroClosingBrace
+ *
+ * @brief Finds the brace that matches from the start position. Returns the match position
+ *
+ * This is a replication of the original logic for finding the matching brace in MQ2.  It does
+ * not allow for escape characters and there is some weird logic to it (for example, quoted
+ * strings only last until a close bracket) but I've duplicated it here for backwards
+ * compatibility.
+ *
+ * This will start at the position specified and try to find the matching closing brace.
+ * If the match has been found, the function will return the location of that match.  If it
+ * cannot be found, returns std::string::npos to match what find() would return.
+ *
+ * This makes the assumption that you'll be calling it on a position just before ${ since
+ * we're trying to match a macro's closing braces and all macro variables start with ${.
+ *
+ * @param strOrigString The string that you would like to check
+ * @param iCurrentPosition The position to start at in the string (allows for starting
+ *        in the middle to get an interior match)
+ *
+ * @return size_t position of the matching brace (or npos if no match found)
+ */
+size_t FindMacroClosingBrace(std::string_view strOrigString, size_t iCurrentPosition)
+{
+	// Setup our needed trackers
+	int iBraceTracker = 0; // Track {
+	bool bQuoteTracker = false; // Track "
+	bool bParamTracker = false; // Track parameters ([ & ,)
+
+	// We already know what the first two characters are going to be so let's jump to the new position + 2.
+	iCurrentPosition += 2;
+
+	// Since we skipped the brace, let's increment that.
+	iBraceTracker = 1;
+
+	// Walk through the braces until we find the matching end brace or we reach the end of the string
+	while ((iBraceTracker > 0) && (iCurrentPosition < strOrigString.size()))
+	{
+		// If our last character was a start parameter
+		if (bParamTracker)
+		{
+			// This character isn't a start parameter
+			bParamTracker = false;
+			// If this is a double quote after the parameter, we're going to assume we're in a quoted string
+			if (strOrigString[iCurrentPosition] == '"')
+			{
+				bQuoteTracker = true;
+			}
+		}
+		// If our last character wasn't a start parameter, are we in a quoted string?
+		else if (bQuoteTracker)
 		{
 			// If this character is a quote
 			if (strOrigString[iCurrentPosition] == '"')
@@ -916,6 +1600,117 @@ size_t FindMacroClosingBrace(std::string_view strOrigString, size_t iCurrentPosi
 	return std::string::npos;
 }
 
+//----------------------------------------------------------------------------
+// Per-evaluation temporaries
+
+// Strings produced while a line is evaluated (String.Upper, String.Replace and so on) are bump
+// allocated out of a chunk list that is only rewound once the outermost evaluation finishes. The
+// chunks themselves are kept, so after the first few lines nothing is allocated at all.
+class DataEvaluationArena
+{
+public:
+	char* Allocate(size_t size)
+	{
+		while (m_chunkIndex < m_chunks.size())
+		{
+			Chunk& chunk = m_chunks[m_chunkIndex];
+			if (chunk.size - m_offset >= size)
+			{
+				char* ptr = chunk.data.get() + m_offset;
+				m_offset += size;
+				return ptr;
+			}
+
+			++m_chunkIndex;
+			m_offset = 0;
+		}
+
+		const size_t chunkSize = std::max(size, ChunkSize);
+		m_chunks.push_back({ std::make_unique<char[]>(chunkSize), chunkSize });
+		m_chunkIndex = m_chunks.size() - 1;
+		m_offset = size;
+
+		return m_chunks.back().data.get();
+	}
+
+	void Reset()
+	{
+		m_chunkIndex = 0;
+		m_offset = 0;
+	}
+
+	int Depth = 0;
+
+private:
+	static constexpr size_t ChunkSize = 16 * 1024;
+
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	std::vector<Chunk> m_chunks;
+	size_t m_chunkIndex = 0;
+	size_t m_offset = 0;
+};
+
+static thread_local DataEvaluationArena s_evaluationArena;
+
+void BeginDataEvaluation()
+{
+	++s_evaluationArena.Depth;
+}
+
+void EndDataEvaluation()
+{
+	if (--s_evaluationArena.Depth == 0)
+		s_evaluationArena.Reset();
+}
+
+char* AllocateDataTypeTemp(size_t size)
+{
+	// Outside of an evaluation there is nothing to rewind the arena, so fall back to the shared buffer.
+	if (s_evaluationArena.Depth == 0)
+		return size <= MAX_STRING ? &DataTypeTemp[0] : nullptr;
+
+	return s_evaluationArena.Allocate(size);
+}
+
+char* StoreDataTypeTemp(std::string_view str)
+{
+	const size_t length = s_evaluationArena.Depth == 0 ? std::min<size_t>(str.length(), MAX_STRING - 1) : str.length();
+
+	char* buffer = AllocateDataTypeTemp(length + 1);
+	memmove(buffer, str.data(), length);
+	buffer[length] = 0;
+
+	return buffer;
+}
+
+// String results are copied straight out of the variable so that they aren't cut off at MAX_STRING.
+static bool TypeVarToString(const MQTypeVar& Result, std::string& strOutput)
+{
+	if (!Result.Type)
+		return false;
+
+	if (Result.Type == datatypes::pStringType)
+	{
+		if (!Result.Ptr)
+			return false;
+
+		strOutput = static_cast<const char*>(Result.Ptr);
+		return true;
+	}
+
+	char szResult[MAX_STRING] = { 0 };
+	if (!Result.Type->ToString(Result.VarPtr, szResult))
+		return false;
+
+	strOutput = szResult;
+	return true;
+}
+
 /**
  * @fn GetMacroVarData
  *
@@ -954,11 +1749,10 @@ std::string GetMacroVarData(std::string_view strVarToParse)
 		MQTypeVar Result;
 
 		// If the parse was successful and there is a result type and we could convert that type to a string
-		if (pDataAPI->ParseMQ2DataPortion(&currentStr[0], Result) && Result.Type && Result.Type->ToString(Result.VarPtr, &currentStr[0]))
+		std::string strResult;
+		if (pDataAPI->ParseMQ2DataPortion(&currentStr[0], Result) && TypeVarToString(Result, strResult))
 		{
-			// Set our return whatever szCurrent was modified to be (removing the additional null terminators
-			// due to the above resize)
-			strReturn = currentStr.erase(currentStr.find('\0'));
+			strReturn = std::move(strResult);
 		}
 	}
 	return strReturn;
@@ -1157,6 +1951,64 @@ std::string HandleParseParam(std::string_view strOriginal, const bool bParseOnce
 	return strReturn;
 }
 
+// Evaluates every variable that starts to the left of iCurrentPosition, working from right to left
+// and replacing each one in place. This is the body of ParseMacroVar, split out so that the compiled
+// parser can resume the same walk part way through a variable.
+static void ParseMacroVarFrom(std::string& strReturn, size_t iCurrentPosition, const bool bParseOnce)
+{
+	// Loop until we reach the beginning of the string
+	while (iCurrentPosition > 0)
+	{
+		// Starting from one position left of our current position in the string, find the farthest right ${.
+		const size_t iPosition = strReturn.rfind("${", iCurrentPosition - 1);
+
+		// If we found a variable marker
+		if (iPosition != std::string::npos)
+		{
+			// Find the closing brace
+			const size_t iCloseBrace = FindMacroClosingBrace(strReturn, iPosition);
+
+			// If we found the Closing Brace then we can get the variable's data
+			if (iCloseBrace != std::string::npos)
+			{
+				// If the Closing Brace is AFTER our last parsed variable and we're only
+				// parsing once then we need to skip parsing this. This accounts for situations
+				// like ${Parse[1,${Spawn[=${Me.Name}].ID]}
+				if (!(bParseOnce && (iCloseBrace > iCurrentPosition)))
+				{
+					// We're going to use this value a couple times so store it in a variable
+					std::string strVarToParse = strReturn.substr(iPosition, iCloseBrace - iPosition);
+
+					// Parse the variable (also going to use this a couple of times)
+					std::string strParsedVar = GetMacroVarData(strVarToParse);
+
+					// If the variable changed (otherwise no point in doing anything)
+					if (strVarToParse != strParsedVar)
+					{
+						// If the variable contains a ${ and we are not in a parse once then we need to
+						// send it through the parser again
+						if (!bParseOnce && (strParsedVar.find("${") != std::string::npos))
+						{
+							strParsedVar = ModifyMacroString(strParsedVar);
+						}
+
+						// Replace the variable in our return string with the parsed variable
+						strReturn.replace(iPosition, iCloseBrace - iPosition, strParsedVar);
+					}
+				}
+			}
+
+			// In any case, move our cursor past the current position.
+			iCurrentPosition = iPosition;
+		}
+		else
+		{
+			// Otherwise we didn't find a variable marker so we're done.
+			iCurrentPosition = 0;
+		}
+	}
+}
+
 /**
  * @fn ParseMacroVar
  *
@@ -1188,72 +2040,17 @@ std::string HandleParseParam(std::string_view strOriginal, const bool bParseOnce
  */
 std::string ParseMacroVar(std::string_view strOriginal, const bool bParseOnce = false)
 {
-	// Setup a return string and initialize it to the original string
-	std::string strReturn{ strOriginal } ;
-
-	// If there is no parse parameter
-	if (strOriginal.find(PARSE_PARAM_BEG) == std::string::npos)
+	// If there is a parse parameter in this string, hand it off
+	if (strOriginal.find(PARSE_PARAM_BEG) != std::string::npos)
 	{
-		// Track our position and we're starting from the right
-		size_t iCurrentPosition = strReturn.length();
+		return HandleParseParam(strOriginal, bParseOnce);
+	}
 
-		// Loop until we reach the beginning of the string
-		while (iCurrentPosition > 0)
-		{
-			// Starting from one position left of our current position in the string, find the farthest right ${.
-			const size_t iPosition = strReturn.rfind("${", iCurrentPosition - 1);
+	// Setup a return string and initialize it to the original string
+	std::string strReturn{ strOriginal };
 
-			// If we found a variable marker
-			if (iPosition != std::string::npos)
-			{
-				// Find the closing brace
-				const size_t iCloseBrace = FindMacroClosingBrace(strReturn, iPosition);
-
-				// If we found the Closing Brace then we can get the variable's data
-				if (iCloseBrace != std::string::npos)
-				{
-					// If the Closing Brace is AFTER our last parsed variable and we're only
-					// parsing once then we need to skip parsing this. This accounts for situations
-					// like ${Parse[1,${Spawn[=${Me.Name}].ID]}
-					if (!(bParseOnce && (iCloseBrace > iCurrentPosition)))
-					{
-						// We're going to use this value a couple times so store it in a variable
-						std::string strVarToParse = strReturn.substr(iPosition, iCloseBrace - iPosition);
-
-						// Parse the variable (also going to use this a couple of times)
-						std::string strParsedVar = GetMacroVarData(strVarToParse);
-
-						// If the variable changed (otherwise no point in doing anything)
-						if (strVarToParse != strParsedVar)
-						{
-							// If the variable contains a ${ and we are not in a parse once then we need to
-							// send it through the parser again
-							if (!bParseOnce && (strParsedVar.find("${") != std::string::npos))
-							{
-								strParsedVar = ModifyMacroString(strParsedVar);
-							}
-
-							// Replace the variable in our return string with the parsed variable
-							strReturn.replace(iPosition, iCloseBrace - iPosition, strParsedVar);
-						}
-					}
-				}
-
-				// In any case, move our cursor past the current position.
-				iCurrentPosition = iPosition;
-			}
-			else
-			{
-				// Otherwise we didn't find a variable marker so we're done.
-				iCurrentPosition = 0;
-			}
-		}
-	}
-	else
-	{
-		// There is a parse parameter in this string
-		strReturn = HandleParseParam(strOriginal, bParseOnce);
-	}
+	// Track our position and we're starting from the right
+	ParseMacroVarFrom(strReturn, strReturn.length(), bParseOnce);
 
 	return strReturn;
 }
@@ -1310,129 +2107,797 @@ std::string ModifyMacroString(std::string_view strOriginal, bool bParseOnce, Mod
 		}
 		else
 		{
-			// We found a ${ - If the new position skips from our old position
-			if (iNewPosition > iCurrentPosition)
+			// We found a ${ - If the new position skips from our old position
+			if (iNewPosition > iCurrentPosition)
+			{
+				// Catch the data we missed from the Current Position to the New Position
+				strReturn += strOriginal.substr(iCurrentPosition, (iNewPosition - iCurrentPosition));
+			}
+
+			// Advance the current pointer to where we are now.
+			iCurrentPosition = iNewPosition;
+
+			// Get the matching brace position.
+			const size_t iBracePosition = FindMacroClosingBrace(strOriginal, iCurrentPosition);
+
+			// If we didn't find the matching brace, return the rest of the string
+			if (iBracePosition == std::string::npos)
+			{
+				strReturn += strOriginal.substr(iCurrentPosition);
+
+				// We reached the end of the string
+				iCurrentPosition = std::string::npos;
+			}
+			else
+			{
+				// We found the matching brace
+				switch (iOperation)
+				{
+					// Wrap Parse Zero, No Doubles - Wrap variables in a Parse Zero (unless they already have a Parse zero)
+				case ModifyMacroMode::WrapNoDoubles:
+					// If we already have a Parse Zero
+					if (strOriginal.substr(iCurrentPosition, PARSE_PARAM_BEG.length() + 1) == PARSE_PARAM_BEG + "0")
+					{
+						// Just add the section as is
+						strReturn += strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition));
+					}
+					else
+					{
+						// Add a Parse Zero
+						strReturn.append(PARSE_PARAM_BEG);
+						strReturn.append("0,");
+						strReturn.append(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)));
+						strReturn.append(PARSE_PARAM_END);
+					}
+					break;
+
+					// 0 - Wrap Parse Zero - Wrap variables in a Parse Zero (don't parse)
+				case ModifyMacroMode::Wrap:
+					strReturn.append(PARSE_PARAM_BEG);
+					strReturn.append("0,");
+					strReturn.append(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)));
+					strReturn.append(PARSE_PARAM_END);
+					break;
+
+					// Default case is Parse
+				case ModifyMacroMode::Default:
+				default:
+					// Parse it and add the result to our current string
+					strReturn.append(ParseMacroVar(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)), bParseOnce));
+				}
+
+				// Advance our position to where the brace is
+				iCurrentPosition = iBracePosition;
+			}
+		}
+	}
+
+	// Return the parsed string
+	return strReturn;
+}
+
+//============================================================================
+// Compiled macro strings
+//
+// ModifyMacroString has to find every ${ and its matching brace each time a line is evaluated,
+// even when the line is identical to the one it saw on the previous pulse. Compiling a line does
+// that work once: the line is split into literal text and variables, and each variable records
+// where its nested variables are. Variables without nested variables are tokenized completely so
+// that evaluating them only walks the member chain.
+//
+// Evaluation replicates ParseMacroVar exactly. Nested variables are substituted from right to left
+// using the recorded boundaries. If a substituted value contains something that would change how
+// the brace matcher sees the rest of the variable, the remainder is handed to ParseMacroVarFrom,
+// which continues from the same position.
+
+static constexpr size_t MAX_COMPILED_MACRO_STRINGS = 4096;
+
+static std::unordered_map<std::string, std::shared_ptr<const MQCompiledMacroString>> s_compiledMacroStrings;
+static std::mutex s_compiledMacroStringsMutex;
+
+// Records the nested variables of a variable segment using the same rules as FindMacroClosingBrace.
+static bool CompileMacroVarSegment(MQCompiledMacroSegment& segment)
+{
+	const std::string& text = segment.Text;
+
+	// Segments that use ${Parse[ go through HandleParseParam, which is left alone.
+	if (text.find(PARSE_PARAM_BEG) != std::string::npos)
+		return false;
+
+	bool bParamTracker = false;
+	bool bQuoteTracker = false;
+
+	// Open braces. Plain braces are tracked as -1 so that they balance like they do in the matcher.
+	std::vector<int> openBraces;
+
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		const char ch = text[i];
+
+		// Every ${ is evaluated by ParseMacroVar regardless of where it appears, but we can only
+		// predict its boundaries if the brace matcher isn't treating it as part of a quoted string.
+		const bool isVar = ch == '$' && i + 1 < text.size() && text[i + 1] == '{';
+		if (isVar)
+		{
+			if (bQuoteTracker)
+				return false;
+
+			MQCompiledMacroVar var;
+			var.Begin = i;
+
+			for (auto iter = openBraces.rbegin(); iter != openBraces.rend(); ++iter)
+			{
+				if (*iter >= 0)
+				{
+					segment.Vars[*iter].Children.push_back(segment.Vars.size());
+					break;
+				}
+			}
+
+			openBraces.push_back(static_cast<int>(segment.Vars.size()));
+			segment.Vars.push_back(std::move(var));
+
+			bParamTracker = false;
+			++i;
+			continue;
+		}
+
+		if (bParamTracker)
+		{
+			bParamTracker = false;
+			if (ch == '"')
+				bQuoteTracker = true;
+		}
+		else if (bQuoteTracker)
+		{
+			if (ch == '"' && i + 1 < text.size() && (text[i + 1] == ']' || text[i + 1] == ','))
+				bQuoteTracker = false;
+		}
+		else if (ch == '}')
+		{
+			if (openBraces.empty())
+				return false;
+
+			if (openBraces.back() >= 0)
+				segment.Vars[openBraces.back()].End = i + 1;
+
+			openBraces.pop_back();
+
+			// The segment ends on the brace that closes the outermost variable.
+			if (openBraces.empty() && i + 1 != text.size())
+				return false;
+		}
+		else if (ch == '{')
+		{
+			openBraces.push_back(-1);
+		}
+		else if (ch == '[' || ch == ',')
+		{
+			bParamTracker = true;
+		}
+	}
+
+	if (!openBraces.empty() || segment.Vars.empty())
+		return false;
+
+	for (MQCompiledMacroVar& var : segment.Vars)
+	{
+		if (var.Children.empty())
+		{
+			var.HasChain = TokenizeDataChain(
+				std::string_view(text).substr(var.Begin + 2, var.End - var.Begin - 3), var.Chain);
+		}
+	}
+
+	return true;
+}
+
+std::shared_ptr<const MQCompiledMacroString> CompileMacroString(std::string_view strOriginal)
+{
+	std::string key{ strOriginal };
+
+	{
+		std::scoped_lock lock(s_compiledMacroStringsMutex);
+
+		auto iter = s_compiledMacroStrings.find(key);
+		if (iter != s_compiledMacroStrings.end())
+			return iter->second;
+	}
+
+	auto compiled = std::make_shared<MQCompiledMacroString>();
+
+	auto addLiteral = [&compiled](std::string_view text)
+	{
+		if (text.empty())
+			return;
+
+		if (!compiled->Segments.empty() && !compiled->Segments.back().IsVariable)
+		{
+			compiled->Segments.back().Text.append(text);
+		}
+		else
+		{
+			MQCompiledMacroSegment& segment = compiled->Segments.emplace_back();
+			segment.Text = text;
+		}
+	};
+
+	// This is the tokenization that ModifyMacroString performs
+	size_t iCurrentPosition = 0;
+	while (iCurrentPosition != std::string::npos)
+	{
+		const size_t iNewPosition = strOriginal.find("${", iCurrentPosition);
+		if (iNewPosition == std::string::npos)
+		{
+			addLiteral(strOriginal.substr(iCurrentPosition));
+			break;
+		}
+
+		addLiteral(strOriginal.substr(iCurrentPosition, iNewPosition - iCurrentPosition));
+
+		const size_t iBracePosition = FindMacroClosingBrace(strOriginal, iNewPosition);
+		if (iBracePosition == std::string::npos)
+		{
+			addLiteral(strOriginal.substr(iNewPosition));
+			break;
+		}
+
+		MQCompiledMacroSegment& segment = compiled->Segments.emplace_back();
+		segment.Text = strOriginal.substr(iNewPosition, iBracePosition - iNewPosition);
+		segment.IsVariable = true;
+		segment.Compiled = CompileMacroVarSegment(segment);
+
+		if (!segment.Compiled)
+		{
+			segment.Vars.clear();
+		}
+
+		iCurrentPosition = iBracePosition;
+	}
+
+	std::scoped_lock lock(s_compiledMacroStringsMutex);
+
+	// Lines built at runtime would otherwise grow this forever. Starting over is cheap.
+	if (s_compiledMacroStrings.size() >= MAX_COMPILED_MACRO_STRINGS)
+		s_compiledMacroStrings.clear();
+
+	s_compiledMacroStrings.emplace(std::move(key), compiled);
+	return compiled;
+}
+
+void ClearCompiledMacroStrings()
+{
+	std::scoped_lock lock(s_compiledMacroStringsMutex);
+
+	s_compiledMacroStrings.clear();
+}
+
+// Checks whether the value that was just substituted at [begin, begin + length) leaves the brace
+// matcher of the enclosing variable in the same state that the original variable text did.
+static bool IsNeutralSubstitution(std::string_view text, size_t begin, size_t length)
+{
+	const std::string_view value = text.substr(begin, length);
+	if (value.find_first_of("{}\"") != std::string_view::npos)
+		return false;
+
+	// A trailing [ or , makes the matcher treat the next character as the start of a parameter
+	const char last = !value.empty() ? value.back() : (begin > 0 ? text[begin - 1] : 0);
+	if (last == '[' || last == ',')
+	{
+		const char next = begin + length < text.size() ? text[begin + length] : 0;
+		if (next == '"' || next == '{' || next == '}' || next == '[' || next == ',')
+			return false;
+	}
+
+	return true;
+}
+
+static std::string EvaluateCompiledMacroVar(const MQCompiledMacroSegment& segment)
+{
+	std::string strReturn = segment.Text;
+	const std::vector<MQCompiledMacroVar>& vars = segment.Vars;
+
+	// How much longer (or shorter) each variable is than its original text after substitution
+	std::vector<ptrdiff_t> shifts(vars.size(), 0);
+
+	for (size_t i = vars.size(); i-- > 0;)
+	{
+		const MQCompiledMacroVar& var = vars[i];
+
+		size_t iCloseBrace = var.End;
+		for (size_t child : var.Children)
+			iCloseBrace += shifts[child];
+
+		const size_t iLength = iCloseBrace - var.Begin;
+		std::string strParsedVar;
+
+		if (var.HasChain)
+		{
+			MQTypeVar Result;
+
+			if (!pDataAPI->EvaluateDataChain(var.Chain, Result) || !TypeVarToString(Result, strParsedVar))
+				strParsedVar = "NULL";
+		}
+		else
+		{
+			strParsedVar = GetMacroVarData(std::string_view(strReturn).substr(var.Begin, iLength));
+		}
+
+		if (strReturn.compare(var.Begin, iLength, strParsedVar) != 0)
+		{
+			if (strParsedVar.find("${") != std::string::npos)
+			{
+				strParsedVar = ModifyMacroString(strParsedVar);
+			}
+
+			strReturn.replace(var.Begin, iLength, strParsedVar);
+
+			if (!IsNeutralSubstitution(strReturn, var.Begin, strParsedVar.length()))
+			{
+				// The recorded boundaries can no longer be trusted, continue the slow way.
+				ParseMacroVarFrom(strReturn, var.Begin, false);
+				return strReturn;
+			}
+
+			shifts[i] = static_cast<ptrdiff_t>(strParsedVar.length()) - static_cast<ptrdiff_t>(var.End - var.Begin);
+		}
+		else
+		{
+			shifts[i] = static_cast<ptrdiff_t>(iLength) - static_cast<ptrdiff_t>(var.End - var.Begin);
+		}
+	}
+
+	return strReturn;
+}
+
+std::string EvaluateCompiledMacroString(const MQCompiledMacroString& compiled)
+{
+	MQDataEvaluationScope evaluationScope;
+	std::string strReturn;
+
+	for (const MQCompiledMacroSegment& segment : compiled.Segments)
+	{
+		if (!segment.IsVariable)
+			strReturn.append(segment.Text);
+		else if (segment.Compiled)
+			strReturn.append(EvaluateCompiledMacroVar(segment));
+		else
+			strReturn.append(ParseMacroVar(segment.Text));
+	}
+
+	return strReturn;
+}
+
+/**
+ * @fn ParseMacroData
+ *
+ * @brief Backwards compatible wrapper for ModifyMacroString
+ *
+ * This function is a backwards compatible wrapper for ModifyMacroString
+ * that takes the place of the original ParseMacroData function so that
+ * code being passed to the parser doesn't have to be rewritten.
+ *
+ * It will perform the same function as the original (parsing the char*
+ * and storing it in the original location) but, if Parser 2 is enabled
+ * it does so by converting to a string and passing it to ModifyMacroString
+ * instead of doing the parsing itself.
+ *
+ * The original ParseMacroData function would return false if there are
+ * no braces left to Parse, but if Parser 2 is enabled this function only
+ * returns "true" as an indicator of success rather than an indicator of
+ * "continue to parse" since that is all handled in the macro language
+ * itself now.
+ *
+ * @param szOriginal The char* to parse and store the output
+ * @param BufferSize The size of szOriginal
+ *
+ * @return bool ParserV2: Success / ParserV1: Whether there are braces
+ *                                            left to parse
+ */
+bool ParseCompiledMacroData(const MQCompiledMacroString& compiled, char* szOutput, size_t BufferSize)
+{
+	std::string strReturn = EvaluateCompiledMacroString(compiled);
+
+	// If the result is larger than MAX_STRING
+	if (strReturn.length() >= BufferSize)
+	{
+		// If we are currently in a macro block
+		if (MQMacroBlockPtr currblock = GetCurrentMacroBlock())
+		{
+			const MQMacroLine& line = currblock->Line.at(currblock->CurrIndex);
+
+			MacroError("Data Truncated in %s, Line: %d.  Expanded Length was greater than %d",
+				line.SourceFile.c_str(), line.LineNumber, BufferSize);
+		}
+
+		// Trim the result.
+		strReturn = strReturn.substr(0, BufferSize - 1);
+	}
+
+	// Copy the parsed string into the output buffer
+	strcpy_s(szOutput, BufferSize, strReturn.c_str());
+	// TODO: Change the behavior of the return for this to be more informative (consider backwards compatibility, however)
+	return true;
+}
+
+size_t FindMacroConditionEnd(std::string_view strParameters)
+{
+	if (strParameters.empty() || strParameters[0] != '(')
+		return std::string::npos;
+
+	int nParens = 0;
+	size_t iPosition = 0;
+
+	while (iPosition < strParameters.size())
+	{
+		if (strParameters.compare(iPosition, 2, "${") == 0)
+		{
+			iPosition = FindMacroClosingBrace(strParameters, iPosition);
+			continue;
+		}
+
+		if (strParameters[iPosition] == '(')
+		{
+			++nParens;
+		}
+		else if (strParameters[iPosition] == ')' && --nParens == 0)
+		{
+			return iPosition + 1;
+		}
+
+		++iPosition;
+	}
+
+	return std::string::npos;
+}
+
+// Classifies text the way Calculate would read it, if it reads as a single non-negative number.
+static bool GetConditionNumber(std::string_view text, double& value)
+{
+	if (ci_equals(text, "TRUE"))
+	{
+		value = 1.0;
+		return true;
+	}
+
+	if (ci_equals(text, "FALSE") || ci_equals(text, "NULL"))
+	{
+		value = 0.0;
+		return true;
+	}
+
+	if (text.empty() || text.find_first_not_of("0123456789.") != std::string_view::npos)
+		return false;
+
+	value = GetDoubleFromString(std::string(text).c_str(), 0);
+	return true;
+}
+
+// A ${} variable of a condition, evaluated when it is first needed.
+struct MQConditionLeaf
+{
+	MQTypeVar Var;
+	std::string Text;
+	double Value = 0.0;
+	bool HasText = false;
+	bool Bindable = false;
+	bool Evaluated = false;
+};
+
+static void EvaluateConditionLeaf(const MQCompiledMacroSegment& segment, MQConditionLeaf& leaf)
+{
+	leaf.Evaluated = true;
+
+	if (!segment.Compiled || segment.Vars.size() != 1 || !segment.Vars[0].HasChain)
+	{
+		// Only simple variables can be handed over as values. The rest are evaluated as text.
+		MQCompiledMacroString single;
+		single.Segments.push_back(segment);
+
+		leaf.Text = EvaluateCompiledMacroString(single);
+		leaf.HasText = true;
+	}
+	else if (!pDataAPI->EvaluateDataChain(segment.Vars[0].Chain, leaf.Var) || !leaf.Var.Type)
+	{
+		leaf.Text = "NULL";
+		leaf.HasText = true;
+	}
+	else if (leaf.Var.Type == datatypes::pIntType)
+	{
+		leaf.Value = leaf.Var.Int;
+	}
+	else if (leaf.Var.Type == datatypes::pInt64Type)
+	{
+		leaf.Value = static_cast<double>(leaf.Var.Int64);
+	}
+	else if (leaf.Var.Type == datatypes::pBoolType)
+	{
+		leaf.Value = leaf.Var.Get<bool>() ? 1.0 : 0.0;
+	}
+	else
+	{
+		// Anything else is only valid until the next evaluation, so keep it as text.
+		if (!TypeVarToString(leaf.Var, leaf.Text))
+			leaf.Text = "NULL";
+		leaf.HasText = true;
+	}
+
+	if (leaf.HasText)
+	{
+		if (leaf.Text.find_first_of("{}\"") != std::string::npos)
+		{
+			// Values that the brace matcher could trip over are rare. Let the evaluator deal with them.
+			MQCompiledMacroString single;
+			single.Segments.push_back(segment);
+
+			leaf.Text = EvaluateCompiledMacroString(single);
+		}
+
+		leaf.Bindable = GetConditionNumber(leaf.Text, leaf.Value);
+	}
+	else
+	{
+		// As text, a leading minus sign can merge with the operator in front of it.
+		leaf.Bindable = leaf.Value >= 0;
+	}
+}
+
+static const std::string& GetConditionLeafText(MQConditionLeaf& leaf)
+{
+	if (!leaf.HasText)
+	{
+		if (leaf.Var.Type == datatypes::pBoolType)
+			leaf.Text = leaf.Var.Get<bool>() ? "TRUE" : "FALSE";
+		else if (leaf.Var.Type == datatypes::pInt64Type)
+			leaf.Text = std::to_string(leaf.Var.Int64);
+		else
+			leaf.Text = std::to_string(leaf.Var.Int);
+
+		leaf.HasText = true;
+	}
+
+	return leaf.Text;
+}
+
+// A condition with each of its variables replaced by a CALC_BOUND_VALUE marker.
+struct MQConditionEvaluation
+{
+	const MQCompiledMacroString& Compiled;
+	std::string Formula;
+	std::vector<size_t> LeafSegments;            // segment index of each marker
+	std::vector<MQConditionLeaf> Leaves;
+};
+
+static void EvaluateConditionLeaves(MQConditionEvaluation& eval, size_t begin, size_t end, size_t firstLeaf)
+{
+	size_t leafIndex = firstLeaf;
+	for (size_t i = begin; i < end; ++i)
+	{
+		if (eval.Formula[i] != CALC_BOUND_VALUE)
+			continue;
+
+		MQConditionLeaf& leaf = eval.Leaves[leafIndex];
+		if (!leaf.Evaluated)
+			EvaluateConditionLeaf(eval.Compiled.Segments[eval.LeafSegments[leafIndex]], leaf);
+
+		++leafIndex;
+	}
+}
+
+static std::string GetConditionText(MQConditionEvaluation& eval, size_t begin, size_t end, size_t firstLeaf)
+{
+	std::string strText;
+
+	size_t leafIndex = firstLeaf;
+	for (size_t i = begin; i < end; ++i)
+	{
+		if (eval.Formula[i] == CALC_BOUND_VALUE)
+			strText.append(GetConditionLeafText(eval.Leaves[leafIndex++]));
+		else
+			strText.push_back(eval.Formula[i]);
+	}
+
+	return strText;
+}
+
+// Calculates Formula[begin, end), whose first marker is leaf firstLeaf.
+static bool CalculateConditionRange(MQConditionEvaluation& eval, size_t begin, size_t end, size_t firstLeaf,
+	double& Result, std::string& strFailed)
+{
+	EvaluateConditionLeaves(eval, begin, end, firstLeaf);
+
+	std::vector<double> values;
+	bool bindable = true;
+
+	size_t leafIndex = firstLeaf;
+	for (size_t i = begin; i < end && bindable; ++i)
+	{
+		if (eval.Formula[i] == CALC_BOUND_VALUE)
+		{
+			const MQConditionLeaf& leaf = eval.Leaves[leafIndex++];
+
+			bindable = leaf.Bindable;
+			values.push_back(leaf.Value);
+		}
+	}
+
+	if (bindable && end - begin < MAX_STRING)
+	{
+		const std::string formula = eval.Formula.substr(begin, end - begin);
+
+		const int rc = CalculateBound(formula.c_str(), values.data(), values.size(), Result);
+		if (rc == 1)
+			return true;
+
+		if (rc == 0)
+		{
+			strFailed = GetConditionText(eval, begin, end, firstLeaf);
+			return false;
+		}
+	}
+
+	// Calculate it as text, from the values we already have.
+	std::string strText = GetConditionText(eval, begin, end, firstLeaf);
+	if (!Calculate(strText.c_str(), Result))
+	{
+		strFailed = std::move(strText);
+		return false;
+	}
+
+	return true;
+}
+
+// With lazy conditions enabled, operands of a top level || or && are calculated left to right and
+// only until the result is known, so the variables in the remaining operands are never evaluated.
+static bool EvaluateConditionRange(MQConditionEvaluation& eval, size_t begin, size_t end, size_t firstLeaf,
+	double& Result, std::string& strFailed)
+{
+	if (!gLazyConditions)
+		return CalculateConditionRange(eval, begin, end, firstLeaf, Result, strFailed);
+
+	const std::string& formula = eval.Formula;
+
+	auto trim = [&formula](size_t& b, size_t& e)
+	{
+		while (b < e && formula[b] == ' ') ++b;
+		while (e > b && formula[e - 1] == ' ') --e;
+	};
+
+	auto countLeaves = [&formula](size_t b, size_t e)
+	{
+		return static_cast<size_t>(std::count(formula.begin() + b, formula.begin() + e, CALC_BOUND_VALUE));
+	};
+
+	size_t innerBegin = begin;
+	size_t innerEnd = end;
+	trim(innerBegin, innerEnd);
+
+	// Look through parentheses that enclose the whole range.
+	while (innerEnd - innerBegin >= 2 && formula[innerBegin] == '(' && formula[innerEnd - 1] == ')')
+	{
+		int nParens = 0;
+		size_t close = innerBegin;
+		for (; close < innerEnd; ++close)
+		{
+			if (formula[close] == '(')
+				++nParens;
+			else if (formula[close] == ')' && --nParens == 0)
+				break;
+		}
+
+		if (close != innerEnd - 1)
+			break;
+
+		++innerBegin;
+		--innerEnd;
+		trim(innerBegin, innerEnd);
+	}
+
+	// || binds looser than &&, so split on it first.
+	for (const char* op : { "||", "&&" })
+	{
+		std::vector<std::pair<size_t, size_t>> operands;
+		size_t operandBegin = innerBegin;
+		int nParens = 0;
+
+		for (size_t i = innerBegin; i < innerEnd; ++i)
+		{
+			if (formula[i] == '(')
+				++nParens;
+			else if (formula[i] == ')')
+				--nParens;
+			else if (nParens == 0 && formula.compare(i, 2, op) == 0)
 			{
-				// Catch the data we missed from the Current Position to the New Position
-				strReturn += strOriginal.substr(iCurrentPosition, (iNewPosition - iCurrentPosition));
+				operands.emplace_back(operandBegin, i);
+				operandBegin = i + 2;
+				++i;
 			}
+		}
 
-			// Advance the current pointer to where we are now.
-			iCurrentPosition = iNewPosition;
-
-			// Get the matching brace position.
-			const size_t iBracePosition = FindMacroClosingBrace(strOriginal, iCurrentPosition);
+		if (operands.empty())
+			continue;
 
-			// If we didn't find the matching brace, return the rest of the string
-			if (iBracePosition == std::string::npos)
-			{
-				strReturn += strOriginal.substr(iCurrentPosition);
+		operands.emplace_back(operandBegin, innerEnd);
 
-				// We reached the end of the string
-				iCurrentPosition = std::string::npos;
-			}
-			else
-			{
-				// We found the matching brace
-				switch (iOperation)
-				{
-					// Wrap Parse Zero, No Doubles - Wrap variables in a Parse Zero (unless they already have a Parse zero)
-				case ModifyMacroMode::WrapNoDoubles:
-					// If we already have a Parse Zero
-					if (strOriginal.substr(iCurrentPosition, PARSE_PARAM_BEG.length() + 1) == PARSE_PARAM_BEG + "0")
-					{
-						// Just add the section as is
-						strReturn += strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition));
-					}
-					else
-					{
-						// Add a Parse Zero
-						strReturn.append(PARSE_PARAM_BEG);
-						strReturn.append("0,");
-						strReturn.append(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)));
-						strReturn.append(PARSE_PARAM_END);
-					}
-					break;
+		// An empty operand is an error that the whole formula should report.
+		bool valid = true;
+		for (auto [b, e] : operands)
+		{
+			trim(b, e);
+			valid = valid && b < e;
+		}
 
-					// 0 - Wrap Parse Zero - Wrap variables in a Parse Zero (don't parse)
-				case ModifyMacroMode::Wrap:
-					strReturn.append(PARSE_PARAM_BEG);
-					strReturn.append("0,");
-					strReturn.append(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)));
-					strReturn.append(PARSE_PARAM_END);
-					break;
+		if (!valid)
+			break;
 
-					// Default case is Parse
-				case ModifyMacroMode::Default:
-				default:
-					// Parse it and add the result to our current string
-					strReturn.append(ParseMacroVar(strOriginal.substr(iCurrentPosition, (iBracePosition - iCurrentPosition)), bParseOnce));
-				}
+		const bool isOr = op[0] == '|';
+		for (auto [b, e] : operands)
+		{
+			double operandResult = 0;
+			if (!EvaluateConditionRange(eval, b, e, firstLeaf + countLeaves(begin, b), operandResult, strFailed))
+				return false;
 
-				// Advance our position to where the brace is
-				iCurrentPosition = iBracePosition;
+			if ((operandResult != 0) == isOr)
+			{
+				Result = isOr ? 1.0 : 0.0;
+				return true;
 			}
 		}
+
+		Result = isOr ? 0.0 : 1.0;
+		return true;
 	}
 
-	// Return the parsed string
-	return strReturn;
+	return CalculateConditionRange(eval, begin, end, firstLeaf, Result, strFailed);
 }
 
-/**
- * @fn ParseMacroData
- *
- * @brief Backwards compatible wrapper for ModifyMacroString
- *
- * This function is a backwards compatible wrapper for ModifyMacroString
- * that takes the place of the original ParseMacroData function so that
- * code being passed to the parser doesn't have to be rewritten.
- *
- * It will perform the same function as the original (parsing the char*
- * and storing it in the original location) but, if Parser 2 is enabled
- * it does so by converting to a string and passing it to ModifyMacroString
- * instead of doing the parsing itself.
- *
- * The original ParseMacroData function would return false if there are
- * no braces left to Parse, but if Parser 2 is enabled this function only
- * returns "true" as an indicator of success rather than an indicator of
- * "continue to parse" since that is all handled in the macro language
- * itself now.
- *
- * @param szOriginal The char* to parse and store the output
- * @param BufferSize The size of szOriginal
- *
- * @return bool ParserV2: Success / ParserV1: Whether there are braces
- *                                            left to parse
- */
-bool ParseMacroData(char* szOriginal, size_t BufferSize)
+int EvaluateCompiledCondition(const MQCompiledMacroString& compiled, double& Result, std::string& strExpanded)
 {
-	MQScopedBenchmark bm(bmParseMacroData);
+	MQDataEvaluationScope evaluationScope;
+	MQConditionEvaluation eval{ compiled };
 
-	if (gParserVersion == 2)
+	for (size_t i = 0; i < compiled.Segments.size(); ++i)
 	{
-		// Pass it off to our String Parser
-		std::string strReturn = ModifyMacroString(szOriginal);
+		const MQCompiledMacroSegment& segment = compiled.Segments[i];
 
-		// If the result is larger than MAX_STRING
-		if (strReturn.length() >= BufferSize)
+		if (!segment.IsVariable)
 		{
-			// If we are currently in a macro block
-			if (MQMacroBlockPtr currblock = GetCurrentMacroBlock())
+			// Markers have to be unambiguous. Conditions that contain the marker character are left
+			// to Calculate, which will reject them.
+			if (segment.Text.find(CALC_BOUND_VALUE) != std::string::npos)
 			{
-				const MQMacroLine& line = currblock->Line.at(currblock->CurrIndex);
-
-				MacroError("Data Truncated in %s, Line: %d.  Expanded Length was greater than %d",
-					line.SourceFile.c_str(), line.LineNumber, BufferSize);
+				strExpanded = EvaluateCompiledMacroString(compiled);
+				return -1;
 			}
 
-			// Trim the result.
-			strReturn = strReturn.substr(0, BufferSize - 1);
+			eval.Formula.append(segment.Text);
 		}
+		else
+		{
+			eval.Formula.push_back(CALC_BOUND_VALUE);
+			eval.LeafSegments.push_back(i);
+		}
+	}
+
+	eval.Leaves.resize(eval.LeafSegments.size());
+
+	if (!EvaluateConditionRange(eval, 0, eval.Formula.size(), 0, Result, strExpanded))
+		return 0;
+
+	return 1;
+}
+
+bool ParseMacroData(char* szOriginal, size_t BufferSize)
+{
+	MQScopedBenchmark bm(bmParseMacroData);
+	MQDataEvaluationScope evaluationScope;
+
+	if (gParserVersion == 2)
+	{
+		// Pass it off to our String Parser. Lines with variables are compiled once and reused.
+		if (strstr(szOriginal, "${") != nullptr)
+			return ParseCompiledMacroData(*CompileMacroString(szOriginal), szOriginal, BufferSize);
 
-		// Copy the parsed string into the original string
-		strcpy_s(szOriginal, BufferSize, strReturn.c_str());
-		// TODO: Change the behavior of the return for this to be more informative (consider backwards compatibility, however)
 		return true;
 	}
 
@@ -1592,6 +3057,9 @@ MQ2Type::~MQ2Type()
 	{
 		pDataAPI->RemoveDataType(*this);
 	}
+
+	// Something else could be allocated at this address, don't let it inherit our bindings.
+	BumpDataTypeGeneration();
 }
 
 void MQ2Type::InitializeMembers(MQTypeMember* memberArray)
@@ -1607,6 +3075,46 @@ const char* MQ2Type::GetName() const
 	return m_typeName.c_str();
 }
 
+const MQNameLookupTable* MQ2Type::GetMemberTable() const
+{
+	if (const MQNameLookupTable* table = m_memberTable.load(std::memory_order_acquire))
+		return table;
+
+	std::scoped_lock lock(m_mutex);
+
+	if (const MQNameLookupTable* table = m_memberTable.load(std::memory_order_acquire))
+		return table;
+
+	std::vector<MQNameLookupTable::Entry> entries;
+	entries.reserve(MemberMap.size());
+	for (const auto& [name, index] : MemberMap)
+		entries.push_back({ name.c_str(), Members[index].get(), Members[index]->ID });
+
+	m_lookupTables.push_back(std::make_unique<MQNameLookupTable>(std::move(entries)));
+	m_memberTable.store(m_lookupTables.back().get(), std::memory_order_release);
+	return m_lookupTables.back().get();
+}
+
+const MQNameLookupTable* MQ2Type::GetMethodTable() const
+{
+	if (const MQNameLookupTable* table = m_methodTable.load(std::memory_order_acquire))
+		return table;
+
+	std::scoped_lock lock(m_mutex);
+
+	if (const MQNameLookupTable* table = m_methodTable.load(std::memory_order_acquire))
+		return table;
+
+	std::vector<MQNameLookupTable::Entry> entries;
+	entries.reserve(MethodMap.size());
+	for (const auto& [name, index] : MethodMap)
+		entries.push_back({ name.c_str(), Methods[index].get(), Methods[index]->ID });
+
+	m_lookupTables.push_back(std::make_unique<MQNameLookupTable>(std::move(entries)));
+	m_methodTable.store(m_lookupTables.back().get(), std::memory_order_release);
+	return m_lookupTables.back().get();
+}
+
 const char* MQ2Type::GetMemberName(int ID) const
 {
 	for (const auto& pMember : Members)
@@ -1622,71 +3130,44 @@ const char* MQ2Type::GetMemberName(int ID) const
 
 bool MQ2Type::GetMemberID(const char* Name, int& result) const
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
+	const MQNameLookupTable::Entry* entry = GetMemberTable()->Find(Name);
+	if (!entry)
 		return false;
 
-	int index = iter->second;
-	result = Members[index]->ID;
+	result = entry->ID;
 	return true;
 }
 
 mq::MQTypeMember* MQ2Type::FindMember(const char* Name)
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
+	if (const MQMemberLookupHint* hint = GetMemberLookupHint(this, Name))
+		return hint->Member;
 
-	int index = MemberMap[Name];
-	return Members[index].get();
+	return static_cast<MQTypeMember*>(GetMemberTable()->FindValue(Name));
 }
 
 mq::MQTypeMember* MQ2Type::FindMember(const std::string& Name)
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
-
-	int index = MemberMap[Name];
-	return Members[index].get();
+	return FindMember(Name.c_str());
 }
 
 mq::MQTypeMember* MQ2Type::FindMethod(const char* Name)
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
+	if (const MQMemberLookupHint* hint = GetMemberLookupHint(this, Name))
+		return hint->Method;
 
-	int index = iter->second;
-	return Methods[index].get();
+	return static_cast<MQTypeMember*>(GetMethodTable()->FindValue(Name));
 }
 
 mq::MQTypeMember* MQ2Type::FindMethod(const std::string& Name)
 {
-	std::scoped_lock lock(m_mutex);
-
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
-
-	int index = iter->second;
-	return Methods[index].get();
+	return FindMethod(Name.c_str());
 }
 
 bool MQ2Type::CanEvaluateMethodOrMember(const std::string& Name)
 {
-	std::scoped_lock lock(m_mutex);
-
 	// exists in method map?
-	return MemberMap.count(Name) != 0 || MethodMap.count(Name) != 0;
+	return GetMemberTable()->Find(Name.c_str()) != nullptr || GetMethodTable()->Find(Name.c_str()) != nullptr;
 }
 
 bool MQ2Type::AddMember(int id, const char* Name)
@@ -1715,6 +3196,8 @@ bool MQ2Type::AddMember(int id, const char* Name)
 
 	Members[index] = std::make_unique<MQTypeMember>(id, Name, 0);
 	MemberMap[Name] = index;
+	m_memberTable = nullptr;
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -1729,9 +3212,12 @@ bool MQ2Type::RemoveMember(const char* Name)
 	int index = iter->second;
 	MemberMap.erase(iter);
 
+	m_memberTable = nullptr;
+
 	if (index < 0)
 		return false;
 	Members[index].reset();
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -1761,6 +3247,8 @@ bool MQ2Type::AddMethod(int ID, const char* Name)
 
 	Methods[index] = std::make_unique<MQTypeMember>(ID, Name, 1);
 	MethodMap[Name] = index;
+	m_methodTable = nullptr;
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -1775,9 +3263,12 @@ bool MQ2Type::RemoveMethod(const char* Name)
 	int index = iter->second;
 	MethodMap.erase(iter);
 
+	m_methodTable = nullptr;
+
 	if (index < 0)
 		return false;
 	Methods[index].reset();
+	BumpDataTypeGeneration();
 	return true;
 }
 
@@ -1829,6 +3320,217 @@ bool FindMacroDataMember(MQ2Type* Type, const std::string& Member)
 	return pDataAPI->FindMacroDataMember(Type, Member);
 }
 
+void EvaluateMacroDataMembers(const MQTypeVar& Object, const std::vector<std::string_view>& Members,
+	const std::function<void(size_t, const MQTypeVar&)>& Callback)
+{
+	MQDataEvaluationScope evaluationScope;
+
+	std::string strMember;
+	char szIndex[MAX_STRING];
+
+	for (size_t i = 0; i < Members.size(); ++i)
+	{
+		std::string_view member = Members[i];
+		std::string_view index;
+
+		// Split "Buff[1]" into its name and index
+		size_t pos = member.find('[');
+		if (pos != std::string_view::npos && member.back() == ']')
+		{
+			index = member.substr(pos + 1, member.length() - pos - 2);
+			member = member.substr(0, pos);
+		}
+
+		strMember = member;
+		szIndex[index.copy(szIndex, MAX_STRING - 1)] = 0;
+
+		MQTypeVar Result;
+		MQVarPtr VarPtr = Object.GetVarPtr();
+		if (Object.Type == nullptr
+			|| pDataAPI->EvaluateMacroDataMember(Object.Type, VarPtr, Result, strMember, szIndex, false) != MQDataAPI::EvaluateResult::Success)
+		{
+			Result = MQTypeVar();
+		}
+
+		Callback(i, Result);
+	}
+}
+
+std::shared_ptr<MQBoundDataExpression> BindDataExpression(std::string_view expression)
+{
+	auto bound = std::make_shared<MQBoundDataExpression>();
+	if (!TokenizeDataChain(expression, bound->Chain))
+		return nullptr;
+
+	return bound;
+}
+
+bool EvaluateBoundDataExpression(const MQBoundDataExpression& expression, MQTypeVar& Result)
+{
+	return pDataAPI->EvaluateDataChain(expression.Chain, Result);
+}
+
+MQTopLevelObject* GetBoundTopLevelObject(const MQBoundDataExpression& expression)
+{
+	if (expression.Chain.empty())
+		return nullptr;
+
+	return FindTopLevelObject(expression.Chain.front().Name.c_str());
+}
+
+//============================================================================
+// Data subscriptions
+
+struct MQDataSubscription
+{
+	std::string Expression;
+	MQDataTrigger Trigger;
+	double Threshold;
+	MQDataChangedCallback Callback;
+
+	bool Notified = false;
+	bool Triggered = false;
+};
+
+struct MQWatchedExpression
+{
+	std::shared_ptr<MQBoundDataExpression> Bound;
+	std::vector<int> Subscribers;
+
+	std::string Value;
+	bool HasValue = false;
+};
+
+static std::map<std::string, MQWatchedExpression, std::less<>> s_watchedExpressions;
+static std::unordered_map<int, std::shared_ptr<MQDataSubscription>> s_dataSubscriptions;
+static int s_nextDataSubscriptionID = 0;
+
+int SubscribeDataExpression(std::string_view expression, MQDataTrigger trigger, double threshold,
+	MQDataChangedCallback callback)
+{
+	if (!callback)
+		return 0;
+
+	auto iter = s_watchedExpressions.find(expression);
+	if (iter == s_watchedExpressions.end())
+	{
+		auto bound = BindDataExpression(expression);
+		if (!bound)
+			return 0;
+
+		iter = s_watchedExpressions.emplace(std::string(expression), MQWatchedExpression{ std::move(bound) }).first;
+	}
+
+	auto subscription = std::make_shared<MQDataSubscription>();
+	subscription->Expression = iter->first;
+	subscription->Trigger = trigger;
+	subscription->Threshold = threshold;
+	subscription->Callback = std::move(callback);
+
+	int id = ++s_nextDataSubscriptionID;
+	s_dataSubscriptions.emplace(id, std::move(subscription));
+	iter->second.Subscribers.push_back(id);
+
+	return id;
+}
+
+bool UnsubscribeDataExpression(int subscriptionID)
+{
+	auto iter = s_dataSubscriptions.find(subscriptionID);
+	if (iter == s_dataSubscriptions.end())
+		return false;
+
+	// The expression itself is dropped on the next pulse once nothing is watching it.
+	auto watched = s_watchedExpressions.find(iter->second->Expression);
+	if (watched != s_watchedExpressions.end())
+	{
+		auto& subscribers = watched->second.Subscribers;
+		subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriptionID), subscribers.end());
+	}
+
+	s_dataSubscriptions.erase(iter);
+	return true;
+}
+
+static bool ShouldNotifyDataSubscriber(MQDataSubscription& subscription, const MQTypeVar& Result,
+	const std::string& value, bool changed)
+{
+	if (subscription.Trigger == MQDataTrigger::Changed)
+	{
+		bool notify = changed || !subscription.Notified;
+		subscription.Notified = true;
+		return notify;
+	}
+
+	// A value that fails to evaluate is neither above nor below anything
+	bool triggered = false;
+	if (Result.Type != nullptr)
+	{
+		const double number = GetDoubleFromString(value, 0.0);
+		triggered = subscription.Trigger == MQDataTrigger::Above
+			? number > subscription.Threshold
+			: number < subscription.Threshold;
+	}
+
+	// Only the crossing is reported, not every frame that the value stays on that side
+	bool notify = triggered && !subscription.Triggered;
+	subscription.Triggered = triggered;
+	return notify;
+}
+
+static void PulseDataAPI()
+{
+	if (s_watchedExpressions.empty())
+		return;
+
+	MQDataEvaluationScope evaluationScope;
+
+	for (auto iter = s_watchedExpressions.begin(); iter != s_watchedExpressions.end();)
+	{
+		MQWatchedExpression& watched = iter->second;
+		if (watched.Subscribers.empty())
+		{
+			iter = s_watchedExpressions.erase(iter);
+			continue;
+		}
+
+		MQTypeVar Result;
+		std::string value;
+		if (!EvaluateBoundDataExpression(*watched.Bound, Result) || !TypeVarToString(Result, value))
+		{
+			Result = MQTypeVar();
+			value = "NULL";
+		}
+
+		const bool changed = !watched.HasValue || value != watched.Value;
+		if (changed)
+		{
+			watched.Value = std::move(value);
+			watched.HasValue = true;
+		}
+
+		// A callback can evaluate other data and overwrite temporary storage, so strings are handed
+		// out from our own copy.
+		if (Result.Type == datatypes::pStringType)
+			Result.Ptr = watched.Value.data();
+
+		// Callbacks may subscribe or unsubscribe, so work from a copy of the list.
+		const std::vector<int> subscribers = watched.Subscribers;
+		for (int id : subscribers)
+		{
+			auto subscriptionIter = s_dataSubscriptions.find(id);
+			if (subscriptionIter == s_dataSubscriptions.end())
+				continue;
+
+			std::shared_ptr<MQDataSubscription> subscription = subscriptionIter->second;
+			if (ShouldNotifyDataSubscriber(*subscription, Result, watched.Value, changed))
+				subscription->Callback(Result);
+		}
+
+		++iter;
+	}
+}
+
 //============================================================================
 
 SGlobalBuffer::SGlobalBuffer()
@@ -17,8 +17,11 @@
 #include "mq/base/Common.h"
 #include "mq/api/MacroAPI.h"
 
+#include <atomic>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace mq {
 
@@ -31,12 +34,71 @@ struct MQTopLevelObject
 	std::string Name;
 	MQTopLevelObjectFunction Function;
 	MQPlugin* Owner;
+	int ID = -1;                       // stable for as long as the TLO is registered, never reused
 };
 using MQDataItem DEPRECATE("Use MQTopLevelObject instead of MQDataItem") = MQTopLevelObject;
 
+// A single pre-tokenized step of a data expression such as `Me`, `Buff[1]` or `(int)`. Steps are
+// produced by the same rules that ParseMQ2DataPortion uses, so evaluating them in order gives the
+// same result without re-scanning the text.
+struct MQDataChainStep
+{
+	enum class Kind { Evaluate, Cast };
+
+	Kind StepKind = Kind::Evaluate;
+	std::string Name;                  // TLO or member name, or the type name of a cast
+	std::string Index;                 // index contents with quoting removed
+	bool AllowFunction = false;
+	std::vector<int> ArrayIndex;       // zero based coordinates when Index is a constant like 5,3
+
+	// Member lookups for the type that this step was last evaluated against. These are only
+	// trusted while Generation matches the data type generation, see GetDataTypeGeneration.
+	struct Binding
+	{
+		MQ2Type* Type = nullptr;
+		MQTypeMember* Member = nullptr;
+		MQTypeMember* Method = nullptr;
+		MQTopLevelObject* TopLevelObject = nullptr; // first step only
+		bool HasExtensions = false;
+		uint32_t Generation = 0;
+	};
+	mutable Binding Bound;
+};
+
+// A data expression that was tokenized once by BindDataExpression, for callers that evaluate the
+// same expression over and over.
+struct MQBoundDataExpression
+{
+	std::vector<MQDataChainStep> Chain;
+};
+
+// A ${} variable inside of a compiled segment. Offsets are relative to the segment text.
+struct MQCompiledMacroVar
+{
+	size_t Begin = 0;                  // position of the ${
+	size_t End = 0;                    // one past the closing brace
+	std::vector<size_t> Children;      // indices of directly nested variables
+	std::vector<MQDataChainStep> Chain; // only valid for variables without nested variables
+	bool HasChain = false;
+};
+
+struct MQCompiledMacroSegment
+{
+	std::string Text;                  // literal text or the full text of a variable
+	bool IsVariable = false;
+	bool Compiled = false;             // if false, the segment is evaluated with ParseMacroVar
+	std::vector<MQCompiledMacroVar> Vars; // in order of appearance, evaluated back to front
+};
+
+// A line that has been split into literal and variable segments, cached by its raw text.
+struct MQCompiledMacroString
+{
+	std::vector<MQCompiledMacroSegment> Segments;
+};
+
 struct MQDataVar
 {
-	char szName[MAX_STRING];
+	std::string Name;
 	MQTypeVar Var;
 
 	MQDataVar* pNext;
@@ -46,6 +108,8 @@ struct MQDataVar
 
 //----------------------------------------------------------------------------
 
+class MQNameLookupTable;
+
 class MQDataAPI
 {
 public:
@@ -58,6 +122,8 @@ public:
 	bool AddTopLevelObject(const char* szName, MQTopLevelObjectFunction Function, MQPlugin* Owner = nullptr);
 	bool RemoveTopLevelObject(const char* szName, MQPlugin* Owner = nullptr);
 	MQTopLevelObject* FindTopLevelObject(const char* szName) const;
+	int FindTopLevelObjectID(const char* szName) const;
+	MQTopLevelObject* GetTopLevelObject(int id) const;
 
 	// DataTypes
 	bool AddDataType(MQ2Type& TypeInstance, MQPlugin* Owner = nullptr);
@@ -80,6 +146,8 @@ public:
 		const std::string& Member, char* pIndex, bool checkFirst) const;
 
 	bool EvaluateDataExpression(MQTypeVar& Result, const char* pStart, char* pIndex, bool allowFunction = false) const;
+	EvaluateResult EvaluateBoundMember(MQ2Type* type, MQVarPtr& VarPtr, MQTypeVar& Result,
+		const MQDataChainStep& step, char* pIndex) const;
 
 	static inline int EvaluateResultToInt(MQDataAPI::EvaluateResult result)
 	{
@@ -99,19 +167,33 @@ public:
 	bool IsReservedName(const std::string& name) const;
 
 	bool ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const;
+	bool EvaluateDataChain(const std::vector<MQDataChainStep>& chain, MQTypeVar& Result) const;
 
 private:
 	void RegisterTopLevelObjects();
 
+	const MQNameLookupTable* GetTopLevelObjectTable() const;
+	const MQNameLookupTable* GetDataTypeTable() const;
+
 private:
 	std::unordered_map<std::string, std::unique_ptr<MQTopLevelObject>> m_tloMap;
 	std::unordered_map<std::string, MQ2Type*> m_dataTypeMap;
 	std::unordered_map<std::string, std::vector<MQ2Type*>> m_typeExtensions;
 	mutable std::recursive_mutex m_mutex;
+
+	// Lock free lookup tables for TLO and data type names. They are rebuilt on the first lookup
+	// after a change, and every table ever published is kept so that readers never race a free.
+	std::vector<MQTopLevelObject*> m_tloByID;
+	mutable std::atomic<const MQNameLookupTable*> m_tloTable{ nullptr };
+	mutable std::atomic<const MQNameLookupTable*> m_dataTypeTable{ nullptr };
+	mutable std::vector<std::unique_ptr<MQNameLookupTable>> m_lookupTables;
 };
 
 extern MQDataAPI* pDataAPI;
 
+// Changes whenever a data type, its members or its extensions change.
+uint32_t GetDataTypeGeneration();
+
 std::string HandleParseParam(std::string_view strOriginal, bool bParseOnce = false);
 
 enum class ModifyMacroMode { Default, Wrap, WrapNoDoubles };
@@ -119,6 +201,21 @@ enum class ModifyMacroMode { Default, Wrap, WrapNoDoubles };
 std::string ModifyMacroString(std::string_view strOriginal, bool bParseOnce = false,
 	ModifyMacroMode iOperation = ModifyMacroMode::Default);
 
+// CompileMacroString and friends are declared in mq/api/MacroAPI.h
+void ClearCompiledMacroStrings();
+
+// Calculates a compiled condition such as the "(${Me.PctHPs} < 50)" of an /if. Variables that
+// evaluate to plain numbers are passed to Calculate as values instead of being written into the
+// condition text and read back out of it. Returns 1 on success. Otherwise strExpanded is set to the
+// condition as ParseMacroData would have expanded it, and the return value is 0 if Calculate
+// failed on it (the error has been reported) or -1 if it still needs to be calculated as text.
+// With #lazyconditions, the operands of && and || are only evaluated until the result is known.
+int EvaluateCompiledCondition(const MQCompiledMacroString& compiled, double& Result, std::string& strExpanded);
+
+// Finds the end of the parenthesized condition at the start of the parameters of an /if or /while,
+// skipping over the contents of ${} variables. Returns one past the closing paren, or npos.
+size_t FindMacroConditionEnd(std::string_view strParameters);
+
 //============================================================================
 
 // MQ2Hud is using this...
@@ -70,4 +70,104 @@ int GetBankSlotCount(int nSize, bool bEmptyOnly /* = false */)
 	return numSlots;
 }
 
+static bool operator==(const MQInventoryItemSnapshot& a, const MQInventoryItemSnapshot& b)
+{
+	return a.Location == b.Location
+		&& a.Slot == b.Slot
+		&& a.BagSlot == b.BagSlot
+		&& a.ItemID == b.ItemID
+		&& a.StackCount == b.StackCount
+		&& a.Charges == b.Charges
+		&& a.Flags == b.Flags
+		&& strcmp(a.Name, b.Name) == 0;
+}
+
+struct InventorySnapshotState
+{
+	MQInventorySnapshot snapshot = {};
+	uint32_t generation = 0;
+	std::vector<MQInventoryItemSnapshot> scratch;
+};
+
+static InventorySnapshotState s_inventorySnapshots[3];
+
+static void AddItemsToSnapshot(std::vector<MQInventoryItemSnapshot>& items, eqlib::ItemContainer& container)
+{
+	container.VisitItems(-1, -1, -1, [&items](const eqlib::ItemPtr& pItem, const eqlib::ItemIndex& index)
+		{
+			eqlib::ItemDefinition* pDef = pItem->GetItemDefinition();
+
+			MQInventoryItemSnapshot& item = items.emplace_back();
+			item.Location = pItem->GetItemLocation().GetLocation();
+			item.Slot = static_cast<int16_t>(index.GetSlot(0));
+			item.BagSlot = static_cast<int16_t>(index.GetSlot(1));
+			item.ItemID = pItem->GetID();
+			strcpy_s(item.Name, pItem->GetName());
+			item.StackCount = pItem->GetItemCount();
+			item.Charges = pItem->GetType() == ITEMTYPE_NORMAL ? pItem->Charges : 0;
+
+			item.Flags = 0;
+			if (pItem->IsLore(false))
+				item.Flags |= InventoryItem_Lore;
+			if (!pItem->CanDrop(false, true))
+				item.Flags |= InventoryItem_NoDrop;
+			if (!pDef->NoRent)
+				item.Flags |= InventoryItem_NoRent;
+			if (pItem->IsContainer())
+				item.Flags |= InventoryItem_Container;
+			if (pItem->IsStackable())
+				item.Flags |= InventoryItem_Stackable;
+			if (pItem->GetType() == ITEMTYPE_NORMAL && pDef->IsMagic())
+				item.Flags |= InventoryItem_Magic;
+		});
+}
+
+const MQInventorySnapshot& GetInventorySnapshot(InventorySnapshotSource source)
+{
+	InventorySnapshotState& state = s_inventorySnapshots[static_cast<int>(source)];
+
+	// Shares its invalidation with the index FindItem and friends use.
+	const uint32_t generation = GetInventoryIndexGeneration();
+	if (state.generation == generation)
+		return state.snapshot;
+
+	state.generation = generation;
+	state.scratch.clear();
+
+	if (eqlib::pLocalPC)
+	{
+		switch (source)
+		{
+		case InventorySnapshotSource::Inventory:
+			if (eqlib::PcProfile* pProfile = GetPcProfile())
+				AddItemsToSnapshot(state.scratch, pProfile->InventoryContainer);
+			break;
+
+		case InventorySnapshotSource::Bank:
+			AddItemsToSnapshot(state.scratch, pLocalPC->BankItems);
+			AddItemsToSnapshot(state.scratch, pLocalPC->SharedBankItems);
+			break;
+
+		case InventorySnapshotSource::KeyRings:
+#if HAS_KEYRING_WINDOW
+			for (auto keyRingType = eKeyRingTypeFirst;
+				keyRingType <= eKeyRingTypeLast;
+				keyRingType = static_cast<KeyRingType>(keyRingType + 1))
+			{
+				AddItemsToSnapshot(state.scratch, pLocalPC->GetKeyRingItems(keyRingType));
+			}
+#endif
+			break;
+		}
+	}
+
+	if (state.scratch != state.snapshot.Items)
+	{
+		state.snapshot.Items.swap(state.scratch);
+		++state.snapshot.Revision;
+	}
+
+	return state.snapshot;
+}
+
 } // namespace mq
\ No newline at end of file
@@ -20,9 +20,58 @@
 
 #include "routing/PostOffice.h"
 
+#include <psapi.h>
+
 namespace mq {
 using namespace postoffice;
 
+extern float gCurrentCPU;
+extern uint64_t s_commandCount;
+
+// How often a performance summary is sent to the launcher
+static constexpr std::chrono::seconds PERFORMANCE_REPORT_INTERVAL = std::chrono::seconds(5);
+
+// Pipe that this client listens on for mail from other clients when peer routing is on
+static constexpr const char* PEER_PIPE_PATH_FORMAT = R"(\\.\pipe\mqpipe_peer_{})";
+
+// Mail sent to a client through the launcher before a direct connection is opened to it
+static constexpr uint32_t PEER_CONNECTION_THRESHOLD = 16;
+
+// Every direct connection has its own pipe thread, so only the first few busy peers get one
+static constexpr size_t MAX_PEER_CONNECTIONS = 16;
+
+// Longest that delivering mail to mailboxes can take in one pulse. Whatever is left waits for the next.
+static constexpr std::chrono::milliseconds MAIL_TIME_BUDGET = std::chrono::milliseconds(4);
+
+static uint32_t GetClientActivity()
+{
+	uint32_t activity = MQClientActivity_None;
+
+	if (gbInForeground)
+		activity |= MQClientActivity_Foreground;
+
+	if (gZoning || gGameState != GAMESTATE_INGAME)
+		activity |= MQClientActivity_Zoning;
+
+	if ((pEverQuestInfo && pEverQuestInfo->bAutoAttack) || (pPlayerWnd && pPlayerWnd->CombatState == eCombatState_Combat))
+		activity |= MQClientActivity_InCombat;
+
+	if (pLocalPlayer && GetSpellByID(pLocalPlayer->CastingData.SpellID))
+		activity |= MQClientActivity_Casting;
+
+	return activity;
+}
+
+static std::chrono::nanoseconds GetLuaThreadTime()
+{
+	uint32_t luaBenchmark = 0;
+	MQBenchmark benchmark;
+	if (FindMQ2Benchmark("Lua_Threads", luaBenchmark) && GetMQ2Benchmark(luaBenchmark, benchmark))
+		return benchmark.TotalTime;
+
+	return std::chrono::nanoseconds::zero();
+}
+
 // MQModule forward declarations
 namespace pipeclient {
 static void InitializePostOffice();
@@ -60,11 +109,22 @@ private:
 		std::string account;
 		std::string server;
 		std::string character;
+		std::string peerPipe;
 	};
 
 	std::unordered_map<uint32_t, ClientIdentification> m_identities;
 	ci_unordered::map<std::string, uint32_t> m_names;
 
+	// Mail counts for other clients, and the direct connection once one has been opened
+	struct PeerConnection
+	{
+		uint32_t messages = 0;
+		std::unique_ptr<ProtoPipeClient> pipe;
+	};
+
+	std::unordered_map<uint32_t, PeerConnection> m_peers;
+	size_t m_peerConnectionCount = 0;
+
 	class PipeEventsHandler : public NamedPipeEvents
 	{
 	public:
@@ -75,45 +135,8 @@ private:
 			switch (message->GetMessageId())
 			{
 			case MQMessageId::MSG_ROUTE:
-			{
-				auto envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
-				const auto& address = envelope.address();
-				// either this message is coming off the pipe, so assume it was routed correctly by the server,
-				// or it was routed internally after checking to make sure that the destination of the message
-				// was within the client. In either case, we can safely assume that we should route it to an
-				// internal mailbox
-				if (address.has_mailbox() && !ci_equals(address.mailbox(), "pipe_client"))
-				{
-					// we need to loop all mailboxes and deliver to all of them that end with the address
-					// if this is an RPC message, then we need to ensure that we have only one
-					if (message->GetRequestMode() == MQRequestMode::CallAndResponse)
-					{
-						auto mailbox = m_postOffice->FindMailbox(address, m_postOffice->m_mailboxes.begin());
-
-						if (mailbox == m_postOffice->m_mailboxes.end()) // no addresses
-							RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), nullptr);
-						else if (m_postOffice->FindMailbox(address, std::next(mailbox)) != m_postOffice->m_mailboxes.end()) // multiple addresses
-							RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), nullptr);
-						else // we have exactly one recipient, this is valid
-							m_postOffice->DeliverTo(address.mailbox(), std::move(message));
-					}
-					else
-					{
-						// in any other case, just route the message
-						m_postOffice->DeliverTo(address.mailbox(), std::move(message));
-					}
-				}
-				else
-				{
-					// This is a failsafe action, we shouldn't expect to be here often. For this code to
-					// be reached, we would have to have a client that packages a message in an envelope
-					// that is intended to be parsed directly by the server and not routed anywhere (so
-					// no mailbox routing information is included), rather than just send the message
-					m_postOffice->DeliverTo("pipe_client", std::move(message));
-				}
-
+				m_postOffice->DeliverRoutedMessage(std::move(message));
 				break;
-			}
 
 			case MQMessageId::MSG_IDENTIFICATION:
 				if (message->GetHeader()->messageLength > 0)
@@ -131,7 +154,8 @@ private:
 							id.pid(),
 							id.has_account() ? id.account() : "",
 							id.has_server() ? id.server() : "",
-							id.has_character() ? id.character() : ""
+							id.has_character() ? id.character() : "",
+							id.has_peer_pipe() ? id.peer_pipe() : ""
 							});
 
 						// only include the PID here, otherwise it's pseudonym-identifiable information from the logs
@@ -158,9 +182,11 @@ private:
 				else
 				{
 					m_postOffice->m_identities.erase(id.pid());
+					m_postOffice->ClosePeerConnection(id.pid());
 				}
 
 				// TODO: forward the message to all mailboxes
+				break;
 			}
 
 			case MQMessageId::MSG_MAIN_CRASHPAD_CONFIG:
@@ -209,6 +235,15 @@ private:
 				}
 				break;
 
+			case MQMessageId::MSG_MAIN_FRAME_BUDGET:
+				if (message->size() >= sizeof(MQMessageFrameBudget))
+				{
+					const MQMessageFrameBudget* budget = message->get<MQMessageFrameBudget>();
+
+					SetFrameLimiterHostBudget(budget->simulationFPS, std::chrono::milliseconds(budget->durationMs));
+				}
+				break;
+
 			default: break;
 			}
 		}
@@ -226,6 +261,43 @@ private:
 
 			// and then ask for the list of all ID's
 			m_postOffice->m_pipeClient.SendMessage(MQMessageId::MSG_IDENTIFICATION, nullptr, 0);
+
+			// a new launcher doesn't know our mailboxes yet
+			m_postOffice->m_mailboxesChanged = true;
+		}
+
+	private:
+		MQPostOffice* m_postOffice;
+	};
+
+	// Handles mail that other clients send straight to this one, and the replies that come back on
+	// the connections that this client opened to them.
+	class PeerEventsHandler : public NamedPipeEvents
+	{
+	public:
+		PeerEventsHandler(MQPostOffice* postOffice) : m_postOffice(postOffice) {}
+
+		virtual void OnIncomingMessage(PipeMessagePtr&& message) override
+		{
+			switch (message->GetMessageId())
+			{
+			case MQMessageId::MSG_ROUTE:
+				m_postOffice->DeliverRoutedMessage(std::move(message));
+				break;
+
+			case MQMessageId::MSG_MAIN_FOCUS_ACTIVATE_WND:
+				// the client that asked isn't in the foreground, but this one is, so it can do the
+				// switch without the launcher having to pass the request along
+				if (message->size() >= sizeof(MQMessageActivateWnd))
+				{
+					const MQMessageActivateWnd* request = message->get<MQMessageActivateWnd>();
+
+					pipeclient::RequestActivateWindow((HWND)request->hWnd, false);
+				}
+				break;
+
+			default: break;
+			}
 		}
 
 	private:
@@ -277,22 +349,148 @@ public:
 			{ return ci_ends_with(pair.first, address.mailbox()); });
 	}
 
+	void DeliverRoutedMessage(PipeMessagePtr&& message)
+	{
+		proto::routing::Envelope envelope;
+		std::string_view payload;
+		OpenEnvelope(*message, envelope, payload);
+
+		const auto& address = envelope.address();
+		// either this message is coming off the pipe, so assume it was routed correctly by the server
+		// or the peer that sent it, or it was routed internally after checking to make sure that the
+		// destination of the message was within the client. In either case, we can safely assume that
+		// we should route it to an internal mailbox
+		if (address.has_mailbox() && !ci_equals(address.mailbox(), "pipe_client"))
+		{
+			// we need to loop all mailboxes and deliver to all of them that end with the address
+			// if this is an RPC message, then we need to ensure that we have only one
+			if (message->GetRequestMode() == MQRequestMode::CallAndResponse)
+			{
+				auto mailbox = FindMailbox(address, m_mailboxes.begin());
+
+				if (mailbox == m_mailboxes.end()) // no addresses
+					RoutingFailed(envelope, MsgError_RoutingFailed, std::move(message), nullptr);
+				else if (FindMailbox(address, std::next(mailbox)) != m_mailboxes.end()) // multiple addresses
+					RoutingFailed(envelope, MsgError_AmbiguousRecipient, std::move(message), nullptr);
+				else // we have exactly one recipient, this is valid
+					DeliverTo(address.mailbox(), std::move(message));
+			}
+			else
+			{
+				// in any other case, just route the message
+				DeliverTo(address.mailbox(), std::move(message));
+			}
+		}
+		else
+		{
+			// This is a failsafe action, we shouldn't expect to be here often. For this code to
+			// be reached, we would have to have a client that packages a message in an envelope
+			// that is intended to be parsed directly by the server and not routed anywhere (so
+			// no mailbox routing information is included), rather than just send the message
+			DeliverTo("pipe_client", std::move(message));
+		}
+	}
+
+	// Returns the direct connection to the one client that the address resolves to, if there is
+	// one and it is connected. Mail for any other address goes through the launcher, since only it
+	// knows every client that matches. A connection is opened once enough mail has gone to the same
+	// client; until it is up the mail keeps going through the launcher, so mail sent right before
+	// the switch can arrive after mail sent right after it.
+	ProtoPipeClient* GetPeerConnection(const proto::routing::Address& address)
+	{
+		if (!gbPeerRouting)
+			return nullptr;
+
+		uint32_t pid = 0;
+		if (address.has_pid())
+		{
+			pid = address.pid();
+		}
+		else if (address.has_name())
+		{
+			auto name_it = m_names.find(address.name());
+			if (name_it == m_names.end())
+				return nullptr;
+
+			pid = name_it->second;
+		}
+
+		return GetPeerConnection(pid, false);
+	}
+
+	// Returns the direct connection to the client with the given pid if it is connected. Unless
+	// openNow is set, the connection is only opened once enough mail has gone to that client.
+	ProtoPipeClient* GetPeerConnection(uint32_t pid, bool openNow)
+	{
+		if (!gbPeerRouting || pid == 0 || pid == GetCurrentProcessId())
+			return nullptr;
+
+		// only clients that announced a pipe can be reached directly
+		auto ident_it = m_identities.find(pid);
+		if (ident_it == m_identities.end() || ident_it->second.peerPipe.empty())
+			return nullptr;
+
+		PeerConnection& peer = m_peers[pid];
+		if (peer.pipe == nullptr)
+		{
+			if ((++peer.messages < PEER_CONNECTION_THRESHOLD && !openNow) || m_peerConnectionCount >= MAX_PEER_CONNECTIONS)
+				return nullptr;
+
+			SPDLOG_INFO("Opening direct connection to {}", pid);
+
+			peer.pipe = std::make_unique<ProtoPipeClient>(ident_it->second.peerPipe.c_str());
+			peer.pipe->SetHandler(m_peerHandler);
+			peer.pipe->Start();
+			++m_peerConnectionCount;
+		}
+
+		return peer.pipe->IsConnected() ? peer.pipe.get() : nullptr;
+	}
+
+	void ClosePeerConnection(uint32_t pid)
+	{
+		auto peer_it = m_peers.find(pid);
+		if (peer_it == m_peers.end())
+			return;
+
+		if (peer_it->second.pipe != nullptr)
+		{
+			peer_it->second.pipe->Stop();
+			--m_peerConnectionCount;
+		}
+
+		m_peers.erase(peer_it);
+	}
+
+	bool EnrichReturnAddress(proto::routing::Address& address) override
+	{
+		if (!pLocalPC)
+			return false;
+
+		const char* account = GetLoginName();
+		const char* server = GetServerShortName();
+
+		if (address.account() == account && address.server() == server && address.character() == pLocalPC->Name)
+			return false;
+
+		address.set_account(account);
+		address.set_server(server);
+		address.set_character(pLocalPC->Name);
+		return true;
+	}
+
 	void RouteMessage(PipeMessagePtr&& message, const PipeMessageResponseCb& callback) override
 	{
 		if (message->GetMessageId() == MQMessageId::MSG_ROUTE)
 		{
-			auto& envelope = ProtoMessage::Parse<proto::routing::Envelope>(message);
-
-			// always enrich the return address if in game
-			if (pLocalPC)
-			{
-				envelope.mutable_return_address()->set_account(GetLoginName());
-				envelope.mutable_return_address()->set_server(GetServerShortName());
-				envelope.mutable_return_address()->set_character(pLocalPC->Name);
+			proto::routing::Envelope envelope;
+			std::string_view payload;
+			OpenEnvelope(*message, envelope, payload);
 
-				std::string data(envelope.SerializeAsString());
-				message = std::make_unique<PipeMessage>(*message->GetHeader(), &data[0], data.size());
-			}
+			// always enrich the return address if in game. mail from our own mailboxes already is,
+			// so this only has to rebuild messages that were put together somewhere else
+			if (EnrichReturnAddress(*envelope.mutable_return_address()))
+				message = StuffEnvelope(*message->GetHeader(), envelope, payload);
 
 			if (envelope.has_address())
 			{
@@ -306,11 +504,16 @@ public:
 				{
 					// we can't assume that even if we match the address (account/server/character) that this
 					// client is the only one that does. We need to route it through the server to ensure that
-					// it gets to all clients that match
+					// it gets to all clients that match, unless it names exactly one client that we are
+					// connected to directly
+					ProtoPipeClient* pipe = GetPeerConnection(address);
+					if (pipe == nullptr)
+						pipe = &m_pipeClient;
+
 					if (callback == nullptr) // no response
-						m_pipeClient.SendMessage(std::move(message));
+						pipe->SendMessage(std::move(message));
 					else
-						m_pipeClient.SendMessageWithResponse(std::move(message), callback);
+						pipe->SendMessageWithResponse(std::move(message), callback);
 				}
 				else if (address.has_pid() && address.pid() == GetCurrentProcessId() && address.has_mailbox())
 				{
@@ -351,14 +554,133 @@ public:
 		}
 	}
 
+	void GetPipeMessageCounts(uint64_t& sent, uint64_t& received) const
+	{
+		sent = m_pipeClient.GetMessagesSent();
+		received = m_pipeClient.GetMessagesReceived();
+	}
+
+	void OnMailboxesChanged() override
+	{
+		m_mailboxesChanged = true;
+	}
+
+	// Lets the launcher leave this client out of mail for everyone that goes to mailboxes it doesn't
+	// have. Sent once per pulse at most, since a script can register a lot of them at once.
+	void SendMailboxes()
+	{
+		proto::routing::Mailboxes mailboxes;
+		for (const auto& [name, _] : m_mailboxes)
+			mailboxes.add_names(name);
+
+		m_pipeClient.SendProtoMessage(MQMessageId::MSG_MAILBOXES, mailboxes);
+	}
+
 	void ProcessPipeClient()
 	{
+		if (m_pipeClient.IsConnected() && m_mailboxesChanged.exchange(false))
+			SendMailboxes();
+
 		m_pipeClient.Process();
-		Process(1000); // make this large just to prevent overflows
+
+		if (m_peerServer)
+			m_peerServer->Process();
+
+		for (auto& [_, peer] : m_peers)
+		{
+			if (peer.pipe)
+				peer.pipe->Process();
+		}
+
+		Process(1000, MAIL_TIME_BUDGET); // make this large just to prevent overflows
+	}
+
+	// While this client is in the foreground, it lets every other client take the foreground
+	// itself, so that switching to another box doesn't have to go through this one or the launcher.
+	// Windows takes the permission back as soon as the user gives this client any input, so it is
+	// handed out again every pulse.
+	void GrantForegroundToPeers()
+	{
+		if (!m_isForeground)
+			return;
+
+		for (const auto& [pid, _] : m_identities)
+		{
+			if (pid != GetCurrentProcessId())
+				::AllowSetForegroundWindow(pid);
+		}
+	}
+
+	// Collects frame times every pulse and sends a summary of them to the launcher every few
+	// seconds, so that it can show how every client on the machine is doing side by side.
+	void UpdatePerformanceReport()
+	{
+		const auto now = std::chrono::steady_clock::now();
+
+		const std::vector<MQBenchmarkNode>& frameTree = GetBenchmarkFrameTree();
+		if (!frameTree.empty())
+			m_frameTimes.Record(frameTree[0].InclusiveTime);
+
+		// anything seen between reports counts, so that a short cast or fight isn't missed
+		m_activity |= GetClientActivity();
+
+		if (m_lastReport == std::chrono::steady_clock::time_point{})
+		{
+			m_lastReport = now;
+			m_lastCommandCount = s_commandCount;
+			m_lastLuaTime = GetLuaThreadTime();
+			return;
+		}
+
+		if (now - m_lastReport < PERFORMANCE_REPORT_INTERVAL)
+			return;
+
+		auto toMilliseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<float, std::milli>(time).count(); };
+
+		MQMessagePerformanceReport report;
+		report.processId = GetCurrentProcessId();
+		report.frameCount = static_cast<uint32_t>(m_frameTimes.Count);
+		report.frameTimeP50 = toMilliseconds(m_frameTimes.GetPercentile(50));
+		report.frameTimeP95 = toMilliseconds(m_frameTimes.GetPercentile(95));
+		report.frameTimeP99 = toMilliseconds(m_frameTimes.GetPercentile(99));
+		report.frameTimeMax = toMilliseconds(m_frameTimes.Max);
+		report.cpuUsage = gCurrentCPU;
+
+		PROCESS_MEMORY_COUNTERS_EX memoryCounters = { sizeof(PROCESS_MEMORY_COUNTERS_EX) };
+		if (::GetProcessMemoryInfo(::GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memoryCounters), sizeof(memoryCounters)))
+		{
+			report.workingSet = memoryCounters.WorkingSetSize;
+			report.privateBytes = memoryCounters.PrivateUsage;
+		}
+
+		// the command count starts over with every macro
+		const float seconds = std::chrono::duration<float>(now - m_lastReport).count();
+		const uint64_t commandCount = s_commandCount;
+		const uint64_t lines = commandCount >= m_lastCommandCount ? commandCount - m_lastCommandCount : commandCount;
+		report.macroLinesPerSecond = static_cast<float>(lines) / seconds;
+
+		// the benchmark starts over if the lua plugin is reloaded
+		const std::chrono::nanoseconds luaTime = GetLuaThreadTime();
+		if (report.frameCount > 0 && luaTime >= m_lastLuaTime)
+			report.luaTimePerFrame = toMilliseconds(luaTime - m_lastLuaTime) / static_cast<float>(report.frameCount);
+
+		report.simulationFPS = GetFrameLimiterSimulationFPS();
+		report.activity = m_activity;
+
+		m_pipeClient.SendMessage(MQMessageId::MSG_MAIN_PERFORMANCE_REPORT, &report, sizeof(report));
+
+		m_frameTimes.Reset();
+		m_lastReport = now;
+		m_lastCommandCount = commandCount;
+		m_lastLuaTime = luaTime;
+		m_activity = MQClientActivity_None;
 	}
 
 	void NotifyIsForegroundWindow(bool isForeground)
 	{
+		m_isForeground = isForeground;
+		GrantForegroundToPeers();
+
 		MQMessageFocusRequest request;
 		request.focusMode = MQMessageFocusRequest::FocusMode::HasFocus;
 		request.state = isForeground;
@@ -377,6 +699,23 @@ public:
 		if (::SetForegroundWindow(hWnd))
 			return;
 
+		if (sendMessage)
+		{
+			// whichever client is in the foreground can always make the switch, so ask it directly
+			// if there is a connection to it
+			DWORD foregroundPid = 0;
+			::GetWindowThreadProcessId(::GetForegroundWindow(), &foregroundPid);
+
+			if (ProtoPipeClient* peer = GetPeerConnection(foregroundPid, true))
+			{
+				MQMessageActivateWnd message;
+				message.hWnd = hWnd;
+
+				peer->SendMessage(MQMessageId::MSG_MAIN_FOCUS_ACTIVATE_WND, &message, sizeof(message));
+				return;
+			}
+		}
+
 		if (sendMessage && m_pipeClient.IsConnected())
 		{
 			MQMessageFocusRequest request;
@@ -391,6 +730,17 @@ public:
 		ShowWindow(hWnd, SW_RESTORE);
 	}
 
+	proto::routing::Identification GetSelfIdentification() const
+	{
+		proto::routing::Identification id;
+		id.set_pid(GetCurrentProcessId());
+
+		if (m_peerServer)
+			id.set_peer_pipe(m_peerPipeName);
+
+		return id;
+	}
+
 	void SetGameStatePostOffice(DWORD GameState)
 	{
 		static bool logged_in = false;
@@ -398,8 +748,7 @@ public:
 		// 0 is sent from init
 		if (GameState == 0)
 		{
-			proto::routing::Identification id;
-			id.set_pid(GetCurrentProcessId());
+			proto::routing::Identification id = GetSelfIdentification();
 
 			if (pLocalPC && pLocalPC->Name)
 			{
@@ -415,8 +764,7 @@ public:
 		{
 			logged_in = false;
 
-			proto::routing::Identification id;
-			id.set_pid(GetCurrentProcessId());
+			proto::routing::Identification id = GetSelfIdentification();
 
 			m_pipeClient.SendProtoMessage(MQMessageId::MSG_IDENTIFICATION, id);
 		}
@@ -424,8 +772,7 @@ public:
 		{
 			logged_in = true;
 
-			proto::routing::Identification id;
-			id.set_pid(GetCurrentProcessId());
+			proto::routing::Identification id = GetSelfIdentification();
 			id.set_account(GetLoginName());
 			id.set_server(GetServerShortName());
 			id.set_character(pLocalPC->Name);
@@ -436,6 +783,18 @@ public:
 
 	void Initialize()
 	{
+		// the peer pipe is announced with our identification, so it needs to be up before we
+		// connect to the launcher
+		if (gbPeerRouting)
+		{
+			m_peerHandler = std::make_shared<PeerEventsHandler>(this);
+			m_peerPipeName = fmt::format(PEER_PIPE_PATH_FORMAT, GetCurrentProcessId());
+
+			m_peerServer = std::make_unique<ProtoPipeServer>(m_peerPipeName.c_str());
+			m_peerServer->SetHandler(m_peerHandler);
+			m_peerServer->Start();
+		}
+
 		m_pipeClient.SetHandler(std::make_shared<PipeEventsHandler>(this));
 		m_pipeClient.Start();
 		::atexit(StopPipeClient);
@@ -450,17 +809,48 @@ public:
 
 		// we don't need to worry about sending messages after we stop because the pipe client will log
 		// and handle this situation.
+		StopPeerConnections();
 		m_pipeClient.Stop();
 	}
 
+	void StopPeerConnections()
+	{
+		for (auto& [_, peer] : m_peers)
+		{
+			if (peer.pipe)
+				peer.pipe->Stop();
+		}
+
+		m_peers.clear();
+		m_peerConnectionCount = 0;
+
+		if (m_peerServer)
+			m_peerServer->Stop();
+	}
+
 private:
 	ProtoPipeClient m_pipeClient;
+	std::atomic_bool m_mailboxesChanged{ true };
 	Dropbox m_clientDropbox;
 	DWORD m_launcherProcessID;
+	bool m_isForeground = false;
+
+	std::unique_ptr<ProtoPipeServer> m_peerServer;
+	std::shared_ptr<PeerEventsHandler> m_peerHandler;
+	std::string m_peerPipeName;
+
+	MQBenchmarkHistogram m_frameTimes;
+	std::chrono::steady_clock::time_point m_lastReport;
+	uint64_t m_lastCommandCount = 0;
+	std::chrono::nanoseconds m_lastLuaTime = std::chrono::nanoseconds::zero();
+	uint32_t m_activity = MQClientActivity_None;
 
 	static void StopPipeClient()
 	{
-		static_cast<MQPostOffice&>(GetPostOffice()).m_pipeClient.Stop();
+		MQPostOffice& postOffice = static_cast<MQPostOffice&>(GetPostOffice());
+
+		postOffice.StopPeerConnections();
+		postOffice.m_pipeClient.Stop();
 	}
 };
 
@@ -482,6 +872,11 @@ void RequestActivateWindow(HWND hWnd, bool sendMessage)
 	static_cast<MQPostOffice&>(GetPostOffice()).RequestActivateWindow(hWnd, sendMessage);
 }
 
+void GetPipeMessageCounts(uint64_t& sent, uint64_t& received)
+{
+	static_cast<MQPostOffice&>(GetPostOffice()).GetPipeMessageCounts(sent, received);
+}
+
 void InitializePostOffice()
 {
 	static_cast<MQPostOffice&>(GetPostOffice()).Initialize();
@@ -494,7 +889,11 @@ void ShutdownPostOffice()
 
 void PulsePostOffice()
 {
-	static_cast<MQPostOffice&>(GetPostOffice()).ProcessPipeClient();
+	MQPostOffice& postOffice = static_cast<MQPostOffice&>(GetPostOffice());
+
+	postOffice.ProcessPipeClient();
+	postOffice.GrantForegroundToPeers();
+	postOffice.UpdatePerformanceReport();
 }
 
 void SetGameStatePostOffice(DWORD GameState)
@@ -23,6 +23,9 @@ namespace pipeclient {
 void NotifyIsForegroundWindow(bool isForeground);
 void RequestActivateWindow(HWND hWnd, bool sendMessage = true);
 
+// Number of messages this client has sent to and received from the launcher's pipe server.
+void GetPipeMessageCounts(uint64_t& sent, uint64_t& received);
+
 } // namespace pipeclient
 
 } // namespace mq
@@ -109,4 +109,15 @@ bool IsAssistNPC(PlayerClient* pSpawn)
 	return false;
 }
 
+std::vector<PlayerClient*> GetNearestSpawns(std::string_view searchString, int Count)
+{
+	MQSpawnSearch ssSpawn;
+	ClearSearchSpawn(&ssSpawn);
+
+	// ${NearestSpawn} includes the player in its results, so match it here as well.
+	ParseSearchSpawn(std::string(searchString).c_str(), &ssSpawn);
+
+	return GetNearestSpawns(&ssSpawn, Count, pControlledPlayer, true);
+}
+
 } // namespace mq
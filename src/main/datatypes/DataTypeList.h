@@ -40,6 +40,9 @@ DATATYPE(MQ2PluginType, pPluginType, nullptr);
 DATATYPE(MQ2StringType, pStringType, nullptr);
 DATATYPE(MQ2TimeType, pTimeType, nullptr);
 DATATYPE(MQ2TypeType, pTypeType, nullptr);
+DATATYPE(MQ2ListType, pListType, nullptr);
+DATATYPE(MQ2SetType, pSetType, nullptr);
+DATATYPE(MQ2MapType, pMapType, nullptr);
 DATATYPE(MQ2EverQuestType, pEverQuestType, nullptr);
 DATATYPE(MQ2SpawnType, pSpawnType, nullptr);
 DATATYPE(MQ2SpellType, pSpellType, nullptr);
@@ -101,6 +104,7 @@ DATATYPE(MQ2AuraType, pAuraType, nullptr);
 DATATYPE(MQ2BandolierItemType, pBandolierItemType, nullptr);
 DATATYPE(MQ2BandolierType, pBandolierType, nullptr);
 DATATYPE(MQ2FrameLimiterType, pFrameLimiterType, nullptr);
+DATATYPE(MQ2BenchmarkType, pBenchmarkType, nullptr);
 DATATYPE(MQ2AchievementType, pAchievementType, nullptr);
 DATATYPE(MQ2AchievementManagerType, pAchievementManagerType, nullptr);
 DATATYPE(MQ2AchievementCategoryType, pAchievementCategoryType, nullptr);
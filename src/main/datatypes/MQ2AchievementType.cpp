@@ -73,7 +73,7 @@ bool MQ2AchievementManagerType::GetMember(MQVarPtr VarPtr, const char* Member, c
 			}
 			else
 			{
-				Dest.Int = mgr.GetAchievementIndexByName(Index);
+				Dest.Int = GetAchievementIndexByName(Index);
 			}
 		}
 		return true;
@@ -180,7 +180,7 @@ bool MQ2AchievementManagerType::dataAchievement(const char* szIndex, MQTypeVar&
 		}
 		else
 		{
-			Ret.Int = mgr.GetAchievementIndexByName(szIndex);
+			Ret.Int = GetAchievementIndexByName(szIndex);
 		}
 		return true;
 	}
@@ -498,7 +498,7 @@ bool MQ2AchievementType::FromString(MQVarPtr& VarPtr, const char* Source)
 	}
 	else
 	{
-		VarPtr.Int = mgr.GetAchievementIndexByName(Source);
+		VarPtr.Int = GetAchievementIndexByName(Source);
 	}
 
 	return VarPtr.Int != -1;
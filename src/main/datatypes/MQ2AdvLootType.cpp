@@ -64,7 +64,14 @@ bool MQ2AdvLootType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 		return true;
 
 	case AdvLootTypeMembers::PList:
-		if (int index = GetIntFromString(Index, 0))
+	{
+		int index = GetIntFromString(Index, 0);
+
+		// an item name instead of a position in the list
+		if (!index && !IsNumber(Index))
+			index = FindAdvLootRowByName(false, Index) + 1;
+
+		if (index)
 		{
 			index--;
 			if (index < 0)
@@ -82,6 +89,7 @@ bool MQ2AdvLootType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 			}
 		}
 		return false;
+	}
 
 	case AdvLootTypeMembers::SCount:
 		Dest.Int = pAdvancedLootWnd->pCLootList->Items.GetSize();
@@ -89,7 +97,14 @@ bool MQ2AdvLootType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 		return true;
 
 	case AdvLootTypeMembers::SList:
-		if (int index = GetIntFromString(Index, 0))
+	{
+		int index = GetIntFromString(Index, 0);
+
+		// an item name instead of a position in the list
+		if (!index && !IsNumber(Index))
+			index = FindAdvLootRowByName(true, Index) + 1;
+
+		if (index)
 		{
 			index--;
 			if (index < 0)
@@ -108,6 +123,7 @@ bool MQ2AdvLootType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 			}
 		}
 		return false;
+	}
 
 	case AdvLootTypeMembers::PWantCount:
 		Dest.DWord = 0;
@@ -160,14 +160,10 @@ bool MQ2AltAbilityType::GetMember(MQVarPtr VarPtr, const char* Member, char* Ind
 
 			if (requiredGroup > 0 && requiredGroupRank > 0)
 			{
-				for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
+				if (CAltAbilityData* tmpAbility = FindAltAbilityByGroupID(requiredGroup))
 				{
-					CAltAbilityData* tmpAbility = GetAAById(nAbility);
-					if (tmpAbility && tmpAbility->GroupID == requiredGroup)
-					{
-						Dest.Ptr = tmpAbility;
-						return true;
-					}
+					Dest.Ptr = tmpAbility;
+					return true;
 				}
 			}
 		}
@@ -274,39 +270,16 @@ bool MQ2AltAbilityType::dataAltAbility(const char* szIndex, MQTypeVar& Ret)
 	if (!szIndex[0])
 		return false;
 
-	if (IsNumber(szIndex))
-	{
-		for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
-		{
-			if (CAltAbilityData* pAbility = GetAAById(nAbility))
-			{
-				if (pAbility->GroupID == GetIntFromString(szIndex, 0))
-				{
-					Ret.Ptr = pAbility;
-					Ret.Type = pAltAbilityType;
-					return true;
-				}
-			}
-		}
-	}
-	else
-	{
-		// we need to get the level appropriate one if they just supplied a name
-		int level = pLocalPlayer ? pLocalPlayer->Level : -1;
+	// we need to get the level appropriate one if they just supplied a name
+	CAltAbilityData* pAbility = IsNumber(szIndex)
+		? FindAltAbilityByGroupID(GetIntFromString(szIndex, 0))
+		: FindAltAbilityByName(szIndex);
 
-		for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
-		{
-			if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
-			{
-				const char* pName = pAbility->GetNameString();
-				if (!_stricmp(szIndex, pName))
-				{
-					Ret.Ptr = pAbility;
-					Ret.Type = pAltAbilityType;
-					return true;
-				}
-			}
-		}
+	if (pAbility)
+	{
+		Ret.Ptr = pAbility;
+		Ret.Type = pAltAbilityType;
+		return true;
 	}
 
 	return false;
@@ -445,18 +445,12 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 			if (Len == 0)
 				return false;
 
-			if (Len > MAX_STRING - 1)
-				Len = MAX_STRING - 1;
-
 			if (Len > 0)
 			{
 				if (static_cast<size_t>(Len) > StrLen)
 					Len = static_cast<int>(StrLen);
 
-				memmove(DataTypeTemp, szString, Len);
-
-				DataTypeTemp[Len] = 0;
-				Dest.Ptr = &DataTypeTemp[0];
+				Dest.Ptr = StoreDataTypeTemp(std::string_view(szString, Len));
 			}
 			else
 			{
@@ -464,14 +458,11 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 
 				if (static_cast<size_t>(Len) > StrLen)
 				{
-					strcpy_s(DataTypeTemp, "");
-					Dest.Ptr = &DataTypeTemp[0];
+					Dest.Ptr = StoreDataTypeTemp("");
 					return true;
 				}
 
-				memmove(DataTypeTemp, szString, StrLen - Len);
-				DataTypeTemp[StrLen - Len] = 0;
-				Dest.Ptr = &DataTypeTemp[0];
+				Dest.Ptr = StoreDataTypeTemp(std::string_view(szString, StrLen - Len));
 			}
 		}
 		return true;
@@ -484,7 +475,6 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 
 		{
 			size_t StrLen = strlen(szString);
-			const char* pStart = szString;
 
 			int Len = GetIntFromString(Index, 0);
 
@@ -497,26 +487,18 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 
 				if (static_cast<size_t>(Len) >= StrLen)
 				{
-					strcpy_s(DataTypeTemp, "");
-					Dest.Ptr = &DataTypeTemp[0];
+					Dest.Ptr = StoreDataTypeTemp("");
 					return true;
 				}
 
-				pStart = &pStart[Len];
-				Len = static_cast<int>(StrLen) - Len;
-
-				memmove(DataTypeTemp, pStart, Len + 1);
-				Dest.Ptr = &DataTypeTemp[0];
+				Dest.Ptr = StoreDataTypeTemp(std::string_view(szString + Len, StrLen - Len));
 			}
 			else
 			{
-				pStart = &pStart[strlen(pStart) - Len];
-
-				if (pStart < szString)
-					pStart = szString;
+				if (static_cast<size_t>(Len) > StrLen)
+					Len = static_cast<int>(StrLen);
 
-				memmove(DataTypeTemp, pStart, Len + 1);
-				Dest.Ptr = &DataTypeTemp[0];
+				Dest.Ptr = StoreDataTypeTemp(std::string_view(szString + StrLen - Len, Len));
 			}
 		}
 		return true;
@@ -566,32 +548,28 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 				pos += replace.length();
 			}
 
-			strcpy_s(DataTypeTemp, subject.c_str());
-
-			void* x = Dest.Ptr = DataTypeTemp;
-
-			if (Dest.Ptr = DataTypeTemp)
-			{
-				return true;
-			}
+			Dest.Ptr = StoreDataTypeTemp(subject);
+			return true;
 		}
 
 		return false;
 	}
 
-	case StringMembers::Upper:
-		strcpy_s(DataTypeTemp, szString);
-		_strupr_s(DataTypeTemp);
-		Dest.Ptr = &DataTypeTemp[0];
+	case StringMembers::Upper: {
+		char* szUpper = StoreDataTypeTemp(szString);
+		_strupr_s(szUpper, strlen(szUpper) + 1);
+		Dest.Ptr = szUpper;
 		Dest.Type = pStringType;
 		return true;
+	}
 
-	case StringMembers::Lower:
-		strcpy_s(DataTypeTemp, szString);
-		_strlwr_s(DataTypeTemp);
-		Dest.Ptr = &DataTypeTemp[0];
+	case StringMembers::Lower: {
+		char* szLower = StoreDataTypeTemp(szString);
+		_strlwr_s(szLower, strlen(szLower) + 1);
+		Dest.Ptr = szLower;
 		Dest.Type = pStringType;
 		return true;
+	}
 
 	case StringMembers::Compare:
 		Dest.Int = 0;
@@ -632,21 +610,16 @@ bool MQ2StringType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 
 			if (nStart >= StrLen)
 			{
-				strcpy_s(DataTypeTemp, "");
-				Dest.Ptr = &DataTypeTemp[0];
+				Dest.Ptr = StoreDataTypeTemp("");
 				return true;
 			}
 
-			pStr += nStart;
-
-			if (Len > StrLen || Len < 0)
+			if (Len > StrLen - nStart || Len < 0)
 			{
-				Len = StrLen;
+				Len = StrLen - nStart;
 			}
 
-			memmove(DataTypeTemp, pStr, Len);
-			DataTypeTemp[Len] = '\0';
-			Dest.Ptr = &DataTypeTemp[0];
+			Dest.Ptr = StoreDataTypeTemp(std::string_view(pStr + nStart, Len));
 			return true;
 		}
 		return false;
@@ -1502,17 +1502,12 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 		else
 		{
 			// name
-			for (unsigned long nGem = 0; nGem < NUM_SPELL_GEMS; nGem++)
+			int nGem = GetMemorizedSpellGem(Index);
+			if (nGem >= 0)
 			{
-				if (SPELL* pSpell = GetSpellByID(GetMemorizedSpell(nGem)))
-				{
-					if (!_stricmp(Index, pSpell->Name))
-					{
-						Dest.DWord = nGem + 1;
-						Dest.Type = pIntType;
-						return true;
-					}
-				}
+				Dest.DWord = nGem + 1;
+				Dest.Type = pIntType;
+				return true;
 			}
 		}
 		return false;
@@ -1748,54 +1743,22 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 		Dest.Type = pTimeStampType;
 
 		if (Index[0]) {
-			if (IsNumber(Index))
-			{
-				// numeric
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
-					{
-						if (pAbility->ID == GetIntFromString(Index, 0))
-						{
-							int reusetimer = 0;
-							pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, &reusetimer);
-							if (reusetimer < 0)
-							{
-								reusetimer = 0;
-							}
+			// by name we need to take their level into account
+			CAltAbilityData* pAbility = IsNumber(Index)
+				? FindOwnedAltAbilityByID(GetIntFromString(Index, 0))
+				: FindOwnedAltAbilityByName(Index);
 
-							Dest.UInt64 = reusetimer * 1000;
-							return true;
-						}
-					}
-				}
-			}
-			else
+			if (pAbility)
 			{
-				// by name so we ned to take level into account
-				int level = pLocalPlayer->Level;
-
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
+				int reusetimer = 0;
+				pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, &reusetimer);
+				if (reusetimer < 0)
 				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
-					{
-						if (const char* pName = pDBStr->GetString(pAbility->nName, eAltAbilityName))
-						{
-							if (!_stricmp(Index, pName))
-							{
-								int reusetimer = 0;
-								pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, &reusetimer);
-								if (reusetimer < 0)
-								{
-									reusetimer = 0;
-								}
-
-								Dest.UInt64 = static_cast<uint64_t>(reusetimer) * 1000;
-								return true;
-							}
-						}
-					}
+					reusetimer = 0;
 				}
+
+				Dest.UInt64 = static_cast<uint64_t>(reusetimer) * 1000;
+				return true;
 			}
 		}
 		return false;
@@ -1806,45 +1769,13 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 
 		if (Index[0])
 		{
-			if (IsNumber(Index))
-			{
-				// numeric
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
-					{
-						if (pAbility->ID == GetIntFromString(Index, 0))
-						{
-							if (pAbility->SpellID != -1)
-								Dest.Set(pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, nullptr));
+			// by name we need to take their level into account
+			CAltAbilityData* pAbility = IsNumber(Index)
+				? FindOwnedAltAbilityByID(GetIntFromString(Index, 0))
+				: FindOwnedAltAbilityByName(Index);
 
-							return true;
-						}
-					}
-				}
-			}
-			else
-			{
-				// by name so we need to take their level into account
-				int level = pLocalPlayer->Level;
-
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
-					{
-						if (const char* pName = pDBStr->GetString(pAbility->nName, eAltAbilityName))
-						{
-							if (!_stricmp(Index, pName))
-							{
-								if (pAbility->SpellID != -1)
-									Dest.Set(pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, nullptr));
-
-								return true;
-							}
-						}
-					}
-				}
-			}
+			if (pAbility && pAbility->SpellID != -1)
+				Dest.Set(pAltAdvManager->IsAbilityReady(pLocalPC, pAbility, nullptr));
 		}
 		return true;
 
@@ -1852,40 +1783,15 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 		Dest.Type = pAltAbilityType;
 		if (Index[0])
 		{
-			if (IsNumber(Index))
-			{
-				// numeric
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
-					{
-						if (pAbility->ID == GetIntFromString(Index, 0))
-						{
-							Dest.Ptr = pAbility;
-							return true;
-						}
-					}
-				}
-			}
-			else
-			{
-				// by name so we need to take their level into account
-				int level = pLocalPlayer->Level;
+			// by name we need to take their level into account
+			CAltAbilityData* pAbility = IsNumber(Index)
+				? FindOwnedAltAbilityByID(GetIntFromString(Index, 0))
+				: FindOwnedAltAbilityByName(Index);
 
-				for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-				{
-					if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
-					{
-						if (const char* pName = pDBStr->GetString(pAbility->nName, eAltAbilityName))
-						{
-							if (!_stricmp(Index, pName))
-							{
-								Dest.Ptr = pAbility;
-								return true;
-							}
-						}
-					}
-				}
+			if (pAbility)
+			{
+				Dest.Ptr = pAbility;
+				return true;
 			}
 		}
 		return false;
@@ -2120,17 +2026,12 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 			else
 			{
 				// name
-				for (int nSpell = 0; nSpell < NUM_BOOK_SLOTS; nSpell++)
+				int nSpell = GetSpellBookSlotByName(Index);
+				if (nSpell >= 0)
 				{
-					if (pProfile->SpellBook[nSpell] != -1)
-					{
-						if (!_stricmp(GetSpellNameByID(pProfile->SpellBook[nSpell]), Index))
-						{
-							Dest.DWord = nSpell + 1;
-							Dest.Type = pIntType;
-							return true;
-						}
-					}
+					Dest.DWord = nSpell + 1;
+					Dest.Type = pIntType;
+					return true;
 				}
 			}
 		}
@@ -2145,14 +2046,11 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 				// Look for spell in our book by ID
 				int spellId = GetIntFromString(Index, 0);
 
-				for (int nSpell : pProfile->SpellBook)
+				if (GetSpellBookSlot(spellId) >= 0)
 				{
-					if (nSpell == spellId)
-					{
-						Dest.Type = pSpellType;
-						Dest.Ptr = GetSpellByID(spellId);
-						return true;
-					}
+					Dest.Type = pSpellType;
+					Dest.Ptr = GetSpellByID(spellId);
+					return true;
 				}
 			}
 			else
@@ -2161,34 +2059,22 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 				if (PSPELL pSpell = GetSpellByName(Index))
 				{
 					// If we found a spell check if its in the spellbook
-					int spellID = pSpell->ID;
-
-					for (int nSpell : pProfile->SpellBook)
+					if (GetSpellBookSlot(pSpell->ID) >= 0)
 					{
-						if (nSpell == spellID)
-						{
-							Dest.Type = pSpellType;
-							Dest.Ptr = pSpell;
-							return true;
-						}
+						Dest.Type = pSpellType;
+						Dest.Ptr = pSpell;
+						return true;
 					}
 
-					// Scan the spell book for spells in the same group that match
+					// Check the spells we have in the same group for one that matches
 					// at the substring level
-					for (int nSpell : pProfile->SpellBook)
+					for (EQ_Spell* pFoundSpell : GetSpellBookSpellsByGroupID(pSpell->SpellGroup))
 					{
-						if (nSpell != -1)
+						if (ci_find_substr(pFoundSpell->Name, pSpell->Name) == 0)
 						{
-							if (PSPELL pFoundSpell = GetSpellByID(nSpell))
-							{
-								if (pFoundSpell->SpellGroup == pSpell->SpellGroup
-									&& ci_find_substr(pFoundSpell->Name, pSpell->Name) == 0)
-								{
-									Dest.Ptr = pFoundSpell;
-									Dest.Type = pSpellType;
-									return true;
-								}
-							}
+							Dest.Ptr = pFoundSpell;
+							Dest.Type = pSpellType;
+							return true;
 						}
 					}
 				}
@@ -2287,20 +2173,15 @@ bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Inde
 			}
 			else
 			{
-				for (int nGem = 0; nGem < NUM_SPELL_GEMS; nGem++)
+				int nGem = GetMemorizedSpellGem(Index);
+				if (nGem >= 0)
 				{
-					if (SPELL* pSpell = GetSpellByID(GetMemorizedSpell(nGem)))
+					if (pDisplay->TimeStamp > pLocalPlayer->SpellGemETA[nGem]
+						&& pDisplay->TimeStamp > pLocalPlayer->GetSpellCooldownETA())
 					{
-						if (!_stricmp(Index, pSpell->Name))
-						{
-							if (pDisplay->TimeStamp > pLocalPlayer->SpellGemETA[nGem]
-								&& pDisplay->TimeStamp > pLocalPlayer->GetSpellCooldownETA())
-							{
-								Dest.Set(true);
-							}
-							return true;
-						}
+						Dest.Set(true);
 					}
+					return true;
 				}
 			}
 		}
@@ -0,0 +1,516 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2DataTypes.h"
+
+namespace mq::datatypes {
+
+// Collections hold strings. Keys are compared without regard to case, like the rest of the macro
+// language. Initial values are given as a comma separated list, and map entries as key=value.
+
+struct MQListData
+{
+	std::vector<std::string> Items;
+};
+
+struct MQSetData
+{
+	ci_unordered::set<std::string> Items;
+};
+
+struct MQMapData
+{
+	ci_unordered::map<std::string, std::string> Items;
+};
+
+template <typename Func>
+static void ForEachCollectionItem(std::string_view source, Func&& func)
+{
+	if (source.empty())
+		return;
+
+	for (std::string_view item : split_view(source, ','))
+	{
+		item = trim(item);
+		if (!item.empty())
+			func(item);
+	}
+}
+
+// Splits "key,value" on the first comma, values may contain commas.
+static std::pair<std::string_view, std::string_view> SplitCollectionIndex(std::string_view index, char delim = ',')
+{
+	const size_t pos = index.find(delim);
+	if (pos == std::string_view::npos)
+		return { trim(index), std::string_view() };
+
+	return { trim(index.substr(0, pos)), index.substr(pos + 1) };
+}
+
+static bool SetCollectionString(std::string_view value, MQTypeVar& Dest)
+{
+	strncpy_s(DataTypeTemp, value.data(), std::min(value.size(), DataTypeTemp.size() - 1));
+	Dest.Ptr = &DataTypeTemp[0];
+	Dest.Type = pStringType;
+	return true;
+}
+
+//============================================================================
+// MQ2ListType
+
+enum class ListMembers
+{
+	Count = 1,
+	Item,
+	Contains,
+	Index,
+	First,
+	Last,
+};
+
+enum class ListMethods
+{
+	Add = 1,
+	Insert,
+	Remove,
+	RemoveAt,
+	Clear,
+};
+
+MQ2ListType::MQ2ListType() : MQ2Type("list")
+{
+	ScopedTypeMember(ListMembers, Count);
+	ScopedTypeMember(ListMembers, Item);
+	ScopedTypeMember(ListMembers, Contains);
+	ScopedTypeMember(ListMembers, Index);
+	ScopedTypeMember(ListMembers, First);
+	ScopedTypeMember(ListMembers, Last);
+
+	ScopedTypeMethod(ListMethods, Add);
+	ScopedTypeMethod(ListMethods, Insert);
+	ScopedTypeMethod(ListMethods, Remove);
+	ScopedTypeMethod(ListMethods, RemoveAt);
+	ScopedTypeMethod(ListMethods, Clear);
+}
+
+bool MQ2ListType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
+{
+	auto pList = VarPtr.Get<MQListData>();
+	if (!pList)
+		return false;
+
+	std::vector<std::string>& items = pList->Items;
+
+	//----------------------------------------------------------------------------
+	// methods
+
+	if (MQTypeMember* pMethod = MQ2ListType::FindMethod(Member))
+	{
+		switch (static_cast<ListMethods>(pMethod->ID))
+		{
+		case ListMethods::Add:
+			items.emplace_back(Index);
+			return true;
+
+		case ListMethods::Insert: {
+			// Insert[n,value] puts the value at position n, the end of the list at most.
+			auto [position, value] = SplitCollectionIndex(Index);
+			int location = GetIntFromString(position, 0) - 1;
+			if (location < 0)
+				return false;
+
+			location = std::min(location, static_cast<int>(items.size()));
+			items.emplace(items.begin() + location, value);
+			return true;
+		}
+
+		case ListMethods::Remove: {
+			auto iter = std::find_if(items.begin(), items.end(),
+				[&](const std::string& item) { return ci_equals(item, Index); });
+			if (iter != items.end())
+				items.erase(iter);
+			return true;
+		}
+
+		case ListMethods::RemoveAt: {
+			int location = GetIntFromString(Index, 0) - 1;
+			if (location < 0 || location >= static_cast<int>(items.size()))
+				return false;
+
+			items.erase(items.begin() + location);
+			return true;
+		}
+
+		case ListMethods::Clear:
+			items.clear();
+			return true;
+
+		default: break;
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------
+	// members
+
+	MQTypeMember* pMember = MQ2ListType::FindMember(Member);
+	if (!pMember)
+		return false;
+
+	switch (static_cast<ListMembers>(pMember->ID))
+	{
+	case ListMembers::Count:
+		Dest.DWord = static_cast<uint32_t>(items.size());
+		Dest.Type = pIntType;
+		return true;
+
+	case ListMembers::Item: {
+		int location = GetIntFromString(Index, 0) - 1;
+		if (location < 0 || location >= static_cast<int>(items.size()))
+			return false;
+
+		return SetCollectionString(items[location], Dest);
+	}
+
+	case ListMembers::Contains:
+		Dest.Set(std::any_of(items.begin(), items.end(),
+			[&](const std::string& item) { return ci_equals(item, Index); }));
+		Dest.Type = pBoolType;
+		return true;
+
+	case ListMembers::Index: {
+		auto iter = std::find_if(items.begin(), items.end(),
+			[&](const std::string& item) { return ci_equals(item, Index); });
+
+		Dest.Int = iter != items.end() ? static_cast<int>(iter - items.begin()) + 1 : 0;
+		Dest.Type = pIntType;
+		return true;
+	}
+
+	case ListMembers::First:
+		if (items.empty())
+			return false;
+
+		return SetCollectionString(items.front(), Dest);
+
+	case ListMembers::Last:
+		if (items.empty())
+			return false;
+
+		return SetCollectionString(items.back(), Dest);
+
+	default: break;
+	}
+
+	return false;
+}
+
+bool MQ2ListType::ToString(MQVarPtr VarPtr, char* Destination)
+{
+	auto pList = VarPtr.Get<MQListData>();
+	if (!pList)
+		return false;
+
+	_itoa_s(static_cast<int>(pList->Items.size()), Destination, MAX_STRING, 10);
+	return true;
+}
+
+void MQ2ListType::InitVariable(MQVarPtr& VarPtr)
+{
+	VarPtr.Set(MQListData{});
+}
+
+bool MQ2ListType::FromData(MQVarPtr& VarPtr, const MQTypeVar& Source)
+{
+	if (Source.Type != pListType)
+		return false;
+
+	auto pSource = Source.Get<MQListData>();
+	if (!pSource)
+		return false;
+
+	VarPtr.Set(MQListData{ *pSource });
+	return true;
+}
+
+bool MQ2ListType::FromString(MQVarPtr& VarPtr, const char* Source)
+{
+	MQListData list;
+	ForEachCollectionItem(Source, [&list](std::string_view item) { list.Items.emplace_back(item); });
+
+	VarPtr.Set(std::move(list));
+	return true;
+}
+
+//============================================================================
+// MQ2SetType
+
+enum class SetMembers
+{
+	Count = 1,
+	Contains,
+};
+
+enum class SetMethods
+{
+	Add = 1,
+	Remove,
+	Clear,
+};
+
+MQ2SetType::MQ2SetType() : MQ2Type("set")
+{
+	ScopedTypeMember(SetMembers, Count);
+	ScopedTypeMember(SetMembers, Contains);
+
+	ScopedTypeMethod(SetMethods, Add);
+	ScopedTypeMethod(SetMethods, Remove);
+	ScopedTypeMethod(SetMethods, Clear);
+}
+
+bool MQ2SetType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
+{
+	auto pSet = VarPtr.Get<MQSetData>();
+	if (!pSet)
+		return false;
+
+	//----------------------------------------------------------------------------
+	// methods
+
+	if (MQTypeMember* pMethod = MQ2SetType::FindMethod(Member))
+	{
+		switch (static_cast<SetMethods>(pMethod->ID))
+		{
+		case SetMethods::Add:
+			pSet->Items.emplace(Index);
+			return true;
+
+		case SetMethods::Remove:
+			if (auto iter = pSet->Items.find(Index); iter != pSet->Items.end())
+				pSet->Items.erase(iter);
+			return true;
+
+		case SetMethods::Clear:
+			pSet->Items.clear();
+			return true;
+
+		default: break;
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------
+	// members
+
+	MQTypeMember* pMember = MQ2SetType::FindMember(Member);
+	if (!pMember)
+		return false;
+
+	switch (static_cast<SetMembers>(pMember->ID))
+	{
+	case SetMembers::Count:
+		Dest.DWord = static_cast<uint32_t>(pSet->Items.size());
+		Dest.Type = pIntType;
+		return true;
+
+	case SetMembers::Contains:
+		Dest.Set(pSet->Items.find(Index) != pSet->Items.end());
+		Dest.Type = pBoolType;
+		return true;
+
+	default: break;
+	}
+
+	return false;
+}
+
+bool MQ2SetType::ToString(MQVarPtr VarPtr, char* Destination)
+{
+	auto pSet = VarPtr.Get<MQSetData>();
+	if (!pSet)
+		return false;
+
+	_itoa_s(static_cast<int>(pSet->Items.size()), Destination, MAX_STRING, 10);
+	return true;
+}
+
+void MQ2SetType::InitVariable(MQVarPtr& VarPtr)
+{
+	VarPtr.Set(MQSetData{});
+}
+
+bool MQ2SetType::FromData(MQVarPtr& VarPtr, const MQTypeVar& Source)
+{
+	if (Source.Type != pSetType)
+		return false;
+
+	auto pSource = Source.Get<MQSetData>();
+	if (!pSource)
+		return false;
+
+	VarPtr.Set(MQSetData{ *pSource });
+	return true;
+}
+
+bool MQ2SetType::FromString(MQVarPtr& VarPtr, const char* Source)
+{
+	MQSetData set;
+	ForEachCollectionItem(Source, [&set](std::string_view item) { set.Items.emplace(item); });
+
+	VarPtr.Set(std::move(set));
+	return true;
+}
+
+//============================================================================
+// MQ2MapType
+
+enum class MapMembers
+{
+	Count = 1,
+	Contains,
+	Get,
+};
+
+enum class MapMethods
+{
+	Add = 1,
+	Remove,
+	Clear,
+};
+
+MQ2MapType::MQ2MapType() : MQ2Type("map")
+{
+	ScopedTypeMember(MapMembers, Count);
+	ScopedTypeMember(MapMembers, Contains);
+	ScopedTypeMember(MapMembers, Get);
+
+	ScopedTypeMethod(MapMethods, Add);
+	ScopedTypeMethod(MapMethods, Remove);
+	ScopedTypeMethod(MapMethods, Clear);
+}
+
+bool MQ2MapType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
+{
+	auto pMap = VarPtr.Get<MQMapData>();
+	if (!pMap)
+		return false;
+
+	//----------------------------------------------------------------------------
+	// methods
+
+	if (MQTypeMember* pMethod = MQ2MapType::FindMethod(Member))
+	{
+		switch (static_cast<MapMethods>(pMethod->ID))
+		{
+		case MapMethods::Add: {
+			// Add[key,value] replaces the value of an existing key.
+			auto [key, value] = SplitCollectionIndex(Index);
+			if (key.empty())
+				return false;
+
+			pMap->Items.insert_or_assign(std::string(key), std::string(value));
+			return true;
+		}
+
+		case MapMethods::Remove:
+			if (auto iter = pMap->Items.find(Index); iter != pMap->Items.end())
+				pMap->Items.erase(iter);
+			return true;
+
+		case MapMethods::Clear:
+			pMap->Items.clear();
+			return true;
+
+		default: break;
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------
+	// members
+
+	MQTypeMember* pMember = MQ2MapType::FindMember(Member);
+	if (!pMember)
+		return false;
+
+	switch (static_cast<MapMembers>(pMember->ID))
+	{
+	case MapMembers::Count:
+		Dest.DWord = static_cast<uint32_t>(pMap->Items.size());
+		Dest.Type = pIntType;
+		return true;
+
+	case MapMembers::Contains:
+		Dest.Set(pMap->Items.find(Index) != pMap->Items.end());
+		Dest.Type = pBoolType;
+		return true;
+
+	case MapMembers::Get:
+		if (auto iter = pMap->Items.find(Index); iter != pMap->Items.end())
+			return SetCollectionString(iter->second, Dest);
+		return false;
+
+	default: break;
+	}
+
+	return false;
+}
+
+bool MQ2MapType::ToString(MQVarPtr VarPtr, char* Destination)
+{
+	auto pMap = VarPtr.Get<MQMapData>();
+	if (!pMap)
+		return false;
+
+	_itoa_s(static_cast<int>(pMap->Items.size()), Destination, MAX_STRING, 10);
+	return true;
+}
+
+void MQ2MapType::InitVariable(MQVarPtr& VarPtr)
+{
+	VarPtr.Set(MQMapData{});
+}
+
+bool MQ2MapType::FromData(MQVarPtr& VarPtr, const MQTypeVar& Source)
+{
+	if (Source.Type != pMapType)
+		return false;
+
+	auto pSource = Source.Get<MQMapData>();
+	if (!pSource)
+		return false;
+
+	VarPtr.Set(MQMapData{ *pSource });
+	return true;
+}
+
+bool MQ2MapType::FromString(MQVarPtr& VarPtr, const char* Source)
+{
+	MQMapData map;
+	ForEachCollectionItem(Source, [&map](std::string_view item)
+		{
+			auto [key, value] = SplitCollectionIndex(item, '=');
+			if (!key.empty())
+				map.Items.insert_or_assign(std::string(key), std::string(value));
+		});
+
+	VarPtr.Set(std::move(map));
+	return true;
+}
+
+} // namespace mq::datatypes
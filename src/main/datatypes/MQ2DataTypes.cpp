@@ -56,53 +56,43 @@ MQ2CachedBuffType* pTargetBuffType DEPRECATE("Use pCachedBuffType instead.") = p
 
 CDataArray::CDataArray(MQ2Type* Type, const char* Index)
 {
-	m_nExtents = 1;
-	m_totalElements = 1;
+	int totalElements = 1;
 
-	// count number of , 's
-	if (const char* pComma = strchr(Index, ','))
+	std::string_view extents = Index;
+	while (true)
 	{
-		m_nExtents++;
-		while (pComma = strchr(&pComma[1], ','))
-		{
-			m_nExtents++;
-		}
-	}
+		const size_t comma = extents.find(',');
 
-	// allocate extents
-	m_pExtents = new int[m_nExtents];
+		m_extents.push_back(GetIntFromString(extents.substr(0, comma), 0));
+		totalElements *= m_extents.back();
 
-	// read extents
-	std::string IndexCopy = Index;
-	char* pStart = &IndexCopy[0];
-	for (int index = 0; index < m_nExtents; index++)
-	{
-		char* pComma = strchr(pStart, ',');
-		if (pComma)
-			*pComma = 0;
+		if (comma == std::string_view::npos)
+			break;
 
-		m_pExtents[index] = GetIntFromString(pStart, 0);
-		m_totalElements *= m_pExtents[index];
+		extents.remove_prefix(comma + 1);
+	}
 
-		if (pComma)
-		{
-			*pComma = ',';
-			pStart = &pComma[1];
-		}
+	// Row major, so the last extent is contiguous.
+	m_strides.resize(m_extents.size());
+	int stride = 1;
+	for (size_t index = m_extents.size(); index-- > 0;)
+	{
+		m_strides[index] = stride;
+		stride *= m_extents[index];
 	}
 
 	m_pType = Type;
-	m_pData = new MQVarPtr[m_totalElements];
+	m_data.resize(std::max(totalElements, 0));
 }
 
 void CDataArray::Initialize(const char* defaultValue)
 {
 	if (m_pType != nullptr)
 	{
-		for (int index = 0; index < m_totalElements; index++)
+		for (MQVarPtr& element : m_data)
 		{
-			m_pType->InitVariable(m_pData[index]);
-			m_pType->FromString(m_pData[index], defaultValue);
+			m_pType->InitVariable(element);
+			m_pType->FromString(element, defaultValue);
 		}
 	}
 }
@@ -111,85 +101,65 @@ void CDataArray::Initialize(const MQTypeVar& defaultValue)
 {
 	if (m_pType != nullptr)
 	{
-		for (int index = 0; index < m_totalElements; index++)
+		for (MQVarPtr& element : m_data)
 		{
-			m_pType->InitVariable(m_pData[index]);
-			m_pType->FromData(m_pData[index], defaultValue);
+			m_pType->InitVariable(element);
+			m_pType->FromData(element, defaultValue);
 		}
 	}
 }
 
-
-CDataArray::~CDataArray()
+void CDataArray::FreeElements()
 {
-	if (m_pType && m_pData)
+	if (m_pType)
 	{
-		for (int index = 0; index < m_totalElements; index++)
+		for (MQVarPtr& element : m_data)
 		{
-			m_pType->FreeVariable(m_pData[index]);
+			m_pType->FreeVariable(element);
 		}
 	}
+}
 
-	delete[] m_pExtents;
-	delete[] m_pData;
+CDataArray::~CDataArray()
+{
+	FreeElements();
 }
 
 void CDataArray::Delete()
 {
-	if (m_pType && m_pData)
-	{
-		for (int index = 0; index < m_totalElements; index++)
-		{
-			m_pType->FreeVariable(m_pData[index]);
-		}
-	}
-
-	delete[] m_pExtents;
-	delete[] m_pData;
+	FreeElements();
 
-	m_pExtents = nullptr;
 	m_pType = nullptr;
-	m_pData = nullptr;
-	m_nExtents = 0;
-	m_totalElements = 0;
+	m_data.clear();
+	m_extents.clear();
+	m_strides.clear();
 }
 
 int CDataArray::GetElement(std::string_view Index) const
 {
-	if (m_nExtents == 1)
+	const int numExtents = GetNumExtents();
+	int location = 0;
+	int extent = 0;
+
+	while (true)
 	{
-		if (Index.find(',') != std::string_view::npos)
+		const size_t comma = Index.find(',');
+		if (extent >= numExtents)
 			return -1;
 
-		int location = GetIntFromString(Index, 0) - 1;
-		if (location >= m_totalElements)
+		const int coordinate = GetIntFromString(Index.substr(0, comma), 0) - 1;
+		if (coordinate < 0 || coordinate >= m_extents[extent])
 			return -1;
 
-		return location;
-	}
-	
-	int num_extents = static_cast<int>(std::count(Index.begin(), Index.end(), ',') + 1);
-	if (num_extents != m_nExtents)
-		return -1;
+		location += coordinate * m_strides[extent++];
 
-	auto tokens = split_view(Index, ',');
-	int extent = 0;
-	return std::accumulate(tokens.begin(), tokens.end(), 0, [&extent, this](int location, std::string_view token) -> int
-		{
-			if (location < 0)
-				return -1;
-
-			int max_extent = m_pExtents[extent];
-			int next_location = GetIntFromString(token, 0) - 1;
-			if (next_location >= max_extent || next_location < 0)
-				return -1;
+		if (comma == std::string_view::npos)
+			break;
 
-			for (int extent_marker = extent + 1; extent_marker < m_nExtents; ++extent_marker)
-				next_location *= m_pExtents[extent_marker];
+		Index.remove_prefix(comma + 1);
+	}
 
-			++extent;
-			return location + next_location;
-		});
+	return extent == numExtents ? location : -1;
 }
 
 int CDataArray::GetElement(char* Index)
@@ -197,13 +167,30 @@ int CDataArray::GetElement(char* Index)
 	return GetElement(std::string_view(Index));
 }
 
+int CDataArray::GetElement(const std::vector<int>& Coordinates) const
+{
+	if (Coordinates.size() != m_extents.size())
+		return -1;
+
+	int location = 0;
+	for (size_t extent = 0; extent < Coordinates.size(); ++extent)
+	{
+		if (Coordinates[extent] < 0 || Coordinates[extent] >= m_extents[extent])
+			return -1;
+
+		location += Coordinates[extent] * m_strides[extent];
+	}
+
+	return location;
+}
+
 bool CDataArray::GetElement(std::string_view Index, MQTypeVar& Dest)
 {
-	int location = GetElement(std::string_view(Index));
+	int location = GetElement(Index);
 	if (location >= 0)
 	{
 		Dest.Type = m_pType;
-		Dest.VarPtr = m_pData[location];
+		Dest.VarPtr = m_data[location];
 	}
 
 	return location >= 0;
@@ -214,6 +201,18 @@ bool CDataArray::GetElement(char* Index, MQTypeVar& Dest)
 	return GetElement(std::string_view(Index), Dest);
 }
 
+bool CDataArray::GetElement(const std::vector<int>& Coordinates, MQTypeVar& Dest)
+{
+	int location = GetElement(Coordinates);
+	if (location >= 0)
+	{
+		Dest.Type = m_pType;
+		Dest.VarPtr = m_data[location];
+	}
+
+	return location >= 0;
+}
+
 } // namespace mq::datatypes
 
 #include "MQ2BasicTypes.cpp"
@@ -231,6 +230,7 @@ bool CDataArray::GetElement(char* Index, MQTypeVar& Dest)
 #include "MQ2CharacterType.cpp"
 #include "MQ2CharSelectListType.cpp"
 #include "MQ2ClassType.cpp"
+#include "MQ2CollectionTypes.cpp"
 #include "MQ2CorpseType.cpp"
 #include "MQ2CurrentZoneType.cpp"
 #include "MQ2DeityType.cpp"
@@ -43,21 +43,26 @@ public:
 	MQLIB_OBJECT bool GetElement(std::string_view Index, MQTypeVar& Dest);
 	MQLIB_OBJECT bool GetElement(char* Index, MQTypeVar& Dest);
 
+	// Coordinates are zero based, one per extent. Used for indices that were parsed ahead of time.
+	MQLIB_OBJECT int GetElement(const std::vector<int>& Coordinates) const;
+	MQLIB_OBJECT bool GetElement(const std::vector<int>& Coordinates, MQTypeVar& Dest);
+
 	MQ2Type* GetType() { return m_pType; }
-	MQVarPtr& GetData(int index) { return m_pData[index]; }
-	int GetExtents(int index) const { return m_pExtents[index]; }
-	int GetNumExtents() const { return m_nExtents; }
-	int GetTotalElements() const { return m_totalElements; }
+	MQVarPtr& GetData(int index) { return m_data[index]; }
+	int GetExtents(int index) const { return m_extents[index]; }
+	int GetNumExtents() const { return static_cast<int>(m_extents.size()); }
+	int GetTotalElements() const { return static_cast<int>(m_data.size()); }
 
 	void Initialize(const char* defaultValue);
 	void Initialize(const MQTypeVar& defaultValue);
 
 private:
+	void FreeElements();
+
 	MQ2Type* m_pType = nullptr;
-	MQVarPtr* m_pData = nullptr;
-	int* m_pExtents = nullptr;
-	int m_nExtents = 0;
-	int m_totalElements = 0;
+	std::vector<MQVarPtr> m_data;
+	std::vector<int> m_extents;
+	std::vector<int> m_strides;        // elements skipped by one step in each extent
 };
 
 #pragma region Basic Types
@@ -312,6 +317,54 @@ public:
 	static bool dataHeading(const char* szIndex, MQTypeVar& Ret);
 };
 
+//============================================================================
+// MQ2ListType
+
+class MQ2ListType : public MQ2Type
+{
+public:
+	MQ2ListType();
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override;
+	bool ToString(MQVarPtr VarPtr, char* Destination) override;
+
+	bool FromData(MQVarPtr& VarPtr, const MQTypeVar& Source) override;
+	bool FromString(MQVarPtr& VarPtr, const char* Source) override;
+	void InitVariable(MQVarPtr& VarPtr) override;
+};
+
+//============================================================================
+// MQ2SetType
+
+class MQ2SetType : public MQ2Type
+{
+public:
+	MQ2SetType();
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override;
+	bool ToString(MQVarPtr VarPtr, char* Destination) override;
+
+	bool FromData(MQVarPtr& VarPtr, const MQTypeVar& Source) override;
+	bool FromString(MQVarPtr& VarPtr, const char* Source) override;
+	void InitVariable(MQVarPtr& VarPtr) override;
+};
+
+//============================================================================
+// MQ2MapType
+
+class MQ2MapType : public MQ2Type
+{
+public:
+	MQ2MapType();
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override;
+	bool ToString(MQVarPtr VarPtr, char* Destination) override;
+
+	bool FromData(MQVarPtr& VarPtr, const MQTypeVar& Source) override;
+	bool FromString(MQVarPtr& VarPtr, const char* Source) override;
+	void InitVariable(MQVarPtr& VarPtr) override;
+};
+
 #pragma endregion
 
 #pragma region MQ Types
@@ -1403,6 +1456,18 @@ public:
 	static bool dataFrameLimiter(const char* szIndex, MQTypeVar& Ret);
 };
 
+//============================================================================
+// MQ2BenchmarkType
+
+class MQ2BenchmarkType : public MQ2Type
+{
+public:
+	MQ2BenchmarkType();
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override;
+	bool ToString(MQVarPtr VarPtr, char* Destination) override;
+};
+
 //============================================================================
 // MQIniType
 
@@ -119,20 +119,12 @@ bool MQ2GroupType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, M
 			return true;
 		}
 
-		for (int i = 1; i < MAX_GROUP_SIZE; i++)
 		{
-			if (CGroupMember* pGroupMember = pLocalPC->Group->GetGroupMember(i))
+			int memberIndex = GetGroupMemberIndexByName(Index);
+			if (memberIndex != -1)
 			{
-				Dest.DWord++;
-				char Name[MAX_STRING] = { 0 };
-				strcpy_s(Name, pGroupMember->GetName());
-
-				CleanupName(Name, sizeof(Name), false, false); // we do this to fix the mercenaryname bug
-
-				if (Index[0] != 0 && ci_equals(Name, Index))
-				{
-					return true;
-				}
+				Dest.DWord = memberIndex;
+				return true;
 			}
 		}
 		return false;
@@ -366,6 +366,172 @@ MQ2ItemType::MQ2ItemType() : MQ2Type("item")
 	ScopedTypeMethod(ItemMethods, Inspect);
 }
 
+// Members worked out from the item definition instead of read straight from it are kept per
+// definition, scripts that score gear ask for the same ones on hundreds of items. The memo is
+// thrown away if the definition ends up belonging to a different item.
+struct ItemDefinitionMemo
+{
+	int ItemID = 0;
+	int WornSlots = 0;
+	int Classes = 0;
+	int Races = 0;
+	int Deities = 0;
+	int Augs = 0;
+	EQ_Spell* pSpell = nullptr;
+	const char* EffectType = nullptr;
+};
+
+static constexpr size_t MAX_ITEM_DEFINITION_MEMOS = 4096;
+static std::unordered_map<const ItemDefinition*, ItemDefinitionMemo> s_itemDefinitionMemos;
+
+static int CountBits(uint32_t bits, int count)
+{
+	int found = 0;
+
+	for (int num = 0; num < count; num++)
+	{
+		if (bits & (1 << num))
+			found++;
+	}
+
+	return found;
+}
+
+static const char* GetItemEffectType(const ItemDefinition* pItemDef)
+{
+	// 0 Proc
+	// 1 Clickable from inventory (any class)
+	// 2 Worn effect (haste, cleave)
+	// 3 Unknown
+	// 4 Clickable must be worn
+	// 5 Clickable from inventory (class restricted)
+	// 6 Focus effect
+	// 7 Memmable spell scroll
+
+	// This used to return an int type with a case statment, items could have
+	// only one effect. For backwards compatibility we return based on a hierarchy.
+	// A zero in any field indicates no effect (others will also be zero)
+	if (!pItemDef->Clicky.SpellID)
+		return nullptr;
+
+	if (pItemDef->Scroll.SpellID != -1)
+		return "Spell Scroll";
+
+	if (pItemDef->Clicky.SpellID != -1)
+	{
+		// code to detect must-be-worn etc here
+		switch (pItemDef->Clicky.EffectType)
+		{
+		case ItemEffectClickyWorn:
+			return "Click Worn";
+		case ItemEffectClicky:
+		case ItemEffectClickyRestricted:
+			return "Click Inventory";
+		default:
+			return "Click Unknown";
+		}
+	}
+
+	if (pItemDef->Focus.SpellID != -1 || pItemDef->Worn.SpellID != -1)
+		return "Worn";
+
+	if (pItemDef->Proc.SpellID != -1)
+		return "Combat";
+
+	return nullptr;
+}
+
+static const ItemDefinitionMemo& GetItemDefinitionMemo(const ItemDefinition* pItemDef)
+{
+	auto iter = s_itemDefinitionMemos.find(pItemDef);
+	if (iter != s_itemDefinitionMemos.end() && iter->second.ItemID == pItemDef->ItemNumber)
+		return iter->second;
+
+	if (iter == s_itemDefinitionMemos.end() && s_itemDefinitionMemos.size() >= MAX_ITEM_DEFINITION_MEMOS)
+		s_itemDefinitionMemos.clear();
+
+	ItemDefinitionMemo& memo = s_itemDefinitionMemos[pItemDef];
+	memo = ItemDefinitionMemo();
+	memo.ItemID = pItemDef->ItemNumber;
+	memo.WornSlots = CountBits(pItemDef->EquipSlots, 32);
+	memo.Classes = CountBits(pItemDef->Classes, TotalPlayerClasses);
+	memo.Races = CountBits(pItemDef->Races, NUM_RACES);
+	memo.Deities = CountBits(pItemDef->Deity, NUM_DEITIES);
+	memo.EffectType = GetItemEffectType(pItemDef);
+
+	if (pItemDef->Type == ITEMTYPE_NORMAL)
+	{
+		for (const auto& augInfo : pItemDef->AugData.Sockets)
+		{
+			if (augInfo.Type != 0 && augInfo.bVisible)
+				memo.Augs++;
+		}
+	}
+
+	for (int spellID : { pItemDef->Clicky.SpellID, pItemDef->Scroll.SpellID, pItemDef->Proc.SpellID,
+		pItemDef->Focus.SpellID, pItemDef->Worn.SpellID })
+	{
+		if (memo.pSpell = GetSpellByID(spellID))
+			break;
+	}
+
+	return memo;
+}
+
+// Stacks and StackCount look through every bag, so they are kept by item id until the inventory
+// index is rebuilt.
+struct ItemStacksMemo
+{
+	int Stacks = 0;
+	int Count = 0;
+};
+
+static std::unordered_map<int, ItemStacksMemo> s_itemStacksMemos;
+static uint32_t s_itemStacksGeneration = 0;
+
+static const ItemStacksMemo& GetItemStacksMemo(PcProfile* pProfile, int itemToFind)
+{
+	const uint32_t generation = GetInventoryIndexGeneration();
+	if (generation != s_itemStacksGeneration)
+	{
+		s_itemStacksMemos.clear();
+		s_itemStacksGeneration = generation;
+	}
+
+	auto iter = s_itemStacksMemos.find(itemToFind);
+	if (iter != s_itemStacksMemos.end())
+		return iter->second;
+
+	ItemStacksMemo& memo = s_itemStacksMemos[itemToFind];
+
+	// If we used ItemContainer::FindItem, we might count augs that are placed
+	// within items in the bag slots (not in the bags).
+	for (int slot = InvSlot_FirstBagSlot; slot <= GetHighestAvailableBagSlot(); slot++)
+	{
+		ItemPtr pBagItem = pProfile->InventoryContainer.GetItem(slot);
+		if (!pBagItem) continue;
+
+		if (pBagItem->GetID() == itemToFind)
+		{
+			memo.Stacks++;
+			memo.Count += pBagItem->GetItemCount();
+		}
+		else if (pBagItem->IsContainer())
+		{
+			for (const ItemPtr& item : pBagItem->GetHeldItems())
+			{
+				if (item && item->GetID() == itemToFind)
+				{
+					memo.Stacks++;
+					memo.Count += item->GetItemCount();
+				}
+			}
+		}
+	}
+
+	return memo;
+}
+
 bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
 {
 	ItemPtr pItem = GetItem(VarPtr);
@@ -687,19 +853,10 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		}
 		return false;
 
-	case ItemMembers::WornSlots: {
-		Dest.DWord = 0;
-
-		// count bits
-		int cmp = GetItemFromContents(pItem)->EquipSlots;
-		for (int num = 0; num < 32; num++)
-		{
-			if (cmp & (1 << num))
-				Dest.DWord++;
-		}
+	case ItemMembers::WornSlots:
+		Dest.DWord = GetItemDefinitionMemo(GetItemFromContents(pItem)).WornSlots;
 		Dest.Type = pIntType;
 		return true;
-	}
 
 	case ItemMembers::CastTime:
 		Dest.UInt64 = GetItemFromContents(pItem)->Clicky.CastTime;
@@ -707,72 +864,19 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		return true;
 
 	case ItemMembers::Spell:
+		Dest.Ptr = GetItemDefinitionMemo(GetItemFromContents(pItem)).pSpell;
 		Dest.Type = pSpellType;
-		if (Dest.Ptr = GetSpellByID(GetItemFromContents(pItem)->Clicky.SpellID))
-			return true;
-		if (Dest.Ptr = GetSpellByID(GetItemFromContents(pItem)->Scroll.SpellID))
-			return true;
-		if (Dest.Ptr = GetSpellByID(GetItemFromContents(pItem)->Proc.SpellID))
-			return true;
-		if (Dest.Ptr = GetSpellByID(GetItemFromContents(pItem)->Focus.SpellID))
-			return true;
-		if (Dest.Ptr = GetSpellByID(GetItemFromContents(pItem)->Worn.SpellID))
-			return true;
-		return false;
+		return Dest.Ptr != nullptr;
 
 	case ItemMembers::EffectType:
 		Dest.Type = pStringType;
-		// 0 Proc
-		// 1 Clickable from inventory (any class)
-		// 2 Worn effect (haste, cleave)
-		// 3 Unknown
-		// 4 Clickable must be worn
-		// 5 Clickable from inventory (class restricted)
-		// 6 Focus effect
-		// 7 Memmable spell scroll
-
-		// This used to return an int type with a case statment, items could have
-		// only one effect. For backwards compatibility we return based on a hierarchy.
-		// A zero in any field indicates no effect (others will also be zero)
-		if (!GetItemFromContents(pItem)->Clicky.SpellID)
-		{
-			return false;
-		}
-		else if (GetItemFromContents(pItem)->Scroll.SpellID != -1)
-		{
-			strcpy_s(DataTypeTemp, "Spell Scroll");
-		}
-		else if (GetItemFromContents(pItem)->Clicky.SpellID != -1)
-		{
-			// code to detect must-be-worn etc here
-			switch (GetItemFromContents(pItem)->Clicky.EffectType)
-			{
-			case ItemEffectClickyWorn:
-				strcpy_s(DataTypeTemp, "Click Worn");
-				break;
-			case ItemEffectClicky:
-			case ItemEffectClickyRestricted:
-				strcpy_s(DataTypeTemp, "Click Inventory");
-				break;
-			default:
-				strcpy_s(DataTypeTemp, "Click Unknown");
-				break;
-			}
-		}
-		else if (GetItemFromContents(pItem)->Focus.SpellID != -1 || GetItemFromContents(pItem)->Worn.SpellID != -1)
-		{
-			strcpy_s(DataTypeTemp, "Worn");
-		}
-		else if (GetItemFromContents(pItem)->Proc.SpellID != -1)
-		{
-			strcpy_s(DataTypeTemp, "Combat");
-		}
-		else
+		if (const char* effectType = GetItemDefinitionMemo(GetItemFromContents(pItem)).EffectType)
 		{
-			return false;
+			strcpy_s(DataTypeTemp, effectType);
+			Dest.Ptr = &DataTypeTemp[0];
+			return true;
 		}
-		Dest.Ptr = &DataTypeTemp[0];
-		return true;
+		return false;
 
 	case ItemMembers::InstrumentMod:
 		Dest.Float = ((float)GetItemFromContents(pItem)->InstrumentMod) / 10.0f;
@@ -837,44 +941,7 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		Dest.Type = pIntType;
 		return true;
 
-	case ItemMembers::Stacks: {
-		Dest.DWord = 0;
-		Dest.Type = pIntType;
-
-		PcProfile* pProfile = GetPcProfile();
-		if (!pProfile) return false;
-
-		if (!pItem->IsStackable())
-			return true;
-
-		int itemToFind = pItem->GetID();
-
-		// If we used ItemContainer::FindItem, we might count augs that are placed
-		// within items in the bag slots (not in the bags).
-		for (int slot = InvSlot_FirstBagSlot; slot <= GetHighestAvailableBagSlot(); slot++)
-		{
-			ItemPtr pBagItem = pProfile->InventoryContainer.GetItem(slot);
-			if (!pBagItem) continue;
-
-			if (pBagItem->GetID() == itemToFind)
-			{
-				Dest.DWord++;
-			}
-			else if (pBagItem->IsContainer())
-			{
-				for (const ItemPtr& item : pBagItem->GetHeldItems())
-				{
-					if (item && item->GetID() == itemToFind)
-					{
-						Dest.DWord++;
-					}
-				}
-			}
-		}
-
-		return true;
-	}
-
+	case ItemMembers::Stacks:
 	case ItemMembers::StackCount: {
 		Dest.DWord = 0;
 		Dest.Type = pIntType;
@@ -885,28 +952,8 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		if (!pItem->IsStackable())
 			return true;
 
-		int itemToFind = pItem->GetID();
-
-		for (int slot = InvSlot_FirstBagSlot; slot <= GetHighestAvailableBagSlot(); slot++)
-		{
-			ItemPtr pBagItem = pProfile->InventoryContainer.GetItem(slot);
-			if (!pBagItem) continue;
-
-			if (pBagItem->GetID() == itemToFind)
-			{
-				Dest.DWord += pBagItem->GetItemCount();
-			}
-			else if (pBagItem->IsContainer())
-			{
-				for (const ItemPtr& item : pBagItem->GetHeldItems())
-				{
-					if (item && item->GetID() == itemToFind)
-					{
-						Dest.DWord += item->GetItemCount();
-					}
-				}
-			}
-		}
+		const ItemStacksMemo& memo = GetItemStacksMemo(pProfile, pItem->GetID());
+		Dest.DWord = static_cast<ItemMembers>(pMember->ID) == ItemMembers::Stacks ? memo.Stacks : memo.Count;
 		return true;
 	}
 
@@ -925,19 +972,10 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		}
 		return false;
 
-	case ItemMembers::Classes: {
-		Dest.DWord = 0;
+	case ItemMembers::Classes:
+		Dest.DWord = GetItemDefinitionMemo(GetItemFromContents(pItem)).Classes;
 		Dest.Type = pIntType;
-
-		// count bits
-		int cmp = GetItemFromContents(pItem)->Classes;
-		for (int num = 0; num < TotalPlayerClasses; num++)
-		{
-			if (cmp & (1 << num))
-				Dest.DWord++;
-		}
 		return true;
-	}
 
 	case ItemMembers::Class:
 		Dest.DWord = 0;
@@ -985,19 +1023,10 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		}
 		return false;
 
-	case ItemMembers::Races: {
-		Dest.DWord = 0;
+	case ItemMembers::Races:
+		Dest.DWord = GetItemDefinitionMemo(GetItemFromContents(pItem)).Races;
 		Dest.Type = pIntType;
-
-		// count bits
-		int cmp = GetItemFromContents(pItem)->Races;
-		for (int num = 0; num < NUM_RACES; num++)
-		{
-			if (cmp & (1 << num))
-				Dest.DWord++;
-		}
 		return true;
-	}
 
 	case ItemMembers::Race:
 		Dest.DWord = 0;
@@ -1076,19 +1105,10 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		}
 		return false;
 
-	case ItemMembers::Deities: {
-		Dest.DWord = 0;
+	case ItemMembers::Deities:
+		Dest.DWord = GetItemDefinitionMemo(GetItemFromContents(pItem)).Deities;
 		Dest.Type = pIntType;
-
-		// count bits
-		int cmp = GetItemFromContents(pItem)->Deity;
-		for (int num = 0; num < NUM_DEITIES; num++)
-		{
-			if (cmp & (1 << num))
-				Dest.DWord++;
-		}
 		return true;
-	}
 
 	case ItemMembers::Deity:
 		Dest.DWord = 0;
@@ -1630,22 +1650,10 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		Dest.Type = pIntType;
 		return true;
 
-	case ItemMembers::Augs: {
-		Dest.DWord = 0;
+	case ItemMembers::Augs:
+		Dest.DWord = GetItemDefinitionMemo(pItem->GetItemDefinition()).Augs;
 		Dest.Type = pIntType;
-
-		ItemDefinition* itemDef = pItem->GetItemDefinition();
-		if (itemDef->Type == ITEMTYPE_NORMAL)
-		{
-			for (const auto& augInfo : itemDef->AugData.Sockets)
-			{
-				if (augInfo.Type != 0 && augInfo.bVisible)
-					Dest.DWord++;
-			}
-		}
-
 		return true;
-	}
 
 	case ItemMembers::Tradeskills:
 		Dest.Set(GetItemFromContents(pItem)->TradeSkills);
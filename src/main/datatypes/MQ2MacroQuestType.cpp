@@ -29,7 +29,8 @@ enum class MacroQuestMembers
 	Version,
 	InternalName,
 	Parser,
-	Anonymize
+	Anonymize,
+	Benchmark
 };
 
 MQ2MacroQuestType::MQ2MacroQuestType() : MQ2Type("macroquest")
@@ -45,6 +46,7 @@ MQ2MacroQuestType::MQ2MacroQuestType() : MQ2Type("macroquest")
 	ScopedTypeMember(MacroQuestMembers, InternalName);
 	ScopedTypeMember(MacroQuestMembers, Parser);
 	ScopedTypeMember(MacroQuestMembers, Anonymize);
+	ScopedTypeMember(MacroQuestMembers, Benchmark);
 }
 
 bool MQ2MacroQuestType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -266,6 +268,16 @@ bool MQ2MacroQuestType::GetMember(MQVarPtr VarPtr, const char* Member, char* Ind
 		Dest.Type = pBoolType;
 		return true;
 
+	case MacroQuestMembers::Benchmark: {
+		uint32_t benchmark = 0;
+		if (!Index[0] || !FindMQ2Benchmark(Index, benchmark))
+			return false;
+
+		Dest.DWord = benchmark;
+		Dest.Type = pBenchmarkType;
+		return true;
+	}
+
 	default:
 		return false;
 	}
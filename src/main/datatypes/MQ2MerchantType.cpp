@@ -37,6 +37,122 @@ enum MerchantMethods
 	CloseWindow,
 };
 
+// Index of the regular merchant page by lower case item name. It is built the first time an item
+// is looked up after the list has been received, and dropped when the list is refreshed.
+class MerchantItemIndex
+{
+	std::unordered_map<std::string, int> m_byName;   // first item with each name
+	std::vector<std::string> m_names;
+	bool m_valid = false;
+
+	void Build()
+	{
+		const auto& page = pMerchantWnd->PageHandlers[RegularMerchantPage];
+		const int count = page->GetItemCount();
+
+		m_byName.clear();
+		m_names.clear();
+		m_names.reserve(count);
+
+		for (int i = 0; i < count; ++i)
+		{
+			ItemPtr pItem = page->GetItem(i);
+			m_names.push_back(pItem ? to_lower_copy(std::string(pItem->GetName())) : std::string());
+
+			if (pItem)
+				m_byName.emplace(m_names.back(), i);
+		}
+
+		m_valid = true;
+	}
+
+	int Lookup(const std::string& name, bool exact) const
+	{
+		if (exact)
+		{
+			auto iter = m_byName.find(name);
+			return iter != m_byName.end() ? iter->second : -1;
+		}
+
+		for (int i = 0; i < static_cast<int>(m_names.size()); ++i)
+		{
+			if (m_names[i].find(name) != std::string::npos)
+				return i;
+		}
+
+		return -1;
+	}
+
+	static int LinearLookup(std::string_view name, bool exact)
+	{
+		const auto& page = pMerchantWnd->PageHandlers[RegularMerchantPage];
+
+		for (int i = 0; i < page->GetItemCount(); ++i)
+		{
+			ItemPtr pItem = page->GetItem(i);
+
+			if (pItem && ci_equals(pItem->GetName(), name, exact))
+				return i;
+		}
+
+		return -1;
+	}
+
+public:
+	void Invalidate()
+	{
+		m_valid = false;
+	}
+
+	// Returns the position of the first item matching name on the regular merchant page, or -1.
+	// Uses the same matching as MaybeExactCompare when exact is false and the name starts with '='.
+	int Find(std::string_view name, bool exact)
+	{
+		if (!pMerchantWnd || name.empty())
+			return -1;
+
+		// the list is still being filled in, so there's nothing to index yet
+		if (!gItemsReceived || !pMerchantWnd->IsVisible())
+		{
+			m_valid = false;
+			return LinearLookup(name, exact);
+		}
+
+		const auto& page = pMerchantWnd->PageHandlers[RegularMerchantPage];
+		std::string lowerName{ name };
+		to_lower(lowerName);
+
+		// items can be bought out or sold without the list being refreshed, so check what was found
+		// and rebuild once if it doesn't match anymore.
+		for (int attempt = 0; attempt < 2; ++attempt)
+		{
+			if (!m_valid || static_cast<int>(m_names.size()) != page->GetItemCount())
+				Build();
+
+			int index = Lookup(lowerName, exact);
+			if (index == -1)
+				return -1;
+
+			ItemPtr pItem = page->GetItem(index);
+			if (pItem && ci_equals(pItem->GetName(), m_names[index]))
+				return index;
+
+			m_valid = false;
+		}
+
+		return -1;
+	}
+
+	int Find(std::string_view name)
+	{
+		if (!name.empty() && name[0] == '=')
+			return Find(name.substr(1), true);
+
+		return Find(name, false);
+	}
+};
+static MerchantItemIndex s_merchantItemIndex;
+
 MQ2MerchantType::MQ2MerchantType() : MQ2Type("merchant")
 {
 	ScopedTypeMember(MerchantMembers, Markup);
@@ -70,26 +186,10 @@ bool MQ2MerchantType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index
 		case MerchantMethods::SelectItem: {
 			if (pMerchantWnd->IsVisible())
 			{
-				bool bFound = false;
-				int listIndex = 0;
-				ItemPtr pItem;
-
 				auto& page = pMerchantWnd->PageHandlers[RegularMerchantPage];
 
-				for (int i = 0; i < page->GetItemCount(); i++)
-				{
-					ItemPtr pItemItr = page->GetItem(i);
-
-					if (pItemItr)
-					{
-						if (MaybeExactCompare(pItemItr->GetName(), Index))
-						{
-							listIndex = i;
-							pItem = pItemItr;
-							break;
-						}
-					}
-				}
+				int listIndex = s_merchantItemIndex.Find(Index);
+				ItemPtr pItem = listIndex != -1 ? page->GetItem(listIndex) : ItemPtr();
 
 				if (pItem)
 				{
@@ -221,15 +321,11 @@ bool MQ2MerchantType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index
 			}
 
 			// by name
-			for (int i = 0; i < page->GetItemCount(); ++i)
+			int nIndex = s_merchantItemIndex.Find(Index);
+			if (nIndex != -1)
 			{
-				ItemPtr pItem = page->GetItem(i);
-
-				if (pItem && MaybeExactCompare(pItem->GetName(), Index))
-				{
-					Dest = pItemType->MakeTypeVar(pItem);
-					return true;
-				}
+				Dest = pItemType->MakeTypeVar(page->GetItem(nIndex));
+				return true;
 			}
 		}
 
@@ -294,3 +390,12 @@ bool MQ2MerchantType::dataMerchant(const char* szIndex, MQTypeVar& Ret)
 }
 
 } // namespace mq::datatypes
+
+namespace mq {
+
+void InvalidateMerchantItemIndex()
+{
+	datatypes::s_merchantItemIndex.Invalidate();
+}
+
+} // namespace mq
@@ -22,6 +22,10 @@ enum class PluginMembers
 	Name = 1,
 	Version,
 	IsLoaded,
+	CallbackCount,
+	CallbackTime,
+	CallbackMaxTime,
+	CallbackLastTime,
 };
 
 MQ2PluginType::MQ2PluginType() : MQ2Type("plugin")
@@ -29,6 +33,35 @@ MQ2PluginType::MQ2PluginType() : MQ2Type("plugin")
 	ScopedTypeMember(PluginMembers, Name);
 	ScopedTypeMember(PluginMembers, Version);
 	ScopedTypeMember(PluginMembers, IsLoaded);
+	ScopedTypeMember(PluginMembers, CallbackCount);
+	ScopedTypeMember(PluginMembers, CallbackTime);
+	ScopedTypeMember(PluginMembers, CallbackMaxTime);
+	ScopedTypeMember(PluginMembers, CallbackLastTime);
+}
+
+// Returns the timing of the callback named by the index, or all of the callbacks added together
+// if there is no index.
+static bool GetCallbackTiming(const MQPlugin* pPlugin, const char* Index, MQPluginCallbackTiming& timing)
+{
+	if (Index[0])
+	{
+		PluginCallback callback;
+		if (!FindPluginCallback(Index, callback))
+			return false;
+
+		timing = pPlugin->CallbackTimings[static_cast<size_t>(callback)];
+		return true;
+	}
+
+	timing = MQPluginCallbackTiming();
+	for (const MQPluginCallbackTiming& callbackTiming : pPlugin->CallbackTimings)
+	{
+		timing.Count += callbackTiming.Count;
+		timing.TotalTime += callbackTiming.TotalTime;
+		timing.MaxTime = std::max(timing.MaxTime, callbackTiming.MaxTime);
+	}
+
+	return true;
 }
 
 bool MQ2PluginType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -58,6 +91,47 @@ bool MQ2PluginType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 		Dest.Set(pPlugin != nullptr);
 		return true;
 
+	case PluginMembers::CallbackCount: {
+		MQPluginCallbackTiming timing;
+		if (!GetCallbackTiming(pPlugin, Index, timing))
+			return false;
+
+		Dest.Type = pInt64Type;
+		Dest.Int64 = timing.Count;
+		return true;
+	}
+
+	// times are in milliseconds
+	case PluginMembers::CallbackTime: {
+		MQPluginCallbackTiming timing;
+		if (!GetCallbackTiming(pPlugin, Index, timing))
+			return false;
+
+		Dest.Type = pFloatType;
+		Dest.Set(std::chrono::duration<float, std::milli>(timing.TotalTime).count());
+		return true;
+	}
+
+	case PluginMembers::CallbackMaxTime: {
+		MQPluginCallbackTiming timing;
+		if (!GetCallbackTiming(pPlugin, Index, timing))
+			return false;
+
+		Dest.Type = pFloatType;
+		Dest.Set(std::chrono::duration<float, std::milli>(timing.MaxTime).count());
+		return true;
+	}
+
+	case PluginMembers::CallbackLastTime: {
+		MQPluginCallbackTiming timing;
+		if (!Index[0] || !GetCallbackTiming(pPlugin, Index, timing))
+			return false;
+
+		Dest.Type = pFloatType;
+		Dest.Set(std::chrono::duration<float, std::milli>(timing.LastTime).count());
+		return true;
+	}
+
 	default: break;
 	}
 
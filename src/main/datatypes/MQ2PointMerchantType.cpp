@@ -61,15 +61,11 @@ bool MQ2PointMerchantType::GetMember(MQVarPtr VarPtr, const char* Member, char*
 			else
 			{
 				// by name
-				for (int i = 0; i < page->GetItemCount(); i++)
+				int index = s_merchantItemIndex.Find(Index, true);
+				if (index != -1)
 				{
-					ItemPtr pItem = page->GetItem(i);
-
-					if (pItem && !_stricmp(pItem->GetName(), Index))
-					{
-						Dest.Int = i;
-						return true;
-					}
+					Dest.Int = index;
+					return true;
 				}
 			}
 		}
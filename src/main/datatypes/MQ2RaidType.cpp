@@ -107,13 +107,11 @@ bool MQ2RaidType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 			else
 			{
 				// by name
-				for (int nMember = 0; nMember < MAX_RAID_SIZE; nMember++)
+				int nMember = GetRaidMemberSlotByName(Index);
+				if (nMember != -1)
 				{
-					if (pRaid->locations[nMember] && ci_equals(pRaid->raidMembers[nMember].Name, Index))
-					{
-						Dest.DWord = nMember + 1;
-						return true;
-					}
+					Dest.DWord = nMember + 1;
+					return true;
 				}
 			}
 		}
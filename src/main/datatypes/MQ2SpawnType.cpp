@@ -1071,7 +1071,7 @@ bool MQ2SpawnType::GetMember(SPAWNINFO* pSpawn, const char* Member, char* Index,
 		return true;
 
 	case SpawnMembers::LineOfSight:
-		Dest.Set(pControlledPlayer->CanSee(*pSpawn));
+		Dest.Set(CanSeeSpawn(pControlledPlayer, pSpawn));
 		Dest.Type = pBoolType;
 		return true;
 
@@ -1666,6 +1666,7 @@ bool MQ2SpawnType::dataSpawnCount(const char* szIndex, MQTypeVar& Ret)
 	}
 	else
 	{
+		EnsureMQ2SpawnSort();
 		Ret.DWord = gSpawnCount;
 		Ret.Type = pIntType;
 		return true;
@@ -1761,6 +1762,9 @@ bool MQ2SpawnType::dataNearestSpawn(const char* szIndex, MQTypeVar& Ret)
 			FRadiusSq = static_cast<float>(ssSpawn.FRadius * ssSpawn.FRadius);
 		}
 
+		EnsureMQ2SpawnSort();
+
+		const MQCompiledSpawnSearch search(&ssSpawn);
 		for (const MQSpawnArrayItem& spawnItem : gSpawnsArray)
 		{
 			if (checkDistance && spawnItem.GetDistanceSquared() > FRadiusSq)
@@ -1769,7 +1773,7 @@ bool MQ2SpawnType::dataNearestSpawn(const char* szIndex, MQTypeVar& Ret)
 					return false;
 			}
 
-			if (SpawnMatchesSearch(&ssSpawn, pControlledPlayer, spawnItem.GetSpawn()))
+			if (search.Matches(pControlledPlayer, spawnItem.GetSpawn()))
 			{
 				if (--nth == 0)
 				{
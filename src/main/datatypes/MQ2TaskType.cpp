@@ -38,36 +38,6 @@ enum class TaskTypeMethods
 	Select = 1,
 };
 
-int FindTaskIndex(CTaskEntry* task)
-{
-	if (!task || !pTaskManager)
-		return -1;
-
-	switch (task->TaskSystem)
-	{
-	case TaskSystemType::cTaskSystemTypeSharedQuest:
-		for (int i = 0; i < MAX_SHARED_TASK_ENTRIES; ++i)
-		{
-			if (&pTaskManager->SharedTaskEntries[i] == task)
-				return i;
-		}
-		break;
-
-	case TaskSystemType::cTaskSystemTypeSoloQuest:
-		for (int i = 0; i < MAX_QUEST_ENTRIES; ++i)
-		{
-			if (&pTaskManager->QuestEntries[i] == task)
-				return i;
-		}
-		break;
-
-	default:
-		break;
-	}
-
-	return -1;
-}
-
 MQ2TaskType::MQ2TaskType() : MQ2Type("task")
 {
 	ScopedTypeMember(TaskTypeMembers, Index);
@@ -295,11 +265,9 @@ bool MQ2TaskType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 			return true;
 		}
 
-		char szOut[MAX_STRING] = { 0 };
 		for (auto& Element : pTask->Elements)
 		{
-			pTaskManager->GetElementDescription(&Element, szOut);
-			if (MaybeExactCompare(szOut, Index))
+			if (MaybeExactCompare(GetTaskObjectiveDescription(&Element), Index))
 			{
 				Dest.Ptr = &Element;
 				return true;
@@ -529,47 +497,6 @@ enum class TaskObjectiveTypeMembers
 	CurrentCount
 };
 
-struct ObjectiveIndex
-{
-	int taskIndex;
-	int objectiveIndex;
-	TaskSystemType systemType;
-};
-
-ObjectiveIndex FindObjectiveIndex(CTaskElement* objective)
-{
-	if (!pTaskManager || !objective)
-		return { -1, -1, TaskSystemType::cTaskSystemTypeTask };
-
-	for (int i = 0; i < MAX_SHARED_TASK_ENTRIES; ++i)
-	{
-		auto sharedEntry = &pTaskManager->SharedTaskEntries[i];
-		if (!sharedEntry || !sharedEntry->TaskID)
-			continue;
-
-		for (int j = 0; j < MAX_TASK_ELEMENTS; ++j)
-		{
-			if (&sharedEntry->Elements[j] == objective)
-				return { i, j, TaskSystemType::cTaskSystemTypeSharedQuest };
-		}
-	}
-
-	for (int i = 0; i < MAX_QUEST_ENTRIES; ++i)
-	{
-		auto questEntry = &pTaskManager->QuestEntries[i];
-		if (!questEntry || !questEntry->TaskID)
-			continue;
-
-		for (int j = 0; j < MAX_TASK_ELEMENTS; ++j)
-		{
-			if (&questEntry->Elements[j] == objective)
-				return { i, j, TaskSystemType::cTaskSystemTypeSoloQuest };
-		}
-	}
-
-	return { -1, -1, TaskSystemType::cTaskSystemTypeTask };
-}
-
 MQ2TaskObjectiveType::MQ2TaskObjectiveType() : MQ2Type("taskobjectivemember")
 {
 	ScopedTypeMember(TaskObjectiveTypeMembers, Instruction);
@@ -602,7 +529,7 @@ bool MQ2TaskObjectiveType::GetMember(MQVarPtr VarPtr, const char* Member, char*
 		if (!pTaskManager)
 			return false;
 
-		pTaskManager->GetElementDescription(pTaskObjective, DataTypeTemp);
+		strcpy_s(DataTypeTemp, GetTaskObjectiveDescription(pTaskObjective).c_str());
 		Dest.Ptr = &DataTypeTemp[0];
 		Dest.Type = pStringType;
 		return true;
@@ -789,12 +716,10 @@ bool MQ2TaskObjectiveType::ToString(MQVarPtr VarPtr, char* Destination)
 	if (!pTaskObjective)
 		return false;
 
-	char szOut[MAX_STRING] = { 0 };
-	pTaskManager->GetElementDescription(pTaskObjective, szOut);
-
-	if (szOut[0])
+	const std::string& description = GetTaskObjectiveDescription(pTaskObjective);
+	if (!description.empty())
 	{
-		strcpy_s(Destination, MAX_STRING, szOut);
+		strcpy_s(Destination, MAX_STRING, description.c_str());
 		return true;
 	}
 
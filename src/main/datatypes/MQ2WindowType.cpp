@@ -377,7 +377,7 @@ bool MQ2WindowType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 		return true;
 
 	case WindowMembers::Child:
-		if (Dest.Ptr = pWnd->GetChildItem(Index))
+		if (Dest.Ptr = FindMQ2WindowChild(pWnd, Index))
 		{
 			Dest.Type = pWindowType;
 			return true;
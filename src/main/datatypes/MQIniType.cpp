@@ -52,22 +52,22 @@ bool MQIniFileSectionKeyType::GetMember(MQVarPtr VarPtr, const char* Member, cha
 	{
 		Dest.Type = pIntType;
 		Dest.Set(0);
-		auto keys = GetPrivateProfileKeys<MAX_STRING * 10>(MQIniFileSection, MQIniFile);
+		auto keys = GetCachedPrivateProfileKeyValues(MQIniFileSection, MQIniFile);
 		if (MQIniFileSectionKey.empty())
 		{
 			Dest.Set(keys.size());
 		}
 		else
 		{
-			Dest.Set(std::count_if(keys.begin(), keys.end(), [](std::string i) {
-				return ci_equals(i, MQIniFileSectionKey);
+			Dest.Set(std::count_if(keys.begin(), keys.end(), [](const auto& i) {
+				return ci_equals(i.first, MQIniFileSectionKey);
 			}));
 		}
 		return true;
 	}
 	case IniFileSectionKeyTypeMembers::Exists:
 		Dest.Type = pBoolType;
-		Dest.Set(PrivateProfileKeyExists(MQIniFileSection, MQIniFileSectionKey, MQIniFile));
+		Dest.Set(CachedIniKeyExists(MQIniFileSection, MQIniFileSectionKey, MQIniFile));
 		return true;
 	case IniFileSectionKeyTypeMembers::Value:
 	{
@@ -84,7 +84,7 @@ bool MQIniFileSectionKeyType::GetMember(MQVarPtr VarPtr, const char* Member, cha
 		}
 		else
 		{
-			strcpy_s(DataTypeTemp, GetPrivateProfileString(MQIniFileSection, MQIniFileSectionKey, defaultReturn, MQIniFile).c_str());
+			strcpy_s(DataTypeTemp, GetCachedPrivateProfileString(MQIniFileSection, MQIniFileSectionKey, defaultReturn, MQIniFile).c_str());
 		}
 		Dest.Ptr = &DataTypeTemp[0];
 		return true;
@@ -106,7 +106,7 @@ bool MQIniFileSectionKeyType::GetMember(MQVarPtr VarPtr, const char* Member, cha
 			else
 			{
 				Dest.Type = pStringType;
-				auto keyvalues = GetPrivateProfileKeyValues<MAX_STRING * 10>(MQIniFileSection, MQIniFile);
+				auto keyvalues = GetCachedPrivateProfileKeyValues(MQIniFileSection, MQIniFile);
 
 				if (MQIniFileSectionKey.empty())
 				{
@@ -200,7 +200,7 @@ bool MQIniFileSectionType::GetMember(MQVarPtr VarPtr, const char* Member, char*
 	{
 		Dest.Type = pIntType;
 		Dest.Set(0);
-		auto sections = GetPrivateProfileSections<MAX_STRING * 10>(MQIniFile);
+		auto sections = GetCachedPrivateProfileSections(MQIniFile);
 		if (MQIniFileSection.empty())
 		{
 			Dest.Set(sections.size());
@@ -214,9 +214,14 @@ bool MQIniFileSectionType::GetMember(MQVarPtr VarPtr, const char* Member, char*
 		return true;
 	}
 	case IniFileSectionTypeMembers::Exists:
+	{
 		Dest.Type = pBoolType;
-		Dest.Set(PrivateProfileSectionExists(MQIniFileSection, MQIniFile));
+		auto sections = GetCachedPrivateProfileSections(MQIniFile);
+		Dest.Set(std::any_of(sections.begin(), sections.end(), [](const std::string& i) {
+			return ci_equals(i, MQIniFileSection);
+		}));
 		return true;
+	}
 	case IniFileSectionTypeMembers::Key:
 		Dest.Type = pIniFileSectionKeyType;
 		MQIniFileSectionKey = Index;
@@ -259,12 +264,9 @@ bool MQIniFileType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index,
 	switch (static_cast<IniFileTypeMembers>(pMember->ID))
 	{
 	case IniFileTypeMembers::Exists:
-	{
-		std::error_code ec;
 		Dest.Type = pBoolType;
-		Dest.Set(std::filesystem::exists(MQIniFile, ec));
+		Dest.Set(CachedIniFileExists(MQIniFile));
 		return true;
-	}
 	case IniFileTypeMembers::Section:
 		Dest.Type = pIniFileSectionType;
 		MQIniFileSection = Index;
@@ -382,10 +384,9 @@ bool MQIniType::dataIni(const char* szIndex, MQTypeVar& Ret)
 
 	const std::filesystem::path pathIniFile = GetMacroIni(internal_paths::Config, internal_paths::Macros, IniFile);
 
-	std::error_code ec_exists;
-	if (std::filesystem::exists(pathIniFile, ec_exists))
+	if (CachedIniFileExists(pathIniFile.string()))
 	{
-		const int nSize = GetPrivateProfileString(Section, Key, Default, DataTypeTemp, MAX_STRING, pathIniFile.string());
+		const int nSize = GetCachedPrivateProfileString(Section, Key, Default, DataTypeTemp, MAX_STRING, pathIniFile.string());
 
 		if (nSize)
 		{
@@ -13,12 +13,11 @@
  */
 
 #include <mq/Plugin.h>
+#include <mq/api/Inventory.h>
 
 PreSetup("MQ2AutoBank");
 PLUGIN_VERSION(0.1);
 
-static std::list<ItemGlobalIndex> gAutoBankList;
-static std::list<ItemGlobalIndex> gAutoInventoryList;
 static bool gbStartAutoBanking = false;
 static bool gbAutoBankInProgress = false;
 static bool gbAutoInventoryInProgress = false;
@@ -235,6 +234,28 @@ void RemoveAutoBankMenu()//This was empty for autobank??
 	}
 }
 
+static bool ShouldAutoBankItem(const ItemPtr& pItem)
+{
+	// dont add bags that have items inside of them.
+	if (pItem->IsContainer() && !pItem->IsEmpty())
+		return false;
+
+	ItemDefinition* itemDef = pItem->GetItemDefinition();
+	return (gbAutoBankTradeSkillItems && itemDef->TradeSkills && (!itemDef->SkillModValue || gbAutoBankTrophiesWithTradeskill))
+		|| (gbAutoBankCollectibleItems && itemDef->Collectible)
+		|| (gbAutoBankQuestItems && itemDef->QuestItem);
+}
+
+static void StopAutoBanking()
+{
+	gbStartAutoBanking = false;
+	gbAutoBankInProgress = false;
+	gbAutoInventoryInProgress = false;
+
+	if (gAutoBankButton && gAutoBankButton->bChecked)
+		gAutoBankButton->bChecked = false;
+}
+
 static void AutoBankPulse()
 {
 	if (!pLocalPC)
@@ -249,183 +270,88 @@ static void AutoBankPulse()
 
 	if (!pBankWnd || (pBankWnd && pBankWnd->IsVisible() == 0))
 	{
-		gbStartAutoBanking = false;
-		gbAutoBankInProgress = false;
-		gbAutoInventoryInProgress = false;
-
-		if (gAutoBankButton && gAutoBankButton->bChecked)
-			gAutoBankButton->bChecked = false;
+		// the moves that were already sent finish on their own
+		if (IsMovingItems())
+			CancelItemMoves();
 
-		gAutoBankList.clear();
-		gAutoInventoryList.clear();
+		StopAutoBanking();
 		return;
 	}
 
-	if (gbAutoInventoryItems && !gbAutoInventoryInProgress)
-	{
-		// user wants us to move items FROM bank back to their inventory
-
-		if (gAutoInventoryList.empty() && (gbAutoBankTradeSkillItems || gbAutoBankCollectibleItems || gbAutoBankQuestItems))
-		{
-			pLocalPC->BankItems.VisitContainers(
-				[&](const ItemPtr& pItem, const ItemIndex& index)
-				{
-					// dont add bags that have items inside of them.
-					if (pItem->IsContainer() && !pItem->IsEmpty())
-						return;
-
-					ItemDefinition* itemDef = pItem->GetItemDefinition();
-					if ((gbAutoBankTradeSkillItems && itemDef->TradeSkills && (!itemDef->SkillModValue || gbAutoBankTrophiesWithTradeskill))
-						|| (gbAutoBankCollectibleItems && itemDef->Collectible)
-						|| (gbAutoBankQuestItems && itemDef->QuestItem))
-					{
-						gAutoInventoryList.push_back(pItem->GetItemLocation());
-					}
-				});
-		}
-
-		if (!gAutoInventoryList.empty())
-		{
-			gbAutoInventoryInProgress = true;
-		}
-		else
-		{
-			gbStartAutoBanking = false;
-			gbAutoInventoryInProgress = false;
-
-			if (gAutoBankButton && gAutoBankButton->bChecked)
-				gAutoBankButton->bChecked = false;
-
-			WriteChatf("\ay[No Items Found for Auto Inventory.]\ax\n");
-			return;
-		}
-	} // user wants us to autobank stuff
-	else if (!gbAutoInventoryItems && !gbAutoBankInProgress)
-	{
-		if (gAutoBankList.empty() && (gbAutoBankTradeSkillItems || gbAutoBankCollectibleItems || gbAutoBankQuestItems))
-		{
-			// check toplevel slots
-			pProfile->GetInventory().VisitContainers(
-				[&](const ItemPtr& pItem, const ItemIndex& index)
-				{
-					if (pItem->IsContainer() && !pItem->IsEmpty())
-						return;
-
-					ItemDefinition* itemDef = pItem->GetItemDefinition();
-					if ((gbAutoBankTradeSkillItems && itemDef->TradeSkills && (!itemDef->SkillModValue || gbAutoBankTrophiesWithTradeskill))
-						|| (gbAutoBankCollectibleItems && itemDef->Collectible)
-						|| (gbAutoBankQuestItems && itemDef->QuestItem))
-					{
-						gAutoBankList.push_back(pItem->GetItemLocation());
-					}
-				});
-		}
-
-		if (!gAutoBankList.empty())
-		{
-			gbAutoBankInProgress = true;
-		}
-		else
-		{
-			gbStartAutoBanking = false;
-			gbAutoBankInProgress = false;
-
-			if (gAutoBankButton && gAutoBankButton->bChecked)
-				gAutoBankButton->bChecked = false;
-
-			WriteChatf("\ay[No Items Found for Auto Banking.]\ax\n");
-			return;
-		}
-	}
+	// the moves are running, the callback finishes up
+	if (gbAutoBankInProgress || gbAutoInventoryInProgress)
+		return;
 
 	if (pProfile->GetInventorySlot(InvSlot_Cursor) != nullptr)
 	{
-		if (gbAutoInventoryInProgress)
+		if (gbAutoInventoryItems)
 			DoCommandf("/autoinventory");
 		else
 			DoCommandf("/autobank");
 		return;
 	}
 
-	if (!gAutoInventoryList.empty())
-	{
-		const ItemGlobalIndex& ind = gAutoInventoryList.front();
+	std::vector<ItemGlobalIndex> items;
 
-		if (ItemClient* pItem = FindItemByGlobalIndex(ind))
-		{
-			ItemGlobalIndex indy = pItem->GetItemLocation();
+	if (gbAutoBankTradeSkillItems || gbAutoBankCollectibleItems || gbAutoBankQuestItems)
+	{
+		// user wants us to move items FROM bank back to their inventory, or autobank stuff
+		ItemContainer& source = gbAutoInventoryItems ? pLocalPC->BankItems : pProfile->GetInventory();
 
-			if (WillFitInInventory(pItem))
+		source.VisitContainers(
+			[&](const ItemPtr& pItem, const ItemIndex& index)
 			{
-				WriteChatf("[%d] Moving %s from slot %d %d to inventory",
-					gAutoInventoryList.size(), pItem->GetName(), indy.GetIndex().GetSlot(0), indy.GetIndex().GetSlot(1));
+				if (ShouldAutoBankItem(pItem))
+					items.push_back(pItem->GetItemLocation());
+			});
+	}
 
-				PickupItem(pItem->GetItemLocation());
-			}
-			else
-			{
-				WriteChatf("[%d] \arAutoinventory for %s from slot %d %d to inventory \ayFAILED\ar, you are out of space.\ax",
-					gAutoInventoryList.size(), pItem->GetName(), indy.GetIndex().GetSlot(0), indy.GetIndex().GetSlot(1));
-			}
-		}
-		else
-		{
-			WriteChatf("[%d] \arAutoinventory for slot %d %d to inventory \ayFAILED\ar, no item was found.\ax",
-				gAutoInventoryList.size(), ind.GetIndex().GetSlot(0), ind.GetIndex().GetSlot(1));
-		}
+	const char* action = gbAutoInventoryItems ? "Autoinventory" : "AutoBank";
 
-		gAutoInventoryList.pop_front();
+	if (items.empty())
+	{
+		StopAutoBanking();
+
+		WriteChatf("\ay[No Items Found for Auto %s.]\ax\n", gbAutoInventoryItems ? "Inventory" : "Banking");
 		return;
 	}
 
-	if (!gAutoBankList.empty()) {
-		const ItemGlobalIndex& ind = gAutoBankList.front();
-
-		if (ItemClient* pCont = FindItemByGlobalIndex(ind))
-		{
-			ItemDefinition* pItem = GetItemFromContents(pCont);
-			ItemGlobalIndex indy = pCont->GetItemLocation();
+	std::vector<MQItemMove> moves = PlanItemMoves(items,
+		gbAutoInventoryItems ? eItemContainerPossessions : eItemContainerBank);
 
-			if (WillFitInBank(pCont))
-			{
-				WriteChatf("[%d] Moving %s from slot %d %d to bank",
-					gAutoBankList.size(), pItem->Name, indy.GetIndex().GetSlot(0), indy.GetIndex().GetSlot(1));
-
-				PickupItem(indy.Location, pCont);
-			}
-			else
-			{
-				WriteChatf("[%d] \arAutoBank for %s from slot %d %d to bank \ayFAILED\ar, you are out of space.\ax",
-					gAutoBankList.size(), pItem->Name, indy.GetIndex().GetSlot(0), indy.GetIndex().GetSlot(1));
-			}
-		}
-		else
-		{
-			WriteChatf("[%d] \arAutoBank for slot %d %d to bank \ayFAILED\ar, no item was found.\ax",
-				gAutoBankList.size(), ind.GetIndex().GetSlot(0), ind.GetIndex().GetSlot(1));
-		}
+	if (moves.size() < items.size())
+	{
+		WriteChatf("\ar%s for %d items \ayFAILED\ar, you are out of space.\ax",
+			action, static_cast<int>(items.size() - moves.size()));
+	}
 
-		gAutoBankList.pop_front();
+	if (moves.empty())
+	{
+		StopAutoBanking();
 		return;
 	}
 
-	if (gbAutoInventoryInProgress)
-	{
-		if (gAutoBankButton && gAutoBankButton->bChecked)
-			gAutoBankButton->bChecked = false;
+	WriteChatf("Moving %d items to %s", static_cast<int>(moves.size()), gbAutoInventoryItems ? "inventory" : "bank");
 
-		gbAutoInventoryInProgress = false;
-		gbStartAutoBanking = false;
-		WriteChatf("\ay[Autoinventory Finished.]\ax");
-	}
-	else if (gbAutoBankInProgress)
-	{
-		if (gAutoBankButton && gAutoBankButton->bChecked)
-			gAutoBankButton->bChecked = false;
+	if (gbAutoInventoryItems)
+		gbAutoInventoryInProgress = true;
+	else
+		gbAutoBankInProgress = true;
 
-		gbAutoBankInProgress = false;
-		gbStartAutoBanking = false;
-		WriteChatf("\ay[AutoBank Finished.]\ax");
+	bool started = MoveItems(std::move(moves),
+		[action](int moved, int failed)
+		{
+			if (failed > 0)
+				WriteChatf("\ar%s could not move %d items.\ax", action, failed);
+
+			StopAutoBanking();
+			WriteChatf("\ay[%s Finished.]\ax", action);
+		});
+
+	if (!started)
+	{
+		WriteChatf("\ar[Other items are still being moved, please wait for them to finish...]\ax");
+		StopAutoBanking();
 	}
 }
 
@@ -440,6 +366,8 @@ PLUGIN_API void InitializePlugin()
 PLUGIN_API void ShutdownPlugin()
 {
 	DebugSpewAlways("MQ2AutoBank::Shutting down");
+	if (gbAutoBankInProgress || gbAutoInventoryInProgress)
+		CancelItemMoves(false);
 	RemoveDetour(CBankWnd__WndNotification);
 	RemoveAutoBankMenu();
 }
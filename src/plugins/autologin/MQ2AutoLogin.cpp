@@ -252,6 +252,20 @@ void NotifyCharacterUpdate(int Class, int Level)
 	Post(proto::login::ProfileCharInfo, info);
 }
 
+void NotifyLoginPhase(int GameState)
+{
+	proto::login::LoginPhaseMissive phase;
+	switch (GameState)
+	{
+	case GAMESTATE_PRECHARSELECT: phase.set_phase(proto::login::LoginPhaseMissive::Login); break;
+	case GAMESTATE_CHARSELECT: phase.set_phase(proto::login::LoginPhaseMissive::CharacterSelect); break;
+	case GAMESTATE_INGAME: phase.set_phase(proto::login::LoginPhaseMissive::InGame); break;
+	default: return;
+	}
+
+	Post(proto::login::ProfileLoginPhase, phase);
+}
+
 void LoginServer(const char* Login, const char* Pass, const char* Server)
 {
 	proto::login::StartInstanceMissive start;
@@ -813,6 +827,12 @@ int GetListCurSel(CListWnd* pWnd)
 int s_lastCharacterLevel = -1;
 int s_lastCharacterClass = -1;
 
+PLUGIN_API void SetGameState(int GameState)
+{
+	// lets the launcher know how far along the login is so it can pace group launches
+	NotifyLoginPhase(GameState);
+}
+
 PLUGIN_API void OnPulse()
 {
 	if (pLocalPlayer && (pLocalPlayer->GetClass() != s_lastCharacterClass || pLocalPlayer->Level != s_lastCharacterLevel))
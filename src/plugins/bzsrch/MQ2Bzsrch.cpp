@@ -131,6 +131,141 @@ bool WaitingForSearch = false;
 uint64_t NextSearchCheck = 0;
 uint64_t SearchCompleteCheck = 0;
 
+// Index over BazaarItemsArray, rebuilt whenever new results come in so the TLO doesn't have to
+// scan them. Also compares the results against the previous search, so scripts that repeat the same
+// search can tell what changed.
+struct BazaarSearchIndex
+{
+	std::unordered_map<std::string, int> byGuid;
+	std::unordered_map<std::string, int> byName;               // name up to the count, first result
+	std::unordered_map<int, std::vector<int>> byItemID;        // cheapest first
+	std::unordered_map<std::string, int> traderCounts;         // lower case trader names
+
+	// compared to the previous search
+	std::vector<bool> isNew;
+	std::vector<uint32_t> previousPrices;
+	int added = 0;
+	int removed = 0;
+	int priceChanged = 0;
+};
+BazaarSearchIndex BazaarIndex;
+
+// Prices from the last search that came in, by item guid.
+std::unordered_map<std::string, uint32_t> PreviousBazaarPrices;
+
+static std::string GetBazaarGuidKey(const EqItemGuid& guid)
+{
+	return std::string(reinterpret_cast<const char*>(&guid), sizeof(EqItemGuid));
+}
+
+static std::string_view GetBazaarBaseName(const char* itemName)
+{
+	// Result names have the count in brackets at the end
+	std::string_view name = itemName;
+	size_t pos = name.rfind('(');
+
+	return pos == std::string_view::npos ? name : name.substr(0, pos);
+}
+
+static void ClearBazaarIndex(bool clearPrevious)
+{
+	BazaarIndex = BazaarSearchIndex();
+
+	if (clearPrevious)
+		PreviousBazaarPrices.clear();
+}
+
+static void BuildBazaarIndex()
+{
+	BazaarSearchIndex index;
+	std::unordered_map<std::string, uint32_t> prices;
+
+	const int count = static_cast<int>(BazaarItemsArray.size());
+	index.isNew.resize(count, false);
+	index.previousPrices.resize(count, 0);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const BazaarSearchItem& item = BazaarItemsArray[i];
+		std::string guid = GetBazaarGuidKey(item.ItemGuid);
+
+		index.byName.emplace(GetBazaarBaseName(item.ItemName), i);
+		index.byItemID[item.ItemID].push_back(i);
+		++index.traderCounts[to_lower_copy(item.TraderName)];
+
+		auto iter = PreviousBazaarPrices.find(guid);
+		if (iter == PreviousBazaarPrices.end())
+		{
+			index.isNew[i] = true;
+			++index.added;
+		}
+		else
+		{
+			index.previousPrices[i] = iter->second;
+			if (iter->second != item.Price)
+				++index.priceChanged;
+		}
+
+		prices[guid] = item.Price;
+		index.byGuid.emplace(std::move(guid), i);
+	}
+
+	for (const auto& [guid, price] : PreviousBazaarPrices)
+	{
+		if (prices.find(guid) == prices.end())
+			++index.removed;
+	}
+
+	for (auto& [itemID, items] : index.byItemID)
+	{
+		std::stable_sort(items.begin(), items.end(),
+			[](int a, int b) { return BazaarItemsArray[a].Price < BazaarItemsArray[b].Price; });
+	}
+
+	BazaarIndex = std::move(index);
+	PreviousBazaarPrices = std::move(prices);
+}
+
+// Finds the first result whose name, up to the count, starts the given name.
+static int FindBazaarItemByName(std::string_view name)
+{
+	int found = -1;
+
+	for (size_t len = 0; len <= name.length(); ++len)
+	{
+		auto iter = BazaarIndex.byName.find(std::string(name.substr(0, len)));
+		if (iter != BazaarIndex.byName.end() && (found == -1 || iter->second < found))
+			found = iter->second;
+	}
+
+	return found;
+}
+
+// Finds the cheapest result with the given item id, or the given name if it isn't a number.
+static int FindCheapestBazaarItem(const char* szIndex)
+{
+	int itemID = 0;
+
+	if (IsNumber(szIndex))
+	{
+		itemID = GetIntFromString(szIndex, 0);
+	}
+	else
+	{
+		int index = FindBazaarItemByName(szIndex);
+		if (index == -1)
+			return -1;
+
+		itemID = BazaarItemsArray[index].ItemID;
+	}
+
+	auto iter = BazaarIndex.byItemID.find(itemID);
+	if (iter == BazaarIndex.byItemID.end() || iter->second.empty())
+		return -1;
+
+	return iter->second.front();
+}
+
 // attn: dannuic, I need a state machine
 enum class SearchCheckState
 {
@@ -173,6 +308,8 @@ public:
 			}
 		}
 
+		BuildBazaarIndex();
+
 		HandleSearchResults_Trampoline(bufferIn);
 		BazaarSearchDone = true;
 	};
@@ -199,13 +336,11 @@ static void SelectBazaarSearchItem(const BazaarSearchItem* pSearchItem)
 
 static int FindBazaarItemsArrayIndex(const BazaarSearchResults* pResult)
 {
-	for (int i = 0; i < (int)BazaarItemsArray.size(); ++i)
-	{
-		if (BazaarItemsArray[i].ItemGuid == pResult->itemGuid)
-			return i;
-	}
+	auto iter = BazaarIndex.byGuid.find(GetBazaarGuidKey(pResult->itemGuid));
+	if (iter == BazaarIndex.byGuid.end())
+		return -1;
 
-	return -1;
+	return iter->second;
 }
 
 MQ2BazaarType* pBazaarType = nullptr;
@@ -222,6 +357,8 @@ public:
 		Trader,
 		Name,
 		FullName,
+		New,
+		PreviousPrice,
 	};
 
 	enum class BazaarItemMethods
@@ -237,6 +374,8 @@ public:
 		ScopedTypeMember(BazaarItemMembers, Trader);
 		ScopedTypeMember(BazaarItemMembers, Name);
 		ScopedTypeMember(BazaarItemMembers, FullName);
+		ScopedTypeMember(BazaarItemMembers, New);
+		ScopedTypeMember(BazaarItemMembers, PreviousPrice);
 
 		ScopedTypeMethod(BazaarItemMethods, Select);
 	}
@@ -301,6 +440,16 @@ public:
 			Dest.Ptr = &DataTypeTemp[0];
 			Dest.Type = pStringType;
 			return true;
+
+		case BazaarItemMembers::New:
+			Dest.Set(index < BazaarIndex.isNew.size() && BazaarIndex.isNew[index]);
+			Dest.Type = pBoolType;
+			return true;
+
+		case BazaarItemMembers::PreviousPrice:
+			Dest.DWord = index < BazaarIndex.previousPrices.size() ? BazaarIndex.previousPrices[index] : 0;
+			Dest.Type = pIntType;
+			return true;
 		}
 
 		return false;
@@ -346,6 +495,12 @@ public:
 		Done,
 		Item,
 		SortedItem,
+		Cheapest,
+		LowestPrice,
+		TraderCount,
+		Added,
+		Removed,
+		PriceChanged,
 	};
 
 	MQ2BazaarType() : MQ2Type("bazaar")
@@ -354,6 +509,12 @@ public:
 		ScopedTypeMember(BazaarMembers, Done);
 		ScopedTypeMember(BazaarMembers, Item);
 		ScopedTypeMember(BazaarMembers, SortedItem);
+		ScopedTypeMember(BazaarMembers, Cheapest);
+		ScopedTypeMember(BazaarMembers, LowestPrice);
+		ScopedTypeMember(BazaarMembers, TraderCount);
+		ScopedTypeMember(BazaarMembers, Added);
+		ScopedTypeMember(BazaarMembers, Removed);
+		ScopedTypeMember(BazaarMembers, PriceChanged);
 	}
 
 	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
@@ -394,17 +555,12 @@ public:
 				}
 				else
 				{
-					for (uint32_t i = 0; i < BazaarItemsArray.size(); i++)
+					int index = FindBazaarItemByName(Index);
+					if (index != -1)
 					{
-						BazaarSearchItem& item = BazaarItemsArray[i];
-
-						size_t len = strrchr(&item.ItemName[0], '(') - &item.ItemName[0];
-						if (!strncmp(Index, &item.ItemName[0], len))
-						{
-							Dest.DWord = i;
-							Dest.Type = pBazaarItemType;
-							return true;
-						}
+						Dest.DWord = index;
+						Dest.Type = pBazaarItemType;
+						return true;
 					}
 				}
 			}
@@ -460,6 +616,57 @@ public:
 			}
 			return false;
 
+		case BazaarMembers::Cheapest:
+			if (Index[0])
+			{
+				int index = FindCheapestBazaarItem(Index);
+				if (index != -1)
+				{
+					Dest.DWord = index;
+					Dest.Type = pBazaarItemType;
+					return true;
+				}
+			}
+			return false;
+
+		case BazaarMembers::LowestPrice:
+			if (Index[0])
+			{
+				int index = FindCheapestBazaarItem(Index);
+				if (index != -1)
+				{
+					Dest.DWord = BazaarItemsArray[index].Price;
+					Dest.Type = pIntType;
+					return true;
+				}
+			}
+			return false;
+
+		case BazaarMembers::TraderCount:
+			if (Index[0])
+			{
+				auto iter = BazaarIndex.traderCounts.find(to_lower_copy(Index));
+				Dest.DWord = iter != BazaarIndex.traderCounts.end() ? iter->second : 0;
+				Dest.Type = pIntType;
+				return true;
+			}
+			return false;
+
+		case BazaarMembers::Added:
+			Dest.DWord = BazaarIndex.added;
+			Dest.Type = pIntType;
+			return true;
+
+		case BazaarMembers::Removed:
+			Dest.DWord = BazaarIndex.removed;
+			Dest.Type = pIntType;
+			return true;
+
+		case BazaarMembers::PriceChanged:
+			Dest.DWord = BazaarIndex.priceChanged;
+			Dest.Type = pIntType;
+			return true;
+
 		default: break;
 		}
 
@@ -513,6 +720,12 @@ void MQ2BzSrch(SPAWNINFO* pChar, char* szLine)
 	WriteChatColor("    ${Bazaar.Item[n].Quantity} -- quantity of the nth item", USERCOLOR_WHO);
 	WriteChatColor("    ${Bazaar.Item[n].ItemID} -- id of the nth item", USERCOLOR_WHO);
 	WriteChatColor("    ${Bazaar.Item[n].Trader} -- trader name of the nth item", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.Item[n].New} -- TRUE if the nth item wasn't in the previous search", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.Item[n].PreviousPrice} -- price of the nth item in the previous search", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.Cheapest[id|name]} -- cheapest result for an item", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.LowestPrice[id|name]} -- lowest price for an item", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.TraderCount[trader]} -- number of results from a trader", USERCOLOR_WHO);
+	WriteChatColor("    ${Bazaar.Added} ${Bazaar.Removed} ${Bazaar.PriceChanged} -- changes since the previous search", USERCOLOR_WHO);
 }
 
 void SetComboSelection(CComboWnd* pCombo, DWORD index)
@@ -704,6 +917,7 @@ void BzReset(SPAWNINFO* pChar, char* szLine)
 	BazaarSearchDone = false;
 	WaitingForSearch = false;
 	BazaarItemsArray.clear();
+	ClearBazaarIndex(true);
 }
 
 void BzSrchMe(SPAWNINFO* pChar, char* szLine)
@@ -714,6 +928,7 @@ void BzSrchMe(SPAWNINFO* pChar, char* szLine)
 	BazaarSearchDone = false;
 	WaitingForSearch = false;
 	BazaarItemsArray.clear();
+	ClearBazaarIndex(false);
 
 	// Reset to defaults
 	if (CButtonWnd* pDefaultButton = pBazaarSearchWnd->pDefaultButton)
@@ -972,6 +1187,7 @@ PLUGIN_API void SetGameState(DWORD gamestate)
 	WaitingForSearch = false;
 	BazaarSearchDone = false;
 	BazaarItemsArray.clear();
+	ClearBazaarIndex(true);
 	NextSearchCheck = 0;
 }
 
@@ -15,7 +15,7 @@
 #include <mq/Plugin.h>
 
 #include <vector>
-#include <list>
+#include <deque>
 #include <string>
 #include <mq/imgui/ImGuiUtils.h>
 
@@ -23,11 +23,14 @@
 
 PreSetup("MQ2ChatWnd");
 
-static constexpr auto LINES_PER_FRAME = 3;
+// Pending lines are appended to the output box as one block per frame, so this caps how much
+// STML gets laid out in one frame rather than how many appends are done.
+static constexpr auto LINES_PER_FRAME = 20;
 static constexpr auto CMD_HIST_MAX = 50;
 static constexpr auto MAX_LINES_OUTBOX = 700;
 
-std::list<CXStr> sPendingChat;
+// Never holds more than the output box keeps, older lines would be stripped right after being added.
+std::deque<CXStr> sPendingChat;
 DWORD ulOldVScrollPos = 0;
 DWORD bmStripFirstStmlLines = 0;
 char szChatINISection[MAX_STRING] = { 0 };
@@ -248,9 +251,9 @@ CMQChatWnd* MQChatWnd = nullptr;
 
 void LoadChatSettings()
 {
-	bAutoScroll = GetPrivateProfileBool("Settings", "AutoScroll", bAutoScroll, INIFileName);
-	bNoCharSelect = GetPrivateProfileBool("Settings", "NoCharSelect", bNoCharSelect, INIFileName);
-	bSaveByChar = GetPrivateProfileBool("Settings", "SaveByChar", bSaveByChar, INIFileName);
+	bAutoScroll = GetCachedPrivateProfileBool("Settings", "AutoScroll", bAutoScroll, INIFileName);
+	bNoCharSelect = GetCachedPrivateProfileBool("Settings", "NoCharSelect", bNoCharSelect, INIFileName);
+	bSaveByChar = GetCachedPrivateProfileBool("Settings", "SaveByChar", bSaveByChar, INIFileName);
 }
 
 void LoadChatFromINI(CSidlScreenWnd* pWindow)
@@ -260,68 +263,68 @@ void LoadChatFromINI(CSidlScreenWnd* pWindow)
 	LoadChatSettings();
 
 	// left top right bottom
-	pWindow->SetLocation({ (LONG)GetPrivateProfileInt(szChatINISection,"ChatLeft",      10,INIFileName),
-		(LONG)GetPrivateProfileInt(szChatINISection,"ChatTop",       10,INIFileName),
-		(LONG)GetPrivateProfileInt(szChatINISection,"ChatRight",    410,INIFileName),
-		(LONG)GetPrivateProfileInt(szChatINISection,"ChatBottom",   210,INIFileName) });
-
-	pWindow->SetLocked((GetPrivateProfileInt(szChatINISection, "Locked", 0, INIFileName) ? true : false));
-	pWindow->SetFades((GetPrivateProfileInt(szChatINISection, "Fades", 0, INIFileName) ? true : false));
-	pWindow->SetFadeDelay(GetPrivateProfileInt(szChatINISection, "Delay", 2000, INIFileName));
-	pWindow->SetFadeDuration(GetPrivateProfileInt(szChatINISection, "Duration", 500, INIFileName));
-	pWindow->SetAlpha((BYTE)GetPrivateProfileInt(szChatINISection, "Alpha", 255, INIFileName));
-	pWindow->SetFadeToAlpha((BYTE)GetPrivateProfileInt(szChatINISection, "FadeToAlpha", 255, INIFileName));
-	pWindow->SetBGType(GetPrivateProfileInt(szChatINISection, "BGType", 1, INIFileName));
+	pWindow->SetLocation({ (LONG)GetCachedPrivateProfileInt(szChatINISection,"ChatLeft",      10,INIFileName),
+		(LONG)GetCachedPrivateProfileInt(szChatINISection,"ChatTop",       10,INIFileName),
+		(LONG)GetCachedPrivateProfileInt(szChatINISection,"ChatRight",    410,INIFileName),
+		(LONG)GetCachedPrivateProfileInt(szChatINISection,"ChatBottom",   210,INIFileName) });
+
+	pWindow->SetLocked((GetCachedPrivateProfileInt(szChatINISection, "Locked", 0, INIFileName) ? true : false));
+	pWindow->SetFades((GetCachedPrivateProfileInt(szChatINISection, "Fades", 0, INIFileName) ? true : false));
+	pWindow->SetFadeDelay(GetCachedPrivateProfileInt(szChatINISection, "Delay", 2000, INIFileName));
+	pWindow->SetFadeDuration(GetCachedPrivateProfileInt(szChatINISection, "Duration", 500, INIFileName));
+	pWindow->SetAlpha((BYTE)GetCachedPrivateProfileInt(szChatINISection, "Alpha", 255, INIFileName));
+	pWindow->SetFadeToAlpha((BYTE)GetCachedPrivateProfileInt(szChatINISection, "FadeToAlpha", 255, INIFileName));
+	pWindow->SetBGType(GetCachedPrivateProfileInt(szChatINISection, "BGType", 1, INIFileName));
 	ARGBCOLOR col = { 0 };
 	col.ARGB = pWindow->GetBGColor();
-	col.A = GetPrivateProfileInt(szChatINISection, "BGTint.alpha", 255, INIFileName);
-	col.R = GetPrivateProfileInt(szChatINISection, "BGTint.red", 0, INIFileName);
-	col.G = GetPrivateProfileInt(szChatINISection, "BGTint.green", 0, INIFileName);
-	col.B = GetPrivateProfileInt(szChatINISection, "BGTint.blue", 0, INIFileName);
+	col.A = GetCachedPrivateProfileInt(szChatINISection, "BGTint.alpha", 255, INIFileName);
+	col.R = GetCachedPrivateProfileInt(szChatINISection, "BGTint.red", 0, INIFileName);
+	col.G = GetCachedPrivateProfileInt(szChatINISection, "BGTint.green", 0, INIFileName);
+	col.B = GetCachedPrivateProfileInt(szChatINISection, "BGTint.blue", 0, INIFileName);
 	pWindow->SetBGColor(col.ARGB);
-	MQChatWnd->SetChatFont(GetPrivateProfileInt(szChatINISection, "FontSize", 4, INIFileName));
-	GetPrivateProfileString(szChatINISection, "WindowTitle", "MQ", szTemp, MAX_STRING, INIFileName);
+	MQChatWnd->SetChatFont(GetCachedPrivateProfileInt(szChatINISection, "FontSize", 4, INIFileName));
+	GetCachedPrivateProfileString(szChatINISection, "WindowTitle", "MQ", szTemp, MAX_STRING, INIFileName);
 	pWindow->SetWindowText(szTemp);
-	pWindow->bKeepOnScreen = GetPrivateProfileBool(szChatINISection, "KeepOnScreen", true, INIFileName);
+	pWindow->bKeepOnScreen = GetCachedPrivateProfileBool(szChatINISection, "KeepOnScreen", true, INIFileName);
 }
 
 void SaveChatToINI(CSidlScreenWnd* pWindow)
 {
 	char szTemp[MAX_STRING] = { 0 };
-	WritePrivateProfileString("Settings", "AutoScroll", bAutoScroll ? "on" : "off", INIFileName);
-	WritePrivateProfileString("Settings", "NoCharSelect", bNoCharSelect ? "on" : "off", INIFileName);
-	WritePrivateProfileString("Settings", "SaveByChar", bSaveByChar ? "on" : "off", INIFileName);
+	WriteCachedPrivateProfileString("Settings", "AutoScroll", bAutoScroll ? "on" : "off", INIFileName);
+	WriteCachedPrivateProfileString("Settings", "NoCharSelect", bNoCharSelect ? "on" : "off", INIFileName);
+	WriteCachedPrivateProfileString("Settings", "SaveByChar", bSaveByChar ? "on" : "off", INIFileName);
 
 	if (pWindow->IsMinimized())
 	{
-		WritePrivateProfileString(szChatINISection, "ChatTop", std::to_string(pWindow->GetOldLocation().top), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatBottom", std::to_string(pWindow->GetOldLocation().bottom), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatLeft", std::to_string(pWindow->GetOldLocation().left), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatRight", std::to_string(pWindow->GetOldLocation().right), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatTop", std::to_string(pWindow->GetOldLocation().top).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatBottom", std::to_string(pWindow->GetOldLocation().bottom).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatLeft", std::to_string(pWindow->GetOldLocation().left).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatRight", std::to_string(pWindow->GetOldLocation().right).c_str(), INIFileName);
 	}
 	else
 	{
-		WritePrivateProfileString(szChatINISection, "ChatTop", std::to_string(pWindow->GetLocation().top), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatBottom", std::to_string(pWindow->GetLocation().bottom), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatLeft", std::to_string(pWindow->GetLocation().left), INIFileName);
-		WritePrivateProfileString(szChatINISection, "ChatRight", std::to_string(pWindow->GetLocation().right), INIFileName);
-	}
-	WritePrivateProfileString(szChatINISection, "Locked", std::to_string(pWindow->IsLocked()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "Fades", std::to_string(pWindow->GetFades()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "Delay", std::to_string(pWindow->GetFadeDelay()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "Duration", std::to_string(pWindow->GetFadeDuration()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "Alpha", std::to_string(pWindow->GetAlpha()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "FadeToAlpha", std::to_string(pWindow->GetFadeToAlpha()), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatTop", std::to_string(pWindow->GetLocation().top).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatBottom", std::to_string(pWindow->GetLocation().bottom).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatLeft", std::to_string(pWindow->GetLocation().left).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(szChatINISection, "ChatRight", std::to_string(pWindow->GetLocation().right).c_str(), INIFileName);
+	}
+	WriteCachedPrivateProfileString(szChatINISection, "Locked", std::to_string(pWindow->IsLocked()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "Fades", std::to_string(pWindow->GetFades()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "Delay", std::to_string(pWindow->GetFadeDelay()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "Duration", std::to_string(pWindow->GetFadeDuration()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "Alpha", std::to_string(pWindow->GetAlpha()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "FadeToAlpha", std::to_string(pWindow->GetFadeToAlpha()).c_str(), INIFileName);
 	ARGBCOLOR col = { 0 };
 	col.ARGB = pWindow->GetBGColor();
-	WritePrivateProfileString(szChatINISection, "BGType", std::to_string(pWindow->GetBGType()), INIFileName);
-	WritePrivateProfileString(szChatINISection, "BGTint.alpha", std::to_string(col.A), INIFileName);
-	WritePrivateProfileString(szChatINISection, "BGTint.red", std::to_string(col.R), INIFileName);
-	WritePrivateProfileString(szChatINISection, "BGTint.green", std::to_string(col.G), INIFileName);
-	WritePrivateProfileString(szChatINISection, "BGTint.blue", std::to_string(col.B), INIFileName);
-	WritePrivateProfileString(szChatINISection, "FontSize", std::to_string(MQChatWnd->FontSize), INIFileName);
-	WritePrivateProfileString(szChatINISection, "WindowTitle", pWindow->GetWindowText().c_str(), INIFileName);
-	WritePrivateProfileBool(szChatINISection, "KeepOnScreen", pWindow->bKeepOnScreen, INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "BGType", std::to_string(pWindow->GetBGType()).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "BGTint.alpha", std::to_string(col.A).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "BGTint.red", std::to_string(col.R).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "BGTint.green", std::to_string(col.G).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "BGTint.blue", std::to_string(col.B).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "FontSize", std::to_string(MQChatWnd->FontSize).c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "WindowTitle", pWindow->GetWindowText().c_str(), INIFileName);
+	WriteCachedPrivateProfileString(szChatINISection, "KeepOnScreen", pWindow->bKeepOnScreen ? "1" : "0", INIFileName);
 }
 
 void CreateChatWindow()
@@ -652,31 +655,27 @@ PLUGIN_API DWORD OnWriteChatColor(char* Line, DWORD Color, DWORD Filter)
 
 	MQChatWnd->SetVisible(true);
 
-	MQFilter* pFilter = gpFilters;
-	while (pFilter)
+	if (IsChatFiltered(Line))
 	{
-		if (!pFilter->pEnabled || (*pFilter->pEnabled))
-		{
-			if (!_strnicmp(Line, pFilter->FilterText, pFilter->Length))
-			{
-				return 0;
-			}
-		}
-		pFilter = pFilter->pNext;
+		return 0;
 	}
 
 	Color = pChatManager->GetRGBAFromIndex(Color);
-	char* szProcessed = new char[MAX_STRING];
+	char szProcessed[MAX_STRING];
 
-	int pos = MQToSTML(Line, szProcessed, MAX_STRING - 4, Color);
+	MQToSTML(Line, szProcessed, MAX_STRING - 4, Color);
 
 	CXStr text = szProcessed;
 	text.append("<br>");
 
 	ConvertItemTags(text);
-	sPendingChat.push_back(text);
 
-	delete[] szProcessed;
+	if (sPendingChat.size() >= MAX_LINES_OUTBOX)
+	{
+		sPendingChat.pop_front();
+	}
+
+	sPendingChat.push_back(std::move(text));
 	return 0;
 }
 
@@ -719,15 +718,32 @@ PLUGIN_API void OnPulse()
 				ThisPulse = LINES_PER_FRAME;
 			}
 
-			for (size_t N = 0; N < ThisPulse; N++)
+			// Coalesce this frame's lines so the output box only lays out once
+			if (ThisPulse == 1)
 			{
-				if (!sPendingChat.empty())
+				MQChatWnd->OutputBox->AppendSTML(sPendingChat.front());
+			}
+			else
+			{
+				size_t length = 0;
+				for (size_t N = 0; N < ThisPulse; N++)
 				{
-					MQChatWnd->OutputBox->AppendSTML(*sPendingChat.begin());
-					sPendingChat.pop_front();
+					length += sPendingChat[N].length();
 				}
+
+				std::string block;
+				block.reserve(length);
+
+				for (size_t N = 0; N < ThisPulse; N++)
+				{
+					block.append(sPendingChat[N].c_str(), sPendingChat[N].length());
+				}
+
+				MQChatWnd->OutputBox->AppendSTML(block.c_str());
 			}
 
+			sPendingChat.erase(sPendingChat.begin(), sPendingChat.begin() + ThisPulse);
+
 			if (bScrollDown)
 			{
 				// set current vscroll position to bottom
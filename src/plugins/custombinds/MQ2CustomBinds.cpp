@@ -29,6 +29,7 @@ struct CustomBind
 };
 
 static std::vector<std::unique_ptr<CustomBind>> sCustomBinds;
+static ci_unordered::map<std::string, int> sCustomBindsByName;
 static bool gbBindsLoaded = false;
 
 static void ExecuteCustomBind(const char* Name, bool Down);
@@ -38,16 +39,11 @@ static void CustomBindCmd(SPAWNINFO* pChar, char* szLine);
 
 static int FindCustomBind(const char* Name)
 {
-	for (int index = 0; index < (int)sCustomBinds.size(); ++index)
-	{
-		if (CustomBind* pBind = sCustomBinds[index].get())
-		{
-			if (ci_equals(Name, pBind->name))
-				return index;
-		}
-	}
+	auto iter = sCustomBindsByName.find(std::string(Name));
+	if (iter == sCustomBindsByName.end())
+		return -1;
 
-	return -1;
+	return iter->second;
 }
 
 static CustomBind* AddCustomBind(
@@ -80,6 +76,7 @@ static CustomBind* AddCustomBind(
 		}
 
 		sCustomBinds[index] = std::move(pBind);
+		sCustomBindsByName[Name] = index;
 		return sCustomBinds[index].get();
 	}
 
@@ -95,6 +92,7 @@ static void RemoveCustomBind(size_t index)
 	{
 		RemoveMQ2KeyBind(pBind->name.c_str());
 
+		sCustomBindsByName.erase(pBind->name);
 		sCustomBinds[index].reset();
 	}
 }
@@ -335,6 +333,7 @@ PLUGIN_API void ShutdownPlugin()
 		}
 	}
 	sCustomBinds.clear();
+	sCustomBindsByName.clear();
 }
 
 PLUGIN_API void SetGameState(DWORD GameState)
@@ -17,6 +17,7 @@
 
 #include <mq/Plugin.h>
 
+#include <filesystem>
 #include <mutex>
 
 PreSetup("MQ2HUD");
@@ -40,11 +41,21 @@ struct HUDELEMENT
 	char        Text[MAX_STRING];
 	char        PreParsed[MAX_STRING];
 
+	// Text with variables is compiled once when the element is loaded. Text without any is only
+	// ever parsed once.
+	std::shared_ptr<const MQCompiledMacroString> Compiled;
+	std::vector<std::string> MacroVars;      // variables a macro element needs before it is parsed
+	int         RefreshMS;                   // 0 to refresh every SkipParse frames
+	uint64_t    NextRefresh;
+	bool        Parsed;
+	bool        Visible;                     // PreParsed has something to draw
+
 	HUDELEMENT* pNext;
 };
 HUDELEMENT* pHud = nullptr;
 
 struct _stat LastRead;
+HANDLE hINIChange = INVALID_HANDLE_VALUE;
 char HUDNames[MAX_STRING] = "Elements";
 char HUDSection[MAX_STRING] = "MQ2HUD";
 int SkipParse = 1;
@@ -79,6 +90,8 @@ void ClearElements()
 	}
 }
 
+bool ParseMacroLine(char* szOriginal, size_t BufferSize, std::list<std::string>& out);
+
 void AddElement(char* IniString)
 {
 	std::scoped_lock lock(s_mutex);
@@ -86,16 +99,22 @@ void AddElement(char* IniString)
 	int X = 0;
 	int Y = 0;
 	int Type = 0;  // FIXME: What is a sane default value for Type?
+	int RefreshMS = 0;
 	ARGBCOLOR Color;
 	Color.A = 0xFF;
 
-	// x,y,color,string
+	// type[:refresh ms],x,y,color,string
 	int Size = 0;
 
 	char* pComma = strchr(IniString, ',');
 	if (!pComma)
 		return;
 	*pComma = 0;
+	if (char* pRefresh = strchr(IniString, ':'))
+	{
+		*pRefresh = 0;
+		RefreshMS = std::max(GetIntFromString(&pRefresh[1], 0), 0);
+	}
 	Type = GetIntFromString(IniString, Type);
 	IniString = &pComma[1];
 
@@ -156,7 +175,7 @@ void AddElement(char* IniString)
 	if (!IniString[0])
 		return;
 
-	HUDELEMENT* pElement = new HUDELEMENT;
+	HUDELEMENT* pElement = new HUDELEMENT();
 	pElement->pNext = pHud;
 	pHud = pElement;
 	pElement->Type = static_cast<HudType>(Type);
@@ -164,8 +183,24 @@ void AddElement(char* IniString)
 	pElement->X = X;
 	pElement->Y = Y;
 	strcpy_s(pElement->Text, IniString);
-	ZeroMemory(pElement->PreParsed, sizeof(pElement->PreParsed));
 	pElement->Size = Size;
+	pElement->RefreshMS = RefreshMS;
+
+	if (strstr(pElement->Text, "${"))
+	{
+		pElement->Compiled = CompileMacroString(pElement->Text);
+
+		// The variables that a macro element depends on only depend on its text.
+		if (pElement->Type & HUDTYPE_MACRO)
+		{
+			char szTemp[MAX_STRING] = { 0 };
+			strcpy_s(szTemp, pElement->Text);
+
+			std::list<std::string> out;
+			ParseMacroLine(szTemp, MAX_STRING, out);
+			pElement->MacroVars.assign(out.begin(), out.end());
+		}
+	}
 
 	DebugSpew("New element '%s' in color %X", pElement->Text, pElement->Color);
 }
@@ -248,6 +283,33 @@ void LoadElements()
 	}
 }
 
+void CheckINIChanged()
+{
+	struct _stat now;
+	if (Stat(INIFileName, now) && (now.st_mtime != LastRead.st_mtime || now.st_size != LastRead.st_size))
+		LoadElements();
+}
+
+// The folder is watched rather than the file, so a notification only means it is worth checking
+// the file again. If the folder can't be watched, the file is checked every CheckINI frames instead.
+void WatchINI()
+{
+	if (hINIChange != INVALID_HANDLE_VALUE)
+		return;
+
+	std::string folder = std::filesystem::path(INIFileName).parent_path().string();
+	hINIChange = FindFirstChangeNotificationA(folder.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+}
+
+void UnwatchINI()
+{
+	if (hINIChange != INVALID_HANDLE_VALUE)
+	{
+		FindCloseChangeNotification(hINIChange);
+		hINIChange = INVALID_HANDLE_VALUE;
+	}
+}
+
 void HandleINI()
 {
 	std::scoped_lock lock(s_mutex);
@@ -421,6 +483,7 @@ PLUGIN_API void InitializePlugin()
 {
 	GetPrivateProfileString(HUDSection, "Last", "Elements", HUDNames, MAX_STRING, INIFileName);
 	HandleINI();
+	WatchINI();
 
 	AddCommand("/defaulthud", DefaultHUD);
 	AddCommand("/loadhud", LoadHUD);
@@ -433,6 +496,7 @@ PLUGIN_API void InitializePlugin()
 
 PLUGIN_API void ShutdownPlugin()
 {
+	UnwatchINI();
 	ClearElements();
 
 	RemoveCommand("/loadhud");
@@ -572,22 +636,71 @@ bool ParseMacroLine(char* szOriginal, size_t BufferSize, std::list<std::string>&
 	return Changed;
 }
 
+// A macro element is blank until every variable it uses exists.
+bool MacroVariablesExist(const HUDELEMENT* pElement)
+{
+	if (!(pElement->Type & HUDTYPE_MACRO) || !gRunning)
+		return true;
+
+	for (const std::string& name : pElement->MacroVars)
+	{
+		if (!FindMQ2Data(name.c_str()) && !FindMQ2DataVariable(name.c_str()))
+			return false;
+	}
+
+	return true;
+}
+
+void RefreshElement(HUDELEMENT* pElement)
+{
+	char szBuffer[MAX_STRING] = { 0 };
+
+	if (!pElement->Compiled)
+	{
+		strcpy_s(szBuffer, pElement->Text);
+	}
+	else if (MacroVariablesExist(pElement))
+	{
+		if (gParserVersion == 2)
+		{
+			ParseCompiledMacroData(*pElement->Compiled, szBuffer, MAX_STRING);
+		}
+		else
+		{
+			strcpy_s(szBuffer, pElement->Text);
+			ParseMacroParameter(szBuffer);
+		}
+	}
+
+	pElement->Parsed = true;
+
+	// Most values are the same as last time, and there is nothing more to do for them.
+	if (!strcmp(szBuffer, pElement->PreParsed))
+		return;
+
+	strcpy_s(pElement->PreParsed, szBuffer);
+	pElement->Visible = szBuffer[0] && strcmp(szBuffer, "nullptr");
+}
+
 // Called every frame that the "HUD" is drawn -- e.g. net status / packet loss bar
 PLUGIN_API void OnDrawHUD()
 {
 	std::scoped_lock lock(s_mutex);
 
-	static bool bOkToCheck = true;
 	static int FrameCount = 0;
-	char szBuffer[MAX_STRING] = { 0 };
+
+	if (hINIChange != INVALID_HANDLE_VALUE && WaitForSingleObject(hINIChange, 0) == WAIT_OBJECT_0)
+	{
+		FindNextChangeNotification(hINIChange);
+		CheckINIChanged();
+	}
 
 	if (++FrameCount > CheckINI)
 	{
 		FrameCount = 0;
 
-		struct _stat now;
-		if (Stat(INIFileName, now) && now.st_mtime != LastRead.st_mtime)
-			LoadElements();
+		if (hINIChange == INVALID_HANDLE_VALUE)
+			CheckINIChanged();
 
 		// check for EQ in foreground
 		if (!bBGUpdate && !gbInForeground)
@@ -607,6 +720,7 @@ PLUGIN_API void OnDrawHUD()
 
 	HUDELEMENT* pElement = pHud;
 	bool bCheckParse = !(FrameCount % SkipParse);
+	uint64_t now = MQGetTickCount64();
 
 	DWORD X, Y;
 	while (pElement)
@@ -627,66 +741,24 @@ PLUGIN_API void OnDrawHUD()
 				Y = SX + pElement->Y;
 			}
 
-			if (bCheckParse)
+			bool bRefresh = !pElement->Parsed;
+			if (pElement->Compiled)
 			{
-				bOkToCheck = true;
-				strcpy_s(pElement->PreParsed, pElement->Text);
-
-				if (pElement->Type & HUDTYPE_MACRO)
-				{
-					if (gRunning)
-					{
-						char szTemp[MAX_STRING] = { 0 };
-						strcpy_s(szTemp, pElement->Text);
-
-						std::list<std::string> out;
-						ParseMacroLine(szTemp, MAX_STRING, out);
-
-						for (auto& i : out)
-						{
-							bOkToCheck = false;
-							char* pChar = (char*)i.c_str();
-
-							if (FindMQ2Data(pChar))
-							{
-								bOkToCheck = true;
-								continue;
-							}
-
-							if (!bOkToCheck)
-							{
-								// ok fine we didnt find it in the tlo map...
-								// lets check variables
-								if (FindMQ2DataVariable(pChar))
-								{
-									bOkToCheck = true;
-									continue;
-								}
-							}
-
-							if (!bOkToCheck)
-							{
-								// still not found...
-								break;
-							}
-						}
-					}
-				}
-
-				if (bOkToCheck)
-				{
-					ParseMacroParameter(pElement->PreParsed);
-				}
+				if (pElement->RefreshMS > 0)
+					bRefresh |= now >= pElement->NextRefresh;
 				else
-				{
-					pElement->PreParsed[0] = '\0';
-				}
+					bRefresh |= bCheckParse;
+			}
+
+			if (bRefresh)
+			{
+				RefreshElement(pElement);
+				pElement->NextRefresh = now + pElement->RefreshMS;
 			}
 
-			strcpy_s(szBuffer, pElement->PreParsed);
-			if (szBuffer[0] && strcmp(szBuffer, "nullptr"))
+			if (pElement->Visible)
 			{
-				DrawHUDText(szBuffer, X, Y, pElement->Color, pElement->Size);
+				DrawHUDText(pElement->PreParsed, X, Y, pElement->Color, pElement->Size);
 			}
 		}
 
@@ -59,6 +59,7 @@ ItemEffectConfig s_itemEffectConfigs[ItemSpellType_Max] = {
 };
 
 static std::pair<MQColor, std::string_view> GetEffectInfo(ItemSpellTypes effectType, bool useCustom = true);
+static void ClearSpellTextCache();
 
 //----------------------------------------------------------------------------
 // this class holds persisted settings for this plugin.
@@ -140,6 +141,8 @@ void Settings::Load()
 	{
 		m_spellColor = MQColor(spellColor.c_str());
 	}
+
+	ClearSpellTextCache();
 }
 
 void Settings::Reset()
@@ -182,6 +185,7 @@ void Settings::SetItemSpellColor(ItemSpellTypes effectType, MQColor color)
 	WritePrivateProfileString("Settings", fmt::format("CustomColor_{}", name),
 		fmt::format("#{:6X}", color.ToRGB()), INIFileName);
 
+	ClearSpellTextCache();
 	s_refreshItemDisplay = true;
 }
 
@@ -197,6 +201,7 @@ void Settings::ResetItemSpellColor(ItemSpellTypes effectType)
 		}
 	}
 
+	ClearSpellTextCache();
 	s_refreshItemDisplay = true;
 }
 
@@ -207,6 +212,7 @@ void Settings::SetSpellColor(MQColor color)
 	WritePrivateProfileString("Settings", "CustomColor_Spell",
 		fmt::format("#{:06X}", color.ToRGB()), INIFileName);
 
+	ClearSpellTextCache();
 	s_refreshSpellDisplay = true;
 }
 
@@ -216,6 +222,7 @@ void Settings::ResetSpellColor()
 
 	DeletePrivateProfileKey("Settings", "CustomColor_Spell", INIFileName);
 
+	ClearSpellTextCache();
 	s_refreshSpellDisplay = true;
 }
 
@@ -776,12 +783,71 @@ static CXStr CreateItemSpellTag(ItemSpellData::SpellData* Effect, EQ_Spell* pSpe
 		CXStr{ buf.data(), buf.size() });
 }
 
+//----------------------------------------------------------------------------
+// The spell text is the same every time the same spell is shown, so the most recently built
+// texts are kept. Durations depend on the player's level, so that is part of the key. Changing
+// the colors in the settings clears the cache.
+
+class SpellTextCache
+{
+public:
+	static constexpr size_t MAX_ENTRIES = 128;
+
+	const std::string* Find(const std::string& key)
+	{
+		auto iter = m_index.find(key);
+		if (iter == m_index.end())
+			return nullptr;
+
+		// move to the front, it was just used
+		m_entries.splice(m_entries.begin(), m_entries, iter->second);
+		return &iter->second->second;
+	}
+
+	const std::string& Add(std::string key, std::string text)
+	{
+		m_entries.emplace_front(std::move(key), std::move(text));
+		m_index[m_entries.front().first] = m_entries.begin();
+
+		if (m_entries.size() > MAX_ENTRIES)
+		{
+			m_index.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+
+		return m_entries.front().second;
+	}
+
+	void Clear()
+	{
+		m_index.clear();
+		m_entries.clear();
+	}
+
+private:
+	using Entry = std::pair<std::string, std::string>;
+
+	std::list<Entry> m_entries;              // most recently used first
+	std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+};
+static SpellTextCache s_spellTextCache;
+
+static void ClearSpellTextCache()
+{
+	s_spellTextCache.Clear();
+}
+
 static std::string CreateItemSpellText(eItemSpellType spellType, ItemSpellData::SpellData* Effect)
 {
 	EQ_Spell* pSpell = GetSpellByID(Effect->SpellID);
 	if (pSpell == nullptr)
 		return {};
 
+	std::string key = fmt::format("item:{}:{}:{}:{}:{}", static_cast<int>(spellType), pSpell->ID,
+		static_cast<int>(Effect->EffectType), pLocalPlayer ? pLocalPlayer->Level : 0, Effect->OverrideName);
+	if (const std::string* text = s_spellTextCache.Find(key))
+		return *text;
+
 	auto [color, name] = GetEffectInfo(spellType);
 
 	auto buf = fmt::memory_buffer();
@@ -794,7 +860,7 @@ static std::string CreateItemSpellText(eItemSpellType spellType, ItemSpellData::
 
 	fmt::format_to(std::back_inserter(buf), "</c>");
 
-	return to_string(buf);
+	return s_spellTextCache.Add(std::move(key), to_string(buf));
 }
 
 static std::string CreateSpellText(EQ_Spell* pSpell)
@@ -802,6 +868,10 @@ static std::string CreateSpellText(EQ_Spell* pSpell)
 	if (!pSpell)
 		return {};
 
+	std::string key = fmt::format("spell:{}:{}", pSpell->ID, pLocalPlayer ? pLocalPlayer->Level : 0);
+	if (const std::string* text = s_spellTextCache.Find(key))
+		return *text;
+
 	auto buf = fmt::memory_buffer();
 	fmt::format_to(fmt::appender(buf), "<BR><c \"#{:06X}\">", s_settings.GetSpellColor().ToRGB());
 
@@ -826,7 +896,7 @@ static std::string CreateSpellText(EQ_Spell* pSpell)
 	fmt::format_to(std::back_inserter(buf), "Spell Icon: {}<br>", pSpell->SpellIcon);
 	fmt::format_to(std::back_inserter(buf), "</c>");
 
-	return to_string(buf);
+	return s_spellTextCache.Add(std::move(key), to_string(buf));
 }
 
 struct repeated_text {
@@ -16,7 +16,11 @@
 
 #include <mq/Plugin.h>
 
-PLUGIN_VERSION(2.0);
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+PLUGIN_VERSION(2.1);
 
 PreSetup("MQ2Labels");
 
@@ -115,6 +119,70 @@ public:
 #endif // IS_EXPANSION_LEVEL(EXPANSION_LEVEL_COTF)
 };
 
+// Labels are updated much more often than their values change, and setting the same text again
+// still has the label lay it out again.
+static void SetLabelText(CLabel* pLabel, const char* text)
+{
+	if (strcmp(pLabel->GetWindowText().c_str(), text) != 0)
+		pLabel->SetWindowText(text);
+}
+
+// Labels are drawn far more often than what they show changes, so each label's text is compiled
+// once and then evaluated at most every gUpdateInterval milliseconds. Everything is thrown away
+// when the UI is reloaded, since the labels go with it.
+struct LabelState
+{
+	std::string Source;
+	std::shared_ptr<const MQCompiledMacroString> Compiled;
+	std::string Text;
+	uint64_t NextUpdate = 0;
+};
+
+static std::unordered_map<CLabel*, LabelState> s_labelStates;
+static int gUpdateInterval = 100;
+
+// Source is what the label's text comes from. If it is a tooltip, it is converted from STML before
+// being compiled.
+static void UpdateLabel(CLabel* pLabel, std::string_view source, bool isTooltip)
+{
+	LabelState& state = s_labelStates[pLabel];
+	const uint64_t now = MQGetTickCount64();
+
+	if (state.Compiled && state.Source == source)
+	{
+		if (now < state.NextUpdate)
+		{
+			SetLabelText(pLabel, state.Text.c_str());
+			return;
+		}
+	}
+	else
+	{
+		state.Source = source;
+
+		if (isTooltip)
+		{
+			char plainText[MAX_STRING] = { 0 };
+			STMLToPlainText(state.Source.data(), plainText);
+			state.Compiled = CompileMacroString(plainText);
+		}
+		else
+		{
+			state.Compiled = CompileMacroString(source);
+		}
+	}
+
+	state.NextUpdate = now + gUpdateInterval;
+
+	char buffer[MAX_STRING] = { 0 };
+	ParseCompiledMacroData(*state.Compiled, buffer, MAX_STRING);
+	if (strcmp(buffer, "NULL") == 0)
+		buffer[0] = 0;
+
+	state.Text = buffer;
+	SetLabelText(pLabel, buffer);
+}
+
 class CLabelHook
 {
 public:
@@ -127,22 +195,15 @@ public:
 		if (pThis->EQType == 9999)
 		{
 			auto tooltip = pThis->GetXMLTooltip();
-			char buffer[MAX_STRING] = { 0 };
 
 			if (!tooltip.empty())
 			{
-				STMLToPlainText(tooltip.mutable_data(), buffer);
-
-				ParseMacroParameter(buffer, MAX_STRING);
-				if (strcmp(buffer, "NULL") == 0)
-					buffer[0] = 0;
+				UpdateLabel(pThis, std::string_view{ tooltip.c_str(), tooltip.length() }, true);
 			}
 			else
 			{
-				strcpy_s(buffer, "BadCustom");
+				SetLabelText(pThis, "BadCustom");
 			}
-
-			pThis->SetWindowText(buffer);
 			return;
 		}
 
@@ -152,14 +213,7 @@ public:
 			{
 				if (Id_PMP[index].ID == pThis->EQType)
 				{
-					char buffer[MAX_STRING] = { 0 };
-					strcpy_s(buffer, Id_PMP[index].PMP);
-
-					ParseMacroParameter(buffer, MAX_STRING);
-					if (strcmp(buffer, "NULL") == 0)
-						buffer[0] = 0;
-
-					pThis->SetWindowText(buffer);
+					UpdateLabel(pThis, Id_PMP[index].PMP, false);
 					return;
 				}
 			}
@@ -172,6 +226,8 @@ public:
 PLUGIN_API void InitializePlugin()
 {
 	// Add commands, macro parameters, hooks, etc.
+	gUpdateInterval = GetPrivateProfileInt("Settings", "UpdateInterval", gUpdateInterval, INIFileName);
+
 	EzDetour(CLabel__UpdateText, &CLabelHook::UpdateText_Detour, &CLabelHook::UpdateText_Trampoline);
 	EzDetour(CSidlManager__CreateXWnd, &CSidlManagerHook::CreateXWnd_Detour, &CSidlManagerHook::CreateXWnd_Trampoline);
 }
@@ -182,4 +238,11 @@ PLUGIN_API void ShutdownPlugin()
 	// Remove commands, macro parameters, hooks, etc.
 	RemoveDetour(CSidlManager__CreateXWnd);
 	RemoveDetour(CLabel__UpdateText);
+
+	s_labelStates.clear();
+}
+
+PLUGIN_API void OnCleanUI()
+{
+	s_labelStates.clear();
 }
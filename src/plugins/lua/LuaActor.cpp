@@ -23,12 +23,16 @@
 #include "LuaActor.h"
 #include "LuaThread.h"
 #include "LuaCoroutine.h"
+#include "LuaEventWait.h"
 
 // includes for datatype conversions to proto
 #include "imgui.h"
 
 #include "common/StringUtils.h"
 
+#include <cmath>
+#include <cstring>
+
 #ifdef _DEBUG
 #pragma comment(lib, "libprotobufd")
 #else
@@ -155,6 +159,436 @@ messaging::Variant SerializeProto(const sol::object& data)
 	return variant;
 }
 
+//----------------------------------------------------------------------------
+// Compact payloads: a flat MessagePack encoding written straight off the lua stack and read straight
+// back onto it, with no proto tree in between. A sender picks it with `compact = true` in the header.
+// The payload leads with a zero byte, which no serialized Variant starts with (field tags are never
+// zero), so receivers tell the two apart on their own and replies go back in the same encoding.
+
+static constexpr char COMPACT_PAYLOAD_MARKER = '\0';
+static constexpr int COMPACT_MAX_DEPTH = 32;  // deeper than any sane payload, and stops cycles
+
+// MessagePack ext types for the imgui vectors
+static constexpr int8_t COMPACT_EXT_IMVEC2 = 1;
+static constexpr int8_t COMPACT_EXT_IMVEC4 = 2;
+
+static bool IsCompactPayload(const std::string& payload)
+{
+	return !payload.empty() && payload[0] == COMPACT_PAYLOAD_MARKER;
+}
+
+static void WriteBigEndian(std::string& out, uint64_t value, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; --i)
+		out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+static void WriteCompactFloat(std::string& out, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	WriteBigEndian(out, bits, 4);
+}
+
+static void WriteCompactNumber(std::string& out, double number)
+{
+	// most numbers are whole, and those take a fraction of the space as integers
+	if (number >= -9223372036854775808.0 && number < 9223372036854775808.0 && number == std::floor(number))
+	{
+		const int64_t value = static_cast<int64_t>(number);
+		if (value >= -32 && value <= 0x7f)
+		{
+			// positive and negative fixint
+			out.push_back(static_cast<char>(value));
+		}
+		else if (value >= INT16_MIN && value <= INT16_MAX)
+		{
+			out.push_back('\xd1');
+			WriteBigEndian(out, static_cast<uint64_t>(value), 2);
+		}
+		else if (value >= INT32_MIN && value <= INT32_MAX)
+		{
+			out.push_back('\xd2');
+			WriteBigEndian(out, static_cast<uint64_t>(value), 4);
+		}
+		else
+		{
+			out.push_back('\xd3');
+			WriteBigEndian(out, static_cast<uint64_t>(value), 8);
+		}
+	}
+	else
+	{
+		uint64_t bits;
+		memcpy(&bits, &number, sizeof(bits));
+		out.push_back('\xcb');
+		WriteBigEndian(out, bits, 8);
+	}
+}
+
+static void WriteCompactString(std::string& out, const char* str, size_t length)
+{
+	if (length <= 31)
+	{
+		out.push_back(static_cast<char>(0xa0 | length));
+	}
+	else if (length <= UINT8_MAX)
+	{
+		out.push_back('\xd9');
+		WriteBigEndian(out, length, 1);
+	}
+	else if (length <= UINT16_MAX)
+	{
+		out.push_back('\xda');
+		WriteBigEndian(out, length, 2);
+	}
+	else
+	{
+		out.push_back('\xdb');
+		WriteBigEndian(out, length, 4);
+	}
+
+	out.append(str, length);
+}
+
+// The count of a map isn't known until its entries are written, so a byte is held for it at the
+// start and grown into a map16 or map32 header for large tables.
+static void WriteCompactMapHeader(std::string& out, size_t header, uint32_t count)
+{
+	std::string size;
+	if (count <= 15)
+	{
+		out[header] = static_cast<char>(0x80 | count);
+		return;
+	}
+
+	if (count <= UINT16_MAX)
+	{
+		out[header] = '\xde';
+		WriteBigEndian(size, count, 2);
+	}
+	else
+	{
+		out[header] = '\xdf';
+		WriteBigEndian(size, count, 4);
+	}
+
+	out.insert(header + 1, size);
+}
+
+static void SerializeCompact(lua_State* L, int index, std::string& out, int depth)
+{
+	switch (lua_type(L, index))
+	{
+	case LUA_TBOOLEAN:
+		out.push_back(lua_toboolean(L, index) ? '\xc3' : '\xc2');
+		break;
+
+	case LUA_TNUMBER:
+		WriteCompactNumber(out, lua_tonumber(L, index));
+		break;
+
+	case LUA_TSTRING:
+	{
+		size_t length = 0;
+		const char* str = lua_tolstring(L, index, &length);
+		WriteCompactString(out, str, length);
+		break;
+	}
+
+	case LUA_TTABLE:
+	{
+		if (depth >= COMPACT_MAX_DEPTH || !lua_checkstack(L, 3))
+		{
+			out.push_back('\xc0');
+			break;
+		}
+
+		const size_t header = out.size();
+		out.push_back('\x80');
+
+		uint32_t count = 0;
+		lua_pushnil(L);
+		while (lua_next(L, index) != 0)
+		{
+			// the same keys that the proto encoding allows, less the restriction on numbers
+			const int keyType = lua_type(L, -2);
+			if (keyType == LUA_TSTRING || keyType == LUA_TNUMBER)
+			{
+				const int top = lua_gettop(L);
+				SerializeCompact(L, top - 1, out, depth + 1);
+				SerializeCompact(L, top, out, depth + 1);
+				++count;
+			}
+
+			lua_pop(L, 1);
+		}
+
+		WriteCompactMapHeader(out, header, count);
+		break;
+	}
+
+	case LUA_TUSERDATA:
+		if (sol::stack::check<ImVec2>(L, index, sol::no_panic))
+		{
+			const ImVec2& vec = sol::stack::get<ImVec2&>(L, index);
+			out.push_back('\xd7');
+			out.push_back(COMPACT_EXT_IMVEC2);
+			WriteCompactFloat(out, vec.x);
+			WriteCompactFloat(out, vec.y);
+		}
+		else if (sol::stack::check<ImVec4>(L, index, sol::no_panic))
+		{
+			const ImVec4& vec = sol::stack::get<ImVec4&>(L, index);
+			out.push_back('\xd8');
+			out.push_back(COMPACT_EXT_IMVEC4);
+			WriteCompactFloat(out, vec.x);
+			WriteCompactFloat(out, vec.y);
+			WriteCompactFloat(out, vec.z);
+			WriteCompactFloat(out, vec.w);
+		}
+		else
+		{
+			out.push_back('\xc0');
+		}
+		break;
+
+	default:
+		// functions, threads, and nil have nothing to send
+		out.push_back('\xc0');
+		break;
+	}
+}
+
+// Reads a compact payload onto the lua stack. Payloads come from other processes, so every length
+// is checked against what is left before it is trusted.
+class CompactReader
+{
+public:
+	explicit CompactReader(std::string_view data)
+		: m_pos(data.data())
+		, m_end(data.data() + data.size())
+	{
+	}
+
+	// Pushes the next value. Returns false, with whatever it pushed still on the stack, if the data is
+	// cut short or isn't something we write.
+	bool Push(lua_State* L, int depth)
+	{
+		uint8_t tag;
+		if (!ReadBigEndian(tag, 1))
+			return false;
+
+		if (tag <= 0x7f)
+		{
+			lua_pushnumber(L, tag);
+			return true;
+		}
+
+		if (tag >= 0xe0)
+		{
+			lua_pushnumber(L, static_cast<int8_t>(tag));
+			return true;
+		}
+
+		if ((tag & 0xe0) == 0xa0)
+			return PushString(L, tag & 0x1f);
+
+		if ((tag & 0xf0) == 0x80)
+			return PushMap(L, tag & 0x0f, depth);
+
+		switch (tag)
+		{
+		case 0xc0: lua_pushnil(L); return true;
+		case 0xc2: lua_pushboolean(L, 0); return true;
+		case 0xc3: lua_pushboolean(L, 1); return true;
+
+		case 0xcb:
+		{
+			uint64_t bits;
+			if (!ReadBigEndian(bits, 8))
+				return false;
+
+			double number;
+			memcpy(&number, &bits, sizeof(number));
+			lua_pushnumber(L, number);
+			return true;
+		}
+
+		case 0xd1: return PushInteger<int16_t>(L);
+		case 0xd2: return PushInteger<int32_t>(L);
+		case 0xd3: return PushInteger<int64_t>(L);
+
+		case 0xd9: return PushSized<uint8_t>(L, &CompactReader::PushString);
+		case 0xda: return PushSized<uint16_t>(L, &CompactReader::PushString);
+		case 0xdb: return PushSized<uint32_t>(L, &CompactReader::PushString);
+
+		case 0xde: { uint16_t count; return ReadBigEndian(count, 2) && PushMap(L, count, depth); }
+		case 0xdf: { uint32_t count; return ReadBigEndian(count, 4) && PushMap(L, count, depth); }
+
+		case 0xd7: return PushExt(L, 8);
+		case 0xd8: return PushExt(L, 16);
+
+		default:
+			return false;
+		}
+	}
+
+private:
+	template <typename T>
+	bool ReadBigEndian(T& value, int bytes)
+	{
+		if (m_end - m_pos < bytes)
+			return false;
+
+		uint64_t result = 0;
+		for (int i = 0; i < bytes; ++i)
+			result = (result << 8) | static_cast<uint8_t>(*m_pos++);
+
+		value = static_cast<T>(result);
+		return true;
+	}
+
+	float ReadFloat()
+	{
+		uint32_t bits = 0;
+		ReadBigEndian(bits, 4);
+
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	template <typename T>
+	bool PushInteger(lua_State* L)
+	{
+		std::make_unsigned_t<T> bits;
+		if (!ReadBigEndian(bits, static_cast<int>(sizeof(T))))
+			return false;
+
+		lua_pushnumber(L, static_cast<lua_Number>(static_cast<T>(bits)));
+		return true;
+	}
+
+	template <typename T>
+	bool PushSized(lua_State* L, bool (CompactReader::*push)(lua_State*, size_t))
+	{
+		T length;
+		return ReadBigEndian(length, static_cast<int>(sizeof(T))) && (this->*push)(L, length);
+	}
+
+	bool PushString(lua_State* L, size_t length)
+	{
+		if (static_cast<size_t>(m_end - m_pos) < length)
+			return false;
+
+		lua_pushlstring(L, m_pos, length);
+		m_pos += length;
+		return true;
+	}
+
+	bool PushMap(lua_State* L, uint32_t count, int depth)
+	{
+		// every entry takes at least two bytes, which keeps a bogus count from sizing a huge table
+		if (depth >= COMPACT_MAX_DEPTH || count > static_cast<size_t>(m_end - m_pos) / 2 || !lua_checkstack(L, 3))
+			return false;
+
+		lua_createtable(L, 0, static_cast<int>(count));
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (!Push(L, depth + 1) || !Push(L, depth + 1))
+				return false;
+
+			// lua won't take nil or NaN as a key, so leave those out the way a failed send would
+			const int keyType = lua_type(L, -2);
+			if (keyType == LUA_TNIL || (keyType == LUA_TNUMBER && std::isnan(lua_tonumber(L, -2))))
+				lua_pop(L, 2);
+			else
+				lua_rawset(L, -3);
+		}
+
+		return true;
+	}
+
+	bool PushExt(lua_State* L, int length)
+	{
+		int8_t type;
+		if (!ReadBigEndian(type, 1) || m_end - m_pos < length)
+			return false;
+
+		if (type == COMPACT_EXT_IMVEC2 && length == 8)
+		{
+			const float x = ReadFloat();
+			const float y = ReadFloat();
+			sol::stack::push(L, ImVec2(x, y));
+		}
+		else if (type == COMPACT_EXT_IMVEC4 && length == 16)
+		{
+			const float x = ReadFloat();
+			const float y = ReadFloat();
+			const float z = ReadFloat();
+			const float w = ReadFloat();
+			sol::stack::push(L, ImVec4(x, y, z, w));
+		}
+		else
+		{
+			m_pos += length;
+			lua_pushnil(L);
+		}
+
+		return true;
+	}
+
+	const char* m_pos;
+	const char* m_end;
+};
+
+sol::object DeserializeCompact(const std::string& payload, sol::state_view s)
+{
+	lua_State* L = s.lua_state();
+	const int top = lua_gettop(L);
+
+	CompactReader reader(std::string_view(payload).substr(1));
+	if (!reader.Push(L, 0))
+	{
+		lua_settop(L, top);
+		return sol::lua_nil;
+	}
+
+	return sol::stack::pop<sol::object>(L);
+}
+
+std::string SerializeCompact(const sol::object& data)
+{
+	std::string out(1, COMPACT_PAYLOAD_MARKER);
+
+	if (lua_State* L = data.lua_state())
+	{
+		data.push(L);
+		SerializeCompact(L, lua_gettop(L), out, 0);
+		lua_pop(L, 1);
+	}
+	else
+	{
+		out.push_back('\xc0');
+	}
+
+	return out;
+}
+
+static std::string SerializePayload(const sol::object& data, bool compact)
+{
+	if (compact)
+		return SerializeCompact(data);
+
+	return SerializeProto(data).SerializeAsString();
+}
+
+static bool IsCompactHeader(const sol::table& header)
+{
+	return header.valid() && header.get<std::optional<bool>>("compact").value_or(false);
+}
+
 
 void Send(sol::object payload);
 void Send(sol::table header, sol::object payload);
@@ -168,18 +602,27 @@ struct LuaMessage
 	std::shared_ptr<Message> message;
 	messaging::Variant data;
 	bool has_data = false;
+	bool compact = false;
 
 	LuaMessage(const LuaDropbox* const dropbox_, const std::shared_ptr<Message>& message_)
 		: dropbox(dropbox_)
-		, message(message_)
 	{
-		has_data = message && message->Payload && data.ParseFromString(*message->Payload);
+		SetMessage(message_);
+	}
+
+	void SetMessage(const std::shared_ptr<Message>& message_)
+	{
+		message = message_;
+		compact = message && message->Payload && IsCompactPayload(*message->Payload);
+
+		// compact payloads are read straight onto the stack when asked for, so there is nothing to parse here
+		has_data = message && message->Payload && (compact || data.ParseFromString(*message->Payload));
 	}
 
 	sol::object Get(sol::this_state s)
 	{
 		if (has_data)
-			return DeserializeProto(data, s);
+			return compact ? DeserializeCompact(*message->Payload, s) : DeserializeProto(data, s);
 
 		return sol::lua_nil;
 	}
@@ -208,6 +651,59 @@ struct LuaMessage
 	void Send(sol::object reply, sol::this_state s);
 };
 
+/**
+ * A response that a script waits for with response:wait() instead of handling it in a callback, so
+ * that several requests can be sent before waiting on any of them.
+ */
+struct LuaResponse
+{
+	ResponseFuture future;
+
+	bool Ready() const { return future.IsReady(); }
+
+	sol::object Status(sol::this_state s) const
+	{
+		if (future.IsReady())
+			return sol::make_object(s, future.GetStatus());
+
+		return sol::lua_nil;
+	}
+
+	sol::object Reply(sol::this_state s) const
+	{
+		if (auto message = future.GetReply())
+			return sol::make_object(s, LuaMessage(nullptr, message));
+
+		return sol::lua_nil;
+	}
+
+	void Cancel() { future.Cancel(); }
+
+	void Wait(sol::this_state s) const
+	{
+		if (future.IsReady())
+			return;
+
+		auto thread = LuaThread::get_from(s);
+		if (thread == nullptr || !thread->GetAllowYield())
+		{
+			luaL_error(s, "Cannot wait for a response from a non-yieldable thread");
+			return;
+		}
+
+		if (auto co = thread->GetCurrentCoroutine())
+			co->Await([future = future]() { return future.IsReady(); });
+	}
+};
+
+static std::chrono::milliseconds GetResponseTimeout(std::optional<int64_t> timeout)
+{
+	if (timeout)
+		return std::max(std::chrono::milliseconds(0), std::chrono::milliseconds(*timeout));
+
+	return DEFAULT_RESPONSE_TIMEOUT;
+}
+
 struct CallbackInstance
 {
 	sol::function m_callback;
@@ -275,7 +771,9 @@ public:
 	void Send(sol::table header, sol::object payload) const;
 	void Send(sol::object payload, sol::function response_callback);
 	void Send(sol::table header, sol::object payload, sol::function response_callback);
-	void Reply(const std::shared_ptr<Message>& message, const sol::object& reply, int status) const;
+	LuaResponse SendAsync(sol::object payload) const;
+	LuaResponse SendAsync(sol::table header, sol::object payload, std::optional<int64_t> timeout) const;
+	void Reply(const std::shared_ptr<Message>& message, const sol::object& reply, int status, bool compact) const;
 	void Receive(const std::shared_ptr<Message>& message);
 	void Process();
 
@@ -300,20 +798,25 @@ static ci_unordered::map<std::string, std::weak_ptr<LuaDropbox>> s_dropboxes;
 
 void LuaMessage::Reply(sol::object reply)
 {
-	if (message && dropbox != nullptr) dropbox->Reply(message, reply, 0);
+	if (message && dropbox != nullptr) dropbox->Reply(message, reply, 0, compact);
 }
 
 void LuaMessage::Reply(int status, sol::object reply)
 {
-	if (message && dropbox != nullptr) dropbox->Reply(message, reply, status);
+	if (message && dropbox != nullptr) dropbox->Reply(message, reply, status, compact);
 }
 
 void LuaMessage::Send(sol::object reply, sol::this_state s)
 {
+	// answer in the encoding that the sender used
+	sol::table header = Sender(s);
+	if (compact && header.valid())
+		header["compact"] = true;
+
 	if (dropbox != nullptr)
-		dropbox->Send(Sender(s), reply);
+		dropbox->Send(header, reply);
 	else
-		mq::lua::Send(Sender(s), reply);
+		mq::lua::Send(header, reply);
 }
 
 std::shared_ptr<LuaDropbox> LuaDropbox::RegisterWithName(const std::string& name, const sol::function& callback, sol::this_state s)
@@ -418,6 +921,9 @@ Address LuaDropbox::ParseHeader(sol::table header, const std::shared_ptr<LuaThre
 	addr.Server = header.get<std::optional<std::string>>("server");
 	addr.Character = header.get<std::optional<std::string>>("character");
 
+	// state, like hp, that only the newest of is worth handling
+	addr.Key = header.get<std::optional<std::string>>("key");
+
 	return addr;
 }
 
@@ -428,7 +934,7 @@ void LuaDropbox::Send(sol::object payload) const
 
 void LuaDropbox::Send(sol::table header, sol::object payload) const
 {
-	m_dropbox.Post(ParseHeader(header), SerializeProto(payload));
+	m_dropbox.Post(ParseHeader(header), SerializePayload(payload, IsCompactHeader(header)));
 }
 
 void LuaDropbox::Send(sol::object payload, sol::function response_callback)
@@ -440,26 +946,41 @@ void LuaDropbox::Send(sol::table header, sol::object payload, sol::function resp
 {
 	// need to create the callback instance before response_callback goes out of scope in lua
 	auto callback = std::make_unique<CallbackInstance>(m_parentThread, response_callback, LuaMessage(this, nullptr));
-	m_dropbox.Post(ParseHeader(header), SerializeProto(payload),
+	m_dropbox.Post(ParseHeader(header), SerializePayload(payload, IsCompactHeader(header)),
 		[callback = callback.release(), this](int status, const std::shared_ptr<Message>& message)
 		{
 			callback->m_status = status;
-			callback->m_message.message = message;
-			callback->m_message.has_data = message && message->Payload && callback->m_message.data.ParseFromString(*message->Payload);
+			callback->m_message.SetMessage(message);
 			m_queue.push_back(std::unique_ptr<CallbackInstance>(callback));
 		});
 }
 
-void LuaDropbox::Reply(const std::shared_ptr<Message>& message, const sol::object& reply, int status) const
+LuaResponse LuaDropbox::SendAsync(sol::object payload) const
 {
-	m_dropbox.PostReply(message, SerializeProto(reply), static_cast<uint8_t>(status));
+	return SendAsync(sol::state_view(payload.lua_state()).create_table(), payload, std::nullopt);
+}
+
+LuaResponse LuaDropbox::SendAsync(sol::table header, sol::object payload, std::optional<int64_t> timeout) const
+{
+	// the future only holds the response, it never calls into lua, so there is nothing to queue
+	LuaResponse response{ ResponseFuture(GetResponseTimeout(timeout)) };
+	m_dropbox.Post(ParseHeader(header), SerializePayload(payload, IsCompactHeader(header)), response.future.GetCallback());
+	return response;
+}
+
+void LuaDropbox::Reply(const std::shared_ptr<Message>& message, const sol::object& reply, int status, bool compact) const
+{
+	m_dropbox.PostReply(message, SerializePayload(reply, compact), static_cast<uint8_t>(status));
 }
 
 void LuaDropbox::Receive(const std::shared_ptr<Message>& message)
 {
+	std::shared_ptr<LuaThread> thread = LuaThread::get_from(m_thread.state());
+	LuaEventWaits::Signal(LuaWaitEvent::ActorMessage, 0, m_name, thread.get());
+
 	try
 	{
-		ScopedYieldDisabler disableYield(LuaThread::get_from(m_thread.state()));
+		ScopedYieldDisabler disableYield(thread);
 
 		sol::function_result result = m_coroutine(LuaMessage(this, message));
 		if (!result.valid())
@@ -497,7 +1018,8 @@ void Send(sol::object payload)
 void Send(sol::table header, sol::object payload)
 {
 	auto thread = LuaThread::get_from(header.lua_state());
-	postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread ? thread->GetName() : ""), SerializeProto(payload));
+	postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread ? thread->GetName() : ""),
+		SerializePayload(payload, IsCompactHeader(header)));
 }
 
 void Send(sol::object payload, sol::function response_callback)
@@ -512,17 +1034,30 @@ void Send(sol::table header, sol::object payload, sol::function response_callbac
 	if (thread)
 	{
 		auto callback = std::make_unique<CallbackInstance>(thread->GetLuaThread(), response_callback, LuaMessage(nullptr, nullptr));
-		postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread->GetName()), SerializeProto(payload),
+		postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread->GetName()), SerializePayload(payload, IsCompactHeader(header)),
 			[callback = callback.release()](int status, const std::shared_ptr<Message>& message)
 			{
 				callback->m_status = status;
-				callback->m_message.message = message;
-				callback->m_message.has_data = message && message->Payload && callback->m_message.data.ParseFromString(*message->Payload);
+				callback->m_message.SetMessage(message);
 				s_queue.push_back(std::unique_ptr<CallbackInstance>(callback));
 			});
 	}
 }
 
+LuaResponse SendAsync(sol::table header, sol::object payload, std::optional<int64_t> timeout)
+{
+	auto thread = LuaThread::get_from(header.lua_state());
+	LuaResponse response{ ResponseFuture(GetResponseTimeout(timeout)) };
+	postoffice::SendToActor(LuaDropbox::ParseHeader(header, thread, thread ? thread->GetName() : ""),
+		SerializePayload(payload, IsCompactHeader(header)), response.future.GetCallback());
+	return response;
+}
+
+LuaResponse SendAsync(sol::object payload)
+{
+	return SendAsync(sol::state_view(payload.lua_state()).create_table(), payload, std::nullopt);
+}
+
 // TODO: are these useful?
 sol::object StatelessIterator(sol::object, sol::object k, sol::this_state s)
 {
@@ -580,8 +1115,19 @@ sol::table LuaActors::RegisterLua(sol::state_view s)
 			sol::resolve<void(sol::object, sol::function)>(&LuaDropbox::Send),
 			sol::resolve<void(sol::table, sol::object) const>(&LuaDropbox::Send),
 			sol::resolve<void(sol::table, sol::object, sol::function)>(&LuaDropbox::Send)),
+		"send_async", sol::overload(
+			sol::resolve<LuaResponse(sol::object) const>(&LuaDropbox::SendAsync),
+			sol::resolve<LuaResponse(sol::table, sol::object, std::optional<int64_t>) const>(&LuaDropbox::SendAsync)),
 		"unregister", &LuaDropbox::Unregister);
 
+	actors.new_usertype<LuaResponse>(
+		"response", sol::no_constructor,
+		"ready", sol::property(&LuaResponse::Ready),
+		"status", sol::property(&LuaResponse::Status),
+		"message", sol::property(&LuaResponse::Reply),
+		"cancel", &LuaResponse::Cancel,
+		"wait", &LuaResponse::Wait);
+
 	actors.new_usertype<LuaMessage>(
 		"message", sol::no_constructor,
 		"content", sol::property(&LuaMessage::Get),
@@ -599,12 +1145,18 @@ sol::table LuaActors::RegisterLua(sol::state_view s)
 		sol::resolve<void(sol::object, sol::function)>(&Send),
 		sol::resolve<void(sol::table, sol::object)>(&Send),
 		sol::resolve<void(sol::table, sol::object, sol::function)>(&Send)));
+	actors.set_function("send_async", sol::overload(
+		sol::resolve<LuaResponse(sol::object)>(&SendAsync),
+		sol::resolve<LuaResponse(sol::table, sol::object, std::optional<int64_t>)>(&SendAsync)));
 
 	actors.new_enum("ResponseStatus",
 		"ConnectionClosed", postoffice::ResponseStatus::ConnectionClosed,
 		"NoConnection", postoffice::ResponseStatus::NoConnection,
 		"RoutingFailed", postoffice::ResponseStatus::RoutingFailed,
-		"AmbiguousRecipient", postoffice::ResponseStatus::AmbiguousRecipient);
+		"AmbiguousRecipient", postoffice::ResponseStatus::AmbiguousRecipient,
+		"MailboxFull", postoffice::ResponseStatus::MailboxFull,
+		"Timeout", postoffice::ResponseStatus::Timeout,
+		"Cancelled", postoffice::ResponseStatus::Cancelled);
 
 	return actors;
 }
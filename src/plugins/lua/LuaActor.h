@@ -28,4 +28,10 @@ public:
 
 private:
 };
+
+// The compact payload encoding of actor messages. Values can be moved between unrelated lua states
+// with it, which is how worker states get their input and hand back their results.
+std::string SerializeCompact(const sol::object& data);
+sol::object DeserializeCompact(const std::string& payload, sol::state_view s);
+
 } // namespace mq::lua
@@ -0,0 +1,153 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "LuaBytecodeCache.h"
+
+#include <mq/Plugin.h>
+#include <luajit.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace mq::lua {
+
+static constexpr std::string_view BYTECODE_CACHE_DIR = "LuaCache";
+static constexpr std::string_view BYTECODE_CACHE_EXT = ".luac";
+
+// The first line of a cache file. The bytecode follows it.
+static std::string GetCacheKey(const std::string& path, uintmax_t size, fs::file_time_type modified)
+{
+	return fmt::format("{}|{}|{}|{}|{}\n", LUAJIT_VERSION, sizeof(void*) * 8, to_lower_copy(path), size,
+		modified.time_since_epoch().count());
+}
+
+static fs::path GetCacheDir()
+{
+	return fs::path(gPathResources) / BYTECODE_CACHE_DIR;
+}
+
+static bool ReadFile(const fs::path& path, std::string& contents)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return !file.bad();
+}
+
+static int DumpWriter(lua_State*, const void* p, size_t size, void* ud)
+{
+	static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+	return 0;
+}
+
+// Other clients may be reading or writing the same entry, so the file is written under a name of
+// its own and moved into place.
+static void WriteCacheFile(const fs::path& cachePath, const std::string& key, const sol::protected_function& chunk)
+{
+	lua_State* L = chunk.lua_state();
+
+	std::string contents = key;
+	chunk.push(L);
+	const bool dumped = lua_dump(L, &DumpWriter, &contents) == 0;
+	lua_pop(L, 1);
+
+	if (!dumped)
+		return;
+
+	std::error_code ec;
+	fs::create_directories(cachePath.parent_path(), ec);
+
+	fs::path tempPath = cachePath;
+	tempPath += fmt::format(".{}.tmp", GetCurrentProcessId());
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+
+		file.write(contents.data(), contents.size());
+		if (!file)
+		{
+			file.close();
+			fs::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	fs::rename(tempPath, cachePath, ec);
+	if (ec)
+		fs::remove(tempPath, ec);
+}
+
+sol::load_result LoadLuaFile(sol::state_view sv, const std::string& path, bool useCache)
+{
+	if (!useCache)
+		return sv.load_file(path);
+
+	std::error_code ec;
+	const uintmax_t size = fs::file_size(path, ec);
+	if (ec)
+		return sv.load_file(path);
+
+	const fs::file_time_type modified = fs::last_write_time(path, ec);
+	if (ec)
+		return sv.load_file(path);
+
+	const std::string key = GetCacheKey(path, size, modified);
+	const fs::path cachePath = GetCacheDir() / fmt::format("{:016x}{}",
+		static_cast<uint64_t>(std::hash<std::string>{}(key)), BYTECODE_CACHE_EXT);
+
+	// same chunk name that load_file gives, so that errors and tracebacks look the same either way
+	const std::string chunkName = "@" + path;
+
+	std::string contents;
+	if (ReadFile(cachePath, contents) && contents.size() > key.size() && contents.compare(0, key.size(), key) == 0)
+	{
+		sol::load_result result = sv.load_buffer(contents.data() + key.size(), contents.size() - key.size(),
+			chunkName, sol::load_mode::binary);
+		if (result.valid())
+			return result;
+	}
+
+	if (!ReadFile(path, contents))
+		return sv.load_file(path);
+
+	sol::load_result result = sv.load_buffer(contents.data(), contents.size(), chunkName, sol::load_mode::any);
+	if (result.valid())
+	{
+		WriteCacheFile(cachePath, key, result.get<sol::protected_function>());
+	}
+
+	return result;
+}
+
+size_t ClearBytecodeCache()
+{
+	size_t removed = 0;
+
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(GetCacheDir(), ec))
+	{
+		if (entry.path().extension() == BYTECODE_CACHE_EXT && fs::remove(entry.path(), ec))
+			++removed;
+	}
+
+	return removed;
+}
+
+} // namespace mq::lua
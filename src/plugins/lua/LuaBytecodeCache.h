@@ -0,0 +1,31 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "LuaCommon.h"
+
+#include <string>
+
+namespace mq::lua {
+
+// Loads a lua file the same as load_file does. With the cache enabled, the compiled chunk is kept
+// in the resources directory, keyed on the file's path, size and modification time and on the
+// LuaJIT build, so that every client on the machine can skip parsing it until it changes.
+sol::load_result LoadLuaFile(sol::state_view sv, const std::string& path, bool useCache);
+
+// Removes every cached chunk. Returns the number of files removed.
+size_t ClearBytecodeCache();
+
+} // namespace mq::lua
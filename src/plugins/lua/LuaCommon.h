@@ -62,6 +62,7 @@ public:
 	std::string moduleDir;
 	std::vector<std::string> luaRequirePaths;
 	std::vector<std::string> dllRequirePaths;
+	bool bytecodeCache = true;
 
 private:
 	bool m_initialized = false;
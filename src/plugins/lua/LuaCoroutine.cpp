@@ -18,6 +18,8 @@
 
 #include <mq/Plugin.h>
 
+#include <limits>
+
 namespace mq::lua {
 
 template <typename T>
@@ -155,6 +157,17 @@ void LuaCoroutine::ClearDelay()
 {
 	m_delayTime = 0L;
 	m_delayCondition = std::nullopt;
+	m_awaitReady = nullptr;
+}
+
+void LuaCoroutine::Await(std::function<bool()> ready)
+{
+	if (luaThread == nullptr || ready())
+		return;
+
+	luaThread->DoYield();
+	m_delayTime = std::numeric_limits<uint64_t>::max();
+	m_awaitReady = std::move(ready);
 }
 
 bool LuaCoroutine::ShouldRun()
@@ -165,7 +178,7 @@ bool LuaCoroutine::ShouldRun()
 	}
 
 	// check delayed status
-	if (m_delayTime <= MQGetTickCount64() || CheckCondition(m_delayCondition))
+	if (m_delayTime <= MQGetTickCount64() || CheckCondition(m_delayCondition) || (m_awaitReady && m_awaitReady()))
 	{
 		ClearDelay();
 		return true;
@@ -30,12 +30,17 @@ struct LuaCoroutine
 	sol::thread thread;
 	uint64_t m_delayTime = 0L;
 	std::optional<sol::function> m_delayCondition = std::nullopt;
+	std::function<bool()> m_awaitReady;
 
 	bool CheckCondition(std::optional<sol::function>& func);
 	void Delay(sol::object delayObj, std::optional<sol::object> conditionObj, sol::state_view s);
 	void SetDelay(uint64_t time, std::optional<sol::function> condition = std::nullopt);
 	void ClearDelay();
 
+	// Yields until ready returns true. It is checked each frame before resuming, so it has to
+	// become true on its own, as an actor response does when it arrives or times out.
+	void Await(std::function<bool()> ready);
+
 	bool ShouldRun();
 	CoroutineResult RunCoroutine();
 	CoroutineResult RunCoroutine(const std::vector<std::string>& args);
@@ -30,11 +30,23 @@ unsigned int CALLBACK LuaVarProcess(char* VarName, char* Value, size_t ValueLen)
 	return static_cast<int>(strlen(Value));
 }
 
+// All scripts' events are registered in one parser, so that each line is matched once no matter how
+// many scripts are running. A match is handed to the processor of the script that owns the event.
+static Blech& GetEventParser()
+{
+	static Blech s_blech('#', '|', LuaVarProcess);
+	return s_blech;
+}
+
+static size_t s_eventCount = 0;
+
+// the line being fed to the parser, for the events that match it
+static std::string_view s_currentLine;
+
 //----------------------------------------------------------------------------
 
 LuaEventProcessor::LuaEventProcessor(LuaThread* thread)
 	: m_thread(thread)
-	, m_blech(std::make_unique<Blech>('#', '|', LuaVarProcess))
 {
 }
 
@@ -56,7 +68,7 @@ bool LuaEventProcessor::AddEvent(std::string_view name, std::string_view express
 		return false;
 	}
 
-	m_eventDefinitions.push_back(std::make_unique<LuaEvent>(name, expression, function, this, *m_blech));
+	m_eventDefinitions.push_back(std::make_unique<LuaEvent>(name, expression, function, this, GetEventParser()));
 	return true;
 }
 
@@ -110,11 +122,9 @@ bool LuaEventProcessor::RemoveBind(std::string_view name)
 	return false;
 }
 
-void LuaEventProcessor::Process(std::string_view line) const
+/*static*/ void LuaEventProcessor::ProcessLine(std::string_view line)
 {
-	if (!m_thread->IsValid())
-		return;
-	if (m_eventDefinitions.empty())
+	if (s_eventCount == 0)
 		return;
 	if (line.size() >= MAX_STRING)
 		return;
@@ -135,11 +145,9 @@ void LuaEventProcessor::Process(std::string_view line) const
 	// since we initialized to 0, we know that any remaining members will be 0, so just in case we Get an overflow, re-set the last character to 0
 	line_char[MAX_STRING - 1] = 0;
 
-	sol::state_view state = m_thread->GetState();
-
-	state["_mq_event_line"] = line_char;
-	m_blech->Feed(line_char);
-	state["_mq_event_line"] = sol::lua_nil;
+	s_currentLine = line_char;
+	GetEventParser().Feed(line_char);
+	s_currentLine = {};
 }
 
 static void loop_and_run(LuaThread& thread, std::vector<std::shared_ptr<LuaEventFunction>>& vec)
@@ -247,10 +255,13 @@ void LuaEventProcessor::RemoveBinds(const std::vector<std::string>& binds)
 
 void LuaEventProcessor::HandleBlechEvent(LuaEvent* pEvent, BLECHVALUE* pValues)
 {
-	std::vector<std::pair<uint32_t, std::string>> args;
+	// the captures are only copied for the scripts whose events matched, and only while they are
+	// running and able to handle them
+	if (!m_thread->IsValid() || m_thread->IsPaused())
+		return;
 
-	std::optional<std::string> line = m_thread->GetState()["_mq_event_line"];
-	args.emplace_back(0, line.value_or(""));
+	std::vector<std::pair<uint32_t, std::string>> args;
+	args.emplace_back(0, s_currentLine);
 
 	auto value = pValues;
 	while (value != nullptr)
@@ -312,11 +323,13 @@ LuaEvent::LuaEvent(std::string_view name, std::string_view expression,
 	, m_blech(blech)
 {
 	m_id = m_blech.AddEvent(m_expression.c_str(), LuaEventCallback, this);
+	++s_eventCount;
 }
 
 LuaEvent::~LuaEvent()
 {
 	m_blech.RemoveEvent(m_id);
+	--s_eventCount;
 }
 
 //============================================================================
@@ -119,7 +119,9 @@ public:
 	bool AddBind(std::string_view name, const sol::function& function);
 	bool RemoveBind(std::string_view name);
 
-	void Process(std::string_view line) const;
+	// Matches the line against the events of every script at once and queues the matches with the
+	// scripts they belong to.
+	static void ProcessLine(std::string_view line);
 
 	// this is guaranteed to always run at the exact same time, so we can run binds and events in it
 	void RunEvents(LuaThread& thread);
@@ -137,7 +139,6 @@ public:
 
 private:
 	LuaThread* m_thread;
-	std::unique_ptr<Blech> m_blech;
 
 	// Events
 	std::vector<std::unique_ptr<LuaEvent>> m_eventDefinitions;
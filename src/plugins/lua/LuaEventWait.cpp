@@ -0,0 +1,193 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "LuaEventWait.h"
+#include "LuaCoroutine.h"
+#include "LuaThread.h"
+
+#include <mq/Plugin.h>
+
+#include <limits>
+
+namespace mq::lua {
+
+struct LuaEventWaitState
+{
+	LuaWaitEvent event;
+	const LuaThread* thread;                 // only compared against, never followed
+	std::optional<int> filterValue;
+	std::string filterText;
+	uint64_t deadline;
+
+	bool fired = false;
+	bool cancelled = false;
+	int value = 0;
+	std::string text;
+
+	bool IsDone() const
+	{
+		return fired || cancelled || MQGetTickCount64() >= deadline;
+	}
+
+	bool Matches(LuaWaitEvent other, int otherValue, std::string_view otherText, const LuaThread* otherThread) const
+	{
+		if (event != other || (otherThread != nullptr && otherThread != thread))
+			return false;
+
+		if (filterValue && *filterValue != otherValue)
+			return false;
+
+		return filterText.empty() || ci_find_substr(otherText, filterText) != -1;
+	}
+};
+
+// Waits that haven't been signalled yet. A wait that is dropped by its script expires here.
+static std::vector<std::weak_ptr<LuaEventWaitState>> s_waits;
+
+static const std::pair<std::string_view, LuaWaitEvent> s_waitEventNames[] = {
+	{ "castend",      LuaWaitEvent::CastEnd },
+	{ "spawnadded",   LuaWaitEvent::SpawnAdded },
+	{ "spawnremoved", LuaWaitEvent::SpawnRemoved },
+	{ "target",       LuaWaitEvent::TargetChanged },
+	{ "zoned",        LuaWaitEvent::Zoned },
+	{ "chat",         LuaWaitEvent::Chat },
+	{ "actor",        LuaWaitEvent::ActorMessage },
+};
+
+struct LuaEventWaitHandle
+{
+	std::shared_ptr<LuaEventWaitState> state;
+
+	bool Done() const { return state->IsDone(); }
+	bool Fired() const { return state->fired; }
+	bool TimedOut() const { return !state->fired && !state->cancelled && state->IsDone(); }
+	int Value() const { return state->value; }
+	const std::string& Text() const { return state->text; }
+	void Cancel() const { state->cancelled = true; }
+};
+
+// mq.waitfor(event, [timeout], [filter]) waits until event happens or timeout ms pass, and returns
+// a handle that says which it was. Filter is a number to match the event's value against, or text
+// to find in its text. Outside of a coroutine that can yield, the handle is returned right away
+// and can be checked with done().
+static LuaEventWaitHandle lua_waitfor(std::string_view eventName, std::optional<int64_t> timeout,
+	sol::object filter, sol::this_state s)
+{
+	auto iter = std::find_if(std::begin(s_waitEventNames), std::end(s_waitEventNames),
+		[eventName](const auto& entry) { return ci_equals(entry.first, eventName); });
+	if (iter == std::end(s_waitEventNames))
+	{
+		luaL_error(s, "Unknown event '%s' passed to mq.waitfor", std::string(eventName).c_str());
+		return {};
+	}
+
+	std::shared_ptr<LuaThread> thread = LuaThread::get_from(s);
+
+	auto state = std::make_shared<LuaEventWaitState>();
+	state->event = iter->second;
+	state->thread = thread.get();
+	state->deadline = timeout
+		? MQGetTickCount64() + std::max<int64_t>(*timeout, 0)
+		: std::numeric_limits<uint64_t>::max();
+
+	if (filter.is<int>())
+		state->filterValue = filter.as<int>();
+	else if (filter.is<std::string>())
+		state->filterText = filter.as<std::string>();
+
+	s_waits.push_back(state);
+
+	if (thread && thread->GetAllowYield())
+	{
+		if (auto co = thread->GetCurrentCoroutine())
+			co->Await([state]() { return state->IsDone(); });
+	}
+
+	return LuaEventWaitHandle{ std::move(state) };
+}
+
+void LuaEventWaits::RegisterLua(sol::table& mq)
+{
+	mq.new_usertype<LuaEventWaitHandle>(
+		"eventwait",                             sol::no_constructor,
+		"done",                                  &LuaEventWaitHandle::Done,
+		"fired",                                 &LuaEventWaitHandle::Fired,
+		"timedout",                              &LuaEventWaitHandle::TimedOut,
+		"value",                                 &LuaEventWaitHandle::Value,
+		"text",                                  &LuaEventWaitHandle::Text,
+		"cancel",                                &LuaEventWaitHandle::Cancel);
+
+	mq.set_function("waitfor",                   &lua_waitfor);
+}
+
+void LuaEventWaits::Signal(LuaWaitEvent event, int value, std::string_view text, const LuaThread* thread /* = nullptr */)
+{
+	if (s_waits.empty())
+		return;
+
+	s_waits.erase(std::remove_if(s_waits.begin(), s_waits.end(),
+		[&](const std::weak_ptr<LuaEventWaitState>& weak)
+		{
+			std::shared_ptr<LuaEventWaitState> state = weak.lock();
+			if (!state || state->IsDone())
+				return true;
+
+			if (!state->Matches(event, value, text, thread))
+				return false;
+
+			state->fired = true;
+			state->value = value;
+			state->text = text;
+			return true;
+		}), s_waits.end());
+}
+
+void LuaEventWaits::Pulse()
+{
+	// These are tracked whether anything waits on them or not, so that a new wait doesn't see a
+	// change that happened before it started.
+	static int s_lastTargetID = 0;
+	static int s_lastCastingID = 0;
+
+	const int targetID = pTarget ? static_cast<int>(pTarget->SpawnID) : 0;
+	if (targetID != s_lastTargetID)
+	{
+		s_lastTargetID = targetID;
+		Signal(LuaWaitEvent::TargetChanged, targetID, pTarget ? pTarget->Name : "");
+	}
+
+	const int castingID = pLocalPlayer && GetSpellByID(pLocalPlayer->CastingData.SpellID)
+		? pLocalPlayer->CastingData.SpellID : 0;
+	if (castingID != s_lastCastingID)
+	{
+		if (s_lastCastingID != 0)
+		{
+			if (EQ_Spell* pSpell = GetSpellByID(s_lastCastingID))
+				Signal(LuaWaitEvent::CastEnd, s_lastCastingID, pSpell->Name);
+		}
+
+		s_lastCastingID = castingID;
+	}
+
+	// drop waits that timed out with nothing signalling them
+	s_waits.erase(std::remove_if(s_waits.begin(), s_waits.end(),
+		[](const std::weak_ptr<LuaEventWaitState>& weak)
+		{
+			std::shared_ptr<LuaEventWaitState> state = weak.lock();
+			return !state || state->IsDone();
+		}), s_waits.end());
+}
+
+} // namespace mq::lua
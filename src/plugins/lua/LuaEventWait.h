@@ -0,0 +1,52 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "LuaCommon.h"
+
+#include <string>
+#include <string_view>
+
+namespace mq::lua {
+
+class LuaThread;
+
+enum class LuaWaitEvent
+{
+	CastEnd,                                 // value is the spell id
+	SpawnAdded,                              // value is the spawn id, text is the name
+	SpawnRemoved,                            // value is the spawn id, text is the name
+	TargetChanged,                           // value is the new target's spawn id, 0 for none
+	Zoned,                                   // value is the zone id
+	Chat,                                    // text is the line
+	ActorMessage,                            // text is the mailbox name
+};
+
+// Waits that the events below resume, instead of the script checking a condition every frame. A
+// waiting coroutine is only checked against a flag until the event it waits for happens or the
+// wait times out.
+class LuaEventWaits
+{
+public:
+	static void RegisterLua(sol::table& mq);
+
+	// Called from the plugin's callbacks. thread limits the signal to waits from one script.
+	static void Signal(LuaWaitEvent event, int value, std::string_view text, const LuaThread* thread = nullptr);
+
+	// Signals the events that have no callback of their own by comparing against the last frame.
+	static void Pulse();
+};
+
+} // namespace mq::lua
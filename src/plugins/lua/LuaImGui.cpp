@@ -20,6 +20,8 @@
 #include "imgui/implot/implot.h"
 #include <mq/Plugin.h>
 
+#include <imgui/imgui_internal.h>
+
 namespace mq::lua {
 
 //============================================================================
@@ -34,9 +36,9 @@ LuaImGuiProcessor::~LuaImGuiProcessor()
 {
 }
 
-void LuaImGuiProcessor::AddCallback(std::string_view name, sol::function callback)
+void LuaImGuiProcessor::AddCallback(std::string_view name, sol::function callback, const LuaImGuiOptions& options)
 {
-	m_imguis.emplace_back(new LuaImGui(name, m_thread->GetLuaThread(), callback));
+	m_imguis.emplace_back(new LuaImGui(name, m_thread->GetLuaThread(), callback, options));
 }
 
 void LuaImGuiProcessor::RemoveCallback(std::string_view name)
@@ -56,6 +58,8 @@ void LuaImGuiProcessor::Pulse()
 {
 	if (m_thread->IsPaused()) return;
 
+	const auto startTime = std::chrono::steady_clock::now();
+
 	// Backup context and set our own
 	ImPlotContext* context = ImPlot::GetCurrentContext();
 	ImPlot::SetCurrentContext(m_imPlotContext.get());
@@ -72,13 +76,173 @@ void LuaImGuiProcessor::Pulse()
 
 	// Restore context
 	ImPlot::SetCurrentContext(context);
+
+	// smoothed over the last few dozen frames, so that it reads as a steady number
+	m_frameTime += (std::chrono::steady_clock::now() - startTime - m_frameTime) / 16.0f;
 }
 
 //============================================================================
 
-LuaImGui::LuaImGui(std::string_view name, const sol::thread& parent_thread, const sol::function& callback)
+// What a callback drew the last time it ran: a copy of each of its windows' draw lists, so that
+// frames it sits out can draw them again without running any lua.
+struct LuaImGuiReplay
+{
+	struct DrawListDeleter
+	{
+		void operator()(ImDrawList* drawList) const { IM_DELETE(drawList); }
+	};
+
+	std::vector<ImGuiID> windows;                                     // its root windows
+	std::vector<std::pair<ImGuiID, std::unique_ptr<ImDrawList, DrawListDeleter>>> drawLists;  // by viewport
+	ImTextureID fontTexture = nullptr;
+	ImVec2 displaySize;
+
+	// The windows that were begun this frame before the callback ran.
+	static std::vector<ImGuiWindow*> GetActiveWindows()
+	{
+		ImGuiContext& g = *GImGui;
+
+		std::vector<ImGuiWindow*> active;
+		for (ImGuiWindow* window : g.Windows)
+		{
+			if (window->LastFrameActive == g.FrameCount)
+				active.push_back(window);
+		}
+
+		return active;
+	}
+
+	void AddWindow(ImGuiWindow* window)
+	{
+		if (!window->Active || window->Hidden)
+			return;
+
+		drawLists.emplace_back(window->ViewportId, window->DrawList->CloneOutput());
+
+		for (ImGuiWindow* child : window->DC.ChildWindows)
+			AddWindow(child);
+	}
+
+	// Copies everything that was begun this frame and isn't in activeBefore.
+	void Capture(const std::vector<ImGuiWindow*>& activeBefore)
+	{
+		ImGuiContext& g = *GImGui;
+
+		windows.clear();
+		drawLists.clear();
+		fontTexture = ImGui::GetIO().Fonts->TexID;
+		displaySize = ImGui::GetIO().DisplaySize;
+
+		// g.Windows is in display order, back to front, which is the order to draw them in
+		for (ImGuiWindow* window : g.Windows)
+		{
+			if (window->LastFrameActive != g.FrameCount || window->RootWindow != window
+				|| std::find(activeBefore.begin(), activeBefore.end(), window) != activeBefore.end())
+			{
+				continue;
+			}
+
+			windows.push_back(window->ID);
+			AddWindow(window);
+		}
+	}
+
+	bool IsValid() const
+	{
+		// a new font atlas or a new device would leave the copied draw commands pointing at textures
+		// that are gone
+		const ImGuiIO& io = ImGui::GetIO();
+		return !windows.empty() && fontTexture == io.Fonts->TexID
+			&& displaySize.x == io.DisplaySize.x && displaySize.y == io.DisplaySize.y;
+	}
+
+	// Whether the user is working with one of the windows, in which case it has to be live.
+	bool IsInUse() const
+	{
+		ImGuiContext& g = *GImGui;
+
+		for (ImGuiID id : windows)
+		{
+			ImGuiWindow* window = ImGui::FindWindowByID(id);
+			if (window == nullptr)
+				continue;
+
+			if (window->Rect().Contains(g.IO.MousePos))
+				return true;
+
+			if ((g.NavWindow && g.NavWindow->RootWindow == window) || (g.ActiveIdWindow && g.ActiveIdWindow->RootWindow == window))
+				return true;
+		}
+
+		return false;
+	}
+
+	bool IsCollapsed() const
+	{
+		for (ImGuiID id : windows)
+		{
+			ImGuiWindow* window = ImGui::FindWindowByID(id);
+			if (window == nullptr || !window->Collapsed)
+				return false;
+		}
+
+		return true;
+	}
+
+	void Draw() const
+	{
+		for (const auto& [viewportId, drawList] : drawLists)
+		{
+			ImGuiViewport* viewport = ImGui::FindViewportByID(viewportId);
+			AppendDrawList(ImGui::GetBackgroundDrawList(viewport ? viewport : ImGui::GetMainViewport()), *drawList);
+		}
+	}
+
+	static void AppendDrawList(ImDrawList* dest, const ImDrawList& src)
+	{
+		for (const ImDrawCmd& cmd : src.CmdBuffer)
+		{
+			if (cmd.UserCallback != nullptr || cmd.ElemCount == 0)
+				continue;
+
+			// the range of vertices that this command uses
+			unsigned int first = UINT_MAX, last = 0;
+			for (unsigned int i = 0; i < cmd.ElemCount; ++i)
+			{
+				const unsigned int idx = src.IdxBuffer[cmd.IdxOffset + i];
+				first = std::min(first, idx);
+				last = std::max(last, idx);
+			}
+
+			dest->PushClipRect(ImVec2(cmd.ClipRect.x, cmd.ClipRect.y), ImVec2(cmd.ClipRect.z, cmd.ClipRect.w));
+			dest->PushTextureID(cmd.TextureId);
+			dest->PrimReserve(cmd.ElemCount, last - first + 1);
+
+			const unsigned int base = dest->_VtxCurrentIdx;
+			for (unsigned int v = first; v <= last; ++v)
+			{
+				const ImDrawVert& vert = src.VtxBuffer[cmd.VtxOffset + v];
+				dest->PrimWriteVtx(vert.pos, vert.uv, vert.col);
+			}
+
+			for (unsigned int i = 0; i < cmd.ElemCount; ++i)
+			{
+				dest->PrimWriteIdx(static_cast<ImDrawIdx>(base + src.IdxBuffer[cmd.IdxOffset + i] - first));
+			}
+
+			dest->PopTextureID();
+			dest->PopClipRect();
+		}
+	}
+};
+
+//============================================================================
+
+LuaImGui::LuaImGui(std::string_view name, const sol::thread& parent_thread, const sol::function& callback,
+	const LuaImGuiOptions& options)
 	: m_name(name)
 	, m_parentThread(parent_thread), m_callback(callback)
+	, m_options(options)
 {
 	m_thread = sol::thread::create(m_parentThread.state());
 	m_coroutine = sol::coroutine(m_thread.state(), m_callback);
@@ -91,7 +255,49 @@ LuaImGui::~LuaImGui()
 {
 }
 
-bool LuaImGui::Pulse() const
+bool LuaImGui::Pulse()
+{
+	if (!m_options.CanSkip())
+		return Run();
+
+	if (ShouldSkip())
+	{
+		m_replay->Draw();
+		return true;
+	}
+
+	if (!m_replay)
+		m_replay = std::make_unique<LuaImGuiReplay>();
+
+	std::vector<ImGuiWindow*> activeBefore = LuaImGuiReplay::GetActiveWindows();
+	m_lastRun = std::chrono::steady_clock::now();
+
+	if (!Run())
+		return false;
+
+	m_replay->Capture(activeBefore);
+	return true;
+}
+
+bool LuaImGui::ShouldSkip() const
+{
+	if (!m_replay || !m_replay->IsValid())
+		return false;
+
+	// nobody can be using the windows of a client in the background
+	if (!m_options.background && !gbInForeground)
+		return true;
+
+	if (m_replay->IsInUse())
+		return false;
+
+	if (!m_options.collapsed && m_replay->IsCollapsed())
+		return true;
+
+	return m_options.interval.count() > 0 && std::chrono::steady_clock::now() - m_lastRun < m_options.interval;
+}
+
+bool LuaImGui::Run() const
 {
 	bool success = true;
 	try
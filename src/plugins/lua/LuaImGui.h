@@ -16,27 +16,49 @@
 
 #include "LuaCommon.h"
 
+#include <chrono>
+
 struct ImPlotContext;
 
 namespace mq::lua {
 
 class LuaThread;
+struct LuaImGuiReplay;
+
+// When a callback has to run. On frames that it sits out, what it drew the last time it ran is drawn
+// again, and it always runs while the mouse is over one of its windows or one of them has focus.
+struct LuaImGuiOptions
+{
+	std::chrono::milliseconds interval{ 0 };    // least time between runs
+	bool background = true;                     // run while the client is in the background
+	bool collapsed = true;                      // run while all of its windows are collapsed
+
+	bool CanSkip() const { return interval.count() > 0 || !background || !collapsed; }
+};
 
 class LuaImGui
 {
 public:
-	LuaImGui(std::string_view name, const sol::thread& parent_thread, const sol::function& callback);
+	LuaImGui(std::string_view name, const sol::thread& parent_thread, const sol::function& callback,
+		const LuaImGuiOptions& options = {});
 	~LuaImGui();
 
-	bool Pulse() const;
+	bool Pulse();
 	std::string_view GetName() { return m_name; }
 
 private:
+	bool Run() const;
+	bool ShouldSkip() const;
+
 	std::string m_name;
 	sol::thread m_thread;
 	sol::function m_callback;
 	mutable sol::coroutine m_coroutine;
 	sol::thread m_parentThread;
+
+	LuaImGuiOptions m_options;
+	std::chrono::steady_clock::time_point m_lastRun;
+	std::unique_ptr<LuaImGuiReplay> m_replay;
 };
 
 class LuaImGuiProcessor
@@ -45,14 +67,21 @@ public:
 	LuaImGuiProcessor(const LuaThread* thread);
 	~LuaImGuiProcessor();
 
-	void AddCallback(std::string_view name, sol::function callback);
+	void AddCallback(std::string_view name, sol::function callback, const LuaImGuiOptions& options = {});
 	void RemoveCallback(std::string_view name);
 	bool HasCallback(std::string_view name);
 	void Pulse();
 
+	// Average time that this script's ImGui callbacks take each frame.
+	std::chrono::microseconds GetFrameTime() const
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(m_frameTime);
+	}
+
 private:
 	const LuaThread* m_thread;
 	std::vector<std::unique_ptr<LuaImGui>> m_imguis;
+	std::chrono::duration<float, std::micro> m_frameTime{ 0 };
 
 	std::shared_ptr<ImPlotContext> m_imPlotContext;
 };
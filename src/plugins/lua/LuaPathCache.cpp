@@ -0,0 +1,228 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "LuaPathCache.h"
+
+#include <mq/Plugin.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace mq::lua {
+
+static std::mutex s_pathCacheMutex;
+
+// Change notification handles, one per watched directory. They are waited on together, so there
+// can't be more than MAXIMUM_WAIT_OBJECTS of them.
+static std::vector<HANDLE> s_watchHandles;
+static std::vector<std::string> s_watchedDirs;
+
+// what WatchDirectory and WatchSearchPath said for each argument, so asking again is free
+static std::unordered_map<std::string, bool> s_watchResults;
+
+static std::unordered_map<std::string, LuaResolvedPath> s_resolvedPaths;
+static uint64_t s_resolvedGeneration = 0;
+
+static std::string NormalizeDir(const fs::path& dir)
+{
+	std::error_code ec;
+	std::string result = to_lower_copy(fs::absolute(dir, ec).lexically_normal().string());
+
+	while (result.size() > 1 && (result.back() == '\\' || result.back() == '/'))
+		result.pop_back();
+
+	return result;
+}
+
+static bool IsUnderDir(std::string_view path, std::string_view dir)
+{
+	return path.size() > dir.size() && starts_with(path, dir) && (path[dir.size()] == '\\' || path[dir.size()] == '/');
+}
+
+static bool IsWatched(std::string_view dir)
+{
+	for (const std::string& watched : s_watchedDirs)
+	{
+		if (dir == watched || IsUnderDir(dir, watched))
+			return true;
+	}
+
+	return false;
+}
+
+// Called with the lock held. Drops every result if anything signaled since the last check.
+static void CheckForChanges()
+{
+	bool changed = false;
+
+	while (!s_watchHandles.empty())
+	{
+		DWORD result = WaitForMultipleObjects(static_cast<DWORD>(s_watchHandles.size()), s_watchHandles.data(), FALSE, 0);
+		if (result < WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + s_watchHandles.size())
+			break;
+
+		FindNextChangeNotification(s_watchHandles[result - WAIT_OBJECT_0]);
+		changed = true;
+	}
+
+	if (changed)
+	{
+		s_resolvedPaths.clear();
+		++s_resolvedGeneration;
+	}
+}
+
+// Called with the lock held.
+static bool WatchDirectoryLocked(const fs::path& dir)
+{
+	std::string key = NormalizeDir(dir);
+
+	auto iter = s_watchResults.find(key);
+	if (iter != s_watchResults.end())
+		return iter->second;
+
+	bool& watching = s_watchResults[key];
+	if (IsWatched(key))
+		return watching = true;
+
+	// A directory that doesn't exist yet is watched through its parent, so that creating it is
+	// noticed. Stop short of watching a whole drive.
+	std::error_code ec;
+	fs::path existing = key;
+	while (!fs::is_directory(existing, ec))
+	{
+		if (!existing.has_relative_path())
+			return watching = false;
+
+		existing = existing.parent_path();
+	}
+
+	if (!existing.has_relative_path())
+		return watching = false;
+
+	std::string existingDir = NormalizeDir(existing);
+	if (IsWatched(existingDir))
+		return watching = true;
+
+	if (s_watchHandles.size() >= MAXIMUM_WAIT_OBJECTS)
+		return watching = false;
+
+	HANDLE handle = FindFirstChangeNotificationW(existing.wstring().c_str(), TRUE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME);
+	if (handle == INVALID_HANDLE_VALUE)
+		return watching = false;
+
+	s_watchHandles.push_back(handle);
+	s_watchedDirs.push_back(std::move(existingDir));
+	return watching = true;
+}
+
+bool WatchDirectory(const fs::path& dir)
+{
+	std::scoped_lock lock(s_pathCacheMutex);
+
+	return WatchDirectoryLocked(dir);
+}
+
+bool WatchSearchPath(const std::string& searchPath)
+{
+	std::scoped_lock lock(s_pathCacheMutex);
+
+	// a search path can't be mistaken for a directory because it always has a '?' in it
+	auto iter = s_watchResults.find(searchPath);
+	if (iter != s_watchResults.end())
+		return iter->second;
+
+	bool watching = true;
+	for (std::string_view entry : split_view(searchPath, ';'))
+	{
+		size_t pos = entry.find('?');
+		if (entry.empty() || pos == std::string_view::npos)
+			continue;
+
+		// everything up to the last separator before the name is the directory
+		std::string_view prefix = entry.substr(0, pos);
+		size_t sep = prefix.find_last_of("\\/");
+		fs::path dir = sep == std::string_view::npos ? fs::path(".") : fs::path(std::string(prefix.substr(0, sep)));
+
+		if (!WatchDirectoryLocked(dir))
+			watching = false;
+	}
+
+	s_watchResults[searchPath] = watching;
+	return watching;
+}
+
+bool IsWatchedPath(const fs::path& path)
+{
+	std::string normalized = NormalizeDir(path);
+
+	std::scoped_lock lock(s_pathCacheMutex);
+	for (const std::string& watched : s_watchedDirs)
+	{
+		if (IsUnderDir(normalized, watched))
+			return true;
+	}
+
+	return false;
+}
+
+LuaResolvedPath ResolveCachedPath(const std::string& key, bool cacheable, const std::function<LuaResolvedPath()>& resolve)
+{
+	if (!cacheable)
+		return resolve();
+
+	uint64_t generation;
+	{
+		std::scoped_lock lock(s_pathCacheMutex);
+		CheckForChanges();
+
+		auto iter = s_resolvedPaths.find(key);
+		if (iter != s_resolvedPaths.end())
+			return iter->second;
+
+		generation = s_resolvedGeneration;
+	}
+
+	// resolve without the lock, other threads shouldn't wait on this thread's trip to the disk
+	LuaResolvedPath result = resolve();
+
+	std::scoped_lock lock(s_pathCacheMutex);
+	CheckForChanges();
+
+	// if something changed while resolving, the result may already be out of date
+	if (generation == s_resolvedGeneration)
+		s_resolvedPaths.emplace(key, result);
+
+	return result;
+}
+
+void ShutdownPathCache()
+{
+	std::scoped_lock lock(s_pathCacheMutex);
+
+	for (HANDLE handle : s_watchHandles)
+		FindCloseChangeNotification(handle);
+
+	s_watchHandles.clear();
+	s_watchedDirs.clear();
+	s_watchResults.clear();
+	s_resolvedPaths.clear();
+	++s_resolvedGeneration;
+}
+
+} // namespace mq::lua
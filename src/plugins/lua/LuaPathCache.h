@@ -0,0 +1,50 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+namespace mq::lua {
+
+// A path looked up on the filesystem: the file that was found, or why nothing was.
+struct LuaResolvedPath
+{
+	std::string path;
+	std::string error;
+};
+
+// Watches dir, or the closest directory above it that exists, for files and directories being
+// created, removed or renamed anywhere under it. Returns false if it can't be watched, in which
+// case nothing that depends on it should be cached. Safe to call from any thread.
+bool WatchDirectory(const std::filesystem::path& dir);
+
+// Watches the directory of every template in a lua search path, like package.path.
+bool WatchSearchPath(const std::string& searchPath);
+
+// True if path is somewhere under a watched directory.
+bool IsWatchedPath(const std::filesystem::path& path);
+
+// Returns what resolve returned the last time it was called for key, or calls it and remembers
+// the result if cacheable. Every result is forgotten as soon as anything changes under a watched
+// directory, so a key must only depend on what is under them. Safe to call from any thread, the
+// process shares one cache.
+LuaResolvedPath ResolveCachedPath(const std::string& key, bool cacheable, const std::function<LuaResolvedPath()>& resolve);
+
+// Forgets every result and stops watching.
+void ShutdownPathCache();
+
+} // namespace mq::lua
@@ -18,6 +18,9 @@
 #include "LuaEvent.h"
 #include "LuaImGui.h"
 #include "LuaActor.h"
+#include "LuaBytecodeCache.h"
+#include "LuaPathCache.h"
+#include "LuaWorker.h"
 #include "bindings/lua_Bindings.h"
 
 #include <mq/Plugin.h>
@@ -113,6 +116,15 @@ LuaThread::LuaThread(this_is_private&&, LuaEnvironmentSettings* environment)
 	, m_pid(NextID())
 	, m_coroutine(LuaCoroutine::Create(sol::thread::create(m_globalState), this))
 {
+	// Count allocations by chaining to the allocator the state was created with rather than
+	// replacing it. LuaJIT's own allocator already pools small blocks per state and keeps them
+	// in the address range that LuaJIT needs. What was allocated before this is taken from the GC.
+	lua_State* L = m_globalState.lua_state();
+	m_memory.baseAlloc = lua_getallocf(L, &m_memory.baseUserData);
+	m_memory.stats.bytes = static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+	m_memory.stats.peakBytes = m_memory.stats.bytes;
+	lua_setallocf(L, &LuaThread::lua_TrackedAlloc, &m_memory);
+
 	m_globalState.open_libraries();
 	m_luaEnvironmentSettings->ConfigureLuaState(m_globalState);
 
@@ -127,6 +139,100 @@ LuaThread::~LuaThread()
 	RemoveAllDataObjects();
 }
 
+void* LuaThread::lua_TrackedAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+	MemoryTracker& memory = *static_cast<MemoryTracker*>(ud);
+	LuaMemoryStats& stats = memory.stats;
+
+	if (ptr == nullptr)
+		osize = 0;
+
+	// only growth is refused, lua expects frees and shrinks to always succeed
+	if (nsize > osize && memory.hardLimit != 0 && stats.bytes + (nsize - osize) > memory.hardLimit)
+		return nullptr;
+
+	void* result = memory.baseAlloc(memory.baseUserData, ptr, osize, nsize);
+	if (result == nullptr && nsize != 0)
+		return nullptr;
+
+	stats.bytes = stats.bytes - osize + nsize;
+	if (ptr == nullptr)
+		++stats.allocations;
+	if (stats.bytes > stats.peakBytes)
+		stats.peakBytes = stats.bytes;
+
+	if (memory.softLimit != 0)
+	{
+		bool over = stats.bytes > memory.softLimit;
+		if (over && !memory.overSoftLimit)
+			memory.warn = true;
+		memory.overSoftLimit = over;
+	}
+
+	return result;
+}
+
+void LuaThread::SetMemoryLimits(size_t softLimit, size_t hardLimit)
+{
+	m_memory.softLimit = softLimit;
+	m_memory.hardLimit = hardLimit;
+	m_memory.overSoftLimit = softLimit != 0 && m_memory.stats.bytes > softLimit;
+}
+
+void LuaThread::SetManagedGC(bool managed)
+{
+	if (m_gcManaged == managed)
+		return;
+
+	m_gcManaged = managed;
+	m_gcInCycle = false;
+	m_gcEstimate = m_memory.stats.bytes;
+	lua_gc(m_globalState.lua_state(), managed ? LUA_GCSTOP : LUA_GCRESTART, 0);
+}
+
+void LuaThread::SetGCTuning(int pause, int stepMul)
+{
+	m_gcPause = std::max(pause, 100);
+	m_gcStepMul = std::max(stepMul, 100);
+
+	lua_State* L = m_globalState.lua_state();
+	lua_gc(L, LUA_GCSETPAUSE, m_gcPause);
+	lua_gc(L, LUA_GCSETSTEPMUL, m_gcStepMul);
+}
+
+bool LuaThread::NeedsGC() const
+{
+	return m_gcManaged && (m_gcInCycle || m_memory.stats.bytes >= m_gcEstimate / 100 * m_gcPause);
+}
+
+void LuaThread::StepGC(std::chrono::steady_clock::time_point deadline)
+{
+	if (!NeedsGC())
+		return;
+
+	// A script that allocates faster than its leftover time lets it collect finishes the cycle now,
+	// the way the collector would have on its own, rather than growing without bound.
+	const bool behind = m_memory.stats.bytes >= m_gcEstimate / 50 * m_gcPause;
+	lua_State* L = m_globalState.lua_state();
+	const auto start = std::chrono::steady_clock::now();
+
+	// always take one step so that a script that never gets leftover time still makes progress
+	do
+	{
+		m_gcInCycle = lua_gc(L, LUA_GCSTEP, 0) == 0;
+		if (!m_gcInCycle)
+		{
+			m_gcEstimate = m_memory.stats.bytes;
+			break;
+		}
+	} while (behind || std::chrono::steady_clock::now() < deadline);
+
+	// stepping resets the collector's threshold, which would let it run on its own again
+	lua_gc(L, LUA_GCSTOP, 0);
+
+	m_gcTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
 /*static*/ std::shared_ptr<LuaThread> LuaThread::Create(LuaEnvironmentSettings* environment)
 {
 	std::shared_ptr<LuaThread> luaThread = std::make_shared<LuaThread>(this_is_private{}, environment);
@@ -141,6 +247,10 @@ void LuaThread::Initialize()
 	bindings::RegisterBindings_Bit32(m_globalState);
 
 	m_globalState.add_package_loader(LuaThread::lua_PackageLoader);
+
+	// in place of the standard loader for lua files, which is the second one, so that required
+	// modules are found through the path cache and go through the bytecode cache as well
+	m_globalState["package"]["loaders"][2] = &LuaThread::lua_CachedFileLoader;
 }
 
 void LuaThread::EnableImGui()
@@ -215,6 +325,12 @@ int LuaThread::PackageLoader(const std::string& pkg, lua_State* L)
 		return 1;
 	}
 
+	if (pkg == "workers")
+	{
+		sol::stack::push(L, std::function([](sol::this_state L) { return LuaWorkers::RegisterLua(L); }));
+		return 1;
+	}
+
 	if (pkg == "ImGui")
 	{
 		sol::stack::push(L, std::function([](sol::this_state L) { return bindings::RegisterBindings_ImGui(L); }));
@@ -242,6 +358,45 @@ int LuaThread::PackageLoader(const std::string& pkg, lua_State* L)
 	return 0;
 }
 
+/*static*/ int LuaThread::lua_CachedFileLoader(lua_State* L)
+{
+	std::shared_ptr<LuaThread> thread_ptr = LuaThread::get_from(L);
+	const bool useBytecodeCache = thread_ptr && thread_ptr->m_luaEnvironmentSettings->bytecodeCache;
+
+	sol::state_view sv{ L };
+	std::string name = sol::stack::get<std::string>(L, 1);
+	std::string searchPath = sv["package"]["path"];
+
+	LuaResolvedPath path = ResolveCachedPath(fmt::format("module|{}|{}", searchPath, name), WatchSearchPath(searchPath),
+		[&]() -> LuaResolvedPath
+		{
+			sol::protected_function searchpath = sv["package"]["searchpath"];
+			sol::protected_function_result found = searchpath(name, searchPath);
+			if (!found.valid())
+				return {};
+
+			return { found.get<sol::optional<std::string>>(0).value_or(""), found.get<sol::optional<std::string>>(1).value_or("") };
+		});
+
+	// like the standard loader, explain where it looked so that require can list it
+	if (path.path.empty())
+	{
+		sol::stack::push(L, path.error);
+		return 1;
+	}
+
+	sol::load_result result = LoadLuaFile(sv, path.path, useBytecodeCache);
+	if (!result.valid())
+	{
+		sol::error err = result;
+		std::string message = fmt::format("error loading module '{}' from file '{}':\n\t{}", name, path.path, err.what());
+		return luaL_error(L, "%s", message.c_str());
+	}
+
+	sol::stack::push(L, result.get<sol::protected_function>());
+	return 1;
+}
+
 //============================================================================
 //============================================================================
 
@@ -288,7 +443,7 @@ std::optional<LuaThreadInfo> LuaThread::StartFile(
 	m_name = GetCanonicalScriptName(script_path, m_luaEnvironmentSettings->luaDir);
 	m_path = script_path;
 
-	auto co = m_coroutine->thread.state().load_file(script_path);
+	auto co = LoadLuaFile(m_coroutine->thread.state(), script_path, m_luaEnvironmentSettings->bytecodeCache);
 	if (!co.valid())
 	{
 		sol::error err = co;
@@ -403,12 +558,11 @@ sol::thread_status LuaThread::GetThreadStatus() const
 	return m_coroutine->thread.status();
 }
 
-std::string LuaThread::GetScriptPath(std::string_view script, const std::filesystem::path& luaDir)
+static std::string FindScriptPath(const std::filesystem::path& script_path)
 {
 	namespace fs = std::filesystem;
 
 	std::error_code ec;
-	const auto script_path = fs::absolute(luaDir / script, ec).lexically_normal();
 	const auto lua_path = script_path.parent_path() / (script_path.filename().string() + ".lua");
 
 	if (fs::exists(script_path, ec) && fs::is_directory(script_path, ec) && fs::exists(script_path / "init.lua", ec))
@@ -428,10 +582,26 @@ std::string LuaThread::GetScriptPath(std::string_view script, const std::filesys
 		return lua_path.string();
 	}
 
-	LuaError("Cannot find %.*s in the filesystem.", script.size(), script.data());
 	return {};
 }
 
+std::string LuaThread::GetScriptPath(std::string_view script, const std::filesystem::path& luaDir)
+{
+	std::error_code ec;
+	const auto script_path = std::filesystem::absolute(luaDir / script, ec).lexically_normal();
+
+	// scripts given by a path outside of the lua directory are looked up every time
+	const bool cacheable = WatchDirectory(luaDir) && IsWatchedPath(script_path);
+
+	std::string path = ResolveCachedPath(fmt::format("script|{}", script_path.string()), cacheable,
+		[&]() -> LuaResolvedPath { return { FindScriptPath(script_path), {} }; }).path;
+
+	if (path.empty())
+		LuaError("Cannot find %.*s in the filesystem.", script.size(), script.data());
+
+	return path;
+}
+
 std::string LuaThread::GetCanonicalScriptName(std::string_view script, const std::filesystem::path& luaDir)
 {
 	namespace fs = std::filesystem;
@@ -467,6 +637,8 @@ LuaThread::RunResult LuaThread::RunOnce()
 		return { m_coroutine->thread.status(), std::nullopt };
 	}
 
+	MQScopedTraceEvent trace(m_name, "lua");
+
 	DataTypeTemp.push_buffer(buffer);
 
 	if (m_eventProcessor)
@@ -475,9 +647,13 @@ LuaThread::RunResult LuaThread::RunOnce()
 		m_eventProcessor->PrepareBinds();
 	}
 
-	YieldAt(m_turboNum);
+	YieldAtSliceEnd();
 	m_yieldToFrame = false;
 
+	// collectgarbage("collect") or "step" in the script resets the threshold too
+	if (m_gcManaged)
+		lua_gc(m_globalState.lua_state(), LUA_GCSTOP, 0);
+
 	if (m_eventProcessor)
 	{
 		m_eventProcessor->RunEvents(*this);
@@ -485,6 +661,7 @@ LuaThread::RunResult LuaThread::RunOnce()
 
 	if (!m_coroutine->ShouldRun())
 	{
+		m_sliceEnd.reset();
 		DataTypeTemp.pop_buffer();
 		return { m_coroutine->thread.status(), std::nullopt };
 	}
@@ -493,10 +670,12 @@ LuaThread::RunResult LuaThread::RunOnce()
 	{
 		CoroutineResult result = m_coroutine->RunCoroutine();
 		sol::thread_status status = result ? static_cast<sol::thread_status>(result->status()) : sol::thread_status::dead;
+		m_sliceEnd.reset();
 		DataTypeTemp.pop_buffer();
 		return std::make_pair(std::move(status), std::move(result));
 	}
 
+	m_sliceEnd.reset();
 	DataTypeTemp.pop_buffer();
 
 	if (!m_coroutine->thread.valid())
@@ -553,6 +732,21 @@ void LuaThread::SetAllowYield(bool allowYield, YieldDisabledReason reason)
 	}
 }
 
+// how many instructions run between clock checks when the thread has a time slice
+static constexpr int SLICE_CHECK_INSTRUCTIONS = 100;
+
+// same as lua_forceYield, but only once the time slice set by the scheduler has run out
+/*static*/ void LuaThread::lua_sliceYield(lua_State* L, lua_Debug* D)
+{
+	if (std::shared_ptr<LuaThread> thread_ptr = get_from(L))
+	{
+		if (thread_ptr->m_sliceEnd && std::chrono::steady_clock::now() < *thread_ptr->m_sliceEnd)
+			return;
+	}
+
+	lua_forceYield(L, D);
+}
+
 void LuaThread::YieldAt(int count) const
 {
 	if (m_allowYield)
@@ -561,6 +755,18 @@ void LuaThread::YieldAt(int count) const
 	}
 }
 
+void LuaThread::YieldAtSliceEnd() const
+{
+	if (!m_sliceEnd)
+	{
+		YieldAt(m_turboNum);
+	}
+	else if (m_allowYield)
+	{
+		lua_sethook(m_coroutine->thread.state(), &LuaThread::lua_sliceYield, LUA_MASKCOUNT, SLICE_CHECK_INSTRUCTIONS);
+	}
+}
+
 //============================================================================
 
 bool LuaThread::AddTopLevelObject(const char* name, MQTopLevelObjectFunction func)
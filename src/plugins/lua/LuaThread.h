@@ -61,6 +61,14 @@ enum class YieldDisabledReason
 	Require,
 };
 
+// Memory held by a script's lua state, as counted by the allocator in front of the state's own.
+struct LuaMemoryStats
+{
+	size_t bytes = 0;
+	size_t peakBytes = 0;
+	uint64_t allocations = 0;
+};
+
 struct LuaThreadInfo
 {
 	uint32_t pid;
@@ -72,6 +80,8 @@ struct LuaThreadInfo
 	std::vector<std::string> returnValues;
 	LuaThreadStatus status;
 	bool isString;
+	LuaMemoryStats memory; // as of the end of the run, ask the thread while it is running
+	std::chrono::microseconds gcTime{ 0 }; // same
 
 	std::string_view status_string() const
 	{
@@ -128,6 +138,35 @@ public:
 
 	void InjectMQNamespace();
 	void SetTurbo(uint32_t turboVal) { m_turboNum = turboVal; }
+
+	// Limits in bytes, 0 for none. Crossing the soft limit raises a warning that is picked up with
+	// TakeMemoryWarning. An allocation that would cross the hard limit fails, which the script sees
+	// as a "not enough memory" error.
+	void SetMemoryLimits(size_t softLimit, size_t hardLimit);
+	const LuaMemoryStats& GetMemoryStats() const { return m_memory.stats; }
+	bool TakeMemoryWarning() { return std::exchange(m_memory.warn, false); }
+
+	// When the plugin has a frame budget, the scheduler gives each run a slice that ends at this
+	// time instead of yielding after m_turboNum instructions. It only applies to the next run.
+	void SetTimeSlice(std::chrono::steady_clock::time_point sliceEnd) { m_sliceEnd = sliceEnd; }
+
+	// Share of the frame budget relative to other scripts, and the order it is handed out in.
+	void SetScheduling(uint32_t weight, int priority) { m_weight = std::max(weight, 1U); m_priority = priority; }
+	uint32_t GetWeight() const { return m_weight; }
+	int GetPriority() const { return m_priority; }
+
+	// With a frame budget the collector doesn't run on its own inside whatever the script is doing.
+	// The scheduler calls StepGC with what is left of the frame instead, and the script's GC pause
+	// and step multiplier (in percent, like collectgarbage) decide when a cycle starts and how much
+	// each step does.
+	void SetManagedGC(bool managed);
+	void SetGCTuning(int pause, int stepMul);
+	int GetGCPause() const { return m_gcPause; }
+	int GetGCStepMul() const { return m_gcStepMul; }
+	bool NeedsGC() const;
+	void StepGC(std::chrono::steady_clock::time_point deadline);
+	std::chrono::microseconds GetGCTime() const { return m_gcTime; }
+
 	void SetEvaluateResult(bool evaluate) { m_evaluateResult = evaluate; }
 	bool GetEvaluateResult() const { return m_evaluateResult; }
 
@@ -197,15 +236,33 @@ private:
 	void Initialize();
 
 	void YieldAt(int count) const;
+	void YieldAtSliceEnd() const;
 
 	int PackageLoader(const std::string& pkg, lua_State* L);
 
 	static int lua_PackageLoader(lua_State* L);
+	static int lua_CachedFileLoader(lua_State* L);
 	static void lua_forceYield(lua_State* L, lua_Debug* D);
+	static void lua_sliceYield(lua_State* L, lua_Debug* D);
+	static void* lua_TrackedAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+	struct MemoryTracker
+	{
+		lua_Alloc baseAlloc = nullptr;
+		void* baseUserData = nullptr;
+		LuaMemoryStats stats;
+		size_t softLimit = 0;
+		size_t hardLimit = 0;
+		bool overSoftLimit = false;
+		bool warn = false;
+	};
 
 private:
 	LuaEnvironmentSettings* m_luaEnvironmentSettings = nullptr;
 
+	// the state frees through the tracker when it closes, so this has to outlive m_globalState
+	MemoryTracker m_memory;
+
 	// this needs to be first in initialization order because other things depend on it
 	sol::state m_globalState;
 	std::shared_ptr<LuaCoroutine> m_coroutine;
@@ -217,6 +274,15 @@ private:
 	std::string m_path;
 	uint32_t m_pid = 0;
 	uint32_t m_turboNum = 500;
+	std::optional<std::chrono::steady_clock::time_point> m_sliceEnd;
+	uint32_t m_weight = 1;
+	int m_priority = 0;
+	bool m_gcManaged = false;
+	bool m_gcInCycle = false;
+	int m_gcPause = 200;
+	int m_gcStepMul = 200;
+	size_t m_gcEstimate = 0; // bytes live after the last finished cycle
+	std::chrono::microseconds m_gcTime{ 0 };
 	bool m_yieldToFrame = false;
 	bool m_isString = false;
 	bool m_paused = false;
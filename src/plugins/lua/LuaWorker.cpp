@@ -0,0 +1,475 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+
+#include "LuaWorker.h"
+#include "LuaActor.h"
+#include "LuaThread.h"
+#include "LuaCoroutine.h"
+
+#include "mq/Plugin.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace mq::lua {
+
+// how many instructions a worker runs between checks for being stopped
+static constexpr int WORKER_STOP_CHECK_INSTRUCTIONS = 10000;
+static constexpr unsigned int WORKER_POOL_MAX_THREADS = 4;
+
+// One call into a worker. The input and output are compact encoded so that neither side touches the
+// other's lua state. Everything but the flags is only read once done is set.
+struct LuaWorkerJob
+{
+	std::string input;
+	std::string output;
+	std::string error;
+	std::atomic<bool> done = false;
+	std::atomic<bool> cancelled = false;
+
+	void Fail(std::string message)
+	{
+		error = std::move(message);
+		done = true;
+	}
+};
+using LuaWorkerJobPtr = std::shared_ptr<LuaWorkerJob>;
+
+//============================================================================
+
+// The background side of a worker: its lua state and the jobs waiting for it. The state is created
+// and only ever used on the pool, by one pool thread at a time.
+class LuaWorkerState : public std::enable_shared_from_this<LuaWorkerState>
+{
+public:
+	LuaWorkerState(std::string name, std::string source)
+		: m_name(std::move(name)), m_source(std::move(source)) {}
+
+	const std::string& GetName() const { return m_name; }
+	bool IsStopped() const { return m_stopped; }
+
+	size_t GetPending() const
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_jobs.size();
+	}
+
+	void Post(const LuaWorkerJobPtr& job);
+	void Stop();
+
+	// Called on the pool. Runs the next job and returns true if there are more waiting.
+	bool RunNext();
+
+private:
+	bool Initialize();
+	void RunJob(LuaWorkerJob& job);
+
+	static void lua_checkStopped(lua_State* L, lua_Debug* D);
+
+	std::string m_name;
+	std::string m_source;
+	std::unique_ptr<sol::state> m_state;
+	sol::protected_function m_handler;
+	std::string m_initError;
+	std::atomic<bool> m_stopped = false;
+
+	mutable std::mutex m_mutex;
+	std::deque<LuaWorkerJobPtr> m_jobs;
+	bool m_scheduled = false;                 // queued on or running on the pool
+};
+
+// the worker that the current pool thread is running
+static thread_local LuaWorkerState* s_currentWorker = nullptr;
+
+//============================================================================
+
+class LuaWorkerPool
+{
+public:
+	void Schedule(std::shared_ptr<LuaWorkerState> worker)
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			if (m_threads.empty())
+			{
+				const unsigned int count = std::clamp(std::thread::hardware_concurrency() / 2, 1U, WORKER_POOL_MAX_THREADS);
+				for (unsigned int i = 0; i < count; ++i)
+					m_threads.emplace_back([this]() { Run(); });
+			}
+
+			m_ready.push_back(std::move(worker));
+		}
+
+		m_cv.notify_one();
+	}
+
+	void Stop()
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			m_stopping = true;
+		}
+
+		m_cv.notify_all();
+
+		for (std::thread& thread : m_threads)
+			thread.join();
+
+		m_threads.clear();
+		m_ready.clear();
+		m_stopping = false;
+	}
+
+private:
+	void Run()
+	{
+		while (true)
+		{
+			std::shared_ptr<LuaWorkerState> worker;
+
+			{
+				std::unique_lock lock(m_mutex);
+				m_cv.wait(lock, [this]() { return m_stopping || !m_ready.empty(); });
+				if (m_stopping)
+					return;
+
+				worker = std::move(m_ready.front());
+				m_ready.pop_front();
+			}
+
+			// one job at a time, so that a busy worker doesn't hold up the others
+			if (worker->RunNext())
+				Schedule(std::move(worker));
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::shared_ptr<LuaWorkerState>> m_ready;
+	std::vector<std::thread> m_threads;
+	bool m_stopping = false;
+};
+
+static LuaWorkerPool s_pool;
+
+// every worker that has been started, so that they can all be stopped with the plugin
+static std::vector<std::weak_ptr<LuaWorkerState>> s_workers;
+
+//============================================================================
+
+void LuaWorkerState::Post(const LuaWorkerJobPtr& job)
+{
+	bool schedule = false;
+
+	{
+		std::scoped_lock lock(m_mutex);
+		if (m_stopped)
+		{
+			job->Fail("worker has been stopped");
+			return;
+		}
+
+		m_jobs.push_back(job);
+		schedule = !std::exchange(m_scheduled, true);
+	}
+
+	if (schedule)
+		s_pool.Schedule(shared_from_this());
+}
+
+void LuaWorkerState::Stop()
+{
+	std::scoped_lock lock(m_mutex);
+	m_stopped = true;
+
+	for (const LuaWorkerJobPtr& job : m_jobs)
+		job->Fail("worker has been stopped");
+	m_jobs.clear();
+}
+
+bool LuaWorkerState::RunNext()
+{
+	LuaWorkerJobPtr job;
+
+	{
+		std::scoped_lock lock(m_mutex);
+		if (m_jobs.empty())
+		{
+			m_scheduled = false;
+			return false;
+		}
+
+		job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+	}
+
+	if (job->cancelled)
+	{
+		job->Fail("cancelled");
+	}
+	else
+	{
+		s_currentWorker = this;
+		RunJob(*job);
+		s_currentWorker = nullptr;
+	}
+
+	std::scoped_lock lock(m_mutex);
+	if (m_jobs.empty())
+	{
+		m_scheduled = false;
+		return false;
+	}
+
+	return true;
+}
+
+bool LuaWorkerState::Initialize()
+{
+	m_state = std::make_unique<sol::state>();
+
+	// Only the libraries that don't reach outside of the state. There is no mq, no package loading
+	// and no file access, and print is gone because it would write to chat from the wrong thread.
+	m_state->open_libraries(sol::lib::base, sol::lib::string, sol::lib::table, sol::lib::math, sol::lib::bit32, sol::lib::os);
+
+	sol::table os = m_state->get<sol::table>("os");
+	(*m_state)["os"] = m_state->create_table_with(
+		"clock", os["clock"],
+		"date", os["date"],
+		"difftime", os["difftime"],
+		"time", os["time"]);
+	(*m_state)["dofile"] = sol::lua_nil;
+	(*m_state)["loadfile"] = sol::lua_nil;
+	(*m_state)["print"] = sol::lua_nil;
+
+	lua_sethook(m_state->lua_state(), &LuaWorkerState::lua_checkStopped, LUA_MASKCOUNT, WORKER_STOP_CHECK_INSTRUCTIONS);
+
+	sol::protected_function_result result = m_state->safe_script(m_source, sol::script_pass_on_error, "@" + m_name);
+	if (!result.valid())
+	{
+		sol::error err = result;
+		m_initError = err.what();
+		return false;
+	}
+
+	sol::object handler = result;
+	if (handler.get_type() != sol::type::function)
+	{
+		m_initError = fmt::format("worker script '{}' must return a function to handle calls", m_name);
+		return false;
+	}
+
+	m_handler = handler.as<sol::protected_function>();
+	return true;
+}
+
+void LuaWorkerState::RunJob(LuaWorkerJob& job)
+{
+	if (!m_state)
+		Initialize();
+
+	if (!m_initError.empty())
+	{
+		job.Fail(m_initError);
+		return;
+	}
+
+	sol::protected_function_result result = m_handler(DeserializeCompact(job.input, *m_state));
+	if (!result.valid())
+	{
+		sol::error err = result;
+		job.Fail(err.what());
+		return;
+	}
+
+	job.output = SerializeCompact(result.return_count() > 0 ? result.get<sol::object>() : sol::object(sol::lua_nil));
+	job.done = true;
+}
+
+/*static*/ void LuaWorkerState::lua_checkStopped(lua_State* L, lua_Debug* D)
+{
+	if (s_currentWorker != nullptr && s_currentWorker->m_stopped)
+	{
+		luaL_error(L, "worker has been stopped");
+	}
+}
+
+//============================================================================
+
+/**
+ * The result of a worker call. A script either checks on it each frame or waits for it with
+ * result:wait(), which suspends the script's coroutine until the worker is done.
+ */
+struct LuaWorkerResult
+{
+	LuaWorkerJobPtr job;
+
+	bool Ready() const { return job->done; }
+
+	sol::object Result(sol::this_state s) const
+	{
+		if (job->done && job->error.empty())
+			return DeserializeCompact(job->output, s);
+
+		return sol::lua_nil;
+	}
+
+	sol::object Error(sol::this_state s) const
+	{
+		if (job->done && !job->error.empty())
+			return sol::make_object(s, job->error);
+
+		return sol::lua_nil;
+	}
+
+	void Cancel() { job->cancelled = true; }
+
+	void Wait(sol::this_state s) const
+	{
+		if (job->done)
+			return;
+
+		auto thread = LuaThread::get_from(s);
+		if (thread == nullptr || !thread->GetAllowYield())
+		{
+			luaL_error(s, "Cannot wait for a worker from a non-yieldable thread");
+			return;
+		}
+
+		if (auto co = thread->GetCurrentCoroutine())
+			co->Await([job = job]() { return job->done.load(); });
+	}
+};
+
+// The script's handle to a worker. The worker is stopped when the handle is collected, which
+// includes when the script that started it ends.
+class LuaWorker
+{
+public:
+	explicit LuaWorker(std::shared_ptr<LuaWorkerState> state) : m_state(std::move(state)) {}
+	~LuaWorker() { m_state->Stop(); }
+
+	LuaWorker(const LuaWorker&) = delete;
+	LuaWorker& operator=(const LuaWorker&) = delete;
+
+	static std::shared_ptr<LuaWorker> Start(std::string_view script, sol::this_state s);
+	static std::shared_ptr<LuaWorker> StartString(std::string_view source, std::optional<std::string> name);
+
+	LuaWorkerResult Call(sol::object payload)
+	{
+		auto job = std::make_shared<LuaWorkerJob>();
+		job->input = SerializeCompact(payload);
+
+		m_state->Post(job);
+		return LuaWorkerResult{ std::move(job) };
+	}
+
+	void Stop() { m_state->Stop(); }
+	bool IsStopped() const { return m_state->IsStopped(); }
+	size_t GetPending() const { return m_state->GetPending(); }
+	const std::string& GetName() const { return m_state->GetName(); }
+
+private:
+	static std::shared_ptr<LuaWorker> Create(std::string name, std::string source)
+	{
+		auto state = std::make_shared<LuaWorkerState>(std::move(name), std::move(source));
+
+		s_workers.erase(std::remove_if(s_workers.begin(), s_workers.end(),
+			[](const std::weak_ptr<LuaWorkerState>& worker) { return worker.expired(); }), s_workers.end());
+		s_workers.push_back(state);
+
+		return std::make_shared<LuaWorker>(std::move(state));
+	}
+
+	std::shared_ptr<LuaWorkerState> m_state;
+};
+
+std::shared_ptr<LuaWorker> LuaWorker::Start(std::string_view script, sol::this_state s)
+{
+	auto thread = LuaThread::get_from(s);
+	if (thread == nullptr)
+		return nullptr;
+
+	std::string script_path = LuaThread::GetScriptPath(script, thread->GetLuaDir());
+	std::ifstream file(script_path);
+	if (script_path.empty() || !file)
+	{
+		luaL_error(s, "Could not find worker script '%.*s'", static_cast<int>(script.size()), script.data());
+		return nullptr;
+	}
+
+	std::stringstream source;
+	source << file.rdbuf();
+
+	return Create(LuaThread::GetCanonicalScriptName(script_path, thread->GetLuaDir()), source.str());
+}
+
+std::shared_ptr<LuaWorker> LuaWorker::StartString(std::string_view source, std::optional<std::string> name)
+{
+	return Create(name.value_or("worker"), std::string(source));
+}
+
+//============================================================================
+
+sol::table LuaWorkers::RegisterLua(sol::state_view s)
+{
+	sol::table workers = s.create_table();
+
+	workers.new_usertype<LuaWorker>(
+		"worker", sol::no_constructor,
+		"call", &LuaWorker::Call,
+		"stop", &LuaWorker::Stop,
+		"stopped", sol::property(&LuaWorker::IsStopped),
+		"pending", sol::property(&LuaWorker::GetPending),
+		"name", sol::property(&LuaWorker::GetName));
+
+	workers.new_usertype<LuaWorkerResult>(
+		"result", sol::no_constructor,
+		"ready", sol::property(&LuaWorkerResult::Ready),
+		"result", sol::property(&LuaWorkerResult::Result),
+		"error", sol::property(&LuaWorkerResult::Error),
+		"cancel", &LuaWorkerResult::Cancel,
+		"wait", &LuaWorkerResult::Wait);
+
+	workers.set_function("start", &LuaWorker::Start);
+	workers.set_function("start_string", &LuaWorker::StartString);
+
+	return workers;
+}
+
+void LuaWorkers::Start()
+{
+}
+
+void LuaWorkers::Stop()
+{
+	for (const std::weak_ptr<LuaWorkerState>& worker : s_workers)
+	{
+		if (auto ptr = worker.lock())
+			ptr->Stop();
+	}
+
+	s_workers.clear();
+	s_pool.Stop();
+}
+
+} // namespace mq::lua
@@ -0,0 +1,32 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "LuaCommon.h"
+
+namespace mq::lua {
+
+// Worker states are separate lua states that run on a small pool of background threads, for pure
+// computation that would otherwise stall the frame. They have no access to mq, TLOs or anything
+// else of the game's; values go in and come out through the compact actor encoding.
+class LuaWorkers
+{
+public:
+	static sol::table RegisterLua(sol::state_view s);
+	static void Start();
+	static void Stop();
+};
+
+} // namespace mq::lua
@@ -18,7 +18,11 @@
 #include "LuaCommon.h"
 #include "LuaThread.h"
 #include "LuaEvent.h"
+#include "LuaEventWait.h"
 #include "LuaActor.h"
+#include "LuaBytecodeCache.h"
+#include "LuaPathCache.h"
+#include "LuaWorker.h"
 #include "LuaImGui.h"
 #include "bindings/lua_Bindings.h"
 #include "imgui/ImGuiUtils.h"
@@ -51,6 +55,9 @@ namespace mq::lua {
 
 // provide option strings here
 static const std::string KEY_TURBO_NUM = "turboNum";
+static const std::string KEY_FRAME_BUDGET = "frameBudget";
+static const std::string KEY_MEMORY_SOFT_LIMIT = "memorySoftLimit";
+static const std::string KEY_MEMORY_HARD_LIMIT = "memoryHardLimit";
 static const std::string KEY_LUA_DIR = "luaDir";
 static const std::string KEY_MODULE_DIR = "moduleDir";
 static const std::string KEY_LUA_REQUIRE_PATHS = "luaRequirePaths";
@@ -58,9 +65,13 @@ static const std::string KEY_DLL_REQUIRE_PATHS = "dllRequirePaths";
 static const std::string KEY_INFO_GC = "infoGC";
 static const std::string KEY_SQUELCH_STATUS = "squelchStatus";
 static const std::string KEY_SHOW_MENU = "showMenu";
+static const std::string KEY_BYTECODE_CACHE = "bytecodeCache";
 
 // configurable options, defaults provided where needed
 static uint32_t s_turboNum = 500;
+static std::chrono::microseconds s_frameBudget = 0us; // 0 yields by instruction count (turbo) instead
+static uint32_t s_memorySoftLimit = 0; // MB per script, 0 for no limit
+static uint32_t s_memoryHardLimit = 0;
 static std::string s_luaDirName = "lua";
 static std::string s_moduleDirName = "modules";
 static LuaEnvironmentSettings s_environment;
@@ -79,6 +90,8 @@ static ImGuiFileDialog* s_luaDirDialog = nullptr;
 static ImGuiFileDialog* s_moduleDirDialog = nullptr;
 static imgui::TextEditor* s_luaCodeViewer = nullptr;
 
+static uint32_t bmLuaThreads = 0;
+
 // use a vector for s_running because we need to iterate it every pulse, and find only if a command is issued
 std::vector<std::shared_ptr<LuaThread>> s_running;
 std::vector<std::shared_ptr<LuaThread>> s_pending;
@@ -160,6 +173,24 @@ bool DoStatus()
 	return !s_squelchStatus;
 }
 
+static void ApplySettings(LuaThread& thread)
+{
+	thread.SetMemoryLimits(static_cast<size_t>(s_memorySoftLimit) << 20, static_cast<size_t>(s_memoryHardLimit) << 20);
+	thread.SetManagedGC(s_frameBudget > 0us);
+}
+
+static void CheckMemoryWarnings()
+{
+	for (const std::shared_ptr<LuaThread>& thread : s_running)
+	{
+		if (thread->TakeMemoryWarning())
+		{
+			WriteChatStatus("Lua script '%s' with PID %d is using %.1f MB, over the %u MB soft limit",
+				thread->GetName().c_str(), thread->GetPID(), thread->GetMemoryStats().bytes / 1048576.0, s_memorySoftLimit);
+		}
+	}
+}
+
 void EndScript(const std::shared_ptr<LuaThread>& thread, const LuaThread::RunResult& result,
 	bool announce)
 {
@@ -172,6 +203,9 @@ void EndScript(const std::shared_ptr<LuaThread>& thread, const LuaThread::RunRes
 	auto fin_it = s_infoMap.find(thread->GetPID());
 	if (fin_it != s_infoMap.end())
 	{
+		fin_it->second.memory = thread->GetMemoryStats();
+		fin_it->second.gcTime = thread->GetGCTime();
+
 		if (result.second)
 			fin_it->second.SetResult(*result.second, thread->GetEvaluateResult());
 		else
@@ -179,6 +213,72 @@ void EndScript(const std::shared_ptr<LuaThread>& thread, const LuaThread::RunRes
 	}
 }
 
+// Runs every thread once with a time slice out of s_frameBudget. Higher priority scripts run first,
+// and each gets the share of what is left of the budget that its weight makes up of the scripts that
+// haven't run yet, so time that a script doesn't use rolls over to the ones after it. A script whose
+// share comes to nothing still runs until its next clock check, so nothing is starved.
+//
+// Whatever is left of the budget afterwards goes to garbage collection, split evenly between the
+// scripts that are due for it, in the same order.
+static void RunScheduledThreads()
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<std::shared_ptr<LuaThread>> order = s_running;
+	std::stable_sort(order.begin(), order.end(),
+		[](const std::shared_ptr<LuaThread>& a, const std::shared_ptr<LuaThread>& b)
+		{
+			return a->GetPriority() > b->GetPriority();
+		});
+
+	uint64_t weightLeft = 0;
+	for (const std::shared_ptr<LuaThread>& thread : order)
+		weightLeft += thread->GetWeight();
+
+	const clock::time_point frameEnd = clock::now() + s_frameBudget;
+	std::vector<std::shared_ptr<LuaThread>> ended;
+
+	for (const std::shared_ptr<LuaThread>& thread : order)
+	{
+		const clock::time_point now = clock::now();
+		const clock::duration left = std::max(frameEnd - now, clock::duration::zero());
+
+		thread->SetTimeSlice(now + left * thread->GetWeight() / weightLeft);
+		weightLeft -= thread->GetWeight();
+
+		LuaThread::RunResult result = thread->Run();
+		if (result.first != sol::thread_status::yielded)
+		{
+			EndScript(thread, result, true);
+			ended.push_back(thread);
+		}
+	}
+
+	std::vector<LuaThread*> collecting;
+	for (const std::shared_ptr<LuaThread>& thread : order)
+	{
+		if (thread->NeedsGC() && std::find(ended.begin(), ended.end(), thread) == ended.end())
+			collecting.push_back(thread.get());
+	}
+
+	for (size_t i = 0; i < collecting.size(); ++i)
+	{
+		const clock::time_point now = clock::now();
+		const clock::duration left = std::max(frameEnd - now, clock::duration::zero());
+
+		collecting[i]->StepGC(now + left / (collecting.size() - i));
+	}
+
+	if (!ended.empty())
+	{
+		s_running.erase(std::remove_if(s_running.begin(), s_running.end(),
+			[&ended](const std::shared_ptr<LuaThread>& thread)
+			{
+				return std::find(ended.begin(), ended.end(), thread) != ended.end();
+			}), s_running.end());
+	}
+}
+
 std::shared_ptr<LuaThread> GetLuaThreadByPID(int pid)
 {
 	for (const auto& thread : s_running)
@@ -196,6 +296,23 @@ std::shared_ptr<LuaThread> GetLuaThreadByPID(int pid)
 	return nullptr;
 }
 
+// live while the script is running, as it was when it ended afterwards
+static LuaMemoryStats GetMemoryStats(const LuaThreadInfo& info)
+{
+	if (std::shared_ptr<LuaThread> thread = GetLuaThreadByPID(info.pid))
+		return thread->GetMemoryStats();
+
+	return info.memory;
+}
+
+static std::chrono::microseconds GetGCTime(const LuaThreadInfo& info)
+{
+	if (std::shared_ptr<LuaThread> thread = GetLuaThreadByPID(info.pid))
+		return thread->GetGCTime();
+
+	return info.gcTime;
+}
+
 void OnLuaThreadDestroyed(LuaThread* destroyedThread)
 {
 	s_running.erase(std::remove_if(s_running.begin(), s_running.end(),
@@ -267,7 +384,11 @@ public:
 		EndTime,
 		ReturnCount,
 		Return,
-		Status
+		Status,
+		Memory,
+		PeakMemory,
+		Allocations,
+		GCTime,
 	};
 
 	MQ2LuaInfoType() : MQ2Type("luainfo")
@@ -281,6 +402,10 @@ public:
 		ScopedTypeMember(Members, ReturnCount);
 		ScopedTypeMember(Members, Return);
 		ScopedTypeMember(Members, Status);
+		ScopedTypeMember(Members, Memory);
+		ScopedTypeMember(Members, PeakMemory);
+		ScopedTypeMember(Members, Allocations);
+		ScopedTypeMember(Members, GCTime);
 	};
 
 	virtual bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override
@@ -371,6 +496,26 @@ public:
 			Dest.Ptr = &DataTypeTemp[0];
 			return true;
 
+		case Members::Memory:
+			Dest.Type = pInt64Type;
+			Dest.Set(static_cast<int64_t>(GetMemoryStats(*info).bytes));
+			return true;
+
+		case Members::PeakMemory:
+			Dest.Type = pInt64Type;
+			Dest.Set(static_cast<int64_t>(GetMemoryStats(*info).peakBytes));
+			return true;
+
+		case Members::Allocations:
+			Dest.Type = pInt64Type;
+			Dest.Set(static_cast<int64_t>(GetMemoryStats(*info).allocations));
+			return true;
+
+		case Members::GCTime:
+			Dest.Type = pInt64Type;
+			Dest.Set(static_cast<int64_t>(GetGCTime(*info).count()));
+			return true;
+
 		default:
 			return false;
 		}
@@ -584,6 +729,7 @@ static uint32_t LuaRunCommand(const std::string& script, const std::vector<std::
 
 	std::shared_ptr<LuaThread> entry = LuaThread::Create(&s_environment);
 	entry->SetTurbo(s_turboNum);
+	ApplySettings(*entry);
 	entry->EnableEvents();
 	entry->EnableImGui();
 	s_pending.push_back(entry);
@@ -625,6 +771,7 @@ static uint32_t LuaParseCommand(const std::string& script, std::string_view name
 	// Create LuaThread with mq namespace already injected.
 	std::shared_ptr<LuaThread> entry = LuaThread::Create(&s_environment);
 	entry->SetTurbo(s_turboNum);
+	ApplySettings(*entry);
 	entry->InjectMQNamespace();
 	if (name == "lua parse")
 	{
@@ -870,6 +1017,18 @@ static void ReadSettings()
 		}
 	}
 
+	bool budgetChanged = mq::test_and_set(s_frameBudget, std::chrono::microseconds(s_configNode[KEY_FRAME_BUDGET].as<uint32_t>(
+		static_cast<uint32_t>(s_frameBudget.count()))));
+	bool softChanged = mq::test_and_set(s_memorySoftLimit, s_configNode[KEY_MEMORY_SOFT_LIMIT].as<uint32_t>(s_memorySoftLimit));
+	bool hardChanged = mq::test_and_set(s_memoryHardLimit, s_configNode[KEY_MEMORY_HARD_LIMIT].as<uint32_t>(s_memoryHardLimit));
+	if (budgetChanged || softChanged || hardChanged)
+	{
+		for (const std::shared_ptr<LuaThread>& thread : s_running)
+		{
+			ApplySettings(*thread);
+		}
+	}
+
 	s_verboseErrors = s_configNode["verboseErrors"].as<bool>(false);
 
 	std::string tempDirName = s_luaDirName;
@@ -940,6 +1099,7 @@ static void ReadSettings()
 
 	s_squelchStatus = s_configNode[KEY_SQUELCH_STATUS].as<bool>(s_squelchStatus);
 	s_showMenu = s_configNode[KEY_SHOW_MENU].as<bool>(s_showMenu);
+	s_environment.bytecodeCache = s_configNode[KEY_BYTECODE_CACHE].as<bool>(s_environment.bytecodeCache);
 }
 
 static void LuaConfCommand(const std::string& setting, const std::string& value)
@@ -1045,11 +1205,13 @@ static void LuaInfoCommand(const std::optional<std::string>& script = std::nullo
 		if (thread_it != s_infoMap.end())
 		{
 			const LuaThreadInfo& info = thread_it->second;
+			const LuaMemoryStats memory = GetMemoryStats(info);
 
 			fmt::memory_buffer line;
 			fmt::format_to(
 				fmt::appender(line),
-				"pid: {}\nname: {}\npath: {}\narguments: {}\nstartTime: {}\nendTime: {}\nreturnValues: {}\nstatus: {}",
+				"pid: {}\nname: {}\npath: {}\narguments: {}\nstartTime: {}\nendTime: {}\nreturnValues: {}\nstatus: {}\n"
+				"memory: {:.1f} KB (peak {:.1f} KB, {} allocations)\ngcTime: {:.2f} ms",
 				info.pid,
 				info.name,
 				info.path,
@@ -1057,7 +1219,11 @@ static void LuaInfoCommand(const std::optional<std::string>& script = std::nullo
 				info.startTime,
 				info.endTime,
 				join(info.returnValues, ", "),
-				static_cast<int>(info.status));
+				static_cast<int>(info.status),
+				memory.bytes / 1024.0,
+				memory.peakBytes / 1024.0,
+				memory.allocations,
+				GetGCTime(info).count() / 1000.0);
 
 			WriteChatStatus("%.*s", line.size(), line.data());
 		}
@@ -1298,6 +1464,7 @@ public:
 	{
 		LuaScriptPtr entry = LuaThread::Create(&s_environment);
 		entry->SetTurbo(s_turboNum);
+		ApplySettings(*entry);
 		s_pending.push_back(entry);
 
 		return entry;
@@ -1398,6 +1565,16 @@ static void DrawLuaSettings()
 		s_configNode["verboseErrors"] = s_verboseErrors;
 	}
 
+	if (ImGui::Checkbox("Cache Compiled Scripts", &s_environment.bytecodeCache))
+	{
+		s_configNode[KEY_BYTECODE_CACHE] = s_environment.bytecodeCache;
+	}
+	ImGui::SameLine();
+	if (ImGui::SmallButton("Clear Cache"))
+	{
+		WriteChatStatus("Removed %d cached lua chunks", static_cast<int>(ClearBytecodeCache()));
+	}
+
 	ImGui::NewLine();
 
 	ImGui::Text("Turbo Num:");
@@ -1409,6 +1586,49 @@ static void DrawLuaSettings()
 		s_configNode[KEY_TURBO_NUM] = s_turboNum;
 	}
 
+	ImGui::Text("Frame Budget:");
+	uint32_t budget_selected = static_cast<uint32_t>(s_frameBudget.count()), budget_min = 0U, budget_max = 10000U;
+	ImGui::SetNextItemWidth(-1.0f);
+	if (ImGui::SliderScalar("##frameBudgetslider", ImGuiDataType_U32, &budget_selected, &budget_min, &budget_max,
+		budget_selected == 0 ? "Off (use Turbo Num)" : "%u us of Lua per Frame", ImGuiSliderFlags_None))
+	{
+		s_frameBudget = std::chrono::microseconds(budget_selected);
+		s_configNode[KEY_FRAME_BUDGET] = budget_selected;
+
+		for (const std::shared_ptr<LuaThread>& thread : s_running)
+		{
+			ApplySettings(*thread);
+		}
+	}
+	ImGui::SameLine();
+	mq::imgui::HelpMarker("Shares this much time each frame between all running scripts, by their weight and priority "
+		"(see mq.schedule). Time that a script doesn't use is handed to the scripts after it, and what is left "
+		"at the end goes to garbage collection (see mq.gctune).");
+
+	ImGui::Text("Memory Limits:");
+	uint32_t soft_selected = s_memorySoftLimit, hard_selected = s_memoryHardLimit, memory_min = 0U, memory_max = 2048U;
+	ImGui::SetNextItemWidth(-1.0f);
+	bool memoryChanged = ImGui::SliderScalar("##memorySoftLimitslider", ImGuiDataType_U32, &soft_selected, &memory_min, &memory_max,
+		soft_selected == 0 ? "No Warning" : "Warn at %u MB", ImGuiSliderFlags_None);
+	ImGui::SetNextItemWidth(-1.0f);
+	memoryChanged |= ImGui::SliderScalar("##memoryHardLimitslider", ImGuiDataType_U32, &hard_selected, &memory_min, &memory_max,
+		hard_selected == 0 ? "No Limit" : "Fail allocations over %u MB", ImGuiSliderFlags_None);
+	if (memoryChanged)
+	{
+		s_memorySoftLimit = soft_selected;
+		s_memoryHardLimit = hard_selected;
+		s_configNode[KEY_MEMORY_SOFT_LIMIT] = s_memorySoftLimit;
+		s_configNode[KEY_MEMORY_HARD_LIMIT] = s_memoryHardLimit;
+
+		for (const std::shared_ptr<LuaThread>& thread : s_running)
+		{
+			ApplySettings(*thread);
+		}
+	}
+	ImGui::SameLine();
+	mq::imgui::HelpMarker("Per script. A script going over the first limit is reported each time it crosses it. "
+		"Allocations that would take a script over the second limit fail with a not enough memory error.");
+
 
 	ImGui::Text("Lua Directory:");
 	auto dirDisplay = s_configNode[KEY_LUA_DIR].as<std::string>(s_luaDirName);
@@ -1681,13 +1901,18 @@ PLUGIN_API void InitializePlugin()
 	bindings::InitializeBindings_MQMacroData();
 
 	LuaActors::Start();
+	LuaWorkers::Start();
+
+	bmLuaThreads = AddMQ2Benchmark("Lua_Threads");
 }
 
 PLUGIN_API void ShutdownPlugin()
 {
 	using namespace mq::lua;
 
+	LuaWorkers::Stop();
 	LuaActors::Stop();
+	ShutdownPathCache();
 
 	bindings::ShutdownBindings_MQMacroData();
 
@@ -1706,6 +1931,8 @@ PLUGIN_API void ShutdownPlugin()
 
 	delete s_pluginInterface;
 	s_pluginInterface = nullptr;
+
+	RemoveMQ2Benchmark(bmLuaThreads);
 }
 
 PLUGIN_API void OnPulse()
@@ -1718,19 +1945,35 @@ PLUGIN_API void OnPulse()
 		s_pending.clear();
 	}
 
-	s_running.erase(std::remove_if(s_running.begin(), s_running.end(),
-		[](const std::shared_ptr<LuaThread>& thread) -> bool
+	// before the threads run, so that anything waiting on a change this frame resumes this frame
+	LuaEventWaits::Pulse();
+
+	{
+		MQScopedBenchmark bm(bmLuaThreads);
+
+		if (s_frameBudget > 0us)
+		{
+			RunScheduledThreads();
+		}
+		else
 		{
-			LuaThread::RunResult result = thread->Run();
+			s_running.erase(std::remove_if(s_running.begin(), s_running.end(),
+				[](const std::shared_ptr<LuaThread>& thread) -> bool
+				{
+					LuaThread::RunResult result = thread->Run();
 
-			if (result.first != sol::thread_status::yielded)
-			{
-				EndScript(thread, result, true);
-				return true;
-			}
+					if (result.first != sol::thread_status::yielded)
+					{
+						EndScript(thread, result, true);
+						return true;
+					}
 
-			return false;
-		}), s_running.end());
+					return false;
+				}), s_running.end());
+		}
+	}
+
+	CheckMemoryWarnings();
 
 	// Process messages after any threads have ended or started (the order likely won't matter since cleanup is checked)
 	LuaActors::Process();
@@ -1882,6 +2125,16 @@ PLUGIN_API void OnUpdateImGui()
 			std::string_view status = info.status_string();
 			ImGui::LabelText("Status", "%.*s", status.size(), status.data());
 
+			if (std::shared_ptr<LuaThread> thread = GetLuaThreadByPID(info.pid))
+			{
+				if (LuaImGuiProcessor* imgui = thread->GetImGuiProcessor())
+					ImGui::LabelText("ImGui Time", "%.2f ms per frame", imgui->GetFrameTime().count() / 1000.0f);
+
+				const LuaMemoryStats& memory = thread->GetMemoryStats();
+				ImGui::LabelText("Memory", "%.1f KB (peak %.1f KB)", memory.bytes / 1024.0, memory.peakBytes / 1024.0);
+				ImGui::LabelText("GC Time", "%.2f ms", thread->GetGCTime().count() / 1000.0);
+			}
+
 			if (!info.returnValues.empty())
 			{
 				ImGui::LabelText("Return Values", "%s", join(info.returnValues, ", ").c_str());
@@ -2033,30 +2286,34 @@ PLUGIN_API void OnUpdateImGui()
 
 PLUGIN_API void OnWriteChatColor(const char* Line, int Color, int Filter)
 {
-	for (const std::shared_ptr<mq::lua::LuaThread>& thread : mq::lua::s_running)
-	{
-		if (thread && !thread->IsPaused())
-		{
-			if (lua::LuaEventProcessor* events = thread->GetEventProcessor())
-				events->Process(Line);
-		}
-	}
+	mq::lua::LuaEventProcessor::ProcessLine(Line);
+	mq::lua::LuaEventWaits::Signal(mq::lua::LuaWaitEvent::Chat, 0, Line);
 }
 
 PLUGIN_API bool OnIncomingChat(const char* Line, DWORD Color)
 {
-	for (const std::shared_ptr<mq::lua::LuaThread>& thread : mq::lua::s_running)
-	{
-		if (thread && !thread->IsPaused())
-		{
-			if (lua::LuaEventProcessor* events = thread->GetEventProcessor())
-				events->Process(Line);
-		}
-	}
+	mq::lua::LuaEventProcessor::ProcessLine(Line);
+	mq::lua::LuaEventWaits::Signal(mq::lua::LuaWaitEvent::Chat, 0, Line);
 
 	return false;
 }
 
+PLUGIN_API void OnAddSpawn(SPAWNINFO* pNewSpawn)
+{
+	mq::lua::LuaEventWaits::Signal(mq::lua::LuaWaitEvent::SpawnAdded, pNewSpawn->SpawnID, pNewSpawn->Name);
+}
+
+PLUGIN_API void OnRemoveSpawn(SPAWNINFO* pSpawn)
+{
+	mq::lua::LuaEventWaits::Signal(mq::lua::LuaWaitEvent::SpawnRemoved, pSpawn->SpawnID, pSpawn->Name);
+}
+
+PLUGIN_API void OnZoned()
+{
+	mq::lua::LuaEventWaits::Signal(mq::lua::LuaWaitEvent::Zoned, pLocalPC ? pLocalPC->zoneId : 0,
+		pZoneInfo ? pZoneInfo->ShortName : "");
+}
+
 PLUGIN_API PluginInterface* GetPluginInterface()
 {
 	return mq::lua::s_pluginInterface;
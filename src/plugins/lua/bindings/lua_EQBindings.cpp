@@ -21,6 +21,8 @@
 #include "LuaImGui.h"
 #include "LuaThread.h"
 
+#include <mq/api/Inventory.h>
+
 namespace mq::lua::bindings {
 
 //============================================================================
@@ -40,6 +42,45 @@ static std::unique_ptr<CTextureAnimation> FindTextureAnimation(std::string_view
 
 //============================================================================
 
+// 1-based, like lua arrays. Out of range gives nil.
+static const MQSpawnSnapshot* lua_snapshotSpawn(const MQSpawnSnapshot* spawns, int count, int index)
+{
+	if (index < 1 || index > count)
+		return nullptr;
+
+	return &spawns[index - 1];
+}
+
+static const MQBuffSnapshot* lua_snapshotBuff(const MQGameSnapshot& snapshot, int slot)
+{
+	if (slot < 1 || slot > MAX_SNAPSHOT_BUFFS || snapshot.Buffs[slot - 1].SpellID <= 0)
+		return nullptr;
+
+	return &snapshot.Buffs[slot - 1];
+}
+
+static std::optional<MQInventoryItemSnapshot> lua_inventorySnapshotItem(const MQInventorySnapshot& snapshot, int index)
+{
+	if (index < 1 || index > static_cast<int>(snapshot.Items.size()))
+		return std::nullopt;
+
+	return snapshot.Items[index - 1];
+}
+
+static const MQInventorySnapshot* lua_inventorySnapshot(std::optional<std::string_view> source)
+{
+	if (!source || ci_equals(*source, "inventory"))
+		return &GetInventorySnapshot(InventorySnapshotSource::Inventory);
+	if (ci_equals(*source, "bank"))
+		return &GetInventorySnapshot(InventorySnapshotSource::Bank);
+	if (ci_equals(*source, "keyring"))
+		return &GetInventorySnapshot(InventorySnapshotSource::KeyRings);
+
+	return nullptr;
+}
+
+//============================================================================
+
 #pragma region MQ Data Bindings
 
 static sol::table lua_getAllSpawns(sol::this_state L)
@@ -82,6 +123,19 @@ static sol::table lua_getFilteredSpawns(sol::this_state L, std::optional<sol::fu
 	return table;
 }
 
+static sol::table lua_getNearestSpawns(sol::this_state L, int count, std::optional<std::string_view> search)
+{
+	auto table = sol::state_view(L).create_table();
+
+	for (PlayerClient* spawn : GetNearestSpawns(search.value_or(""), count))
+	{
+		auto lua_spawn = lua_MQTypeVar(datatypes::pSpawnType->MakeTypeVar(spawn));
+		table.add(std::move(lua_spawn));
+	}
+
+	return table;
+}
+
 static sol::table lua_getAllGroundItems(sol::this_state L)
 {
 	auto table = sol::state_view(L).create_table();
@@ -159,8 +213,93 @@ void RegisterBindings_EQ(LuaThread* thread, sol::table& mq)
 	// Direct Data Bindings
 	mq.set_function("getAllSpawns", &lua_getAllSpawns);
 	mq.set_function("getFilteredSpawns", &lua_getFilteredSpawns);
+	mq.set_function("getNearestSpawns", &lua_getNearestSpawns);
 	mq.set_function("getAllGroundItems", &lua_getAllGroundItems);
 	mq.set_function("getFilteredGroundItems", &lua_getFilteredGroundItems);
+
+	//----------------------------------------------------------------------------
+	// Game State Snapshot
+
+	mq.new_usertype<MQSpawnSnapshot>(
+		"spawnsnapshot", sol::no_constructor,
+		"Valid", sol::readonly(&MQSpawnSnapshot::Valid),
+		"Dead", sol::readonly(&MQSpawnSnapshot::Dead),
+		"SpawnID", sol::readonly(&MQSpawnSnapshot::SpawnID),
+		"Name", sol::property([](const MQSpawnSnapshot& mThis) { return std::string_view(mThis.Name); }),
+		"Level", sol::readonly(&MQSpawnSnapshot::Level),
+		"Class", sol::readonly(&MQSpawnSnapshot::Class),
+		"Type", sol::readonly(&MQSpawnSnapshot::Type),
+		"X", sol::readonly(&MQSpawnSnapshot::X),
+		"Y", sol::readonly(&MQSpawnSnapshot::Y),
+		"Z", sol::readonly(&MQSpawnSnapshot::Z),
+		"Heading", sol::readonly(&MQSpawnSnapshot::Heading),
+		"Distance", sol::readonly(&MQSpawnSnapshot::Distance),
+		"PctHPs", sol::readonly(&MQSpawnSnapshot::PctHPs),
+		"PctMana", sol::readonly(&MQSpawnSnapshot::PctMana),
+		"PctEndurance", sol::readonly(&MQSpawnSnapshot::PctEndurance)
+	);
+
+	mq.new_usertype<MQBuffSnapshot>(
+		"buffsnapshot", sol::no_constructor,
+		"SpellID", sol::readonly(&MQBuffSnapshot::SpellID),
+		"Duration", sol::readonly(&MQBuffSnapshot::Duration)
+	);
+
+	mq.new_usertype<MQGameSnapshot>(
+		"gamesnapshot", sol::no_constructor,
+		"Frame", sol::readonly(&MQGameSnapshot::Frame),
+		"InGame", sol::readonly(&MQGameSnapshot::InGame),
+		"Self", sol::property([](const MQGameSnapshot& mThis) { return &mThis.Self; }),
+		"CurrentHPs", sol::readonly(&MQGameSnapshot::CurrentHPs),
+		"MaxHPs", sol::readonly(&MQGameSnapshot::MaxHPs),
+		"CurrentMana", sol::readonly(&MQGameSnapshot::CurrentMana),
+		"MaxMana", sol::readonly(&MQGameSnapshot::MaxMana),
+		"CurrentEndurance", sol::readonly(&MQGameSnapshot::CurrentEndurance),
+		"MaxEndurance", sol::readonly(&MQGameSnapshot::MaxEndurance),
+		"ZoneID", sol::readonly(&MQGameSnapshot::ZoneID),
+		"Target", sol::property([](const MQGameSnapshot& mThis) { return &mThis.Target; }),
+		"GroupCount", sol::readonly(&MQGameSnapshot::GroupCount),
+		"XTargetCount", sol::readonly(&MQGameSnapshot::XTargetCount),
+		"BuffCount", sol::readonly(&MQGameSnapshot::BuffCount),
+		"Group", [](const MQGameSnapshot& mThis, int index) { return lua_snapshotSpawn(mThis.Group, mThis.GroupCount, index); },
+		"XTarget", [](const MQGameSnapshot& mThis, int index) { return lua_snapshotSpawn(mThis.XTargets, mThis.XTargetCount, index); },
+		"Buff", [](const MQGameSnapshot& mThis, int slot) { return lua_snapshotBuff(mThis, slot); }
+	);
+
+	// The same object every frame; its fields change after each main pulse.
+	mq.set_function("snapshot", []() { return &GetGameSnapshot(); });
+
+	//----------------------------------------------------------------------------
+	// Inventory Snapshot
+
+	mq.new_usertype<MQInventoryItemSnapshot>(
+		"inventoryitemsnapshot", sol::no_constructor,
+		"Location", sol::property([](const MQInventoryItemSnapshot& mThis) { return static_cast<int>(mThis.Location); }),
+		"Slot", sol::readonly(&MQInventoryItemSnapshot::Slot),
+		"BagSlot", sol::readonly(&MQInventoryItemSnapshot::BagSlot),
+		"ID", sol::readonly(&MQInventoryItemSnapshot::ItemID),
+		"Name", sol::property([](const MQInventoryItemSnapshot& mThis) { return std::string_view(mThis.Name); }),
+		"StackCount", sol::readonly(&MQInventoryItemSnapshot::StackCount),
+		"Charges", sol::readonly(&MQInventoryItemSnapshot::Charges),
+		"Flags", sol::readonly(&MQInventoryItemSnapshot::Flags),
+		"Lore", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_Lore) != 0; }),
+		"NoDrop", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_NoDrop) != 0; }),
+		"NoRent", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_NoRent) != 0; }),
+		"Container", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_Container) != 0; }),
+		"Stackable", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_Stackable) != 0; }),
+		"Magic", sol::property([](const MQInventoryItemSnapshot& mThis) { return (mThis.Flags & InventoryItem_Magic) != 0; })
+	);
+
+	mq.new_usertype<MQInventorySnapshot>(
+		"inventorysnapshot", sol::no_constructor,
+		"Revision", sol::readonly(&MQInventorySnapshot::Revision),
+		"Count", sol::property([](const MQInventorySnapshot& mThis) { return static_cast<int>(mThis.Items.size()); }),
+		"Item", &lua_inventorySnapshotItem
+	);
+
+	// "inventory" (the default), "bank" or "keyring". The same object for each source; Revision
+	// changes when its items do. Items are copied out, so they stay valid after the next pulse.
+	mq.set_function("inventorySnapshot", &lua_inventorySnapshot);
 }
 
 } // namespace mq::lua::bindings
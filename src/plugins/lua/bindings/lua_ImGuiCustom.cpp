@@ -30,9 +30,119 @@ namespace mq::lua::bindings {
 
 //============================================================================
 
-void lua_addimgui(std::string_view name, sol::function function, sol::this_state s);
+void lua_addimgui(std::string_view name, sol::function function, std::optional<sol::table> options, sol::this_state s);
 void lua_removeimgui(std::string_view name, sol::this_state s);
 
+//----------------------------------------------------------------------------
+// Batched widgets: these take a whole lua array and draw it in one call, instead of one call into
+// the bindings per widget. They are raw lua functions so that walking the array doesn't go through
+// sol for every element.
+
+// A cell is a string or number drawn as text, or { text, color } with the color as a packed ImU32.
+static void DrawBatchedCell(lua_State* L, int index)
+{
+	size_t length = 0;
+
+	if (lua_type(L, index) == LUA_TTABLE)
+	{
+		lua_rawgeti(L, index, 1);
+		lua_rawgeti(L, index, 2);
+
+		if (const char* text = lua_tolstring(L, -2, &length))
+		{
+			const bool colored = lua_type(L, -1) == LUA_TNUMBER;
+			if (colored)
+				ImGui::PushStyleColor(ImGuiCol_Text, static_cast<ImU32>(static_cast<uint64_t>(lua_tonumber(L, -1))));
+
+			ImGui::TextUnformatted(text, text + length);
+
+			if (colored)
+				ImGui::PopStyleColor();
+		}
+
+		lua_pop(L, 2);
+	}
+	else if (const char* text = lua_tolstring(L, index, &length))
+	{
+		ImGui::TextUnformatted(text, text + length);
+	}
+}
+
+// Calls draw(i) for each of count items, only for the ones that are on screen unless clip is false.
+template <typename Fn>
+static void DrawBatchedItems(int count, bool clip, Fn&& draw)
+{
+	if (!clip)
+	{
+		for (int i = 0; i < count; ++i)
+			draw(i);
+		return;
+	}
+
+	ImGuiListClipper clipper;
+	clipper.Begin(count);
+	while (clipper.Step())
+	{
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+			draw(i);
+	}
+}
+
+// ImGui.TableRows(rows, clip = true): one table row for each array of cells in rows.
+static int lua_TableRows(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	if (ImGui::GetCurrentTable() == nullptr)
+		return luaL_error(L, "TableRows must be called between BeginTable and EndTable");
+
+	const bool clip = lua_isnoneornil(L, 2) || lua_toboolean(L, 2);
+
+	DrawBatchedItems(static_cast<int>(lua_objlen(L, 1)), clip,
+		[L](int row)
+		{
+			ImGui::TableNextRow();
+
+			lua_rawgeti(L, 1, row + 1);
+			const int rowIndex = lua_gettop(L);
+
+			if (lua_type(L, rowIndex) == LUA_TTABLE)
+			{
+				const int cells = static_cast<int>(lua_objlen(L, rowIndex));
+				for (int cell = 1; cell <= cells; ++cell)
+				{
+					lua_rawgeti(L, rowIndex, cell);
+					if (ImGui::TableNextColumn())
+						DrawBatchedCell(L, rowIndex + 1);
+					lua_pop(L, 1);
+				}
+			}
+
+			lua_pop(L, 1);
+		});
+
+	return 0;
+}
+
+// ImGui.TextLines(lines, clip = true): one line of text for each cell in lines.
+static int lua_TextLines(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+
+	const bool clip = lua_isnoneornil(L, 2) || lua_toboolean(L, 2);
+
+	DrawBatchedItems(static_cast<int>(lua_objlen(L, 1)), clip,
+		[L](int line)
+		{
+			lua_rawgeti(L, 1, line + 1);
+			DrawBatchedCell(L, lua_gettop(L));
+			lua_pop(L, 1);
+		});
+
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+
 void RegisterBindings_ImGuiCustom(sol::table& ImGui)
 {
 	// Variables
@@ -48,6 +158,10 @@ void RegisterBindings_ImGuiCustom(sol::table& ImGui)
 		[](CTextureAnimation* anim) { return mq::imgui::DrawTextureAnimation(anim); }
 	));
 
+	// Widgets: Batched
+	ImGui.set_function("TableRows", &lua_TableRows);
+	ImGui.set_function("TextLines", &lua_TextLines);
+
 	// Widgets: Utility
 	ImGui.set_function("HelpMarker", [](const char* text, std::optional<float> width, std::optional<ImFont*> font) { mq::imgui::HelpMarker(text, width.value_or(450), font.value_or(nullptr)); });
 
@@ -65,6 +65,70 @@ static ImPlotPoint LuaImPlotGetter(int index, void* user_data)
 	return point.value_or(ImPlotPoint(0, 0));
 }
 
+// Fixed size buffer of points that scripts push to and plot from directly, so that streaming a
+// series doesn't copy a table into an array every frame. Once full, each new point replaces the
+// oldest one.
+class LuaPlotBuffer
+{
+public:
+	explicit LuaPlotBuffer(int capacity)
+		: m_capacity(std::max(capacity, 1))
+	{
+		m_points.reserve(m_capacity);
+	}
+
+	void AddPoint(double x, double y)
+	{
+		if (static_cast<int>(m_points.size()) < m_capacity)
+		{
+			m_points.emplace_back(x, y);
+		}
+		else
+		{
+			m_points[m_offset] = ImPlotPoint(x, y);
+			m_offset = (m_offset + 1) % m_capacity;
+		}
+	}
+
+	void Clear()
+	{
+		m_points.clear();
+		m_offset = 0;
+	}
+
+	int Count() const { return static_cast<int>(m_points.size()); }
+	int Capacity() const { return m_capacity; }
+
+	// oldest first
+	const ImPlotPoint& GetPoint(int index) const
+	{
+		return m_points[(m_offset + index) % m_points.size()];
+	}
+
+	static ImPlotPoint Getter(int index, void* user_data)
+	{
+		return static_cast<const LuaPlotBuffer*>(user_data)->GetPoint(index);
+	}
+
+private:
+	std::vector<ImPlotPoint> m_points;
+	int m_capacity;
+	int m_offset = 0;
+};
+
+// the other edge of a buffer shaded to a constant
+struct LuaPlotBufferRef
+{
+	const LuaPlotBuffer* buffer;
+	double yref;
+
+	static ImPlotPoint Getter(int index, void* user_data)
+	{
+		auto ref = static_cast<const LuaPlotBufferRef*>(user_data);
+		return ImPlotPoint(ref->buffer->GetPoint(index).x, ref->yref);
+	}
+};
+
 // Custom type used for creating links between plots. Must remain alive for as long as the links are active
 
 
@@ -85,6 +149,11 @@ void PlotLineG(const char* label_id, sol::unsafe_function getter, int count, std
 	ImPlot::PlotLineG(label_id, &LuaImPlotGetter, &getter, count, flags.value_or(0));
 }
 
+void PlotLineB(const char* label_id, const LuaPlotBuffer& buffer, std::optional<int> flags)
+{
+	ImPlot::PlotLineG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), buffer.Count(), flags.value_or(0));
+}
+
 //----------------------------------------------------------------------------
 
 void PlotScatter1(const char* label_id, std::vector<double> values, int count, std::optional<double> xscale, std::optional<double> xstart, std::optional<int> flags, std::optional<int> offset, std::optional<int> stride)
@@ -102,6 +171,11 @@ void PlotScatterG(const char* label_id, sol::unsafe_function getter, int count,
 	ImPlot::PlotScatterG(label_id, &LuaImPlotGetter, &getter, count, flags.value_or(0));
 }
 
+void PlotScatterB(const char* label_id, const LuaPlotBuffer& buffer, std::optional<int> flags)
+{
+	ImPlot::PlotScatterG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), buffer.Count(), flags.value_or(0));
+}
+
 //----------------------------------------------------------------------------
 
 void PlotStairs1(const char* label_id, std::vector<double> values, int count, std::optional<double> xscale, std::optional<double> xstart, std::optional<int> flags, std::optional<int> offset, std::optional<int> stride)
@@ -119,6 +193,11 @@ void PlotStairsG(const char* label_id, sol::unsafe_function getter, int count, s
 	ImPlot::PlotStairsG(label_id, &LuaImPlotGetter, &getter, count, flags.value_or(0));
 }
 
+void PlotStairsB(const char* label_id, const LuaPlotBuffer& buffer, std::optional<int> flags)
+{
+	ImPlot::PlotStairsG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), buffer.Count(), flags.value_or(0));
+}
+
 //----------------------------------------------------------------------------
 
 void PlotShaded1(const char* label_id, std::vector<double> values, int count, std::optional<double> yref, std::optional<double> xscale, std::optional<double> xstart, std::optional<int> flags, std::optional<int> offset, std::optional<int> stride)
@@ -141,6 +220,12 @@ void PlotShadedG(const char* label_id, sol::unsafe_function getter1, sol::unsafe
 	ImPlot::PlotShadedG(label_id, &LuaImPlotGetter, &getter1, &LuaImPlotGetter, &getter2, count, flags.value_or(0));
 }
 
+void PlotShadedB(const char* label_id, const LuaPlotBuffer& buffer, std::optional<double> yref, std::optional<int> flags)
+{
+	LuaPlotBufferRef ref{ &buffer, yref.value_or(0) };
+	ImPlot::PlotShadedG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), &LuaPlotBufferRef::Getter, &ref, buffer.Count(), flags.value_or(0));
+}
+
 //----------------------------------------------------------------------------
 
 void PlotBars1(const char* label_id, std::vector<double> values, int count, std::optional<double> bar_size, std::optional<double> shift, std::optional<int> flags, std::optional<int> offset, std::optional<int> stride)
@@ -158,6 +243,11 @@ void PlotBarsG(const char* label_id, sol::unsafe_function getter, int count, dou
 	ImPlot::PlotBarsG(label_id, &LuaImPlotGetter, &getter, count, bar_size, flags.value_or(0));
 }
 
+void PlotBarsB(const char* label_id, const LuaPlotBuffer& buffer, double bar_size, std::optional<int> flags)
+{
+	ImPlot::PlotBarsG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), buffer.Count(), bar_size, flags.value_or(0));
+}
+
 //----------------------------------------------------------------------------
 
 void PlotBarGroups(std::vector<const char*> label_ids, std::vector<double> values, int item_count, int group_count, std::optional<double> group_size, std::optional<double> shift, std::optional<int> flags)
@@ -250,6 +340,11 @@ void PlotDigitalG(const char* label_id, sol::unsafe_function getter, int count,
 	ImPlot::PlotDigitalG(label_id, &LuaImPlotGetter, &getter, count, flags.value_or(0));
 }
 
+void PlotDigitalB(const char* label_id, const LuaPlotBuffer& buffer, std::optional<int> flags)
+{
+	ImPlot::PlotDigitalG(label_id, &LuaPlotBuffer::Getter, const_cast<LuaPlotBuffer*>(&buffer), buffer.Count(), flags.value_or(0));
+}
+
 //============================================================================
 //============================================================================
 
@@ -641,6 +736,18 @@ sol::table RegisterBindings_ImPlot(sol::this_state L)
 		sol::meta_function::index, [](const ImPlotPoint& point, int index, sol::this_state L) -> sol::object { if (index == 1 || index == 2) return sol::make_object(L, point[index]); return sol::make_object(L, sol::nil); }
 	);
 
+	// Ring buffer of points for streaming series, see LuaPlotBuffer
+	state.new_usertype<LuaPlotBuffer>(
+		"ImPlotBuffer", sol::call_constructor,
+		sol::constructors<LuaPlotBuffer(int)>(),
+		"AddPoint", &LuaPlotBuffer::AddPoint,
+		"Clear", &LuaPlotBuffer::Clear,
+		"Count", sol::readonly_property(&LuaPlotBuffer::Count),
+		"Capacity", sol::readonly_property(&LuaPlotBuffer::Capacity),
+		sol::meta_function::length, &LuaPlotBuffer::Count,
+		sol::meta_function::index, [](const LuaPlotBuffer& buffer, int index, sol::this_state L) -> sol::object { if (index >= 1 && index <= buffer.Count()) return sol::make_object(L, buffer.GetPoint(index - 1)); return sol::make_object(L, sol::nil); }
+	);
+
 	state.new_usertype<ImPlotRange>(
 		"ImPlotRange", sol::call_constructor,
 		sol::constructors<ImPlotRange(), ImPlotRange(double, double)>(),
@@ -812,11 +919,11 @@ sol::table RegisterBindings_ImPlot(sol::this_state L)
 	ImPlot.set_function("SetNextAxesToFit", &ImPlot::SetNextAxesToFit);
 
 	// [SECTION] Plot Items
-	ImPlot.set_function("PlotLine", sol::overload(&PlotLine1, &PlotLine2, &PlotLineG));
-	ImPlot.set_function("PlotScatter", sol::overload(&PlotScatter1, &PlotScatter2, &PlotScatterG));
-	ImPlot.set_function("PlotStairs", sol::overload(&PlotStairs1, &PlotStairs2, &PlotStairsG));
-	ImPlot.set_function("PlotShaded", sol::overload(&PlotShaded1, &PlotShaded2, &PlotShaded3, &PlotShadedG));
-	ImPlot.set_function("PlotBars", sol::overload(&PlotBars1, &PlotBars2, &PlotBarsG));
+	ImPlot.set_function("PlotLine", sol::overload(&PlotLine1, &PlotLine2, &PlotLineG, &PlotLineB));
+	ImPlot.set_function("PlotScatter", sol::overload(&PlotScatter1, &PlotScatter2, &PlotScatterG, &PlotScatterB));
+	ImPlot.set_function("PlotStairs", sol::overload(&PlotStairs1, &PlotStairs2, &PlotStairsG, &PlotStairsB));
+	ImPlot.set_function("PlotShaded", sol::overload(&PlotShaded1, &PlotShaded2, &PlotShaded3, &PlotShadedG, &PlotShadedB));
+	ImPlot.set_function("PlotBars", sol::overload(&PlotBars1, &PlotBars2, &PlotBarsG, &PlotBarsB));
 	ImPlot.set_function("PlotBarGroups", &PlotBarGroups);
 	ImPlot.set_function("PlotErrorBars", sol::overload(&PlotErrorBars1, &PlotErrorBars2));
 	ImPlot.set_function("PlotStems", sol::overload(&PlotStems1, &PlotStems2));
@@ -825,7 +932,7 @@ sol::table RegisterBindings_ImPlot(sol::this_state L)
 	ImPlot.set_function("PlotHeatmap", &PlotHeatmap);
 	ImPlot.set_function("PlotHistogram", &PlotHistogram);
 	ImPlot.set_function("PlotHistogram2D", &PlotHistogram2D);
-	ImPlot.set_function("PlotDigital", sol::overload(&PlotDigital, &PlotDigitalG));
+	ImPlot.set_function("PlotDigital", sol::overload(&PlotDigital, &PlotDigitalG, &PlotDigitalB));
 	ImPlot.set_function("PlotImage", [](const char* label_id, ImTextureID user_texture_id, const ImPlotPoint& bounds_min, const ImPlotPoint& bounds_max, std::optional<ImVec2> uv0, std::optional<ImVec2> uv1, std::optional<ImVec4> tint_col, std::optional<int> flags) {
 		ImPlot::PlotImage(label_id, user_texture_id, bounds_min, bounds_max, uv0.value_or(ImVec2(0, 0)), uv1.value_or(ImVec2(1, 1)), tint_col.value_or(ImVec4(1, 1, 1, 1)), flags.value_or(0));
 	});
@@ -18,6 +18,7 @@
 #include "LuaCommon.h"
 #include "LuaCoroutine.h"
 #include "LuaEvent.h"
+#include "LuaEventWait.h"
 #include "LuaImGui.h"
 #include "LuaThread.h"
 
@@ -103,6 +104,35 @@ static void lua_delay(sol::object delayObj, std::optional<sol::object> condition
 	}
 }
 
+// mq.schedule(weight, priority) sets this script's share of the frame budget, if there is one.
+// Returns the weight and priority in effect.
+static std::tuple<uint32_t, int> lua_schedule(std::optional<uint32_t> weight, std::optional<int> priority, sol::this_state s)
+{
+	if (std::shared_ptr<LuaThread> thread_ptr = LuaThread::get_from(s))
+	{
+		thread_ptr->SetScheduling(weight.value_or(thread_ptr->GetWeight()), priority.value_or(thread_ptr->GetPriority()));
+
+		return { thread_ptr->GetWeight(), thread_ptr->GetPriority() };
+	}
+
+	return { 1, 0 };
+}
+
+// mq.gctune(pause, stepmul) sets this script's collector pause and step multiplier, in percent as
+// with collectgarbage. They also pace the collection done in leftover frame budget. Returns the
+// values in effect.
+static std::tuple<int, int> lua_gctune(std::optional<int> pause, std::optional<int> stepMul, sol::this_state s)
+{
+	if (std::shared_ptr<LuaThread> thread_ptr = LuaThread::get_from(s))
+	{
+		thread_ptr->SetGCTuning(pause.value_or(thread_ptr->GetGCPause()), stepMul.value_or(thread_ptr->GetGCStepMul()));
+
+		return { thread_ptr->GetGCPause(), thread_ptr->GetGCStepMul() };
+	}
+
+	return { 200, 200 };
+}
+
 // also exposed as os.exit
 void lua_exit(sol::this_state s)
 {
@@ -303,12 +333,21 @@ static bool lua_removebind(std::string_view name, sol::this_state s)
 #pragma region ImGui Bindings
 
 // We also bind these inside ImGui namespace
-void lua_addimgui(std::string_view name, sol::function function, sol::this_state s)
+// options are { interval = ms, background = bool, collapsed = bool }, see LuaImGuiOptions
+void lua_addimgui(std::string_view name, sol::function function, std::optional<sol::table> options, sol::this_state s)
 {
+	LuaImGuiOptions imguiOptions;
+	if (options)
+	{
+		imguiOptions.interval = std::chrono::milliseconds(options->get_or("interval", 0));
+		imguiOptions.background = options->get_or("background", true);
+		imguiOptions.collapsed = options->get_or("collapsed", true);
+	}
+
 	if (std::shared_ptr<LuaThread> thread_ptr = LuaThread::get_from(s))
 	{
 		if (LuaImGuiProcessor* imgui = thread_ptr->GetImGuiProcessor())
-			imgui->AddCallback(name, function);
+			imgui->AddCallback(name, function, imguiOptions);
 	}
 }
 
@@ -521,6 +560,9 @@ void RegisterBindings_MQ(LuaThread* thread, sol::table& mq)
 	// thread bindings
 	mq.set_function("delay",                     &lua_delay);
 	mq.set_function("exit",                      &lua_exit);
+	mq.set_function("schedule",                  &lua_schedule);
+	mq.set_function("gctune",                    &lua_gctune);
+	LuaEventWaits::RegisterLua(mq);
 
 	// event bindings
 	mq.set_function("doevents",                  &lua_doevents);
@@ -559,9 +601,11 @@ void RegisterBindings_MQ(LuaThread* thread, sol::table& mq)
 		"MQTexture"                  , sol::no_constructor,
 		"size"                       , sol::property([](const MQTexture& mThis) -> ImVec2 { return mThis.GetTextureSize(); }),
 		"fileName"                   , sol::property(&mq::MQTexture::GetFilename),
+		"loading"                    , sol::property(&mq::MQTexture::IsLoading),
 		"GetTextureID"               , &mq::MQTexture::GetTextureID
 	);
 	mq.set_function("CreateTexture", [](const std::string& name) { return CreateTexturePtr(name); });
+	mq.set_function("CreateTextureAsync", [](const std::string& name) { return CreateTextureAsync(name); });
 }
 
 } // namespace mq::lua::bindings
@@ -20,6 +20,7 @@
 namespace mq {
 	struct MQTypeVar;
 	struct MQTopLevelObject;
+	struct MQBoundDataExpression;
 }
 
 namespace mq::datatypes {
@@ -71,6 +72,7 @@ public:
 	sol::object CallVA(sol::this_state L, sol::variadic_args args) const;
 	sol::object CallEmpty(sol::this_state L) const;
 	sol::object Get(sol::stack_object key, sol::this_state L) const;
+	sol::table GetMembers(sol::table members, sol::this_state L) const;
 	datatypes::MQ2Type* GetType() const;
 
 private:
@@ -102,6 +104,10 @@ public:
 	sol::object CallEmpty(sol::this_state L) const;
 	sol::object Get(sol::stack_object key, sol::this_state L) const;
 
+	// mq.TLO.Target:get{ 'Name', 'PctHPs', 'Distance' } evaluates the TLO once and returns a table
+	// of the member values, keyed by member.
+	sol::table GetMembers(sol::table members, sol::this_state L) const;
+
 	datatypes::MQ2Type* GetType() const;
 
 private:
@@ -110,6 +116,54 @@ private:
 
 //----------------------------------------------------------------------------
 
+// A TLO path bound once with mq.bindtlo, e.g. mq.bindtlo('Me.PctHPs'). Calling it returns the live
+// value, the same as mq.TLO.Me.PctHPs() but without looking up the TLO and each member by name.
+class lua_MQBoundData
+{
+public:
+	lua_MQBoundData(std::string expression, std::shared_ptr<MQBoundDataExpression> bound);
+
+	// Registered as a plain lua_CFunction, so the value goes straight onto the stack without
+	// passing through a sol::object.
+	static int Call(lua_State* L);
+	sol::object Var(sol::this_state L) const;
+	static std::string ToString(const lua_MQBoundData& data);
+
+private:
+	std::string m_expression;
+	std::shared_ptr<MQBoundDataExpression> m_bound;
+};
+
+// A subscription made with mq.watch, e.g. mq.watch('Me.PctHPs', 'below', 50). The expression is
+// evaluated once per frame no matter how many scripts watch it. changed() returns true and the
+// value if the trigger has fired since it was last called.
+class lua_MQDataWatch
+{
+public:
+	lua_MQDataWatch(std::string expression, int subscriptionID);
+
+	std::tuple<bool, sol::object> Changed(sol::this_state L) const;
+	static std::string ToString(const lua_MQDataWatch& watch);
+
+	struct State
+	{
+		int SubscriptionID = 0;
+		bool Pending = false;
+		MQTypeVar Value;
+		std::string Text;
+
+		~State();
+	};
+
+	State* GetState() const { return m_state.get(); }
+
+private:
+	std::string m_expression;
+	std::shared_ptr<State> m_state;
+};
+
+//----------------------------------------------------------------------------
+
 class LuaAbstractDataType;
 
 // A custom DataType implementation that serves as a proxy between the Macro
@@ -114,46 +114,82 @@ static sol::table FillExtent(const std::shared_ptr<datatypes::CDataArray>& arr,
 	return table;
 }
 
-static sol::object ConvertTypeVarToLua(sol::this_state L, const MQTypeVar& result)
+// Pushes the value of result straight onto the stack: numbers and booleans as themselves, and
+// anything else as its string. Always pushes exactly one value.
+static int PushTypeVar(lua_State* L, const MQTypeVar& result)
 {
-	if (result.Type == nullptr)
-		return sol::object(L, sol::in_place, sol::lua_nil);
-
-	if (result.Type == mq::datatypes::pArrayType)
-		return sol::object(L, sol::in_place, FillExtent(result.Get<datatypes::CDataArray>(), 0, 0, sol::state_view(L)));
-	if (result.Type == mq::datatypes::pBoolType)
-		return sol::object(L, sol::in_place, result.Get<bool>());
-	if (result.Type == mq::datatypes::pIntType)
-		return sol::object(L, sol::in_place, result.Get<int>());
-	if (result.Type == mq::datatypes::pInt64Type)
-		return sol::object(L, sol::in_place, result.Get<int64_t>());
-	if (result.Type == mq::datatypes::pByteType)
-		return sol::object(L, sol::in_place, result.Get<uint8_t>());
-	if (result.Type == mq::datatypes::pFloatType)
-		return sol::object(L, sol::in_place, result.Get<float>());
-	if (result.Type == mq::datatypes::pDoubleType)
-		return sol::object(L, sol::in_place, result.Get<double>());
-	if (result.Type == mq::datatypes::pStringType)
-		return sol::object(L, sol::in_place, (const char*)result.Ptr);
-	if (result.Type == mq::datatypes::pTimeStampType)
-		return sol::object(L, sol::in_place, result.Get<int64_t>());
-
-	// Transfer a table type over to the new lua state
-	if (result.Type == s_luaTableType)
+	MQ2Type* const type = result.Type;
+
+	if (type == nullptr)
+		lua_pushnil(L);
+	else if (type == mq::datatypes::pIntType)
+		lua_pushinteger(L, result.Get<int>());
+	else if (type == mq::datatypes::pBoolType)
+		lua_pushboolean(L, result.Get<bool>());
+	else if (type == mq::datatypes::pFloatType)
+		lua_pushnumber(L, result.Get<float>());
+	else if (type == mq::datatypes::pDoubleType)
+		lua_pushnumber(L, result.Get<double>());
+	else if (type == mq::datatypes::pInt64Type || type == mq::datatypes::pTimeStampType)
+		lua_pushinteger(L, static_cast<lua_Integer>(result.Get<int64_t>()));
+	else if (type == mq::datatypes::pByteType)
+		lua_pushinteger(L, result.Get<uint8_t>());
+	else if (type == mq::datatypes::pStringType)
+		lua_pushstring(L, static_cast<const char*>(result.Ptr));
+	else if (type == mq::datatypes::pArrayType)
+		sol::stack::push(L, FillExtent(result.Get<datatypes::CDataArray>(), 0, 0, sol::state_view(L)));
+	else if (type == s_luaTableType)
 	{
+		// Transfer a table type over to the new lua state
 		if (auto obj = result.Get<sol::object>())
-			return CloneObject(*obj, L);
+			sol::stack::push(L, CloneObject(*obj, L));
+		else
+			lua_pushnil(L);
+	}
+	else
+	{
+		// by default run it through the tostring conversion because we are assuming calling with empty parens means
+		// to actualize the data in the native lua space. Only the terminator needs clearing, this is
+		// called far too often to zero the whole buffer.
+		char buf[MAX_STRING];
+		buf[0] = 0;
+
+		if (type->ToString(result.GetVarPtr(), buf))
+			lua_pushstring(L, buf);
+		else
+			lua_pushnil(L);
+	}
+
+	return 1;
+}
+
+static sol::object ConvertTypeVarToLua(sol::this_state L, const MQTypeVar& result)
+{
+	PushTypeVar(L, result);
+	return sol::stack::pop<sol::object>(L);
+}
+
+static sol::table EvaluateMembersToTable(const MQTypeVar& object, const sol::table& members, sol::this_state L)
+{
+	std::vector<std::string_view> names;
+	names.reserve(members.size());
 
-		return sol::nil;
+	for (size_t i = 1; i <= members.size(); ++i)
+	{
+		if (auto maybe_name = members.get<std::optional<std::string_view>>(i))
+			names.push_back(*maybe_name);
 	}
 
-	// by default run it through the tostring conversion because we are assuming calling with empty parens means
-	// to actualize the data in the native lua space
-	char buf[MAX_STRING] = { 0 };
-	if (result.Type->ToString(result.GetVarPtr(), buf))
-		return sol::object(L, sol::in_place, buf);
+	sol::table results = sol::state_view(L).create_table(0, static_cast<int>(names.size()));
 
-	return sol::object(L, sol::in_place, sol::lua_nil);
+	// values are converted as soon as they are evaluated, the next member may reuse their storage
+	EvaluateMacroDataMembers(object, names,
+		[&](size_t index, const MQTypeVar& result)
+		{
+			results[names[index]] = ConvertTypeVarToLua(L, result);
+		});
+
+	return results;
 }
 
 template <typename T>
@@ -406,6 +442,11 @@ sol::object lua_MQTypeVar::Get(sol::stack_object key, sol::this_state L) const
 	return sol::object(L, sol::in_place, std::move(var));
 }
 
+sol::table lua_MQTypeVar::GetMembers(sol::table members, sol::this_state L) const
+{
+	return EvaluateMembersToTable(EvaluateMember(), members, L);
+}
+
 //----------------------------------------------------------------------------
 
 lua_MQTopLevelObject::lua_MQTopLevelObject(sol::this_state L, const std::string& str)
@@ -503,6 +544,15 @@ sol::object lua_MQTopLevelObject::Get(sol::stack_object key, sol::this_state L)
 	return sol::object(L, sol::in_place, lua_MQTypeVar(MQTypeVar()));
 }
 
+sol::table lua_MQTopLevelObject::GetMembers(sol::table members, sol::this_state L) const
+{
+	MQTypeVar result;
+	if (self == nullptr || !self->Function("", result))
+		result = MQTypeVar();
+
+	return EvaluateMembersToTable(result, members, L);
+}
+
 template <typename Handler>
 bool sol_lua_check(sol::types<lua_MQTopLevelObject>, lua_State* L, int index, Handler&& handler, sol::stack::record& tracking)
 {
@@ -534,6 +584,168 @@ bool lua_MQTypeVar::EqualData(const lua_MQTopLevelObject& right) const
 
 //----------------------------------------------------------------------------
 
+lua_MQBoundData::lua_MQBoundData(std::string expression, std::shared_ptr<MQBoundDataExpression> bound)
+	: m_expression(std::move(expression))
+	, m_bound(std::move(bound))
+{
+}
+
+int lua_MQBoundData::Call(lua_State* L)
+{
+	if (!sol::stack::check<lua_MQBoundData>(L, 1))
+		return luaL_error(L, "Expected a bound data expression");
+
+	const lua_MQBoundData& self = sol::stack::get<lua_MQBoundData&>(L, 1);
+
+	MQTypeVar result;
+	if (!EvaluateBoundDataExpression(*self.m_bound, result))
+		result = MQTypeVar();
+
+	return PushTypeVar(L, result);
+}
+
+sol::object lua_MQBoundData::Var(sol::this_state L) const
+{
+	MQTypeVar result;
+	if (!EvaluateBoundDataExpression(*m_bound, result))
+		result = MQTypeVar();
+
+	return sol::object(L, sol::in_place, lua_MQTypeVar(result));
+}
+
+std::string lua_MQBoundData::ToString(const lua_MQBoundData& data)
+{
+	return fmt::format("bound({})", data.m_expression);
+}
+
+static sol::object mq_bindtlo(std::string_view expression, sol::this_state L)
+{
+	auto bound = BindDataExpression(expression);
+	if (!bound)
+	{
+		luaL_error(L, "Unable to bind '%.*s': expected a data expression such as 'Me.PctHPs'",
+			static_cast<int>(expression.size()), expression.data());
+		return sol::lua_nil;
+	}
+
+	// the script depends on the plugin that provides the TLO, the same as with mq.TLO
+	if (const MQTopLevelObject* tlo = GetBoundTopLevelObject(*bound))
+	{
+		if (auto thread_ptr = LuaThread::get_from(L))
+			thread_ptr->AssociateTopLevelObject(tlo);
+	}
+
+	return sol::make_object(L, lua_MQBoundData(std::string(expression), std::move(bound)));
+}
+
+lua_MQDataWatch::State::~State()
+{
+	if (SubscriptionID != 0)
+		UnsubscribeDataExpression(SubscriptionID);
+}
+
+lua_MQDataWatch::lua_MQDataWatch(std::string expression, int subscriptionID)
+	: m_expression(std::move(expression))
+	, m_state(std::make_shared<State>())
+{
+	m_state->SubscriptionID = subscriptionID;
+}
+
+std::tuple<bool, sol::object> lua_MQDataWatch::Changed(sol::this_state L) const
+{
+	if (!m_state->Pending)
+		return { false, sol::lua_nil };
+
+	m_state->Pending = false;
+
+	// Numbers and booleans are held in the value itself, anything else could be gone by now and
+	// is handed back as the text it had when the trigger fired.
+	MQ2Type* type = m_state->Value.Type;
+	if (type == nullptr)
+		return { true, sol::lua_nil };
+
+	if (type == datatypes::pIntType || type == datatypes::pBoolType || type == datatypes::pFloatType
+		|| type == datatypes::pDoubleType || type == datatypes::pInt64Type || type == datatypes::pTimeStampType
+		|| type == datatypes::pByteType)
+	{
+		return { true, ConvertTypeVarToLua(L, m_state->Value) };
+	}
+
+	return { true, sol::make_object(L, m_state->Text) };
+}
+
+std::string lua_MQDataWatch::ToString(const lua_MQDataWatch& watch)
+{
+	return fmt::format("watch({})", watch.m_expression);
+}
+
+static sol::object mq_watch(std::string_view expression, sol::optional<std::string_view> trigger,
+	sol::optional<double> threshold, sol::this_state L)
+{
+	MQDataTrigger dataTrigger = MQDataTrigger::Changed;
+	if (trigger)
+	{
+		if (ci_equals(*trigger, "above"))
+			dataTrigger = MQDataTrigger::Above;
+		else if (ci_equals(*trigger, "below"))
+			dataTrigger = MQDataTrigger::Below;
+		else if (!ci_equals(*trigger, "changed"))
+		{
+			luaL_error(L, "Unknown watch trigger '%.*s': expected 'changed', 'above' or 'below'",
+				static_cast<int>(trigger->size()), trigger->data());
+			return sol::lua_nil;
+		}
+	}
+
+	if (dataTrigger != MQDataTrigger::Changed && !threshold)
+	{
+		luaL_error(L, "A threshold is required to watch for a value going above or below it");
+		return sol::lua_nil;
+	}
+
+	lua_MQDataWatch watch(std::string(expression), 0);
+	lua_MQDataWatch::State* state = watch.GetState();
+
+	// the state unsubscribes when the last copy of the watch is collected, so it outlives the callback
+	int id = SubscribeDataExpression(expression, dataTrigger, threshold.value_or(0.0),
+		[state](const MQTypeVar& value)
+		{
+			state->Pending = true;
+			state->Value = value;
+
+			char buf[MAX_STRING] = { 0 };
+			if (value.Type == datatypes::pStringType)
+				state->Text = static_cast<const char*>(value.Ptr);
+			else if (value.Type != nullptr && value.Type->ToString(value.GetVarPtr(), buf))
+				state->Text = buf;
+			else
+				state->Text.clear();
+		});
+
+	if (id == 0)
+	{
+		luaL_error(L, "Unable to watch '%.*s': expected a data expression such as 'Me.PctHPs'",
+			static_cast<int>(expression.size()), expression.data());
+		return sol::lua_nil;
+	}
+
+	state->SubscriptionID = id;
+
+	// the script depends on the plugin that provides the TLO, the same as with mq.TLO
+	if (auto bound = BindDataExpression(expression))
+	{
+		if (const MQTopLevelObject* tlo = GetBoundTopLevelObject(*bound))
+		{
+			if (auto thread_ptr = LuaThread::get_from(L))
+				thread_ptr->AssociateTopLevelObject(tlo);
+		}
+	}
+
+	return sol::make_object(L, std::move(watch));
+}
+
+//----------------------------------------------------------------------------
+
 template <typename Handler>
 bool sol_lua_check(sol::types<lua_MQTypeVar>, lua_State* L, int index, Handler&& handler, sol::stack::record& tracking)
 {
@@ -1091,7 +1303,8 @@ void RegisterBindings_MQMacroData(sol::table& mq)
 		sol::meta_function::equal_to,            sol::overload(
 			                                         &lua_MQTypeVar::operator==,
 			                                         &lua_MQTypeVar::EqualData,
-			                                         &lua_MQTypeVar::EqualNil));
+			                                         &lua_MQTypeVar::EqualNil),
+		"get",                                   &lua_MQTypeVar::GetMembers);
 
 	mq.new_usertype<lua_MQTopLevelObject>(
 		"data",                                  sol::constructors<
@@ -1105,13 +1318,27 @@ void RegisterBindings_MQMacroData(sol::table& mq)
 		sol::meta_function::equal_to,            sol::overload(
 			                                         &lua_MQTopLevelObject::operator==,
 			                                         &lua_MQTopLevelObject::EqualVar,
-			                                         &lua_MQTopLevelObject::EqualNil));
+			                                         &lua_MQTopLevelObject::EqualNil),
+		"get",                                   &lua_MQTopLevelObject::GetMembers);
 
 	mq.new_usertype<lua_MQTLO>(
 		"tlo",                                   sol::no_constructor,
 		sol::meta_function::index,               &lua_MQTLO::Get);
 	mq.set("TLO",                                lua_MQTLO());
 	mq.set("null",                               lua_MQTypeVar(MQTypeVar()));
+
+	mq.new_usertype<lua_MQBoundData>(
+		"bound",                                 sol::no_constructor,
+		sol::meta_function::call,                &lua_MQBoundData::Call,
+		sol::meta_function::to_string,           &lua_MQBoundData::ToString,
+		"var",                                   &lua_MQBoundData::Var);
+	mq.set_function("bindtlo",                   &mq_bindtlo);
+
+	mq.new_usertype<lua_MQDataWatch>(
+		"datawatch",                             sol::no_constructor,
+		sol::meta_function::to_string,           &lua_MQDataWatch::ToString,
+		"changed",                               &lua_MQDataWatch::Changed);
+	mq.set_function("watch",                     &mq_watch);
 	mq.set("gettype",                            sol::overload(
 		                                             mq_gettype_MQTopLevelObject,
 		                                             mq_gettype_MQTypeVar));
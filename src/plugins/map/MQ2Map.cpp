@@ -444,18 +444,24 @@ PLUGIN_API void OnPulse()
 	}
 }
 
-PLUGIN_API void OnAddSpawn(SPAWNINFO* pNewSpawn)
+PLUGIN_API void OnAddSpawns(SPAWNINFO* const* spawns, size_t count)
 {
-	// your toon's spawn id changes and it's no longer zero to start don't added it all
-	if (pLocalPlayer != pNewSpawn && pNewSpawn->SpawnID != 0)
+	for (size_t i = 0; i < count; ++i)
 	{
-		AddSpawn(pNewSpawn);
+		// your toon's spawn id changes and it's no longer zero to start don't added it all
+		if (pLocalPlayer != spawns[i] && spawns[i]->SpawnID != 0)
+		{
+			AddSpawn(spawns[i]);
+		}
 	}
 }
 
-PLUGIN_API void OnRemoveSpawn(SPAWNINFO* pSpawn)
+PLUGIN_API void OnRemoveSpawns(SPAWNINFO* const* spawns, size_t count)
 {
-	RemoveSpawn(pSpawn);
+	for (size_t i = 0; i < count; ++i)
+	{
+		RemoveSpawn(spawns[i]);
+	}
 }
 
 PLUGIN_API void SetGameState(DWORD GameState)
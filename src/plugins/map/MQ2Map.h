@@ -16,6 +16,9 @@
 
 #include <mq/Plugin.h>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 enum class MapFilter {
 	Invalid = -1,
@@ -161,6 +164,10 @@ int MapHighlight(MQSpawnSearch* pSearch);
 int MapHide(MQSpawnSearch& Search);
 int MapShow(MQSpawnSearch& Search);
 void MapUpdate();
+
+// Highlights stay in effect until /highlight reset, so spawns that are added to the map later,
+// or that come to match, are highlighted as well.
+bool MatchesMapHighlight(SPAWNINFO* pSpawn);
 void MapAttach();
 void MapDetach();
 
@@ -209,4 +216,24 @@ inline bool RequirementsMet(MapFilter Option)
 MarkerType FindMarker(std::string_view szMark, MarkerType fallback = MarkerType::Unknown);
 
 PLUGIN_API MapViewLine* InitLine();
-PLUGIN_API void DeleteLine(MapViewLine* pLine);
\ No newline at end of file
+PLUGIN_API void DeleteLine(MapViewLine* pLine);
+
+// Fixed size blocks carved out of slabs and recycled through a free list. Map objects, lines and
+// labels come and go with every spawn, so they are allocated from these instead of the heap.
+class MapSlabPool
+{
+public:
+	explicit MapSlabPool(size_t blockSize);
+
+	void* Allocate();
+	void Free(void* ptr);
+
+	size_t GetBlockSize() const { return m_blockSize; }
+
+private:
+	static constexpr size_t BlocksPerSlab = 64;
+
+	size_t m_blockSize;
+	std::vector<std::unique_ptr<std::byte[]>> m_slabs;
+	void* m_freeList = nullptr;
+};
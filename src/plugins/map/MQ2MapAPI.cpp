@@ -18,7 +18,9 @@
 #include <mq/Plugin.h>
 
 #include <fmt/format.h>
+#include <limits>
 #include <sstream>
+#include <unordered_set>
 
 extern MapObject* gpActiveMapObjects;
 extern MapViewLabel* gpLabelList;
@@ -39,6 +41,8 @@ MapCircle TargetMeleeCircle;
 MapCircle CampCircle;
 MapCircle PullCircle;
 
+static void RefreshMapHighlights();
+
 static MapObject* GetCurrentMapObject()
 {
 	if (!pCurrentMapLabel)
@@ -47,9 +51,47 @@ static MapObject* GetCurrentMapObject()
 	return GetMapObjectForLabel(pCurrentMapLabel);
 }
 
+MapSlabPool::MapSlabPool(size_t blockSize)
+	// Blocks hold the free list link while unused, and keep the alignment that new would give.
+	: m_blockSize((std::max(blockSize, sizeof(void*)) + __STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1)
+		& ~(__STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1))
+{
+}
+
+void* MapSlabPool::Allocate()
+{
+	if (!m_freeList)
+	{
+		m_slabs.push_back(std::make_unique<std::byte[]>(m_blockSize * BlocksPerSlab));
+		std::byte* slab = m_slabs.back().get();
+
+		for (size_t i = BlocksPerSlab; i-- > 0;)
+		{
+			void* block = slab + i * m_blockSize;
+			*static_cast<void**>(block) = m_freeList;
+			m_freeList = block;
+		}
+	}
+
+	void* block = m_freeList;
+	m_freeList = *static_cast<void**>(block);
+	return block;
+}
+
+void MapSlabPool::Free(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	*static_cast<void**>(ptr) = m_freeList;
+	m_freeList = ptr;
+}
+
+static MapSlabPool s_linePool{ sizeof(MapViewLine) };
+
 MapViewLine* InitLine()
 {
-	MapViewLine* pLine = new MapViewLine;
+	MapViewLine* pLine = new (s_linePool.Allocate()) MapViewLine;
 	pLine->pPrev = nullptr;
 	pLine->pNext = pLineList;
 
@@ -77,7 +119,8 @@ void DeleteLine(MapViewLine* pLine)
 	else
 		pLineList = pLine->pNext;
 
-	delete pLine;
+	pLine->~MapViewLine();
+	s_linePool.Free(pLine);
 }
 
 void MapInit()
@@ -208,11 +251,25 @@ void MapUpdate()
 		}
 	}
 
+	RefreshMapHighlights();
+
+	static uint32_t s_mapUpdateCount = 0;
+	++s_mapUpdateCount;
+
 	MapObject* mapObject = gpActiveMapObjects;
 	while (mapObject)
 	{
 		bool forced = (mapObject == pOldLastTarget) && bTargetChanged;
+
+		// Far away, stationary objects are left alone until their turn comes around.
+		if (!forced && mapObject != pLastTarget && !mapObject->IsUpdateDue(s_mapUpdateCount))
+		{
+			mapObject = mapObject->GetNext();
+			continue;
+		}
+
 		mapObject->Update(forced);
+		mapObject->ScheduleNextUpdate();
 
 		if (!mapObject->CanDisplayObject())
 		{
@@ -518,10 +575,68 @@ void MapClickLocation(float world_point_y, float world_point_x, const std::vecto
 	}
 }
 
+// The spawns matching a search, found through the core spawn search (which uses the spawn grid for
+// searches with a radius) rather than by testing every map object.
+static std::vector<PlayerClient*> GetMatchingSpawns(MQSpawnSearch& Search)
+{
+	return GetNearestSpawns(&Search, std::numeric_limits<int>::max(), pLocalPlayer, true);
+}
+
+static bool SearchDependsOnPosition(const MQSpawnSearch& Search)
+{
+	return Search.FRadius < 10000.0f || Search.ZRadius < 10000.0f || Search.bLoS
+		|| Search.NearAlertList || Search.NotNearAlertList;
+}
+
+static std::vector<MQSpawnSearch> s_highlightFilters;
+static bool s_highlightsDependOnPosition = false;
+static uint64_t s_lastHighlightRefresh = 0;
+constexpr uint64_t HIGHLIGHT_REFRESH_INTERVAL = 500;
+
+bool MatchesMapHighlight(SPAWNINFO* pSpawn)
+{
+	for (MQSpawnSearch& filter : s_highlightFilters)
+	{
+		if (SpawnMatchesSearch(&filter, pLocalPlayer, pSpawn))
+			return true;
+	}
+
+	return false;
+}
+
+// Filters with a radius change as spawns (and the player) move, so those are looked up again through
+// the spawn grid every so often. Other filters are checked when a spawn is added or changes type.
+static void RefreshMapHighlights()
+{
+	if (!s_highlightsDependOnPosition)
+		return;
+
+	uint64_t now = MQGetTickCount64();
+	if (now < s_lastHighlightRefresh + HIGHLIGHT_REFRESH_INTERVAL)
+		return;
+	s_lastHighlightRefresh = now;
+
+	std::unordered_set<PlayerClient*> matches;
+	for (MQSpawnSearch& filter : s_highlightFilters)
+	{
+		for (PlayerClient* pSpawn : GetMatchingSpawns(filter))
+			matches.insert(pSpawn);
+	}
+
+	for (MapObject* pMapSpawn = gpActiveMapObjects; pMapSpawn; pMapSpawn = pMapSpawn->GetNext())
+	{
+		if (SPAWNINFO* pSpawn = pMapSpawn->GetSpawn())
+			pMapSpawn->SetHighlight(matches.count(pSpawn) != 0);
+	}
+}
+
 int MapHighlight(MQSpawnSearch* pSearch)
 {
 	if (!pSearch)
 	{
+		s_highlightFilters.clear();
+		s_highlightsDependOnPosition = false;
+
 		MapObject* pMapSpawn = gpActiveMapObjects;
 		while (pMapSpawn)
 		{
@@ -532,20 +647,18 @@ int MapHighlight(MQSpawnSearch* pSearch)
 		return 0;
 	}
 
+	s_highlightFilters.push_back(*pSearch);
+	s_highlightsDependOnPosition |= SearchDependsOnPosition(*pSearch);
+
 	uint32_t Count = 0;
-	MAPSPAWN* pMapSpawn = gpActiveMapObjects;
 
-	while (pMapSpawn)
+	for (PlayerClient* pSpawn : GetMatchingSpawns(*pSearch))
 	{
-		// update!
-		SPAWNINFO* pSpawn = pMapSpawn->GetSpawn();
-		if (pSpawn && SpawnMatchesSearch(pSearch, pLocalPlayer, pSpawn))
+		if (MapObject* pMapSpawn = FindMapObject(pSpawn))
 		{
 			pMapSpawn->SetHighlight(true);
 			Count++;
 		}
-
-		pMapSpawn = pMapSpawn->GetNext();
 	}
 
 	return Count;
@@ -553,23 +666,15 @@ int MapHighlight(MQSpawnSearch* pSearch)
 
 int MapHide(MQSpawnSearch& Search)
 {
-	MapObject* pMapSpawn = gpActiveMapObjects;
 	uint32_t Count = 0;
 
-	while (pMapSpawn)
+	for (PlayerClient* pSpawn : GetMatchingSpawns(Search))
 	{
-		SPAWNINFO* pSpawn = pMapSpawn->GetSpawn();
-		if (pSpawn && SpawnMatchesSearch(&Search, pLocalPlayer, pSpawn))
+		if (MapObject* pMapSpawn = FindMapObject(pSpawn))
 		{
-			MapObject* pNext = pMapSpawn->GetNext();
 			RemoveMapObject(pMapSpawn);
-			pMapSpawn = pNext;
 			Count++;
 		}
-		else
-		{
-			pMapSpawn = pMapSpawn->GetNext();
-		}
 	}
 
 	return Count;
@@ -577,19 +682,15 @@ int MapHide(MQSpawnSearch& Search)
 
 int MapShow(MQSpawnSearch& Search)
 {
-	SPAWNINFO* pSpawn = (SPAWNINFO*)pSpawnList;
 	uint32_t Count = 0;
 
-	while (pSpawn)
+	for (PlayerClient* pSpawn : GetMatchingSpawns(Search))
 	{
-		if (FindMapObject(pSpawn)
-			== nullptr && SpawnMatchesSearch(&Search, pLocalPlayer, pSpawn))
+		if (FindMapObject(pSpawn) == nullptr)
 		{
 			AddSpawn(pSpawn, true);
 			Count++;
 		}
-
-		pSpawn = pSpawn->pNext;
 	}
 
 	return Count;
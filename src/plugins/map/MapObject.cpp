@@ -26,11 +26,13 @@ MapLocParams gOverrideMapLocParams;
 MAPLABEL* gpLabelList = nullptr;
 MAPLABEL* gpLabelListTail = nullptr;
 
-std::map<MAPLABEL*, MapObject*> LabelMap;
+std::unordered_map<MAPLABEL*, MapObject*> LabelMap;
+
+static MapSlabPool s_labelPool{ sizeof(MAPLABEL) };
 
 static MAPLABEL* InitLabel()
 {
-	MAPLABEL* pLabel = new MAPLABEL;
+	MAPLABEL* pLabel = new (s_labelPool.Allocate()) MAPLABEL;
 	pLabel->pPrev = nullptr;
 	pLabel->pNext = gpLabelList;
 
@@ -55,7 +57,8 @@ static void DeleteLabel(MAPLABEL* pLabel)
 	else
 		gpLabelList = pLabel->pNext;
 
-	delete pLabel;
+	pLabel->~MAPLABEL();
+	s_labelPool.Free(pLabel);
 }
 
 MapObject* GetMapObjectForLabel(MAPLABEL* pLabel)
@@ -66,6 +69,32 @@ MapObject* GetMapObjectForLabel(MAPLABEL* pLabel)
 
 //============================================================================
 
+// One pool per size of map object. There are only a handful of map object classes.
+static MapSlabPool& GetMapObjectPool(size_t size)
+{
+	static std::vector<std::unique_ptr<MapSlabPool>> s_pools;
+
+	const MapSlabPool candidate{ size };
+	for (const auto& pool : s_pools)
+	{
+		if (pool->GetBlockSize() == candidate.GetBlockSize())
+			return *pool;
+	}
+
+	s_pools.push_back(std::make_unique<MapSlabPool>(size));
+	return *s_pools.back();
+}
+
+void* MapObject::operator new(size_t size)
+{
+	return GetMapObjectPool(size).Allocate();
+}
+
+void MapObject::operator delete(void* ptr, size_t size)
+{
+	GetMapObjectPool(size).Free(ptr);
+}
+
 MapObject::MapObject()
 {
 	// Add to beginning of list
@@ -129,6 +158,43 @@ void MapObject::Update(bool forced)
 		RemoveMarker();
 }
 
+// Distances (squared) from the player past which objects are refreshed less often.
+constexpr float MAP_UPDATE_NEAR_DISTANCE_SQ = 300.0f * 300.0f;
+constexpr float MAP_UPDATE_FAR_DISTANCE_SQ = 1000.0f * 1000.0f;
+
+bool MapObject::IsUpdateDue(uint32_t updateCount) const
+{
+	if (m_updateInterval <= 1)
+		return true;
+
+	const uint32_t slot = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this) >> 4);
+	return (updateCount + slot) % m_updateInterval == 0;
+}
+
+void MapObject::ScheduleNextUpdate()
+{
+	const bool moved = fabs(m_pos.X - m_lastUpdatePos.X) > 1.0f || fabs(m_pos.Y - m_lastUpdatePos.Y) > 1.0f
+		|| fabs(m_pos.Z - m_lastUpdatePos.Z) > 1.0f;
+	m_lastUpdatePos = m_pos;
+
+	if (!pLocalPlayer || m_highlight)
+	{
+		m_updateInterval = 1;
+		return;
+	}
+
+	const float dx = m_pos.X - pLocalPlayer->X;
+	const float dy = m_pos.Y - pLocalPlayer->Y;
+	const float distSq = dx * dx + dy * dy;
+
+	if (distSq < MAP_UPDATE_NEAR_DISTANCE_SQ)
+		m_updateInterval = 1;
+	else if (moved)
+		m_updateInterval = distSq < MAP_UPDATE_FAR_DISTANCE_SQ ? 1 : 4;
+	else
+		m_updateInterval = distSq < MAP_UPDATE_FAR_DISTANCE_SQ ? 4 : 16;
+}
+
 bool MapObject::CanDisplayObject() const
 {
 	return false;
@@ -507,7 +573,7 @@ void MapObject::MakeRingMarker()
 
 //============================================================================
 
-static std::map<SPAWNINFO*, MapObject*> SpawnMap;
+static std::unordered_map<SPAWNINFO*, MapObject*> SpawnMap;
 
 MapObjectSpawn::MapObjectSpawn(SPAWNINFO* pSpawn, bool Explicit)
 	: m_spawn(pSpawn)
@@ -548,18 +614,23 @@ void MapObjectSpawn::Update(bool forced)
 
 	changed |= test_and_set(m_type, GetSpawnType(m_spawn));
 
+	// A spawn that changed type (died, for example) may have stopped or started matching a highlight
+	if (changed)
+		SetHighlight(MatchesMapHighlight(m_spawn));
+
 	m_pos.X = m_spawn->X;
 	m_pos.Y = m_spawn->Y;
 	m_pos.Z = m_spawn->Z;
 	m_heading = m_spawn->Heading;
 
-	// If something changed update the label
-	if (changed || forced)
+	// Only format the label again if something that it shows has changed
+	const char* format = pLastTarget == this ? MapTargetNameString : MapNameString;
+	if (UpdateLabelState(format) || changed || forced)
 	{
-		SetText(FormatString(MapNameString));
-		SetColor(GetSpawnColor());
+		SetText(FormatString(format));
 	}
-	else if (!m_highlight)
+
+	if (changed || forced || !m_highlight)
 	{
 		SetColor(GetSpawnColor());
 	}
@@ -569,10 +640,90 @@ void MapObjectSpawn::Update(bool forced)
 	if (pLastTarget == this)
 	{
 		SetColor(GetMapFilterOption(MapFilter::Target).Color);
-		SetText(FormatString(MapTargetNameString));
 	}
 }
 
+enum MapLabelFields : uint32_t
+{
+	MapLabelField_Name                 = 0x01,
+	MapLabelField_HP                   = 0x02,
+	MapLabelField_SpawnID              = 0x04,
+	MapLabelField_Level                = 0x08,
+	MapLabelField_Position             = 0x10,
+};
+
+// Race and class aren't tracked, a change to those changes the spawn type too.
+static uint32_t GetMapLabelFields(const char* format)
+{
+	uint32_t fields = 0;
+
+	for (const char* p = strchr(format, '%'); p && p[1]; p = strchr(p + 2, '%'))
+	{
+		switch (p[1])
+		{
+		case 'N':
+		case 'n': fields |= MapLabelField_Name; break;
+		case 'h': fields |= MapLabelField_HP; break;
+		case 'i': fields |= MapLabelField_SpawnID; break;
+		case 'l': fields |= MapLabelField_Level; break;
+		case 'x':
+		case 'y':
+		case 'z': fields |= MapLabelField_Position; break;
+		default: break;
+		}
+	}
+
+	return fields;
+}
+
+bool MapObjectSpawn::UpdateLabelState(const char* format)
+{
+	LabelState& state = m_labelState;
+	bool changed = false;
+
+	// The naming strings only change through /mapnames, which regenerates the map, so a format is
+	// identified by which string it is.
+	if (state.Format != format)
+	{
+		state.Format = format;
+		state.Fields = GetMapLabelFields(format);
+		changed = true;
+	}
+
+	if (state.Fields & MapLabelField_Name)
+	{
+		if (state.Name != m_spawn->Name)
+		{
+			state.Name = m_spawn->Name;
+			changed = true;
+		}
+
+		if (state.DisplayedName != m_spawn->DisplayedName)
+		{
+			state.DisplayedName = m_spawn->DisplayedName;
+			changed = true;
+		}
+	}
+
+	if (state.Fields & MapLabelField_HP)
+		changed |= test_and_set(state.HP, static_cast<int64_t>(m_spawn->HPCurrent));
+
+	if (state.Fields & MapLabelField_SpawnID)
+		changed |= test_and_set(state.SpawnID, static_cast<uint32_t>(m_spawn->SpawnID));
+
+	if (state.Fields & MapLabelField_Level)
+		changed |= test_and_set(state.Level, static_cast<int>(m_spawn->Level));
+
+	if (state.Fields & MapLabelField_Position)
+	{
+		changed |= test_and_set(state.Position.X, m_spawn->X);
+		changed |= test_and_set(state.Position.Y, m_spawn->Y);
+		changed |= test_and_set(state.Position.Z, m_spawn->Z);
+	}
+
+	return changed;
+}
+
 MQColor MapObjectSpawn::GetSpawnColor() const
 {
 	if (!m_spawn)
@@ -851,7 +1002,7 @@ void MapObjectSpawn::RemoveVector()
 
 //============================================================================
 
-static std::map<EQGroundItem*, MapObject*> GroundItemMap;
+static std::unordered_map<EQGroundItem*, MapObject*> GroundItemMap;
 
 MapObjectGroundSpawn::MapObjectGroundSpawn(EQGroundItem* pGroundItem)
 	: m_groundItem(pGroundItem)
@@ -923,6 +1074,7 @@ MapObject* MakeMapObject(SPAWNINFO* pSpawn, bool Explicit)
 		return nullptr;
 
 	MapObject* obj = new MapObjectSpawn(pSpawn, Explicit);
+	obj->SetHighlight(MatchesMapHighlight(pSpawn));
 	obj->PostInit();
 
 	return obj;
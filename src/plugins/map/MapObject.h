@@ -26,6 +26,10 @@ public:
 	MapObject();
 	virtual ~MapObject();
 
+	// Map objects are allocated from slab pools, one for each object size.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	virtual void PostInit();                // called after object is constructed to init any other things
 	virtual void Update(bool forced);       // called each frame to sync the map item with the game object.
 
@@ -43,6 +47,11 @@ public:
 	void SetPosition(const CVector3& pos);
 	CVector3 GetPosition() const { return m_pos; }
 
+	// Objects that are far from the player and not moving are refreshed less often than every
+	// map update. Each object is given a fixed slot so that refreshes are spread across updates.
+	bool IsUpdateDue(uint32_t updateCount) const;
+	void ScheduleNextUpdate();
+
 	MapObject* GetNext() const { return m_pNext; }
 	MapObject* GetPrev() const { return m_pLast; }
 
@@ -78,6 +87,8 @@ private:
 	MarkerType            m_marker = MarkerType::None;
 	uint32_t              m_markerSize = 0;
 	std::vector<MapViewLine*> m_markerLines;
+	uint32_t              m_updateInterval = 1;
+	CVector3              m_lastUpdatePos;
 	MapObject*            m_pLast = nullptr;
 	MapObject*            m_pNext = nullptr;
 };
@@ -108,10 +119,29 @@ private:
 	void UpdateVector();
 	void RemoveVector();
 
+	// Returns true if a spawn field that the label format shows has changed since the last call,
+	// or if the format itself is a different one.
+	bool UpdateLabelState(const char* format);
+
 private:
+	// The values of the spawn fields that the label was last formatted with. Only the fields that
+	// the format refers to are compared.
+	struct LabelState
+	{
+		const char* Format = nullptr;
+		uint32_t    Fields = 0;
+		std::string Name;
+		std::string DisplayedName;
+		int64_t     HP = 0;
+		uint32_t    SpawnID = 0;
+		int         Level = 0;
+		CVector3    Position;
+	};
+
 	SPAWNINFO* m_spawn = nullptr;
 	eSpawnType m_type = NONE;
 	bool       m_explicit = false;
+	LabelState m_labelState;
 };
 
 //============================================================================
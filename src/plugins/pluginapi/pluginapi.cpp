@@ -15,6 +15,8 @@
 #include <mq/plugin/pluginapi.h>
 #include <mq/api/Main.h>
 
+#include <new.h>
+
 char INIFileName[MAX_STRING] = { 0 };
 
 namespace mqplugin {
@@ -30,6 +32,9 @@ PLUGIN_API bool IsBuiltForNext = true;
 // Exported symbol that ensures that the plugin was built for the specified version of the game
 PLUGIN_API const char EverQuestVersion[] = __ExpectedVersionDate " " __ExpectedVersionTime;
 
+// Allocations made by this plugin, see operator new below.
+PLUGIN_API mq::MQAllocationCounters PluginAllocations;
+
 // Plugin Entrypoint
 bool PluginMain(HINSTANCE hModule, DWORD dwReason, void* lpReserved)
 {
@@ -117,6 +122,27 @@ void mq::postoffice::SendToActor(const Address& address, const std::string& data
 
 //============================================================================
 
+// Every plugin gets its own operator new, because the runtime is linked statically. The array and
+// nothrow forms all come through here, the aligned ones do not. Memory still comes from malloc, so
+// the default operator delete frees it.
+
+void* operator new(size_t size)
+{
+	if (mq::gbTrackAllocations)
+		mq::RecordAllocation(mqplugin::PluginAllocations, size);
+
+	for (;;)
+	{
+		if (void* block = malloc(size))
+			return block;
+
+		if (_callnewh(size) == 0)
+			throw std::bad_alloc();
+	}
+}
+
+//============================================================================
+
 #if __has_include("../../private/pluginapi-private.cpp")
 #include "../../private/pluginapi-private.cpp"
 #endif
@@ -16,17 +16,22 @@
 // 2.1 Added enums for menu and go to menu item
 // 2.2 Added fix from dannuic/knightly to stop clearing target when using hotbuttons.
 // 2.3 Added a fix for stopping movement by Freezerburn26
+// 2.4 Placeholders are looked up by zone, and loaded in the background. Labels are only
+//     reformatted when what they show changes instead of every 500ms.
 
-// TODO: Update for zone checking since the info is in the file (requires switching storage or map key)
 #include <mq/Plugin.h>
 #include "resource.h"
 
+#include <atomic>
+#include <future>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
 PreSetup("MQ2TargetInfo");
-PLUGIN_VERSION(2.3);
+PLUGIN_VERSION(2.4);
 
 enum class eINIOptions
 {
@@ -43,14 +48,31 @@ char szCanSeeTarget[128] = { "Can See Target" };
 char szPHToolTip[128] = { "Target is a Place Holder" };
 char szPH[128] = { "PH" };
 
-SPAWNINFO* oldspawn = nullptr;
-
 CLabelWnd* InfoLabel = nullptr;
 CLabelWnd* DistanceLabel = nullptr;
 CLabelWnd* CanSeeLabel = nullptr;
 
 CButtonWnd* PHButton = nullptr;
 
+// What the target labels are showing, so each one is only reformatted when it changes. Reset
+// this whenever the settings change or the labels are recreated.
+struct TargetDisplayState
+{
+	SPAWNINFO* Target = nullptr;
+	bool Visibility = false;
+	int PHGeneration = -1;
+	int Level = -1;
+	int Anon = -1;
+	float PlayerPos[3] = { std::numeric_limits<float>::quiet_NaN() };
+	float TargetPos[3] = { std::numeric_limits<float>::quiet_NaN() };
+	std::string Distance;
+	int DistanceNear = -1;
+	int CanSee = -1;
+	bool SightStale = false;
+	uint64_t LastSightCheck = 0;
+};
+TargetDisplayState gTargetDisplay;
+
 CXWnd* Target_BuffWindow = nullptr;
 CLabelWnd* Target_AggroPctPlayerLabel = nullptr;
 CLabelWnd* Target_AggroNameSecondaryLabel = nullptr;
@@ -98,20 +120,76 @@ struct PHInfo
 	std::string Named;
 	std::string Link;
 };
-std::map<std::string, PHInfo> gPHMap;
+
+// Placeholders by zone short name, then by placeholder name. The same name can be a placeholder for
+// different nameds in different zones. Loaded on a background thread, it is empty until then.
+using PHZoneIndex = std::unordered_map<std::string, PHInfo>;
+ci_unordered::map<std::string, PHZoneIndex> gPHIndex;
+std::future<void> gPHLoad;
+std::atomic<int> gPHGeneration = 0;
+
+static const PHZoneIndex* GetCurrentZonePHs()
+{
+	if (!pZoneInfo)
+		return nullptr;
+
+	auto iter = gPHIndex.find(pZoneInfo->ShortName);
+	return iter == gPHIndex.end() ? nullptr : &iter->second;
+}
 
 bool GetPhMap(SPAWNINFO* pSpawn, PHInfo* pinf)
 {
-	std::scoped_lock lock(s_mutex); // is this even needed?
+	std::scoped_lock lock(s_mutex);
 
-	if (pSpawn && gPHMap.find(pSpawn->DisplayedName) != gPHMap.end())
+	if (!pSpawn)
+		return false;
+
+	if (const PHZoneIndex* zonePHs = GetCurrentZonePHs())
 	{
-		*pinf = gPHMap[pSpawn->DisplayedName];
-		return true;
+		auto iter = zonePHs->find(pSpawn->DisplayedName);
+		if (iter != zonePHs->end())
+		{
+			*pinf = iter->second;
+			return true;
+		}
 	}
+
 	return false;
 }
 
+// For other plugins, through GetProcAddress. Whether a spawn is a placeholder in the current zone.
+PLUGIN_API bool IsPlaceholder(PlayerClient* pSpawn)
+{
+	std::scoped_lock lock(s_mutex);
+
+	const PHZoneIndex* zonePHs = GetCurrentZonePHs();
+	return pSpawn && zonePHs && zonePHs->count(pSpawn->DisplayedName) != 0;
+}
+
+// For other plugins, through GetProcAddress. Fills spawns with up to maxCount of the placeholders
+// that are up in the current zone and returns how many there are in total.
+PLUGIN_API size_t GetPlaceholderSpawns(PlayerClient** spawns, size_t maxCount)
+{
+	std::scoped_lock lock(s_mutex);
+
+	const PHZoneIndex* zonePHs = GetCurrentZonePHs();
+	if (!zonePHs || zonePHs->empty())
+		return 0;
+
+	size_t count = 0;
+	for (PlayerClient* pSpawn = pSpawnList; pSpawn; pSpawn = pSpawn->pNext)
+	{
+		if (zonePHs->count(pSpawn->DisplayedName) != 0)
+		{
+			if (spawns && count < maxCount)
+				spawns[count] = pSpawn;
+			++count;
+		}
+	}
+
+	return count;
+}
+
 class MyCTargetWnd
 {
 public:
@@ -135,15 +213,16 @@ public:
 	}
 };
 
-void LoadPHs(char* szMyName)
+void LoadPHs(const std::string& szMyName)
 {
 	// well we have it, lets fill in the map...
 	// Chief Librarian Lars^a shissar arbiter, a shissar defiler^tds^kattacastrumdeluge^https://tds.eqresource.com/chieflibrarianlars.php
+	ci_unordered::map<std::string, PHZoneIndex> phIndex;
 	PHInfo phinf;
 	std::string phs;
 	size_t commapos = 0;
 	char szBuffer[MAX_STRING] = { 0 };
-	FILE* fp = _fsopen(szMyName, "rb", _SH_DENYNO);
+	FILE* fp = _fsopen(szMyName.c_str(), "rb", _SH_DENYNO);
 	if (fp != nullptr)
 	{
 		while (fgets(szBuffer, MAX_STRING, fp) != nullptr)
@@ -198,17 +277,21 @@ void LoadPHs(char* szMyName)
 					// more than one...
 					std::string temp = phs.substr(commapos + 2, -1);
 					phs.erase(commapos, -1);
-					gPHMap[temp] = phinf;
+					phIndex[phinf.Zone][temp] = phinf;
 				}
-				gPHMap[phs] = phinf;
+				phIndex[phinf.Zone][phs] = phinf;
 			}
 			else
 			{
-				gPHMap[phs] = phinf;
+				phIndex[phinf.Zone][phs] = phinf;
 			}
 		}
 		fclose(fp);
 	}
+
+	std::scoped_lock lock(s_mutex);
+	gPHIndex = std::move(phIndex);
+	++gPHGeneration;
 }
 
 CLabelWnd* CreateDistLabel(CXWnd* parent, CControlTemplate* DistLabelTemplate, const CXStr& label,
@@ -265,6 +348,7 @@ CXRect GetCXRectTBLRFromString(const std::string& Input, int defaultTop, int def
 void CleanUp()
 {
 	bDisablePluginDueToBadUI = false;
+	gTargetDisplay = TargetDisplayState();
 
 	if (pTargetWnd)
 	{
@@ -379,7 +463,7 @@ void HandleINI(eINIOptions Operation)
 
 	if (!Initialized)
 	{
-		gBUsePerCharSettings = GetPrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
+		gBUsePerCharSettings = GetCachedPrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
 	}
 
 	if (gBUsePerCharSettings && pLocalPlayer && GetServerShortName()[0] != '\0')
@@ -392,55 +476,55 @@ void HandleINI(eINIOptions Operation)
 
 	if (Operation == eINIOptions::ReadOnly || Operation == eINIOptions::ReadAndWrite)
 	{
-		gBShowDistance = GetPrivateProfileBool(szSettingINISection, "ShowDistance", gBShowDistance, INIFileName);
-		gbShowTargetInfo = GetPrivateProfileBool(szSettingINISection, "ShowTargetInfo", gbShowTargetInfo, INIFileName);
-		gbShowPlaceholder = GetPrivateProfileBool(szSettingINISection, "ShowPlaceholder", gbShowPlaceholder, INIFileName);
-		gbShowAnon = GetPrivateProfileBool(szSettingINISection, "ShowAnon", gbShowAnon, INIFileName);
-		gbShowSight = GetPrivateProfileBool(szSettingINISection, "ShowSight", gbShowSight, INIFileName);
+		gBShowDistance = GetCachedPrivateProfileBool(szSettingINISection, "ShowDistance", gBShowDistance, INIFileName);
+		gbShowTargetInfo = GetCachedPrivateProfileBool(szSettingINISection, "ShowTargetInfo", gbShowTargetInfo, INIFileName);
+		gbShowPlaceholder = GetCachedPrivateProfileBool(szSettingINISection, "ShowPlaceholder", gbShowPlaceholder, INIFileName);
+		gbShowAnon = GetCachedPrivateProfileBool(szSettingINISection, "ShowAnon", gbShowAnon, INIFileName);
+		gbShowSight = GetCachedPrivateProfileBool(szSettingINISection, "ShowSight", gbShowSight, INIFileName);
 
-		DistanceLabelToolTip = GetPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
+		DistanceLabelToolTip = GetCachedPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
 
 		/* Also defaulted on the global and in the .ini resource */
-		Target_BuffWindow_TopOffset = GetPrivateProfileInt(strUISection, "Target_BuffWindow_TopOffset", 76, INIFileName); // see note above
-		dTopOffset = GetPrivateProfileInt(strUISection, "dTopOffset", 60, INIFileName); // see note above
-		dBottomOffset = GetPrivateProfileInt(strUISection, "dBottomOffset", 74, INIFileName); // see note above
-		dLeftOffset = GetPrivateProfileInt(strUISection, "dLeftOffset", 50, INIFileName); // see note above
-		CanSeeTopOffset = GetPrivateProfileInt(strUISection, "CanSeeTopOffset", 47, INIFileName); // see note above
-		CanSeeBottomOffset = GetPrivateProfileInt(strUISection, "CanSeeBottomOffset", 61, INIFileName); // see note above
-		TargetInfoWindowStyle = GetPrivateProfileInt(strUISection, "TargetInfoWindowStyle", 0, INIFileName); // see note above
-		TargetInfoAnchoredToRight = GetPrivateProfileInt(strUISection, "TargetInfoAnchoredToRight", 0, INIFileName); // see note above
-
-		ManaLabelName = GetPrivateProfileString(strUISection, "Label1", "Player_ManaLabel", INIFileName); // see note above
-		FatigueLabelName = GetPrivateProfileString(strUISection, "Label2", "Player_FatigueLabel", INIFileName); // see note above
-		TargetDistanceLoc = GetPrivateProfileString(strUISection, "TargetDistanceLoc", "34,48,90,0", INIFileName); // see note above
-		TargetInfoLoc = GetPrivateProfileString(strUISection, "TargetInfoLoc", "34,48,0,40", INIFileName); // see note above
+		Target_BuffWindow_TopOffset = GetCachedPrivateProfileInt(strUISection, "Target_BuffWindow_TopOffset", 76, INIFileName); // see note above
+		dTopOffset = GetCachedPrivateProfileInt(strUISection, "dTopOffset", 60, INIFileName); // see note above
+		dBottomOffset = GetCachedPrivateProfileInt(strUISection, "dBottomOffset", 74, INIFileName); // see note above
+		dLeftOffset = GetCachedPrivateProfileInt(strUISection, "dLeftOffset", 50, INIFileName); // see note above
+		CanSeeTopOffset = GetCachedPrivateProfileInt(strUISection, "CanSeeTopOffset", 47, INIFileName); // see note above
+		CanSeeBottomOffset = GetCachedPrivateProfileInt(strUISection, "CanSeeBottomOffset", 61, INIFileName); // see note above
+		TargetInfoWindowStyle = GetCachedPrivateProfileInt(strUISection, "TargetInfoWindowStyle", 0, INIFileName); // see note above
+		TargetInfoAnchoredToRight = GetCachedPrivateProfileInt(strUISection, "TargetInfoAnchoredToRight", 0, INIFileName); // see note above
+
+		ManaLabelName = GetCachedPrivateProfileString(strUISection, "Label1", "Player_ManaLabel", INIFileName); // see note above
+		FatigueLabelName = GetCachedPrivateProfileString(strUISection, "Label2", "Player_FatigueLabel", INIFileName); // see note above
+		TargetDistanceLoc = GetCachedPrivateProfileString(strUISection, "TargetDistanceLoc", "34,48,90,0", INIFileName); // see note above
+		TargetInfoLoc = GetCachedPrivateProfileString(strUISection, "TargetInfoLoc", "34,48,0,40", INIFileName); // see note above
 		/* End multiple location defaults */
 	}
 	if (Operation == eINIOptions::WriteOnly || Operation == eINIOptions::ReadAndWrite)
 	{
-		WritePrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
-
-		WritePrivateProfileBool(szSettingINISection, "ShowDistance", gBShowDistance, INIFileName);
-		WritePrivateProfileBool(szSettingINISection, "ShowTargetInfo", gbShowTargetInfo, INIFileName);
-		WritePrivateProfileBool(szSettingINISection, "ShowPlaceholder", gbShowPlaceholder, INIFileName);
-		WritePrivateProfileBool(szSettingINISection, "ShowAnon", gbShowAnon, INIFileName);
-		WritePrivateProfileBool(szSettingINISection, "ShowSight", gbShowSight, INIFileName);
-
-		WritePrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
-
-		WritePrivateProfileInt(strUISection, "Target_BuffWindow_TopOffset", Target_BuffWindow_TopOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "dTopOffset", dTopOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "dBottomOffset", dBottomOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "dLeftOffset", dLeftOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "CanSeeTopOffset", CanSeeTopOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "CanSeeBottomOffset", CanSeeBottomOffset, INIFileName);
-		WritePrivateProfileInt(strUISection, "TargetInfoWindowStyle", TargetInfoWindowStyle, INIFileName);
-		WritePrivateProfileInt(strUISection, "TargetInfoAnchoredToRight", TargetInfoAnchoredToRight, INIFileName);
-
-		WritePrivateProfileString(strUISection, "Label1", ManaLabelName, INIFileName);
-		WritePrivateProfileString(strUISection, "Label2", FatigueLabelName, INIFileName);
-		WritePrivateProfileString(strUISection, "TargetDistanceLoc", TargetDistanceLoc, INIFileName);
-		WritePrivateProfileString(strUISection, "TargetInfoLoc", TargetInfoLoc, INIFileName);
+		WriteCachedPrivateProfileString("Default", "UsePerCharSettings", gBUsePerCharSettings ? "1" : "0", INIFileName);
+
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowDistance", gBShowDistance ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowTargetInfo", gbShowTargetInfo ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowPlaceholder", gbShowPlaceholder ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowAnon", gbShowAnon ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowSight", gbShowSight ? "1" : "0", INIFileName);
+
+		WriteCachedPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip.c_str(), INIFileName);
+
+		WriteCachedPrivateProfileString(strUISection, "Target_BuffWindow_TopOffset", std::to_string(Target_BuffWindow_TopOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "dTopOffset", std::to_string(dTopOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "dBottomOffset", std::to_string(dBottomOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "dLeftOffset", std::to_string(dLeftOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "CanSeeTopOffset", std::to_string(CanSeeTopOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "CanSeeBottomOffset", std::to_string(CanSeeBottomOffset).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "TargetInfoWindowStyle", std::to_string(TargetInfoWindowStyle).c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "TargetInfoAnchoredToRight", std::to_string(TargetInfoAnchoredToRight).c_str(), INIFileName);
+
+		WriteCachedPrivateProfileString(strUISection, "Label1", ManaLabelName.c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "Label2", FatigueLabelName.c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "TargetDistanceLoc", TargetDistanceLoc.c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "TargetInfoLoc", TargetInfoLoc.c_str(), INIFileName);
 	}
 }
 
@@ -716,6 +800,7 @@ void CMD_TargetInfo(SPAWNINFO* pPlayer, char* szLine)
 
 	if (WriteIni)
 	{
+		gTargetDisplay = TargetDisplayState();
 		HandleINI(eINIOptions::WriteOnly);
 	}
 }
@@ -753,13 +838,16 @@ PLUGIN_API void InitializePlugin()
 		}
 	}
 
-	LoadPHs(curFilepath.string().data());
+	gPHLoad = std::async(std::launch::async, LoadPHs, curFilepath.string());
 
 	EzDetour(CTargetWnd__HandleBuffRemoveRequest, &MyCTargetWnd::HandleBuffRemoveRequest_Detour, &MyCTargetWnd::HandleBuffRemoveRequest_Tramp);
 }
 
 PLUGIN_API void ShutdownPlugin()
 {
+	if (gPHLoad.valid())
+		gPHLoad.wait();
+
 	CleanUp();
 	RemoveCommand("/targetinfo");
 	RemoveDetour(CTargetWnd__HandleBuffRemoveRequest);
@@ -775,129 +863,173 @@ PLUGIN_API void OnReloadUI()
 	Initialized = false;
 }
 
-PLUGIN_API void OnPulse()
+static bool UpdatePosition(float (&pos)[3], const SPAWNINFO* pSpawn)
 {
-	if (GetGameState() != GAMESTATE_INGAME || !pLocalPlayer)
-		return;
+	if (pos[0] == pSpawn->X && pos[1] == pSpawn->Y && pos[2] == pSpawn->Z)
+		return false;
 
-	static uint64_t lastPulseUpdate = MQGetTickCount64();
-	const uint64_t currentTime = MQGetTickCount64();
+	pos[0] = pSpawn->X;
+	pos[1] = pSpawn->Y;
+	pos[2] = pSpawn->Z;
+	return true;
+}
 
-	if (currentTime - lastPulseUpdate > 500) // 500ms
-	{
-		lastPulseUpdate = currentTime;
+void UpdateTargetDisplay(uint64_t currentTime)
+{
+	TargetDisplayState& state = gTargetDisplay;
 
-		if (pTargetWnd && pTargetWnd->IsVisible())
+	if (!pTarget)
+	{
+		if (state.Target || !state.Visibility)
 		{
-			Initialize();
-			if (InfoLabel && DistanceLabel && CanSeeLabel && PHButton)
-			{
-				if (pTarget)
-				{
-					if (gbShowPlaceholder)
-					{
-						if (oldspawn != pTarget)
-						{
-							oldspawn = pTarget;
-
-							PHInfo pinf;
-							if (GetPhMap(pTarget, &pinf))
-							{
-								PHButton->SetTooltip(CXStr{ pinf.Named });
-								PHButton->SetVisible(true);
-							}
-							else
-							{
-								PHButton->SetVisible(false);
-							}
-						}
-					}
-					else
-					{
-						PHButton->SetVisible(false);
-					}
-
-					char szTargetDist[EQ_MAX_NAME] = { 0 };
+			InfoLabel->SetWindowText(CXStr());
+			DistanceLabel->SetWindowText(CXStr());
+			CanSeeLabel->SetWindowText(CXStr());
+			PHButton->SetVisible(false);
+		}
 
-					if (gbShowTargetInfo)
-					{
-						switch (pTarget->Anon)
-						{
-							case 1:
-								if (gbShowAnon)
-								{
-									strcpy_s(szTargetDist, "Anonymous");
-									break;
-								}
-							case 2:
-								if (gbShowAnon)
-								{
-									strcpy_s(szTargetDist, "Roleplaying");
-									break;
-								}
-							default:
-							{
-								if (pTarget->Type == SPAWN_PLAYER)
-								{
-									sprintf_s(szTargetDist, "%d %s %s", pTarget->Level, pTarget->GetRaceString(), pTarget->GetClassThreeLetterCode());
-								}
-								else
-								{
-									sprintf_s(szTargetDist, "%d %s %s", pTarget->Level, pTarget->GetRaceString(),pTarget->GetClassString());
-								}
-							}
-						}
+		const bool visibility = state.Visibility;
+		state = TargetDisplayState();
+		state.Visibility = visibility;
+		return;
+	}
 
-						InfoLabel->SetWindowText(szTargetDist);
-					}
-					InfoLabel->SetVisible(gbShowTargetInfo);
+	if (state.Target != pTarget)
+	{
+		const bool visibility = state.Visibility;
+		state = TargetDisplayState();
+		state.Visibility = visibility;
+		state.Target = pTarget;
+	}
 
-					// then distance
-					if(gBShowDistance)
-					{
-						float dist = Distance3DToSpawn(pLocalPlayer, pTarget);
-						sprintf_s(szTargetDist, "%.2f", dist);
+	if (!state.Visibility)
+	{
+		InfoLabel->SetVisible(gbShowTargetInfo);
+		DistanceLabel->SetVisible(gBShowDistance);
+		CanSeeLabel->SetVisible(gbShowSight);
+		state.Visibility = true;
+	}
 
-						if (dist < 250)
-						{
-							DistanceLabel->SetCRNormal(MQColor(0, 255, 0)); // green
-						}
-						else
-						{
-							DistanceLabel->SetCRNormal(MQColor(255, 0, 0)); // red
-						}
+	// placeholders load in the background, so check again once they have
+	const int phGeneration = gPHGeneration;
+	if (state.PHGeneration != phGeneration)
+	{
+		state.PHGeneration = phGeneration;
 
-						DistanceLabel->SetWindowText(szTargetDist);
-					}
-					DistanceLabel->SetVisible(gBShowDistance);
+		PHInfo pinf;
+		if (gbShowPlaceholder && GetPhMap(pTarget, &pinf))
+		{
+			PHButton->SetTooltip(CXStr{ pinf.Named });
+			PHButton->SetVisible(true);
+		}
+		else
+		{
+			PHButton->SetVisible(false);
+		}
+	}
 
-					// now do can see
-					if (gbShowSight)
-					{
-						if (pLocalPlayer->CanSee(*(PlayerClient*)pTarget))
-						{
-							strcpy_s(szTargetDist, "O");
-							CanSeeLabel->SetCRNormal(MQColor(0, 255, 0)); // green
-						}
-						else
-						{
-							strcpy_s(szTargetDist, "X");
-							CanSeeLabel->SetCRNormal(MQColor(255, 0, 0)); // red
-						}
-						CanSeeLabel->SetWindowText(szTargetDist);
-					}
+	char szTargetDist[EQ_MAX_NAME] = { 0 };
 
-					CanSeeLabel->SetVisible(gbShowSight);
+	if (gbShowTargetInfo && (state.Level != pTarget->Level || state.Anon != pTarget->Anon))
+	{
+		state.Level = pTarget->Level;
+		state.Anon = pTarget->Anon;
 
+		switch (pTarget->Anon)
+		{
+			case 1:
+				if (gbShowAnon)
+				{
+					strcpy_s(szTargetDist, "Anonymous");
+					break;
+				}
+			case 2:
+				if (gbShowAnon)
+				{
+					strcpy_s(szTargetDist, "Roleplaying");
+					break;
+				}
+			default:
+			{
+				if (pTarget->Type == SPAWN_PLAYER)
+				{
+					sprintf_s(szTargetDist, "%d %s %s", pTarget->Level, pTarget->GetRaceString(), pTarget->GetClassThreeLetterCode());
 				}
 				else
 				{
-					InfoLabel->SetWindowText(CXStr());
-					DistanceLabel->SetWindowText(CXStr());
-					CanSeeLabel->SetWindowText(CXStr());
-					PHButton->SetVisible(false);
+					sprintf_s(szTargetDist, "%d %s %s", pTarget->Level, pTarget->GetRaceString(),pTarget->GetClassString());
 				}
 			}
 		}
+
+		InfoLabel->SetWindowText(szTargetDist);
+	}
+
+	const bool playerMoved = UpdatePosition(state.PlayerPos, pLocalPlayer);
+	const bool targetMoved = UpdatePosition(state.TargetPos, pTarget);
+	const bool moved = playerMoved || targetMoved;
+
+	// then distance
+	if (gBShowDistance && moved)
+	{
+		float dist = Distance3DToSpawn(pLocalPlayer, pTarget);
+		sprintf_s(szTargetDist, "%.2f", dist);
+
+		const int distanceNear = dist < 250;
+		if (state.DistanceNear != distanceNear)
+		{
+			state.DistanceNear = distanceNear;
+			DistanceLabel->SetCRNormal(distanceNear ? MQColor(0, 255, 0) : MQColor(255, 0, 0)); // green or red
+		}
+
+		if (state.Distance != szTargetDist)
+		{
+			state.Distance = szTargetDist;
+			DistanceLabel->SetWindowText(szTargetDist);
+		}
+	}
+
+	// now do can see. Line of sight is one of the more expensive checks, so the result is kept until
+	// either end moves (checked at most every 250ms), or for a second since doors and the like can change it.
+	state.SightStale |= moved;
+	if (gbShowSight
+		&& (state.CanSee < 0
+			|| (state.SightStale && currentTime - state.LastSightCheck >= 250)
+			|| currentTime - state.LastSightCheck >= 1000))
+	{
+		state.LastSightCheck = currentTime;
+		state.SightStale = false;
+
+		const int canSee = CanSeeSpawn(pLocalPlayer, pTarget);
+		if (state.CanSee != canSee)
+		{
+			state.CanSee = canSee;
+			CanSeeLabel->SetCRNormal(canSee ? MQColor(0, 255, 0) : MQColor(255, 0, 0)); // green or red
+			CanSeeLabel->SetWindowText(canSee ? "O" : "X");
+		}
+	}
+}
+
+PLUGIN_API void OnPulse()
+{
+	if (GetGameState() != GAMESTATE_INGAME || !pLocalPlayer)
+		return;
+
+	const uint64_t currentTime = MQGetTickCount64();
+
+	if (!Initialized)
+	{
+		static uint64_t lastInitializeAttempt = 0;
+		if (currentTime - lastInitializeAttempt <= 500) // 500ms
+			return;
+
+		lastInitializeAttempt = currentTime;
+		Initialize();
+	}
+
+	// Labels keep what they show while the window is hidden, so there is nothing to do until it is shown again.
+	if (pTargetWnd && pTargetWnd->IsVisible() && InfoLabel && DistanceLabel && CanSeeLabel && PHButton)
+	{
+		UpdateTargetDisplay(currentTime);
 	}
 }
@@ -8,6 +8,8 @@
 #include <mq/Plugin.h>
 #include "resource.h"
 
+#include <limits>
+
 PreSetup("MQ2XTarInfo");
 PLUGIN_VERSION(0.1);
 
@@ -28,6 +30,18 @@ std::string DistanceLabelToolTip = "XTarget Distance";
 CGaugeWnd* ETW_Gauge[MAX_EXTENDED_TARGET_SIZE] = { nullptr };
 CLabelWnd* ETW_DistLabel[MAX_EXTENDED_TARGET_SIZE] = { nullptr };
 
+// What each distance label is showing, so a label is only reformatted when its slot changes.
+struct XTargetSlotState
+{
+	uint32_t SpawnID = 0;
+	float SpawnPos[3] = { std::numeric_limits<float>::quiet_NaN() };
+	std::string Distance;
+	int Near = -1;
+	int Visible = -1;
+};
+XTargetSlotState ETW_SlotState[MAX_EXTENDED_TARGET_SIZE];
+float LastPlayerPos[3] = { std::numeric_limits<float>::quiet_NaN() };
+
 DWORD orgExtTargetWindStyle = 0;
 
 enum class eINIOptions
@@ -125,7 +139,7 @@ void HandleINI(eINIOptions Operation)
 
 	if (!Initialized)
 	{
-		gBUsePerCharSettings = GetPrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
+		gBUsePerCharSettings = GetCachedPrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
 	}
 
 	if (gBUsePerCharSettings && pLocalPlayer && GetServerShortName()[0] != '\0')
@@ -138,25 +152,25 @@ void HandleINI(eINIOptions Operation)
 
 	if (Operation == eINIOptions::ReadOnly || Operation == eINIOptions::ReadAndWrite)
 	{
-		gBShowExtDistance = GetPrivateProfileBool(szSettingINISection, "ShowDistance", gBShowExtDistance, INIFileName);
-		DistanceLabelToolTip = GetPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
+		gBShowExtDistance = GetCachedPrivateProfileBool(szSettingINISection, "ShowDistance", gBShowExtDistance, INIFileName);
+		DistanceLabelToolTip = GetCachedPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
 
 		/* Also defaulted on the global and in the .ini resource */
-		gbUseExtLayoutBox = GetPrivateProfileBool(strUISection, "UseExtLayoutBox", false, INIFileName); // see note above
-		BaseLabelName = GetPrivateProfileString(strUISection, "LabelBaseXT", "Player_ManaLabel", INIFileName); // see note above
-		ExtDistanceLoc = GetPrivateProfileString(strUISection, "ExtDistanceLoc", "0,-20,70,0", INIFileName); // see note above
+		gbUseExtLayoutBox = GetCachedPrivateProfileBool(strUISection, "UseExtLayoutBox", false, INIFileName); // see note above
+		BaseLabelName = GetCachedPrivateProfileString(strUISection, "LabelBaseXT", "Player_ManaLabel", INIFileName); // see note above
+		ExtDistanceLoc = GetCachedPrivateProfileString(strUISection, "ExtDistanceLoc", "0,-20,70,0", INIFileName); // see note above
 		/* End multiple location defaults */
 	}
 	if (Operation == eINIOptions::WriteOnly || Operation == eINIOptions::ReadAndWrite)
 	{
-		WritePrivateProfileBool("Default", "UsePerCharSettings", gBUsePerCharSettings, INIFileName);
+		WriteCachedPrivateProfileString("Default", "UsePerCharSettings", gBUsePerCharSettings ? "1" : "0", INIFileName);
 
-		WritePrivateProfileBool(szSettingINISection, "ShowDistance", gBShowExtDistance, INIFileName);
-		WritePrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip, INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "ShowDistance", gBShowExtDistance ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(szSettingINISection, "DistanceLabelToolTip", DistanceLabelToolTip.c_str(), INIFileName);
 
-		WritePrivateProfileBool(strUISection, "UseExtLayoutBox", gbUseExtLayoutBox, INIFileName);
-		WritePrivateProfileString(strUISection, "LabelBaseXT", BaseLabelName, INIFileName);
-		WritePrivateProfileString(strUISection, "ExtDistanceLoc", ExtDistanceLoc, INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "UseExtLayoutBox", gbUseExtLayoutBox ? "1" : "0", INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "LabelBaseXT", BaseLabelName.c_str(), INIFileName);
+		WriteCachedPrivateProfileString(strUISection, "ExtDistanceLoc", ExtDistanceLoc.c_str(), INIFileName);
 	}
 }
 
@@ -248,44 +262,89 @@ void Initialize()
 	}
 }
 
+void ResetExtDistanceState()
+{
+	for (auto& state : ETW_SlotState)
+	{
+		state = XTargetSlotState();
+	}
+
+	LastPlayerPos[0] = std::numeric_limits<float>::quiet_NaN();
+}
+
+bool UpdatePosition(float (&pos)[3], const SPAWNINFO* pSpawn)
+{
+	if (pos[0] == pSpawn->X && pos[1] == pSpawn->Y && pos[2] == pSpawn->Z)
+		return false;
+
+	pos[0] = pSpawn->X;
+	pos[1] = pSpawn->Y;
+	pos[2] = pSpawn->Z;
+	return true;
+}
+
+void SetSlotVisible(CLabelWnd* pWnd, XTargetSlotState& state, bool visible)
+{
+	if (state.Visible != static_cast<int>(visible))
+	{
+		state.Visible = visible;
+		pWnd->SetVisible(visible);
+	}
+}
+
 void UpdatedExtDistance()
 {
-	if (!pLocalPC)
+	if (!pLocalPC || !pLocalPlayer)
 		return;
 
 	ExtendedTargetList* xtm = pLocalPC->pXTargetMgr;
+	if (!xtm)
+		return;
+
+	const bool playerMoved = UpdatePosition(LastPlayerPos, pLocalPlayer);
 
 	for (int i = 0; i < xtm->GetNumSlots(); i++)
 	{
 		if (CLabelWnd* pWnd = ETW_DistLabel[i])
 		{
+			XTargetSlotState& state = ETW_SlotState[i];
 			const ExtendedTargetSlot& xts = *xtm->GetSlot(i);
 			uint32_t spID = xts.SpawnID;
 
-			if (spID)
+			SPAWNINFO* pSpawn = spID ? GetSpawnByID(spID) : nullptr;
+			if (!pSpawn)
 			{
-				if (SPAWNINFO* pSpawn = GetSpawnByID(spID))
-				{
-					char szTargetDist[EQ_MAX_NAME] = { 0 };
-					float dist = Distance3DToSpawn(pLocalPlayer, pSpawn);
-					sprintf_s(szTargetDist, "%.2f", dist);
+				state.SpawnID = 0;
+				SetSlotVisible(pWnd, state, false);
+				continue;
+			}
 
-					if (dist < 250)
-					{
-						pWnd->SetCRNormal(MQColor(0, 255, 0)); // green
-					}
-					else
-					{
-						pWnd->SetCRNormal(MQColor(255, 0, 0)); // red
-					}
+			// only reformat when the slot changed or either end moved
+			const bool slotChanged = state.SpawnID != spID;
+			const bool spawnMoved = UpdatePosition(state.SpawnPos, pSpawn);
+			state.SpawnID = spID;
+
+			if (slotChanged || spawnMoved || playerMoved)
+			{
+				char szTargetDist[EQ_MAX_NAME] = { 0 };
+				float dist = Distance3DToSpawn(pLocalPlayer, pSpawn);
+				sprintf_s(szTargetDist, "%.2f", dist);
+
+				const int isNear = dist < 250;
+				if (state.Near != isNear)
+				{
+					state.Near = isNear;
+					pWnd->SetCRNormal(isNear ? MQColor(0, 255, 0) : MQColor(255, 0, 0)); // green or red
+				}
 
+				if (state.Distance != szTargetDist)
+				{
+					state.Distance = szTargetDist;
 					pWnd->SetWindowText(szTargetDist);
-					pWnd->SetVisible(true);
-					continue;
 				}
 			}
 
-			pWnd->SetVisible(false);
+			SetSlotVisible(pWnd, state, true);
 		}
 	}
 }
@@ -293,6 +352,7 @@ void UpdatedExtDistance()
 void CleanUp()
 {
 	bDisablePluginDueToBadUI = false;
+	ResetExtDistanceState();
 
 	if (CXWnd* pExtWnd = FindMQ2Window("ExtendedTargetWnd"))
 	{
@@ -347,6 +407,7 @@ void CMD_XTarInfo(SPAWNINFO* pPlayer, char* szLine)
 				label->SetVisible(gBShowExtDistance);
 			}
 		}
+		ResetExtDistanceState();
 		WriteIni = true;
 	}
 	else if (ci_equals(szArg1, "reset"))
@@ -398,17 +459,21 @@ PLUGIN_API void OnPulse()
 	if (GetGameState() != GAMESTATE_INGAME || !pLocalPC)
 		return;
 
-	static uint64_t lastPulseUpdate = MQGetTickCount64();
-	uint64_t currentTime = MQGetTickCount64();
-
-	if (currentTime - lastPulseUpdate > 500) // 500ms
+	if (!Initialized)
 	{
-		lastPulseUpdate = currentTime;
+		static uint64_t lastInitializeAttempt = 0;
+		uint64_t currentTime = MQGetTickCount64();
+
+		if (currentTime - lastInitializeAttempt <= 500) // 500ms
+			return;
+
+		lastInitializeAttempt = currentTime;
 		Initialize();
+	}
 
-		if (gBShowExtDistance && ETW_DistLabel[0] && pExtendedTargetWnd && pExtendedTargetWnd->IsVisible())
-		{
-			UpdatedExtDistance();
-		}
+	// Each slot is compared against what its label shows, so this is cheap to do every pulse.
+	if (gBShowExtDistance && ETW_DistLabel[0] && pExtendedTargetWnd && pExtendedTargetWnd->IsVisible())
+	{
+		UpdatedExtDistance();
 	}
 }
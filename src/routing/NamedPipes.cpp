@@ -60,11 +60,60 @@ PipeMessage::PipeMessage(const PipeMessage& message, const void* data, size_t le
 	SetConnection(message.m_connection.lock());
 }
 
+PipeMessage::PipeMessage(MQMessageId messageId, std::initializer_list<std::string_view> parts)
+{
+	size_t length = 0;
+	for (std::string_view part : parts)
+		length += part.size();
+
+	Init(messageId, nullptr, length);
+
+	uint8_t* pos = m_buffer.get() + m_dataOffset;
+	for (std::string_view part : parts)
+	{
+		memcpy(pos, part.data(), part.size());
+		pos += part.size();
+	}
+}
+
+PipeMessage::PipeMessage(PipeMessage&& message, const void* data, size_t length)
+{
+	const uint8_t* slice = static_cast<const uint8_t*>(data);
+	const uint8_t* begin = message.m_buffer.get() + message.m_dataOffset;
+	const uint8_t* end = message.m_buffer.get() + message.m_bufferLength;
+
+	if (message.m_header == nullptr || (length > 0 && (slice < begin || slice + length > end)))
+	{
+		// not part of the message, so there is nothing to take over
+		if (message.m_header)
+			Init(*message.m_header, data, length);
+		else
+			Init(message.GetMessageId(), data, length);
+	}
+	else
+	{
+		m_buffer = std::move(message.m_buffer);
+		m_bufferLength = message.m_bufferLength;
+		m_header = message.m_header;
+		m_dataOffset = length > 0 ? slice - m_buffer.get() : m_bufferLength;
+		m_dataLength = length;
+		m_valid = message.m_valid;
+
+		message.m_bufferLength = 0;
+		message.m_header = nullptr;
+		message.m_dataOffset = 0;
+		message.m_dataLength = 0;
+		message.m_valid = false;
+	}
+
+	SetConnection(message.m_connection.lock());
+}
+
 PipeMessage::~PipeMessage()
 {
 }
 
-bool PipeMessage::Parse(std::unique_ptr<uint8_t[]> buffer, size_t length)
+bool PipeMessage::Parse(PipeBuffer buffer, size_t length)
 {
 	if (length == 0)
 		return false;
@@ -88,6 +137,7 @@ bool PipeMessage::Parse(std::unique_ptr<uint8_t[]> buffer, size_t length)
 		if (m_header->messageLength != length)
 			return false;
 
+		m_dataLength = length;
 		m_buffer = std::move(buffer);
 		m_valid = true;
 		return true;
@@ -96,7 +146,7 @@ bool PipeMessage::Parse(std::unique_ptr<uint8_t[]> buffer, size_t length)
 	return false;
 }
 
-bool PipeMessage::Parse(const std::vector<std::pair<std::unique_ptr<uint8_t[]>, size_t>>& buffers)
+bool PipeMessage::Parse(const std::vector<std::pair<PipeBuffer, size_t>>& buffers, PipeBufferPool* pool)
 {
 	// calculate length
 	size_t length = std::accumulate(std::begin(buffers), std::end(buffers),
@@ -105,7 +155,7 @@ bool PipeMessage::Parse(const std::vector<std::pair<std::unique_ptr<uint8_t[]>,
 		return false;
 
 	// allocate buffer and combine buffers into single.
-	auto buffer = std::make_unique<uint8_t[]>(length);
+	PipeBuffer buffer = pool ? pool->Acquire(length) : PipeBuffer(new uint8_t[length]);
 	uint8_t* pos = buffer.get();
 
 	for (auto& [buffer, size] : buffers)
@@ -120,10 +170,11 @@ bool PipeMessage::Parse(const std::vector<std::pair<std::unique_ptr<uint8_t[]>,
 void PipeMessage::Init(const void* data, size_t length)
 {
 	m_dataOffset = sizeof(MQMessageHeader);
+	m_dataLength = length;
 	m_bufferLength = length + m_dataOffset;
 
 	// initialize buffer and header
-	m_buffer = std::make_unique<uint8_t[]>(m_bufferLength);
+	m_buffer = PipeBuffer(new uint8_t[m_bufferLength]());
 	m_header = reinterpret_cast<MQMessageHeader*>(m_buffer.get());
 
 	if (data && length > 0)
@@ -188,6 +239,21 @@ void PipeMessage::SendReply(MQMessageId messageId, void* data, size_t length, ui
 	}
 }
 
+void PipeMessage::SendReply(PipeMessagePtr&& reply, uint8_t status)
+{
+	if (m_header && m_header->mode == MQRequestMode::CallAndResponse && !m_replied && reply->GetHeader())
+	{
+		reply->GetHeader()->mode = MQRequestMode::MessageReply;
+		reply->GetHeader()->status = status;
+		reply->GetHeader()->sequenceId = m_header->sequenceId;
+
+		if (auto connection = m_connection.lock())
+		{
+			connection->SendMessage(std::move(reply));
+		}
+	}
+}
+
 //============================================================================
 
 mq::PipeMessagePtr MakeSimpleMessageV0(MQMessageId messageId, const void* data, size_t dataLength)
@@ -218,6 +284,10 @@ mq::PipeMessagePtr MakeCallResponseReplyV0(MQMessageId messageId, const void* da
 // PipeConnection
 //============================================================================
 
+// Largest batch of messages that goes out in a single write. Messages that are larger than this
+// are written on their own.
+static constexpr size_t MAX_BATCH_SIZE = 64 * 1024;
+
 int PipeConnection::s_nextConnectionId = 1;
 
 PipeConnection::PipeConnection(NamedPipeEndpointBase* parent, wil::unique_hfile hPipe)
@@ -256,7 +326,7 @@ void PipeConnection::InternalBeginRead()
 
 	if (!m_readBuffer)
 	{
-		m_readBuffer = std::make_unique<uint8_t[]>(BUFFER_SIZE);
+		m_readBuffer = m_parent->m_bufferPool->Acquire(BUFFER_SIZE);
 		m_readBufferSize = BUFFER_SIZE;
 	}
 
@@ -290,14 +360,29 @@ void PipeConnection::ProcessBuffers()
 	// Check if we've got any buffers.
 	if (!m_readBuffers.empty())
 	{
-		size_t size = 0;
-		for (const auto& p : m_readBuffers)
-			size += p.second;
-
 		auto message = std::make_unique<PipeMessage>();
-		if (message->Parse(m_readBuffers))
+		bool parsed;
+
+		if (m_readBuffers.size() == 1)
 		{
-			InternalReceiveMessage(std::move(message));
+			// The whole message came in one read, so it takes over the read buffer and the next
+			// read gets another one from the pool.
+			parsed = message->Parse(std::move(m_readBuffers[0].first), m_readBuffers[0].second);
+		}
+		else
+		{
+			parsed = message->Parse(m_readBuffers, m_parent->m_bufferPool.get());
+
+			// Reclaim a buffer
+			m_readBuffer = std::move(m_readBuffers[0].first);
+		}
+
+		if (parsed)
+		{
+			if (message->GetMessageId() == MQMessageId::MSG_BATCH)
+				InternalReceiveBatch(*message);
+			else
+				InternalReceiveMessage(std::move(message));
 		}
 		else
 		{
@@ -305,10 +390,6 @@ void PipeConnection::ProcessBuffers()
 				m_connectionId);
 		}
 
-		// Reclaim a buffer
-		m_readBuffer = std::move(m_readBuffers[0].first);
-		m_readBufferSize = m_readBuffers[0].second;
-
 		m_readBuffers.clear();
 	}
 }
@@ -385,25 +466,38 @@ void PipeConnection::SendMessage(PipeMessagePtr&& message)
 		});
 }
 
+void PipeConnection::SendMessage(const SharedPipeMessagePtr& message)
+{
+	std::weak_ptr<PipeConnection> weakPtr = shared_from_this();
+
+	m_parent->PostToPipeThread([message, weakPtr]()
+		{
+			if (auto ptr = weakPtr.lock())
+			{
+				ptr->InternalSendMessage(message);
+			}
+		});
+}
+
 void PipeConnection::SendMessageWithResponse(MQMessageId messageId, const void* data, size_t dataLength,
-	const PipeMessageResponseCb& response)
+	const PipeMessageResponseCb& response, std::chrono::milliseconds timeout /* = DEFAULT_RPC_TIMEOUT */)
 {
-	SendMessageWithResponse(MakeCallResponseMessageV0(messageId, data, dataLength), response);
+	SendMessageWithResponse(MakeCallResponseMessageV0(messageId, data, dataLength), response, timeout);
 }
 
 void PipeConnection::SendMessageWithResponse(PipeMessagePtr&& message,
-	const PipeMessageResponseCb& callback)
+	const PipeMessageResponseCb& callback, std::chrono::milliseconds timeout /* = DEFAULT_RPC_TIMEOUT */)
 {
 	std::weak_ptr<PipeConnection> weakPtr = shared_from_this();
 	auto parent = m_parent;
 
-	m_parent->PostToPipeThread([message = message.release(), callback, weakPtr, parent]() mutable
+	m_parent->PostToPipeThread([message = message.release(), callback, timeout, weakPtr, parent]() mutable
 		{
 			if (auto ptr = weakPtr.lock())
 			{
 				auto msg = std::unique_ptr<PipeMessage>(message);
 				msg->SetRequestMode(MQRequestMode::CallAndResponse);
-				ptr->InternalSendMessage(std::move(msg), callback);
+				ptr->InternalSendMessage(std::move(msg), callback, timeout);
 			}
 			else
 			{
@@ -419,7 +513,7 @@ void PipeConnection::Close()
 }
 
 void PipeConnection::InternalSendMessage(PipeMessagePtr&& message,
-	const PipeMessageResponseCb& callback /* = nullptr */)
+	const PipeMessageResponseCb& callback /* = nullptr */, std::chrono::milliseconds timeout /* = DEFAULT_RPC_TIMEOUT */)
 {
 	// this function *must* be called on the named pipe server thread
 	assert(std::this_thread::get_id() == m_parent->pipe_thread_id());
@@ -450,15 +544,62 @@ void PipeConnection::InternalSendMessage(PipeMessagePtr&& message,
 		RpcRequest request;
 		request.callback = callback;
 		request.sequenceId = message->GetSequenceId();
-		request.sendTime = std::chrono::steady_clock::now();
+		request.deadline = std::chrono::steady_clock::now() + timeout;
+		m_nextDeadline = std::min(m_nextDeadline, request.deadline);
 		m_rpcRequests.emplace(request.sequenceId, std::move(request));
 	}
 
+	if (m_sharedMemoryWritable)
+	{
+		m_parent->m_messagesSent += m_sharedMemory->Send(std::move(message));
+		return;
+	}
+
 	auto queuedOp = std::make_unique<QueuedOp>();
 	queuedOp->message = std::move(message);
 
-	m_writeQueue.push_back(std::move(queuedOp));
-	InternalBeginSend();
+	InternalQueueWrite(std::move(queuedOp));
+}
+
+void PipeConnection::InternalSendMessage(const SharedPipeMessagePtr& message)
+{
+	// this function *must* be called on the named pipe server thread
+	assert(std::this_thread::get_id() == m_parent->pipe_thread_id());
+	assert(message->GetRequestMode() == MQRequestMode::SimpleMessage);
+
+	if (!m_hPipe)
+	{
+		SPDLOG_WARN("Tried to send a message but the pipe was closed. connectionId={}",
+			m_connectionId);
+		m_parent->CloseConnection(this);
+		return;
+	}
+
+	if (m_sharedMemoryWritable)
+	{
+		m_parent->m_messagesSent += m_sharedMemory->Send(message);
+		return;
+	}
+
+	auto queuedOp = std::make_unique<QueuedOp>();
+	queuedOp->sharedMessage = message;
+
+	InternalQueueWrite(std::move(queuedOp));
+}
+
+void PipeConnection::InternalQueueWrite(std::unique_ptr<QueuedOp>&& op)
+{
+	m_writeQueue.push_back(std::move(op));
+
+	if (!m_parent->m_deferWrites)
+	{
+		InternalBeginSend();
+	}
+	else if (!m_writeDeferred)
+	{
+		m_writeDeferred = true;
+		m_parent->m_deferredWrites.push_back(weak_from_this());
+	}
 }
 
 void PipeConnection::InternalBeginSend()
@@ -469,13 +610,19 @@ void PipeConnection::InternalBeginSend()
 	if (m_writeQueue.empty())
 		return;
 
+	// everything that queued up behind the last write goes out together
+	if (m_peerAcceptsBatches && m_writeQueue.size() > 1)
+		CoalesceWrites();
+
 	QueuedOp* op = m_writeQueue[0].get();
 	op->ref = shared_from_this();
 	ZeroMemory(&op->overlapped, sizeof(OVERLAPPED));
 	op->overlapped.hEvent = reinterpret_cast<HANDLE>(op);
 	m_pendingWrite = true;
 
-	bool writeStarted = ::WriteFileEx(m_hPipe.get(), op->message->buffer(), static_cast<DWORD>(op->message->buffer_size()), &op->overlapped,
+	const PipeMessage& message = op->GetMessage();
+
+	bool writeStarted = ::WriteFileEx(m_hPipe.get(), message.buffer(), static_cast<DWORD>(message.buffer_size()), &op->overlapped,
 		[](DWORD dwErrorCode, DWORD dwNumberOfBytesTransferred, LPOVERLAPPED lpOverlapped)
 	{
 		QueuedOp* op = reinterpret_cast<QueuedOp*>(lpOverlapped->hEvent);
@@ -503,8 +650,8 @@ void PipeConnection::HandleWriteComplete(QueuedOp* op, uint32_t dwErrorCode, uin
 	// Remove the op from the queue.
 	assert(op == m_writeQueue[0].get());
 
-	const auto& reply = op->message;
-	size_t bytesWritten = reply->buffer_size();
+	size_t bytesWritten = op->GetMessage().buffer_size();
+	const size_t messageCount = op->messageCount;
 
 	// this will delete the op
 	m_writeQueue.pop_front();
@@ -521,9 +668,91 @@ void PipeConnection::HandleWriteComplete(QueuedOp* op, uint32_t dwErrorCode, uin
 	SPDLOG_TRACE("PipeConnection::HandleWriteComplete: dwErrorCode={} dwNumBytes={} connectionId={}",
 		dwErrorCode, dwNumBytes, m_connectionId);
 
+	m_parent->m_messagesSent += messageCount;
+
 	InternalBeginSend();
 }
 
+void PipeConnection::AnnounceBatches()
+{
+	InternalSendMessage(MakeSimpleMessageV0(MQMessageId::MSG_BATCH, nullptr, 0));
+}
+
+void PipeConnection::CoalesceWrites()
+{
+	size_t count = 0;
+	size_t length = 0;
+
+	for (const auto& op : m_writeQueue)
+	{
+		const size_t size = op->GetMessage().buffer_size();
+		if (count > 0 && length + size > MAX_BATCH_SIZE)
+			break;
+
+		length += size;
+		++count;
+	}
+
+	if (count < 2)
+		return;
+
+	auto batch = std::make_unique<QueuedOp>();
+	batch->message = MakeSimpleMessageV0(MQMessageId::MSG_BATCH, nullptr, length);
+	batch->messageCount = count;
+
+	uint8_t* pos = batch->message->m_buffer.get() + batch->message->m_dataOffset;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const PipeMessage& message = m_writeQueue.front()->GetMessage();
+		memcpy(pos, message.buffer(), message.buffer_size());
+		pos += message.buffer_size();
+
+		m_writeQueue.pop_front();
+	}
+
+	m_writeQueue.push_front(std::move(batch));
+}
+
+void PipeConnection::InternalReceiveBatch(const PipeMessage& batch)
+{
+	// even an empty one means that the other side can split them
+	m_peerAcceptsBatches = true;
+
+	const uint8_t* pos = batch.get<uint8_t>();
+	size_t remaining = batch.size();
+
+	// handling a message can close the connection
+	while (remaining > 0 && m_hPipe)
+	{
+		const MQMessageHeader* header = reinterpret_cast<const MQMessageHeader*>(pos);
+		if (remaining < sizeof(MQMessageHeader) || remaining - sizeof(MQMessageHeader) < header->messageLength)
+		{
+			SPDLOG_WARN("PipeConnection::InternalReceiveBatch: Truncated message in batch: connectionId={}",
+				m_connectionId);
+			break;
+		}
+
+		const size_t length = sizeof(MQMessageHeader) + header->messageLength;
+
+		PipeBuffer buffer = m_parent->m_bufferPool->Acquire(length);
+		memcpy(buffer.get(), pos, length);
+
+		auto message = std::make_unique<PipeMessage>();
+		if (!message->Parse(std::move(buffer), length))
+		{
+			SPDLOG_WARN("PipeConnection::InternalReceiveBatch: Failed to parse message in batch: connectionId={}",
+				m_connectionId);
+		}
+		else if (message->GetMessageId() != MQMessageId::MSG_BATCH) // the announcement can end up in one
+		{
+			InternalReceiveMessage(std::move(message));
+		}
+
+		pos += length;
+		remaining -= length;
+	}
+}
+
 bool PipeConnection::InternalClose(bool disconnect)
 {
 	if (!m_hPipe)
@@ -534,9 +763,12 @@ bool PipeConnection::InternalClose(bool disconnect)
 
 	::CancelIoEx(m_hPipe.get(), &m_overlapped);
 
-	for (const auto& [sequenceId, rpcRequest] : m_rpcRequests)
+	// everything still waiting on this connection fails together, on the main thread like any
+	// other response
+	for (auto& [sequenceId, rpcRequest] : m_rpcRequests)
 	{
-		rpcRequest.callback(MsgError_ConnectionClosed, nullptr);
+		m_parent->PostToMainThread(
+			[callback = std::move(rpcRequest.callback)]() { callback(MsgError_ConnectionClosed, nullptr); });
 	}
 
 	if (disconnect)
@@ -549,14 +781,27 @@ bool PipeConnection::InternalClose(bool disconnect)
 	}
 
 	m_rpcRequests.clear();
+	m_nextDeadline = std::chrono::steady_clock::time_point::max();
+	m_expiredRequests.clear();
 	m_hPipe.reset();
+
+	m_sharedMemory.reset();
+	m_sharedMemoryReadable = false;
+	m_sharedMemoryWritable = false;
 	return true;
 }
 
 void PipeConnection::InternalReceiveMessage(PipeMessagePtr&& message)
 {
+	++m_parent->m_messagesReceived;
 	message->SetConnection(shared_from_this());
 
+	if (message->GetMessageId() == MQMessageId::MSG_SHARED_MEMORY)
+	{
+		HandleSharedMemoryMessage(*message);
+		return;
+	}
+
 	if (message->GetRequestMode() == MQRequestMode::MessageReply)
 	{
 		// Check if sequence id is in our map
@@ -574,12 +819,175 @@ void PipeConnection::InternalReceiveMessage(PipeMessagePtr&& message)
 
 			return;
 		}
+
+		auto expired = std::find(m_expiredRequests.begin(), m_expiredRequests.end(), message->GetHeader()->sequenceId);
+		if (expired != m_expiredRequests.end())
+		{
+			// its callback has already been told that it timed out
+			m_expiredRequests.erase(expired);
+			return;
+		}
 	}
 
 	// if we get here with a reply, we didn't have a callback -- so it needs to be routed
 	m_parent->DispatchMessage(std::move(message));
 }
 
+DWORD PipeConnection::ExpireRequests(std::chrono::steady_clock::time_point now)
+{
+	// this function *must* be called on the named pipe thread
+	assert(std::this_thread::get_id() == m_parent->pipe_thread_id());
+
+	// only as many late replies are remembered as would plausibly still arrive
+	static constexpr size_t MAX_EXPIRED_REQUESTS = 256;
+
+	if (now >= m_nextDeadline)
+	{
+		m_nextDeadline = std::chrono::steady_clock::time_point::max();
+
+		for (auto iter = m_rpcRequests.begin(); iter != m_rpcRequests.end();)
+		{
+			if (iter->second.deadline <= now)
+			{
+				SPDLOG_DEBUG("PipeConnection: request timed out. connectionId={} sequenceId={}",
+					m_connectionId, iter->first);
+
+				m_parent->PostToMainThread(
+					[callback = std::move(iter->second.callback)]() { callback(MsgError_Timeout, nullptr); });
+
+				m_expiredRequests.push_back(iter->first);
+				if (m_expiredRequests.size() > MAX_EXPIRED_REQUESTS)
+					m_expiredRequests.pop_front();
+
+				iter = m_rpcRequests.erase(iter);
+			}
+			else
+			{
+				m_nextDeadline = std::min(m_nextDeadline, iter->second.deadline);
+				++iter;
+			}
+		}
+	}
+
+	if (m_nextDeadline == std::chrono::steady_clock::time_point::max())
+		return INFINITE;
+
+	// round up, so that we don't wake up just before the deadline and spin
+	auto wait = std::chrono::ceil<std::chrono::milliseconds>(m_nextDeadline - now);
+	return static_cast<DWORD>(std::min<int64_t>(wait.count(), INFINITE - 1));
+}
+
+void PipeConnection::OfferSharedMemory()
+{
+	// this function *must* be called on the named pipe thread
+	assert(std::this_thread::get_id() == m_parent->pipe_thread_id());
+
+	static uint32_t s_nextChannelId = 1;
+
+	MQMessageSharedMemory offer;
+	offer.processId = ::GetCurrentProcessId();
+	offer.channelId = s_nextChannelId++;
+	offer.capacity = SHARED_MEMORY_CHANNEL_CAPACITY;
+
+	m_sharedMemory = SharedMemoryChannel::Create(offer.processId, offer.channelId, offer.capacity);
+	if (!m_sharedMemory)
+		return;
+
+	InternalSendMessage(MakeCallResponseMessageV0(MQMessageId::MSG_SHARED_MEMORY, &offer, sizeof(offer)));
+}
+
+void PipeConnection::HandleSharedMemoryMessage(const PipeMessage& message)
+{
+	switch (message.GetRequestMode())
+	{
+	case MQRequestMode::CallAndResponse: {
+		// The server got an offer from the client
+		uint8_t status = 1;
+
+		if (message.size() >= sizeof(MQMessageSharedMemory) && !m_sharedMemory && m_parent->CanOpenSharedMemory())
+		{
+			const MQMessageSharedMemory* offer = message.get<MQMessageSharedMemory>();
+
+			// only a channel that the process on the other end of the pipe made
+			if (offer->processId == m_processId)
+			{
+				m_sharedMemory = SharedMemoryChannel::Open(offer->processId, offer->channelId, offer->capacity);
+				if (m_sharedMemory)
+					status = 0;
+			}
+		}
+
+		InternalSendMessage(MakeCallResponseReplyV0(MQMessageId::MSG_SHARED_MEMORY, nullptr, 0,
+			message.GetSequenceId(), status));
+
+		m_sharedMemoryWritable = m_sharedMemory != nullptr;
+
+		SPDLOG_DEBUG("PipeConnection: shared memory {} connectionId={} pid={}",
+			m_sharedMemory ? "opened" : "refused", m_connectionId, m_processId);
+		break;
+	}
+
+	case MQRequestMode::MessageReply:
+		// The client hears back from the server about its offer
+		if (message.GetHeader()->status == 0 && m_sharedMemory)
+		{
+			InternalSendMessage(MakeSimpleMessageV0(MQMessageId::MSG_SHARED_MEMORY, nullptr, 0));
+
+			m_sharedMemoryReadable = true;
+			m_sharedMemoryWritable = true;
+
+			ProcessSharedMemory();
+		}
+		else
+		{
+			m_sharedMemory.reset();
+		}
+		break;
+
+	case MQRequestMode::SimpleMessage:
+		// The server has every message the client sent on the pipe
+		if (m_sharedMemory)
+		{
+			m_sharedMemoryReadable = true;
+
+			ProcessSharedMemory();
+		}
+		break;
+	}
+}
+
+void PipeConnection::ProcessSharedMemory()
+{
+	// this function *must* be called on the named pipe thread
+	assert(std::this_thread::get_id() == m_parent->pipe_thread_id());
+
+	if (!m_sharedMemory)
+		return;
+
+	if (m_sharedMemoryWritable)
+		m_parent->m_messagesSent += m_sharedMemory->Flush();
+
+	if (m_sharedMemoryReadable)
+	{
+		// Handling a message can close the connection, which takes the channel with it.
+		while (m_sharedMemory)
+		{
+			PipeMessagePtr message = m_sharedMemory->Receive(*m_parent->m_bufferPool);
+			if (!message)
+				break;
+
+			InternalReceiveMessage(std::move(message));
+		}
+
+		if (m_sharedMemory && m_sharedMemory->HasFailed())
+		{
+			SPDLOG_ERROR("PipeConnection::ProcessSharedMemory: shared memory is corrupt. connectionId={}",
+				m_connectionId);
+			Close();
+		}
+	}
+}
+
 //============================================================================
 // NamedPipeThreadBase
 //============================================================================
@@ -587,6 +995,7 @@ void PipeConnection::InternalReceiveMessage(PipeMessagePtr&& message)
 NamedPipeEndpointBase::NamedPipeEndpointBase(std::string threadName, std::string pipeName)
 	: m_threadName(std::move(threadName))
 	, m_pipeName(std::move(pipeName))
+	, m_bufferPool(std::make_shared<PipeBufferPool>())
 {
 	m_interruptEvent.create();
 }
@@ -662,24 +1071,7 @@ void NamedPipeEndpointBase::DispatchMessage(PipeMessagePtr&& message)
 		});
 }
 
-static inline void ProcessQueuedCallbacks(std::mutex& mutex, std::atomic_bool& dirty, std::vector<std::function<void()>>& callbacks)
-{
-	bool expected = true;
-	if (!dirty.compare_exchange_weak(expected, false))
-		return;
-
-	std::unique_lock<std::mutex> lock(mutex);
-	if (callbacks.empty())
-		return;
-
-	std::vector<std::function<void()>> temp;
-	std::swap(temp, callbacks);
-
-	lock.unlock();
-
-	for (const auto& cb : temp)
-		cb();
-}
+static constexpr std::chrono::milliseconds MainThreadQueueBudget{ 4 };
 
 void NamedPipeEndpointBase::PostToPipeThread(std::function<void()>&& callback)
 {
@@ -689,11 +1081,7 @@ void NamedPipeEndpointBase::PostToPipeThread(std::function<void()>&& callback)
 	}
 	else
 	{
-		{
-			std::scoped_lock lock(m_threadQueueMutex);
-			m_threadQueue.push_back(std::move(callback));
-			m_threadQueueDirty = true;
-		}
+		m_threadQueue.Push(std::move(callback));
 		m_interruptEvent.SetEvent();
 	}
 }
@@ -702,7 +1090,23 @@ void NamedPipeEndpointBase::ProcessPipeThreadQueue()
 {
 	assert(std::this_thread::get_id() == m_pipeThreadId);
 
-	ProcessQueuedCallbacks(m_threadQueueMutex, m_threadQueueDirty, m_threadQueue);
+	m_deferWrites = true;
+	m_threadQueue.Consume([](std::function<void()>& cb) { cb(); });
+	m_deferWrites = false;
+
+	std::vector<std::weak_ptr<PipeConnection>> deferredWrites;
+	std::swap(deferredWrites, m_deferredWrites);
+
+	for (const auto& weakPtr : deferredWrites)
+	{
+		if (auto connection = weakPtr.lock())
+		{
+			connection->m_writeDeferred = false;
+
+			if (connection->IsNamedPipeOpen())
+				connection->InternalBeginSend();
+		}
+	}
 }
 
 void NamedPipeEndpointBase::PostToMainThread(std::function<void()>&& callback)
@@ -713,11 +1117,7 @@ void NamedPipeEndpointBase::PostToMainThread(std::function<void()>&& callback)
 	}
 	else
 	{
-		{
-			std::scoped_lock lock(m_mainQueueMutex);
-			m_mainQueue.push_back(std::move(callback));
-			m_mainQueueDirty = true;
-		}
+		m_mainQueue.Push(std::move(callback));
 
 		if (m_handler)
 		{
@@ -730,7 +1130,7 @@ void NamedPipeEndpointBase::ProcessMainThreadQueue()
 {
 	assert(std::this_thread::get_id() == m_mainThreadId);
 
-	ProcessQueuedCallbacks(m_mainQueueMutex, m_mainQueueDirty, m_mainQueue);
+	m_mainQueue.ConsumeFor([](std::function<void()>& cb) { cb(); }, MainThreadQueueBudget);
 }
 
 //============================================================================
@@ -753,22 +1153,40 @@ NamedPipeServer::~NamedPipeServer()
 
 void NamedPipeServer::NamedPipeThread()
 {
-	HANDLE waitEvents[2] =
-	{
-		m_connectEvent.get(),
-		m_interruptEvent.get(),
-	};
-
 	// initiate by creating the pipe
 	bool bPending = CreateAndConnect();
 
 	while (IsRunning())
 	{
-		// Waiting here will result in three things:
+		m_waitEvents.clear();
+		m_waitEvents.push_back(m_connectEvent.get());
+		m_waitEvents.push_back(m_interruptEvent.get());
+
+		m_waitConnections.clear();
+		DWORD timeout = INFINITE;
+		{
+			const auto now = std::chrono::steady_clock::now();
+
+			std::scoped_lock<std::mutex> lock(m_mutex);
+			for (const auto& connection : m_connections)
+			{
+				timeout = std::min(timeout, connection->ExpireRequests(now));
+
+				if (HANDLE hEvent = connection->GetSharedMemoryEvent())
+				{
+					m_waitEvents.push_back(hEvent);
+					m_waitConnections.push_back(connection);
+				}
+			}
+		}
+
+		// Waiting here will result in four things:
 		// 1. A connection event (a new incoming connection)
 		// 2. A stop event (server shutting down)
 		// 3. A background task being completed and executed while we wait.
-		DWORD dwWait = WaitForMultipleObjectsEx(2, waitEvents, FALSE, INFINITE, TRUE);
+		// 4. A client wrote to, or made room in, its shared memory channel.
+		// 5. A request's deadline came up (the requests are expired at the top of the loop).
+		DWORD dwWait = WaitForMultipleObjectsEx(static_cast<DWORD>(m_waitEvents.size()), m_waitEvents.data(), FALSE, timeout, TRUE);
 
 		switch (dwWait)
 		{
@@ -792,6 +1210,7 @@ void NamedPipeServer::NamedPipeThread()
 				// create new connection object and pass the pipe off to it.
 				auto connection = std::make_shared<PipeConnection>(this, std::move(m_hPipe));
 				connection->StartRead();
+				connection->AnnounceBatches();
 
 				std::scoped_lock<std::mutex> lock(m_mutex);
 				m_connections.push_back(connection);
@@ -823,11 +1242,22 @@ void NamedPipeServer::NamedPipeThread()
 			// This allows the system to execute the completion routine.
 			break;
 
+		case WAIT_TIMEOUT:
+			break;
+
 		default:
+			if (dwWait >= WAIT_OBJECT_0 + 2 && dwWait < WAIT_OBJECT_0 + m_waitEvents.size())
+			{
+				m_waitConnections[dwWait - WAIT_OBJECT_0 - 2]->ProcessSharedMemory();
+				break;
+			}
+
 			throw fmt::windows_error(GetLastError(), "Failed in WaitForMultipleObjectsEx");
 		}
 	}
 
+	m_waitConnections.clear();
+
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
 		if (!m_connections.empty())
@@ -935,6 +1365,20 @@ void NamedPipeServer::CloseConnection(PipeConnection* connection)
 		m_connections.end());
 }
 
+// Every channel's event is waited on along with the connect and interrupt events, and a wait can
+// only take so many.
+bool NamedPipeServer::CanOpenSharedMemory() const
+{
+	if (!IsSharedMemoryEnabled())
+		return false;
+
+	std::scoped_lock<std::mutex> lock(m_mutex);
+
+	const size_t channels = std::count_if(std::begin(m_connections), std::end(m_connections),
+		[](const std::shared_ptr<PipeConnection>& ptr) { return ptr->GetSharedMemoryEvent() != nullptr; });
+	return channels + 2 < MAXIMUM_WAIT_OBJECTS;
+}
+
 int NamedPipeServer::GetConnectionCount() const
 {
 	std::scoped_lock<std::mutex> lock(m_mutex);
@@ -1025,12 +1469,12 @@ void NamedPipeServer::SendMessage(int connectionId, MQMessageId messageId, const
 
 void NamedPipeServer::BroadcastMessage(PipeMessagePtr&& message)
 {
+	message->SetRequestMode(MQRequestMode::SimpleMessage);
+	const SharedPipeMessagePtr shared = std::move(message);
+
 	for (const auto& connection : m_connections)
 	{
-		// force the copy here instead of downstream (because we only want to do this in broadcast)
-		connection->SendMessage(
-			std::make_unique<PipeMessage>(*message->GetHeader(), message->get(), message->size())
-		);
+		connection->SendMessage(shared);
 	}
 }
 
@@ -1053,10 +1497,6 @@ NamedPipeClient::~NamedPipeClient()
 
 void NamedPipeClient::NamedPipeThread()
 {
-	HANDLE waitEvents[1] = {
-		m_interruptEvent.get(),
-	};
-
 	while (IsRunning())
 	{
 		// First loop will try to establish a connection
@@ -1091,6 +1531,10 @@ void NamedPipeClient::NamedPipeThread()
 				{
 					m_connection = std::make_shared<PipeConnection>(this, std::move(hPipe));
 					m_connection->StartRead();
+					m_connection->AnnounceBatches();
+
+					if (IsSharedMemoryEnabled())
+						m_connection->OfferSharedMemory();
 
 					if (m_handler)
 					{
@@ -1153,7 +1597,14 @@ void NamedPipeClient::NamedPipeThread()
 		// Second loop will try to process events on the connection
 		while (m_connection && IsRunning())
 		{
-			DWORD dwWait = WaitForMultipleObjectsEx(static_cast<DWORD>(lengthof(waitEvents)), waitEvents, FALSE, INFINITE, TRUE);
+			HANDLE connectionEvents[2] = {
+				m_interruptEvent.get(),
+				m_connection->GetSharedMemoryEvent(),
+			};
+			const DWORD eventCount = connectionEvents[1] ? 2 : 1;
+			const DWORD timeout = m_connection->ExpireRequests(std::chrono::steady_clock::now());
+
+			DWORD dwWait = WaitForMultipleObjectsEx(eventCount, connectionEvents, FALSE, timeout, TRUE);
 
 			switch (dwWait)
 			{
@@ -1162,7 +1613,13 @@ void NamedPipeClient::NamedPipeThread()
 				ProcessPipeThreadQueue();
 				break;
 
+			case 1: // shared memory event
+				if (auto connection = m_connection)
+					connection->ProcessSharedMemory();
+				break;
+
 			case WAIT_IO_COMPLETION:
+			case WAIT_TIMEOUT:
 				break;
 
 			default:
@@ -1224,28 +1681,36 @@ void NamedPipeClient::SendMessage(MQMessageId messageId, const void* data, size_
 	}
 }
 
-void NamedPipeClient::SendMessageWithResponse(PipeMessagePtr&& message, const PipeMessageResponseCb& response)
+void NamedPipeClient::SendMessageWithResponse(PipeMessagePtr&& message, const PipeMessageResponseCb& response,
+	std::chrono::milliseconds timeout /* = DEFAULT_RPC_TIMEOUT */)
 {
 	if (m_connection)
 	{
-		m_connection->SendMessageWithResponse(std::move(message), response);
+		m_connection->SendMessageWithResponse(std::move(message), response, timeout);
 	}
 	else
 	{
 		SPDLOG_WARN("Tried to send a message with id {0} on a null connection.", static_cast<int>(message->GetMessageId()));
+
+		// still answer, so that nobody waits on a response that can't come
+		if (response)
+			PostToMainThread([response]() { response(MsgError_NoConnection, nullptr); });
 	}
 }
 
 void NamedPipeClient::SendMessageWithResponse(MQMessageId messageId, const void* data, size_t dataLength,
-	const PipeMessageResponseCb& response)
+	const PipeMessageResponseCb& response, std::chrono::milliseconds timeout /* = DEFAULT_RPC_TIMEOUT */)
 {
 	if (m_connection)
 	{
-		m_connection->SendMessageWithResponse(messageId, data, dataLength, response);
+		m_connection->SendMessageWithResponse(messageId, data, dataLength, response, timeout);
 	}
 	else
 	{
 		SPDLOG_WARN("Tried to send a message with id {0} on a null connection.", static_cast<int>(messageId));
+
+		if (response)
+			PostToMainThread([response]() { response(MsgError_NoConnection, nullptr); });
 	}
 }
 
@@ -15,13 +15,18 @@
 #pragma once
 
 #include "NamedPipesProtocol.h"
+#include "PipeBufferPool.h"
+#include "SharedMemoryChannel.h"
+#include "mq/base/MPSCQueue.h"
 
 #include <wil/resource.h>
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -42,13 +47,14 @@ class PipeConnection;
 //============================================================================
 // message sent to/from the named pipe server
 
-// Note: If we want to be able to send a message to multiple clients, we need
-// to separate the header from the message, since different clients are going
-// to have different headers (maybe..?)
+// A message that is sent to more than one connection can be shared between them, so that it is
+// only put together once. Nothing about it can change once it is shared, so only simple messages
+// are sent this way: the sequence id only matters for matching replies.
 
 class PipeMessage
 {
 	friend class PipeConnection;
+	friend class SharedMemoryChannel;
 
 public:
 	PipeMessage() = default;
@@ -56,12 +62,22 @@ public:
 	PipeMessage(const MQMessageHeader& header, const void* data, size_t length);
 	PipeMessage(const PipeMessage& message, const void* data, size_t length);
 
+	// concatenates the parts into the message data, without putting them together first
+	PipeMessage(MQMessageId messageId, std::initializer_list<std::string_view> parts);
+
+	// takes over the buffer of another message, with the data narrowed down to a slice of it. The
+	// header is left alone, so this still sends as the original message did.
+	PipeMessage(PipeMessage&& message, const void* data, size_t length);
+
 	virtual ~PipeMessage();
 
 	// parse an existing message buffer into a message. Returns false if this is not a
-	// properly formatted message.
-	bool Parse(std::unique_ptr<uint8_t[]> buffer, size_t length);
-	bool Parse(const std::vector<std::pair<std::unique_ptr<uint8_t[]>, size_t>>& buffers);
+	// properly formatted message. The message takes over the buffer, which can come from a pool.
+	bool Parse(PipeBuffer buffer, size_t length);
+
+	// same, but for a message that arrived in pieces. They are put together in a buffer from
+	// the pool, if there is one.
+	bool Parse(const std::vector<std::pair<PipeBuffer, size_t>>& buffers, PipeBufferPool* pool = nullptr);
 
 	void Init(const void* data, size_t length);
 	void Init(MQMessageId messageId, const void* data, size_t length);
@@ -99,7 +115,7 @@ public:
 	template <typename T = void>
 	const T* get() const { return reinterpret_cast<T*>(m_buffer.get() + m_dataOffset); }
 
-	size_t size() const { return m_header ? m_header->messageLength : 0; }
+	size_t size() const { return m_header ? m_dataLength : 0; }
 
 	uint32_t GetSequenceId() const { return m_header ? m_header->sequenceId : 0; }
 	void SetSequenceId(uint32_t sequenceId) { if (m_header) m_header->sequenceId = sequenceId; }
@@ -112,6 +128,9 @@ public:
 	// A more thorough message reply
 	void SendReply(MQMessageId messageId, void* data, size_t length, uint8_t status = 0);
 
+	// Reply with a message that has already been put together
+	void SendReply(std::unique_ptr<PipeMessage>&& reply, uint8_t status = 0);
+
 private:
 	void SetConnection(std::shared_ptr<PipeConnection> connection) { m_connection = connection; }
 
@@ -119,19 +138,25 @@ private:
 	size_t buffer_size() const { return m_bufferLength; }
 
 private:
-	std::unique_ptr<uint8_t[]> m_buffer;
+	PipeBuffer m_buffer;
 	size_t m_bufferLength = 0;
 	MQMessageHeader* m_header = nullptr;
 	size_t m_dataOffset = 0;
+	size_t m_dataLength = 0;
 	bool m_valid = false;
 	bool m_replied = false;
 
 	std::weak_ptr<PipeConnection> m_connection;
 };
 using PipeMessagePtr = std::unique_ptr<PipeMessage>;
+using SharedPipeMessagePtr = std::shared_ptr<const PipeMessage>;
 
 using PipeMessageResponseCb = std::function<void(int status, PipeMessagePtr&& message)>;
 
+// How long a call-and-response message waits for its response before the callback is given
+// MsgError_Timeout, unless the sender asks for something else.
+constexpr std::chrono::milliseconds DEFAULT_RPC_TIMEOUT = std::chrono::seconds(60);
+
 // Create a v0 simple message
 PipeMessagePtr MakeSimpleMessageV0(MQMessageId messageId, const void* data, size_t dataLength);
 
@@ -166,6 +191,11 @@ public:
 	HANDLE GetNamedPipe() { return m_hPipe.get(); }
 	bool IsNamedPipeOpen() const { return m_hPipe.is_valid(); }
 
+	// Once a shared memory channel has been negotiated, every message goes through it and the pipe
+	// only tells us when the other side goes away. Empty until then.
+	HANDLE GetSharedMemoryEvent() const { return m_sharedMemory ? m_sharedMemory->GetWakeEvent() : nullptr; }
+	bool IsUsingSharedMemory() const { return m_sharedMemoryWritable; }
+
 	//----------------------------------------------------------------------------
 	// Send message variants
 
@@ -173,11 +203,16 @@ public:
 	void SendMessage(MQMessageId messageId, const void* data, size_t dataLength);
 	void SendMessage(PipeMessagePtr&& message);
 
-	// Send a call-and-response message to the server
+	// Send a simple message that is also being sent to other connections
+	void SendMessage(const SharedPipeMessagePtr& message);
+
+	// Send a call-and-response message to the server. Any number can be waiting at once. The
+	// response is always called exactly once on the main thread: with the reply, or with an error if
+	// the timeout passes or the connection closes first.
 	void SendMessageWithResponse(MQMessageId messageId, const void* data, size_t dataLength,
-		const PipeMessageResponseCb& response);
+		const PipeMessageResponseCb& response, std::chrono::milliseconds timeout = DEFAULT_RPC_TIMEOUT);
 	void SendMessageWithResponse(PipeMessagePtr&& message,
-		const PipeMessageResponseCb& response);
+		const PipeMessageResponseCb& response, std::chrono::milliseconds timeout = DEFAULT_RPC_TIMEOUT);
 
 	void Close();
 private:
@@ -187,6 +222,10 @@ private:
 		OVERLAPPED overlapped;
 		std::shared_ptr<PipeConnection> ref;
 		std::unique_ptr<PipeMessage> message;
+		SharedPipeMessagePtr sharedMessage; // instead of message, when it goes to other connections too
+		size_t messageCount = 1;          // more than one if this is a batch
+
+		const PipeMessage& GetMessage() const { return message ? *message : *sharedMessage; }
 	};
 
 	// After a read is completed, start a write.
@@ -197,7 +236,9 @@ private:
 
 	// This sends the message to the named pipe. It expects to be called from the named pipe thread.
 	void InternalSendMessage(PipeMessagePtr&& message,
-		const PipeMessageResponseCb& response = nullptr);
+		const PipeMessageResponseCb& response = nullptr, std::chrono::milliseconds timeout = DEFAULT_RPC_TIMEOUT);
+	void InternalSendMessage(const SharedPipeMessagePtr& message);
+	void InternalQueueWrite(std::unique_ptr<QueuedOp>&& op);
 
 	void InternalReceiveMessage(PipeMessagePtr&& message);
 
@@ -205,8 +246,27 @@ private:
 	void ProcessBuffers();
 	void InternalBeginSend();
 
+	// Tell the other side that we can split batches, so it can start sending them.
+	void AnnounceBatches();
+
+	// Combines the messages at the front of the write queue into one batch.
+	void CoalesceWrites();
+	void InternalReceiveBatch(const PipeMessage& batch);
+
+	// From the client, offer a shared memory channel to the server.
+	void OfferSharedMemory();
+	void HandleSharedMemoryMessage(const PipeMessage& message);
+
+	// Writes what has been waiting for room and reads what has arrived on the shared memory channel.
+	// Called when its event is set.
+	void ProcessSharedMemory();
+
 	bool InternalClose(bool disconnect);
 
+	// Fails the requests whose deadline has passed. Returns how long the pipe thread can wait before
+	// the next one is due, for its wait timeout.
+	DWORD ExpireRequests(std::chrono::steady_clock::time_point now);
+
 private:
 	wil::unique_hfile m_hPipe;
 	NamedPipeEndpointBase* m_parent = nullptr;
@@ -218,23 +278,35 @@ private:
 
 	// data used for reading
 	OVERLAPPED m_overlapped;              // used for reading only
-	std::unique_ptr<uint8_t[]> m_readBuffer;
-	std::vector<std::pair<std::unique_ptr<uint8_t[]>, size_t>> m_readBuffers;
+	PipeBuffer m_readBuffer;
+	std::vector<std::pair<PipeBuffer, size_t>> m_readBuffers;
 	size_t m_readBufferSize = 0;
 	std::shared_ptr<PipeConnection> m_self;
 
 	// data used for writing
 	std::deque<std::unique_ptr<QueuedOp>> m_writeQueue;
 	bool m_pendingWrite = false;
+	bool m_writeDeferred = false;         // waiting to be flushed by the endpoint
+	bool m_peerAcceptsBatches = false;
+
+	// shared memory channel
+	std::unique_ptr<SharedMemoryChannel> m_sharedMemory;
+	bool m_sharedMemoryReadable = false;  // the other side's last pipe message has arrived
+	bool m_sharedMemoryWritable = false;  // our last pipe message has been sent
 
 	// mapping of sequence id to callbacks
 	struct RpcRequest
 	{
 		PipeMessageResponseCb callback;
 		uint32_t sequenceId;
-		std::chrono::steady_clock::time_point sendTime; // for timeouts
+		std::chrono::steady_clock::time_point deadline;
 	};
 	std::unordered_map<uint32_t, RpcRequest> m_rpcRequests;
+	std::chrono::steady_clock::time_point m_nextDeadline = std::chrono::steady_clock::time_point::max();
+
+	// requests that timed out recently, so that their replies are dropped if they turn up late
+	// instead of being routed like new mail
+	std::deque<uint32_t> m_expiredRequests;
 };
 using PipeConnectionPtr = std::shared_ptr<PipeConnection>;
 
@@ -286,9 +358,19 @@ public:
 	// dispatches a message to be handled by the client.
 	void DispatchMessage(PipeMessagePtr&& message);
 
+	// Number of messages written to and read from the pipe since it was created.
+	uint64_t GetMessagesSent() const { return m_messagesSent; }
+	uint64_t GetMessagesReceived() const { return m_messagesReceived; }
+
+	// Connections to processes on this machine move to shared memory when both ends allow it,
+	// which they do by default. Takes effect for new connections.
+	void SetSharedMemoryEnabled(bool enabled) { m_sharedMemoryEnabled = enabled; }
+	bool IsSharedMemoryEnabled() const { return m_sharedMemoryEnabled; }
+
 protected:
 	virtual void NamedPipeThread() = 0;
 	virtual void CloseConnection(PipeConnection* connection) = 0;
+	virtual bool CanOpenSharedMemory() const { return m_sharedMemoryEnabled; }
 
 	void ProcessMainThreadQueue();
 	void ProcessPipeThreadQueue();
@@ -307,16 +389,24 @@ private:
 	std::thread::id m_mainThreadId;
 	std::thread::id m_pipeThreadId;
 	std::atomic_bool m_running{ false };
+	std::atomic<uint64_t> m_messagesSent{ 0 };
+	std::atomic<uint64_t> m_messagesReceived{ 0 };
+	std::atomic_bool m_sharedMemoryEnabled{ true };
+
+	// for reading messages, shared by all connections
+	std::shared_ptr<PipeBufferPool> m_bufferPool;
 
 	// for passing events to the pipe thread
-	std::vector<std::function<void()>> m_threadQueue;
-	std::mutex m_threadQueueMutex;
-	std::atomic_bool m_threadQueueDirty{ false };
-
-	// for passing events to the main thread
-	std::vector<std::function<void()>> m_mainQueue;
-	std::mutex m_mainQueueMutex;
-	std::atomic_bool m_mainQueueDirty{ false };
+	mq::MPSCQueue<std::function<void()>> m_threadQueue;
+
+	// while the pipe thread queue runs, writes wait here, so that everything sent in one go can
+	// be put into the same batch
+	bool m_deferWrites = false;
+	std::vector<std::weak_ptr<PipeConnection>> m_deferredWrites;
+
+	// for passing events to the main thread. Processed against a time budget, the rest
+	// waits for the next call to Process.
+	mq::MPSCQueue<std::function<void()>> m_mainQueue;
 };
 
 //============================================================================
@@ -341,6 +431,7 @@ public:
 	void SendMessage(int connectionId, PipeMessagePtr&& message);
 	void SendMessage(int connectionId, MQMessageId messageId, const void* data, size_t dataLength);
 
+	// The message is shared by every connection, not copied for each one.
 	void BroadcastMessage(PipeMessagePtr&& message);
 	void BroadcastMessage(MQMessageId messageId, const void* data, size_t dataLength);
 
@@ -353,6 +444,7 @@ private:
 
 	// clean up a connection
 	void CloseConnection(PipeConnection* connection) override;
+	bool CanOpenSharedMemory() const override;
 
 	int GetConnectionCount() const;
 
@@ -362,6 +454,10 @@ private:
 	wil::unique_hfile m_hPipe;
 	std::vector<std::shared_ptr<PipeConnection>> m_connections;
 	mutable std::mutex m_mutex;
+
+	// what the pipe thread waits on, and the connection behind each shared memory event
+	std::vector<HANDLE> m_waitEvents;
+	std::vector<std::shared_ptr<PipeConnection>> m_waitConnections;
 };
 
 //============================================================================
@@ -377,9 +473,10 @@ public:
 	void SendMessage(MQMessageId messageId, const void* data, size_t dataLength);
 
 	// Send a call-and-response message to the server
-	void SendMessageWithResponse(PipeMessagePtr&& message, const PipeMessageResponseCb& response);
+	void SendMessageWithResponse(PipeMessagePtr&& message, const PipeMessageResponseCb& response,
+		std::chrono::milliseconds timeout = DEFAULT_RPC_TIMEOUT);
 	void SendMessageWithResponse(MQMessageId messageId, const void* data, size_t dataLength,
-		const PipeMessageResponseCb& response);
+		const PipeMessageResponseCb& response, std::chrono::milliseconds timeout = DEFAULT_RPC_TIMEOUT);
 
 	// Checks if we're connected
 	bool IsConnected() const;
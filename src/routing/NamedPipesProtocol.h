@@ -28,6 +28,9 @@ enum class MQMessageId : uint16_t
 	MSG_ROUTE                              = 2,     // Route a message to a mailbox in a client
 	MSG_IDENTIFICATION                     = 3,     // Update routing information in server/client or request ID list
 	MSG_DROPPED                            = 4,     // Notify clients that an address is no longer connected
+	MSG_SHARED_MEMORY                      = 5,     // Negotiate a shared memory channel next to the pipe. Handled by the connection.
+	MSG_BATCH                              = 6,     // Several messages in one write. Handled by the connection.
+	MSG_MAILBOXES                          = 7,     // Tell the server which mailboxes a client has
 
 	// FIXME: We really should have message ids separated by plugins or services. For now we will use a single enum
 	// and just change it later.
@@ -40,6 +43,8 @@ enum class MQMessageId : uint16_t
 	MSG_MAIN_FOCUS_REQUEST                 = 1004,  // to/from mq: i have focus or i want focus.
 	MSG_MAIN_FOCUS_ACTIVATE_WND            = 1005,  // to mq: activate requested window
 	MSG_MAIN_REQ_FORCEUNLOAD               = 1006,  // to mq: ask mq to less nicely unload.
+	MSG_MAIN_PERFORMANCE_REPORT            = 1007,  // from mq: periodic performance summary.
+	MSG_MAIN_FRAME_BUDGET                  = 1008,  // to mq: frame rate assigned by the launcher's cpu governor.
 };
 
 enum class MQProtoVersion : uint8_t
@@ -61,6 +66,8 @@ constexpr int MsgError_ConnectionClosed        = -1;                  // connect
 constexpr int MsgError_NoConnection            = -2;                  // no connection established
 constexpr int MsgError_RoutingFailed           = -3;                  // message routing failed
 constexpr int MsgError_AmbiguousRecipient      = -4;                  // RPC message couldn't determine single recipient
+constexpr int MsgError_MailboxFull             = -5;                  // recipient had too much mail waiting
+constexpr int MsgError_Timeout                 = -6;                  // no response came before the deadline
 
 #pragma pack(push)
 #pragma pack(1)
@@ -81,6 +88,29 @@ struct MQMessageHeader
 
 #pragma pack(pop)
 
+// MSG_SHARED_MEMORY -> from client, as a call-and-response
+// The client offers a channel that it created. The server opens the channel and replies with status
+// 0 when it did. Its reply is the last message it sends on the pipe. After that, the client sends
+// MSG_SHARED_MEMORY as a simple message without data as the last message on its side of the pipe.
+// Each side only reads the channel once it has the other side's last message from the pipe, so
+// messages stay in order across the switch.
+struct MQMessageSharedMemory
+{
+	uint32_t            processId;     // id of the process that created the channel
+	uint32_t            channelId;     // unique in that process
+	uint32_t            capacity;      // bytes in each direction
+};
+
+// MSG_BATCH -> either direction, as a simple message
+// The data is a run of whole messages, each one a header followed by its data. Both sides send an
+// empty batch when they connect, and neither sends a full one until it has seen one from the other
+// side, so older versions never get one.
+
+// MSG_MAILBOXES -> from client, as a simple message
+// The data is a proto::routing::Mailboxes with every mailbox the client has, sent whenever they
+// change. Mail for everyone that names a mailbox only goes to the clients that have it. A client
+// that never sends this gets all of it.
+
 // MSG_MAIN_PROCESS_LOADED
 struct MQMessageProcessLoadedFromMQ
 {
@@ -108,6 +138,46 @@ struct MQMessageActivateWnd
 	void*               hWnd = nullptr;
 };
 
+// What a client was doing at any point since its previous report.
+enum MQClientActivity : uint32_t
+{
+	MQClientActivity_None                  = 0,
+	MQClientActivity_Foreground            = 0x01,
+	MQClientActivity_InCombat              = 0x02,
+	MQClientActivity_Casting               = 0x04,
+	MQClientActivity_Zoning                = 0x08,
+};
+
+// MSG_MAIN_PERFORMANCE_REPORT -> from mq
+// Times are in milliseconds and cover the frames since the previous report. Fields are only added
+// at the end, and a shorter report from an older client leaves the rest at their defaults.
+struct MQMessagePerformanceReport
+{
+	uint32_t            processId = 0;
+	uint32_t            frameCount = 0;
+	float               frameTimeP50 = 0.0f;
+	float               frameTimeP95 = 0.0f;
+	float               frameTimeP99 = 0.0f;
+	float               frameTimeMax = 0.0f;
+	float               cpuUsage = 0.0f;             // percent, as measured by the frame limiter
+	uint64_t            workingSet = 0;              // bytes
+	uint64_t            privateBytes = 0;            // bytes
+	float               macroLinesPerSecond = 0.0f;
+	float               luaTimePerFrame = 0.0f;
+	float               simulationFPS = 0.0f;        // main loop rate
+	uint32_t            activity = 0;                // MQClientActivity flags
+};
+
+// MSG_MAIN_FRAME_BUDGET -> to mq
+// The main loop rate that a background client should hold to. The render rate stays at or below
+// the client's own setting. A client goes back to its own settings when the budget runs out without
+// being renewed, and a rate of zero hands control back right away.
+struct MQMessageFrameBudget
+{
+	float               simulationFPS = 0.0f;
+	uint32_t            durationMs = 0;
+};
+
 //----------------------------------------------------------------------------
 
 // MSG_MAIN_CRASHPAD_PIPENAME
@@ -0,0 +1,79 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "PipeBufferPool.h"
+
+namespace mq {
+
+void PipeBufferDeleter::operator()(uint8_t* buffer) const
+{
+	if (pool)
+		pool->Release(buffer, sizeClass);
+	else
+		delete[] buffer;
+}
+
+//============================================================================
+
+PipeBufferPool::~PipeBufferPool()
+{
+	for (auto& buffers : m_free)
+	{
+		for (uint8_t* buffer : buffers)
+			delete[] buffer;
+	}
+}
+
+PipeBuffer PipeBufferPool::Acquire(size_t size)
+{
+	if (size > MAX_BUFFER_SIZE)
+		return PipeBuffer(new uint8_t[size]);
+
+	uint32_t sizeClass = 0;
+	while ((MIN_BUFFER_SIZE << sizeClass) < size)
+		++sizeClass;
+
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto& buffers = m_free[sizeClass];
+		if (!buffers.empty())
+		{
+			uint8_t* buffer = buffers.back();
+			buffers.pop_back();
+
+			return PipeBuffer(buffer, PipeBufferDeleter(shared_from_this(), sizeClass));
+		}
+	}
+
+	return PipeBuffer(new uint8_t[MIN_BUFFER_SIZE << sizeClass], PipeBufferDeleter(shared_from_this(), sizeClass));
+}
+
+void PipeBufferPool::Release(uint8_t* buffer, uint32_t sizeClass)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto& buffers = m_free[sizeClass];
+		if (buffers.size() < MAX_FREE_BUFFERS)
+		{
+			buffers.push_back(buffer);
+			return;
+		}
+	}
+
+	delete[] buffer;
+}
+
+} // namespace mq
@@ -0,0 +1,74 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mq {
+
+class PipeBufferPool;
+
+// Gives pooled buffers back to the pool they came from and deletes the rest. Holds on to the pool,
+// because a message can outlive the endpoint that read it.
+struct PipeBufferDeleter
+{
+	PipeBufferDeleter() = default;
+	PipeBufferDeleter(std::default_delete<uint8_t[]>) {}
+	PipeBufferDeleter(std::shared_ptr<PipeBufferPool> pool, uint32_t sizeClass)
+		: pool(std::move(pool)), sizeClass(sizeClass) {}
+
+	void operator()(uint8_t* buffer) const;
+
+	std::shared_ptr<PipeBufferPool> pool;   // null if the buffer isn't pooled
+	uint32_t sizeClass = 0;
+};
+
+using PipeBuffer = std::unique_ptr<uint8_t[], PipeBufferDeleter>;
+
+//============================================================================
+
+// Buffers for incoming messages, kept in power of two size classes so that they can be used again
+// for messages of about the same size. Each endpoint has one that its connections share. Buffers
+// come back from whichever thread lets go of the message, so the free lists are locked.
+class PipeBufferPool : public std::enable_shared_from_this<PipeBufferPool>
+{
+public:
+	static constexpr size_t MIN_BUFFER_SIZE = 256;
+	static constexpr size_t SIZE_CLASS_COUNT = 9;           // up to 64KB
+	static constexpr size_t MAX_BUFFER_SIZE = MIN_BUFFER_SIZE << (SIZE_CLASS_COUNT - 1);
+	static constexpr size_t MAX_FREE_BUFFERS = 32;          // kept around in each size class
+
+	PipeBufferPool() = default;
+	~PipeBufferPool();
+
+	PipeBufferPool(const PipeBufferPool&) = delete;
+	PipeBufferPool& operator=(const PipeBufferPool&) = delete;
+
+	// Returns a buffer that holds at least size bytes. Buffers over MAX_BUFFER_SIZE aren't pooled.
+	PipeBuffer Acquire(size_t size);
+
+private:
+	friend struct PipeBufferDeleter;
+
+	void Release(uint8_t* buffer, uint32_t sizeClass);
+
+	std::mutex m_mutex;
+	std::vector<uint8_t*> m_free[SIZE_CLASS_COUNT];
+};
+
+} // namespace mq
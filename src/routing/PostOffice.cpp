@@ -15,48 +15,273 @@
 #define MQLIB_OBJECT
 #include "PostOffice.h"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
 namespace mq::postoffice {
 
+using google::protobuf::internal::WireFormatLite;
+
+static constexpr int ENVELOPE_PAYLOAD_FIELD = proto::routing::Envelope::kPayloadFieldNumber;
+
+PipeMessagePtr StuffEnvelope(const MQMessageHeader& header, const proto::routing::Envelope& envelope, std::string_view payload)
+{
+	auto message = StuffEnvelope(envelope, payload);
+
+	// keep the header of the message being rebuilt, except for the length of the new data
+	MQMessageHeader* newHeader = message->GetHeader();
+	const uint32_t messageLength = newHeader->messageLength;
+	*newHeader = header;
+	newHeader->messageLength = messageLength;
+	newHeader->protoVersion = MQProtoVersion::V0;
+
+	return message;
+}
+
+PipeMessagePtr StuffEnvelope(const proto::routing::Envelope& envelope, std::string_view payload)
+{
+	// the payload is the last field, so serializing it after the rest of the envelope gives the
+	// same bytes as serializing the whole envelope would
+	std::string addresses = envelope.SerializeAsString();
+
+	uint8_t prefix[16];
+	uint8_t* pos = WireFormatLite::WriteTagToArray(ENVELOPE_PAYLOAD_FIELD, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, prefix);
+	pos = google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(payload.size()), pos);
+
+	return std::make_unique<PipeMessage>(MQMessageId::MSG_ROUTE, std::initializer_list<std::string_view>{
+		addresses,
+		std::string_view(reinterpret_cast<const char*>(prefix), pos - prefix),
+		payload });
+}
+
+bool OpenEnvelope(const PipeMessage& message, proto::routing::Envelope& envelope, std::string_view& payload)
+{
+	const uint8_t* data = message.get<uint8_t>();
+	google::protobuf::io::CodedInputStream input(data, static_cast<int>(message.size()));
+
+	envelope.Clear();
+	payload = std::string_view();
+
+	while (uint32_t tag = input.ReadTag())
+	{
+		if (WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+		{
+			if (!WireFormatLite::SkipField(&input, tag))
+				return false;
+
+			continue;
+		}
+
+		uint32_t length;
+		if (!input.ReadVarint32(&length) || length > static_cast<uint32_t>(input.BytesUntilLimit()))
+			return false;
+
+		const uint8_t* field = data + input.CurrentPosition();
+
+		switch (WireFormatLite::GetTagFieldNumber(tag))
+		{
+		case proto::routing::Envelope::kAddressFieldNumber:
+			if (!envelope.mutable_address()->ParseFromArray(field, static_cast<int>(length)))
+				return false;
+			break;
+
+		case proto::routing::Envelope::kReturnAddressFieldNumber:
+			if (!envelope.mutable_return_address()->ParseFromArray(field, static_cast<int>(length)))
+				return false;
+			break;
+
+		case proto::routing::Envelope::kKeyFieldNumber:
+			envelope.set_key(reinterpret_cast<const char*>(field), length);
+			break;
+
+		case ENVELOPE_PAYLOAD_FIELD:
+			payload = std::string_view(reinterpret_cast<const char*>(field), length);
+			break;
+
+		default: break;
+		}
+
+		input.Skip(static_cast<int>(length));
+	}
+
+	return input.ConsumedEntireMessage();
+}
+
 void Mailbox::Deliver(PipeMessagePtr&& message) const
 {
 	// Don't do anything if this isn't wrapped in an envelope
 	if (message->GetMessageId() == MQMessageId::MSG_ROUTE)
 	{
-		m_receiveQueue.push(Open(ProtoMessage::Parse<proto::routing::Envelope>(message), message));
+		proto::routing::Envelope envelope;
+		std::string_view payload;
+		OpenEnvelope(*message, envelope, payload);
+
+		ProtoMessagePtr mail = Open(envelope, std::move(message), payload);
+
+		if (mail->GetRequestMode() == MQRequestMode::CallAndResponse)
+		{
+			if (MakeRoom(m_replyQueue, mail))
+				m_replyQueue.push_back(std::move(mail));
+		}
+		else if (!mail->GetKey().empty())
+		{
+			// only the newest state matters, so it takes the place of any that is still waiting
+			auto [latest_it, added] = m_latest.try_emplace(GetLatestKey(*mail), nullptr);
+			if (!added)
+			{
+				*latest_it->second = std::move(mail);
+				++m_replaced;
+			}
+			else if (MakeRoom(m_receiveQueue, mail))
+			{
+				m_receiveQueue.push_back(std::move(mail));
+				latest_it->second = &m_receiveQueue.back();
+			}
+			else
+			{
+				m_latest.erase(latest_it);
+			}
+		}
+		else if (MakeRoom(m_receiveQueue, mail))
+		{
+			m_receiveQueue.push_back(std::move(mail));
+		}
 	}
 }
 
-void Mailbox::Process(size_t howMany) const
+bool Mailbox::MakeRoom(std::deque<ProtoMessagePtr>& lane, ProtoMessagePtr& message) const
 {
-	if (howMany > 0 && !m_receiveQueue.empty())
+	if (m_options.maxWaiting == 0 || m_replyQueue.size() + m_receiveQueue.size() < m_options.maxWaiting)
 	{
-		m_receive(std::move(m_receiveQueue.front()));
-		m_receiveQueue.pop();
+		m_overflowing = false;
+		return true;
+	}
 
-		Process(howMany - 1);
+	if (!m_overflowing)
+	{
+		SPDLOG_WARN("Mailbox {} is full, dropping mail until it catches up", m_localAddress);
+		m_overflowing = true;
 	}
+
+	switch (m_options.overflow)
+	{
+	case MailboxOverflow::Coalesce:
+		if (m_options.coalesceKey)
+		{
+			const std::string key = m_options.coalesceKey(*message);
+			auto waiting_it = std::find_if(lane.begin(), lane.end(),
+				[this, &key](const ProtoMessagePtr& waiting) { return m_options.coalesceKey(*waiting) == key; });
+
+			// the new mail takes the place of the old, so it doesn't lose its turn
+			if (waiting_it != lane.end())
+			{
+				std::swap(*waiting_it, message);
+				ForgetLatest(*message, &*waiting_it);
+				break;
+			}
+		}
+		[[fallthrough]];
+
+	case MailboxOverflow::DropOldest:
+	{
+		// mail that a sender is waiting on can push out other mail, but not the other way around
+		auto& oldest = lane.empty() ? m_receiveQueue : lane;
+		if (!oldest.empty())
+		{
+			Drop(PopFront(oldest));
+			return true;
+		}
+		break;
+	}
+
+	case MailboxOverflow::RejectNew:
+		break;
+	}
+
+	Drop(std::move(message));
+	return false;
 }
 
-ProtoMessagePtr Mailbox::Open(proto::routing::Envelope&& envelope, const PipeMessagePtr& message)
+void Mailbox::Drop(ProtoMessagePtr&& message) const
 {
-	ProtoMessagePtr unwrapped;
+	++m_dropped;
+
+	// don't leave the sender waiting for a reply that will never come
+	message->SendReply(static_cast<uint8_t>(MsgError_MailboxFull));
+}
+
+ProtoMessagePtr Mailbox::PopFront(std::deque<ProtoMessagePtr>& lane) const
+{
+	ProtoMessagePtr message = std::move(lane.front());
+	ForgetLatest(*message, &lane.front());
+	lane.pop_front();
+
+	return message;
+}
+
+std::string Mailbox::GetLatestKey(ProtoMessage& message)
+{
+	const auto& sender = message.GetSender();
+	if (!sender)
+		return message.GetKey();
+
+	return fmt::format("{}\n{}\n{}", sender->has_name() ? sender->name() : std::to_string(sender->pid()),
+		sender->mailbox(), message.GetKey());
+}
+
+void Mailbox::ForgetLatest(ProtoMessage& message, const ProtoMessagePtr* slot) const
+{
+	if (message.GetKey().empty())
+		return;
 
-	const void* data = nullptr;
-	size_t length = 0;
-	if (envelope.has_payload())
+	auto latest_it = m_latest.find(GetLatestKey(message));
+	if (latest_it != m_latest.end() && latest_it->second == slot)
+		m_latest.erase(latest_it);
+}
+
+size_t Mailbox::Process(size_t howMany, std::chrono::steady_clock::time_point deadline) const
+{
+	const bool timed = deadline != std::chrono::steady_clock::time_point::max();
+	size_t processed = 0;
+
+	while (processed < howMany)
 	{
-		data = &envelope.payload()[0];
-		length = envelope.payload().size();
+		auto& lane = m_replyQueue.empty() ? m_receiveQueue : m_replyQueue;
+		if (lane.empty())
+			break;
+
+		m_receive(PopFront(lane));
+		++processed;
+
+		if (timed && std::chrono::steady_clock::now() >= deadline)
+			break;
 	}
 
-	if (message != nullptr) // this resets the m_replied member, but it couldn't have become true before this anyway
-		unwrapped = std::make_unique<ProtoMessage>(*message, data, length);
+	return processed;
+}
+
+ProtoMessagePtr Mailbox::Open(const proto::routing::Envelope& envelope, PipeMessagePtr&& message, std::string_view payload)
+{
+	ProtoMessagePtr unwrapped;
+
+	// the payload is a slice of the message, so the unwrapped message takes over its buffer
+	// instead of copying it. this resets the m_replied member, but it couldn't have become true
+	// before this anyway
+	if (message != nullptr)
+		unwrapped = std::make_unique<ProtoMessage>(std::move(*message), payload.data(), payload.size());
 	else
-		unwrapped = std::make_unique<ProtoMessage>(MQMessageId::MSG_NULL, data, length);
+		unwrapped = std::make_unique<ProtoMessage>(MQMessageId::MSG_NULL, payload.data(), payload.size());
 
 	if (envelope.has_return_address())
 		unwrapped->SetSender(envelope.return_address());
 
+	if (envelope.has_key())
+		unwrapped->SetKey(envelope.key());
+
 	return unwrapped;
 }
 
@@ -108,14 +333,38 @@ void PostOffice::RouteMessage(const std::string& data, const PipeMessageResponse
 	RouteMessage(&data[0], data.size(), callback);
 }
 
-Dropbox PostOffice::RegisterAddress(const std::string& localAddress, ReceiveCallback&& receive)
+void PostOffice::RouteMessage(const proto::routing::Address& address, const std::string& fromAddress, std::string_view data, std::string_view key,
+	const PipeMessageResponseCb& callback)
+{
+	proto::routing::Envelope envelope;
+	*envelope.mutable_address() = address;
+
+	if (!key.empty())
+		envelope.set_key(std::string(key));
+
+	proto::routing::Address& ret = *envelope.mutable_return_address();
+	ret.set_pid(GetCurrentProcessId());
+
+	if (!fromAddress.empty())
+		ret.set_mailbox(fromAddress);
+
+	EnrichReturnAddress(ret);
+
+	RouteMessage(StuffEnvelope(envelope, data), callback);
+}
+
+Dropbox PostOffice::RegisterAddress(const std::string& localAddress, ReceiveCallback&& receive, MailboxOptions options)
 {
-	auto [mailbox, added] = m_mailboxes.emplace(localAddress, std::make_unique<Mailbox>(localAddress, std::move(receive)));
+	auto [mailbox, added] = m_mailboxes.emplace(localAddress, std::make_unique<Mailbox>(localAddress, std::move(receive), std::move(options)));
 	if (added)
 	{
+		OnMailboxesChanged();
+
 		return Dropbox(
 			localAddress,
-			[this](const std::string& data, const PipeMessageResponseCb& callback) { RouteMessage(data, callback); },
+			[this](const proto::routing::Address& address, const std::string& fromAddress, std::string_view data, std::string_view key,
+				const PipeMessageResponseCb& callback)
+			{ RouteMessage(address, fromAddress, data, key, callback); },
 			[this](const std::string& localAddress) { RemoveMailbox(localAddress); });
 	}
 
@@ -124,7 +373,11 @@ Dropbox PostOffice::RegisterAddress(const std::string& localAddress, ReceiveCall
 
 bool PostOffice::RemoveMailbox(const std::string& localAddress)
 {
-	return m_mailboxes.erase(localAddress) == 1;
+	if (m_mailboxes.erase(localAddress) == 0)
+		return false;
+
+	OnMailboxesChanged();
+	return true;
 }
 
 bool PostOffice::DeliverTo(const std::string& localAddress, PipeMessagePtr&& message, const std::function<void(int, PipeMessagePtr&&)>& failed)
@@ -155,10 +408,33 @@ void PostOffice::DeliverAll(PipeMessagePtr& message, std::optional<std::string_v
 
 void PostOffice::Process(size_t howMany)
 {
-	size_t messages_per_mailbox = std::max(1, (int)std::round(howMany / m_mailboxes.size()));
-	for (const auto& [_, mailbox] : m_mailboxes)
+	ProcessUntil(howMany, std::chrono::steady_clock::time_point::max());
+}
+
+void PostOffice::Process(size_t howMany, std::chrono::steady_clock::duration budget)
+{
+	ProcessUntil(howMany, std::chrono::steady_clock::now() + budget);
+}
+
+void PostOffice::ProcessUntil(size_t howMany, std::chrono::steady_clock::time_point deadline)
+{
+	if (m_mailboxes.empty())
+		return;
+
+	const bool timed = deadline != std::chrono::steady_clock::time_point::max();
+	const size_t messages_per_mailbox = std::max<size_t>(1, howMany / m_mailboxes.size());
+
+	// start from a different mailbox each time, so that they all get a share of the budget
+	auto mailbox_it = std::next(m_mailboxes.begin(), m_nextMailbox++ % m_mailboxes.size());
+	for (size_t i = 0; i < m_mailboxes.size(); ++i)
 	{
-		mailbox->Process(messages_per_mailbox);
+		mailbox_it->second->Process(messages_per_mailbox, deadline);
+
+		if (timed && std::chrono::steady_clock::now() >= deadline)
+			break;
+
+		if (++mailbox_it == m_mailboxes.end())
+			mailbox_it = m_mailboxes.begin();
 	}
 }
 
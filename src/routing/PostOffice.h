@@ -16,23 +16,71 @@
 
 #include "Routing.h"
 
+#include <chrono>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <queue>
 #include <memory>
 
 namespace mq::postoffice {
 
 using ReceiveCallback = std::function<void(ProtoMessagePtr&&)>;
-using PostCallback = std::function<void(const std::string&, const PipeMessageResponseCb&)>;
+using PostCallback = std::function<void(const proto::routing::Address&, const std::string&, std::string_view, std::string_view, const PipeMessageResponseCb&)>;
 using DropboxDropper = std::function<void(const std::string&)>;
 
+/**
+ * What a mailbox does with mail that arrives when it already has as much waiting as it takes
+ */
+enum class MailboxOverflow
+{
+	DropOldest,   // make room by dropping the mail that has waited the longest
+	Coalesce,     // replace waiting mail that has the same key, or drop the oldest if there is none
+	RejectNew,    // drop the new mail
+};
+
+/**
+ * Limits on the mail that a mailbox holds on to until it is processed. Dropped mail that a sender
+ * is waiting on gets a reply with MsgError_MailboxFull.
+ */
+struct MailboxOptions
+{
+	size_t maxWaiting = 4096;                                     // 0 for no limit
+	MailboxOverflow overflow = MailboxOverflow::DropOldest;
+	std::function<std::string(const ProtoMessage&)> coalesceKey;  // required for Coalesce
+};
+
+/**
+ * Puts an envelope and its payload together into a message that can be routed. The payload is
+ * copied straight into the message, so it doesn't have to be set on the envelope first (and it
+ * must not be).
+ *
+ * @param header the header to give the message, for rebuilding a message that is already being routed
+ * @param envelope the addresses of the message, without a payload
+ * @param payload the data to send
+ * @return the message, with the ID of ROUTE
+ */
+PipeMessagePtr StuffEnvelope(const MQMessageHeader& header, const proto::routing::Envelope& envelope, std::string_view payload);
+PipeMessagePtr StuffEnvelope(const proto::routing::Envelope& envelope, std::string_view payload);
+
+/**
+ * Reads the addresses of a routed message without copying its payload
+ *
+ * @param message the message to read, with the ID of ROUTE
+ * @param envelope filled in with everything but the payload
+ * @param payload points into the message buffer, so it is only good for as long as the message is.
+ *                it has a null data pointer if the envelope has no payload.
+ * @return false if the message isn't a well formed envelope
+ */
+bool OpenEnvelope(const PipeMessage& message, proto::routing::Envelope& envelope, std::string_view& payload);
+
 class Mailbox
 {
 public:
-	Mailbox(std::string localAddress, ReceiveCallback&& receive)
+	Mailbox(std::string localAddress, ReceiveCallback&& receive, MailboxOptions options = {})
 		: m_localAddress(localAddress)
 		, m_receive(std::move(receive))
+		, m_options(std::move(options))
 	{}
 
 	~Mailbox() {}
@@ -52,19 +100,52 @@ public:
 	void Deliver(PipeMessagePtr&& message) const;
 
 	/**
-	 * Process some messages that have been delivered
+	 * Process some messages that have been delivered. Mail that a sender is waiting on goes first.
 	 *
 	 * @param howMany how many messages to process off the queue
+	 * @param deadline stop once this time has passed, even if there is more mail
+	 * @return how many messages were processed
 	 */
-	void Process(size_t howMany) const;
+	size_t Process(size_t howMany,
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) const;
+
+	/**
+	 * Gets the number of messages that were dropped because the mailbox was full
+	 */
+	uint64_t GetDroppedCount() const { return m_dropped; }
+
+	/**
+	 * Gets the number of messages that newer mail with the same key replaced before they were processed
+	 */
+	uint64_t GetReplacedCount() const { return m_replaced; }
 
 private:
-	static ProtoMessagePtr Open(proto::routing::Envelope&& envelope, const PipeMessagePtr& header);
+	static ProtoMessagePtr Open(const proto::routing::Envelope& envelope, PipeMessagePtr&& message, std::string_view payload);
+
+	// Makes room for the message in the lane that it goes in. Returns false if it was dropped.
+	bool MakeRoom(std::deque<ProtoMessagePtr>& lane, ProtoMessagePtr& message) const;
+	void Drop(ProtoMessagePtr&& message) const;
+	ProtoMessagePtr PopFront(std::deque<ProtoMessagePtr>& lane) const;
+
+	// Mail with a key is only replaced by mail from the same sender
+	static std::string GetLatestKey(ProtoMessage& message);
+	void ForgetLatest(ProtoMessage& message, const ProtoMessagePtr* slot) const;
 
 	const std::string m_localAddress;
 	const ReceiveCallback m_receive;
+	const MailboxOptions m_options;
+
+	// mail that a sender is waiting on a reply for, and everything else
+	mutable std::deque<ProtoMessagePtr> m_replyQueue;
+	mutable std::deque<ProtoMessagePtr> m_receiveQueue;
 
-	mutable std::queue<ProtoMessagePtr> m_receiveQueue;
+	// where the waiting mail with each key is. Elements of a deque stay put when others are added
+	// or removed at the ends.
+	mutable std::unordered_map<std::string, ProtoMessagePtr*> m_latest;
+
+	mutable uint64_t m_dropped = 0;
+	mutable uint64_t m_replaced = 0;
+	mutable bool m_overflowing = false;
 };
 
 class Dropbox
@@ -96,7 +177,19 @@ public:
 	template <typename T>
 	void Post(const proto::routing::Address& address, const T& obj, const PipeMessageResponseCb& callback = nullptr)
 	{
-		if (IsValid()) m_post(Stuff(address, obj), callback);
+		if (IsValid()) m_post(address, m_localAddress, obj.SerializeAsString(), std::string_view(), callback);
+	}
+
+	/**
+	 * Sends data to an address
+	 *
+	 * @param address the address to send the message
+	 * @param data the message (already serialized)
+	 * @param callback optional callback for an expected response
+	 */
+	void Post(const proto::routing::Address& address, const std::string& data, const PipeMessageResponseCb& callback = nullptr)
+	{
+		if (IsValid()) m_post(address, m_localAddress, data, std::string_view(), callback);
 	}
 
 	/**
@@ -107,7 +200,21 @@ public:
 	 */
 	void Post(const proto::routing::Address& address, const PipeMessageResponseCb& callback = nullptr)
 	{
-		if (IsValid()) m_post(Stuff(address, std::string()), callback);
+		if (IsValid()) m_post(address, m_localAddress, std::string_view(), std::string_view(), callback);
+	}
+
+	/**
+	 * Sends state to an address. Waiting mail from this dropbox with the same key is replaced,
+	 * so a slow recipient only sees the newest.
+	 *
+	 * @param address the address to send the message
+	 * @param key what the state is of, like "hp"
+	 * @param data the message (already serialized)
+	 * @param callback optional callback for an expected response
+	 */
+	void PostLatest(const proto::routing::Address& address, std::string_view key, const std::string& data, const PipeMessageResponseCb& callback = nullptr)
+	{
+		if (IsValid()) m_post(address, m_localAddress, data, key, callback);
 	}
 
 	/**
@@ -145,8 +252,7 @@ public:
 		{
 			if (auto sender = message->GetSender())
 			{
-				std::string data(Stuff(*sender, obj));
-				message->SendReply(MQMessageId::MSG_ROUTE, &data[0], data.size(), status);
+				message->SendReply(Stuff(*sender, Data(obj)), status);
 			}
 			else
 			{
@@ -175,18 +281,12 @@ private:
 		return obj.SerializeAsString();
 	}
 
-	std::string Data(const std::string& obj)
+	const std::string& Data(const std::string& obj)
 	{
 		return obj;
 	}
 
-	template <typename T>
-	std::string Stuff(const proto::routing::Address& address, const T& obj)
-	{
-		return Stuff(address, obj.SerializeAsString());
-	}
-
-	std::string Stuff(const proto::routing::Address& address, const std::string& data)
+	PipeMessagePtr Stuff(const proto::routing::Address& address, std::string_view data)
 	{
 		proto::routing::Envelope envelope;
 		*envelope.mutable_address() = address;
@@ -195,9 +295,7 @@ private:
 		ret.set_pid(GetCurrentProcessId());
 		ret.set_mailbox(m_localAddress);
 
-		envelope.set_payload(data);
-
-		return envelope.SerializeAsString();
+		return StuffEnvelope(envelope, data);
 	}
 
 	std::string m_localAddress;
@@ -263,17 +361,22 @@ public:
 	 */
 	void RouteMessage(const proto::routing::Address& address, const std::string& data, const PipeMessageResponseCb& callback)
 	{
-		proto::routing::Envelope envelope;
-		*envelope.mutable_address() = address;
-
-		proto::routing::Address& ret = *envelope.mutable_return_address();
-		ret.set_pid(GetCurrentProcessId());
-
-		envelope.set_payload(data);
-
-		RouteMessage(envelope, callback);
+		RouteMessage(address, std::string(), data, std::string_view(), callback);
 	}
 
+	/**
+	 * Routes data in an envelope from a local mailbox. The data is only copied once, into the
+	 * message that gets routed.
+	 *
+	 * @param address the address to send the message to
+	 * @param fromAddress the local mailbox that replies go to, or empty for none
+	 * @param data the data to send
+	 * @param key what the data is the state of, or empty if it isn't state
+	 * @param callback an optional callback for RPC responses
+	 */
+	void RouteMessage(const proto::routing::Address& address, const std::string& fromAddress, std::string_view data, std::string_view key,
+		const PipeMessageResponseCb& callback);
+
 	/**
 	 * A helper interface to route a message
 	 *
@@ -299,9 +402,10 @@ public:
 	 *
 	 * @param localAddress the string address to create the address at
 	 * @param receive a callback rvalue that will process messages as they are received in this mailbox
+	 * @param options how much mail the mailbox holds on to, and what it does with the rest
 	 * @return an dropbox that the creator can use to send addressed messages. will be invalid if it failed to add
 	 */
-	Dropbox RegisterAddress(const std::string& localAddress, ReceiveCallback&& receive);
+	Dropbox RegisterAddress(const std::string& localAddress, ReceiveCallback&& receive, MailboxOptions options = {});
 
 	/**
 	 * Removes a mailbox from the post office
@@ -333,11 +437,32 @@ public:
 	 * Processes messages waiting in the queue
 	 *
 	 * @param howMany how many messages to process (up to)
+	 * @param budget how long to spend on it. the mailboxes take turns going first, so one that is
+	 *               flooded can't keep using it all up
 	 */
 	void Process(size_t howMany);
+	void Process(size_t howMany, std::chrono::steady_clock::duration budget);
 
 protected:
+	/**
+	 * Fills in the parts of a return address that only the post office knows about
+	 *
+	 * @param address the return address of a message that is about to be routed
+	 * @return true if the address was changed
+	 */
+	virtual bool EnrichReturnAddress(proto::routing::Address& address) { return false; }
+
+	/**
+	 * Called when a mailbox is added or removed
+	 */
+	virtual void OnMailboxesChanged() {}
+
 	std::unordered_map<std::string, std::unique_ptr<Mailbox>> m_mailboxes;
+
+private:
+	void ProcessUntil(size_t howMany, std::chrono::steady_clock::time_point deadline);
+
+	size_t m_nextMailbox = 0;
 };
 
 /**
@@ -60,8 +60,13 @@ public:
 	const std::optional<proto::routing::Address>& GetSender() { return m_returnAddress; }
 	void SetSender(const proto::routing::Address& address) { m_returnAddress = address; }
 
+	// empty for mail that isn't state
+	const std::string& GetKey() const { return m_key; }
+	void SetKey(const std::string& key) { m_key = key; }
+
 private:
 	std::optional<proto::routing::Address> m_returnAddress;
+	std::string m_key;
 };
 using ProtoMessagePtr = std::unique_ptr<ProtoMessage>;
 
@@ -0,0 +1,371 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "SharedMemoryChannel.h"
+#include "NamedPipes.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace mq {
+
+static constexpr uint32_t SHARED_RING_MAGIC = 0x474e5252; // 'RRNG'
+static constexpr uint32_t RECORD_MORE = 1;                // more fragments of the message follow
+
+// Lives at the start of each ring in the mapping. The layout is the same for 32 and 64 bit
+// processes, so that a 64 bit launcher can share a channel with a 32 bit client.
+struct SharedRingHeader
+{
+	uint32_t magic;
+	uint32_t capacity;
+
+	// head is only written by the writer and tail only by the reader. Both count bytes since the
+	// ring was created, so they don't wrap.
+	alignas(64) std::atomic<uint64_t> head;
+	alignas(64) std::atomic<uint64_t> tail;
+
+	// Set by the writer when the ring was full, so the reader knows to signal it.
+	std::atomic<uint32_t> writerWaiting;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared ring needs lock free 64 bit atomics");
+
+struct SharedRingRecord
+{
+	uint32_t length;
+	uint32_t flags;
+};
+
+// Records start on 8 byte boundaries, so a record header never wraps around the end of the ring.
+static uint64_t GetRecordSize(uint32_t length)
+{
+	return sizeof(SharedRingRecord) + ((static_cast<uint64_t>(length) + 7) & ~uint64_t{ 7 });
+}
+
+static size_t GetMappingSize(uint32_t capacity)
+{
+	return 2 * (sizeof(SharedRingHeader) + capacity);
+}
+
+static std::string GetChannelObjectName(uint32_t processId, uint32_t channelId, const char* suffix)
+{
+	return fmt::format("Local\\mqpipe_shm_{}_{}{}", processId, channelId, suffix);
+}
+
+//============================================================================
+// SharedRing
+//============================================================================
+
+void SharedRing::Init(SharedRingHeader* header, uint8_t* data, uint32_t capacity, HANDLE hPeerEvent)
+{
+	m_header = header;
+	m_data = data;
+	m_capacity = capacity;
+	m_hPeerEvent = hPeerEvent;
+}
+
+void SharedRing::CopyIn(uint64_t pos, const void* src, size_t length)
+{
+	const size_t offset = static_cast<size_t>(pos & (m_capacity - 1));
+	const size_t first = std::min<size_t>(length, m_capacity - offset);
+
+	memcpy(m_data + offset, src, first);
+	memcpy(m_data, static_cast<const uint8_t*>(src) + first, length - first);
+}
+
+void SharedRing::CopyOut(uint64_t pos, void* dest, size_t length) const
+{
+	const size_t offset = static_cast<size_t>(pos & (m_capacity - 1));
+	const size_t first = std::min<size_t>(length, m_capacity - offset);
+
+	memcpy(dest, m_data + offset, first);
+	memcpy(static_cast<uint8_t*>(dest) + first, m_data, length - first);
+}
+
+bool SharedRing::TryWrite(const uint8_t* data, uint32_t length, bool more)
+{
+	const uint64_t size = GetRecordSize(length);
+	const uint64_t head = m_header->head.load(std::memory_order_relaxed);
+	const uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+
+	if (size > m_capacity - (head - tail))
+		return false;
+
+	const SharedRingRecord record = { length, more ? RECORD_MORE : 0 };
+	CopyIn(head, &record, sizeof(record));
+	CopyIn(head + sizeof(record), data, length);
+
+	m_header->head.store(head + size);
+
+	// The reader only goes to sleep once it has read everything before this record. Both of these
+	// are sequentially consistent, so either the reader sees the new head before it sleeps or we
+	// see that it caught up.
+	if (m_header->tail.load() == head)
+		::SetEvent(m_hPeerEvent);
+
+	return true;
+}
+
+bool SharedRing::Write(const uint8_t* data, uint32_t length, bool more)
+{
+	if (TryWrite(data, length, more))
+		return true;
+
+	// Ask the reader for a signal when it makes room, then check again in case it already has.
+	m_header->writerWaiting.store(1);
+	return TryWrite(data, length, more);
+}
+
+bool SharedRing::Read(PipeBufferPool& pool, PipeBuffer& buffer, uint32_t& length, bool& more)
+{
+	if (m_corrupt)
+		return false;
+
+	const uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+	const uint64_t head = m_header->head.load();
+	if (head == tail)
+		return false;
+
+	const uint64_t available = head - tail;
+	if (available < sizeof(SharedRingRecord) || available > m_capacity)
+	{
+		m_corrupt = true;
+		return false;
+	}
+
+	SharedRingRecord record;
+	CopyOut(tail, &record, sizeof(record));
+
+	const uint64_t size = GetRecordSize(record.length);
+	if (size > available)
+	{
+		m_corrupt = true;
+		return false;
+	}
+
+	buffer = pool.Acquire(record.length);
+	CopyOut(tail + sizeof(record), buffer.get(), record.length);
+	length = record.length;
+	more = (record.flags & RECORD_MORE) != 0;
+
+	m_header->tail.store(tail + size);
+
+	if (m_header->writerWaiting.exchange(0) != 0)
+		::SetEvent(m_hPeerEvent);
+
+	return true;
+}
+
+//============================================================================
+// SharedMemoryChannel
+//============================================================================
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::Create(uint32_t processId, uint32_t channelId, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		return nullptr;
+
+	std::unique_ptr<SharedMemoryChannel> channel(new SharedMemoryChannel(false));
+
+	const size_t mappingSize = GetMappingSize(capacity);
+	channel->m_mapping.reset(::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(mappingSize) >> 32), static_cast<DWORD>(mappingSize),
+		GetChannelObjectName(processId, channelId, "").c_str()));
+	if (!channel->m_mapping || ::GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		SPDLOG_WARN("SharedMemoryChannel::Create: {}",
+			fmt::windows_error(::GetLastError(), "Failed to create shared memory").what());
+		return nullptr;
+	}
+
+	channel->m_wakeEvent.reset(::CreateEventA(nullptr, FALSE, FALSE, GetChannelObjectName(processId, channelId, "_c").c_str()));
+	channel->m_peerEvent.reset(::CreateEventA(nullptr, FALSE, FALSE, GetChannelObjectName(processId, channelId, "_s").c_str()));
+	if (!channel->m_wakeEvent || !channel->m_peerEvent || !channel->Map(capacity, true))
+		return nullptr;
+
+	return channel;
+}
+
+std::unique_ptr<SharedMemoryChannel> SharedMemoryChannel::Open(uint32_t processId, uint32_t channelId, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		return nullptr;
+
+	std::unique_ptr<SharedMemoryChannel> channel(new SharedMemoryChannel(true));
+
+	channel->m_mapping.reset(::OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+		GetChannelObjectName(processId, channelId, "").c_str()));
+	channel->m_wakeEvent.reset(::OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE,
+		GetChannelObjectName(processId, channelId, "_s").c_str()));
+	channel->m_peerEvent.reset(::OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE,
+		GetChannelObjectName(processId, channelId, "_c").c_str()));
+
+	if (!channel->m_mapping || !channel->m_wakeEvent || !channel->m_peerEvent)
+	{
+		SPDLOG_WARN("SharedMemoryChannel::Open: {} pid={} channelId={}",
+			fmt::windows_error(::GetLastError(), "Failed to open shared memory").what(), processId, channelId);
+		return nullptr;
+	}
+
+	if (!channel->Map(capacity, false))
+		return nullptr;
+
+	return channel;
+}
+
+// The first ring carries messages from the client to the server and the second one the replies.
+bool SharedMemoryChannel::Map(uint32_t capacity, bool created)
+{
+	const size_t mappingSize = GetMappingSize(capacity);
+
+	m_view.reset(static_cast<uint8_t*>(::MapViewOfFile(m_mapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, mappingSize)));
+	if (!m_view)
+	{
+		SPDLOG_WARN("SharedMemoryChannel::Map: {}",
+			fmt::windows_error(::GetLastError(), "Failed to map shared memory").what());
+		return false;
+	}
+
+	uint8_t* rings[2] = { m_view.get(), m_view.get() + sizeof(SharedRingHeader) + capacity };
+	SharedRingHeader* headers[2];
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (created)
+		{
+			headers[i] = new (rings[i]) SharedRingHeader{ SHARED_RING_MAGIC, capacity, {0}, {0}, {0} };
+		}
+		else
+		{
+			headers[i] = reinterpret_cast<SharedRingHeader*>(rings[i]);
+
+			// Whoever created the mapping decides its size, make sure the rings are all there.
+			if (headers[i]->magic != SHARED_RING_MAGIC || headers[i]->capacity != capacity)
+			{
+				SPDLOG_WARN("SharedMemoryChannel::Map: shared memory has the wrong layout");
+				return false;
+			}
+		}
+	}
+
+	MEMORY_BASIC_INFORMATION info = {};
+	if (!::VirtualQuery(m_view.get(), &info, sizeof(info)) || info.RegionSize < mappingSize)
+	{
+		SPDLOG_WARN("SharedMemoryChannel::Map: shared memory is too small");
+		return false;
+	}
+
+	const int outgoing = m_server ? 1 : 0;
+	const int incoming = m_server ? 0 : 1;
+
+	m_outgoing.Init(headers[outgoing], rings[outgoing] + sizeof(SharedRingHeader), capacity, m_peerEvent.get());
+	m_incoming.Init(headers[incoming], rings[incoming] + sizeof(SharedRingHeader), capacity, m_peerEvent.get());
+	return true;
+}
+
+// Messages only go into the backlog when they don't fit, so most of them are written straight away.
+size_t SharedMemoryChannel::Send(PipeMessagePtr&& message)
+{
+	if (m_backlog.empty() && Write(*message))
+		return 1;
+
+	m_backlog.push_back(std::move(message));
+	return 0;
+}
+
+size_t SharedMemoryChannel::Send(const SharedPipeMessagePtr& message)
+{
+	if (m_backlog.empty() && Write(*message))
+		return 1;
+
+	m_backlog.push_back(message);
+	return 0;
+}
+
+bool SharedMemoryChannel::Write(const PipeMessage& message)
+{
+	const uint8_t* data = message.buffer();
+	const size_t size = message.buffer_size();
+
+	while (m_backlogOffset < size)
+	{
+		const uint32_t fragment = static_cast<uint32_t>(std::min<size_t>(size - m_backlogOffset, m_outgoing.GetMaxFragment()));
+		const bool more = m_backlogOffset + fragment < size;
+
+		if (!m_outgoing.Write(data + m_backlogOffset, fragment, more))
+			return false;
+
+		m_backlogOffset += fragment;
+	}
+
+	m_backlogOffset = 0;
+	return true;
+}
+
+size_t SharedMemoryChannel::Flush()
+{
+	size_t written = 0;
+
+	while (!m_backlog.empty())
+	{
+		if (!Write(*m_backlog.front()))
+			return written;
+
+		m_backlog.pop_front();
+		++written;
+	}
+
+	return written;
+}
+
+PipeMessagePtr SharedMemoryChannel::Receive(PipeBufferPool& pool)
+{
+	PipeBuffer buffer;
+	uint32_t length = 0;
+	bool more = false;
+
+	while (m_incoming.Read(pool, buffer, length, more))
+	{
+		auto message = std::make_unique<PipeMessage>();
+
+		// Messages that fit in one record don't need to be put back together
+		if (m_fragments.empty() && !more)
+		{
+			if (message->Parse(std::move(buffer), length))
+				return message;
+		}
+		else
+		{
+			m_fragments.emplace_back(std::move(buffer), length);
+			if (more)
+				continue;
+
+			const bool parsed = message->Parse(m_fragments, &pool);
+			m_fragments.clear();
+
+			if (parsed)
+				return message;
+		}
+
+		SPDLOG_WARN("SharedMemoryChannel::Receive: Failed to parse incoming message");
+	}
+
+	return nullptr;
+}
+
+} // namespace mq
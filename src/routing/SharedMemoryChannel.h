@@ -0,0 +1,124 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include "PipeBufferPool.h"
+
+#include <wil/resource.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <windows.h>
+
+namespace mq {
+
+class PipeMessage;
+using PipeMessagePtr = std::unique_ptr<PipeMessage>;
+using SharedPipeMessagePtr = std::shared_ptr<const PipeMessage>;
+
+// Bytes in each direction of a shared memory channel. Must be a power of two.
+constexpr uint32_t SHARED_MEMORY_CHANNEL_CAPACITY = 1024 * 1024;
+
+struct SharedRingHeader;
+
+//============================================================================
+
+// One direction of a shared memory channel: a single producer, single consumer ring of records in
+// the shared mapping. Each record holds a message or a fragment of a message that was too large
+// to fit in the ring at once.
+class SharedRing
+{
+public:
+	void Init(SharedRingHeader* header, uint8_t* data, uint32_t capacity, HANDLE hPeerEvent);
+
+	// Writer: returns false if the record doesn't fit until the reader catches up. The reader will
+	// signal the writer's event when it makes room.
+	bool Write(const uint8_t* data, uint32_t length, bool more);
+
+	// Reader: returns false if there is nothing to read, or if the ring holds garbage, in which
+	// case IsCorrupt is set.
+	bool Read(PipeBufferPool& pool, PipeBuffer& buffer, uint32_t& length, bool& more);
+
+	bool IsCorrupt() const { return m_corrupt; }
+
+	// Largest fragment that is written in one record.
+	uint32_t GetMaxFragment() const { return m_capacity / 4; }
+
+private:
+	bool TryWrite(const uint8_t* data, uint32_t length, bool more);
+	void CopyIn(uint64_t pos, const void* src, size_t length);
+	void CopyOut(uint64_t pos, void* dest, size_t length) const;
+
+	SharedRingHeader* m_header = nullptr;
+	uint8_t* m_data = nullptr;
+	uint32_t m_capacity = 0;
+	HANDLE m_hPeerEvent = nullptr;
+	bool m_corrupt = false;
+};
+
+//============================================================================
+
+// A pair of rings in a file mapping shared by a client and the server, for sending messages to a
+// process on the same machine without going through the pipe. The client creates the channel and
+// offers it over the pipe, the server opens it by name. Each side has an event that the other sets
+// when there is something to read or room to write.
+class SharedMemoryChannel
+{
+public:
+	~SharedMemoryChannel();
+
+	static std::unique_ptr<SharedMemoryChannel> Create(uint32_t processId, uint32_t channelId, uint32_t capacity);
+	static std::unique_ptr<SharedMemoryChannel> Open(uint32_t processId, uint32_t channelId, uint32_t capacity);
+
+	// The event this side waits on.
+	HANDLE GetWakeEvent() const { return m_wakeEvent.get(); }
+
+	// Queues the message behind any that are still waiting for room and writes as much as fits.
+	// Returns the number of messages that were completely written.
+	size_t Send(PipeMessagePtr&& message);
+	size_t Send(const SharedPipeMessagePtr& message);
+	size_t Flush();
+
+	// Returns the next whole message, or nullptr if there isn't one yet. Its buffer comes from the pool.
+	PipeMessagePtr Receive(PipeBufferPool& pool);
+
+	bool HasFailed() const { return m_incoming.IsCorrupt(); }
+
+private:
+	explicit SharedMemoryChannel(bool server) : m_server(server) {}
+
+	bool Map(uint32_t capacity, bool created);
+
+	// Writes the message from where the backlog left off. Returns false if the rest didn't fit.
+	bool Write(const PipeMessage& message);
+
+	bool m_server;
+	wil::unique_handle m_mapping;
+	wil::unique_mapview_ptr<uint8_t> m_view;
+	wil::unique_event m_wakeEvent;
+	wil::unique_event m_peerEvent;
+	SharedRing m_outgoing;
+	SharedRing m_incoming;
+
+	std::deque<SharedPipeMessagePtr> m_backlog;
+	size_t m_backlogOffset = 0;                 // bytes of the first backlogged message already written
+
+	std::vector<std::pair<PipeBuffer, size_t>> m_fragments;
+};
+
+} // namespace mq
@@ -0,0 +1,179 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Micro-benchmarks for the parts of MacroQuest that don't need the game to run.
+//
+// Usage: Benchmarks [filter] [--corpus <directory>] [--csv <file>] [--time <seconds>]
+//
+// Only benchmarks whose name contains the filter are run. The corpus directory defaults to the
+// corpus folder next to this project, which is also the working directory when run from Visual
+// Studio. --csv appends the results to a file so that they can be compared between releases.
+
+#include "Benchmark.h"
+
+#include <mq/base/String.h>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace mq::benchmarks {
+
+static volatile size_t s_sink = 0;
+
+void Consume(size_t value)
+{
+	s_sink = s_sink + value;
+}
+
+static std::vector<std::string> LoadCorpusFile(const std::filesystem::path& path)
+{
+	std::vector<std::string> lines;
+
+	std::ifstream file(path);
+	if (!file)
+	{
+		fmt::print(stderr, "Could not open corpus file: {}\n", path.string());
+		return lines;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (!line.empty())
+			lines.push_back(std::move(line));
+	}
+
+	return lines;
+}
+
+static bool LoadCorpus(const std::filesystem::path& directory, Corpus& corpus)
+{
+	corpus.MacroLines = LoadCorpusFile(directory / "macro_lines.txt");
+	corpus.ChatLines = LoadCorpusFile(directory / "raid_chat.txt");
+	corpus.SpawnSearches = LoadCorpusFile(directory / "spawn_searches.txt");
+	corpus.BuffFilters = LoadCorpusFile(directory / "buff_filters.txt");
+
+	return !corpus.MacroLines.empty() && !corpus.ChatLines.empty()
+		&& !corpus.SpawnSearches.empty() && !corpus.BuffFilters.empty();
+}
+
+struct BenchmarkResult
+{
+	uint64_t Iterations = 0;
+	double NanosecondsPerItem = 0;
+};
+
+// Runs the benchmark with more and more iterations until a run takes at least minTime.
+static BenchmarkResult RunBenchmark(const Benchmark& benchmark, std::chrono::duration<double> minTime)
+{
+	// once to warm up the caches and anything that is built on first use
+	benchmark.Run();
+
+	uint64_t iterations = 1;
+	for (;;)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i)
+			benchmark.Run();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (elapsed >= minTime || iterations >= (uint64_t{ 1 } << 40))
+		{
+			BenchmarkResult result;
+			result.Iterations = iterations;
+			result.NanosecondsPerItem = std::chrono::duration<double, std::nano>(elapsed).count()
+				/ (static_cast<double>(iterations) * static_cast<double>(benchmark.ItemsPerIteration));
+			return result;
+		}
+
+		// aim a little past the minimum so that the next run is usually the last
+		const double scale = elapsed.count() > 0 ? minTime.count() / elapsed.count() * 1.4 : 10.0;
+		iterations = std::max(iterations + 1, static_cast<uint64_t>(static_cast<double>(iterations) * std::clamp(scale, 2.0, 10.0)));
+	}
+}
+
+} // namespace mq::benchmarks
+
+using namespace mq::benchmarks;
+
+int main(int argc, char* argv[])
+{
+	std::string filter;
+	std::filesystem::path corpusPath = "corpus";
+	std::string csvFile;
+	double minTime = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+
+		if (arg == "--corpus" && i + 1 < argc)
+			corpusPath = argv[++i];
+		else if (arg == "--csv" && i + 1 < argc)
+			csvFile = argv[++i];
+		else if (arg == "--time" && i + 1 < argc)
+			minTime = std::max(mq::GetDoubleFromString(argv[++i], minTime), 0.01);
+		else
+			filter = arg;
+	}
+
+	Corpus corpus;
+	if (!LoadCorpus(corpusPath, corpus))
+	{
+		fmt::print(stderr, "The corpus in {} is missing or incomplete. Use --corpus to say where it is.\n", corpusPath.string());
+		return 1;
+	}
+
+	BenchmarkList benchmarks;
+	AddStringBenchmarks(benchmarks, corpus);
+	AddLexerBenchmarks(benchmarks, corpus);
+	AddBlechBenchmarks(benchmarks, corpus);
+	AddRoutingBenchmarks(benchmarks, corpus);
+
+	std::ofstream csv;
+	if (!csvFile.empty())
+	{
+		const bool writeHeader = !std::filesystem::exists(csvFile);
+		csv.open(csvFile, std::ios::app);
+		if (writeHeader)
+			csv << "Benchmark,Iterations,ItemsPerIteration,NanosecondsPerItem\n";
+	}
+
+	fmt::print("{:<48} {:>12} {:>14} {:>16}\n", "Benchmark", "Iterations", "ns/item", "items/s");
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (!filter.empty() && mq::ci_find_substr(benchmark.Name, filter) == -1)
+			continue;
+
+		const BenchmarkResult result = RunBenchmark(benchmark, std::chrono::duration<double>(minTime));
+
+		fmt::print("{:<48} {:>12} {:>14.1f} {:>16.0f}\n", benchmark.Name, result.Iterations,
+			result.NanosecondsPerItem, 1e9 / result.NanosecondsPerItem);
+
+		if (csv)
+		{
+			csv << fmt::format("{},{},{},{:.2f}\n", benchmark.Name, result.Iterations,
+				benchmark.ItemsPerIteration, result.NanosecondsPerItem);
+		}
+	}
+
+	return 0;
+}
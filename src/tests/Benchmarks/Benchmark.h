@@ -0,0 +1,51 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mq::benchmarks {
+
+// Sample text the benchmarks run over, one entry per line of the files in the corpus directory.
+struct Corpus
+{
+	std::vector<std::string> MacroLines;       // macro_lines.txt
+	std::vector<std::string> ChatLines;        // raid_chat.txt
+	std::vector<std::string> SpawnSearches;    // spawn_searches.txt
+	std::vector<std::string> BuffFilters;      // buff_filters.txt
+};
+
+// A single benchmark. Each call to Run is one iteration, which handles ItemsPerIteration items
+// (usually one pass over a corpus) so that the results can be reported per item.
+struct Benchmark
+{
+	std::string Name;
+	size_t ItemsPerIteration = 1;
+	std::function<void()> Run;
+};
+
+using BenchmarkList = std::vector<Benchmark>;
+
+// Keeps the compiler from throwing away a result that is otherwise unused.
+void Consume(size_t value);
+
+void AddStringBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus);
+void AddLexerBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus);
+void AddBlechBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus);
+void AddRoutingBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus);
+
+} // namespace mq::benchmarks
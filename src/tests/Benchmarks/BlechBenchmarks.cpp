@@ -0,0 +1,98 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "Benchmark.h"
+
+#include <windows.h>
+#include <Blech/Blech.h>
+
+#include <memory>
+
+namespace mq::benchmarks {
+
+// The kind of #event lines that raid macros register, in the same syntax.
+static const char* s_eventPatterns[] = {
+	"#1# tells the raid, '#2#'",
+	"#1# tells the group, '#2#'",
+	"#1# tells you, '#2#'",
+	"#*#tells the raid, 'burn now#*#'",
+	"#*#tells the raid, 'cure #1#'",
+	"#1# has been slain by #2#!",
+	"You have been slain by #1#!",
+	"#*#You have gained a level! Welcome to level #1#!",
+	"Your #1# spell has worn off of #2#.",
+	"#1# has fallen to the ground.",
+	"You have healed #1# for #2# points.",
+	"#*#YOU for #1# points of damage.",
+	"#1# begins to cast a spell. <#2#>",
+	"Your target is too far away, get closer!",
+	"You cannot see your target.",
+	"You must first select a target for this spell!",
+	"#*#has taken #1# damage from your #2#.",
+	"#1# feels the touch of #2#.",
+	"#*#You feel yourself starting to appear.#*#",
+	"#1# is stunned!",
+};
+
+static unsigned int CALLBACK NoVariable(char* VarName, char* Value, size_t ValueLen)
+{
+	return 0;
+}
+
+static void CALLBACK CountMatch(unsigned int ID, void* pData, PBLECHVALUE pValues)
+{
+	++*static_cast<size_t*>(pData);
+}
+
+void AddBlechBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus)
+{
+	struct EventState
+	{
+		Blech events{ '#', '|', NoVariable };
+		size_t matches = 0;
+	};
+
+	auto state = std::make_shared<EventState>();
+	auto compiledState = std::make_shared<EventState>();
+	compiledState->events.SetCompiled(true);
+
+	for (const char* pattern : s_eventPatterns)
+	{
+		state->events.AddEvent(pattern, CountMatch, &state->matches);
+		compiledState->events.AddEvent(pattern, CountMatch, &compiledState->matches);
+	}
+
+	benchmarks.push_back({ "Blech/MayMatch (raid chat)", corpus.ChatLines.size(),
+		[&corpus, state]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(state->events.MayMatch(line.c_str()));
+		} });
+
+	benchmarks.push_back({ "Blech/Feed (raid chat)", corpus.ChatLines.size(),
+		[&corpus, state]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(state->events.Feed(line.c_str(), line.length()));
+		} });
+
+	benchmarks.push_back({ "Blech/Feed compiled (raid chat)", corpus.ChatLines.size(),
+		[&corpus, compiledState]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(compiledState->events.Feed(line.c_str(), line.length()));
+		} });
+}
+
+} // namespace mq::benchmarks
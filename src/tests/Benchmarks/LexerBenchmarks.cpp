@@ -0,0 +1,119 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "Benchmark.h"
+
+#include <mq/base/SimpleLexer.h>
+
+namespace mq::benchmarks {
+
+// Stands in for a buff, with just enough of one for the buff filter grammar to test against.
+struct TestBuff
+{
+	int SpellID;
+	int Category;
+	int SubCategory;
+	std::string Name;
+	std::string Caster;
+	std::vector<int> Attributes;
+};
+
+using BuffPredicate = std::function<bool(const TestBuff&)>;
+using BuffLexer = SimpleLexer<BuffPredicate>;
+
+// The same grammar as the Buff and FindBuff filters, less the lookups of names in the game data.
+static BuffLexer MakeBuffLexer()
+{
+	return BuffLexer(
+		[]() -> BuffPredicate { return [](const TestBuff&) { return false; }; },
+		"spa", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				const int spa = GetIntFromString(arg, -1);
+				return [spa](const TestBuff& buff)
+				{ return std::find(buff.Attributes.begin(), buff.Attributes.end(), spa) != buff.Attributes.end(); };
+			}),
+		"cat", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				const int category = GetIntFromString(arg, 0);
+				return [category](const TestBuff& buff) { return buff.Category == category; };
+			}),
+		"subcat", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				const int category = GetIntFromString(arg, 0);
+				return [category](const TestBuff& buff) { return buff.SubCategory == category; };
+			}),
+		"id", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				const int id = GetIntFromString(arg, 0);
+				return [id](const TestBuff& buff) { return buff.SpellID == id; };
+			}),
+		"name", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				return [name = std::string(arg)](const TestBuff& buff) { return ci_find_substr(buff.Name, name) != -1; };
+			}),
+		"caster", BuffLexer::Term([](std::string_view arg) -> BuffPredicate
+			{
+				return [caster = std::string(arg)](const TestBuff& buff) { return ci_equals(buff.Caster, caster); };
+			}),
+		"and", BuffLexer::Reducer([](BuffPredicate&& a, BuffPredicate&& b) -> BuffPredicate
+			{ return [a = std::move(a), b = std::move(b)](const TestBuff& buff) { return a(buff) && b(buff); }; }),
+		"or", BuffLexer::Reducer([](BuffPredicate&& a, BuffPredicate&& b) -> BuffPredicate
+			{ return [a = std::move(a), b = std::move(b)](const TestBuff& buff) { return a(buff) || b(buff); }; }),
+		"not", BuffLexer::Modifier([](BuffPredicate&& a) -> BuffPredicate
+			{ return [a = std::move(a)](const TestBuff& buff) { return !a(buff); }; })
+	);
+}
+
+static const std::vector<TestBuff> s_buffs = {
+	{ 1447, 125, 42, "Aegolism", "Clericone", { 0, 1, 79 } },
+	{ 3467, 79, 43, "Virtue", "Clericone", { 1, 69 } },
+	{ 21650, 95, 62, "Shared Brutal Ferocity", "Beastone", { 119, 0, 216 } },
+	{ 40250, 125, 59, "Talisman of the Wulthan", "Shamanone", { 69, 0, 5, 7 } },
+	{ 2590, 45, 17, "Spirit of Wolf", "Druidone", { 3, 58 } },
+	{ 56081, 20, 51, "Hastening of Salik", "Enchone", { 11, 98 } },
+	{ 3296, 125, 43, "Circle of Fireskin", "Druidone", { 59, 1 } },
+	{ 80106, 87, 61, "Sworn Protector", "Paladinone", { 168, 162 } },
+};
+
+void AddLexerBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus)
+{
+	// The lexer is built once and reused, the way InternalBuffEvaluate keeps a static one.
+	auto lexer = std::make_shared<BuffLexer>(MakeBuffLexer());
+
+	benchmarks.push_back({ "SimpleLexer/parse (buff filters)", corpus.BuffFilters.size(),
+		[&corpus, lexer]()
+		{
+			for (const std::string& filter : corpus.BuffFilters)
+			{
+				BuffPredicate predicate = (*lexer)(filter);
+				Consume(static_cast<bool>(predicate));
+			}
+		} });
+
+	std::vector<BuffPredicate> predicates;
+	for (const std::string& filter : corpus.BuffFilters)
+		predicates.push_back((*lexer)(filter));
+
+	benchmarks.push_back({ "SimpleLexer/evaluate (buff filters)", predicates.size() * s_buffs.size(),
+		[predicates = std::move(predicates)]()
+		{
+			for (const BuffPredicate& predicate : predicates)
+			{
+				for (const TestBuff& buff : s_buffs)
+					Consume(predicate(buff));
+			}
+		} });
+}
+
+} // namespace mq::benchmarks
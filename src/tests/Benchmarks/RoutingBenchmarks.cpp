@@ -0,0 +1,101 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "Benchmark.h"
+
+#include "routing/Routing.h"
+#include "routing/PostOffice.h"
+
+namespace mq::benchmarks {
+
+// Wraps the data the way the post office does it for mail from one client's actor to another's.
+static std::string StuffEnvelope(const std::string& data)
+{
+	proto::routing::Envelope envelope;
+
+	proto::routing::Address& address = *envelope.mutable_address();
+	address.set_name("dannet");
+	address.set_server("firiona");
+	address.set_character("Clericone");
+	address.set_mailbox("observe");
+
+	proto::routing::Address& ret = *envelope.mutable_return_address();
+	ret.set_pid(24816);
+	ret.set_mailbox("dannet");
+
+	envelope.set_payload(data);
+
+	return envelope.SerializeAsString();
+}
+
+void AddRoutingBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus)
+{
+	// raid chat makes for payloads of the usual size of actor messages
+	benchmarks.push_back({ "PostOffice/Envelope encode (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(StuffEnvelope(line).size());
+		} });
+
+	std::vector<std::string> envelopes;
+	for (const std::string& line : corpus.ChatLines)
+		envelopes.push_back(StuffEnvelope(line));
+
+	benchmarks.push_back({ "PostOffice/Envelope decode (raid chat)", envelopes.size(),
+		[envelopes = std::move(envelopes)]()
+		{
+			proto::routing::Envelope envelope;
+			for (const std::string& data : envelopes)
+			{
+				envelope.ParseFromArray(data.data(), static_cast<int>(data.size()));
+				Consume(envelope.payload().size());
+			}
+		} });
+
+	// the path that mail takes now: stuffed straight into the pipe message, and opened without
+	// copying the payload
+	benchmarks.push_back({ "PostOffice/StuffEnvelope (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			proto::routing::Envelope envelope;
+			envelope.mutable_address()->set_name("dannet");
+			envelope.mutable_address()->set_mailbox("observe");
+			envelope.mutable_return_address()->set_pid(24816);
+
+			for (const std::string& line : corpus.ChatLines)
+				Consume(postoffice::StuffEnvelope(envelope, line)->size());
+		} });
+
+	auto messages = std::make_shared<std::vector<PipeMessagePtr>>();
+	for (const std::string& line : corpus.ChatLines)
+	{
+		std::string data = StuffEnvelope(line);
+		messages->push_back(std::make_unique<PipeMessage>(MQMessageId::MSG_ROUTE, data.data(), data.size()));
+	}
+
+	benchmarks.push_back({ "PostOffice/OpenEnvelope (raid chat)", messages->size(),
+		[messages]()
+		{
+			proto::routing::Envelope envelope;
+			std::string_view payload;
+			for (const PipeMessagePtr& message : *messages)
+			{
+				postoffice::OpenEnvelope(*message, envelope, payload);
+				Consume(payload.size());
+			}
+		} });
+}
+
+} // namespace mq::benchmarks
@@ -0,0 +1,128 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-2023 MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "Benchmark.h"
+
+#include <mq/base/String.h>
+
+#include <algorithm>
+#include <random>
+
+namespace mq::benchmarks {
+
+// The keywords that a spawn search understands, for matching the words of a search against.
+static const ci_unordered::set<std::string_view> s_spawnSearchKeywords = {
+	"pc", "npc", "mercenary", "pet", "nopet", "corpse", "trigger", "untargetable", "trap", "chest",
+	"aura", "object", "banner", "campfire", "flyer", "mount", "any", "next", "prev", "lfg", "gm",
+	"group", "fellowship", "nogroup", "raid", "noguild", "known", "named", "merchant", "banker",
+	"tribute", "noalert", "alert", "notnearalert", "nearalert", "zradius", "radius", "range",
+	"class", "race", "body", "guild", "id", "loc", "targetable", "los", "playerstate", "nopcnear",
+	"xtarhater", "light", "master", "nearest", "xtarget",
+};
+
+void AddStringBenchmarks(BenchmarkList& benchmarks, const Corpus& corpus)
+{
+	benchmarks.push_back({ "String/tokenize_args (macro lines)", corpus.MacroLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.MacroLines)
+				Consume(tokenize_args(line).size());
+		} });
+
+	benchmarks.push_back({ "String/split_view (macro lines)", corpus.MacroLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.MacroLines)
+				Consume(split_view(line, ' ', true).size());
+		} });
+
+	benchmarks.push_back({ "String/trim_copy (macro lines)", corpus.MacroLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.MacroLines)
+				Consume(trim_copy(line).size());
+		} });
+
+	benchmarks.push_back({ "String/ci_find_substr hit (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(static_cast<size_t>(ci_find_substr(line, "tells the raid")));
+		} });
+
+	benchmarks.push_back({ "String/ci_find_substr miss (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(static_cast<size_t>(ci_find_substr(line, "Your spell fizzles")));
+		} });
+
+	benchmarks.push_back({ "String/ci_equals (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(ci_equals(line, corpus.ChatLines.front()));
+		} });
+
+	benchmarks.push_back({ "String/to_lower_copy (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(to_lower_copy(line).size());
+		} });
+
+	benchmarks.push_back({ "String/replace (raid chat)", corpus.ChatLines.size(),
+		[&corpus]()
+		{
+			for (const std::string& line : corpus.ChatLines)
+				Consume(replace(line, "tells the raid", "says").size());
+		} });
+
+	// The way a spawn search is picked apart: split into words, each of which is either a
+	// keyword, a number or a name.
+	benchmarks.push_back({ "String/spawn search words", corpus.SpawnSearches.size(),
+		[&corpus]()
+		{
+			for (const std::string& search : corpus.SpawnSearches)
+			{
+				for (std::string_view word : tokenize_args(search))
+				{
+					if (s_spawnSearchKeywords.count(word))
+						Consume(1);
+					else
+						Consume(static_cast<size_t>(GetIntFromString(word, 0)));
+				}
+			}
+		} });
+
+	// Every word of the raid chat, natural sorted the way lists in the UI are
+	std::vector<std::string_view> words;
+	for (const std::string& line : corpus.ChatLines)
+	{
+		for (std::string_view word : split_view(line, ' ', true))
+			words.push_back(word);
+	}
+	std::shuffle(words.begin(), words.end(), std::minstd_rand{ 1 });
+
+	benchmarks.push_back({ "String/alphanum_comp sort (raid chat words)", words.size(),
+		[words]()
+		{
+			std::vector<std::string_view> sorted = words;
+			std::sort(sorted.begin(), sorted.end(),
+				[](std::string_view a, std::string_view b) { return alphanum_comp(a, b) < 0; });
+			Consume(sorted.size());
+		} });
+}
+
+} // namespace mq::benchmarks
@@ -128,6 +128,31 @@ PLUGIN_API void SetGameState(int GameState)
 }
 
 
+/**
+ * @fn OnSaveReloadState
+ *
+ * Optional. Called when the plugin is about to be unloaded by "/plugin <name> reload".
+ * Write whatever the plugin needs to pick up where it left off into state; it is
+ * handed back to @ref OnRestoreReloadState once the plugin has been loaded again.
+ *
+ * @param state std::string& - Blob to serialize the plugin's state into
+ */
+// PLUGIN_API void OnSaveReloadState(std::string& state)
+// {
+// }
+
+/**
+ * @fn OnRestoreReloadState
+ *
+ * Optional. Called right after @ref InitializePlugin when the plugin was loaded by
+ * a reload and saved state with @ref OnSaveReloadState.
+ *
+ * @param state std::string_view - The blob that was saved before the reload
+ */
+// PLUGIN_API void OnRestoreReloadState(std::string_view state)
+// {
+// }
+
 /**
  * @fn OnPulse
  *
@@ -151,6 +176,21 @@ PLUGIN_API void OnPulse()
 */
 }
 
+/**
+ * @fn OnAsyncPulse
+ *
+ * Optional. Exporting this declares that the function is thread safe. It is then
+ * called once per pulse on a worker thread, at the same time as the main thread
+ * pulses, and MQ waits for it to finish before running commands and macros.
+ *
+ * It must not touch game memory, UI, TLOs or anything else owned by the main
+ * thread. Use it for work such as network I/O, logging or aggregating data that
+ * your plugin owns and guards itself.
+ */
+// PLUGIN_API void OnAsyncPulse()
+// {
+// }
+
 /**
  * @fn OnWriteChatColor
  *
@@ -229,6 +269,36 @@ PLUGIN_API void OnRemoveSpawn(PSPAWNINFO pSpawn)
 	// DebugSpewAlways("MQPluginTemplate::OnRemoveSpawn(%s)", pSpawn->Name);
 }
 
+/**
+ * @fn OnAddSpawns
+ *
+ * Batched alternative to @ref OnAddSpawn. If a plugin exports this, it is called
+ * once per pulse with every spawn added since the previous pulse, and
+ * @ref OnAddSpawn is no longer called. Spawns that are removed again before the
+ * pulse are never reported. When a plugin first initializes, it is called once
+ * with all existing spawns.
+ *
+ * @param spawns PSPAWNINFO const* - The spawns that were added
+ * @param count size_t - The number of spawns
+ */
+// PLUGIN_API void OnAddSpawns(PSPAWNINFO const* spawns, size_t count)
+// {
+// }
+
+/**
+ * @fn OnRemoveSpawns
+ *
+ * Batched alternative to @ref OnRemoveSpawn. If a plugin exports this, it is
+ * called instead of @ref OnRemoveSpawn, with every spawn removed at once when the
+ * whole spawn list is destroyed. Spawns are still valid during the call.
+ *
+ * @param spawns PSPAWNINFO const* - The spawns that were removed
+ * @param count size_t - The number of spawns
+ */
+// PLUGIN_API void OnRemoveSpawns(PSPAWNINFO const* spawns, size_t count)
+// {
+// }
+
 /**
  * @fn OnAddGroundItem
  *